@@ -34,6 +34,7 @@
 #include "eqCPUServices.h"
 #include "ExceptionHandler.h"
 #include "ConsoleCommands.h"
+#include "profiler_trace.h"
 
 EXPORTED_INTERFACE(IDkCore, CDkCore)
 
@@ -283,6 +284,9 @@ bool CDkCore::Init(const char* pszApplicationName, const char* pszCommandLine)
 	CEqCPUCaps* cpuCaps = (CEqCPUCaps*)g_cpuCaps.GetInstancePtr();
 	cpuCaps->Init();
 
+	// calibrated once here, threads read it without synchronization
+	ProfTraceInit();
+
 	ConCommandBase::Register(&developer);
 	ConCommandBase::Register(&echo);
 
@@ -335,6 +339,11 @@ void CDkCore::Shutdown()
 
 	m_isInit = false;
 
+	// trace output is a file
+	ProfStopTrace();
+	ProfStatsShutdown();
+	PROF_RELEASE_THREAD_MARKERS();
+
 	g_fileSystem->Shutdown();
 
 	SAFE_DELETE(m_coreConfiguration);
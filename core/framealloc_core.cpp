@@ -0,0 +1,375 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2024
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Per-thread double-buffered frame memory arena
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "core/core_common.h"
+#include "core/ConCommand.h"
+
+using namespace Threading;
+
+static constexpr const int		FRAMEALLOC_MAX_ARENAS = 256;
+static constexpr const size_t	FRAMEALLOC_CHUNK_SIZE = 256 * 1024;
+
+#ifdef EQ_DEBUG
+// tail guard of each allocation is checked when buffer is rewound
+static constexpr const size_t	FRAMEALLOC_GUARD_SIZE = 16;
+static constexpr const ubyte	FRAMEALLOC_GUARD_BYTE = 0xFD;
+static constexpr const ubyte	FRAMEALLOC_EXPIRED_BYTE = 0xDD;
+
+struct FrameAllocDebugRecord
+{
+	ubyte*			ptr;
+	size_t			size;
+	PPSourceLine	sl;
+};
+#else
+static constexpr const size_t	FRAMEALLOC_GUARD_SIZE = 0;
+#endif // EQ_DEBUG
+
+struct FrameArenaChunk
+{
+	ubyte*	data{ nullptr };
+	size_t	size{ 0 };
+	size_t	used{ 0 };
+};
+
+struct FrameArenaBuffer
+{
+	Array<FrameArenaChunk>	chunks{ PP_SL };
+	int				currentChunk{ 0 };
+	int64			frameIndex{ -1 };
+
+	// for in-place growth
+	ubyte*			lastAlloc{ nullptr };
+
+	size_t			usedBytes{ 0 };
+	int				numAllocs{ 0 };
+
+#ifdef EQ_DEBUG
+	Array<FrameAllocDebugRecord> debugRecords{ PPSourceLine::Empty() };
+#endif
+};
+
+struct FrameArena
+{
+	FrameArenaBuffer	buffers[2];		// by frame index parity
+	size_t				reservedBytes{ 0 };
+	size_t				peakFrameBytes{ 0 };
+	uintptr_t			threadId{ 0 };
+	bool				inUse{ false };
+};
+
+static volatile int64	s_frameAllocFrameIndex = 0;
+
+static CEqMutex			s_frameArenasMutex;
+static FrameArena*		s_frameArenas[FRAMEALLOC_MAX_ARENAS]{ nullptr };
+static volatile int32	s_numFrameArenas = 0;
+
+static void FrameArenaRelease();
+
+struct FrameArenaReleaser
+{
+	~FrameArenaReleaser() { FrameArenaRelease(); }
+};
+
+static thread_local FrameArena*			tls_frameArena = nullptr;
+static thread_local FrameArenaReleaser	tls_frameArenaReleaser;
+
+// arenas of exited threads are reused, they are never freed
+static FrameArena* FrameArenaAcquire()
+{
+	FrameArena* arena = nullptr;
+	{
+		CScopedMutex m(s_frameArenasMutex);
+		for (int i = 0; i < s_numFrameArenas; ++i)
+		{
+			if (!s_frameArenas[i]->inUse)
+			{
+				arena = s_frameArenas[i];
+				break;
+			}
+		}
+
+		if (!arena)
+		{
+			arena = PPNew FrameArena;
+			if (s_numFrameArenas < FRAMEALLOC_MAX_ARENAS)
+			{
+				s_frameArenas[s_numFrameArenas] = arena;
+				Atomic::Increment(s_numFrameArenas);
+			}
+			else
+				MsgWarning("Too many frame arenas, new arena is not listed in stats\n");
+		}
+
+		arena->inUse = true;
+		arena->threadId = GetCurrentThreadID();
+	}
+
+	tls_frameArena = arena;
+
+	// registers release on thread exit
+	(void)&tls_frameArenaReleaser;
+	return arena;
+}
+
+static void FrameArenaRelease()
+{
+	FrameArena* arena = tls_frameArena;
+	tls_frameArena = nullptr;
+
+	if (!arena)
+		return;
+
+	CScopedMutex m(s_frameArenasMutex);
+	arena->inUse = false;
+}
+
+static FrameArena* FrameArenaGet()
+{
+	FrameArena* arena = tls_frameArena;
+	return arena ? arena : FrameArenaAcquire();
+}
+
+#ifdef EQ_DEBUG
+static void FrameBufferCheckGuards(const FrameArenaBuffer& buffer, int firstRecord)
+{
+	for (int recordIdx = firstRecord; recordIdx < buffer.debugRecords.numElem(); ++recordIdx)
+	{
+		const FrameAllocDebugRecord& record = buffer.debugRecords[recordIdx];
+		const ubyte* guard = record.ptr + record.size;
+		for (size_t i = 0; i < FRAMEALLOC_GUARD_SIZE; ++i)
+		{
+			if (guard[i] == FRAMEALLOC_GUARD_BYTE)
+				continue;
+
+			MsgError("Frame allocation of %s:%d (%" PRIu64 " bytes) was overflowed\n", record.sl.GetFileName(), record.sl.GetLine(), static_cast<uint64>(record.size));
+			ASSERT_FAIL("Frame allocation of %s:%d was overflowed, investigate with ASAN", record.sl.GetFileName(), record.sl.GetLine());
+			break;
+		}
+	}
+}
+#endif // EQ_DEBUG
+
+static void FrameBufferRewind(FrameArena* arena, FrameArenaBuffer& buffer)
+{
+#ifdef EQ_DEBUG
+	FrameBufferCheckGuards(buffer, 0);
+	buffer.debugRecords.clear();
+
+	// stale pointers will read garbage
+	for (FrameArenaChunk& chunk : buffer.chunks)
+		memset(chunk.data, FRAMEALLOC_EXPIRED_BYTE, chunk.used);
+#endif // EQ_DEBUG
+
+	arena->peakFrameBytes = max(arena->peakFrameBytes, buffer.usedBytes);
+
+	for (FrameArenaChunk& chunk : buffer.chunks)
+		chunk.used = 0;
+
+	buffer.currentChunk = 0;
+	buffer.lastAlloc = nullptr;
+	buffer.usedBytes = 0;
+	buffer.numAllocs = 0;
+}
+
+// buffer of current frame, rewound if it holds memory of frame before previous
+static FrameArenaBuffer& FrameArenaGetBuffer(FrameArena* arena)
+{
+	const int64 frameIndex = s_frameAllocFrameIndex;
+
+	FrameArenaBuffer& buffer = arena->buffers[frameIndex & 1];
+	if (buffer.frameIndex != frameIndex)
+	{
+		FrameBufferRewind(arena, buffer);
+		buffer.frameIndex = frameIndex;
+	}
+	return buffer;
+}
+
+static ubyte* FrameBufferAlloc(FrameArena* arena, FrameArenaBuffer& buffer, size_t size, size_t align, const PPSourceLine& sl)
+{
+	const size_t reserveSize = size + FRAMEALLOC_GUARD_SIZE;
+
+	ubyte* ptr = nullptr;
+	while (!ptr)
+	{
+		if (buffer.currentChunk == buffer.chunks.numElem())
+		{
+			FrameArenaChunk& newChunk = buffer.chunks.append();
+			newChunk.size = max(FRAMEALLOC_CHUNK_SIZE, reserveSize + align);
+			newChunk.data = reinterpret_cast<ubyte*>(PPDAlloc(newChunk.size, sl));
+			arena->reservedBytes += newChunk.size;
+		}
+
+		FrameArenaChunk& chunk = buffer.chunks[buffer.currentChunk];
+
+		const uintptr_t start = reinterpret_cast<uintptr_t>(chunk.data + chunk.used);
+		const size_t offset = ((start + align - 1) & ~static_cast<uintptr_t>(align - 1)) - reinterpret_cast<uintptr_t>(chunk.data);
+
+		// skip to the next chunk, rest of this one is wasted until rewind
+		if (offset + reserveSize > chunk.size)
+		{
+			++buffer.currentChunk;
+			continue;
+		}
+
+		ptr = chunk.data + offset;
+		buffer.usedBytes += offset + reserveSize - chunk.used;
+		chunk.used = offset + reserveSize;
+	}
+
+	buffer.lastAlloc = ptr;
+	++buffer.numAllocs;
+
+#ifdef EQ_DEBUG
+	memset(ptr + size, FRAMEALLOC_GUARD_BYTE, FRAMEALLOC_GUARD_SIZE);
+	buffer.debugRecords.append({ ptr, size, sl });
+#endif
+
+	return ptr;
+}
+
+IEXPORTS void* FrameDAlloc(size_t size, size_t align, const PPSourceLine& sl)
+{
+	ASSERT_MSG(align > 0 && (align & (align - 1)) == 0, "FrameDAlloc alignment %d is not power of two", static_cast<int>(align));
+
+	FrameArena* arena = FrameArenaGet();
+	FrameArenaBuffer& buffer = FrameArenaGetBuffer(arena);
+	return FrameBufferAlloc(arena, buffer, size, align, sl);
+}
+
+IEXPORTS void* FrameDReAlloc(void* ptr, size_t oldSize, size_t newSize, size_t align, const PPSourceLine& sl)
+{
+	if (!ptr)
+		return FrameDAlloc(newSize, align, sl);
+
+	FrameArena* arena = FrameArenaGet();
+	FrameArenaBuffer& buffer = FrameArenaGetBuffer(arena);
+
+	// last allocation of the current chunk can be grown or shrunk
+	if (buffer.lastAlloc == ptr)
+	{
+		FrameArenaChunk& chunk = buffer.chunks[buffer.currentChunk];
+		const size_t offset = static_cast<ubyte*>(ptr) - chunk.data;
+
+		if (offset + newSize + FRAMEALLOC_GUARD_SIZE <= chunk.size)
+		{
+			const size_t newUsed = offset + newSize + FRAMEALLOC_GUARD_SIZE;
+			buffer.usedBytes = buffer.usedBytes + newUsed - chunk.used;
+			chunk.used = newUsed;
+
+#ifdef EQ_DEBUG
+			memset(static_cast<ubyte*>(ptr) + newSize, FRAMEALLOC_GUARD_BYTE, FRAMEALLOC_GUARD_SIZE);
+			buffer.debugRecords.back().size = newSize;
+#endif
+			return ptr;
+		}
+	}
+
+	ubyte* newPtr = FrameBufferAlloc(arena, buffer, newSize, align, sl);
+	memcpy(newPtr, ptr, min(oldSize, newSize));
+	return newPtr;
+}
+
+IEXPORTS void FrameAllocEndFrame()
+{
+	Atomic::Increment(s_frameAllocFrameIndex);
+}
+
+IEXPORTS FrameAllocMark FrameAllocGetMark()
+{
+	FrameArena* arena = FrameArenaGet();
+	FrameArenaBuffer& buffer = FrameArenaGetBuffer(arena);
+
+	// allocations made before mark must not grow over it
+	buffer.lastAlloc = nullptr;
+
+	FrameAllocMark mark;
+	mark.frameIndex = buffer.frameIndex;
+	mark.chunk = buffer.currentChunk;
+	mark.chunkUsed = buffer.currentChunk < buffer.chunks.numElem() ? buffer.chunks[buffer.currentChunk].used : 0;
+	mark.usedBytes = buffer.usedBytes;
+	mark.numAllocs = buffer.numAllocs;
+	return mark;
+}
+
+IEXPORTS void FrameAllocRewind(const FrameAllocMark& mark)
+{
+	FrameArena* arena = FrameArenaGet();
+
+	// frame may have ended inside the scope, allocations of the next frame are kept
+	FrameArenaBuffer& buffer = arena->buffers[mark.frameIndex & 1];
+	if (buffer.frameIndex != mark.frameIndex)
+		return;
+
+	ASSERT_MSG(buffer.numAllocs >= mark.numAllocs, "FrameAllocRewind - buffer was rewound after mark was taken");
+
+#ifdef EQ_DEBUG
+	FrameBufferCheckGuards(buffer, mark.numAllocs);
+	buffer.debugRecords.setNum(mark.numAllocs, false);
+
+	for (int i = mark.chunk; i <= buffer.currentChunk && i < buffer.chunks.numElem(); ++i)
+	{
+		FrameArenaChunk& chunk = buffer.chunks[i];
+		const size_t keepUsed = (i == mark.chunk) ? mark.chunkUsed : 0;
+		memset(chunk.data + keepUsed, FRAMEALLOC_EXPIRED_BYTE, chunk.used - keepUsed);
+	}
+#endif // EQ_DEBUG
+
+	arena->peakFrameBytes = max(arena->peakFrameBytes, buffer.usedBytes);
+
+	for (int i = mark.chunk + 1; i < buffer.chunks.numElem(); ++i)
+		buffer.chunks[i].used = 0;
+
+	if (mark.chunk < buffer.chunks.numElem())
+		buffer.chunks[mark.chunk].used = mark.chunkUsed;
+
+	buffer.currentChunk = mark.chunk;
+	buffer.lastAlloc = nullptr;
+	buffer.usedBytes = mark.usedBytes;
+	buffer.numAllocs = mark.numAllocs;
+}
+
+IEXPORTS int64 FrameAllocGetFrameIndex()
+{
+	return s_frameAllocFrameIndex;
+}
+
+IEXPORTS void FrameAllocGetStats(FrameAllocStats& stats)
+{
+	stats = FrameAllocStats();
+	stats.frameIndex = s_frameAllocFrameIndex;
+	stats.lastFrameHeapAllocs = PPMemGetFrameAllocCount();
+
+	// counters are read unlocked and may be slightly off
+	CScopedMutex m(s_frameArenasMutex);
+	stats.numArenas = s_numFrameArenas;
+	for (int i = 0; i < s_numFrameArenas; ++i)
+	{
+		const FrameArena* arena = s_frameArenas[i];
+		const FrameArenaBuffer& lastBuffer = arena->buffers[(stats.frameIndex - 1) & 1];
+		if (lastBuffer.frameIndex == stats.frameIndex - 1)
+		{
+			stats.lastFrameAllocs += lastBuffer.numAllocs;
+			stats.lastFrameBytes += lastBuffer.usedBytes;
+		}
+
+		stats.peakFrameBytes = max(stats.peakFrameBytes, arena->peakFrameBytes);
+		stats.reservedBytes += arena->reservedBytes;
+	}
+}
+
+DECLARE_CMD(framealloc_stats, "Prints frame arena usage and heap allocations of last frame", 0)
+{
+	FrameAllocStats stats;
+	FrameAllocGetStats(stats);
+
+	Msg("Frame %" PRId64 ": %d frame allocations, %.2f KB in %d arenas (peak %.2f KB, reserved %.2f KB)\n",
+		stats.frameIndex - 1, stats.lastFrameAllocs, stats.lastFrameBytes / 1024.0f, stats.numArenas,
+		stats.peakFrameBytes / 1024.0f, stats.reservedBytes / 1024.0f);
+	Msg("  %d heap (re)allocations\n", stats.lastFrameHeapAllocs);
+}
@@ -13,6 +13,11 @@
 //				standard console output, or for checking whole space use 'PPMemInfo()'
 //				that is attached to 'ppmem_stats' console command
 //
+//				Tracked blocks come from size class pools. Each thread has own
+//				block cache and own tracking list with counters, so allocating
+//				threads do not contend. Blocks are exchanged with central pools
+//				in batches, tracking is merged only when PPMemInfo is called.
+//
 //////////////////////////////////////////////////////////////////////////////////
 
 #include "core/core_common.h"
@@ -27,6 +32,11 @@
 #define pp_internal_malloc(s)	malloc(s)
 #endif // defined(CRT_DEBUG_ENABLED) && defined(_WIN32)
 
+// pooled blocks would hide use-after-free from sanitizer
+#if __has_feature(address_sanitizer) || defined(__SANITIZE_ADDRESS__)
+#define PPMEM_NO_POOL
+#endif
+
 using namespace Threading;
 
 #define PPMEM_EXTRA_DEBUGINFO
@@ -34,6 +44,13 @@ constexpr const uint PPMEM_CHECKMARK	   = MAKECHAR4('P','P','M','E');
 constexpr const uint PPMEM_CHECKMARK_FREED = MAKECHAR4('E','M','T','Y');
 constexpr const uint PPMEM_EXTRA_MARKS = 20;
 
+constexpr const int		PPMEM_MAX_THREAD_STATES = 256;		// slot 0 is shared by threads without own state
+constexpr const int		PPMEM_NUM_SIZE_CLASSES = 40;		// 32 byte steps up to 512, then 4 per power of two
+constexpr const size_t	PPMEM_MAX_POOLED_BLOCK = 32768;
+constexpr const size_t	PPMEM_SLAB_SIZE = 128 * 1024;
+constexpr const int		PPMEM_SOURCE_CACHE_SIZE = 64;		// must be power of two
+constexpr const ushort	PPMEM_SIZE_CLASS_NONE = 0xFFFF;		// block is allocated by malloc
+
 struct ppallocinfo_t
 {
 	ppallocinfo_t*	next{nullptr};
@@ -46,39 +63,474 @@ struct ppallocinfo_t
 #endif // PPMEM_EXTRA_DEBUGINFO
 
 	uint			id;
+	ushort			threadSlot;		// owner of tracking list
+	ushort			sizeClass;
 	uint			checkMark;
 };
 
+// pooled block when not allocated
+struct ppfreeblock_t
+{
+	ppfreeblock_t*	next;
+};
+
+struct ppblock_list_t
+{
+	ppfreeblock_t*	first{ nullptr };
+	int				numBlocks{ 0 };
+};
+
+struct ppsize_class_pool_t
+{
+	CEqMutex		mutex;
+	ppblock_list_t	blocks;
+};
+
 // allocation map
 struct ppsrc_counter_t
 {
 	uint64 count{ 0 };
-	uint64 lastTime{ 0 };
+	uint64 lastAllocId{ 0 };
 };
 using source_counter_map = Map<uint64, ppsrc_counter_t>;
 using source_map = Map<const char*, const char*>;
 
-struct ppmem_state_t
+struct ppsrc_cache_t
+{
+	uint64				key{ 0 };
+	ppsrc_counter_t*	counter{ nullptr };
+};
+
+// taken by owning thread nearly always, cheaper than mutex when uncontended
+struct ppspinlock_t
+{
+	volatile int32	locked{ 0 };
+
+	void Lock()
+	{
+		while (Atomic::CompareExchange(locked, 0, 1) != 0)
+			YieldCurrentThread();
+	}
+
+	void Unlock()
+	{
+		Atomic::Exchange(locked, 0);
+	}
+};
+
+struct ppspinlock_scoped_t
+{
+	ppspinlock_scoped_t(ppspinlock_t& lock) : lock(lock) { lock.Lock(); }
+	~ppspinlock_scoped_t() { lock.Unlock(); }
+
+	ppspinlock_t&	lock;
+};
+
+struct ppthread_state_t
 {
+	// guards tracking list and counters, other threads lock it when freeing allocations of this thread
+	ppspinlock_t	lock;
+	ppallocinfo_t*	first{ nullptr };
+	ppallocinfo_t*	last{ nullptr };
+	int64			numAllocs{ 0 };
+	int64			allocMemCounter{ 0 };
+	int64			allocCounter{ 0 };		// total (re)allocations, for per-frame counts
+
 #ifdef PPMEM_EXTRA_DEBUGINFO
-	source_map sourceFileNameMap{PPSourceLine::Empty()};
+	source_map		sourceFileNameMap{ PPSourceLine::Empty() };
 	source_counter_map sourceCounterMap{ PPSourceLine::Empty() };
-	CEqTimer timer;
+	ppsrc_cache_t	sourceCounterCache[PPMEM_SOURCE_CACHE_SIZE];
 #endif
 
-	ppallocinfo_t* first{ nullptr };
-	ppallocinfo_t* last{ nullptr };
-	uint64 numAllocs{ 0 };
+	// accessed only by owning thread
+	ppblock_list_t	blockCache[PPMEM_NUM_SIZE_CLASSES];
 
-	uint allocIdCounter = 0;
-	uint64 allocMemCounter = 0;
-	CEqMutex allocMemMutex;
+	ushort			slot{ 0 };
+	bool			shared{ false };	// may be used by many threads at once, no block cache
+	bool			inUse{ false };
 };
 
+struct ppmem_state_t
+{
+	CEqMutex			threadStatesMutex;
+	ppthread_state_t*	threadStates[PPMEM_MAX_THREAD_STATES]{ nullptr };
+	volatile int32		numThreadStates{ 0 };
+
+	ppsize_class_pool_t	pools[PPMEM_NUM_SIZE_CLASSES];
+	int64				slabMemCounter{ 0 };
+
+	volatile uint32		allocIdCounter{ 0 };
+
+	int64				frameStartAllocCounter{ 0 };
+	int					lastFrameAllocs{ 0 };
+	int					peakFrameAllocs{ 0 };
+};
+
+// states are created with malloc and never destroyed because
+// static destructors and exiting threads still free memory
+static ppthread_state_t* PPMemCreateThreadState(ppmem_state_t& st, bool shared)
+{
+	if (st.numThreadStates >= PPMEM_MAX_THREAD_STATES)
+		return nullptr;
+
+	ppthread_state_t* ts = new(malloc(sizeof(ppthread_state_t))) ppthread_state_t;
+	ts->slot = st.numThreadStates;
+	ts->shared = shared;
+	ts->inUse = shared;
+
+	// publish after state is set up, PPMemGetUsage reads it without lock
+	st.threadStates[ts->slot] = ts;
+	Atomic::Increment(st.numThreadStates);
+	return ts;
+}
+
 static ppmem_state_t& PPGetState()
 {
-	static ppmem_state_t st;
-	return st;
+	static ppmem_state_t* st = []() {
+		ppmem_state_t* newState = new(malloc(sizeof(ppmem_state_t))) ppmem_state_t;
+		PPMemCreateThreadState(*newState, true);
+		return newState;
+	}();
+	return *st;
+}
+
+//-------------------------------------------------------
+// Size classes
+
+static ushort PPMemSizeClass(size_t blockSize)
+{
+#ifdef PPMEM_NO_POOL
+	return PPMEM_SIZE_CLASS_NONE;
+#else
+	if (blockSize > PPMEM_MAX_POOLED_BLOCK)
+		return PPMEM_SIZE_CLASS_NONE;
+
+	if (blockSize <= 512)
+		return (blockSize + 31) / 32 - 1;
+
+	int log2 = 9;
+	while ((blockSize - 1) >> (log2 + 1))
+		++log2;
+
+	const int step = (blockSize - 1) >> (log2 - 2);
+	return 16 + (log2 - 9) * 4 + (step - 4);
+#endif
+}
+
+static size_t PPMemSizeClassBlockSize(int sizeClass)
+{
+	if (sizeClass < 16)
+		return (sizeClass + 1) * 32;
+
+	const int log2 = 9 + (sizeClass - 16) / 4;
+	const int step = 4 + (sizeClass - 16) % 4;
+	return static_cast<size_t>(step + 1) << (log2 - 2);
+}
+
+// number of blocks exchanged between thread cache and central pool
+static int PPMemSizeClassBatch(int sizeClass)
+{
+	return clamp(static_cast<int>(PPMEM_SLAB_SIZE / 16 / PPMemSizeClassBlockSize(sizeClass)), 4, 64);
+}
+
+static size_t PPMemBlockSize(size_t size)
+{
+	return sizeof(ppallocinfo_t) + size + sizeof(uint) * PPMEM_EXTRA_MARKS;
+}
+
+//-------------------------------------------------------
+// Block pools
+
+static ppfreeblock_t* PPMemCutBlocks(ppblock_list_t& list, int count, int& numCut)
+{
+	ppfreeblock_t* first = list.first;
+	ppfreeblock_t* last = nullptr;
+
+	numCut = 0;
+	for (ppfreeblock_t* block = first; block && numCut < count; block = block->next)
+	{
+		last = block;
+		++numCut;
+	}
+
+	if (!last)
+		return nullptr;
+
+	list.first = last->next;
+	list.numBlocks -= numCut;
+	last->next = nullptr;
+	return first;
+}
+
+static void PPMemSpliceBlocks(ppblock_list_t& list, ppfreeblock_t* first, int count)
+{
+	if (!first)
+		return;
+
+	ppfreeblock_t* last = first;
+	while (last->next)
+		last = last->next;
+
+	last->next = list.first;
+	list.first = first;
+	list.numBlocks += count;
+}
+
+static void PPMemFillCache(ppmem_state_t& st, ppblock_list_t& cache, int sizeClass)
+{
+	ppsize_class_pool_t& pool = st.pools[sizeClass];
+	const int batch = PPMemSizeClassBatch(sizeClass);
+	{
+		CScopedMutex m(pool.mutex);
+		int numCut = 0;
+		ppfreeblock_t* first = PPMemCutBlocks(pool.blocks, batch, numCut);
+		PPMemSpliceBlocks(cache, first, numCut);
+	}
+
+	if (cache.numBlocks)
+		return;
+
+	// carve new slab, first batch goes to the cache and the rest to the pool
+	const size_t blockSize = PPMemSizeClassBlockSize(sizeClass);
+	const size_t slabSize = max(PPMEM_SLAB_SIZE, blockSize * batch);
+	const int numBlocks = slabSize / blockSize;
+
+	ubyte* slab = reinterpret_cast<ubyte*>(pp_internal_malloc(slabSize));
+	ASSERT_MSG(slab, "alloc: no mem left for slab");
+
+	for (int i = 0; i < numBlocks; ++i)
+	{
+		ppfreeblock_t* block = reinterpret_cast<ppfreeblock_t*>(slab + i * blockSize);
+		block->next = (i + 1 < numBlocks && i + 1 != batch) ? reinterpret_cast<ppfreeblock_t*>(slab + (i + 1) * blockSize) : nullptr;
+	}
+
+	cache.first = reinterpret_cast<ppfreeblock_t*>(slab);
+	cache.numBlocks = batch;
+
+	CScopedMutex m(pool.mutex);
+	st.slabMemCounter += slabSize;
+	if (numBlocks > batch)
+		PPMemSpliceBlocks(pool.blocks, reinterpret_cast<ppfreeblock_t*>(slab + batch * blockSize), numBlocks - batch);
+}
+
+static ppallocinfo_t* PPMemAllocBlock(ppmem_state_t& st, ppthread_state_t* ts, size_t blockSize)
+{
+	const ushort sizeClass = PPMemSizeClass(blockSize);
+	if (sizeClass == PPMEM_SIZE_CLASS_NONE)
+	{
+		ppallocinfo_t* alloc = reinterpret_cast<ppallocinfo_t*>(pp_internal_malloc(blockSize));
+		ASSERT_MSG(alloc, "alloc: no mem left");
+		alloc->sizeClass = PPMEM_SIZE_CLASS_NONE;
+		return alloc;
+	}
+
+	ppfreeblock_t* block = nullptr;
+	if (ts->shared)
+	{
+		ppblock_list_t cache;
+		PPMemFillCache(st, cache, sizeClass);
+
+		int numCut = 0;
+		block = PPMemCutBlocks(cache, 1, numCut);
+
+		ppsize_class_pool_t& pool = st.pools[sizeClass];
+		CScopedMutex m(pool.mutex);
+		PPMemSpliceBlocks(pool.blocks, cache.first, cache.numBlocks);
+	}
+	else
+	{
+		ppblock_list_t& cache = ts->blockCache[sizeClass];
+		if (!cache.first)
+			PPMemFillCache(st, cache, sizeClass);
+
+		block = cache.first;
+		cache.first = block->next;
+		--cache.numBlocks;
+	}
+
+	ppallocinfo_t* alloc = reinterpret_cast<ppallocinfo_t*>(block);
+	alloc->sizeClass = sizeClass;
+	return alloc;
+}
+
+static void PPMemFreeBlock(ppmem_state_t& st, ppthread_state_t* ts, ppallocinfo_t* alloc)
+{
+	const ushort sizeClass = alloc->sizeClass;
+	if (sizeClass == PPMEM_SIZE_CLASS_NONE)
+	{
+		free(alloc);
+		return;
+	}
+
+	// keeps checkMark of header as it does not overlap
+	ppfreeblock_t* block = reinterpret_cast<ppfreeblock_t*>(alloc);
+	block->next = nullptr;
+
+	ppsize_class_pool_t& pool = st.pools[sizeClass];
+	if (ts->shared)
+	{
+		CScopedMutex m(pool.mutex);
+		PPMemSpliceBlocks(pool.blocks, block, 1);
+		return;
+	}
+
+	ppblock_list_t& cache = ts->blockCache[sizeClass];
+	block->next = cache.first;
+	cache.first = block;
+	++cache.numBlocks;
+
+	const int batch = PPMemSizeClassBatch(sizeClass);
+	if (cache.numBlocks > batch * 2)
+	{
+		int numCut = 0;
+		ppfreeblock_t* first = PPMemCutBlocks(cache, batch, numCut);
+
+		CScopedMutex m(pool.mutex);
+		PPMemSpliceBlocks(pool.blocks, first, numCut);
+	}
+}
+
+//-------------------------------------------------------
+// Thread states
+
+static void PPMemReleaseThreadState();
+
+struct ppthread_state_release_t
+{
+	~ppthread_state_release_t() { PPMemReleaseThreadState(); }
+};
+
+static thread_local ppthread_state_t*			tls_ppmemThreadState = nullptr;
+static thread_local ppthread_state_release_t	tls_ppmemThreadStateRelease;
+
+static ppthread_state_t* PPMemGetThreadState(ppmem_state_t& st)
+{
+	ppthread_state_t* ts = tls_ppmemThreadState;
+	if (ts)
+		return ts;
+
+	{
+		CScopedMutex m(st.threadStatesMutex);
+
+		// states of exited threads are reused along with their allocations
+		for (int i = 1; i < st.numThreadStates; ++i)
+		{
+			if (!st.threadStates[i]->inUse)
+			{
+				ts = st.threadStates[i];
+				break;
+			}
+		}
+
+		if (!ts)
+			ts = PPMemCreateThreadState(st, false);
+
+		if (ts)
+			ts->inUse = true;
+	}
+
+	if (!ts)
+	{
+		tls_ppmemThreadState = st.threadStates[0];
+		return st.threadStates[0];
+	}
+
+	tls_ppmemThreadState = ts;
+
+	// registers release on thread exit
+	(void)&tls_ppmemThreadStateRelease;
+	return ts;
+}
+
+static void PPMemReleaseThreadState()
+{
+	ppmem_state_t& st = PPGetState();
+
+	// whatever is freed after that goes to shared state
+	ppthread_state_t* ts = tls_ppmemThreadState;
+	tls_ppmemThreadState = st.threadStates[0];
+
+	if (!ts || ts->shared)
+		return;
+
+	for (int i = 0; i < PPMEM_NUM_SIZE_CLASSES; ++i)
+	{
+		ppblock_list_t& cache = ts->blockCache[i];
+		if (!cache.first)
+			continue;
+
+		ppsize_class_pool_t& pool = st.pools[i];
+		CScopedMutex m(pool.mutex);
+		PPMemSpliceBlocks(pool.blocks, cache.first, cache.numBlocks);
+		cache = ppblock_list_t();
+	}
+
+	CScopedMutex m(st.threadStatesMutex);
+	ts->inUse = false;
+}
+
+#ifdef PPMEM_EXTRA_DEBUGINFO
+static void PPMemCountSourceLine(ppthread_state_t* ts, const PPSourceLine& sl, uint allocId)
+{
+	const uint hash = static_cast<uint>(sl.data >> 3) ^ static_cast<uint>(sl.data >> 32) * 2654435761u;
+	ppsrc_cache_t& cached = ts->sourceCounterCache[hash & (PPMEM_SOURCE_CACHE_SIZE - 1)];
+
+	if (cached.key != sl.data || !cached.counter)
+	{
+		if (!ts->sourceFileNameMap.count(sl.GetFileName()))
+			ts->sourceFileNameMap[sl.GetFileName()] = strdup(sl.GetFileName());
+
+		// map items are not moved by insertion
+		cached.key = sl.data;
+		cached.counter = &ts->sourceCounterMap[sl.data];
+	}
+
+	++cached.counter->count;
+	cached.counter->lastAllocId = allocId;
+}
+#endif // PPMEM_EXTRA_DEBUGINFO
+
+// inserts to tracking list tail of thread
+static void PPMemLinkAlloc(ppthread_state_t* ts, ppallocinfo_t* alloc, const PPSourceLine& sl)
+{
+	ppspinlock_scoped_t l(ts->lock);
+	++ts->numAllocs;
+	++ts->allocCounter;
+	ts->allocMemCounter += alloc->size;
+
+	alloc->threadSlot = ts->slot;
+
+	if (ts->last != nullptr)
+		ts->last->next = alloc;
+	else
+		ts->first = alloc;
+
+	alloc->prev = ts->last;
+	alloc->next = nullptr;
+	ts->last = alloc;
+
+#ifdef PPMEM_EXTRA_DEBUGINFO
+	PPMemCountSourceLine(ts, sl, alloc->id);
+#endif
+}
+
+static void PPMemUnlinkAlloc(ppmem_state_t& st, ppallocinfo_t* alloc)
+{
+	ppthread_state_t* owner = st.threadStates[alloc->threadSlot];
+
+	ppspinlock_scoped_t l(owner->lock);
+	--owner->numAllocs;
+	owner->allocMemCounter -= alloc->size;
+
+	if (alloc->prev == nullptr)
+		owner->first = alloc->next;
+	else
+		alloc->prev->next = alloc->next;
+
+	if (alloc->next == nullptr)
+		owner->last = alloc->prev;
+	else
+		alloc->next->prev = alloc->prev;
 }
 
 #ifndef PPMEM_DISABLED
@@ -94,7 +546,7 @@ DECLARE_CMD(ppmem_stats, "Memory info", CV_UNREGISTERED)
 
 	PPMemInfo(fullStats);
 }
-DECLARE_CVAR(ppmem_break_on_alloc, "-1", "Helps to catch allocation id at stack trace", CV_UNREGISTERED);
+DECLARE_CVAR(ppmem_break_on_alloc, "0", "Helps to catch allocation id at stack trace, 0 is disabled", CV_UNREGISTERED);
 DECLARE_CVAR(ppmem_stats_rate, "0", "Shows allocation rate statistics for each source line", CV_UNREGISTERED);
 #endif
 
@@ -157,9 +609,8 @@ void PPMemInfo(bool fullStats)
 {
 	ppmem_state_t& st = PPGetState();
 
-	CScopedMutex m(st.allocMemMutex);
-
 	size_t totalUsage = 0;
+	int64 numAllocs = 0;
 	int64 numErrors = 0;
 
 	struct SLStat_t
@@ -168,49 +619,96 @@ void PPMemInfo(bool fullStats)
 		uint numAlloc{ 0 };
 	};
 
+	struct AllocRecord_t
+	{
+		const void*		ptr;
+		size_t			size;
+		PPSourceLine	sl;
+		uint			id;
+		bool			outranged;
+	};
+
 	Map<uint64, SLStat_t> allocCounter{ PPSourceLine::Empty() };
+	Array<AllocRecord_t> allocRecords{ PPSourceLine::Empty() };
 
-	if (fullStats)
-		MsgInfo("--- currently allocated memory ---\n");
+	// merge per-thread tracking first as allocation could be reallocated by other thread
+	source_map sourceFileNameMap{ PPSourceLine::Empty() };
+	source_counter_map sourceCounterMap{ PPSourceLine::Empty() };
+
+	// states are never removed, nothing is printed while state is locked
+	// as printing may allocate and thread state lock is not recursive
+	const int numThreadStates = Atomic::Load(st.numThreadStates);
+
+#ifdef PPMEM_EXTRA_DEBUGINFO
+	for (int i = 0; i < numThreadStates; ++i)
+	{
+		ppthread_state_t* ts = st.threadStates[i];
+		ppspinlock_scoped_t l(ts->lock);
+
+		for (auto it = ts->sourceFileNameMap.begin(); !it.atEnd(); ++it)
+			sourceFileNameMap[it.key()] = *it;
+
+		for (auto it = ts->sourceCounterMap.begin(); !it.atEnd(); ++it)
+		{
+			ppsrc_counter_t& cnt = sourceCounterMap[it.key()];
+			cnt.count += (*it).count;
+			cnt.lastAllocId = max(cnt.lastAllocId, (*it).lastAllocId);
+		}
+	}
+#endif // PPMEM_EXTRA_DEBUGINFO
 
 	// currently allocated items
-	for(ppallocinfo_t* alloc = st.first; alloc != nullptr; alloc = alloc->next)
+	for (int i = 0; i < numThreadStates; ++i)
 	{
-		const void* curPtr = alloc + 1;
+		ppthread_state_t* ts = st.threadStates[i];
+		ppspinlock_scoped_t l(ts->lock);
 
-		totalUsage += alloc->size;
-	
-		if(fullStats)
+		numAllocs += ts->numAllocs;
+
+		for(ppallocinfo_t* alloc = ts->first; alloc != nullptr; alloc = alloc->next)
 		{
-#ifdef PPMEM_EXTRA_DEBUGINFO
-			const char* filename = st.sourceFileNameMap[alloc->sl.GetFileName()];
-			const int fileLine = alloc->sl.GetLine();
-			MsgInfo("alloc id=%u, src='%s:%d', ptr=%p, size=%" PRIu64 "\n", alloc->id, filename, fileLine, curPtr, alloc->size);
-#else
-			MsgInfo("alloc id=%u, ptr=%p, size=%" PRIu64 "\n", alloc->id, curPtr, alloc->size);
-#endif
+			const void* curPtr = alloc + 1;
+			const uint* checkMark = (uint*)((ubyte*)curPtr + alloc->size);
+			const bool outranged = alloc->checkMark != PPMEM_CHECKMARK || *checkMark != PPMEM_CHECKMARK;
 
-			uint* checkMark = (uint*)((ubyte*)curPtr + alloc->size);
+			totalUsage += alloc->size;
 
-			if(alloc->checkMark != PPMEM_CHECKMARK || *checkMark != PPMEM_CHECKMARK)
-			{
-				MsgInfo(" ^^^ outranged ^^^\n");
+			if (outranged)
 				numErrors++;
+
+			if (fullStats)
+			{
+#ifdef PPMEM_EXTRA_DEBUGINFO
+				allocRecords.append({ curPtr, alloc->size, alloc->sl, alloc->id, outranged });
+#else
+				allocRecords.append({ curPtr, alloc->size, PPSourceLine::Empty(), alloc->id, outranged });
+#endif
 			}
-		}
-		else
-		{
-			uint* checkMark = (uint*)((ubyte*)curPtr + alloc->size);
 
-			if(alloc->checkMark != PPMEM_CHECKMARK || *checkMark != PPMEM_CHECKMARK)
-				numErrors++;
+#ifdef PPMEM_EXTRA_DEBUGINFO
+			SLStat_t& slStat = allocCounter[alloc->sl.data];
+			slStat.totalMem += alloc->size;
+			slStat.numAlloc++;
+#endif // PPMEM_EXTRA_DEBUGINFO
 		}
+	}
 
+	if (fullStats)
+	{
+		MsgInfo("--- currently allocated memory ---\n");
+
+		for (const AllocRecord_t& record : allocRecords)
+		{
 #ifdef PPMEM_EXTRA_DEBUGINFO
-		SLStat_t& slStat = allocCounter[alloc->sl.data];
-		slStat.totalMem += alloc->size;
-		slStat.numAlloc++;
-#endif // PPMEM_EXTRA_DEBUGINFO
+			const char* filename = sourceFileNameMap[record.sl.GetFileName()];
+			const int fileLine = record.sl.GetLine();
+			MsgInfo("alloc id=%u, src='%s:%d', ptr=%p, size=%" PRIu64 "\n", record.id, filename, fileLine, record.ptr, record.size);
+#else
+			MsgInfo("alloc id=%u, ptr=%p, size=%" PRIu64 "\n", record.id, record.ptr, record.size);
+#endif
+			if (record.outranged)
+				MsgInfo(" ^^^ outranged ^^^\n");
+		}
 	}
 
 #if !defined(PPMEM_DISABLED) && defined(PPMEM_EXTRA_DEBUGINFO)
@@ -233,10 +731,7 @@ void PPMemInfo(bool fullStats)
 			const SLStat_t& stat = allocCounter[key];
 			const PPSourceLine sl = *(PPSourceLine*)&key;
 
-			const char* filename = st.sourceFileNameMap[sl.GetFileName()];
-			const int fileLine = sl.GetLine();
-
-			MsgInfo("'%s:%d' count: %d, size: %.2f KB\n", st.sourceFileNameMap[sl.GetFileName()], sl.GetLine(), stat.numAlloc, (stat.totalMem / 1024.0f));
+			MsgInfo("'%s:%d' count: %d, size: %.2f KB\n", sourceFileNameMap[sl.GetFileName()], sl.GetLine(), stat.numAlloc, (stat.totalMem / 1024.0f));
 		}
 	}
 
@@ -246,12 +741,12 @@ void PPMemInfo(bool fullStats)
 		MsgInfo("--- allocation rate statistics ---\n");
 
 		Array<uint64> sortedList{ PPSourceLine::Empty() };
-		sortedList.resize(st.sourceCounterMap.size());
-		for (auto it = st.sourceCounterMap.begin(); !it.atEnd(); ++it)
+		sortedList.resize(sourceCounterMap.size());
+		for (auto it = sourceCounterMap.begin(); !it.atEnd(); ++it)
 			sortedList.append(it.key());
 
-		arraySort(sortedList, [&st](uint64 a, uint64 b) {
-			return (int64)st.sourceCounterMap[b].lastTime - (int64)st.sourceCounterMap[a].lastTime;
+		arraySort(sortedList, [&sourceCounterMap](uint64 a, uint64 b) {
+			return (int64)sourceCounterMap[b].lastAllocId - (int64)sourceCounterMap[a].lastAllocId;
 		});
 
 		for (int i = 0; i < sortedList.numElem(); ++i)
@@ -259,15 +754,14 @@ void PPMemInfo(bool fullStats)
 			const uint64 key = sortedList[i];
 			const PPSourceLine sl = *(PPSourceLine*)&key;
 
-			const char* filename = st.sourceFileNameMap[sl.GetFileName()];
-			const int fileLine = sl.GetLine();
-
-			MsgInfo("'%s:%d' counter: %" PRIu64 "\n", st.sourceFileNameMap[sl.GetFileName()], sl.GetLine(), st.sourceCounterMap[key].count);
+			MsgInfo("'%s:%d' counter: %" PRIu64 "\n", sourceFileNameMap[sl.GetFileName()], sl.GetLine(), sourceCounterMap[key].count);
 		}
 	}
 #endif // PPMEM_EXTRA_DEBUGINFO
 
-	MsgInfo("Total %" PRIu64 " allocactions, mem usage: %.2f MB\n", st.numAllocs, (totalUsage / 1024.0f) / 1024.0f);
+	MsgInfo("Total %" PRId64 " allocactions, mem usage: %.2f MB\n", numAllocs, (totalUsage / 1024.0f) / 1024.0f);
+	MsgInfo("Pools: %.2f MB in slabs, %d thread states\n", (st.slabMemCounter / 1024.0f) / 1024.0f, numThreadStates);
+	MsgInfo("Heap (re)allocations last frame: %d, peak %d\n", st.lastFrameAllocs, st.peakFrameAllocs);
 
 	if(numErrors > 0)
 		MsgWarning("%" PRIu64 " allocations has overflow/underflow happened in runtime. Please print full stats to console\n", numErrors);
@@ -279,7 +773,46 @@ IEXPORTS size_t	PPMemGetUsage()
 	return 0;
 #else
 	ppmem_state_t& st = PPGetState();
-	return st.allocMemCounter;
+
+	// not locked, counters of threads may be in flight
+	int64 allocMemCounter = 0;
+	const int numThreadStates = Atomic::Load(st.numThreadStates);
+	for (int i = 0; i < numThreadStates; ++i)
+		allocMemCounter += st.threadStates[i]->allocMemCounter;
+
+	return allocMemCounter;
+#endif
+}
+
+static int64 PPMemGetAllocCounter(ppmem_state_t& st)
+{
+	// not locked, counters of threads may be in flight
+	int64 allocCounter = 0;
+	const int numThreadStates = Atomic::Load(st.numThreadStates);
+	for (int i = 0; i < numThreadStates; ++i)
+		allocCounter += st.threadStates[i]->allocCounter;
+
+	return allocCounter;
+}
+
+IEXPORTS void PPMemEndFrame()
+{
+#ifndef PPMEM_DISABLED
+	ppmem_state_t& st = PPGetState();
+
+	const int64 allocCounter = PPMemGetAllocCounter(st);
+	st.lastFrameAllocs = static_cast<int>(allocCounter - st.frameStartAllocCounter);
+	st.peakFrameAllocs = max(st.peakFrameAllocs, st.lastFrameAllocs);
+	st.frameStartAllocCounter = allocCounter;
+#endif
+}
+
+IEXPORTS int PPMemGetFrameAllocCount()
+{
+#ifdef PPMEM_DISABLED
+	return 0;
+#else
+	return PPGetState().lastFrameAllocs;
 #endif
 }
 
@@ -292,28 +825,25 @@ void* PPDAlloc(size_t size, const PPSourceLine& sl)
 	return mem;
 #else
 
-	if (sl.data == 0) 
+	if (sl.data == 0)
 	{
 		void* mem = pp_internal_malloc(size);
 		ASSERT_MSG(mem, "No mem left");
 		return mem;
 	}
 
-	// alignof(ppallocinfo_t);
-	// sizeof(ppallocinfo_t);
-	// sizeof(RawItem<ppallocinfo_t, alignof(ppallocinfo_t)>);
-
 	ppmem_state_t& st = PPGetState();
+	ppthread_state_t* ts = PPMemGetThreadState(st);
+
 	// allocate more to store extra information of this
-	ppallocinfo_t* alloc = (ppallocinfo_t*)pp_internal_malloc(sizeof(ppallocinfo_t) + size + sizeof(uint) * PPMEM_EXTRA_MARKS);
-	ASSERT_MSG(alloc, "alloc: no mem left");
+	ppallocinfo_t* alloc = PPMemAllocBlock(st, ts, PPMemBlockSize(size));
 
 	// actual pointer address
 	void* actualPtr = alloc + 1;
 	{
 		alloc->sl = sl;
 		alloc->size = size;
-		alloc->id = st.allocIdCounter++;
+		alloc->id = Atomic::Increment(st.allocIdCounter);
 
 		alloc->checkMark = PPMEM_CHECKMARK;
 		uint* tailCheckMark = (uint*)((ubyte*)actualPtr + size);
@@ -321,33 +851,11 @@ void* PPDAlloc(size_t size, const PPSourceLine& sl)
 			*tailCheckMark++ = PPMEM_CHECKMARK;
 	}
 
-	// insert to linked list tail
-	{
-		CScopedMutex m(st.allocMemMutex);
-		++st.numAllocs;
-		st.allocMemCounter += alloc->size;
-
-		if (st.last != nullptr)
-			st.last->next = alloc;
-		else
-			st.first = alloc;
+	PPMemLinkAlloc(ts, alloc, sl);
 
-		alloc->prev = st.last;
-		alloc->next = nullptr;
-		st.last = alloc;
-
-#ifdef PPMEM_EXTRA_DEBUGINFO
-		if (!st.sourceFileNameMap.count(sl.GetFileName()))
-			st.sourceFileNameMap[sl.GetFileName()] = strdup(sl.GetFileName());
-
-		ppsrc_counter_t& cnt = st.sourceCounterMap[sl.data];
-		++cnt.count;
-		cnt.lastTime = st.timer.GetTimeMS();
-#endif
-	}
-
-	if( ppmem_break_on_alloc.GetInt() != -1)
-		ASSERT_MSG(alloc->id == (uint)ppmem_break_on_alloc.GetInt(), "PPDAlloc: Break on allocation id=%d", alloc->id);
+	// ids start from 1 as cvar reads 0 until it is constructed
+	if (ppmem_break_on_alloc.GetInt() > 0 && alloc->id == (uint)ppmem_break_on_alloc.GetInt())
+		ASSERT_FAIL("PPDAlloc: Break on allocation id=%d", alloc->id);
 
 	return actualPtr;
 #endif // PPMEM_DISABLED
@@ -358,8 +866,20 @@ static int PPMemCmpTailCheckmarks(const ubyte* x)
 	const uint checkmark = PPMEM_CHECKMARK;
 	const ubyte* y = (ubyte*)&checkmark;
 
+	// count bytes only when something is overwritten
+	uint wordDiff = 0;
+	for (size_t i = 0; i < PPMEM_EXTRA_MARKS; i++)
+	{
+		uint mark;
+		memcpy(&mark, x + i * sizeof(uint), sizeof(uint));
+		wordDiff |= mark ^ checkmark;
+	}
+
+	if (!wordDiff)
+		return 0;
+
 	int diff = 0;
-	for (size_t i = 0; i < PPMEM_EXTRA_MARKS * sizeof(uint); i++) 
+	for (size_t i = 0; i < PPMEM_EXTRA_MARKS * sizeof(uint); i++)
 		diff += (x[i] != y[i & 3]);
 
 	return diff;
@@ -374,14 +894,20 @@ void* PPDReAlloc( void* ptr, size_t size, const PPSourceLine& sl )
 	ASSERT_MSG(mem, "No mem left");
 	return mem;
 #else
-	ppmem_state_t& st = PPGetState();
+	if (ptr == nullptr)
+		return PPDAlloc(size, sl);
 
+	// untracked memory comes from PPDAlloc with empty source line, it has no check mark
 	ppallocinfo_t* r_alloc = (ppallocinfo_t*)ptr - 1;
-	if (ptr == nullptr || r_alloc->checkMark != PPMEM_CHECKMARK)
+	if (r_alloc->checkMark != PPMEM_CHECKMARK)
 	{
-		return PPDAlloc(size, sl);
+		void* mem = realloc(ptr, size);
+		ASSERT_MSG(mem, "No mem left");
+		return mem;
 	}
 
+	ppmem_state_t& st = PPGetState();
+
 	{
 		// actual pointer address
 		void* actualPtr = r_alloc + 1;
@@ -392,25 +918,31 @@ void* PPDReAlloc( void* ptr, size_t size, const PPSourceLine& sl )
 		ASSERT_MSG(diff == 0, "buffer overflow by %d bytes of %s:%d, investigate with ASAN", diff, r_alloc->sl.GetFileName(), r_alloc->sl.GetLine());
 	}
 
+	ppthread_state_t* ts = PPMemGetThreadState(st);
+
 	// remove from linked list first
 	// as realloc might change the pointer
-	{
-		CScopedMutex m(st.allocMemMutex);
-		st.allocMemCounter -= r_alloc->size;
+	PPMemUnlinkAlloc(st, r_alloc);
 
-		if (r_alloc->prev == nullptr)
-			st.first = r_alloc->next;
-		else
-			r_alloc->prev->next = r_alloc->next;
+	const size_t blockSize = PPMemBlockSize(size);
+	const ushort sizeClass = PPMemSizeClass(blockSize);
 
-		if (r_alloc->next == nullptr)
-			st.last = r_alloc->prev;
-		else
-			r_alloc->next->prev = r_alloc->prev;
+	ppallocinfo_t* alloc = r_alloc;
+	if (sizeClass == PPMEM_SIZE_CLASS_NONE && r_alloc->sizeClass == PPMEM_SIZE_CLASS_NONE)
+	{
+		alloc = (ppallocinfo_t*)realloc((void*)r_alloc, blockSize);
+		ASSERT_MSG(alloc, "realloc: no mem left!");
 	}
+	else if (sizeClass != r_alloc->sizeClass)
+	{
+		// move to block of other size class
+		alloc = PPMemAllocBlock(st, ts, blockSize);
+		memcpy((void*)alloc, (void*)r_alloc, sizeof(ppallocinfo_t) + min(size, r_alloc->size));
+		alloc->sizeClass = sizeClass;
 
-	ppallocinfo_t* alloc = (ppallocinfo_t*)realloc((void*)r_alloc, sizeof(ppallocinfo_t) + size + sizeof(uint) * PPMEM_EXTRA_MARKS);
-	ASSERT_MSG(alloc, "realloc: no mem left!");
+		r_alloc->checkMark = PPMEM_CHECKMARK_FREED;
+		PPMemFreeBlock(st, ts, r_alloc);
+	}
 
 	// actual pointer address
 	void* actualPtr = alloc + 1;
@@ -421,26 +953,8 @@ void* PPDReAlloc( void* ptr, size_t size, const PPSourceLine& sl )
 			*tailCheckMark++ = PPMEM_CHECKMARK;
 	}
 
-	// insert to linked list tail
-	{
-		CScopedMutex m(st.allocMemMutex);
-		st.allocMemCounter += alloc->size;
-
-		if (st.last != nullptr)
-			st.last->next = alloc;
-		else
-			st.first = alloc;
-
-		alloc->prev = st.last;
-		alloc->next = nullptr;
-		st.last = alloc;
-
-#ifdef PPMEM_EXTRA_DEBUGINFO
-		ppsrc_counter_t& cnt = st.sourceCounterMap[sl.data];
-		++cnt.count;
-		cnt.lastTime = st.timer.GetTimeMS();
-#endif
-	}
+	// insert to linked list tail, tracked memory stays tracked with empty source line
+	PPMemLinkAlloc(ts, alloc, sl.data ? sl : alloc->sl);
 
 	return actualPtr;
 #endif // PPMEM_DISABLED
@@ -449,8 +963,6 @@ void* PPDReAlloc( void* ptr, size_t size, const PPSourceLine& sl )
 IEXPORTS void PPDCheck(void* ptr)
 {
 #ifndef PPMEM_DISABLED
-	ppmem_state_t& st = PPGetState();
-
 	ppallocinfo_t* alloc = (ppallocinfo_t*)ptr - 1;
 	if (ptr == nullptr || alloc->checkMark != PPMEM_CHECKMARK)
 		return;
@@ -503,23 +1015,10 @@ void PPFree(void* ptr)
 			*tailCheckMark++ = PPMEM_CHECKMARK_FREED;
 	}
 
-	// remove from linked list
-	{
-		CScopedMutex m(st.allocMemMutex);
-		--st.numAllocs;
-		st.allocMemCounter -= alloc->size;
-
-		if (alloc->prev == nullptr)
-			st.first = alloc->next;
-		else
-			alloc->prev->next = alloc->next;
-
-		if (alloc->next == nullptr)
-			st.last = alloc->prev;
-		else
-			alloc->next->prev = alloc->prev;
-	}
+	// remove from linked list of allocating thread
+	PPMemUnlinkAlloc(st, alloc);
 
-	free((void*)alloc);
+	// block goes to cache of freeing thread
+	PPMemFreeBlock(st, PPMemGetThreadState(st), alloc);
 #endif // PPMEM_DISABLED
 }
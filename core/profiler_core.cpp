@@ -15,6 +15,61 @@
 
 #include "core/ConCommand.h"
 #include "core/ConVar.h"
+#include "core/IFileSystem.h"
+#include "profiler_trace.h"
+
+DECLARE_CVAR(ptrace_file, "ptrace_eq2.eqtrace", "Performance trace file name", CV_ARCHIVE);
+
+DECLARE_CMD(ptrace_convert, "Converts performance trace to Chrome trace JSON. Usage: ptrace_convert [trace file] [json file]", 0)
+{
+	const EqString traceFileName = CMD_ARGC > 0 ? EqString(CMD_ARGV(0)) : EqString(ptrace_file.GetString());
+	const EqString jsonFileName = CMD_ARGC > 1 ? EqString(CMD_ARGV(1)) : fnmPathStripExt(traceFileName) + ".json";
+
+	IFilePtr traceFile = g_fileSystem->Open(traceFileName, "rb", SP_ROOT);
+	if(!traceFile)
+	{
+		MsgError("ptrace_convert: can't open %s\n", traceFileName.ToCString());
+		return;
+	}
+
+	IFilePtr jsonFile = g_fileSystem->Open(jsonFileName, "wb", SP_ROOT);
+	if(!jsonFile)
+	{
+		MsgError("ptrace_convert: can't open %s for writing\n", jsonFileName.ToCString());
+		return;
+	}
+
+	if(ProfConvertTraceToJSON(traceFile, jsonFile))
+		Msg("ptrace_convert: written %s\n", jsonFileName.ToCString());
+}
+
+DECLARE_CMD(ptrace_start, "Performance trace start", 0)
+{
+	if(ProfIsTracing())
+		return;
+
+	IFilePtr file = g_fileSystem->Open(ptrace_file.GetString(), "wb", SP_ROOT);
+	if(!file)
+	{
+		MsgError("ptrace_start: can't open %s for writing\n", ptrace_file.GetString());
+		return;
+	}
+
+	if(!ProfStartTrace(file))
+		return;
+
+	Msg("----- PERF TRACE START -----\n");
+	Msg("output file: %s\n", ptrace_file.GetString());
+}
+
+DECLARE_CMD(ptrace_stop, "Performance trace stop", 0)
+{
+	if(!ProfIsTracing())
+		return;
+
+	ProfStopTrace();
+	Msg("----- PERF TRACE COMPLETED -----\n");
+}
 
 #ifdef _WIN32
 
@@ -71,40 +126,6 @@ static marker_series* GetTLSMarkerSeries()
 	return newSeries;
 }
 
-#else
-
-//#include <sys/syscall.h>
-#include <unistd.h>
-#include "profiler_json.h"
-
-static thread_local Array<CVTraceEvent>* tlsCV_events = nullptr;
-
-static uint64 GetPerfClock()
-{
-	timespec ts;
-	clock_gettime( CLOCK_MONOTONIC_RAW, &ts );
-	return static_cast<uint64>(ts.tv_sec) * 1000000ULL + static_cast<uint64>(ts.tv_nsec) / 1000ULL;
-}
-
-static uintptr_t GetPerfCurrentThreadId()
-{
-	return gettid(); //syscall(SYS_gettid);
-}
-
-static EqCVTracerJSON s_jsonTracer;
-static bool s_startTrace = false;
-
-DECLARE_CVAR(ptrace_file, "ptrace_eq2.json", "Performance trace file name", CV_ARCHIVE);
-DECLARE_CMD(ptrace_start, "Performance trace start", 0)
-{
-	s_startTrace = true;
-}
-
-DECLARE_CMD(ptrace_stop, "Performance trace start", 0)
-{
-	s_startTrace = false;
-}
-
 #endif // _WIN32
 
 IEXPORTS void ProfAddMarker(const char* text)
@@ -119,56 +140,26 @@ IEXPORTS void ProfAddMarker(const char* text)
 #endif // _WIN32
 }
 
+// platform marker and trace scope ids are packed into event id
+static constexpr const int PROF_MARKER_TRACE_ID_BITS = 8;
+static_assert(PROF_TRACE_MAX_DEPTH < (1 << PROF_MARKER_TRACE_ID_BITS), "trace scope id doesn't fit event id");
+
 IEXPORTS int ProfBeginMarker(const char* text)
 {
+	int markerId = 0;
 #ifdef _WIN32
 	marker_series* series = GetTLSMarkerSeries();
 
-	int eventId = tlsCV_events->pushedEvents.numElem();
+	markerId = tlsCV_events->pushedEvents.numElem();
 	cvSpanHolder& spanHld = tlsCV_events->pushedEvents.append();
 	EqWString wText;
 	AnsiUnicodeConverter(wText, text);
 	new(spanHld.data) span(*series, normal_importance, wText.ToCString());
-
-	return eventId;
-#else
-	if(!s_jsonTracer.IsCapturing())
-	{
-		if(s_startTrace)
-		{
-			s_jsonTracer.Start(ptrace_file.GetString());
-		}
-		else
-		{
-			if(tlsCV_events)
-				tlsCV_events->clear(true);
-			return -1;
-		}
-	}
-	else if(!s_startTrace)
-	{
-		s_jsonTracer.Stop();
-		return -1;
-	}
-
-	if(!tlsCV_events)
-		tlsCV_events = PPNew Array<CVTraceEvent>(PP_SL);
-
-	int eventId = tlsCV_events->numElem();
-
-	CVTraceEvent& evt = tlsCV_events->append();
-	evt.name = text;
-	evt.pid = 1000;
-	evt.threadId = GetPerfCurrentThreadId();
-	evt.timeStamp = GetPerfClock();
-	evt.type = EVT_DURATION_BEGIN;
-
-	// need to ensure that events are strictly monotonic per thread
-	if(tlsCV_events->numElem() && tlsCV_events->back().timeStamp >= evt.timeStamp)
-		evt.timeStamp = tlsCV_events->back().timeStamp + 1;
-
-	return eventId;
 #endif // _WIN32
+
+	// -1 when not tracing is stored as 0
+	const int traceId = ProfTraceBegin(text);
+	return (markerId << PROF_MARKER_TRACE_ID_BITS) | (traceId + 1);
 }
 
 IEXPORTS void ProfEndMarker(int eventId)
@@ -176,41 +167,22 @@ IEXPORTS void ProfEndMarker(int eventId)
 	if (eventId < 0)
 		return;
 
+	const int traceId = (eventId & ((1 << PROF_MARKER_TRACE_ID_BITS) - 1)) - 1;
+	if (traceId >= 0)
+		ProfTraceEnd(traceId);
+
 #ifdef _WIN32
-	ASSERT(tlsCV_events->pushedEvents.numElem()-1 == eventId);
+	const int markerId = eventId >> PROF_MARKER_TRACE_ID_BITS;
+	ASSERT(tlsCV_events->pushedEvents.numElem()-1 == markerId);
 	tlsCV_events->pushedEvents.back().GetSpan()->~span();
 	tlsCV_events->pushedEvents.popBack();
-#else
-
-	if(!s_jsonTracer.IsCapturing())
-	{
-		if(tlsCV_events)
-			tlsCV_events->clear(true);
-		return;
-	}
-
-	ASSERT(tlsCV_events->numElem()-1 == eventId);
-
-	const CVTraceEvent startEvt = tlsCV_events->popBack();
-	ASSERT_MSG(startEvt.type == EVT_DURATION_BEGIN, "profiler begin event type is invalid");
-
-	const int64 duration = max<int64>(static_cast<int64>(GetPerfClock()) - startEvt.timeStamp, 1);
-
-	CVTraceEvent writeEvt;
-	writeEvt.id = eventId;
-	writeEvt.name = startEvt.name;
-	writeEvt.threadId = startEvt.threadId;
-	writeEvt.pid = startEvt.pid;
-	writeEvt.timeStamp = startEvt.timeStamp;
-	writeEvt.duration = duration;
-	writeEvt.type = EVT_DURATION_BEGIN_END;
-
-	s_jsonTracer.WriteEvent(writeEvt);
 #endif // _WIN32
 }
 
 IEXPORTS void ProfReleaseCurrentThreadMarkers()
 {
+	ProfTraceReleaseThread();
+
 #ifdef _WIN32
 	if (!tlsCV_events)
 		return;
@@ -218,7 +190,5 @@ IEXPORTS void ProfReleaseCurrentThreadMarkers()
 	ASSERT_MSG(tlsCV_events->pushedEvents.numElem() == 0, "Still in performance measure");
 	delete tlsCV_events;
 	tlsCV_events = nullptr;
-#else
-
 #endif
 }
\ No newline at end of file
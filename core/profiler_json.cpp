@@ -1,220 +1,148 @@
 //////////////////////////////////////////////////////////////////////////////////
 // Copyright (C) Inspiration Byte
-// 2009-2022
+// 2009-2024
 //////////////////////////////////////////////////////////////////////////////////
-// Description: Core profiling utilities
+// Description: Binary performance trace to Chrome trace JSON converter
 //////////////////////////////////////////////////////////////////////////////////
 
 #include "core/core_common.h"
-#include "core/IFileSystem.h"
-#include "core/IEqParallelJobs.h"
+#include "profiler_trace.h"
 
-#include "profiler_json.h"
+static constexpr const int PROF_JSON_PID = 1000;
+static constexpr const int PROF_JSON_READ_RECORDS = 1024;
 
-static Threading::CEqSignal s_jsonTracerWriteCompleted;
-static Threading::CEqMutex s_jsonTracerMutex;
-using namespace Threading;
-
-static constexpr const int bufferThreshold = 1000;
-
-class EqCVTracerDumperJob : public IParallelJob
+static void ProfJSONEscapeString(EqString& out, const char* str)
 {
-public:
-	EqCVTracerDumperJob(EqCVTracerJSON& tracer, IVirtualStreamPtr outFile) 
-		: IParallelJob("CVTracerDumperJob")
-		, m_tracer(tracer)
-		, m_outFile(outFile)
-	{}
-	void Execute() override;
-
-	Array<CVTraceEvent> m_writeBuffer{ PP_SL };
-	EqCVTracerJSON&		m_tracer;
-	IVirtualStreamPtr	m_outFile;
-	bool				m_initialStart{ false };
-};
-
-void EqCVTracerDumperJob::Execute()
-{
-	s_jsonTracerWriteCompleted.Wait();	// wait for another if it was started already
-
-	// start new one
-	s_jsonTracerWriteCompleted.Clear();
-
-	bool initialStart = m_initialStart;
-
-	EqString str;
-	for(CVTraceEvent& traceEvt : m_writeBuffer)
+	out.Empty();
+	for (const char* c = str; *c; ++c)
 	{
-		if(!initialStart)
-			m_outFile->Write(m_tracer.m_batchPrefix.GetData(), 1, m_tracer.m_batchPrefix.Length());
-		else
-			initialStart = false;
-
-		m_tracer.EventToString(str, traceEvt);
-		m_outFile->Write(str.GetData(), 1, str.Length());
+		if (*c == '"' || *c == '\\')
+			out.Append('\\');
+		else if (static_cast<ubyte>(*c) < 0x20)
+			continue;
+		out.Append(*c);
 	}
+}
 
-	// complete write
-	s_jsonTracerWriteCompleted.Raise();
+static void ProfJSONWriteSeparator(IVirtualStream* jsonStream, bool& firstEvent)
+{
+	if (!firstEvent)
+		jsonStream->Write(",", 1, 1);
+	firstEvent = false;
 }
 
-bool EqCVTracerJSON::Start(const char* fileName)
+static bool ProfJSONReadString(IVirtualStream* traceStream, EqString& out, int length)
 {
-	if(Atomic::Load(m_captureInProgress) != 0)
+	if (length < 0 || length > 4096)
 		return false;
 
-	CScopedMutex m(s_jsonTracerMutex);
-
-    IFilePtr file = g_fileSystem->Open(fileName, "wb", SP_ROOT);
-
-	if(!file)
+	char* str = static_cast<char*>(stackalloc(length + 1));
+	if (length > 0 && traceStream->Read(str, length, 1) != length)
 		return false;
 
-	Msg("----- PERF TRACE START -----\n");
-	Msg("output file: %s\n", fileName);
-
-	{
-		file->Print("{\"traceEvents\":[");
-		s_jsonTracerWriteCompleted.Raise();
-
-		m_outFile = file;
-		m_batchPrefix.Empty();
-		m_threadMaskData.clear(true);
-		m_tmpBuffer.reserve(bufferThreshold);
-
-		Atomic::Store(m_captureInProgress, 1);
-	}
-
+	str[length] = 0;
+	ProfJSONEscapeString(out, str);
 	return true;
 }
 
-void EqCVTracerJSON::Stop()
+IEXPORTS bool ProfConvertTraceToJSON(IVirtualStream* traceStream, IVirtualStream* jsonStream)
 {
-	if(Atomic::Load(m_captureInProgress) == 0)
-		return;
-	Atomic::Store(m_captureInProgress, 0);
-
-	CScopedMutex m(s_jsonTracerMutex);
-	FlushTempBuffer();
-
-	s_jsonTracerWriteCompleted.Wait();
-	m_outFile->Print("]}");
-    m_outFile = nullptr;
-
-    m_batchPrefix.Empty();
-    m_threadMaskData.clear(true);
-	m_eventId = 0;
-
-    Msg("----- PERF TRACE COMPLETED -----\n");
-}
-
-void EqCVTracerJSON::WriteEvent(const CVTraceEvent& evt)
-{
-	if(Atomic::Load(m_captureInProgress) == 0)
-		return;
+	const VSSize traceSize = traceStream->GetSize();
 
+	ProfTraceHeader hdr;
+	if (traceStream->Read(&hdr, 1, sizeof(hdr)) != 1 || hdr.ident != PROF_TRACE_IDENT)
 	{
-		CScopedMutex m(s_jsonTracerMutex);
-		if(m_tmpBuffer.numElem() > bufferThreshold)
-			FlushTempBuffer();
-
-		m_tmpBuffer.append(evt);
-
-		if(m_threadMaskData.contains(evt.threadId))
-			return;
-		m_threadMaskData.insert(evt.threadId);
+		MsgError("%s is not a performance trace\n", traceStream->GetName());
+		return false;
 	}
 
-	char threadName[64];
-	Threading::GetThreadName(evt.threadId, threadName, sizeof(threadName));
-	if(*threadName == 0)
-		return;
-
-	// need to put thread name event
+	if (hdr.version != PROF_TRACE_VERSION)
 	{
-		CScopedMutex m(s_jsonTracerMutex);
-		CVTraceEvent& metaDataEvt = m_tmpBuffer.append();
-		
-		metaDataEvt.type = EVT_THREAD_NAME;
-		metaDataEvt.pid = evt.pid;
-		metaDataEvt.threadId = evt.threadId;
-		metaDataEvt.name = threadName;
+		MsgError("%s has trace version %d, expected %d\n", traceStream->GetName(), hdr.version, PROF_TRACE_VERSION);
+		return false;
 	}
-}
 
-uint64 EqCVTracerJSON::AllocEventId()
-{
-	return Atomic::Increment(m_eventId);
-}
+	// microseconds with nanosecond fraction
+	const double ticksToUs = 1000000.0 / static_cast<double>(max<uint64>(hdr.ticksPerSecond, 1));
 
-void EqCVTracerJSON::FlushTempBuffer()
-{
-	if(Atomic::Load(m_captureInProgress) == 0)
-		return;
+	Map<uint32, EqString> names{ PP_SL };
+	EqString str;
+	bool firstEvent = true;
+	int numEvents = 0;
+
+	ProfTraceRecord records[PROF_JSON_READ_RECORDS];
 
-	EqCVTracerDumperJob* dumpJob = PPNew EqCVTracerDumperJob(*this, m_outFile);
-	dumpJob->DeleteOnFinish();
+	jsonStream->Print("{\"traceEvents\":[\n");
 
-	// swap write buffer and start dump job
+	while (traceStream->Tell() + static_cast<VSSize>(sizeof(ProfTraceChunkHdr) + sizeof(uint32)) <= traceSize)
 	{
-		CScopedMutex m(s_jsonTracerMutex);
-		dumpJob->m_writeBuffer.swap(m_tmpBuffer);
+		ProfTraceChunkHdr chunk;
+		uint32 id;
+		traceStream->Read(&chunk, 1, sizeof(chunk));
+		traceStream->Read(&id, 1, sizeof(id));
 
-		if(m_batchPrefix.Length() == 0)
+		const int dataSize = chunk.size - static_cast<int>(sizeof(id));
+		if (dataSize < 0 || traceStream->Tell() + dataSize > traceSize)
 		{
-			dumpJob->m_initialStart = true;
-			m_batchPrefix = ",";
+			MsgWarning("%s is truncated\n", traceStream->GetName());
+			break;
 		}
-		m_tmpBuffer.reserve(bufferThreshold);
-	}
 
-	g_parallelJobs->GetJobMng()->InitStartJob(dumpJob);
-}
-
-void EqCVTracerJSON::EventToString(EqString& out, const CVTraceEvent& evt)
-{
-	EqString evtName = evt.name;
-	EqString evtArgs;
-	char ph;
-	switch(evt.type)
-	{
-		case EVT_DURATION_BEGIN:
-			ph = 'B';
-			break;
-		case EVT_DURATION_END:
-			ph = 'E';
-			break;
-		case EVT_DURATION_BEGIN_END:
-			ph = 'X';
-			break;
-		case EVT_THREAD_NAME:
-			evtArgs = EqString::Format("\"name\": \"%s\"", evt.name.ToCString());
-			evtName = "thread_name";
-			ph = 'M';
-			break;
-		default:
-			ASSERT_FAIL("incorrect event type %d", evt.type);
+		switch (chunk.type)
+		{
+			case PROF_TRACE_CHUNK_NAME:
+			{
+				if (!ProfJSONReadString(traceStream, str, dataSize))
+					return false;
+				names.insert(id, str);
+				break;
+			}
+			case PROF_TRACE_CHUNK_THREAD:
+			{
+				if (!ProfJSONReadString(traceStream, str, dataSize))
+					return false;
+
+				if (str.Length() == 0)
+					break;
+
+				ProfJSONWriteSeparator(jsonStream, firstEvent);
+				jsonStream->Print("{\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":\"%s\"}}\n",
+					PROF_JSON_PID, id, str.ToCString());
+				break;
+			}
+			case PROF_TRACE_CHUNK_EVENTS:
+			{
+				int numRecords = dataSize / sizeof(ProfTraceRecord);
+				while (numRecords > 0)
+				{
+					const int numRead = min(numRecords, PROF_JSON_READ_RECORDS);
+					traceStream->Read(records, numRead, sizeof(ProfTraceRecord));
+					numRecords -= numRead;
+
+					for (int i = 0; i < numRead; ++i)
+					{
+						const ProfTraceRecord& record = records[i];
+						auto nameIt = names.find(record.nameId);
+
+						const double timeStamp = static_cast<double>(static_cast<int64>(record.startTicks - hdr.startTicks)) * ticksToUs;
+						const double duration = static_cast<double>(record.durationTicks) * ticksToUs;
+
+						ProfJSONWriteSeparator(jsonStream, firstEvent);
+						jsonStream->Print("{\"cat\":\"e2\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"name\":\"%s\"}\n",
+							PROF_JSON_PID, id, timeStamp, duration, nameIt.atEnd() ? "(unknown)" : (*nameIt).ToCString());
+					}
+					numEvents += numRead;
+				}
+				break;
+			}
+			default:
+				traceStream->Seek(dataSize, VS_SEEK_CUR);
+				break;
+		}
 	}
 
-	out = EqString::Format(
-		"{"
-		"\"cat\":\"e2\","
-		"\"ph\":\"%c\","
-		"\"id\":\"%" PRIu64 "\","
-		"\"pid\":%" PRIu64 "," 
-		"\"tid\":%" PRIu64 ","
-		"\"ts\":%" PRIu64 ","
-		"\"dur\":%" PRId64 ","
-		"\"name\":\"%s\","
-		"\"args\":{%s}"
-		"}\n", 
-		ph, 
-		evt.id, 
-		evt.pid, 
-		evt.threadId,
-		evt.timeStamp, 
-		(evt.type == EVT_DURATION_BEGIN_END) ? evt.duration : 0,
-		evtName.ToCString(), 
-		evtArgs.ToCString()
-	);
-}
\ No newline at end of file
+	jsonStream->Print("]}\n");
+
+	DevMsg(DEVMSG_CORE, "Converted %d trace events of %s\n", numEvents, traceStream->GetName());
+	return true;
+}
@@ -0,0 +1,513 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2024
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Always-on frame statistics aggregated from PROF_EVENT scopes
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "core/core_common.h"
+#include "core/ConCommand.h"
+#include "core/ConVar.h"
+#include "core/IFileSystem.h"
+#include "ds/sort.h"
+
+#include "profiler_trace.h"
+
+using namespace Threading;
+
+static constexpr const int PROF_STATS_WINDOW			= 128;		// frames in rolling window
+static constexpr const int PROF_STATS_MAX_SCOPES		= 4096;		// dynamic scope names should not grow it forever
+static constexpr const int PROF_STATS_MAX_SPIKE_FRAMES	= 64;
+
+struct ProfScopeStatsData
+{
+	uint32	nameId{ 0 };
+	uint32	threadId{ 0 };
+	int		depth{ 0 };
+	int64	count{ 0 };
+	uint64	totalTicks{ 0 };
+	uint64	minTicks{ 0 };
+	uint64	maxTicks{ 0 };
+
+	uint64	frameTicks{ 0 };
+	int		frameCount{ 0 };
+	uint64	lastFrameTicks{ 0 };
+	int		lastFrameCount{ 0 };
+};
+
+struct ProfThreadStatsData
+{
+	uint32	threadId{ 0 };
+	char	name[32]{ 0 };
+	uint64	frameBusyTicks{ 0 };
+	uint64	busyTicks[PROF_STATS_WINDOW]{ 0 };	// same indexing as frame window
+};
+
+struct ProfSpikeRecord
+{
+	uint32			threadId;
+	ProfTraceRecord	record;
+};
+
+static CEqMutex						s_profStatsMutex;
+static Array<ProfScopeStatsData>	s_profScopeStats{ PP_SL };
+static Map<uint64, int>				s_profScopeStatsIndex{ PP_SL };
+static Array<ProfThreadStatsData>	s_profThreadStats{ PP_SL };
+
+static uint64						s_profFrameTicks[PROF_STATS_WINDOW]{ 0 };
+static int64						s_profFrameIndex = 0;
+static uint64						s_profFrameStartTicks = 0;
+static int							s_profNumSpikes = 0;
+static float						s_profLastSpikeMs = 0.0f;
+static bool							s_profStatsInitialized = false;
+static bool							s_profStatsEnabled = false;
+
+// events of last frames, current frame is at the end
+static float						s_profSpikeThresholdMs = 0.0f;
+static int							s_profSpikeNumFrames = 0;
+static Array<ProfSpikeRecord>		s_profSpikeEvents{ PP_SL };
+static Array<int>					s_profSpikeFrameSizes{ PP_SL };
+static Array<ProfSpikeRecord>		s_profLastSpikeEvents{ PP_SL };
+
+static void prof_stats_changed(ConVar* pVar, char const* pszOldValue)
+{
+	ProfSetStatsEnabled(pVar->GetBool());
+}
+
+static void prof_spike_changed(ConVar* pVar, char const* pszOldValue);
+
+DECLARE_CVAR_CHANGE(prof_stats, "1", prof_stats_changed, "Aggregate PROF_EVENT scopes into frame statistics", CV_ARCHIVE);
+DECLARE_CVAR_CHANGE(prof_spike_ms, "0", prof_spike_changed, "Frame time which triggers spike capture, 0 disables", CV_ARCHIVE);
+DECLARE_CVAR_CHANGE(prof_spike_frames, "8", prof_spike_changed, "Number of last frames captured on spike", CV_ARCHIVE);
+
+static void prof_spike_changed(ConVar* pVar, char const* pszOldValue)
+{
+	ProfSetSpikeCapture(prof_spike_ms.GetFloat(), prof_spike_frames.GetInt());
+}
+
+static float ProfTicksToMs(uint64 ticks)
+{
+	return static_cast<float>(static_cast<double>(ticks) * 1000.0 / static_cast<double>(ProfTraceGetTicksPerSecond()));
+}
+
+static int ProfHistogramBucket(float ms)
+{
+	for (int i = 0; i < PROF_STATS_HISTOGRAM_BUCKETS - 1; ++i)
+	{
+		if (ms < PROF_STATS_HISTOGRAM_BOUNDS[i])
+			return i;
+	}
+	return PROF_STATS_HISTOGRAM_BUCKETS - 1;
+}
+
+static ProfThreadStatsData& ProfGetThreadStatsData(uint32 threadId)
+{
+	for (ProfThreadStatsData& threadStats : s_profThreadStats)
+	{
+		if (threadStats.threadId == threadId)
+			return threadStats;
+	}
+
+	ProfThreadStatsData& threadStats = s_profThreadStats.append();
+	threadStats.threadId = threadId;
+	GetThreadName(threadId, threadStats.name, sizeof(threadStats.name));
+	return threadStats;
+}
+
+void ProfStatsAddRecords(uint32 threadId, const ProfTraceRecord* records, int count)
+{
+	CScopedMutex m(s_profStatsMutex);
+
+	ProfThreadStatsData& threadStats = ProfGetThreadStatsData(threadId);
+	ProfScopeStatsData* scopeStats = nullptr;
+
+	for (int i = 0; i < count; ++i)
+	{
+		const ProfTraceRecord& record = records[i];
+		const uint64 key = (static_cast<uint64>(threadId) << 32) | record.nameId;
+
+		// scopes usually repeat
+		if (!scopeStats || scopeStats->nameId != record.nameId)
+		{
+			auto it = s_profScopeStatsIndex.find(key);
+			if (it.atEnd())
+			{
+				if (s_profScopeStats.numElem() >= PROF_STATS_MAX_SCOPES)
+				{
+					scopeStats = nullptr;
+					continue;
+				}
+
+				s_profScopeStatsIndex.insert(key, s_profScopeStats.numElem());
+				scopeStats = &s_profScopeStats.append();
+				scopeStats->nameId = record.nameId;
+				scopeStats->threadId = threadId;
+				scopeStats->depth = record.depth;
+				scopeStats->minTicks = record.durationTicks;
+			}
+			else
+				scopeStats = &s_profScopeStats[*it];
+		}
+
+		const uint64 durationTicks = record.durationTicks;
+		++scopeStats->count;
+		++scopeStats->frameCount;
+		scopeStats->totalTicks += durationTicks;
+		scopeStats->frameTicks += durationTicks;
+		scopeStats->minTicks = min(scopeStats->minTicks, durationTicks);
+		scopeStats->maxTicks = max(scopeStats->maxTicks, durationTicks);
+		scopeStats->depth = min<int>(scopeStats->depth, record.depth);
+
+		if (record.depth == 0)
+			threadStats.frameBusyTicks += durationTicks;
+	}
+
+	if (s_profSpikeNumFrames > 0)
+	{
+		const int firstIdx = s_profSpikeEvents.numElem();
+		s_profSpikeEvents.setNum(firstIdx + count);
+		for (int i = 0; i < count; ++i)
+		{
+			s_profSpikeEvents[firstIdx + i].threadId = threadId;
+			s_profSpikeEvents[firstIdx + i].record = records[i];
+		}
+	}
+}
+
+void ProfStatsShutdown()
+{
+	ProfSetStatsEnabled(false);
+
+	CScopedMutex m(s_profStatsMutex);
+	s_profScopeStats.clear(true);
+	s_profScopeStatsIndex.clear(true);
+	s_profThreadStats.clear(true);
+	s_profSpikeEvents.clear(true);
+	s_profSpikeFrameSizes.clear(true);
+	s_profLastSpikeEvents.clear(true);
+}
+
+IEXPORTS void ProfSetStatsEnabled(bool enable)
+{
+	s_profStatsInitialized = true;
+	ProfTraceSetStatsEnabled(enable);
+
+	CScopedMutex m(s_profStatsMutex);
+	s_profStatsEnabled = enable;
+	s_profFrameStartTicks = 0;
+}
+
+IEXPORTS void ProfSetSpikeCapture(float thresholdMs, int numFrames)
+{
+	CScopedMutex m(s_profStatsMutex);
+
+	s_profSpikeThresholdMs = thresholdMs;
+	s_profSpikeNumFrames = thresholdMs > 0.0f ? clamp(numFrames, 1, PROF_STATS_MAX_SPIKE_FRAMES) : 0;
+
+	if (!s_profSpikeNumFrames)
+	{
+		s_profSpikeEvents.clear(true);
+		s_profSpikeFrameSizes.clear(true);
+	}
+}
+
+IEXPORTS void ProfEndFrame()
+{
+	if (!s_profStatsInitialized)
+		ProfSetStatsEnabled(prof_stats.GetBool());
+
+	if (!s_profStatsEnabled)
+		return;
+
+	ProfTraceDrain();
+
+	const uint64 nowTicks = ProfTraceGetTicks();
+
+	CScopedMutex m(s_profStatsMutex);
+
+	if (!s_profFrameStartTicks)
+	{
+		// first frame has no start
+		s_profFrameStartTicks = nowTicks;
+		s_profSpikeEvents.clear(false);
+		s_profSpikeFrameSizes.clear(false);
+		return;
+	}
+
+	const uint64 frameTicks = nowTicks - s_profFrameStartTicks;
+	s_profFrameStartTicks = nowTicks;
+
+	const int windowIdx = s_profFrameIndex % PROF_STATS_WINDOW;
+	++s_profFrameIndex;
+
+	s_profFrameTicks[windowIdx] = frameTicks;
+
+	for (ProfThreadStatsData& threadStats : s_profThreadStats)
+	{
+		threadStats.busyTicks[windowIdx] = threadStats.frameBusyTicks;
+		threadStats.frameBusyTicks = 0;
+	}
+
+	for (ProfScopeStatsData& scopeStats : s_profScopeStats)
+	{
+		scopeStats.lastFrameTicks = scopeStats.frameTicks;
+		scopeStats.lastFrameCount = scopeStats.frameCount;
+		scopeStats.frameTicks = 0;
+		scopeStats.frameCount = 0;
+	}
+
+	if (!s_profSpikeNumFrames)
+		return;
+
+	int numKeptEvents = 0;
+	for (const int frameSize : s_profSpikeFrameSizes)
+		numKeptEvents += frameSize;
+	s_profSpikeFrameSizes.append(s_profSpikeEvents.numElem() - numKeptEvents);
+
+	while (s_profSpikeFrameSizes.numElem() > s_profSpikeNumFrames)
+	{
+		s_profSpikeEvents.removeRange(0, s_profSpikeFrameSizes[0]);
+		s_profSpikeFrameSizes.removeIndex(0);
+	}
+
+	const float frameMs = ProfTicksToMs(frameTicks);
+	if (frameMs > s_profSpikeThresholdMs)
+	{
+		++s_profNumSpikes;
+		s_profLastSpikeMs = frameMs;
+		s_profLastSpikeEvents.clear(false);
+		s_profLastSpikeEvents.append(s_profSpikeEvents);
+
+		MsgWarning("Frame %" PRId64 " took %.2f ms, last %d frames captured (prof_spike_save)\n", s_profFrameIndex, frameMs, s_profSpikeFrameSizes.numElem());
+	}
+}
+
+IEXPORTS void ProfGetFrameStats(ProfFrameStats& stats)
+{
+	CScopedMutex m(s_profStatsMutex);
+
+	stats = ProfFrameStats();
+	stats.frameIndex = s_profFrameIndex;
+	stats.numFrames = min<int>(s_profFrameIndex, PROF_STATS_WINDOW);
+	stats.numSpikes = s_profNumSpikes;
+	stats.lastSpikeMs = s_profLastSpikeMs;
+
+	if (!stats.numFrames)
+		return;
+
+	uint64 totalTicks = 0;
+	uint64 minTicks = UINT64_MAX;
+	uint64 maxTicks = 0;
+	for (int i = 0; i < stats.numFrames; ++i)
+	{
+		const uint64 frameTicks = s_profFrameTicks[i];
+		totalTicks += frameTicks;
+		minTicks = min(minTicks, frameTicks);
+		maxTicks = max(maxTicks, frameTicks);
+		++stats.histogram[ProfHistogramBucket(ProfTicksToMs(frameTicks))];
+	}
+
+	stats.lastFrameMs = ProfTicksToMs(s_profFrameTicks[(s_profFrameIndex - 1) % PROF_STATS_WINDOW]);
+	stats.avgFrameMs = ProfTicksToMs(totalTicks) / stats.numFrames;
+	stats.minFrameMs = ProfTicksToMs(minTicks);
+	stats.maxFrameMs = ProfTicksToMs(maxTicks);
+}
+
+IEXPORTS int ProfGetThreadStats(ProfThreadStats* stats, int maxStats)
+{
+	CScopedMutex m(s_profStatsMutex);
+
+	const int numFrames = min<int>(s_profFrameIndex, PROF_STATS_WINDOW);
+	const int lastIdx = (s_profFrameIndex + PROF_STATS_WINDOW - 1) % PROF_STATS_WINDOW;
+
+	int numStats = 0;
+	for (const ProfThreadStatsData& threadStats : s_profThreadStats)
+	{
+		if (numStats >= maxStats)
+			break;
+
+		ProfThreadStats& out = stats[numStats++];
+		out = ProfThreadStats();
+		out.threadId = threadStats.threadId;
+		strncpy(out.name, threadStats.name, sizeof(out.name) - 1);
+
+		if (!numFrames)
+			continue;
+
+		uint64 totalTicks = 0;
+		uint64 maxTicks = 0;
+		for (int i = 0; i < numFrames; ++i)
+		{
+			totalTicks += threadStats.busyTicks[i];
+			maxTicks = max(maxTicks, threadStats.busyTicks[i]);
+			++out.histogram[ProfHistogramBucket(ProfTicksToMs(threadStats.busyTicks[i]))];
+		}
+
+		out.lastFrameBusyMs = ProfTicksToMs(threadStats.busyTicks[lastIdx]);
+		out.avgBusyMs = ProfTicksToMs(totalTicks) / numFrames;
+		out.maxBusyMs = ProfTicksToMs(maxTicks);
+	}
+	return numStats;
+}
+
+IEXPORTS int ProfGetScopeStats(ProfScopeStats* stats, int maxStats)
+{
+	CScopedMutex m(s_profStatsMutex);
+
+	Array<const ProfScopeStatsData*> sorted(PP_SL);
+	sorted.reserve(s_profScopeStats.numElem());
+	for (const ProfScopeStatsData& scopeStats : s_profScopeStats)
+		sorted.append(&scopeStats);
+
+	arraySort(sorted, [](const ProfScopeStatsData* a, const ProfScopeStatsData* b) {
+		return sortCompare(b->totalTicks, a->totalTicks);
+	});
+
+	const int numStats = min(maxStats, sorted.numElem());
+	for (int i = 0; i < numStats; ++i)
+	{
+		const ProfScopeStatsData& scopeStats = *sorted[i];
+		ProfScopeStats& out = stats[i];
+
+		out.name = ProfTraceGetName(scopeStats.nameId);
+		out.threadId = scopeStats.threadId;
+		out.depth = scopeStats.depth;
+		out.count = scopeStats.count;
+		out.totalMs = ProfTicksToMs(scopeStats.totalTicks);
+		out.avgMs = scopeStats.count ? out.totalMs / scopeStats.count : 0.0f;
+		out.minMs = ProfTicksToMs(scopeStats.minTicks);
+		out.maxMs = ProfTicksToMs(scopeStats.maxTicks);
+		out.lastFrameMs = ProfTicksToMs(scopeStats.lastFrameTicks);
+		out.lastFrameCount = scopeStats.lastFrameCount;
+	}
+	return numStats;
+}
+
+IEXPORTS void ProfResetStats()
+{
+	CScopedMutex m(s_profStatsMutex);
+
+	s_profScopeStats.clear(false);
+	s_profScopeStatsIndex.clear(false);
+	s_profThreadStats.clear(false);
+	s_profSpikeEvents.clear(false);
+	s_profSpikeFrameSizes.clear(false);
+	s_profLastSpikeEvents.clear(false);
+
+	memset(s_profFrameTicks, 0, sizeof(s_profFrameTicks));
+	s_profFrameIndex = 0;
+	s_profFrameStartTicks = 0;
+	s_profNumSpikes = 0;
+	s_profLastSpikeMs = 0.0f;
+}
+
+IEXPORTS bool ProfWriteSpikeTrace(IVirtualStream* stream)
+{
+	CScopedMutex m(s_profStatsMutex);
+
+	if (!s_profLastSpikeEvents.numElem())
+		return false;
+
+	ProfTraceHeader hdr;
+	hdr.ident = PROF_TRACE_IDENT;
+	hdr.version = PROF_TRACE_VERSION;
+	hdr.startTicks = UINT64_MAX;
+	hdr.ticksPerSecond = ProfTraceGetTicksPerSecond();
+	for (const ProfSpikeRecord& spikeRecord : s_profLastSpikeEvents)
+		hdr.startTicks = min<uint64>(hdr.startTicks, spikeRecord.record.startTicks);
+
+	stream->Write(&hdr, 1, sizeof(hdr));
+
+	const int numNames = ProfTraceGetNumNames();
+	for (int i = 0; i < numNames; ++i)
+	{
+		const char* name = ProfTraceGetName(i);
+		ProfTraceWriteChunk(stream, PROF_TRACE_CHUNK_NAME, i, name, strlen(name));
+	}
+
+	for (const ProfThreadStatsData& threadStats : s_profThreadStats)
+		ProfTraceWriteChunk(stream, PROF_TRACE_CHUNK_THREAD, threadStats.threadId, threadStats.name, strlen(threadStats.name));
+
+	// records are drained per thread so runs of the same thread are long
+	Array<ProfTraceRecord> threadRecords(PP_SL);
+	for (int i = 0; i < s_profLastSpikeEvents.numElem(); )
+	{
+		const uint32 threadId = s_profLastSpikeEvents[i].threadId;
+
+		threadRecords.clear(false);
+		for (; i < s_profLastSpikeEvents.numElem() && s_profLastSpikeEvents[i].threadId == threadId; ++i)
+			threadRecords.append(s_profLastSpikeEvents[i].record);
+
+		ProfTraceWriteChunk(stream, PROF_TRACE_CHUNK_EVENTS, threadId, threadRecords.ptr(), threadRecords.numElem() * sizeof(ProfTraceRecord));
+	}
+
+	return true;
+}
+
+//-------------------------------------------------------
+
+DECLARE_CMD(prof_stats_print, "Prints frame statistics and slowest PROF_EVENT scopes. Usage: prof_stats_print [number of scopes]", 0)
+{
+	const int maxScopes = CMD_ARGC > 0 ? max(atoi(CMD_ARGV(0)), 1) : 20;
+
+	ProfFrameStats frameStats;
+	ProfGetFrameStats(frameStats);
+
+	Msg("-- frame %" PRId64 ", last %d frames: avg %.2f ms, min %.2f ms, max %.2f ms, %d spikes\n",
+		frameStats.frameIndex, frameStats.numFrames, frameStats.avgFrameMs, frameStats.minFrameMs, frameStats.maxFrameMs, frameStats.numSpikes);
+
+	EqString histogramStr;
+	for (int i = 0; i < PROF_STATS_HISTOGRAM_BUCKETS; ++i)
+	{
+		if (i < PROF_STATS_HISTOGRAM_BUCKETS - 1)
+			histogramStr.Append(EqString::Format(" <%g:%d", PROF_STATS_HISTOGRAM_BOUNDS[i], frameStats.histogram[i]));
+		else
+			histogramStr.Append(EqString::Format(" more:%d", frameStats.histogram[i]));
+	}
+	Msg("   frame time histogram (ms):%s\n", histogramStr.ToCString());
+
+	ProfThreadStats threadStats[64];
+	const int numThreads = ProfGetThreadStats(threadStats, elementsOf(threadStats));
+	for (int i = 0; i < numThreads; ++i)
+	{
+		Msg("   thread %-24s busy last %.2f ms, avg %.2f ms, max %.2f ms\n",
+			threadStats[i].name, threadStats[i].lastFrameBusyMs, threadStats[i].avgBusyMs, threadStats[i].maxBusyMs);
+	}
+
+	Array<ProfScopeStats> scopeStats(PP_SL);
+	scopeStats.setNum(maxScopes);
+	const int numScopes = ProfGetScopeStats(scopeStats.ptr(), maxScopes);
+
+	Msg("   %-40s %10s %10s %9s %9s %9s %9s\n", "scope", "count", "total ms", "avg ms", "min ms", "max ms", "frame ms");
+	for (int i = 0; i < numScopes; ++i)
+	{
+		const ProfScopeStats& scope = scopeStats[i];
+		Msg("   %-40.40s %10" PRId64 " %10.2f %9.3f %9.3f %9.3f %9.3f\n",
+			scope.name, scope.count, scope.totalMs, scope.avgMs, scope.minMs, scope.maxMs, scope.lastFrameMs);
+	}
+}
+
+DECLARE_CMD(prof_stats_reset, "Resets frame statistics", 0)
+{
+	ProfResetStats();
+}
+
+DECLARE_CMD(prof_spike_save, "Writes last captured frame spike as performance trace. Usage: prof_spike_save [file name]", 0)
+{
+	const EqString fileName = CMD_ARGC > 0 ? EqString(CMD_ARGV(0)) : EqString("ptrace_spike.eqtrace");
+
+	IFilePtr file = g_fileSystem->Open(fileName, "wb", SP_ROOT);
+	if (!file)
+	{
+		MsgError("prof_spike_save: can't open %s for writing\n", fileName.ToCString());
+		return;
+	}
+
+	if (!ProfWriteSpikeTrace(file))
+	{
+		MsgWarning("prof_spike_save: no spike was captured, set prof_spike_ms\n");
+		return;
+	}
+
+	Msg("prof_spike_save: written %s, use ptrace_convert to get JSON\n", fileName.ToCString());
+}
@@ -0,0 +1,553 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2024
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Binary performance trace with lock-free per-thread rings
+//////////////////////////////////////////////////////////////////////////////////
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#define PROF_TRACE_USE_TSC
+#endif
+#endif
+
+#include "core/core_common.h"
+#include "profiler_trace.h"
+
+using namespace Threading;
+
+static constexpr const int PROF_TRACE_MAX_THREADS		= 256;
+static constexpr const int PROF_TRACE_NAME_POOL_SIZE	= 512 * 1024;
+static constexpr const int PROF_TRACE_NAME_TABLE_SIZE	= PROF_TRACE_MAX_NAMES * 2;
+
+struct ProfTraceNameCacheEntry
+{
+	const char*	label{ nullptr };
+	int			nameId{ 0 };
+};
+
+struct ProfTraceScope
+{
+	uint64		startTicks{ 0 };
+	int			nameId{ 0 };
+};
+
+// written only by owner thread and read only by trace writer thread
+struct ProfTraceRing
+{
+	ProfTraceRecord			records[PROF_TRACE_RING_SIZE];
+	ProfTraceScope			scopes[PROF_TRACE_MAX_DEPTH];
+	ProfTraceNameCacheEntry	nameCache[PROF_TRACE_NAME_CACHE];
+	char					threadName[64]{ 0 };
+	uint32					threadId{ 0 };
+	int						depth{ 0 };
+
+	volatile uint32			head{ 0 };			// published by owner thread
+	volatile uint32			tail{ 0 };			// published by writer thread
+	uint32					cachedTail{ 0 };	// owner's copy of tail, refreshed when ring looks full
+	volatile int32			dropped{ 0 };
+
+	bool					threadNameWritten{ false };
+	bool					released{ false };
+};
+
+class CProfTraceWriterThread : public CEqThread
+{
+public:
+	int Run() override;
+};
+
+static thread_local ProfTraceRing*	tls_profTraceRing = nullptr;
+
+static volatile int32			s_profTraceCapturing = 0;
+static volatile int32			s_profTraceStatsEnabled = 0;
+static volatile int32			s_profTraceActive = 0;		// capturing or aggregating stats
+
+// rings and output, held by writer while flushing
+static CEqMutex					s_profTraceMutex;
+static ProfTraceRing*			s_profTraceRings[PROF_TRACE_MAX_THREADS]{ nullptr };
+static int						s_profTraceNumRings = 0;
+static IVirtualStreamPtr		s_profTraceStream;
+static CProfTraceWriterThread	s_profTraceWriter;
+static CEqSignal				s_profTraceWriterWake;
+static bool						s_profTraceWriterRunning = false;
+static int						s_profTraceNamesWritten = 0;
+
+// interned names are never freed so rings and writer can keep pointers
+static CEqMutex					s_profTraceNameMutex;
+static char						s_profTraceNamePool[PROF_TRACE_NAME_POOL_SIZE];
+static int						s_profTraceNamePoolUsed = 0;
+static const char*				s_profTraceNames[PROF_TRACE_MAX_NAMES]{ "(unnamed)" };
+static int						s_profTraceNameTable[PROF_TRACE_NAME_TABLE_SIZE]{ 0 };	// open addressing, 0 is empty
+static volatile int32			s_profTraceNumNames = 1;
+
+static uint64					s_profTraceTicksPerSecond = 0;
+
+#ifndef _WIN32
+static uint64 ProfTraceMonotonicNs()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64>(ts.tv_sec) * 1000000000ULL + static_cast<uint64>(ts.tv_nsec);
+}
+#endif
+
+// clock_gettime alone costs more than the rest of the scope, so TSC is used where available
+static uint64 ProfTraceTicks()
+{
+#if defined(_WIN32)
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return static_cast<uint64>(counter.QuadPart);
+#elif defined(PROF_TRACE_USE_TSC)
+	return __rdtsc();
+#else
+	return ProfTraceMonotonicNs();
+#endif
+}
+
+static uint64 ProfTraceCalibrateTicks()
+{
+#if defined(_WIN32)
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+	return static_cast<uint64>(freq.QuadPart);
+#elif defined(PROF_TRACE_USE_TSC)
+	// invariant TSC is assumed
+	const uint64 startNs = ProfTraceMonotonicNs();
+	const uint64 startTicks = __rdtsc();
+	Platform_Sleep(20);
+	const uint64 endNs = ProfTraceMonotonicNs();
+	const uint64 endTicks = __rdtsc();
+	return (endTicks - startTicks) * 1000000000ULL / max<uint64>(endNs - startNs, 1);
+#else
+	return 1000000000ULL;
+#endif
+}
+
+// s_profTraceMutex must be locked. Done before scopes are recorded, so
+// ticks per second never change while they are converted by other threads
+static void ProfTraceCalibrateOnce()
+{
+	if (!s_profTraceTicksPerSecond)
+		s_profTraceTicksPerSecond = ProfTraceCalibrateTicks();
+}
+
+static uint32 ProfTraceCurrentThreadId()
+{
+#ifdef _WIN32
+	return GetCurrentThreadId();
+#else
+	return gettid();
+#endif
+}
+
+//-------------------------------------------------------------------------------
+// Names
+
+static int ProfTraceInternName(const char* name)
+{
+	const int nameLength = strlen(name);
+
+	CScopedMutex m(s_profTraceNameMutex);
+
+	int slot = StringToHash(name) & (PROF_TRACE_NAME_TABLE_SIZE - 1);
+	while (s_profTraceNameTable[slot])
+	{
+		const int nameId = s_profTraceNameTable[slot];
+		if (!strcmp(s_profTraceNames[nameId], name))
+			return nameId;
+
+		slot = (slot + 1) & (PROF_TRACE_NAME_TABLE_SIZE - 1);
+	}
+
+	const int nameId = s_profTraceNumNames;
+	if (nameId >= PROF_TRACE_MAX_NAMES || s_profTraceNamePoolUsed + nameLength + 1 > PROF_TRACE_NAME_POOL_SIZE)
+		return 0;
+
+	char* nameCopy = s_profTraceNamePool + s_profTraceNamePoolUsed;
+	memcpy(nameCopy, name, nameLength + 1);
+	s_profTraceNamePoolUsed += nameLength + 1;
+
+	s_profTraceNames[nameId] = nameCopy;
+	s_profTraceNameTable[slot] = nameId;
+	Atomic::Store(s_profTraceNumNames, nameId + 1);
+
+	return nameId;
+}
+
+static int ProfTraceGetNameId(ProfTraceRing* ring, const char* name)
+{
+	ProfTraceNameCacheEntry& entry = ring->nameCache[(reinterpret_cast<uintptr_t>(name) >> 3) & (PROF_TRACE_NAME_CACHE - 1)];
+
+	// labels may be temporary strings, so cached pointer alone is not enough
+	if (entry.label == name && !strcmp(s_profTraceNames[entry.nameId], name))
+		return entry.nameId;
+
+	entry.label = name;
+	entry.nameId = ProfTraceInternName(name);
+	return entry.nameId;
+}
+
+//-------------------------------------------------------------------------------
+// Rings
+
+static void ProfTraceFreeRing(int ringIdx)
+{
+	delete s_profTraceRings[ringIdx];
+	s_profTraceRings[ringIdx] = s_profTraceRings[--s_profTraceNumRings];
+	s_profTraceRings[s_profTraceNumRings] = nullptr;
+}
+
+static ProfTraceRing* ProfTraceGetThreadRing()
+{
+	if (tls_profTraceRing)
+		return tls_profTraceRing;
+
+	ProfTraceRing* ring = PPNew ProfTraceRing();
+	ring->threadId = ProfTraceCurrentThreadId();
+
+	{
+		CScopedMutex m(s_profTraceMutex);
+		if (s_profTraceNumRings >= PROF_TRACE_MAX_THREADS)
+		{
+			delete ring;
+			return nullptr;
+		}
+
+		// no stale events from before capture started
+		ring->cachedTail = ring->tail = ring->head;
+		s_profTraceRings[s_profTraceNumRings++] = ring;
+	}
+
+	tls_profTraceRing = ring;
+	return ring;
+}
+
+static void ProfTracePush(ProfTraceRing* ring, const ProfTraceRecord& record)
+{
+	const uint32 head = ring->head;
+	if (head - ring->cachedTail >= PROF_TRACE_RING_SIZE)
+	{
+		ring->cachedTail = Atomic::Load(ring->tail);
+		if (head - ring->cachedTail >= PROF_TRACE_RING_SIZE)
+		{
+			// writer can't keep up, never block the thread
+			++ring->dropped;
+			return;
+		}
+	}
+
+	ring->records[head & (PROF_TRACE_RING_SIZE - 1)] = record;
+	Atomic::Store(ring->head, head + 1);
+}
+
+int ProfTraceBegin(const char* name)
+{
+	if (!s_profTraceActive)
+		return -1;
+
+	ProfTraceRing* ring = ProfTraceGetThreadRing();
+	if (!ring || ring->depth >= PROF_TRACE_MAX_DEPTH)
+		return -1;
+
+	const int eventId = ring->depth++;
+
+	ProfTraceScope& scope = ring->scopes[eventId];
+	scope.nameId = ProfTraceGetNameId(ring, name);
+	scope.startTicks = ProfTraceTicks();
+
+	return eventId;
+}
+
+void ProfTraceEnd(int eventId)
+{
+	ProfTraceRing* ring = tls_profTraceRing;
+	if (!ring)
+		return;
+
+	const uint64 endTicks = ProfTraceTicks();
+
+	ASSERT_MSG(ring->depth - 1 == eventId, "profiler event %d ended out of order (depth %d)", eventId, ring->depth);
+	ring->depth = eventId;
+
+	// scope which began before capture was stopped is still popped
+	if (!s_profTraceActive)
+		return;
+
+	const ProfTraceScope& scope = ring->scopes[eventId];
+
+	ProfTraceRecord record;
+	record.startTicks = scope.startTicks;
+	record.durationTicks = min<uint64>(endTicks - scope.startTicks, (1ULL << 40) - 1);
+	record.nameId = scope.nameId;
+	record.depth = eventId;
+
+	ProfTracePush(ring, record);
+}
+
+void ProfTraceReleaseThread()
+{
+	ProfTraceRing* ring = tls_profTraceRing;
+	if (!ring)
+		return;
+
+	tls_profTraceRing = nullptr;
+
+	CScopedMutex m(s_profTraceMutex);
+	if (s_profTraceWriterRunning)
+	{
+		// name can't be queried after thread is gone
+		GetThreadName(ring->threadId, ring->threadName, sizeof(ring->threadName));
+
+		// writer frees it after remaining events are written
+		ring->released = true;
+		return;
+	}
+
+	for (int i = 0; i < s_profTraceNumRings; ++i)
+	{
+		if (s_profTraceRings[i] != ring)
+			continue;
+
+		ProfTraceFreeRing(i);
+		break;
+	}
+}
+
+//-------------------------------------------------------------------------------
+// Writer
+
+void ProfTraceWriteChunk(IVirtualStream* stream, EProfTraceChunk type, uint32 id, const void* data, int size)
+{
+	ProfTraceChunkHdr hdr;
+	hdr.type = type;
+	hdr.size = sizeof(id) + size;
+
+	stream->Write(&hdr, 1, sizeof(hdr));
+	stream->Write(&id, 1, sizeof(id));
+	if (size > 0)
+		stream->Write(data, 1, size);
+}
+
+// called with s_profTraceMutex locked
+static void ProfTraceFlush()
+{
+	uint32 heads[PROF_TRACE_MAX_THREADS];
+
+	// records up to these heads only reference already interned names
+	for (int i = 0; i < s_profTraceNumRings; ++i)
+		heads[i] = Atomic::Load(s_profTraceRings[i]->head);
+
+	IVirtualStream* stream = s_profTraceStream;
+	const bool aggregateStats = s_profTraceStatsEnabled;
+
+	const int numNames = Atomic::Load(s_profTraceNumNames);
+	for (; stream && s_profTraceNamesWritten < numNames; ++s_profTraceNamesWritten)
+	{
+		const char* name = s_profTraceNames[s_profTraceNamesWritten];
+		ProfTraceWriteChunk(stream, PROF_TRACE_CHUNK_NAME, s_profTraceNamesWritten, name, strlen(name));
+	}
+
+	const int numRings = s_profTraceNumRings;
+	for (int i = numRings - 1; i >= 0; --i)
+	{
+		ProfTraceRing* ring = s_profTraceRings[i];
+		const uint32 head = heads[i];
+		const uint32 tail = ring->tail;
+
+		if (stream && !ring->threadNameWritten && head != tail)
+		{
+			// queried late as thread names are usually set after thread has started
+			if (!ring->released)
+				GetThreadName(ring->threadId, ring->threadName, sizeof(ring->threadName));
+
+			ProfTraceWriteChunk(stream, PROF_TRACE_CHUNK_THREAD, ring->threadId, ring->threadName, strlen(ring->threadName));
+			ring->threadNameWritten = true;
+		}
+
+		if (head != tail)
+		{
+			const int numRecords = head - tail;
+			const int firstIdx = tail & (PROF_TRACE_RING_SIZE - 1);
+			const int firstCount = min(numRecords, PROF_TRACE_RING_SIZE - firstIdx);
+
+			if (stream)
+			{
+				ProfTraceChunkHdr hdr;
+				hdr.type = PROF_TRACE_CHUNK_EVENTS;
+				hdr.size = sizeof(uint32) + numRecords * sizeof(ProfTraceRecord);
+
+				stream->Write(&hdr, 1, sizeof(hdr));
+				stream->Write(&ring->threadId, 1, sizeof(uint32));
+				stream->Write(&ring->records[firstIdx], firstCount, sizeof(ProfTraceRecord));
+				if (firstCount < numRecords)
+					stream->Write(&ring->records[0], numRecords - firstCount, sizeof(ProfTraceRecord));
+			}
+
+			if (aggregateStats)
+			{
+				ProfStatsAddRecords(ring->threadId, &ring->records[firstIdx], firstCount);
+				if (firstCount < numRecords)
+					ProfStatsAddRecords(ring->threadId, &ring->records[0], numRecords - firstCount);
+			}
+
+			Atomic::Store(ring->tail, head);
+		}
+
+		if (ring->released && Atomic::Load(ring->head) == head)
+			ProfTraceFreeRing(i);
+	}
+}
+
+int CProfTraceWriterThread::Run()
+{
+	while (!IsTerminating())
+	{
+		s_profTraceWriterWake.Wait(PROF_TRACE_WRITE_INTERVAL_MS);
+
+		CScopedMutex m(s_profTraceMutex);
+		ProfTraceFlush();
+	}
+	return 0;
+}
+
+IEXPORTS bool ProfStartTrace(IVirtualStream* stream)
+{
+	CScopedMutex m(s_profTraceMutex);
+
+	if (s_profTraceWriterRunning || !stream)
+		return false;
+
+	// when core is not initialized
+	ProfTraceCalibrateOnce();
+
+	ProfTraceHeader hdr;
+	hdr.ident = PROF_TRACE_IDENT;
+	hdr.version = PROF_TRACE_VERSION;
+	hdr.startTicks = ProfTraceTicks();
+	hdr.ticksPerSecond = ProfTraceGetTicksPerSecond();
+	stream->Write(&hdr, 1, sizeof(hdr));
+
+	s_profTraceStream = IVirtualStreamPtr(stream);
+	s_profTraceNamesWritten = 0;
+
+	for (int i = 0; i < s_profTraceNumRings; ++i)
+	{
+		ProfTraceRing* ring = s_profTraceRings[i];
+		ring->threadNameWritten = false;
+		ring->dropped = 0;
+		Atomic::Store(ring->tail, Atomic::Load(ring->head));
+	}
+
+	s_profTraceWriterRunning = true;
+	s_profTraceWriter.StartThread("ProfTraceWriter", TP_BELOW_NORMAL);
+
+	Atomic::Exchange(s_profTraceCapturing, 1);
+	Atomic::Exchange(s_profTraceActive, 1);
+	return true;
+}
+
+IEXPORTS void ProfStopTrace()
+{
+	{
+		CScopedMutex m(s_profTraceMutex);
+		if (!s_profTraceWriterRunning)
+			return;
+	}
+
+	Atomic::Exchange(s_profTraceCapturing, 0);
+	Atomic::Exchange(s_profTraceActive, s_profTraceStatsEnabled);
+
+	s_profTraceWriter.StopThread(false);
+	s_profTraceWriterWake.Raise();
+	s_profTraceWriter.WaitForThread();
+
+	CScopedMutex m(s_profTraceMutex);
+	ProfTraceFlush();
+
+	int numDropped = 0;
+	for (int i = 0; i < s_profTraceNumRings; ++i)
+		numDropped += s_profTraceRings[i]->dropped;
+
+	if (numDropped)
+		MsgWarning("Performance trace dropped %d events, writer could not keep up\n", numDropped);
+
+	for (int i = 0; i < s_profTraceNumRings; ++i)
+		s_profTraceRings[i]->dropped = 0;
+
+	s_profTraceStream->Flush();
+	s_profTraceStream = nullptr;
+	s_profTraceWriterRunning = false;
+
+	// threads released during capture
+	for (int i = s_profTraceNumRings - 1; i >= 0; --i)
+	{
+		if (s_profTraceRings[i]->released)
+			ProfTraceFreeRing(i);
+	}
+}
+
+IEXPORTS bool ProfIsTracing()
+{
+	return s_profTraceCapturing != 0;
+}
+
+//-------------------------------------------------------------------------------
+// Frame statistics support
+
+void ProfTraceSetStatsEnabled(bool enable)
+{
+	CScopedMutex m(s_profTraceMutex);
+
+	// when core is not initialized
+	ProfTraceCalibrateOnce();
+
+	// records pushed before were not meant for stats
+	if (enable && !s_profTraceStatsEnabled && !s_profTraceWriterRunning)
+	{
+		for (int i = 0; i < s_profTraceNumRings; ++i)
+			Atomic::Store(s_profTraceRings[i]->tail, Atomic::Load(s_profTraceRings[i]->head));
+	}
+
+	Atomic::Exchange(s_profTraceStatsEnabled, enable ? 1 : 0);
+	Atomic::Exchange(s_profTraceActive, (enable || s_profTraceCapturing) ? 1 : 0);
+}
+
+void ProfTraceDrain()
+{
+	CScopedMutex m(s_profTraceMutex);
+	ProfTraceFlush();
+}
+
+uint64 ProfTraceGetTicks()
+{
+	return ProfTraceTicks();
+}
+
+void ProfTraceInit()
+{
+	CScopedMutex m(s_profTraceMutex);
+	ProfTraceCalibrateOnce();
+}
+
+uint64 ProfTraceGetTicksPerSecond()
+{
+	ASSERT_MSG(s_profTraceTicksPerSecond, "ProfTraceInit was not called");
+	return s_profTraceTicksPerSecond;
+}
+
+int ProfTraceGetNumNames()
+{
+	return Atomic::Load(s_profTraceNumNames);
+}
+
+const char* ProfTraceGetName(int nameId)
+{
+	return s_profTraceNames[nameId];
+}
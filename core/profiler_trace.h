@@ -0,0 +1,84 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2024
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Binary performance trace format and per-thread trace rings
+//////////////////////////////////////////////////////////////////////////////////
+
+/*
+File layout:
+
+	ProfTraceHeader
+	chunks of ProfTraceChunkHdr + data:
+		PROF_TRACE_CHUNK_NAME		- uint32 name id, name characters
+		PROF_TRACE_CHUNK_THREAD		- uint32 thread id, thread name characters
+		PROF_TRACE_CHUNK_EVENTS		- uint32 thread id, ProfTraceRecord[]
+
+	Name and thread chunks always precede events that reference them.
+	ProfConvertTraceToJSON (ptrace_convert) makes Chrome trace JSON of it.
+*/
+
+#pragma once
+
+class IVirtualStream;
+
+static constexpr const int PROF_TRACE_IDENT			= MAKECHAR4('E', 'Q', 'T', 'R');
+static constexpr const int PROF_TRACE_VERSION		= 1;
+
+static constexpr const int PROF_TRACE_RING_SIZE		= 8192;		// records per thread, must be power of two
+static constexpr const int PROF_TRACE_MAX_DEPTH		= 128;		// nested scopes per thread
+static constexpr const int PROF_TRACE_MAX_NAMES		= 16384;
+static constexpr const int PROF_TRACE_NAME_CACHE	= 256;		// per-thread label pointer cache, must be power of two
+static constexpr const int PROF_TRACE_WRITE_INTERVAL_MS = 5;
+
+enum EProfTraceChunk : int
+{
+	PROF_TRACE_CHUNK_NAME = 0,
+	PROF_TRACE_CHUNK_THREAD,
+	PROF_TRACE_CHUNK_EVENTS,
+};
+
+struct ProfTraceHeader
+{
+	int		ident;
+	int		version;
+	uint64	startTicks;		// event times are relative to it
+	uint64	ticksPerSecond;	// TSC, QPC or nanoseconds depending on platform
+};
+
+struct ProfTraceChunkHdr
+{
+	int		type;			// EProfTraceChunk
+	int		size;			// data size following this header
+};
+
+// completed scope
+struct ProfTraceRecord
+{
+	uint64	startTicks;
+	uint64	durationTicks : 40;	// saturated, over a minute even at 5 GHz
+	uint64	nameId : 16;
+	uint64	depth : 8;
+};
+static_assert(sizeof(ProfTraceRecord) == 16, "ProfTraceRecord must be 16 bytes");
+
+// calibrates trace ticks, called once by core init
+void	ProfTraceInit();
+
+// used by ProfBeginMarker / ProfEndMarker
+int		ProfTraceBegin(const char* name);
+void	ProfTraceEnd(int eventId);
+void	ProfTraceReleaseThread();
+
+// used by frame statistics
+void		ProfTraceSetStatsEnabled(bool enable);
+void		ProfTraceDrain();
+uint64		ProfTraceGetTicks();
+uint64		ProfTraceGetTicksPerSecond();
+int			ProfTraceGetNumNames();
+const char*	ProfTraceGetName(int nameId);
+void		ProfTraceWriteChunk(IVirtualStream* stream, EProfTraceChunk type, uint32 id, const void* data, int size);
+
+// profiler_stats.cpp, called by trace drain
+void		ProfStatsAddRecords(uint32 threadId, const ProfTraceRecord* records, int count);
+void		ProfStatsShutdown();
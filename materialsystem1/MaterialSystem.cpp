@@ -678,7 +678,7 @@ void CMaterialSystem::ReleaseUnusedMaterials()
 		if(!CString::CompareCaseIns(material->GetName(), "Default"))
 			continue;
 
-		const int framesDiff = (material->m_frameBound - m_frame);
+		const int framesDiff = (material->m_frameBound.GetFrame() - m_frame);
 
 		// Flush materials
 		if(framesDiff >= m_config.materialFlushThresh - 1)
@@ -711,7 +711,7 @@ void CMaterialSystem::ReloadAllMaterials()
 		else
 			material->Init(m_shaderAPI);
 
-		const int framesDiff = (material->m_frameBound - m_frame);
+		const int framesDiff = (material->m_frameBound.GetFrame() - m_frame);
 
 		// preload material if it was ever used before
 		if(framesDiff >= -1)
@@ -1064,6 +1064,8 @@ bool CMaterialSystem::BeginFrame(ISwapChain* swapChain)
 
 void CMaterialSystem::FramePrepareInternal()
 {
+	// also called by render bundle jobs through SetupDrawCommands
+	CScopedMutex m(s_matSystemBufferMutex);
 	if (m_frameBegun)
 		return;
 	m_frameBegun = true;
@@ -1418,68 +1420,102 @@ void CMaterialSystem::QueueCommitInternalBuffers()
 
 void CMaterialSystem::SetupDrawCommand(const RenderDrawCmd& drawCmd, const RenderPassContext& passContext)
 {
-	if (!drawCmd.batchInfo.material)
+	const RenderDrawCmd* drawCmdPtr = &drawCmd;
+	SetupDrawCommands(ArrayCRef<const RenderDrawCmd*>(&drawCmdPtr, 1), passContext);
+}
+
+void CMaterialSystem::SetupDrawCommands(ArrayCRef<const RenderDrawCmd*> drawCmds, const RenderPassContext& passContext, RenderDrawStats* stats)
+{
+	if (!drawCmds.numElem())
 		return;
 
 	// as it could be called outside of BeginFrame/EndFrame
 	FramePrepareInternal();
 
-	const RenderInstanceInfo& instInfo = drawCmd.instanceInfo;
-	const MeshInstanceData& instData = instInfo.instData;
+	IGPURenderCommandsRecorder* recorder = passContext.recorder;
 
-	FixedArray<GPUBufferView, MAX_VERTEXSTREAM> bindVertexBuffers;
+	RenderDrawStats drawStats;
 
-	uint usedVertexLayoutBits = 0;
-	MeshInstanceFormatRef instFormatRef = instInfo.instFormat;
-	if (instFormatRef.layout.numElem())
+	// state that is currently set on recorder
+	RenderDrawStateCache stateCache;
+
+	for (const RenderDrawCmd* drawCmdPtr : drawCmds)
 	{
-		int bufferSlot = 0;
-		for (int i = 0; i < instFormatRef.layout.numElem(); ++i)
+		const RenderDrawCmd& drawCmd = *drawCmdPtr;
+		if (!drawCmd.batchInfo.material)
+			continue;
+
+		const RenderInstanceInfo& instInfo = drawCmd.instanceInfo;
+		const MeshInstanceData& instData = instInfo.instData;
+
+		FixedArray<GPUBufferView, MAX_VERTEXSTREAM> bindVertexBuffers;
+
+		uint usedVertexLayoutBits = 0;
+		MeshInstanceFormatRef instFormatRef = instInfo.instFormat;
+		if (instFormatRef.layout.numElem())
 		{
-			if (instData.buffer && instFormatRef.layout[i].stepMode == VERTEX_STEPMODE_INSTANCE)
-			{
-				bindVertexBuffers.append(instData.buffer);
-				usedVertexLayoutBits |= (1 << i);
-			}
-			else if(instInfo.vertexBuffers[i])
+			for (int i = 0; i < instFormatRef.layout.numElem(); ++i)
 			{
-				bindVertexBuffers.append(instInfo.vertexBuffers[i]);
-				usedVertexLayoutBits |= (1 << i);
+				if (instData.buffer && instFormatRef.layout[i].stepMode == VERTEX_STEPMODE_INSTANCE)
+				{
+					bindVertexBuffers.append(instData.buffer);
+					usedVertexLayoutBits |= (1 << i);
+				}
+				else if(instInfo.vertexBuffers[i])
+				{
+					bindVertexBuffers.append(instInfo.vertexBuffers[i]);
+					usedVertexLayoutBits |= (1 << i);
+				}
 			}
 		}
-	}
 
-	// modify used layout flags
-	instFormatRef.usedLayoutBits &= usedVertexLayoutBits;
+		// modify used layout flags
+		instFormatRef.usedLayoutBits &= usedVertexLayoutBits;
 
-	const RenderDrawBatch& batchInfo = drawCmd.batchInfo;
-	if (!SetupMaterialPipeline(drawCmd.batchInfo.material, drawCmd.instanceInfo.uniformBuffers, batchInfo.primTopology, instFormatRef, passContext, instData.instanceProvider))
-		return;
+		const RenderDrawBatch& batchInfo = drawCmd.batchInfo;
 
-	if (instFormatRef.layout.numElem())
-	{
-		IMatSystemShader* matShader = static_cast<CMaterial*>(drawCmd.batchInfo.material)->m_shader;
-		int bufferSlot = 0;
-		for (const GPUBufferView& bindBufferView : bindVertexBuffers)
-			passContext.recorder->SetVertexBufferView(bufferSlot++, bindBufferView);
+		if (stateCache.NeedPipelineSetup(drawCmd, instFormatRef.usedLayoutBits))
+		{
+			stateCache.ResetPipeline();
+			if (!SetupMaterialPipeline(batchInfo.material, instInfo.uniformBuffers, batchInfo.primTopology, instFormatRef, passContext, instData.instanceProvider))
+				continue;
 
-		passContext.recorder->SetIndexBufferView(instInfo.indexBuffer, instInfo.indexFormat);
-	}
+			stateCache.SetPipeline(drawCmd, instFormatRef.usedLayoutBits, recorder->GetPipeline().Ptr(), drawStats);
+		}
 
-	if (batchInfo.indirectBuffer)
-	{
-		if (batchInfo.firstIndex < 0)
-			passContext.recorder->DrawIndirect(batchInfo.indirectBuffer.buffer, batchInfo.indirectBuffer.offset);
-		else
-			passContext.recorder->DrawIndexedIndirect(batchInfo.indirectBuffer.buffer, batchInfo.indirectBuffer.offset);
-	}
-	else
-	{
-		if (batchInfo.firstIndex < 0 && batchInfo.numIndices == 0)
-			passContext.recorder->Draw(batchInfo.numVertices, batchInfo.firstVertex, instData.count, instData.first);
+		if (instFormatRef.layout.numElem())
+		{
+			int bufferSlot = 0;
+			for (const GPUBufferView& bindBufferView : bindVertexBuffers)
+			{
+				if (stateCache.SetVertexBuffer(bufferSlot, bindBufferView, drawStats))
+					recorder->SetVertexBufferView(bufferSlot, bindBufferView);
+				++bufferSlot;
+			}
+
+			if (stateCache.SetIndexBuffer(instInfo.indexBuffer, instInfo.indexFormat, drawStats))
+				recorder->SetIndexBufferView(instInfo.indexBuffer, instInfo.indexFormat);
+		}
+
+		if (batchInfo.indirectBuffer)
+		{
+			if (batchInfo.firstIndex < 0)
+				recorder->DrawIndirect(batchInfo.indirectBuffer.buffer, batchInfo.indirectBuffer.offset);
+			else
+				recorder->DrawIndexedIndirect(batchInfo.indirectBuffer.buffer, batchInfo.indirectBuffer.offset);
+		}
 		else
-			passContext.recorder->DrawIndexed(batchInfo.numIndices, batchInfo.firstIndex, instData.count, batchInfo.baseVertex, instData.first);
+		{
+			if (batchInfo.firstIndex < 0 && batchInfo.numIndices == 0)
+				recorder->Draw(batchInfo.numVertices, batchInfo.firstVertex, instData.count, instData.first);
+			else
+				recorder->DrawIndexed(batchInfo.numIndices, batchInfo.firstIndex, instData.count, batchInfo.baseVertex, instData.first);
+		}
+		++drawStats.numDraws;
 	}
+
+	if (stats)
+		*stats += drawStats;
 }
 
 void CMaterialSystem::UpdateMaterialProxies(IMaterial* material, IGPUCommandRecorder* commandRecorder, bool force) const
@@ -1489,12 +1525,11 @@ void CMaterialSystem::UpdateMaterialProxies(IMaterial* material, IGPUCommandReco
 
 	CMaterial* matSysMaterial = static_cast<CMaterial*>(material);
 
-	const uint proxyFrame = m_frame;
-	if (!force && matSysMaterial->m_frameBound == proxyFrame)
-		return;
-
-	matSysMaterial->UpdateProxy(m_proxyDeltaTime, commandRecorder, force);
-	matSysMaterial->m_frameBound = proxyFrame;
+	// material can be set up from several recording threads, only one of them updates proxies
+	// and others wait until proxies are updated
+	matSysMaterial->m_frameBound.Update(m_frame, [&]() {
+		matSysMaterial->UpdateProxy(m_proxyDeltaTime, commandRecorder, force);
+	}, force);
 }
 
 bool CMaterialSystem::SetupMaterialPipeline(IMaterial* material, ArrayCRef<RenderBufferInfo> uniformBuffers, EPrimTopology primTopology, const MeshInstanceFormatRef& meshInstFormat, const RenderPassContext& passContext, IShaderMeshInstanceProvider* meshInstProvider)
@@ -1527,13 +1562,6 @@ bool CMaterialSystem::SetupMaterialPipeline(IMaterial* material, ArrayCRef<Rende
 	IGPUCommandRecorderPtr proxyCmdRecorder = GetTlsProxyCmdRecorder();
 	UpdateMaterialProxies(material, proxyCmdRecorder);
 
-	const uint proxyFrame = m_frame;
-	if (matSysMaterial->m_frameBound != proxyFrame)
-	{
-		matSysMaterial->UpdateProxy(m_proxyDeltaTime, proxyCmdRecorder);
-		matSysMaterial->m_frameBound = proxyFrame;
-	}
-
 	const IMatSystemShader::PipelineInputParams pipelineInputParams {
 		passContext.recorder->GetRenderTargetFormats(),
 		passContext.recorder->GetDepthTargetFormat(),
@@ -1547,6 +1575,7 @@ bool CMaterialSystem::SetupMaterialPipeline(IMaterial* material, ArrayCRef<Rende
 		passContext.recorder->IsDepthReadOnly()
 	};
 
+	Threading::CScopedMutex m(matSysMaterial->m_setupMutex);
 	return matShader->SetupRenderPass(renderAPI, pipelineInputParams, uniformBuffers, passContext, originalMaterial);
 }
 
@@ -166,6 +166,7 @@ public:
 
 	bool						SetupMaterialPipeline(IMaterial* material, ArrayCRef<RenderBufferInfo> uniformBuffers, EPrimTopology primTopology, const MeshInstanceFormatRef& meshInstFormat, const RenderPassContext& passContext, IShaderMeshInstanceProvider* meshInstProvider = nullptr);
 	void						SetupDrawCommand(const RenderDrawCmd& drawCmd, const RenderPassContext& passContext);
+	void						SetupDrawCommands(ArrayCRef<const RenderDrawCmd*> drawCmds, const RenderPassContext& passContext, RenderDrawStats* stats = nullptr);
 	bool						SetupDrawDefaultUP(EPrimTopology primTopology, int vertFVF, const void* verts, int numVerts, const RenderPassContext& passContext);
 
 private:
@@ -72,6 +72,46 @@ public:
 	int			m_usageFlags{ 0 };
 };
 
+class CEmptyRenderBundleRecorder : public IGPURenderBundleRecorder
+{
+public:
+	IVector2D					GetRenderTargetDimensions() const { return IVector2D(800, 600); }
+	ArrayCRef<ETextureFormat>	GetRenderTargetFormats() const { return ArrayCRef(m_targets, MAX_RENDERTARGETS); }
+	ETextureFormat			GetDepthTargetFormat() const { return m_depthFormat; }
+
+	bool					IsDepthReadOnly() const { return true; }
+	bool					IsStencilReadOnly() const { return true; }
+	int						GetTargetMultiSamples() const { return 1; }
+
+	void					DbgPopGroup() const {}
+	void					DbgPushGroup(const char* groupLabel) const {}
+	void					DbgAddMarker(const char* label) const {}
+
+	void					SetPipeline(IGPURenderPipeline* pipeline) { m_curPipeline.Assign(pipeline); }
+	IGPURenderPipelinePtr	GetPipeline() const { return m_curPipeline; }
+	void					SetBindGroup(int groupIndex, IGPUBindGroup* bindGroup, ArrayCRef<uint32> dynamicOffsets = nullptr) {}
+
+	void					SetVertexBuffer(int slot, IGPUBuffer* vertexBuffer, int64 offset = 0, int64 size = -1) {}
+	void					SetIndexBuffer(IGPUBuffer* indexBuffer, EIndexFormat indexFormat, int64 offset = 0, int64 size = -1) {}
+
+	void					SetViewport(const AARectangle& rectangle, float minDepth, float maxDepth) {}
+	void					SetScissorRectangle(const IAARectangle& rectangle) {}
+
+	void					Draw(int vertexCount, int firstVertex, int instanceCount, int firstInstance = 0) {}
+	void					DrawIndexed(int indexCount, int firstIndex, int instanceCount, int baseVertex = 0, int firstInstance = 0) {}
+	void					DrawIndexedIndirect(IGPUBuffer* indirectBuffer, int indirectOffset) {}
+	void					DrawIndirect(IGPUBuffer* indirectBuffer, int indirectOffset) {}
+
+	void*					GetUserData() const { return m_userData; }
+	void					Complete() {}
+
+	ETextureFormat			m_targets[MAX_RENDERTARGETS]{ FORMAT_RGBA8, FORMAT_NONE };
+	ETextureFormat			m_depthFormat{ FORMAT_D24 };
+
+	IGPURenderPipelinePtr	m_curPipeline;
+	void*					m_userData{ nullptr };
+};
+
 class CEmptyRenderPassRecorder : public IGPURenderPassRecorder
 {
 public:
@@ -273,6 +313,13 @@ public:
 	IGPURenderPassRecorderPtr	BeginRenderPass(const RenderPassDesc& renderPassDesc, void* userData = nullptr) const { return IGPURenderPassRecorderPtr(CRefPtr_new(CEmptyRenderPassRecorder)); }
 	IGPUComputePassRecorderPtr	BeginComputePass(const char* name, void* userData = nullptr) const { return IGPUComputePassRecorderPtr(CRefPtr_new(CEmptyComputePassRecorder)); }
 
+	IGPURenderBundleRecorderPtr	CreateRenderBundleRecorder(const IGPURenderPassRecorder* compatiblePass, const char* name = nullptr, void* userData = nullptr) const
+	{
+		CRefPtr<CEmptyRenderBundleRecorder> bundle = CRefPtr_new(CEmptyRenderBundleRecorder);
+		bundle->m_userData = userData;
+		return IGPURenderBundleRecorderPtr(bundle);
+	}
+
 //-------------------------------------------------------------
 // Command buffer management
 
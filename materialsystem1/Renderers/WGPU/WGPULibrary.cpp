@@ -249,6 +249,7 @@ bool CWGPURenderLib::InitAPI(const ShaderAPIParams& params)
 			caps.textureFormatsSupported[i] = true;
 
 		caps.textureFormatsSupported[FORMAT_ATI1N] = false;
+		caps.textureFormatsSupported[FORMAT_BC7] = true;
 
 		WGPUDeviceDescriptor rhiDeviceDesc{};
 
@@ -18,6 +18,7 @@
 #include "WGPUStates.h"
 #include "WGPUCommandRecorder.h"
 #include "WGPURenderPassRecorder.h"
+#include "WGPURenderBundleRecorder.h"
 
 #include "../RenderWorker.h"
 #include "WGPUComputePassRecorder.h"
@@ -1348,6 +1349,52 @@ IGPUComputePassRecorderPtr CWGPURenderAPI::BeginComputePass(const char* name, vo
 	return IGPUComputePassRecorderPtr(renderPass);
 }
 
+IGPURenderBundleRecorderPtr CWGPURenderAPI::CreateRenderBundleRecorder(const IGPURenderPassRecorder* compatiblePass, const char* name, void* userData) const
+{
+	ASSERT(compatiblePass);
+	if (!compatiblePass)
+		return nullptr;
+
+	const ArrayCRef<ETextureFormat> passTargetFormats = compatiblePass->GetRenderTargetFormats();
+
+	FixedArray<WGPUTextureFormat, MAX_RENDERTARGETS> rhiColorFormats;
+	for (const ETextureFormat format : passTargetFormats)
+	{
+		if (format == FORMAT_NONE)
+			break;
+		rhiColorFormats.append(GetWGPUTextureFormat(format));
+	}
+
+	const ETextureFormat depthFormat = compatiblePass->GetDepthTargetFormat();
+
+	WGPURenderBundleEncoderDescriptor rhiBundleEncoderDesc = {};
+	rhiBundleEncoderDesc.label = name;
+	rhiBundleEncoderDesc.colorFormatCount = rhiColorFormats.numElem();
+	rhiBundleEncoderDesc.colorFormats = rhiColorFormats.ptr();
+	rhiBundleEncoderDesc.depthStencilFormat = depthFormat != FORMAT_NONE ? GetWGPUTextureFormat(depthFormat) : WGPUTextureFormat_Undefined;
+	rhiBundleEncoderDesc.sampleCount = compatiblePass->GetTargetMultiSamples();
+	rhiBundleEncoderDesc.depthReadOnly = compatiblePass->IsDepthReadOnly();
+	rhiBundleEncoderDesc.stencilReadOnly = compatiblePass->IsStencilReadOnly();
+
+	WGPURenderBundleEncoder rhiRenderBundleEncoder = wgpuDeviceCreateRenderBundleEncoder(m_rhiDevice, &rhiBundleEncoderDesc);
+	if (!rhiRenderBundleEncoder)
+		return nullptr;
+
+	CRefPtr<CWGPURenderBundleRecorder> renderBundle = CRefPtr_new(CWGPURenderBundleRecorder);
+	for (int i = 0; i < passTargetFormats.numElem() && i < MAX_RENDERTARGETS; ++i)
+		renderBundle->m_renderTargetsFormat[i] = passTargetFormats[i];
+
+	renderBundle->m_depthTargetFormat = depthFormat;
+	renderBundle->m_renderTargetDims = compatiblePass->GetRenderTargetDimensions();
+	renderBundle->m_renderTargetMSAASamples = compatiblePass->GetTargetMultiSamples();
+	renderBundle->m_depthReadOnly = compatiblePass->IsDepthReadOnly();
+	renderBundle->m_stencilReadOnly = compatiblePass->IsStencilReadOnly();
+	renderBundle->m_rhiRenderBundleEncoder = rhiRenderBundleEncoder;
+	renderBundle->m_userData = userData;
+
+	return IGPURenderBundleRecorderPtr(renderBundle);
+}
+
 void CWGPURenderAPI::SubmitCommandBuffers(ArrayCRef<IGPUCommandBufferPtr> cmdBuffers) const
 {
 	PROF_EVENT_F();
@@ -86,6 +86,7 @@ public:
 	IGPUCommandRecorderPtr		CreateCommandRecorder(const char* name = nullptr, void* userData = nullptr) const;
 	IGPURenderPassRecorderPtr	BeginRenderPass(const RenderPassDesc& renderPassDesc, void* userData = nullptr) const;
 	IGPUComputePassRecorderPtr	BeginComputePass(const char* name, void* userData = nullptr) const;
+	IGPURenderBundleRecorderPtr	CreateRenderBundleRecorder(const IGPURenderPassRecorder* compatiblePass, const char* name = nullptr, void* userData = nullptr) const;
 
 //-------------------------------------------------------------
 // Command buffer management
@@ -0,0 +1,122 @@
+#include <webgpu/webgpu.h>
+#include "core/core_common.h"
+
+#include "WGPUBuffer.h"
+#include "WGPUStates.h"
+#include "WGPURenderBundleRecorder.h"
+#include "WGPURenderDefs.h"
+
+//-------------------------------------------
+
+CWGPURenderBundleRecorder::~CWGPURenderBundleRecorder()
+{
+	if (m_rhiRenderBundleEncoder)
+		wgpuRenderBundleEncoderRelease(m_rhiRenderBundleEncoder);
+
+	if (m_rhiRenderBundle)
+		wgpuRenderBundleRelease(m_rhiRenderBundle);
+}
+
+void CWGPURenderBundleRecorder::DbgPopGroup() const
+{
+	wgpuRenderBundleEncoderPopDebugGroup(m_rhiRenderBundleEncoder);
+}
+
+void CWGPURenderBundleRecorder::DbgPushGroup(const char* groupLabel) const
+{
+	wgpuRenderBundleEncoderPushDebugGroup(m_rhiRenderBundleEncoder, groupLabel);
+}
+
+void CWGPURenderBundleRecorder::DbgAddMarker(const char* label) const
+{
+	wgpuRenderBundleEncoderInsertDebugMarker(m_rhiRenderBundleEncoder, label);
+}
+
+void CWGPURenderBundleRecorder::SetPipeline(IGPURenderPipeline* pipeline)
+{
+	m_pipeline.Assign(pipeline);
+
+	ASSERT(pipeline);
+	CWGPURenderPipeline* pipelineImpl = static_cast<CWGPURenderPipeline*>(pipeline);
+	if (!pipelineImpl)
+		return;
+	wgpuRenderBundleEncoderSetPipeline(m_rhiRenderBundleEncoder, pipelineImpl->m_rhiRenderPipeline);
+}
+
+void CWGPURenderBundleRecorder::SetBindGroup(int groupIndex, IGPUBindGroup* bindGroup, ArrayCRef<uint32> dynamicOffsets)
+{
+	CWGPUBindGroup* bindGroupImpl = static_cast<CWGPUBindGroup*>(bindGroup);
+	if (bindGroupImpl)
+		wgpuRenderBundleEncoderSetBindGroup(m_rhiRenderBundleEncoder, groupIndex, bindGroupImpl->m_rhiBindGroup, dynamicOffsets.numElem(), dynamicOffsets.ptr());
+	else
+		wgpuRenderBundleEncoderSetBindGroup(m_rhiRenderBundleEncoder, groupIndex, nullptr, 0, nullptr);
+}
+
+void CWGPURenderBundleRecorder::SetVertexBuffer(int slot, IGPUBuffer* vertexBuffer, int64 offset, int64 size)
+{
+	CWGPUBuffer* vertexBufferImpl = static_cast<CWGPUBuffer*>(vertexBuffer);
+	if (vertexBufferImpl)
+	{
+		if (size < 0) size = WGPU_WHOLE_SIZE;
+		ASSERT_MSG(vertexBufferImpl->GetUsageFlags() & BUFFERUSAGE_VERTEX, "buffer doesn't have Vertex buffer usage bit");
+		wgpuRenderBundleEncoderSetVertexBuffer(m_rhiRenderBundleEncoder, slot, vertexBufferImpl->GetWGPUBuffer(), offset, size);
+	}
+	else
+		wgpuRenderBundleEncoderSetVertexBuffer(m_rhiRenderBundleEncoder, slot, nullptr, 0, 0);
+}
+
+void CWGPURenderBundleRecorder::SetIndexBuffer(IGPUBuffer* indexBuf, EIndexFormat indexFormat, int64 offset, int64 size)
+{
+	CWGPUBuffer* indexBufferImpl = static_cast<CWGPUBuffer*>(indexBuf);
+	if (indexBufferImpl)
+	{
+		if (size < 0) size = WGPU_WHOLE_SIZE;
+		ASSERT_MSG(indexBufferImpl->GetUsageFlags() & BUFFERUSAGE_INDEX, "buffer doesn't have Index buffer usage bit");
+		wgpuRenderBundleEncoderSetIndexBuffer(m_rhiRenderBundleEncoder, indexBufferImpl->GetWGPUBuffer(), g_wgpuIndexFormat[indexFormat], offset, size);
+	}
+}
+
+void CWGPURenderBundleRecorder::SetViewport(const AARectangle& rectangle, float minDepth, float maxDepth)
+{
+	ASSERT_FAIL("SetViewport is not supported in render bundles");
+}
+
+void CWGPURenderBundleRecorder::SetScissorRectangle(const IAARectangle& rectangle)
+{
+	ASSERT_FAIL("SetScissorRectangle is not supported in render bundles");
+}
+
+void CWGPURenderBundleRecorder::Draw(int vertexCount, int firstVertex, int instanceCount, int firstInstance)
+{
+	wgpuRenderBundleEncoderDraw(m_rhiRenderBundleEncoder, vertexCount, instanceCount, firstVertex, firstInstance);
+}
+
+void CWGPURenderBundleRecorder::DrawIndexed(int indexCount, int firstIndex, int instanceCount, int baseVertex, int firstInstance)
+{
+	wgpuRenderBundleEncoderDrawIndexed(m_rhiRenderBundleEncoder, indexCount, instanceCount, firstIndex, baseVertex, firstInstance);
+}
+
+void CWGPURenderBundleRecorder::DrawIndexedIndirect(IGPUBuffer* indirectBuffer, int indirectOffset)
+{
+	CWGPUBuffer* indexBufferImpl = static_cast<CWGPUBuffer*>(indirectBuffer);
+	wgpuRenderBundleEncoderDrawIndexedIndirect(m_rhiRenderBundleEncoder, indexBufferImpl->GetWGPUBuffer(), indirectOffset);
+}
+
+void CWGPURenderBundleRecorder::DrawIndirect(IGPUBuffer* indirectBuffer, int indirectOffset)
+{
+	CWGPUBuffer* indexBufferImpl = static_cast<CWGPUBuffer*>(indirectBuffer);
+	wgpuRenderBundleEncoderDrawIndirect(m_rhiRenderBundleEncoder, indexBufferImpl->GetWGPUBuffer(), indirectOffset);
+}
+
+void CWGPURenderBundleRecorder::Complete()
+{
+	if (!m_rhiRenderBundleEncoder)
+	{
+		ASSERT_FAIL("Render bundle recorder was already completed");
+		return;
+	}
+
+	m_rhiRenderBundle = wgpuRenderBundleEncoderFinish(m_rhiRenderBundleEncoder, nullptr);
+	wgpuRenderBundleEncoderRelease(m_rhiRenderBundleEncoder);
+	m_rhiRenderBundleEncoder = nullptr;
+}
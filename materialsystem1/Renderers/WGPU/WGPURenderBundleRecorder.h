@@ -0,0 +1,53 @@
+#pragma once
+#include "renderers/IShaderAPI.h"
+
+class CWGPURenderBundleRecorder : public IGPURenderBundleRecorder
+{
+public:
+	~CWGPURenderBundleRecorder();
+
+	IVector2D				GetRenderTargetDimensions() const { return m_renderTargetDims; }
+	ArrayCRef<ETextureFormat>	GetRenderTargetFormats() const { return ArrayCRef(m_renderTargetsFormat); }
+	ETextureFormat			GetDepthTargetFormat() const { return m_depthTargetFormat; }
+
+	bool					IsDepthReadOnly() const { return m_depthReadOnly; }
+	bool					IsStencilReadOnly() const { return m_stencilReadOnly; }
+	int						GetTargetMultiSamples() const { return m_renderTargetMSAASamples; }
+
+	void					DbgPopGroup() const;
+	void					DbgPushGroup(const char* groupLabel) const;
+	void					DbgAddMarker(const char* label) const;
+
+	void					SetPipeline(IGPURenderPipeline* pipeline);
+	IGPURenderPipelinePtr	GetPipeline() const { return m_pipeline; }
+
+	void					SetBindGroup(int groupIndex, IGPUBindGroup* bindGroup, ArrayCRef<uint32> dynamicOffsets);
+	void					SetVertexBuffer(int slot, IGPUBuffer* vertexBuffer, int64 offset = 0, int64 size = -1);
+	void					SetIndexBuffer(IGPUBuffer* indexBuf, EIndexFormat indexFormat, int64 offset = 0, int64 size = -1);
+
+	// not supported by bundles, inherited from render pass
+	void					SetViewport(const AARectangle& rectangle, float minDepth, float maxDepth);
+	void					SetScissorRectangle(const IAARectangle& rectangle);
+
+	void					Draw(int vertexCount, int firstVertex, int instanceCount, int firstInstance = 0);
+	void					DrawIndexed(int indexCount, int firstIndex, int instanceCount, int baseVertex = 0, int firstInstance = 0);
+	void					DrawIndexedIndirect(IGPUBuffer* indirectBuffer, int indirectOffset);
+	void					DrawIndirect(IGPUBuffer* indirectBuffer, int indirectOffset);
+
+	void					Complete();
+
+	void*					GetUserData() const { return m_userData; }
+
+	ETextureFormat			m_renderTargetsFormat[MAX_RENDERTARGETS]{ FORMAT_NONE };
+	ETextureFormat			m_depthTargetFormat{ FORMAT_NONE };
+	IVector2D				m_renderTargetDims{ 0 };
+	int						m_renderTargetMSAASamples{ 1 };
+	bool					m_depthReadOnly{ false };
+	bool					m_stencilReadOnly{ false };
+
+	IGPURenderPipelinePtr	m_pipeline;
+
+	WGPURenderBundleEncoder	m_rhiRenderBundleEncoder{ nullptr };
+	WGPURenderBundle		m_rhiRenderBundle{ nullptr };
+	void*					m_userData{ nullptr };
+};
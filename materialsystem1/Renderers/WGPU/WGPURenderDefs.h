@@ -91,6 +91,8 @@ static WGPUTextureFormat g_wgpuTexFormats[] = {
 	WGPUTextureFormat_Undefined,
 	WGPUTextureFormat_Undefined,
 	WGPUTextureFormat_Undefined,
+
+	WGPUTextureFormat_BC7RGBAUnorm,
 };
 
 static WGPUTextureFormat GetWGPUFormatSRGB(WGPUTextureFormat baseFormat)
@@ -107,6 +109,8 @@ static WGPUTextureFormat GetWGPUFormatSRGB(WGPUTextureFormat baseFormat)
 		return WGPUTextureFormat_BC2RGBAUnormSrgb;
 	case WGPUTextureFormat_BC3RGBAUnorm:
 		return WGPUTextureFormat_BC3RGBAUnormSrgb;
+	case WGPUTextureFormat_BC7RGBAUnorm:
+		return WGPUTextureFormat_BC7RGBAUnormSrgb;
 	}
 
 	// TODO: ASTC
@@ -192,6 +196,12 @@ static WGPUVertexFormat g_wgpuVertexFormats[][4] = {
 	{
 		WGPUVertexFormat_Float32, WGPUVertexFormat_Float32x2, WGPUVertexFormat_Float32x3, WGPUVertexFormat_Float32x4
 	},
+	{
+		WGPUVertexFormat_Undefined, WGPUVertexFormat_Unorm8x2, WGPUVertexFormat_Undefined, WGPUVertexFormat_Unorm8x4
+	},
+	{
+		WGPUVertexFormat_Undefined, WGPUVertexFormat_Snorm8x2, WGPUVertexFormat_Undefined, WGPUVertexFormat_Snorm8x4
+	},
 };
 
 // EVertexStepMode
@@ -4,6 +4,7 @@
 #include "WGPUBuffer.h"
 #include "WGPUStates.h"
 #include "WGPURenderPassRecorder.h"
+#include "WGPURenderBundleRecorder.h"
 #include "WGPURenderDefs.h"
 
 //-------------------------------------------
@@ -34,7 +35,18 @@ void CWGPURenderPassRecorder::DbgAddMarker(const char* label) const
 
 void CWGPURenderPassRecorder::AddBundle(IGPURenderBundleRecorder* bundle)
 {
-	ASSERT_FAIL("NOT IMPLEMENTED");
+	CWGPURenderBundleRecorder* bundleImpl = static_cast<CWGPURenderBundleRecorder*>(bundle);
+	if (!bundleImpl)
+		return;
+
+	ASSERT_MSG(bundleImpl->m_rhiRenderBundle, "Render bundle must be completed before adding to render pass");
+	if (!bundleImpl->m_rhiRenderBundle)
+		return;
+
+	wgpuRenderPassEncoderExecuteBundles(m_rhiRenderPassEncoder, 1, &bundleImpl->m_rhiRenderBundle);
+
+	// bundle execution resets pipeline and bindings state
+	m_pipeline = nullptr;
 }
 
 void CWGPURenderPassRecorder::SetPipeline(IGPURenderPipeline* pipeline)
@@ -122,7 +134,6 @@ void CWGPURenderPassRecorder::DrawIndirect(IGPUBuffer* indirectBuffer, int indir
 // CWGPURenderPassRecorder::BeginOcclusionQuery(uint32_t queryIndex);
 // CWGPURenderPassRecorder::EndOcclusionQuery();
 
-// CWGPURenderPassRecorder::ExecuteBundles(size_t bundleCount, WGPURenderBundle const* bundles);
 // CWGPURenderPassRecorder::PixelLocalStorageBarrier();
 
 // CWGPURenderPassRecorder::InsertDebugMarker(char const* markerLabel);
@@ -40,7 +40,6 @@ public:
 	// BeginOcclusionQuery(uint32_t queryIndex);
 	// EndOcclusionQuery();
 
-	// ExecuteBundles(size_t bundleCount, WGPURenderBundle const* bundles);
 	// PixelLocalStorageBarrier();
 
 	// InsertDebugMarker(char const* markerLabel);
@@ -20,7 +20,7 @@ DECLARE_CVAR(r_reportTextureLoading, "0", "Echo textrue loading", 0);
 DECLARE_CVAR(r_skipTextureLoading, "0", nullptr, CV_CHEAT);
 DECLARE_CVAR(r_noMip, "0", nullptr, CV_CHEAT);
 
-static void AnimGetImagesForTextureName(Array<EqString>& textureNames, const char* pszFileName)
+static void AnimGetImagesForTextureName(FrameArray<EqString>& textureNames, const char* pszFileName)
 {
 	EqString texturePath(pszFileName);
 
@@ -113,7 +113,9 @@ ITexturePtr CTextureLoader::LoadTextureFromFileSync(const char* pszFileName, con
 
 	PROF_EVENT("Load Texture from file");
 
-	Array<EqString> textureNames(PP_SL);
+	// loader threads don't run frames
+	CFrameAllocScope frameAllocScope;
+	FrameArray<EqString> textureNames(PP_SL);
 	AnimGetImagesForTextureName(textureNames, pszFileName);
 
 	Array<CImage::PTR_T> imgList(PP_SL);
@@ -326,7 +326,8 @@ MatVarData& CMaterial::VarAt(int idx) const
 
 bool CMaterial::LoadShaderAndTextures()
 {
-	if (m_state != MATERIAL_LOAD_NEED_LOAD)
+	// only one thread is allowed to load
+	if (Atomic::CompareExchange(m_state, MATERIAL_LOAD_NEED_LOAD, MATERIAL_LOAD_INQUEUE) != MATERIAL_LOAD_NEED_LOAD)
 		return false;
 
 	return DoLoadShaderAndTextures();
@@ -339,7 +340,11 @@ bool CMaterial::DoLoadShaderAndTextures()
 
 	IMatSystemShader* shader = m_shader;
 	if(!shader)
+	{
+		// let it try again later
+		Atomic::CompareExchange(m_state, MATERIAL_LOAD_INQUEUE, MATERIAL_LOAD_NEED_LOAD);
 		return true;
+	}
 
 	Atomic::Exchange(m_state, MATERIAL_LOAD_INQUEUE);
 
@@ -353,8 +358,13 @@ bool CMaterial::DoLoadShaderAndTextures()
 	if(shader->IsInitialized() )
 		Atomic::Exchange(m_state, MATERIAL_LOAD_OK);
 	else
+	{
 		ASSERT_FAIL("please check shader '%s' (%s) for initialization (not error, not initialized)", m_szShaderName.ToCString(), m_shader->GetName());
 
+		// don't let other threads wait forever
+		Atomic::Exchange(m_state, MATERIAL_LOAD_ERROR);
+	}
+
 	return true;
 }
 
@@ -85,7 +85,8 @@ protected:
 	int						m_nameHash{ 0 };
 	int						m_instanceFormatId{ 0 };
 
-	uint					m_frameBound{ 0 };
+	Threading::CEqFrameUpdateGuard	m_frameBound;
+	Threading::CEqMutex		m_setupMutex;		// shader state is not safe to set up from several recording threads
 	bool					m_loadFromDisk{ false };
 	bool					m_varsUpdated{ true };
 };
\ No newline at end of file
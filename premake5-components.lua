@@ -206,6 +206,11 @@ project "networkLib"
 	filter "system:Windows"
 		links { "wsock32" }
 
+usage "networkLib"
+	links "networkLib"
+	filter "system:Windows"
+		links { "wsock32" }
+
 project "soundSystemLib"
 	kind "StaticLib"
 	unitybuild "on"
@@ -55,6 +55,7 @@
 
 #include "profiler.h"
 #include "ppmem.h"
+#include "framealloc.h"
 #include "cmdlib.h"
 
 #include "platform/platform.h"
@@ -87,6 +88,8 @@
 #include "ds/List.h"
 
 #include "ds/eqstring.h"
+#include "ds/hashmap.h"
+#include "ds/framearray.h"
 
 #include "platform/eqthread.h"
 #include "ds/future.h"
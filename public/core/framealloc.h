@@ -0,0 +1,80 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2024
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Per-thread double-buffered frame memory arena
+//
+//				Memory allocated during frame stays valid until the end
+//				of the next frame and is never freed individually.
+//				Each thread has own arena, it is rewound lazily by first
+//				allocation of the thread after FrameAllocEndFrame.
+//				Worker jobs must not keep frame memory longer than a frame.
+//				Use FrameArray and FrameString for temporary containers.
+//				Code that runs outside of main loop frames (physics step,
+//				loader and tool threads) releases it's memory with
+//				CFrameAllocScope.
+//////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+struct PPSourceLine;
+
+static constexpr const int FRAMEALLOC_DEFAULT_ALIGN = 16;
+
+struct FrameAllocStats
+{
+	int64	frameIndex{ 0 };
+	int		numArenas{ 0 };
+	int		lastFrameAllocs{ 0 };		// in all arenas
+	size_t	lastFrameBytes{ 0 };
+	size_t	peakFrameBytes{ 0 };		// of single arena
+	size_t	reservedBytes{ 0 };
+	int		lastFrameHeapAllocs{ 0 };	// PPMem heap (re)allocations during last frame
+};
+
+IEXPORTS void*	FrameDAlloc(size_t size, size_t align, const PPSourceLine& sl);
+
+// grows in place if ptr is the last allocation of the thread, otherwise copies
+IEXPORTS void*	FrameDReAlloc(void* ptr, size_t oldSize, size_t newSize, size_t align, const PPSourceLine& sl);
+
+// closes frame, to be called once per frame by main loop
+IEXPORTS void	FrameAllocEndFrame();
+
+// position in arena of the current thread
+struct FrameAllocMark
+{
+	int64	frameIndex{ -1 };
+	int		chunk{ 0 };
+	size_t	chunkUsed{ 0 };
+	size_t	usedBytes{ 0 };
+	int		numAllocs{ 0 };
+};
+
+IEXPORTS FrameAllocMark	FrameAllocGetMark();
+
+// releases allocations of the current thread made after mark in frame of mark
+IEXPORTS void	FrameAllocRewind(const FrameAllocMark& mark);
+
+IEXPORTS int64	FrameAllocGetFrameIndex();
+IEXPORTS void	FrameAllocGetStats(FrameAllocStats& stats);
+
+// memory allocated in frameIndex is still valid
+inline bool		FrameAllocIsAlive(int64 frameIndex) { return FrameAllocGetFrameIndex() - frameIndex <= 1; }
+
+// frame memory allocated by the thread inside the scope is released on exit,
+// containers created before the scope must not grow inside of it
+class CFrameAllocScope
+{
+public:
+	CFrameAllocScope() : m_mark(FrameAllocGetMark()) {}
+	~CFrameAllocScope() { FrameAllocRewind(m_mark); }
+
+	CFrameAllocScope(const CFrameAllocScope&) = delete;
+	CFrameAllocScope& operator=(const CFrameAllocScope&) = delete;
+
+private:
+	FrameAllocMark	m_mark;
+};
+
+#define	FrameAlloc(size)					FrameDAlloc(size, FRAMEALLOC_DEFAULT_ALIGN, PP_SL)
+#define	FrameAllocStructArray(type, count)	reinterpret_cast<type*>(FrameDAlloc((count) * sizeof(type), alignof(type), PP_SL))
@@ -189,6 +189,37 @@ private:
 	void operator=( const CEqSignal & s ) = delete;
 };
 
+//----------------------------------------------------------------------------------------
+// Runs an update once per frame when several threads request it at the same time.
+// Threads coming during the update wait for it to finish, the frame is published after.
+//----------------------------------------------------------------------------------------
+
+class CEqFrameUpdateGuard
+{
+public:
+	// returns true if this thread did the update
+	template<typename F>
+	bool	Update(uint frame, F func, bool force = false)
+	{
+		if (!force && Atomic::Load(m_frame) == frame)
+			return false;
+
+		CScopedMutex m(m_mutex);
+		if (!force && m_frame == frame)
+			return false;
+
+		func();
+		Atomic::Store(m_frame, frame);
+		return true;
+	}
+
+	uint	GetFrame() const { return Atomic::Load(m_frame); }
+
+private:
+	CEqMutex		m_mutex;
+	volatile uint	m_frame{ 0 };
+};
+
 /*----------------------------------------------------------------------------------------
 CEqThread is an abstract base class, to be extended by classes implementing the
 CEqThread::Run() method.
@@ -12,6 +12,10 @@ struct PPSourceLine;
 IEXPORTS void	PPMemInfo( bool fullStats = true );
 IEXPORTS size_t	PPMemGetUsage();
 
+// tracked heap (re)allocations made during last frame
+IEXPORTS void	PPMemEndFrame();
+IEXPORTS int	PPMemGetFrameAllocCount();
+
 IEXPORTS void*	PPDAlloc( size_t size, const PPSourceLine& sl );
 IEXPORTS void*	PPDReAlloc( void* ptr, size_t size, const PPSourceLine& sl );
 IEXPORTS void	PPDCheck( void* ptr );
@@ -11,6 +11,8 @@
 #define PROFILE_ENABLE
 #endif
 
+class IVirtualStream;
+
 // source-line contailer
 struct PPSourceLine
 {
@@ -44,6 +46,80 @@ private:
 	int eventId{ -1 };
 };
 
+// binary trace of PROF_EVENT scopes written by background thread (ptrace_start/ptrace_stop)
+IEXPORTS bool ProfStartTrace(IVirtualStream* stream);
+IEXPORTS void ProfStopTrace();
+IEXPORTS bool ProfIsTracing();
+
+// makes Chrome trace JSON (chrome://tracing, ui.perfetto.dev) from binary trace
+IEXPORTS bool ProfConvertTraceToJSON(IVirtualStream* traceStream, IVirtualStream* jsonStream);
+
+//-------------------------------------------------------
+// Always-on frame statistics aggregated from PROF_EVENT scopes (prof_stats)
+
+static constexpr const int PROF_STATS_HISTOGRAM_BUCKETS = 10;
+
+// histogram bucket upper bounds in milliseconds
+static constexpr const float PROF_STATS_HISTOGRAM_BOUNDS[PROF_STATS_HISTOGRAM_BUCKETS] = {
+	1.0f, 2.0f, 4.0f, 8.0f, 16.7f, 33.3f, 50.0f, 100.0f, 250.0f, 1e10f
+};
+
+struct ProfFrameStats
+{
+	int64	frameIndex{ 0 };
+	int		numFrames{ 0 };			// in rolling window
+	int		numSpikes{ 0 };			// frames over prof_spike_ms since reset
+	float	lastFrameMs{ 0.0f };
+	float	avgFrameMs{ 0.0f };
+	float	minFrameMs{ 0.0f };
+	float	maxFrameMs{ 0.0f };
+	float	lastSpikeMs{ 0.0f };
+	int		histogram[PROF_STATS_HISTOGRAM_BUCKETS]{ 0 };
+};
+
+struct ProfThreadStats
+{
+	uint32	threadId{ 0 };
+	char	name[32]{ 0 };
+	float	lastFrameBusyMs{ 0.0f };	// sum of top level scopes
+	float	avgBusyMs{ 0.0f };
+	float	maxBusyMs{ 0.0f };
+	int		histogram[PROF_STATS_HISTOGRAM_BUCKETS]{ 0 };
+};
+
+struct ProfScopeStats
+{
+	const char*	name{ nullptr };	// valid until process exit
+	uint32	threadId{ 0 };
+	int		depth{ 0 };
+	int64	count{ 0 };				// since reset
+	float	totalMs{ 0.0f };
+	float	avgMs{ 0.0f };
+	float	minMs{ 0.0f };
+	float	maxMs{ 0.0f };
+	float	lastFrameMs{ 0.0f };	// sum in last frame
+	int		lastFrameCount{ 0 };
+};
+
+// closes frame, to be called once per frame by main loop
+IEXPORTS void ProfEndFrame();
+
+IEXPORTS void ProfSetStatsEnabled(bool enable);
+
+// keep events of numFrames last frames and capture them when frame is longer than thresholdMs
+IEXPORTS void ProfSetSpikeCapture(float thresholdMs, int numFrames);
+
+IEXPORTS void ProfGetFrameStats(ProfFrameStats& stats);
+
+// return number of entries written, scopes are sorted by total time
+IEXPORTS int ProfGetThreadStats(ProfThreadStats* stats, int maxStats);
+IEXPORTS int ProfGetScopeStats(ProfScopeStats* stats, int maxStats);
+
+IEXPORTS void ProfResetStats();
+
+// writes last captured spike as binary trace, false if there was none
+IEXPORTS bool ProfWriteSpikeTrace(IVirtualStream* stream);
+
 #ifdef PROFILE_ENABLE
 
 #define PP_SL PPSourceLine::Make(__FILE__, __LINE__)
@@ -57,6 +133,7 @@ IEXPORTS void ProfReleaseCurrentThreadMarkers();
 #define PROF_EVENT_F()					ProfEventWrp _profEvt(__func__)
 #define PROF_MARKER(name)				ProfAddMarker(name)
 #define PROF_RELEASE_THREAD_MARKERS()	ProfReleaseCurrentThreadMarkers()
+#define PROF_END_FRAME()				ProfEndFrame()
 
 inline ProfEventWrp::ProfEventWrp(const char* name)	{ eventId = ProfBeginMarker(name); }
 inline ProfEventWrp::~ProfEventWrp()				{ ProfEndMarker(eventId); }
@@ -69,6 +146,7 @@ inline ProfEventWrp::~ProfEventWrp()				{ ProfEndMarker(eventId); }
 #define PROF_EVENT_F()
 #define PROF_MARKER(name)
 #define PROF_RELEASE_THREAD_MARKERS()
+#define PROF_END_FRAME()
 
 inline ProfEventWrp::ProfEventWrp(const char* name) {};
 inline ProfEventWrp::~ProfEventWrp() = default;
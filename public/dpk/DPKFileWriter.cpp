@@ -9,10 +9,14 @@
 
 #include "core/core_common.h"
 #include "core/IFileSystem.h"
+#include "core/platform/eqjobmanager.h"
 #include "utils/KeyValues.h"
 #include "DPKFileWriter.h"
 #include "DPKUtils.h"
 
+// files queued for parallel compression are written when they reach this size
+static constexpr const int DPK_PENDING_MAXSIZE = 64 * 1024 * 1024;
+
 //---------------------------------------------
 
 CDPKFileWriter::CDPKFileWriter(const char* mountPath, int compression, const char* encryptKey, bool skipPacking)
@@ -65,6 +69,9 @@ bool CDPKFileWriter::Begin(const char* fileName, ESearchPath searchPath)
 	m_header.signature = DPK_SIGNATURE;
 	m_header.compressionLevel = m_compressionLevel;
 
+	m_packedSize = 0;
+	m_reusedFiles = 0;
+
 	m_output.Write(&m_header, sizeof(m_header));
 	m_output.Write(m_mountPath, DPK_STRING_SIZE);
 
@@ -93,6 +100,8 @@ int CDPKFileWriter::End(bool storeFileList)
 		Add(&lstFile, "dpkfiles.lst");
 	}
 
+	FlushPending();
+
 	m_header.fileInfoOffset = m_output.Tell();
 	m_header.numFiles = m_files.size();
 
@@ -109,12 +118,263 @@ int CDPKFileWriter::End(bool storeFileList)
 
 	m_output.Close();
 
+	if (m_prevPackage.IsOpen())
+		m_prevPackage.Close();
+	m_prevFiles.clear(true);
+
 	const int numFiles = m_files.size();
 	m_files.clear(true);
 
 	return numFiles;
 }
 
+bool CDPKFileWriter::SetPreviousPackage(const char* fileName, ESearchPath searchPath)
+{
+	if (m_prevPackage.IsOpen())
+		m_prevPackage.Close();
+	m_prevFiles.clear();
+
+	if (!m_prevPackage.Open(g_fileSystem->GetAbsolutePath(searchPath, fileName), COSFile::OPEN_EXIST | COSFile::READ))
+		return false;
+
+	dpkheader_t header;
+	m_prevPackage.Read(&header, sizeof(header));
+
+	if (header.signature != DPK_SIGNATURE || header.version != DPK_VERSION)
+	{
+		MsgWarning("CDPKFileWriter: previous package '%s' is not valid or has different version\n", fileName);
+		m_prevPackage.Close();
+		return false;
+	}
+
+	m_prevCompressionLevel = header.compressionLevel;
+
+	Array<dpkfileinfo_t> fileInfos(PP_SL);
+	fileInfos.setNum(header.numFiles);
+
+	m_prevPackage.Seek(header.fileInfoOffset, COSFile::ESeekPos::SET);
+	m_prevPackage.Read(fileInfos.ptr(), sizeof(dpkfileinfo_t) * header.numFiles);
+
+	// only block files are worth reusing
+	// package doesn't store encryption key so encrypted blocks are never reused
+	for (const dpkfileinfo_t& info : fileInfos)
+	{
+		if (!info.numBlocks || !DPK_IsBlockFile(info.flags) || (info.flags & DPKFILE_FLAG_ENCRYPTED))
+			continue;
+
+		const uint64 key = ((uint64)info.crc << 32) | info.size;
+		if (!m_prevFiles.contains(key))
+			m_prevFiles.insert(key, info);
+	}
+
+	return true;
+}
+
+bool CDPKFileWriter::CopyPreviousFile(dpkfileinfo_t& pakInfo)
+{
+	if (!m_prevPackage.IsOpen() || m_prevCompressionLevel != m_compressionLevel)
+		return false;
+
+	if (pakInfo.flags & DPKFILE_FLAG_ENCRYPTED)
+		return false;
+
+	auto it = m_prevFiles.find(((uint64)pakInfo.crc << 32) | pakInfo.size);
+	if (it.atEnd())
+		return false;
+
+	const dpkfileinfo_t& prevInfo = *it;
+	if (prevInfo.flags != pakInfo.flags)
+		return false;
+
+	// read and validate all blocks before writing anything
+	Array<ubyte> blockData(PP_SL);
+	blockData.reserve(prevInfo.numBlocks * (sizeof(dpkblock_t) + DPK_BLOCK_MAXSIZE));
+
+	m_prevPackage.Seek(prevInfo.offset, COSFile::ESeekPos::SET);
+
+	uint packedSize = 0;
+	uint unpackedSize = 0;
+	for (int i = 0; i < prevInfo.numBlocks; ++i)
+	{
+		dpkblock_t blockInfo;
+		if (m_prevPackage.Read(&blockInfo, sizeof(blockInfo)) != sizeof(blockInfo))
+			return false;
+
+		const int dataSize = (blockInfo.flags & DPKFILE_FLAG_COMPRESSED) ? blockInfo.compressedSize : blockInfo.size;
+		if (dataSize <= 0 || dataSize > DPK_BLOCK_MAXSIZE || blockInfo.size > DPK_BLOCK_MAXSIZE)
+			return false;
+
+		const int blockStart = blockData.numElem();
+		blockData.setNum(blockStart + sizeof(blockInfo) + dataSize);
+		memcpy(blockData.ptr() + blockStart, &blockInfo, sizeof(blockInfo));
+
+		if (m_prevPackage.Read(blockData.ptr() + blockStart + sizeof(blockInfo), dataSize) != (size_t)dataSize)
+			return false;
+
+		packedSize += dataSize;
+		unpackedSize += blockInfo.size;
+	}
+
+	if (unpackedSize != pakInfo.size)
+		return false;
+
+	pakInfo.offset = m_output.Tell();
+	pakInfo.numBlocks = prevInfo.numBlocks;
+	m_output.Write(blockData.ptr(), blockData.numElem());
+
+	m_packedSize += packedSize;
+	++m_reusedFiles;
+
+	return true;
+}
+
+// compresses and encrypts block, returns size of data written to dstData
+int CDPKFileWriter::EncodeBlock(const ubyte* srcData, int srcSize, int blockFlags, ubyte* dstData, dpkblock_t& blockInfo) const
+{
+	memset(&blockInfo, 0, sizeof(dpkblock_t));
+	blockInfo.size = srcSize;
+
+	int compressedSize = -1;
+
+	// try compressing
+	if (blockFlags & DPKFILE_FLAG_COMPRESSED)
+		compressedSize = LZ4_compress_HC((const char*)srcData, (char*)dstData, srcSize, DPK_BLOCK_MAXSIZE, m_compressionLevel);
+
+	// compressedSize could be -1 which means buffer overlow (or uneffective)
+	if (compressedSize > 0)
+	{
+		blockInfo.flags |= DPKFILE_FLAG_COMPRESSED;
+		blockInfo.compressedSize = compressedSize;
+	}
+	else
+	{
+		memcpy(dstData, srcData, srcSize);
+	}
+
+	const int dstSize = (blockInfo.flags & DPKFILE_FLAG_COMPRESSED) ? blockInfo.compressedSize : srcSize;
+
+	// encrypt tmpBlock
+	if (blockFlags & DPKFILE_FLAG_ENCRYPTED)
+	{
+		blockInfo.flags |= DPKFILE_FLAG_ENCRYPTED;
+
+		const int iceBlockSize = m_ice.blockSize();
+
+		ubyte* iceTempBlock = (ubyte*)stackalloc(iceBlockSize);
+		ubyte* tmpBlockPtr = dstData;
+
+		int bytesLeft = dstSize;
+
+		// encrypt block by block
+		while (bytesLeft > iceBlockSize)
+		{
+			m_ice.encrypt(tmpBlockPtr, iceTempBlock);
+
+			// copy encrypted block
+			memcpy(tmpBlockPtr, iceTempBlock, iceBlockSize);
+
+			tmpBlockPtr += iceBlockSize;
+			bytesLeft -= iceBlockSize;
+		}
+	}
+
+	return dstSize;
+}
+
+void CDPKFileWriter::FlushPending()
+{
+	if (!m_pendingFiles.numElem())
+		return;
+
+	struct BlockTask
+	{
+		int		srcOffset;
+		int		srcSize;
+		int		blockFlags;
+	};
+
+	auto pendingFileSize = [this](int i) {
+		const int nextOffset = (i + 1 < m_pendingFiles.numElem()) ? m_pendingFiles[i + 1].dataOffset : m_pendingData.numElem();
+		return nextOffset - m_pendingFiles[i].dataOffset;
+	};
+
+	Array<BlockTask> blockTasks(PP_SL);
+	for (int i = 0; i < m_pendingFiles.numElem(); ++i)
+	{
+		const PendingFile& pending = m_pendingFiles[i];
+		const dpkfileinfo_t& pakInfo = (*m_files.find(pending.filenameHash)).pakInfo;
+		const int fileSize = pendingFileSize(i);
+
+		for (int offset = 0; offset < fileSize; offset += DPK_BLOCK_MAXSIZE)
+			blockTasks.append({ pending.dataOffset + offset, min(DPK_BLOCK_MAXSIZE, fileSize - offset), pakInfo.flags });
+	}
+
+	const int numBlocks = blockTasks.numElem();
+
+	Array<ubyte> encodedData(PP_SL);
+	encodedData.setNum(numBlocks * DPK_BLOCK_MAXSIZE);
+
+	Array<dpkblock_t> blockInfos(PP_SL);
+	blockInfos.setNum(numBlocks);
+
+	Array<int> encodedSizes(PP_SL);
+	encodedSizes.setNum(numBlocks);
+
+	// blocks are independent and encoded into their own slots, so output order does not depend on threads
+	volatile int nextBlock = 0;
+	auto encodeBlocks = [&](void*, int) {
+		int i;
+		while ((i = Atomic::Increment(nextBlock) - 1) < numBlocks)
+		{
+			const BlockTask& task = blockTasks[i];
+			encodedSizes[i] = EncodeBlock(m_pendingData.ptr() + task.srcOffset, task.srcSize, task.blockFlags, encodedData.ptr() + i * DPK_BLOCK_MAXSIZE, blockInfos[i]);
+		}
+	};
+
+	const int numJobs = min(m_jobMng->GetJobThreadsCount(), numBlocks - 1);
+	Array<FunctionJob*> encodeJobs(PP_SL);
+	encodeJobs.reserve(numJobs);
+	for (int i = 0; i < numJobs; ++i)
+	{
+		FunctionJob* job = PPNew FunctionJob("DPKEncodeBlocks", encodeBlocks);
+		job->InitSignal();
+		m_jobMng->InitStartJob(job);
+		encodeJobs.append(job);
+	}
+
+	// this thread is also working
+	encodeBlocks(nullptr, 0);
+
+	// job manager may be shared, only wait for our own jobs
+	for (FunctionJob* job : encodeJobs)
+	{
+		job->GetSignal()->Wait();
+		delete job;
+	}
+
+	// write files in order they were added
+	int blockIdx = 0;
+	for (int i = 0; i < m_pendingFiles.numElem(); ++i)
+	{
+		dpkfileinfo_t& pakInfo = (*m_files.find(m_pendingFiles[i].filenameHash)).pakInfo;
+		pakInfo.offset = m_output.Tell();
+		pakInfo.numBlocks = 0;
+
+		const int fileSize = pendingFileSize(i);
+		for (int offset = 0; offset < fileSize; offset += DPK_BLOCK_MAXSIZE, ++blockIdx)
+		{
+			m_output.Write(&blockInfos[blockIdx], sizeof(dpkblock_t));
+			m_output.Write(encodedData.ptr() + blockIdx * DPK_BLOCK_MAXSIZE, encodedSizes[blockIdx]);
+
+			m_packedSize += encodedSizes[blockIdx];
+			++pakInfo.numBlocks;
+		}
+	}
+
+	m_pendingFiles.clear();
+	m_pendingData.clear();
+}
+
 uint CDPKFileWriter::WriteDataToPackFile(IVirtualStream* fileData, dpkfileinfo_t& pakInfo, int packageFlags)
 {
 	// prepare stream to be read
@@ -130,7 +390,6 @@ uint CDPKFileWriter::WriteDataToPackFile(IVirtualStream* fileData, dpkfileinfo_t
 	fileData->Seek(0, VS_SEEK_SET);
 
 	// set the size and offset in the file bigfile
-	pakInfo.offset = m_output.Tell();
 	pakInfo.size = fileData->GetSize();
 	pakInfo.crc = fileData->GetCRC32();
 
@@ -142,13 +401,19 @@ uint CDPKFileWriter::WriteDataToPackFile(IVirtualStream* fileData, dpkfileinfo_t
 	if (!m_encrypted)
 		targetBlockFlags &= ~DPKFILE_FLAG_ENCRYPTED;
 
-	Array<ubyte*> readBuffer(PP_SL);
-	readBuffer.resize(DPK_BLOCK_MAXSIZE);
-
 	// compressed and encrypted files has to be put into blocks
 	// uncompressed files are bypassing blocks
 	if (!DPK_IsBlockFile(targetBlockFlags))
 	{
+		// keep files in order they were added
+		FlushPending();
+
+		pakInfo.offset = m_output.Tell();
+		pakInfo.flags = 0;
+
+		Array<ubyte> readBuffer(PP_SL);
+		readBuffer.setNum(DPK_BLOCK_MAXSIZE);
+
 		int numBlocks = 0;
 
 		// copy file block by block (assuming we have a large file)
@@ -168,22 +433,50 @@ uint CDPKFileWriter::WriteDataToPackFile(IVirtualStream* fileData, dpkfileinfo_t
 				break;
 		}
 
+		m_packedSize += pakInfo.size;
 		return pakInfo.size;
 	}
 
+	pakInfo.flags = targetBlockFlags;
+
+	// unchanged file from previous package
+	if (m_prevPackage.IsOpen())
+	{
+		FlushPending();
+
+		const uint64 prevPackedSize = m_packedSize;
+		if (CopyPreviousFile(pakInfo))
+			return (uint)(m_packedSize - prevPackedSize);
+	}
+
+	// queue for parallel compression
+	if (m_jobMng)
+	{
+		PendingFile& pending = m_pendingFiles.append();
+		pending.filenameHash = pakInfo.filenameHash;
+		pending.dataOffset = m_pendingData.numElem();
+
+		m_pendingData.setNum(pending.dataOffset + pakInfo.size);
+		fileData->Read(m_pendingData.ptr() + pending.dataOffset, 1, pakInfo.size);
+
+		if (m_pendingData.numElem() >= DPK_PENDING_MAXSIZE)
+			FlushPending();
+
+		return 0;
+	}
+
+	pakInfo.offset = m_output.Tell();
+
 	uint packedSize = 0;
 	pakInfo.numBlocks = 0;
 
-	// temporary block for both compression and encryption 
-	// twice the size
+	ubyte readBuffer[DPK_BLOCK_MAXSIZE];
 	ubyte tmpBlockData[DPK_BLOCK_MAXSIZE];
 
 	// write blocks
 	dpkblock_t blockInfo;
 	while (true)
 	{
-		memset(&blockInfo, 0, sizeof(dpkblock_t));
-
 		// get block offset
 		const int srcOffset = (int)pakInfo.numBlocks * DPK_BLOCK_MAXSIZE;
 		const int srcSize = min(DPK_BLOCK_MAXSIZE, ((int)pakInfo.size - srcOffset));
@@ -191,57 +484,10 @@ uint CDPKFileWriter::WriteDataToPackFile(IVirtualStream* fileData, dpkfileinfo_t
 		if (srcSize <= 0)
 			break; // EOF
 
-		blockInfo.size = srcSize;
-		fileData->Read(readBuffer.ptr(), 1, srcSize);
+		fileData->Read(readBuffer, 1, srcSize);
 
-		int compressedSize = -1;
-
-		// try compressing
-		if (targetBlockFlags & DPKFILE_FLAG_COMPRESSED)
-		{
-			memset(tmpBlockData, 0, sizeof(tmpBlockData));
-			compressedSize = LZ4_compress_HC((const char*)readBuffer.ptr(), (char*)tmpBlockData, srcSize, sizeof(tmpBlockData), m_compressionLevel);
-		}
-
-		// compressedSize could be -1 which means buffer overlow (or uneffective)
-		if (compressedSize > 0)
-		{
-			blockInfo.flags |= DPKFILE_FLAG_COMPRESSED;
-			blockInfo.compressedSize = compressedSize;
-			packedSize += compressedSize;
-		}
-		else
-		{
-			memcpy(tmpBlockData, readBuffer.ptr(), srcSize);
-			packedSize += srcSize;
-		}
-
-		const int tmpBlockSize = (blockInfo.flags & DPKFILE_FLAG_COMPRESSED) ? blockInfo.compressedSize : srcSize;
-
-		// encrypt tmpBlock
-		if (targetBlockFlags & DPKFILE_FLAG_ENCRYPTED)
-		{
-			blockInfo.flags |= DPKFILE_FLAG_ENCRYPTED;
-
-			const int iceBlockSize = m_ice.blockSize();
-
-			ubyte* iceTempBlock = (ubyte*)stackalloc(iceBlockSize);
-			ubyte* tmpBlockPtr = tmpBlockData;
-
-			int bytesLeft = tmpBlockSize;
-
-			// encrypt block by block
-			while (bytesLeft > iceBlockSize)
-			{
-				m_ice.encrypt(tmpBlockPtr, iceTempBlock);
-
-				// copy encrypted block
-				memcpy(tmpBlockPtr, iceTempBlock, iceBlockSize);
-
-				tmpBlockPtr += iceBlockSize;
-				bytesLeft -= iceBlockSize;
-			}
-		}
+		const int tmpBlockSize = EncodeBlock(readBuffer, srcSize, targetBlockFlags, tmpBlockData, blockInfo);
+		packedSize += tmpBlockSize;
 
 		// write header and data
 		m_output.Write(&blockInfo, sizeof(blockInfo));
@@ -254,6 +500,7 @@ uint CDPKFileWriter::WriteDataToPackFile(IVirtualStream* fileData, dpkfileinfo_t
 			break;
 	}
 
+	m_packedSize += packedSize;
 	return packedSize;
 }
 
@@ -17,6 +17,7 @@
 #include "core/platform/OSFile.h"
 
 class IVirtualStream;
+class CEqJobManager;
 
 class CDPKFileWriter
 {
@@ -24,9 +25,18 @@ public:
 	CDPKFileWriter(const char* mountPath, int compression = 0, const char* encryptKey = nullptr, bool skipPacking = false);
 	~CDPKFileWriter();
 
+	// blocks are compressed in parallel when job manager is set
+	// files are queued and written to the package in the order they were added
+	void					SetJobManager(CEqJobManager* jobMng) { m_jobMng = jobMng; }
+
+	// incremental mode - blocks of files with same CRC and size are copied from previous package
+	// encrypted files are always encoded again
+	bool					SetPreviousPackage(const char* fileName, ESearchPath searchPath = SP_ROOT);
+
 	bool					Begin(const char* fileName, ESearchPath searchPath = SP_ROOT);
 
 	// adds data to the pack file
+	// returns packed size or 0 if file was queued for compression
 	uint					Add(IVirtualStream* fileData, const char* fileName, int packageFlags = 0xff);
 
 #if 0
@@ -38,9 +48,20 @@ public:
 	int						End(bool storeFileList = false);
 
 	int						GetFileCount() const { return m_files.size(); }
+	uint64					GetPackedSize() const { return m_packedSize; }
+	int						GetReusedFileCount() const { return m_reusedFiles; }
 
 protected:
 	uint					WriteDataToPackFile(IVirtualStream* fileData, dpkfileinfo_t& pakInfo, int packageFlags = 0xff);
+	int						EncodeBlock(const ubyte* srcData, int srcSize, int blockFlags, ubyte* dstData, dpkblock_t& blockInfo) const;
+	bool					CopyPreviousFile(dpkfileinfo_t& pakInfo);
+	void					FlushPending();
+
+	struct PendingFile
+	{
+		int				filenameHash;
+		int				dataOffset;
+	};
 
 	struct FileInfo
 	{
@@ -61,6 +82,17 @@ protected:
 	Array<CMemoryStream*>	m_openStreams{ PP_SL };
 	Map<int, FileInfo>		m_files{ PP_SL };
 
+	CEqJobManager*			m_jobMng{ nullptr };
+	Array<PendingFile>		m_pendingFiles{ PP_SL };
+	Array<ubyte>			m_pendingData{ PP_SL };
+
+	COSFile					m_prevPackage;
+	HashMap<uint64, dpkfileinfo_t>	m_prevFiles{ PP_SL };	// keyed by CRC and size
+	int						m_prevCompressionLevel{ -1 };
+
+	uint64					m_packedSize{ 0 };
+	int						m_reusedFiles{ 0 };
+
 	int						m_compressionLevel{ 0 };
 	bool					m_encrypted{ false };
 	bool					m_skipPacking{ false };
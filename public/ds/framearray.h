@@ -0,0 +1,177 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2024
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Array and string in per-thread frame memory
+//
+//				Must not outlive the next frame, see core/framealloc.h
+//////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+template< typename T >
+class FrameArrayStorage
+{
+public:
+	FrameArrayStorage()
+		: m_sl(PPSourceLine::Empty())
+	{
+	}
+
+	FrameArrayStorage(const PPSourceLine& sl, int granularity)
+		: m_sl(sl), m_nGranularity(granularity)
+	{
+	}
+
+	FrameArrayStorage(const FrameArrayStorage& other)
+		: m_sl(other.m_sl), m_nGranularity(other.m_nGranularity)
+	{
+		int numElem = 0;
+		resize(other.m_nSize, numElem);
+	}
+
+	FrameArrayStorage(FrameArrayStorage&& other)
+		: m_sl(other.m_sl), m_nGranularity(other.m_nGranularity)
+	{
+		m_pListPtr = other.m_pListPtr;
+		m_nSize = other.m_nSize;
+		m_frameIndex = other.m_frameIndex;
+		other.m_pListPtr = nullptr;
+		other.m_nSize = 0;
+	}
+
+	// frame memory is not freed
+	void free()
+	{
+		m_pListPtr = nullptr;
+		m_nSize = 0;
+	}
+
+	int calculateGranulatedCapacity(int capacity)
+	{
+		return (capacity + m_nGranularity - 1) / m_nGranularity * m_nGranularity;
+	}
+
+	void resize(int newCapacity, int& numOfElements)
+	{
+		ASSERT_MSG(newCapacity >= 0, "FrameArrayStorage<%s> requested capacity is %d", typeid(T).name(), newCapacity);
+		ASSERT_MSG(!m_pListPtr || FrameAllocIsAlive(m_frameIndex), "FrameArrayStorage<%s> of %s:%d is used after its frame has ended", typeid(T).name(), m_sl.GetFileName(), m_sl.GetLine());
+
+		if (newCapacity <= 0)
+		{
+			free();
+			return;
+		}
+
+		const int newCapacityWithGranularity = calculateGranulatedCapacity(newCapacity);
+		if (newCapacityWithGranularity == m_nSize)
+			return;
+
+		if (newCapacityWithGranularity < numOfElements)
+			numOfElements = newCapacityWithGranularity;
+
+		m_pListPtr = reinterpret_cast<T*>(FrameDReAlloc(m_pListPtr, m_nSize * sizeof(T), newCapacityWithGranularity * sizeof(T), alignof(T), m_sl));
+		m_nSize = newCapacityWithGranularity;
+		m_frameIndex = FrameAllocGetFrameIndex();
+	}
+
+	int			getSize() const						{ return m_nSize; }
+	int			getGranularity() const				{ return m_nGranularity; }
+	void		setGranularity(int newGranularity)	{ m_nGranularity = newGranularity; }
+
+	T*			getData()							{ return m_pListPtr; }
+	const T*	getData() const						{ return m_pListPtr; }
+
+	void swap(FrameArrayStorage& other)
+	{
+		QuickSwap(m_nSize, other.m_nSize);
+		QuickSwap(m_nGranularity, other.m_nGranularity);
+		QuickSwap(m_pListPtr, other.m_pListPtr);
+		QuickSwap(m_frameIndex, other.m_frameIndex);
+	}
+
+	const PPSourceLine	getSL() const { return m_sl; }
+
+protected:
+	const PPSourceLine	m_sl;
+	T*					m_pListPtr{ nullptr };
+	int64				m_frameIndex{ 0 };
+
+	int					m_nSize{ 0 };
+	int					m_nGranularity{ 16 };
+};
+
+template< typename T >
+using FrameArray = ArrayBase<T, FrameArrayStorage<T>>;
+
+//-------------------------------------------
+// Null-terminated string in frame memory
+
+class FrameString
+{
+public:
+	FrameString() = default;
+	FrameString(EqStringRef str)			{ Append(str); }
+
+	template <typename... Args>
+	static FrameString Format(const char* pszFormat, Args&&... args)
+	{
+		FrameString str;
+		str.AppendFormatF(pszFormat, StrToFmt(std::forward<Args>(args))...);
+		return str;
+	}
+
+	const char*	ToCString() const			{ return m_chars.numElem() ? m_chars.ptr() : ""; }
+	EqStringRef	Ref() const					{ return EqStringRef(ToCString(), Length()); }
+	int			Length() const				{ return max(m_chars.numElem() - 1, 0); }
+
+	operator	const char* () const		{ return ToCString(); }
+	operator	EqStringRef () const		{ return Ref(); }
+
+	void		Clear()						{ m_chars.clear(); }
+
+	void		Append(char c)				{ Append(EqStringRef(&c, 1)); }
+	void		Append(EqStringRef str);
+
+	template <typename... Args>
+	void		AppendFormat(const char* pszFormat, Args&&... args) { AppendFormatF(pszFormat, StrToFmt(std::forward<Args>(args))...); }
+	void		AppendFormatF(const char* pszFormat, ...);
+
+private:
+	char*		AppendSpace(int length);
+
+	FrameArray<char>	m_chars;	// with null terminator
+};
+
+inline char* FrameString::AppendSpace(int length)
+{
+	const int oldLength = Length();
+	m_chars.setNum(oldLength + length + 1, false);
+	m_chars[oldLength + length] = 0;
+	return m_chars.ptr() + oldLength;
+}
+
+inline void FrameString::Append(EqStringRef str)
+{
+	if (!str.Length())
+		return;
+	memcpy(AppendSpace(str.Length()), str.ToCString(), str.Length());
+}
+
+inline void FrameString::AppendFormatF(const char* pszFormat, ...)
+{
+	va_list argptr;
+	va_start(argptr, pszFormat);
+	va_list argptrCopy;
+	va_copy(argptrCopy, argptr);
+	const int length = vsnprintf(nullptr, 0, pszFormat, argptr);
+	va_end(argptr);
+
+	if (length > 0)
+	{
+		// vsnprintf writes null terminator to the space reserved by AppendSpace
+		char* dest = AppendSpace(length);
+		vsnprintf(dest, length + 1, pszFormat, argptrCopy);
+	}
+	va_end(argptrCopy);
+}
@@ -0,0 +1,540 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2024
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Open-addressing hash map and set
+//
+//				SwissTable-style layout: one control byte per slot holds
+//				7 bits of key hash, slots are probed in groups of 16 bytes
+//				with SSE2 compares. Items are unordered and their addresses
+//				change on rehash, unlike in Map.
+//////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HASHMAP_SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static inline uint64 HashMapMix(uint64 value)
+{
+	// murmur3 finalizer
+	value ^= value >> 33;
+	value *= 0xff51afd7ed558ccdull;
+	value ^= value >> 33;
+	value *= 0xc4ceb9fe1a85ec53ull;
+	value ^= value >> 33;
+	return value;
+}
+
+static inline uint64 HashMapHashBytes(const void* data, int length)
+{
+	const ubyte* bytes = static_cast<const ubyte*>(data);
+
+	uint64 hash = 0x9e3779b97f4a7c15ull ^ static_cast<uint64>(length);
+	for (; length >= 8; bytes += 8, length -= 8)
+	{
+		uint64 word;
+		memcpy(&word, bytes, 8);
+		hash = (hash ^ HashMapMix(word)) * 0x9e3779b97f4a7c15ull;
+	}
+
+	uint64 tail = 0;
+	memcpy(&tail, bytes, length);
+	return HashMapMix(hash ^ tail);
+}
+
+// integral, enum and pointer keys; specialize for other key types
+template<typename K>
+struct HashMapHasher
+{
+	static uint64 hash(const K& key)
+	{
+		if constexpr (std::is_pointer_v<K>)
+			return HashMapMix(reinterpret_cast<uintptr_t>(key));
+		else
+		{
+			static_assert(std::is_integral_v<K> || std::is_enum_v<K>, "HashMapHasher is not specialized for key type");
+			return HashMapMix(static_cast<uint64>(key));
+		}
+	}
+};
+
+template<>
+struct HashMapHasher<EqString>
+{
+	static uint64 hash(const EqString& key) { return HashMapHashBytes(key.ToCString(), key.Length()); }
+};
+
+template<>
+struct HashMapHasher<EqStringRef>
+{
+	static uint64 hash(const EqStringRef& key) { return HashMapHashBytes(key.ToCString(), key.Length()); }
+};
+
+//-------------------------------------------
+// 16 control bytes probed at once
+
+struct HashMapGroup
+{
+	static constexpr const int WIDTH = 16;
+
+	static constexpr const int8 CTRL_EMPTY = -128;
+	static constexpr const int8 CTRL_DELETED = -2;
+
+#ifdef HASHMAP_SSE2
+	HashMapGroup(const int8* ctrl)
+		: m_ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl)))
+	{
+	}
+
+	uint match(int8 h2) const				{ return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), m_ctrl)); }
+	uint matchEmptyOrDeleted() const		{ return _mm_movemask_epi8(m_ctrl); }
+
+	__m128i		m_ctrl;
+#else
+	HashMapGroup(const int8* ctrl)
+		: m_ctrl(ctrl)
+	{
+	}
+
+	uint match(int8 h2) const
+	{
+		uint mask = 0;
+		for (int i = 0; i < WIDTH; ++i)
+			mask |= static_cast<uint>(m_ctrl[i] == h2) << i;
+		return mask;
+	}
+
+	uint matchEmptyOrDeleted() const
+	{
+		uint mask = 0;
+		for (int i = 0; i < WIDTH; ++i)
+			mask |= static_cast<uint>(m_ctrl[i] < 0) << i;
+		return mask;
+	}
+
+	const int8*	m_ctrl;
+#endif // HASHMAP_SSE2
+
+	uint matchEmpty() const					{ return match(CTRL_EMPTY); }
+
+	static int lowestBit(uint mask)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return index;
+#else
+		return __builtin_ctz(mask);
+#endif
+	}
+
+	static int highestBit(uint mask)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse(&index, mask);
+		return index;
+#else
+		return 31 - __builtin_clz(mask);
+#endif
+	}
+};
+
+//-------------------------------------------
+
+template<typename K, typename V>
+class HashMap
+{
+private:
+	struct Slot
+	{
+		K						key;
+		RawItem<V, alignof(V)>	value;
+	};
+
+public:
+	class Iterator
+	{
+	public:
+		Iterator() = default;
+
+		const K&		key() const { return m_slots[m_index].key; }
+		const V&		value() const { return *m_slots[m_index].value; }
+
+		bool			atEnd() const { return m_index >= m_capacity; }
+
+		const V&		operator*() const { return *m_slots[m_index].value; }
+		V&				operator*() { return *m_slots[m_index].value; }
+		const V*		operator->() const { return &(*m_slots[m_index].value); }
+		V*				operator->() { return &(*m_slots[m_index].value); }
+		bool			operator==(const Iterator& other) const { return m_index == other.m_index; }
+		bool			operator!=(const Iterator& other) const { return m_index != other.m_index; }
+
+		const Iterator& operator++()
+		{
+			do {
+				++m_index;
+			} while (m_index < m_capacity && m_ctrl[m_index] < 0);
+			return *this;
+		}
+
+	private:
+		Slot*			m_slots{ nullptr };
+		const int8*		m_ctrl{ nullptr };
+		int				m_index{ 0 };
+		int				m_capacity{ 0 };
+
+		Iterator(const HashMap& map, int index)
+			: m_slots(map.m_slots), m_ctrl(map.m_ctrl), m_index(index), m_capacity(map.m_capacity)
+		{}
+
+		friend class HashMap;
+	};
+
+public:
+	HashMap(const PPSourceLine& sl)
+		: m_sl(sl)
+	{
+	}
+
+	HashMap(const HashMap& other)
+		: m_sl(other.m_sl)
+	{
+		insert(other);
+	}
+
+	HashMap(HashMap&& other) noexcept
+		: m_sl(other.m_sl)
+	{
+		swap(other);
+	}
+
+	~HashMap()
+	{
+		clear(true);
+	}
+
+	HashMap& operator=(const HashMap& other)
+	{
+		if (this == &other)
+			return *this;
+
+		clear();
+		insert(other);
+		return *this;
+	}
+
+	HashMap& operator=(HashMap&& other) noexcept
+	{
+		clear(true);
+		swap(other);
+		return *this;
+	}
+
+	Iterator		begin() const
+	{
+		Iterator it(*this, -1);
+		return ++it;
+	}
+
+	Iterator		end() const { return Iterator(*this, m_capacity); }
+
+	int				size() const { return m_size; }
+	bool			isEmpty() const { return m_size == 0; }
+	int				capacity() const { return m_capacity; }
+
+	void swap(HashMap& other)
+	{
+		QuickSwap(m_slots, other.m_slots);
+		QuickSwap(m_ctrl, other.m_ctrl);
+		QuickSwap(m_capacity, other.m_capacity);
+		QuickSwap(m_size, other.m_size);
+		QuickSwap(m_deleted, other.m_deleted);
+	}
+
+	void clear(bool deallocate = false)
+	{
+		for (int i = 0; i < m_capacity && m_size > 0; ++i)
+		{
+			if (m_ctrl[i] < 0)
+				continue;
+
+			destroySlot(m_slots[i]);
+			--m_size;
+		}
+
+		if (deallocate)
+		{
+			PPFree(m_slots);
+			m_slots = nullptr;
+			m_ctrl = nullptr;
+			m_capacity = 0;
+		}
+		else if (m_capacity)
+			memset(m_ctrl, HashMapGroup::CTRL_EMPTY, m_capacity + HashMapGroup::WIDTH);
+
+		m_size = 0;
+		m_deleted = 0;
+	}
+
+	// allocates enough slots to insert count items without rehash
+	void reserve(int count)
+	{
+		int newCapacity = HashMapGroup::WIDTH;
+		while (maxLoad(newCapacity) < count)
+			newCapacity *= 2;
+
+		if (newCapacity > m_capacity)
+			rehash(newCapacity);
+	}
+
+	Iterator find(const K& key) const
+	{
+		const int index = findIndex(key, HashMapHasher<K>::hash(key));
+		return index != -1 ? Iterator(*this, index) : end();
+	}
+
+	bool contains(const K& key) const
+	{
+		return findIndex(key, HashMapHasher<K>::hash(key)) != -1;
+	}
+
+	int count(const K& key) const
+	{
+		return contains(key) ? 1 : 0;
+	}
+
+	V& operator[](const K& key)
+	{
+		return *insert(key);
+	}
+
+	// inserts default value if key is not present
+	Iterator insert(const K& key)
+	{
+		const uint64 hash = HashMapHasher<K>::hash(key);
+
+		int index = findIndex(key, hash);
+		if (index == -1)
+		{
+			index = insertIndex(hash);
+
+			Slot& slot = m_slots[index];
+			new(&slot.key) K(key);
+			PPSLPlacementNew<V>(&(*slot.value), m_sl);
+		}
+		return Iterator(*this, index);
+	}
+
+	Iterator insert(const K& key, const V& value)
+	{
+		Iterator it = insert(key);
+		*it = value;
+		return it;
+	}
+
+	Iterator insert(const K& key, V&& value)
+	{
+		Iterator it = insert(key);
+		*it = std::move(value);
+		return it;
+	}
+
+	void insert(const HashMap& other)
+	{
+		reserve(m_size + other.m_size);
+		for (Iterator it = other.begin(); !it.atEnd(); ++it)
+			insert(it.key(), *it);
+	}
+
+	void remove(const K& key)
+	{
+		const int index = findIndex(key, HashMapHasher<K>::hash(key));
+		if (index != -1)
+			removeIndex(index);
+	}
+
+	// returns iterator to the next item
+	Iterator remove(const Iterator& it)
+	{
+		removeIndex(it.m_index);
+
+		Iterator next = it;
+		return ++next;
+	}
+
+private:
+	static int maxLoad(int capacity)
+	{
+		return capacity - capacity / 8;
+	}
+
+	static int8 hashH2(uint64 hash) { return static_cast<int8>(hash & 0x7f); }
+	static int hashH1(uint64 hash) { return static_cast<int>(hash >> 7); }
+
+	void setCtrl(int index, int8 h2)
+	{
+		m_ctrl[index] = h2;
+
+		// first group is mirrored past the end so any slot can start a group load
+		if (index < HashMapGroup::WIDTH)
+			m_ctrl[m_capacity + index] = h2;
+	}
+
+	void destroySlot(Slot& slot)
+	{
+		(*slot.value).~V();
+		slot.key.~K();
+	}
+
+	int findIndex(const K& key, uint64 hash) const
+	{
+		if (!m_size)
+			return -1;
+
+		const int8 h2 = hashH2(hash);
+		const int mask = m_capacity - 1;
+
+		// triangular probing by groups visits every slot when capacity is power of two
+		int pos = hashH1(hash) & mask;
+		for (int step = HashMapGroup::WIDTH; ; step += HashMapGroup::WIDTH)
+		{
+			const HashMapGroup group(m_ctrl + pos);
+			for (uint match = group.match(h2); match; match &= match - 1)
+			{
+				const int index = (pos + HashMapGroup::lowestBit(match)) & mask;
+				if (m_slots[index].key == key)
+					return index;
+			}
+
+			if (group.matchEmpty())
+				return -1;
+
+			pos = (pos + step) & mask;
+		}
+	}
+
+	// returns free slot for new key, key must not be present
+	int insertIndex(uint64 hash)
+	{
+		if (m_size + m_deleted >= maxLoad(m_capacity))
+		{
+			// drop tombstones in place if there are many of them
+			const bool grow = m_size + 1 > m_capacity * 7 / 16;
+			rehash(grow ? max(m_capacity * 2, HashMapGroup::WIDTH) : m_capacity);
+		}
+
+		const int index = findFreeIndex(m_ctrl, m_capacity, hash);
+		if (m_ctrl[index] == HashMapGroup::CTRL_DELETED)
+			--m_deleted;
+
+		setCtrl(index, hashH2(hash));
+		++m_size;
+		return index;
+	}
+
+	static int findFreeIndex(const int8* ctrl, int capacity, uint64 hash)
+	{
+		const int mask = capacity - 1;
+
+		int pos = hashH1(hash) & mask;
+		for (int step = HashMapGroup::WIDTH; ; step += HashMapGroup::WIDTH)
+		{
+			const uint freeMask = HashMapGroup(ctrl + pos).matchEmptyOrDeleted();
+			if (freeMask)
+				return (pos + HashMapGroup::lowestBit(freeMask)) & mask;
+
+			pos = (pos + step) & mask;
+		}
+	}
+
+	void removeIndex(int index)
+	{
+		ASSERT_MSG(index >= 0 && index < m_capacity && m_ctrl[index] >= 0, "HashMap::remove - invalid iterator");
+
+		destroySlot(m_slots[index]);
+		--m_size;
+
+		// slot can become empty if no probe window passing through it was ever full
+		const int mask = m_capacity - 1;
+		const uint emptyBefore = HashMapGroup(m_ctrl + ((index - HashMapGroup::WIDTH) & mask)).matchEmpty();
+		const uint emptyAfter = HashMapGroup(m_ctrl + index).matchEmpty();
+
+		const bool wasNeverFull = emptyBefore && emptyAfter &&
+			HashMapGroup::lowestBit(emptyAfter) + (HashMapGroup::WIDTH - 1 - HashMapGroup::highestBit(emptyBefore)) < HashMapGroup::WIDTH;
+
+		if (wasNeverFull)
+		{
+			setCtrl(index, HashMapGroup::CTRL_EMPTY);
+		}
+		else
+		{
+			setCtrl(index, HashMapGroup::CTRL_DELETED);
+			++m_deleted;
+		}
+	}
+
+	void rehash(int newCapacity)
+	{
+		ASSERT_MSG((newCapacity & (newCapacity - 1)) == 0, "HashMap capacity %d must be power of two", newCapacity);
+
+		const size_t slotsSize = sizeof(Slot) * newCapacity;
+		const size_t ctrlSize = newCapacity + HashMapGroup::WIDTH;
+
+		Slot* newSlots = reinterpret_cast<Slot*>(PPDAlloc(slotsSize + ctrlSize, m_sl));
+		int8* newCtrl = reinterpret_cast<int8*>(newSlots + newCapacity);
+		memset(newCtrl, HashMapGroup::CTRL_EMPTY, ctrlSize);
+
+		Slot* oldSlots = m_slots;
+		const int8* oldCtrl = m_ctrl;
+		const int oldCapacity = m_capacity;
+
+		m_slots = newSlots;
+		m_ctrl = newCtrl;
+		m_capacity = newCapacity;
+		m_deleted = 0;
+
+		for (int i = 0; i < oldCapacity; ++i)
+		{
+			if (oldCtrl[i] < 0)
+				continue;
+
+			Slot& oldSlot = oldSlots[i];
+			const uint64 hash = HashMapHasher<K>::hash(oldSlot.key);
+			const int index = findFreeIndex(m_ctrl, m_capacity, hash);
+			setCtrl(index, hashH2(hash));
+
+			Slot& slot = m_slots[index];
+			new(&slot.key) K(std::move(oldSlot.key));
+			new(&(*slot.value)) V(std::move(*oldSlot.value));
+			destroySlot(oldSlot);
+		}
+
+		PPFree(oldSlots);
+	}
+
+	const PPSourceLine	m_sl;
+	Slot*				m_slots{ nullptr };
+	int8*				m_ctrl{ nullptr };
+	int					m_capacity{ 0 };
+	int					m_size{ 0 };
+	int					m_deleted{ 0 };
+};
+
+template<typename K>
+using HashSet = HashMap<K, _EMPTY_VALUE>;
+
+// nesting Source-line constructor helper
+template<typename K, typename V>
+struct PPSLValueCtor<HashMap<K, V>>
+{
+	HashMap<K, V> x;
+	PPSLValueCtor<HashMap<K, V>>(const PPSourceLine& sl) : x(sl) {}
+};
@@ -120,6 +120,46 @@ void insertionSort(ITER first, ITER last, const CMP& comparator)
 	}
 }
 
+// partitions range around median-of-three pivot, returns final pivot position
+// elements before pivot are less than pivot, elements after are greater or equal
+template<typename ITER, typename CMP>
+ITER introSortPartition(ITER first, ITER last, const CMP& comparator)
+{
+	ITER mid = first + (last - first + 1) / 2;
+	if (comparator(*first, *mid) > 0)
+		QuickSwap(*first, *mid);
+
+	if(comparator(*first, *last) > 0)
+		QuickSwap(*first, *last);
+
+	if (comparator(*mid, *last) > 0)
+		QuickSwap(*mid, *last);
+
+	QuickSwap(*mid, *(last - 1));
+	ITER mi = last - 1;
+
+	ITER lo = first + 1;
+	ITER hi = last - 2;
+	for (;;)
+	{
+		while (comparator(*lo, *mi) < 0)
+			++lo;
+
+		while (lo < hi && comparator(*hi, *mi) >= 0)
+			--hi;
+
+		if (lo >= hi)
+			break;
+
+		QuickSwap(*lo, *hi);
+		++lo;
+		--hi;
+	}
+
+	QuickSwap(*lo, *(last - 1));
+	return lo;
+}
+
 template<typename ITER, typename CMP >
 void introSort(ITER first, ITER last, int depth, const CMP& comparator)
 {
@@ -133,38 +173,7 @@ void introSort(ITER first, ITER last, int depth, const CMP& comparator)
 			return;
 		}
 
-		ITER mid = first + (last - first + 1) / 2;
-		if (comparator(*first, *mid) > 0)
-			QuickSwap(*first, *mid);
-
-		if(comparator(*first, *last) > 0)
-			QuickSwap(*first, *last);
-
-		if (comparator(*mid, *last) > 0)
-			QuickSwap(*mid, *last);
-
-		QuickSwap(*mid, *(last - 1));
-		ITER mi = last - 1;
-
-		ITER lo = first + 1;
-		ITER hi = last - 2;
-		for (;;)
-		{
-			while (comparator(*lo, *mi) < 0)
-				++lo;
-
-			while (lo < hi && comparator(*hi, *mi) >= 0)
-				--hi;
-
-			if (lo >= hi)
-				break;
-
-			QuickSwap(*lo, *hi);
-			++lo;
-			--hi;
-		}
-
-		QuickSwap(*lo, * (last - 1));
+		ITER lo = introSortPartition(first, last, comparator);
 		introSort(lo + 1, last, depth, comparator);
 		last = lo - 1;
 	}
@@ -210,6 +219,241 @@ void arraySort(ARRAY_TYPE& arr, const CMP& comparator)
 	arraySort(arr.ptr(), arr.ptr() + arr.numElem(), comparator);
 }
 
+// -----------------------------------------------------------------
+// Selection and partial sort
+// -----------------------------------------------------------------
+
+// rearranges elements so that nth is the element which would be there in sorted range,
+// elements before nth are less or equal and elements after are greater or equal
+template<typename ITER, typename CMP>
+void arrayNthElement(ITER begin, ITER nth, ITER end, const CMP& comparator)
+{
+	if (nth < begin || nth >= end)
+		return;
+
+	constexpr const int MIN_SELECT_RANGE = 10;
+
+	ITER first = begin;
+	ITER last = end - 1;
+	int depth = introSortDepth(end - begin);
+	while (first + MIN_SELECT_RANGE < last)
+	{
+		--depth;
+		if (depth == 0)
+		{
+			heapSort(first, last, comparator);
+			return;
+		}
+
+		ITER lo = introSortPartition(first, last, comparator);
+		if (lo == nth)
+			return;
+
+		if (nth < lo)
+			last = lo - 1;
+		else
+			first = lo + 1;
+	}
+	insertionSort(first, last, comparator);
+}
+
+template<typename ARRAY_TYPE, typename CMP>
+void arrayNthElement(ARRAY_TYPE& arr, int nth, const CMP& comparator)
+{
+	arrayNthElement(arr.ptr(), arr.ptr() + nth, arr.ptr() + arr.numElem(), comparator);
+}
+
+// sorts only the [begin, middle) range with the smallest elements, the rest is left unordered
+template<typename ITER, typename CMP>
+void arrayPartialSort(ITER begin, ITER middle, ITER end, const CMP& comparator)
+{
+	if (middle <= begin)
+		return;
+
+	if (middle >= end)
+	{
+		arraySort(begin, end, comparator);
+		return;
+	}
+
+	// nth element is placed and the rest before it is not greater
+	arrayNthElement(begin, middle - 1, end, comparator);
+	arraySort(begin, middle - 1, comparator);
+}
+
+template<typename ARRAY_TYPE, typename CMP>
+void arrayPartialSort(ARRAY_TYPE& arr, int count, const CMP& comparator)
+{
+	arrayPartialSort(arr.ptr(), arr.ptr() + count, arr.ptr() + arr.numElem(), comparator);
+}
+
+// -----------------------------------------------------------------
+// Stable merge sort
+// -----------------------------------------------------------------
+
+// merges two sorted ranges into dest, equal elements of first range go first
+template<typename ITER, typename CMP>
+ITER arrayMerge(ITER first1, ITER last1, ITER first2, ITER last2, ITER dest, const CMP& comparator)
+{
+	while (first1 < last1 && first2 < last2)
+	{
+		if (comparator(*first2, *first1) < 0)
+			*dest++ = std::move(*first2++);
+		else
+			*dest++ = std::move(*first1++);
+	}
+
+	while (first1 < last1)
+		*dest++ = std::move(*first1++);
+
+	while (first2 < last2)
+		*dest++ = std::move(*first2++);
+
+	return dest;
+}
+
+// stable sort, temp must have space for (end - begin) elements
+template<typename ITER, typename CMP>
+void mergeSort(ITER begin, ITER end, ITER temp, const CMP& comparator)
+{
+	constexpr const int MIN_MERGE_RANGE = 16;
+
+	const int count = end - begin;
+	if (count <= 1)
+		return;
+
+	// insertion sort is stable and fast on small runs
+	for (int i = 0; i < count; i += MIN_MERGE_RANGE)
+		insertionSort(begin + i, begin + min(i + MIN_MERGE_RANGE, count) - 1, comparator);
+
+	ITER src = begin;
+	ITER dst = temp;
+	for (int width = MIN_MERGE_RANGE; width < count; width *= 2)
+	{
+		for (int i = 0; i < count; i += width * 2)
+		{
+			const int mid = min(i + width, count);
+			const int last = min(i + width * 2, count);
+			arrayMerge(src + i, src + mid, src + mid, src + last, dst + i, comparator);
+		}
+		QuickSwap(src, dst);
+	}
+
+	if (src != begin)
+	{
+		for (int i = 0; i < count; ++i)
+			*(begin + i) = std::move(*(src + i));
+	}
+
+	ASSERT(arrayIsSorted(begin, end, comparator));
+}
+
+template<typename ARRAY_TYPE, typename CMP>
+void arrayStableSort(ARRAY_TYPE& arr, ARRAY_TYPE& temp, const CMP& comparator)
+{
+	temp.setNum(arr.numElem(), false);
+	mergeSort(arr.ptr(), arr.ptr() + arr.numElem(), temp.ptr(), comparator);
+}
+
+// -----------------------------------------------------------------
+// LSD Radix sort (stable, 8 bits per pass)
+// -----------------------------------------------------------------
+
+// maps key to unsigned integer with the same ordering
+inline uint radixSortKey(uint key) { return key; }
+inline uint radixSortKey(int key) { return uint(key) ^ 0x80000000u; }
+inline uint64 radixSortKey(uint64 key) { return key; }
+inline uint64 radixSortKey(int64 key) { return uint64(key) ^ 0x8000000000000000ull; }
+
+// negative floats are inverted, -0.0 goes before 0.0 and NaNs go to the ends by their sign
+inline uint radixSortKey(float key)
+{
+	uint bits;
+	memcpy(&bits, &key, sizeof(bits));
+	return bits ^ ((bits & 0x80000000u) ? 0xffffffffu : 0x80000000u);
+}
+
+inline uint64 radixSortKey(double key)
+{
+	uint64 bits;
+	memcpy(&bits, &key, sizeof(bits));
+	return bits ^ ((bits & 0x8000000000000000ull) ? 0xffffffffffffffffull : 0x8000000000000000ull);
+}
+
+// sorts elements by key returned by keyFunc(const T&) in ascending order
+// temp must have space for (end - begin) elements. Passes where all keys share same digit are skipped
+template<typename ITER, typename KEYFUNC>
+void radixSort(ITER begin, ITER end, ITER temp, const KEYFUNC& keyFunc)
+{
+	using KeyType = decltype(radixSortKey(keyFunc(*begin)));
+	constexpr const int NUM_PASSES = sizeof(KeyType);
+
+	const int count = end - begin;
+	if (count <= 1)
+		return;
+
+	int histogram[NUM_PASSES][256];
+	memset(histogram, 0, sizeof(histogram));
+
+	for (ITER it = begin; it < end; ++it)
+	{
+		const KeyType key = radixSortKey(keyFunc(*it));
+		for (int pass = 0; pass < NUM_PASSES; ++pass)
+			++histogram[pass][(key >> (pass * 8)) & 0xff];
+	}
+
+	ITER src = begin;
+	ITER dst = temp;
+	for (int pass = 0; pass < NUM_PASSES; ++pass)
+	{
+		const int shift = pass * 8;
+		int* offsets = histogram[pass];
+
+		const int firstDigit = int((radixSortKey(keyFunc(*src)) >> shift) & 0xff);
+		if (offsets[firstDigit] == count)
+			continue;
+
+		int offset = 0;
+		for (int i = 0; i < 256; ++i)
+		{
+			const int digitCount = offsets[i];
+			offsets[i] = offset;
+			offset += digitCount;
+		}
+
+		for (int i = 0; i < count; ++i)
+		{
+			const int digit = int((radixSortKey(keyFunc(*(src + i))) >> shift) & 0xff);
+			*(dst + offsets[digit]++) = std::move(*(src + i));
+		}
+		QuickSwap(src, dst);
+	}
+
+	if (src != begin)
+	{
+		for (int i = 0; i < count; ++i)
+			*(begin + i) = std::move(*(src + i));
+	}
+}
+
+// array wrapper, temp array is resized to fit
+template<typename ARRAY_TYPE, typename KEYFUNC>
+void arrayRadixSort(ARRAY_TYPE& arr, ARRAY_TYPE& temp, const KEYFUNC& keyFunc)
+{
+	temp.setNum(arr.numElem(), false);
+	radixSort(arr.ptr(), arr.ptr() + arr.numElem(), temp.ptr(), keyFunc);
+}
+
+// produces sorted order of indices [0..count) with keyFunc(int index),
+// used for sorting SoA data without moving it
+template<typename KEYFUNC>
+void radixSortIndices(int* indices, int* temp, int count, const KEYFUNC& keyFunc)
+{
+	for (int i = 0; i < count; ++i)
+		indices[i] = i;
+	radixSort(indices, indices + count, temp, keyFunc);
+}
+
 // -----------------------------------------------------------------
 // Search in arrays
 // -----------------------------------------------------------------
@@ -0,0 +1,143 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2024
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Parallel sort algorithms running on job manager
+//////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "core/platform/eqjobmanager.h"
+
+// runs func(taskIdx) for all tasks on job manager threads and calling thread
+template<typename F>
+void parallelSortRunTasks(CEqJobManager& jobMng, int numTasks, const F& func)
+{
+	volatile int nextTask = 0;
+	auto runTasks = [&](void*, int) {
+		int i;
+		while ((i = Atomic::Increment(nextTask) - 1) < numTasks)
+			func(i);
+	};
+
+	const int numJobs = min(jobMng.GetJobThreadsCount(), numTasks - 1);
+	Array<FunctionJob*> jobs(PP_SL);
+	jobs.reserve(numJobs);
+	for (int i = 0; i < numJobs; ++i)
+	{
+		FunctionJob* job = PPNew FunctionJob("ParallelSort", runTasks);
+		job->InitSignal();
+		jobMng.InitStartJob(job);
+		jobs.append(job);
+	}
+
+	runTasks(nullptr, 0);
+
+	// only wait for jobs started here, job manager may run other work
+	for (FunctionJob* job : jobs)
+	{
+		job->GetSignal()->Wait();
+		delete job;
+	}
+}
+
+// finds split of merge output position so that [0, i) of first range and [0, pos - i) of second
+// range are the first elements of the stable merge
+template<typename ITER, typename CMP>
+int parallelSortMergeSplit(ITER first1, int count1, ITER first2, int count2, int pos, const CMP& comparator)
+{
+	int lo = max(0, pos - count2);
+	int hi = min(pos, count1);
+	while (lo < hi)
+	{
+		const int i = (lo + hi) / 2;
+		const int j = pos - i;
+
+		// element of first range goes before equal element of second one
+		if (j > 0 && comparator(*(first2 + j - 1), *(first1 + i)) >= 0)
+			lo = i + 1;
+		else
+			hi = i;
+	}
+	return lo;
+}
+
+// sorts chunks on job threads and merges them in parallel
+// temp must have space for (end - begin) elements. The result is not stable
+template<typename ITER, typename CMP>
+void parallelSort(ITER begin, ITER end, ITER temp, const CMP& comparator, CEqJobManager& jobMng)
+{
+	constexpr const int MIN_PARALLEL_CHUNK = 8192;
+
+	const int count = end - begin;
+	const int numThreads = jobMng.GetJobThreadsCount() + 1;
+
+	// power of two chunks so they merge in pairs
+	int numChunks = 1;
+	while (numChunks < numThreads * 2 && count / (numChunks * 2) >= MIN_PARALLEL_CHUNK)
+		numChunks *= 2;
+
+	if (numChunks == 1)
+	{
+		arraySort(begin, end, comparator);
+		return;
+	}
+
+	const int chunkSize = (count + numChunks - 1) / numChunks;
+	parallelSortRunTasks(jobMng, numChunks, [&](int chunk) {
+		const int first = min(chunk * chunkSize, count);
+		const int last = min(first + chunkSize, count);
+		if (first + 1 < last)
+			introSort(begin + first, begin + last - 1, introSortDepth(last - first), comparator);
+	});
+
+	// each merge is split into parts so the final merges still use all threads
+	ITER src = begin;
+	ITER dst = temp;
+	for (int width = chunkSize; width < count; width *= 2)
+	{
+		const int numMerges = (count + width * 2 - 1) / (width * 2);
+		const int partsPerMerge = max(1, numChunks / numMerges);
+
+		parallelSortRunTasks(jobMng, numMerges * partsPerMerge, [&](int task) {
+			const int merge = task / partsPerMerge;
+			const int part = task % partsPerMerge;
+
+			const int first = merge * width * 2;
+			const int mid = min(first + width, count);
+			const int last = min(first + width * 2, count);
+			const int count1 = mid - first;
+			const int count2 = last - mid;
+
+			const int outStart = (count1 + count2) * part / partsPerMerge;
+			const int outEnd = (count1 + count2) * (part + 1) / partsPerMerge;
+
+			const int start1 = parallelSortMergeSplit(src + first, count1, src + mid, count2, outStart, comparator);
+			const int end1 = parallelSortMergeSplit(src + first, count1, src + mid, count2, outEnd, comparator);
+
+			arrayMerge(src + first + start1, src + first + end1,
+				src + mid + (outStart - start1), src + mid + (outEnd - end1),
+				dst + first + outStart, comparator);
+		});
+		QuickSwap(src, dst);
+	}
+
+	if (src != begin)
+	{
+		parallelSortRunTasks(jobMng, numChunks, [&](int chunk) {
+			const int first = min(chunk * chunkSize, count);
+			const int last = min(first + chunkSize, count);
+			for (int i = first; i < last; ++i)
+				*(begin + i) = std::move(*(src + i));
+		});
+	}
+
+	ASSERT(arrayIsSorted(begin, end, comparator));
+}
+
+// array wrapper, temp array is resized to fit
+template<typename ARRAY_TYPE, typename CMP>
+void arrayParallelSort(ARRAY_TYPE& arr, ARRAY_TYPE& temp, const CMP& comparator, CEqJobManager& jobMng)
+{
+	temp.setNum(arr.numElem(), false);
+	parallelSort(arr.ptr(), arr.ptr() + arr.numElem(), temp.ptr(), comparator, jobMng);
+}
@@ -7,7 +7,8 @@
 
 #pragma once
 
-static constexpr const int EQUILIBRIUM_MODEL_VERSION	= 13;
+static constexpr const int EQUILIBRIUM_MODEL_VERSION	= 14;
+static constexpr const int EQUILIBRIUM_MODEL_VERSION_13	= 13;	// no hardware vertex streams
 static constexpr const int EQUILIBRIUM_MODEL_SIGNATURE	= MAKECHAR4('E','Q','G','F');
 
 static constexpr const int MAX_MODEL_LODS				= 8;
@@ -23,6 +24,7 @@ static constexpr const uint8 EGF_INVALID_IDX = 0xff;
 enum EStudioFlags
 {
 	STUDIO_FLAG_NEW_VERTEX_FMT	= (1 << 0),
+	STUDIO_FLAG_HW_VERTEX_STREAMS	= (1 << 1),	// EGF 14: mesh vertices and indices are only in hardware vertex streams
 };
 
 enum EStudioLODFlags
@@ -38,6 +40,8 @@ enum EStudioVertexStreamType : int
 	STUDIO_VERTSTREAM_COLOR			= 3,
 
 	// TODO: more UVs
+
+	STUDIO_VERTSTREAM_COUNT
 };
 
 enum EStudioVertexStreamFlag : int
@@ -185,6 +189,69 @@ struct studioVertexDesc_s
 };
 ALIGNED_TYPE(studioVertexDesc_s, 4) studioVertexDesc_t;
 
+//-------------------------------------------
+// Hardware vertex streams (EGF version 14)
+// Vertices of all meshes in EGFHwVertex layout, uploaded to GPU as they are stored
+
+enum EStudioHwStreamFormat : int
+{
+	STUDIO_HWSTREAM_FMT_HALF = 0,		// obsolete, mesh streams are stored in the file too
+	STUDIO_HWSTREAM_FMT_QUANTIZED,		// half positions and UVs, 8 bit normalized TBN and bone weights
+};
+
+struct studioHwVertexPosUv_s
+{
+	TVec4D<half>	point;				// w is 1
+	TVec2D<half>	texCoord;
+};
+ALIGNED_TYPE(studioHwVertexPosUv_s, 4) studioHwVertexPosUv_t;
+
+// signed normalized unit vectors, w is unused
+struct studioHwVertexTBN_s
+{
+	int8			tangent[4];
+	int8			binormal[4];
+	int8			normal[4];
+};
+ALIGNED_TYPE(studioHwVertexTBN_s, 4) studioHwVertexTBN_t;
+
+struct studioHwBoneWeight_s
+{
+	int8			bones[MAX_MODEL_VERTEX_WEIGHTS];	// -1 for unused weights
+	uint8			weight[MAX_MODEL_VERTEX_WEIGHTS];	// 0..255 for 0..1
+};
+ALIGNED_TYPE(studioHwBoneWeight_s, 4) studioHwBoneWeight_t;
+
+// Vertex streams of all meshes of all mesh groups, ordered as in studioHdr_t.
+// Each mesh indices are already offset by its first vertex
+struct studioHwStreamsDesc_s
+{
+	int8				format;				// EStudioHwStreamFormat
+	int8				indexSize;			// 2 or 4
+	int8				vertexType;			// EStudioVertexStreamFlag, streams available
+	int8				unused;
+
+	int32				numVertices;
+	int32				numIndices;
+
+	Vector3D			boundsMin;
+	Vector3D			boundsMax;
+
+	int					streamOffsets[STUDIO_VERTSTREAM_COUNT];	// relative to this desc
+	int					indicesOffset;
+
+	inline ubyte* pStream(int streamId) const
+	{
+		return ((ubyte*)this) + streamOffsets[streamId];
+	}
+
+	inline ubyte* pIndices() const
+	{
+		return ((ubyte*)this) + indicesOffset;
+	}
+};
+ALIGNED_TYPE(studioHwStreamsDesc_s, 4) studioHwStreamsDesc_t;
+
 //-------------------------------------------
 
 // mesh
@@ -194,6 +261,8 @@ struct studioMeshDesc_s
 	int8				unused[3];
 
 	// Vertices stream
+	// With STUDIO_FLAG_HW_VERTEX_STREAMS vertexOffset and indicesOffset are first vertex and first index
+	// of mesh in hardware vertex streams, vertices are accessed with Studio_GetMeshVertex
 	int32				numVertices;
 	int					vertexOffset;			// pointer to points data
 
@@ -430,6 +499,18 @@ struct studioModelHeader_s
 		return (studioIkChain_t *)(((ubyte *)this) + ikChainsOffset) + i; 
 	};
 
+//---------------------------------------------------------------
+// hardware vertex streams (EGF_VERSION_CHANGE 14, valid with STUDIO_FLAG_HW_VERTEX_STREAMS)
+//---------------------------------------------------------------
+
+	int					hwStreamsOffset;			// hardware vertex streams offset
+
+	inline studioHwStreamsDesc_t* pHwStreams() const
+	{
+		if (!(flags & STUDIO_FLAG_HW_VERTEX_STREAMS))
+			return nullptr;
+		return (studioHwStreamsDesc_t *)(((ubyte *)this) + hwStreamsOffset);
+	};
 };
 ALIGNED_TYPE(studioModelHeader_s, 4) studioHdr_t;
 
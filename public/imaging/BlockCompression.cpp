@@ -0,0 +1,835 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2020
+//////////////////////////////////////////////////////////////////////////////////
+// Description: BCn texture block encoder
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "core/core_common.h"
+#include "core/platform/eqjobmanager.h"
+#include "math/Vector.h"
+
+#include "BlockCompression.h"
+
+static constexpr const int BC_JOB_BLOCK_ROWS = 4;		// rows of blocks in single tile
+static constexpr const int BC_REFINE_ITERATIONS = 2;
+
+bool IsBlockCompressSupported(const ETextureFormat format)
+{
+	switch (GetTexFormat(format))
+	{
+	case FORMAT_DXT1:
+	case FORMAT_DXT3:
+	case FORMAT_DXT5:
+	case FORMAT_ATI1N:
+	case FORMAT_ATI2N:
+	case FORMAT_BC7:
+		return true;
+	default:
+		break;
+	}
+	return false;
+}
+
+static void BCWriteBits(ubyte* dst, int& bitPos, uint value, int numBits)
+{
+	for (int i = 0; i < numBits; ++i, ++bitPos)
+	{
+		if (value & (1u << i))
+			dst[bitPos >> 3] |= 1 << (bitPos & 7);
+	}
+}
+
+static void BCPrincipalAxis(const float (*points)[4], int numChannels, float* axis)
+{
+	float mean[4] = { 0.0f };
+	for (int i = 0; i < BC_BLOCK_PIXELS; ++i)
+	{
+		for (int c = 0; c < numChannels; ++c)
+			mean[c] += points[i][c];
+	}
+
+	for (int c = 0; c < numChannels; ++c)
+		mean[c] /= BC_BLOCK_PIXELS;
+
+	float cov[4][4] = { { 0.0f } };
+	for (int i = 0; i < BC_BLOCK_PIXELS; ++i)
+	{
+		float d[4];
+		for (int c = 0; c < numChannels; ++c)
+			d[c] = points[i][c] - mean[c];
+
+		for (int c = 0; c < numChannels; ++c)
+		{
+			for (int k = c; k < numChannels; ++k)
+				cov[c][k] += d[c] * d[k];
+		}
+	}
+
+	for (int c = 0; c < numChannels; ++c)
+	{
+		for (int k = 0; k < c; ++k)
+			cov[c][k] = cov[k][c];
+	}
+
+	// power iteration starting from the largest variance channel
+	int startChannel = 0;
+	for (int c = 1; c < numChannels; ++c)
+	{
+		if (cov[c][c] > cov[startChannel][startChannel])
+			startChannel = c;
+	}
+
+	for (int c = 0; c < numChannels; ++c)
+		axis[c] = cov[startChannel][c];
+
+	for (int iter = 0; iter < 8; ++iter)
+	{
+		float next[4] = { 0.0f };
+		float maxComp = 0.0f;
+		for (int c = 0; c < numChannels; ++c)
+		{
+			for (int k = 0; k < numChannels; ++k)
+				next[c] += cov[c][k] * axis[k];
+			maxComp = max(maxComp, fabsf(next[c]));
+		}
+
+		if (maxComp < F_EPS)
+			break;
+
+		for (int c = 0; c < numChannels; ++c)
+			axis[c] = next[c] / maxComp;
+	}
+
+	float lenSqr = 0.0f;
+	for (int c = 0; c < numChannels; ++c)
+		lenSqr += axis[c] * axis[c];
+
+	if (lenSqr < F_EPS)
+	{
+		for (int c = 0; c < numChannels; ++c)
+			axis[c] = 1.0f;
+		lenSqr = numChannels;
+	}
+
+	const float invLen = 1.0f / sqrtf(lenSqr);
+	for (int c = 0; c < numChannels; ++c)
+		axis[c] *= invLen;
+}
+
+//-----------------------------------------------------------------------
+// BC1 color block, also used in BC2 and BC3
+
+static int BCQuantizeChannel(float value, int maxValue)
+{
+	return clamp((int)(clamp(value, 0.0f, 255.0f) * maxValue / 255.0f + 0.5f), 0, maxValue);
+}
+
+static uint16 BCPackColor565(const float* rgb)
+{
+	return (BCQuantizeChannel(rgb[0], 31) << 11) | (BCQuantizeChannel(rgb[1], 63) << 5) | BCQuantizeChannel(rgb[2], 31);
+}
+
+static void BCUnpackColor565(uint16 color, int* rgb)
+{
+	const int r = (color >> 11) & 31;
+	const int g = (color >> 5) & 63;
+	const int b = color & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+// optimal endpoints for single color blocks, indexed by 8 bit value
+struct BCSingleColorTable
+{
+	ubyte	match5[256][2];
+	ubyte	match6[256][2];
+
+	BCSingleColorTable()
+	{
+		Build(match5, 31);
+		Build(match6, 63);
+	}
+
+	static void Build(ubyte (*match)[2], int maxValue)
+	{
+		const int bits = (maxValue == 31) ? 5 : 6;
+		for (int value = 0; value < 256; ++value)
+		{
+			int bestError = INT_MAX;
+			for (int e0 = 0; e0 <= maxValue; ++e0)
+			{
+				const int v0 = (e0 << (8 - bits)) | (e0 >> (2 * bits - 8));
+				for (int e1 = 0; e1 <= maxValue; ++e1)
+				{
+					const int v1 = (e1 << (8 - bits)) | (e1 >> (2 * bits - 8));
+					const int error = abs((2 * v0 + v1 + 1) / 3 - value);
+					if (error < bestError)
+					{
+						bestError = error;
+						match[value][0] = e0;
+						match[value][1] = e1;
+					}
+				}
+			}
+		}
+	}
+};
+
+static int BCComputeColorIndices(const float (*pixels)[4], uint16 color0, uint16 color1, uint32& indices)
+{
+	int palette[4][3];
+	BCUnpackColor565(color0, palette[0]);
+	BCUnpackColor565(color1, palette[1]);
+	for (int c = 0; c < 3; ++c)
+	{
+		palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+	}
+
+	int totalError = 0;
+	indices = 0;
+	for (int i = 0; i < BC_BLOCK_PIXELS; ++i)
+	{
+		int bestError = INT_MAX;
+		int bestIndex = 0;
+		for (int j = 0; j < 4; ++j)
+		{
+			int error = 0;
+			for (int c = 0; c < 3; ++c)
+			{
+				const int d = (int)pixels[i][c] - palette[j][c];
+				error += d * d;
+			}
+
+			if (error < bestError)
+			{
+				bestError = error;
+				bestIndex = j;
+			}
+		}
+
+		indices |= bestIndex << (i * 2);
+		totalError += bestError;
+	}
+
+	return totalError;
+}
+
+// least squares fit of endpoints for the chosen indices
+static bool BCRefineColorEndpoints(const float (*pixels)[4], uint32 indices, uint16& color0, uint16& color1)
+{
+	static const float s_weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+	float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+	float ax[3] = { 0.0f }, bx[3] = { 0.0f };
+	for (int i = 0; i < BC_BLOCK_PIXELS; ++i)
+	{
+		const float a = s_weights[(indices >> (i * 2)) & 3];
+		const float b = 1.0f - a;
+		aa += a * a;
+		bb += b * b;
+		ab += a * b;
+		for (int c = 0; c < 3; ++c)
+		{
+			ax[c] += a * pixels[i][c];
+			bx[c] += b * pixels[i][c];
+		}
+	}
+
+	const float det = aa * bb - ab * ab;
+	if (fabsf(det) < F_EPS)
+		return false;
+
+	const float invDet = 1.0f / det;
+	float e0[3], e1[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		e0[c] = (ax[c] * bb - bx[c] * ab) * invDet;
+		e1[c] = (bx[c] * aa - ax[c] * ab) * invDet;
+	}
+
+	color0 = BCPackColor565(e0);
+	color1 = BCPackColor565(e1);
+	return true;
+}
+
+static void BCWriteColorBlock(ubyte* dst, uint16 color0, uint16 color1, uint32 indices)
+{
+	// four color mode requires color0 > color1
+	if (color0 < color1)
+	{
+		QuickSwap(color0, color1);
+		indices ^= 0x55555555;
+	}
+	else if (color0 == color1)
+		indices = 0;
+
+	dst[0] = color0 & 0xff;
+	dst[1] = color0 >> 8;
+	dst[2] = color1 & 0xff;
+	dst[3] = color1 >> 8;
+	dst[4] = indices & 0xff;
+	dst[5] = (indices >> 8) & 0xff;
+	dst[6] = (indices >> 16) & 0xff;
+	dst[7] = indices >> 24;
+}
+
+static void BCEncodeColorBlock(const ubyte* pixels, ubyte* dst)
+{
+	bool singleColor = true;
+	for (int i = 1; i < BC_BLOCK_PIXELS && singleColor; ++i)
+		singleColor = (pixels[i * 4] == pixels[0] && pixels[i * 4 + 1] == pixels[1] && pixels[i * 4 + 2] == pixels[2]);
+
+	if (singleColor)
+	{
+		static const BCSingleColorTable s_singleColor;
+
+		const uint16 color0 = (s_singleColor.match5[pixels[0]][0] << 11) | (s_singleColor.match6[pixels[1]][0] << 5) | s_singleColor.match5[pixels[2]][0];
+		const uint16 color1 = (s_singleColor.match5[pixels[0]][1] << 11) | (s_singleColor.match6[pixels[1]][1] << 5) | s_singleColor.match5[pixels[2]][1];
+
+		// all pixels use 2/3 color0 + 1/3 color1
+		BCWriteColorBlock(dst, color0, color1, 0xaaaaaaaa);
+		return;
+	}
+
+	float points[BC_BLOCK_PIXELS][4];
+	for (int i = 0; i < BC_BLOCK_PIXELS; ++i)
+	{
+		for (int c = 0; c < 4; ++c)
+			points[i][c] = pixels[i * 4 + c];
+	}
+
+	float axis[4];
+	BCPrincipalAxis(points, 3, axis);
+
+	// extreme points along the axis are initial endpoints
+	int minIdx = 0, maxIdx = 0;
+	float minProj = F_INFINITY, maxProj = -F_INFINITY;
+	for (int i = 0; i < BC_BLOCK_PIXELS; ++i)
+	{
+		const float proj = points[i][0] * axis[0] + points[i][1] * axis[1] + points[i][2] * axis[2];
+		if (proj < minProj)
+		{
+			minProj = proj;
+			minIdx = i;
+		}
+		if (proj > maxProj)
+		{
+			maxProj = proj;
+			maxIdx = i;
+		}
+	}
+
+	uint16 color0 = BCPackColor565(points[maxIdx]);
+	uint16 color1 = BCPackColor565(points[minIdx]);
+	uint32 indices;
+	int error = BCComputeColorIndices(points, color0, color1, indices);
+
+	for (int iter = 0; iter < BC_REFINE_ITERATIONS && error > 0; ++iter)
+	{
+		uint16 newColor0, newColor1;
+		if (!BCRefineColorEndpoints(points, indices, newColor0, newColor1))
+			break;
+
+		if (newColor0 == color0 && newColor1 == color1)
+			break;
+
+		uint32 newIndices;
+		const int newError = BCComputeColorIndices(points, newColor0, newColor1, newIndices);
+		if (newError >= error)
+			break;
+
+		color0 = newColor0;
+		color1 = newColor1;
+		indices = newIndices;
+		error = newError;
+	}
+
+	BCWriteColorBlock(dst, color0, color1, indices);
+}
+
+//-----------------------------------------------------------------------
+// BC4 single channel block, also used in BC3 and BC5
+
+static void BCGetAlphaPalette(int alpha0, int alpha1, int* palette)
+{
+	palette[0] = alpha0;
+	palette[1] = alpha1;
+
+	if (alpha0 > alpha1)
+	{
+		for (int i = 1; i < 7; ++i)
+			palette[i + 1] = ((7 - i) * alpha0 + i * alpha1 + 3) / 7;
+	}
+	else
+	{
+		for (int i = 1; i < 5; ++i)
+			palette[i + 1] = ((5 - i) * alpha0 + i * alpha1 + 2) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+static int BCComputeAlphaIndices(const int* values, int alpha0, int alpha1, ubyte* indices)
+{
+	int palette[8];
+	BCGetAlphaPalette(alpha0, alpha1, palette);
+
+	int totalError = 0;
+	for (int i = 0; i < BC_BLOCK_PIXELS; ++i)
+	{
+		int bestError = INT_MAX;
+		for (int j = 0; j < 8; ++j)
+		{
+			const int d = values[i] - palette[j];
+			if (d * d < bestError)
+			{
+				bestError = d * d;
+				indices[i] = j;
+			}
+		}
+		totalError += bestError;
+	}
+
+	return totalError;
+}
+
+static void BCEncodeAlphaBlock(const ubyte* pixels, int channel, ubyte* dst)
+{
+	int values[BC_BLOCK_PIXELS];
+	int minValue = 255, maxValue = 0;
+	int innerMin = 255, innerMax = 0;
+	for (int i = 0; i < BC_BLOCK_PIXELS; ++i)
+	{
+		values[i] = pixels[i * 4 + channel];
+		minValue = min(minValue, values[i]);
+		maxValue = max(maxValue, values[i]);
+
+		if (values[i] != 0 && values[i] != 255)
+		{
+			innerMin = min(innerMin, values[i]);
+			innerMax = max(innerMax, values[i]);
+		}
+	}
+
+	int alpha0 = minValue;
+	int alpha1 = minValue;
+	ubyte indices[BC_BLOCK_PIXELS] = { 0 };
+
+	if (minValue != maxValue)
+	{
+		// 8 interpolated values
+		alpha0 = maxValue;
+		alpha1 = minValue;
+		int error = BCComputeAlphaIndices(values, alpha0, alpha1, indices);
+
+		for (int iter = 0; iter < BC_REFINE_ITERATIONS && error > 0; ++iter)
+		{
+			static const float s_weights[8] = { 1.0f, 0.0f, 6.0f / 7.0f, 5.0f / 7.0f, 4.0f / 7.0f, 3.0f / 7.0f, 2.0f / 7.0f, 1.0f / 7.0f };
+
+			float aa = 0.0f, bb = 0.0f, ab = 0.0f, ax = 0.0f, bx = 0.0f;
+			for (int i = 0; i < BC_BLOCK_PIXELS; ++i)
+			{
+				const float a = s_weights[indices[i]];
+				const float b = 1.0f - a;
+				aa += a * a;
+				bb += b * b;
+				ab += a * b;
+				ax += a * values[i];
+				bx += b * values[i];
+			}
+
+			const float det = aa * bb - ab * ab;
+			if (fabsf(det) < F_EPS)
+				break;
+
+			const int newAlpha0 = clamp((int)((ax * bb - bx * ab) / det + 0.5f), 0, 255);
+			const int newAlpha1 = clamp((int)((bx * aa - ax * ab) / det + 0.5f), 0, 255);
+			if (newAlpha0 <= newAlpha1 || (newAlpha0 == alpha0 && newAlpha1 == alpha1))
+				break;
+
+			ubyte newIndices[BC_BLOCK_PIXELS];
+			const int newError = BCComputeAlphaIndices(values, newAlpha0, newAlpha1, newIndices);
+			if (newError >= error)
+				break;
+
+			alpha0 = newAlpha0;
+			alpha1 = newAlpha1;
+			memcpy(indices, newIndices, sizeof(indices));
+			error = newError;
+		}
+
+		// 6 interpolated values with exact 0 and 255
+		if (error > 0 && (minValue == 0 || maxValue == 255))
+		{
+			if (innerMin > innerMax)
+				innerMin = innerMax = minValue;
+
+			ubyte indices6[BC_BLOCK_PIXELS];
+			const int error6 = BCComputeAlphaIndices(values, innerMin, innerMax, indices6);
+			if (error6 < error)
+			{
+				alpha0 = innerMin;
+				alpha1 = innerMax;
+				memcpy(indices, indices6, sizeof(indices));
+			}
+		}
+	}
+
+	uint64 bits = 0;
+	for (int i = 0; i < BC_BLOCK_PIXELS; ++i)
+		bits |= uint64(indices[i]) << (i * 3);
+
+	dst[0] = alpha0;
+	dst[1] = alpha1;
+	for (int i = 0; i < 6; ++i)
+		dst[2 + i] = (bits >> (i * 8)) & 0xff;
+}
+
+static void BCEncodeExplicitAlphaBlock(const ubyte* pixels, ubyte* dst)
+{
+	uint64 bits = 0;
+	for (int i = 0; i < BC_BLOCK_PIXELS; ++i)
+		bits |= uint64((pixels[i * 4 + 3] * 15 + 127) / 255) << (i * 4);
+
+	for (int i = 0; i < 8; ++i)
+		dst[i] = (bits >> (i * 8)) & 0xff;
+}
+
+//-----------------------------------------------------------------------
+// BC7 mode 6: single subset, RGBA 7.7.7.7 endpoints with unique P-bits, 4 bit indices
+
+static const int s_bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct BC7Mode6Block
+{
+	int		endpoints[2][4];		// 7 bits
+	int		pbits[2];
+	ubyte	indices[BC_BLOCK_PIXELS];
+};
+
+static int BC7ComputeIndices(const float (*pixels)[4], BC7Mode6Block& block)
+{
+	int e[2][4];
+	for (int i = 0; i < 2; ++i)
+	{
+		for (int c = 0; c < 4; ++c)
+			e[i][c] = (block.endpoints[i][c] << 1) | block.pbits[i];
+	}
+
+	int palette[16][4];
+	for (int j = 0; j < 16; ++j)
+	{
+		for (int c = 0; c < 4; ++c)
+			palette[j][c] = ((64 - s_bc7Weights4[j]) * e[0][c] + s_bc7Weights4[j] * e[1][c] + 32) >> 6;
+	}
+
+	int dir[4];
+	int dirLenSqr = 0;
+	for (int c = 0; c < 4; ++c)
+	{
+		dir[c] = e[1][c] - e[0][c];
+		dirLenSqr += dir[c] * dir[c];
+	}
+
+	int totalError = 0;
+	for (int i = 0; i < BC_BLOCK_PIXELS; ++i)
+	{
+		// estimate from projection to endpoint line and check neighbours
+		int estimate = 0;
+		if (dirLenSqr > 0)
+		{
+			float t = 0.0f;
+			for (int c = 0; c < 4; ++c)
+				t += (pixels[i][c] - e[0][c]) * dir[c];
+			t = clamp(t / dirLenSqr, 0.0f, 1.0f) * 15.0f;
+			estimate = (int)(t + 0.5f);
+		}
+
+		int bestError = INT_MAX;
+		for (int j = max(estimate - 1, 0); j <= min(estimate + 1, 15); ++j)
+		{
+			int error = 0;
+			for (int c = 0; c < 4; ++c)
+			{
+				const int d = (int)pixels[i][c] - palette[j][c];
+				error += d * d;
+			}
+
+			if (error < bestError)
+			{
+				bestError = error;
+				block.indices[i] = j;
+			}
+		}
+		totalError += bestError;
+	}
+
+	return totalError;
+}
+
+// tries all P-bit combinations for endpoints
+static int BC7FitEndpoints(const float (*pixels)[4], const float (*endpoints)[4], BC7Mode6Block& bestBlock, int bestError)
+{
+	for (int pbitMask = 0; pbitMask < 4; ++pbitMask)
+	{
+		BC7Mode6Block block;
+		for (int i = 0; i < 2; ++i)
+		{
+			block.pbits[i] = (pbitMask >> i) & 1;
+			for (int c = 0; c < 4; ++c)
+				block.endpoints[i][c] = clamp((int)((clamp(endpoints[i][c], 0.0f, 255.0f) - block.pbits[i]) * 0.5f + 0.5f), 0, 127);
+		}
+
+		const int error = BC7ComputeIndices(pixels, block);
+		if (error < bestError)
+		{
+			bestError = error;
+			bestBlock = block;
+		}
+	}
+
+	return bestError;
+}
+
+static void BC7EncodeBlock(const ubyte* pixels, ubyte* dst)
+{
+	float points[BC_BLOCK_PIXELS][4];
+	for (int i = 0; i < BC_BLOCK_PIXELS; ++i)
+	{
+		for (int c = 0; c < 4; ++c)
+			points[i][c] = pixels[i * 4 + c];
+	}
+
+	float axis[4];
+	BCPrincipalAxis(points, 4, axis);
+
+	float mean[4] = { 0.0f };
+	for (int i = 0; i < BC_BLOCK_PIXELS; ++i)
+	{
+		for (int c = 0; c < 4; ++c)
+			mean[c] += points[i][c] / BC_BLOCK_PIXELS;
+	}
+
+	float minProj = F_INFINITY, maxProj = -F_INFINITY;
+	for (int i = 0; i < BC_BLOCK_PIXELS; ++i)
+	{
+		float proj = 0.0f;
+		for (int c = 0; c < 4; ++c)
+			proj += (points[i][c] - mean[c]) * axis[c];
+
+		minProj = min(minProj, proj);
+		maxProj = max(maxProj, proj);
+	}
+
+	float endpoints[2][4];
+	for (int c = 0; c < 4; ++c)
+	{
+		endpoints[0][c] = mean[c] + axis[c] * minProj;
+		endpoints[1][c] = mean[c] + axis[c] * maxProj;
+	}
+
+	BC7Mode6Block block;
+	int error = BC7FitEndpoints(points, endpoints, block, INT_MAX);
+
+	for (int iter = 0; iter < BC_REFINE_ITERATIONS && error > 0; ++iter)
+	{
+		float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+		float ax[4] = { 0.0f }, bx[4] = { 0.0f };
+		for (int i = 0; i < BC_BLOCK_PIXELS; ++i)
+		{
+			const float b = s_bc7Weights4[block.indices[i]] / 64.0f;
+			const float a = 1.0f - b;
+			aa += a * a;
+			bb += b * b;
+			ab += a * b;
+			for (int c = 0; c < 4; ++c)
+			{
+				ax[c] += a * points[i][c];
+				bx[c] += b * points[i][c];
+			}
+		}
+
+		const float det = aa * bb - ab * ab;
+		if (fabsf(det) < F_EPS)
+			break;
+
+		const float invDet = 1.0f / det;
+		for (int c = 0; c < 4; ++c)
+		{
+			endpoints[0][c] = (ax[c] * bb - bx[c] * ab) * invDet;
+			endpoints[1][c] = (bx[c] * aa - ax[c] * ab) * invDet;
+		}
+
+		const int newError = BC7FitEndpoints(points, endpoints, block, error);
+		if (newError >= error)
+			break;
+
+		error = newError;
+	}
+
+	// anchor index must have zero high bit
+	if (block.indices[0] & 8)
+	{
+		for (int c = 0; c < 4; ++c)
+			QuickSwap(block.endpoints[0][c], block.endpoints[1][c]);
+		QuickSwap(block.pbits[0], block.pbits[1]);
+
+		for (int i = 0; i < BC_BLOCK_PIXELS; ++i)
+			block.indices[i] = 15 - block.indices[i];
+	}
+
+	memset(dst, 0, 16);
+	int bitPos = 0;
+	BCWriteBits(dst, bitPos, 1 << 6, 7);
+
+	for (int c = 0; c < 4; ++c)
+	{
+		BCWriteBits(dst, bitPos, block.endpoints[0][c], 7);
+		BCWriteBits(dst, bitPos, block.endpoints[1][c], 7);
+	}
+
+	BCWriteBits(dst, bitPos, block.pbits[0], 1);
+	BCWriteBits(dst, bitPos, block.pbits[1], 1);
+
+	BCWriteBits(dst, bitPos, block.indices[0], 3);
+	for (int i = 1; i < BC_BLOCK_PIXELS; ++i)
+		BCWriteBits(dst, bitPos, block.indices[i], 4);
+
+	ASSERT(bitPos == 128);
+}
+
+//-----------------------------------------------------------------------
+
+void BlockCompressSingle(const ETextureFormat format, const ubyte pixels[BC_BLOCK_PIXELS * 4], ubyte* dst)
+{
+	switch (GetTexFormat(format))
+	{
+	case FORMAT_DXT1:
+		BCEncodeColorBlock(pixels, dst);
+		break;
+	case FORMAT_DXT3:
+		BCEncodeExplicitAlphaBlock(pixels, dst);
+		BCEncodeColorBlock(pixels, dst + 8);
+		break;
+	case FORMAT_DXT5:
+		BCEncodeAlphaBlock(pixels, 3, dst);
+		BCEncodeColorBlock(pixels, dst + 8);
+		break;
+	case FORMAT_ATI1N:
+		BCEncodeAlphaBlock(pixels, 0, dst);
+		break;
+	case FORMAT_ATI2N:
+		BCEncodeAlphaBlock(pixels, 0, dst);
+		BCEncodeAlphaBlock(pixels, 1, dst + 8);
+		break;
+	case FORMAT_BC7:
+		BC7EncodeBlock(pixels, dst);
+		break;
+	default:
+		ASSERT_FAIL("BlockCompressSingle - unsupported format %d", format);
+	}
+}
+
+struct BlockCompressTask
+{
+	ETextureFormat	format;
+	const ubyte*	rgba;
+	ubyte*			dst;
+	int				width;
+	int				height;
+	int				blocksX;
+	int				blocksY;
+	int				blockBytes;
+	int				numTiles;
+	volatile int	nextTile{ 0 };
+
+	void CompressBlockRows(int startRow, int endRow) const
+	{
+		ubyte pixels[BC_BLOCK_PIXELS * 4];
+		for (int by = startRow; by < endRow; ++by)
+		{
+			for (int bx = 0; bx < blocksX; ++bx)
+			{
+				// edge pixels are repeated in partial blocks
+				for (int y = 0; y < BC_BLOCK_SIZE; ++y)
+				{
+					const int sy = min(by * BC_BLOCK_SIZE + y, height - 1);
+					for (int x = 0; x < BC_BLOCK_SIZE; ++x)
+					{
+						const int sx = min(bx * BC_BLOCK_SIZE + x, width - 1);
+						memcpy(&pixels[(y * BC_BLOCK_SIZE + x) * 4], &rgba[(sy * width + sx) * 4], 4);
+					}
+				}
+
+				BlockCompressSingle(format, pixels, dst + (by * blocksX + bx) * blockBytes);
+			}
+		}
+	}
+
+	void CompressTiles()
+	{
+		int tile;
+		while ((tile = Atomic::Increment(nextTile) - 1) < numTiles)
+			CompressBlockRows(tile * BC_JOB_BLOCK_ROWS, min((tile + 1) * BC_JOB_BLOCK_ROWS, blocksY));
+	}
+};
+
+class CBlockCompressJob : public IParallelJob
+{
+public:
+	CBlockCompressJob()
+		: IParallelJob("BlockCompress")
+	{
+		InitSignal();
+	}
+
+	void Execute() override
+	{
+		m_task->CompressTiles();
+	}
+
+	BlockCompressTask*	m_task{ nullptr };
+};
+
+bool BlockCompress(const ETextureFormat format, const ubyte* rgba, int width, int height, ubyte* dst, CEqJobManager* jobMng)
+{
+	if (!IsBlockCompressSupported(format))
+		return false;
+
+	BlockCompressTask task;
+	task.format = format;
+	task.rgba = rgba;
+	task.dst = dst;
+	task.width = width;
+	task.height = height;
+	task.blocksX = (width + BC_BLOCK_SIZE - 1) / BC_BLOCK_SIZE;
+	task.blocksY = (height + BC_BLOCK_SIZE - 1) / BC_BLOCK_SIZE;
+	task.blockBytes = GetBytesPerBlock(format);
+	task.numTiles = (task.blocksY + BC_JOB_BLOCK_ROWS - 1) / BC_JOB_BLOCK_ROWS;
+
+	const int numJobs = jobMng ? min(jobMng->GetJobThreadsCount(), task.numTiles - 1) : 0;
+	if (numJobs <= 0)
+	{
+		task.CompressBlockRows(0, task.blocksY);
+		return true;
+	}
+
+	CBlockCompressJob* jobs = PPNew CBlockCompressJob[numJobs];
+	for (int i = 0; i < numJobs; ++i)
+	{
+		jobs[i].m_task = &task;
+		jobMng->InitStartJob(&jobs[i]);
+	}
+
+	// this thread takes tiles too
+	task.CompressTiles();
+
+	for (int i = 0; i < numJobs; ++i)
+		jobs[i].GetSignal()->Wait();
+
+	delete[] jobs;
+	return true;
+}
@@ -0,0 +1,35 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2020
+//////////////////////////////////////////////////////////////////////////////////
+// Description: BCn texture block encoder
+//////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "textureformats.h"
+
+class CEqJobManager;
+
+// increment when encoder output changes so cached textures are rebuilt
+static constexpr const int BLOCK_COMPRESS_VERSION = 1;
+
+static constexpr const int BC_BLOCK_SIZE = 4;
+static constexpr const int BC_BLOCK_PIXELS = BC_BLOCK_SIZE * BC_BLOCK_SIZE;
+
+// is format can be produced by BlockCompress
+bool	IsBlockCompressSupported(const ETextureFormat format);
+
+// Encodes RGBA8 pixels into the blocks of
+//		FORMAT_DXT1 (BC1)	- RGB, alpha is ignored
+//		FORMAT_DXT3 (BC2)	- RGB and explicit 4 bit alpha
+//		FORMAT_DXT5 (BC3)	- RGB and interpolated alpha
+//		FORMAT_ATI1N (BC4)	- R
+//		FORMAT_ATI2N (BC5)	- RG
+//		FORMAT_BC7			- RGBA, single subset blocks (mode 6)
+//
+// Rows of blocks are split between job manager threads if it's provided.
+// Output does not depend on the number of threads.
+bool	BlockCompress(const ETextureFormat format, const ubyte* rgba, int width, int height, ubyte* dst, CEqJobManager* jobMng = nullptr);
+
+// encodes 4x4 RGBA8 pixels into one block of the format
+void	BlockCompressSingle(const ETextureFormat format, const ubyte pixels[BC_BLOCK_PIXELS * 4], ubyte* dst);
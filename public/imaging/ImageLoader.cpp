@@ -10,6 +10,12 @@
 #include "math/Vector.h"
 
 #include "ImageLoader.h"
+#include "BlockCompression.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IMAGE_MIPMAP_SSE2
+#endif
 
 #ifndef NO_JPEG
 #ifdef _WIN32
@@ -161,6 +167,14 @@ static const FormatString formatStrings[] = {
 	{ FORMAT_DXT5,   "DXT5"  },
 	{ FORMAT_ATI1N,  "ATI1N" },
 	{ FORMAT_ATI2N,  "ATI2N" },
+	{ FORMAT_BC7,    "BC7"   },
+
+	// aliases
+	{ FORMAT_DXT1,   "BC1"   },
+	{ FORMAT_DXT3,   "BC2"   },
+	{ FORMAT_DXT5,   "BC3"   },
+	{ FORMAT_ATI1N,  "BC4"   },
+	{ FORMAT_ATI2N,  "BC5"   },
 };
 
 const char* GetFormatString(const ETextureFormat format)
@@ -466,6 +480,12 @@ bool CImage::LoadDDS(IFilePtr fileHandle, uint flags)
 		case 77: m_nFormat = FORMAT_DXT5; break;
 		case 80: m_nFormat = FORMAT_ATI1N; break;
 		case 83: m_nFormat = FORMAT_ATI2N; break;
+		case 98: m_nFormat = FORMAT_BC7; break;
+
+		case 72: m_nFormat = MakeTexFormat(FORMAT_DXT1, TEXFORMAT_FLAG_SRGB); break;
+		case 75: m_nFormat = MakeTexFormat(FORMAT_DXT3, TEXFORMAT_FLAG_SRGB); break;
+		case 78: m_nFormat = MakeTexFormat(FORMAT_DXT5, TEXFORMAT_FLAG_SRGB); break;
+		case 99: m_nFormat = MakeTexFormat(FORMAT_BC7, TEXFORMAT_FLAG_SRGB); break;
 		case 0:
 			m_nFormat = FORMAT_ETC2;
 			MsgError("Invalid DDS file %s\n", GetName());
@@ -887,12 +907,19 @@ bool CImage::SaveDDS(IVirtualStreamPtr fileHandle) const
 			headerDXT10.arraySize = 1;
 			headerDXT10.miscFlag = (m_nDepth == IMAGE_DEPTH_CUBEMAP) ? D3D10_RESOURCE_MISC_TEXTURECUBE : 0;
 			headerDXT10.resourceDimension = Is1D() ? D3D10_RESOURCE_DIMENSION_TEXTURE1D : Is3D() ? D3D10_RESOURCE_DIMENSION_TEXTURE3D : D3D10_RESOURCE_DIMENSION_TEXTURE2D;
-			switch (m_nFormat)
+			const bool srgb = HasTexFormatFlags(m_nFormat, TEXFORMAT_FLAG_SRGB);
+			switch (GetTexFormat(m_nFormat))
 			{
 				//case FORMAT_RGBA8:    headerDXT10.dxgiFormat = 28; break;
 			case FORMAT_RGB32F:   headerDXT10.dxgiFormat = 6; break;
 			case FORMAT_RGB9E5:   headerDXT10.dxgiFormat = 67; break;
 			case FORMAT_RG11B10F: headerDXT10.dxgiFormat = 26; break;
+			case FORMAT_BC7:      headerDXT10.dxgiFormat = srgb ? 99 : 98; break;
+
+			// sRGB variants, FourCC only has linear ones
+			case FORMAT_DXT1:     headerDXT10.dxgiFormat = 72; break;
+			case FORMAT_DXT3:     headerDXT10.dxgiFormat = 75; break;
+			case FORMAT_DXT5:     headerDXT10.dxgiFormat = 78; break;
 			default:
 				return false;
 			}
@@ -1143,7 +1170,239 @@ void BuildMipMap(DATA_TYPE* dst, const DATA_TYPE* src, const uint w, const uint
 	}
 }
 
-bool CImage::CreateMipMaps(const int mipMaps)
+//-------------------------------------------------------
+// Filtered mipmaps, computed in linear float RGBA
+
+#ifdef IMAGE_MIPMAP_SSE2
+using MipPixel = __m128;
+static inline MipPixel	MipLoad(const float* p)					{ return _mm_loadu_ps(p); }
+static inline void		MipStore(float* p, const MipPixel& v)	{ _mm_storeu_ps(p, v); }
+static inline MipPixel	MipSplat(float v)						{ return _mm_set1_ps(v); }
+static inline MipPixel	MipAdd(const MipPixel& a, const MipPixel& b) { return _mm_add_ps(a, b); }
+static inline MipPixel	MipMul(const MipPixel& a, const MipPixel& b) { return _mm_mul_ps(a, b); }
+#else
+struct MipPixel { float v[4]; };
+static inline MipPixel	MipLoad(const float* p)					{ MipPixel r; memcpy(r.v, p, sizeof(r.v)); return r; }
+static inline void		MipStore(float* p, const MipPixel& v)	{ memcpy(p, v.v, sizeof(v.v)); }
+static inline MipPixel	MipSplat(float v)						{ return MipPixel{ { v, v, v, v } }; }
+static inline MipPixel	MipAdd(const MipPixel& a, const MipPixel& b) { return MipPixel{ { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } }; }
+static inline MipPixel	MipMul(const MipPixel& a, const MipPixel& b) { return MipPixel{ { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } }; }
+#endif
+
+static constexpr const int MIP_KAISER_TAPS = 6;		// filter width is 3 destination pixels
+
+static float MipBesselI0(float x)
+{
+	float sum = 1.0f;
+	float term = 1.0f;
+	for (int k = 1; k < 20; ++k)
+	{
+		term *= (x * 0.5f / k) * (x * 0.5f / k);
+		sum += term;
+	}
+	return sum;
+}
+
+struct MipKaiserWeights
+{
+	float	weights[MIP_KAISER_TAPS];
+
+	MipKaiserWeights()
+	{
+		constexpr const float alpha = 4.0f;
+		constexpr const float halfWidth = 1.5f;
+
+		float sum = 0.0f;
+		for (int i = 0; i < MIP_KAISER_TAPS; ++i)
+		{
+			// distance from destination pixel center in destination pixels
+			const float x = (i - MIP_KAISER_TAPS / 2 + 0.5f) * 0.5f;
+			const float t = x / halfWidth;
+			const float sinc = sinf(M_PI_F * x) / (M_PI_F * x);
+			const float window = MipBesselI0(alpha * sqrtf(max(1.0f - t * t, 0.0f))) / MipBesselI0(alpha);
+
+			weights[i] = sinc * window;
+			sum += weights[i];
+		}
+
+		for (int i = 0; i < MIP_KAISER_TAPS; ++i)
+			weights[i] /= sum;
+	}
+};
+
+static float SRGBToLinear(float value)
+{
+	return (value <= 0.04045f) ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float LinearToSRGB(float value)
+{
+	return (value <= 0.0031308f) ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+}
+
+static bool IsFilteredMipMapFormat(const ETextureFormat format)
+{
+	return (format >= FORMAT_R8 && format <= FORMAT_RGBA8) || (format >= FORMAT_R32F && format <= FORMAT_RGBA32F);
+}
+
+// loads surface to linear float RGBA
+static void MipLoadSurface(const ubyte* src, ETextureFormat format, int numPixels, bool srgb, float* dst)
+{
+	const int nChannels = GetChannelCount(format);
+	const int colorChannels = srgb ? ((nChannels >= 3) ? 3 : 1) : 0;
+
+	if (format >= FORMAT_R32F)
+	{
+		const float* srcFloat = reinterpret_cast<const float*>(src);
+		for (int i = 0; i < numPixels; ++i, dst += 4, srcFloat += nChannels)
+		{
+			dst[0] = dst[1] = dst[2] = 0.0f;
+			dst[3] = 1.0f;
+			for (int c = 0; c < nChannels; ++c)
+				dst[c] = srcFloat[c];
+		}
+		return;
+	}
+
+	float toFloat[2][256];
+	for (int i = 0; i < 256; ++i)
+	{
+		toFloat[0][i] = i / 255.0f;
+		toFloat[1][i] = SRGBToLinear(i / 255.0f);
+	}
+
+	for (int i = 0; i < numPixels; ++i, dst += 4, src += nChannels)
+	{
+		dst[0] = dst[1] = dst[2] = 0.0f;
+		dst[3] = 1.0f;
+		for (int c = 0; c < nChannels; ++c)
+			dst[c] = toFloat[c < colorChannels][src[c]];
+	}
+}
+
+static void MipStoreSurface(const float* src, ETextureFormat format, int numPixels, bool srgb, ubyte* dst)
+{
+	const int nChannels = GetChannelCount(format);
+	const int colorChannels = srgb ? ((nChannels >= 3) ? 3 : 1) : 0;
+
+	if (format >= FORMAT_R32F)
+	{
+		float* dstFloat = reinterpret_cast<float*>(dst);
+		for (int i = 0; i < numPixels; ++i, src += 4, dstFloat += nChannels)
+		{
+			for (int c = 0; c < nChannels; ++c)
+				dstFloat[c] = src[c];
+		}
+		return;
+	}
+
+	for (int i = 0; i < numPixels; ++i, src += 4, dst += nChannels)
+	{
+		for (int c = 0; c < nChannels; ++c)
+		{
+			const float value = saturate(src[c]);
+			dst[c] = (ubyte)(255.0f * ((c < colorChannels) ? LinearToSRGB(value) : value) + 0.5f);
+		}
+	}
+}
+
+static void MipDownsampleBox(const float* src, int w, int h, float* dst)
+{
+	const int dw = max(w >> 1, 1);
+	const int dh = max(h >> 1, 1);
+	const int xOff = (w > 1) ? 4 : 0;
+	const int yOff = (h > 1) ? w * 4 : 0;
+	const MipPixel quarter = MipSplat(0.25f);
+
+	for (int y = 0; y < dh; ++y)
+	{
+		const float* row = src + y * 2 * w * 4;
+		for (int x = 0; x < dw; ++x, dst += 4)
+		{
+			const float* p = row + x * 2 * 4;
+			const MipPixel sum = MipAdd(MipAdd(MipLoad(p), MipLoad(p + xOff)), MipAdd(MipLoad(p + yOff), MipLoad(p + yOff + xOff)));
+			MipStore(dst, MipMul(sum, quarter));
+		}
+	}
+}
+
+// separable polyphase Kaiser filter, stride is in floats between filtered pixels
+static void MipDownsampleKaiserLine(const float* src, int count, int srcStride, float* dst, int dstStride, const float* weights)
+{
+	const int dstCount = max(count >> 1, 1);
+	if (count == 1)
+	{
+		MipStore(dst, MipLoad(src));
+		return;
+	}
+
+	MipPixel w[MIP_KAISER_TAPS];
+	for (int k = 0; k < MIP_KAISER_TAPS; ++k)
+		w[k] = MipSplat(weights[k]);
+
+	for (int x = 0; x < dstCount; ++x, dst += dstStride)
+	{
+		const int first = x * 2 - (MIP_KAISER_TAPS / 2 - 1);
+
+		MipPixel sum = MipSplat(0.0f);
+		for (int k = 0; k < MIP_KAISER_TAPS; ++k)
+		{
+			const int i = clamp(first + k, 0, count - 1);
+			sum = MipAdd(sum, MipMul(MipLoad(src + i * srcStride), w[k]));
+		}
+		MipStore(dst, sum);
+	}
+}
+
+static void MipDownsampleKaiser(const float* src, int w, int h, float* temp, float* dst)
+{
+	static const MipKaiserWeights s_kaiser;
+
+	const int dw = max(w >> 1, 1);
+
+	for (int y = 0; y < h; ++y)
+		MipDownsampleKaiserLine(src + y * w * 4, w, 4, temp + y * dw * 4, 4, s_kaiser.weights);
+
+	for (int x = 0; x < dw; ++x)
+		MipDownsampleKaiserLine(temp + x * 4, h, dw * 4, dst + x * 4, dw * 4, s_kaiser.weights);
+}
+
+static void BuildFilteredMipMaps(CImage& image, int arraySlice, int face, EMipMapFilter filter, bool srgb)
+{
+	const ETextureFormat format = image.GetFormat();
+	const int width = image.GetWidth();
+	const int height = image.GetHeight();
+
+	Array<float> level(PP_SL);
+	Array<float> nextLevel(PP_SL);
+	Array<float> temp(PP_SL);
+	level.setNum(width * height * 4);
+	nextLevel.setNum(max(width >> 1, 1) * max(height >> 1, 1) * 4);
+	if (filter == MIPMAP_FILTER_KAISER)
+		temp.setNum(max(width >> 1, 1) * height * 4);
+
+	const ubyte* src = image.GetPixels(0, arraySlice) + face * image.GetSliceSize(0);
+	MipLoadSurface(src, format, width * height, srgb, level.ptr());
+
+	for (int mipLevel = 1; mipLevel < image.GetMipMapCount(); ++mipLevel)
+	{
+		const int w = image.GetWidth(mipLevel - 1);
+		const int h = image.GetHeight(mipLevel - 1);
+
+		if (filter == MIPMAP_FILTER_KAISER)
+			MipDownsampleKaiser(level.ptr(), w, h, temp.ptr(), nextLevel.ptr());
+		else
+			MipDownsampleBox(level.ptr(), w, h, nextLevel.ptr());
+
+		ubyte* dst = image.GetPixels(mipLevel, arraySlice) + face * image.GetSliceSize(mipLevel);
+		MipStoreSurface(nextLevel.ptr(), format, image.GetWidth(mipLevel) * image.GetHeight(mipLevel), srgb, dst);
+
+		// keep full precision for next level
+		level.swap(nextLevel);
+	}
+}
+
+bool CImage::CreateMipMaps(const int mipMaps, EMipMapFilter filter, bool srgb)
 {
 	if (IsCompressedFormat(m_nFormat))
 		return false;
@@ -1191,6 +1450,16 @@ bool CImage::CreateMipMaps(const int mipMaps)
 
 	int n = IsCube() ? 6 : 1;
 
+	if (!Is3D() && IsFilteredMipMapFormat(m_nFormat))
+	{
+		for (int arraySlice = 0; arraySlice < m_nArraySize; arraySlice++)
+		{
+			for (int i = 0; i < n; i++)
+				BuildFilteredMipMaps(*this, arraySlice, i, filter, srgb);
+		}
+		return true;
+	}
+
 	for (int arraySlice = 0; arraySlice < m_nArraySize; arraySlice++)
 	{
 		ubyte* src = GetPixels(0, arraySlice);
@@ -1257,8 +1526,44 @@ bool CImage::RemoveMipMaps(const int firstMipMap, int mipMapsToSave)
 	return true;
 }
 
-bool CImage::Convert(const ETextureFormat newFormat)
+bool CImage::Convert(const ETextureFormat newFormat, CEqJobManager* jobMng)
 {
+	if (IsCompressedFormat(newFormat))
+	{
+		if (m_nFormat == newFormat)
+			return true;
+
+		if (IsCompressedFormat(m_nFormat) || !IsBlockCompressSupported(newFormat))
+			return false;
+
+		// block encoder takes RGBA8
+		if (!Convert(FORMAT_RGBA8))
+			return false;
+
+		const int newSize = GetMipMappedSize(0, m_nMipMaps, newFormat);
+		ubyte* newPixels = PPNew ubyte[newSize * m_nArraySize];
+
+		for (int arraySlice = 0; arraySlice < m_nArraySize; arraySlice++)
+		{
+			for (int level = 0; level < m_nMipMaps; level++)
+			{
+				// cubemap faces and volume slices are compressed separately
+				const int numSurfaces = IsCube() ? 6 : GetDepth(level);
+				const ubyte* src = GetPixels(level, arraySlice);
+				ubyte* dest = newPixels + newSize * arraySlice + GetMipMappedSize(0, level, newFormat);
+
+				for (int i = 0; i < numSurfaces; i++)
+					BlockCompress(newFormat, src + i * GetSliceSize(level), GetWidth(level), GetHeight(level), dest + i * GetSliceSize(level, newFormat), jobMng);
+			}
+		}
+
+		delete[] m_pPixels;
+		m_pPixels = newPixels;
+		m_nFormat = newFormat;
+
+		return true;
+	}
+
 	ubyte* newPixels;
 	uint nPixels = GetPixelCount(0, m_nMipMaps) * m_nArraySize;
 
@@ -1320,7 +1625,7 @@ bool CImage::Convert(const ETextureFormat newFormat)
 
 			do
 			{
-				float rgba[4];
+				float rgba[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
 
 				if (IsFloatFormat(m_nFormat))
 				{
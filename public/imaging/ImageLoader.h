@@ -9,6 +9,7 @@
 #include "textureformats.h"
 
 class IVirtualStream;
+class CEqJobManager;
 
 // Image loading flags
 enum EImageLoadingFlags
@@ -16,6 +17,13 @@ enum EImageLoadingFlags
 	DONT_LOAD_MIPMAPS = 0x1
 };
 
+// Mipmap downsampling filters
+enum EMipMapFilter
+{
+	MIPMAP_FILTER_BOX = 0,
+	MIPMAP_FILTER_KAISER,		// sharper, windowed sinc
+};
+
 #define ALL_MIPMAPS				127
 #define IMAGE_DEPTH_CUBEMAP		0
 
@@ -87,12 +95,16 @@ public:
 
 	void			LoadFromMemory(void* mem, const ETextureFormat frmt, const int wide, const int tall, const int nDepth, const int mipMapCount, bool ownsMemory);
 
-	bool			CreateMipMaps(const int mipMaps = ALL_MIPMAPS);
+	// filter and sRGB (gamma-correct) averaging are used on 8 bit and 32 bit float 2D images
+	// other formats are box filtered
+	bool			CreateMipMaps(const int mipMaps = ALL_MIPMAPS, EMipMapFilter filter = MIPMAP_FILTER_BOX, bool srgb = false);
 	bool			RemoveMipMaps(const int firstMipMap, const int mipMapsToSave = ALL_MIPMAPS);
 
 	bool			SwapChannels(const int ch0, const int ch1);
 
-	bool			Convert(const ETextureFormat newFormat);
+	// compressed formats supported by BlockCompress can be produced from plain ones
+	// compression is split between job manager threads if provided
+	bool			Convert(const ETextureFormat newFormat, CEqJobManager* jobMng = nullptr);
 
 protected:
 
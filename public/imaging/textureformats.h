@@ -105,6 +105,7 @@ enum ETextureFormat : int
 	FORMAT_PVRTC_4BPP	= 61, // RGB
 	FORMAT_PVRTC_A_2BPP	= 62, // RGBA
 	FORMAT_PVRTC_A_4BPP	= 63, // RGBA
+	FORMAT_BC7			= 64, // RGBA
 
 	FORMAT_COUNT,
 };
@@ -174,7 +175,7 @@ inline bool IsSignedFormat(const ETextureFormat format)
 inline bool IsCompressedFormat(const ETextureFormat format)
 {
 	const ETextureFormat fmt = GetTexFormat(format);
-	return (fmt >= FORMAT_DXT1) && (fmt <= FORMAT_PVRTC_A_4BPP);
+	return (fmt >= FORMAT_DXT1) && (fmt <= FORMAT_BC7);
 }
 
 inline bool IsFloatFormat(const ETextureFormat format)
@@ -207,7 +208,8 @@ inline int GetChannelCount(const ETextureFormat format)
 		3, 3, 3, 3, 4, 4,			// Packed
 		1, 1, 2, 1,      			// Depth
 		3, 4, 4, 1, 2,				// Compressed
-		3, 3, 4, 3, 3, 4, 4			// Compressed mobile formats
+		3, 3, 4, 3, 3, 4, 4,		// Compressed mobile formats
+		4							// BC7
 	};
 
 	return chCount[fmt];
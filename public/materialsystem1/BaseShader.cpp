@@ -336,12 +336,22 @@ const CBaseShader::PipelineInfo& CBaseShader::EnsureRenderPipeline(IShaderAPI* r
 				newPipelineInfo.layout = renderAPI->CreatePipelineLayout(pipelineLayoutDesc);
 		}
 
+		// pipeline cache is shared between materials which can be set up on different threads
 		MatSysShaderPipelineCache& shaderPipelineCache = g_matSystem->GetRenderPipelineCache(GetNameHash());
-		shaderPipelineCache.rwLock.LockRead();
-		auto cacheIt = shaderPipelineCache.pipelines.find(pipelineId);
-		shaderPipelineCache.rwLock.UnlockRead();
+		IGPURenderPipelinePtr cachedPipeline;
+		bool isCached = false;
+		{
+			shaderPipelineCache.rwLock.LockRead();
+			auto cacheIt = shaderPipelineCache.pipelines.find(pipelineId);
+			if (!cacheIt.atEnd())
+			{
+				cachedPipeline = *cacheIt;
+				isCached = true;
+			}
+			shaderPipelineCache.rwLock.UnlockRead();
+		}
 
-		if (cacheIt.atEnd())
+		if (!isCached)
 		{
 			RenderPipelineDesc renderPipelineDesc;
 			FillRenderPipelineDesc(inputParams, renderPipelineDesc);
@@ -354,7 +364,10 @@ const CBaseShader::PipelineInfo& CBaseShader::EnsureRenderPipeline(IShaderAPI* r
 
 			{
 				Threading::CScopedWriteLocker lock(shaderPipelineCache.rwLock);
-				cacheIt = shaderPipelineCache.pipelines.insert(pipelineId, renderPipeline);
+				auto cacheIt = shaderPipelineCache.pipelines.find(pipelineId);
+				if (cacheIt.atEnd())
+					cacheIt = shaderPipelineCache.pipelines.insert(pipelineId, renderPipeline);
+				cachedPipeline = *cacheIt;
 			}
 
 #ifndef _RETAIL
@@ -390,7 +403,7 @@ const CBaseShader::PipelineInfo& CBaseShader::EnsureRenderPipeline(IShaderAPI* r
 #endif // !_RETAIL
 		}
 
-		newPipelineInfo.pipeline = *cacheIt;
+		newPipelineInfo.pipeline = cachedPipeline;
 	}
 
 	return *it;
@@ -69,7 +69,7 @@ struct MaterialsInitSettings
 class IMaterialSystem : public IEqCoreModule
 {
 public:
-	CORE_INTERFACE("E2_MaterialSystem_028")
+	CORE_INTERFACE("E2_MaterialSystem_029")
 
 	// Initialize material system
 	// szShaderAPI - shader API that will be used. On NULL will set to default Shader API (DX9)
@@ -200,6 +200,9 @@ public:
 
 	virtual bool					SetupMaterialPipeline(IMaterial* material, ArrayCRef<RenderBufferInfo> uniformBuffers, EPrimTopology primTopology, const MeshInstanceFormatRef& meshInstFormat, const RenderPassContext& passContext, IShaderMeshInstanceProvider* meshInstProvider = nullptr) = 0;
 	virtual void					SetupDrawCommand(const RenderDrawCmd& drawCmd, const RenderPassContext& passContext) = 0;
+
+	// draws command list in given order. Pipeline and buffer bindings are skipped when they match previous command
+	virtual void					SetupDrawCommands(ArrayCRef<const RenderDrawCmd*> drawCmds, const RenderPassContext& passContext, RenderDrawStats* stats = nullptr) = 0;
 	virtual bool					SetupDrawDefaultUP(EPrimTopology primTopology, int vertFVF, const void* verts, int numVerts, const RenderPassContext& passContext) = 0;
 
 	template<typename VERT>
@@ -726,5 +726,17 @@ inline void CMeshBuilder::CopyVertData(VertData& vert, bool isNormal)
 
 			break;
 		}
+		case ATTRIBUTEFORMAT_UNORM8:
+		{
+			TVec4D<ubyte> val(clamp(vert.value, Vector4D(0.0f), Vector4D(1.0f)) * 255);
+			memcpy(dest, &val, size);
+			break;
+		}
+		case ATTRIBUTEFORMAT_SNORM8:
+		{
+			TVec4D<int8> val(clamp(vert.value, Vector4D(-1.0f), Vector4D(1.0f)) * 127);
+			memcpy(dest, &val, size);
+			break;
+		}
 	}
 }
@@ -342,6 +342,116 @@ struct RenderDrawCmd
 	}
 };
 
+// draw command submission statistics
+struct RenderDrawStats
+{
+	int		numDraws{ 0 };
+	int		numPipelinesBound{ 0 };
+	int		numMaterialsBound{ 0 };
+	int		numVertexBuffersBound{ 0 };
+	int		numIndexBuffersBound{ 0 };
+
+	RenderDrawStats& operator+=(const RenderDrawStats& other)
+	{
+		numDraws += other.numDraws;
+		numPipelinesBound += other.numPipelinesBound;
+		numMaterialsBound += other.numMaterialsBound;
+		numVertexBuffersBound += other.numVertexBuffersBound;
+		numIndexBuffersBound += other.numIndexBuffersBound;
+		return *this;
+	}
+};
+
+// State set on commands recorder by consecutive draw commands.
+// Used to skip pipeline, material and buffer setup when they are already set
+struct RenderDrawStateCache
+{
+	const RenderDrawCmd*	pipelineCmd{ nullptr };
+	uint					pipelineLayoutBits{ 0 };
+	const IGPURenderPipeline*	boundPipeline{ nullptr };	// pipelines are cached by shaders so pointer is enough
+	IMaterial*				boundMaterial{ nullptr };
+	GPUBufferView			boundVertexBuffers[MAX_VERTEXSTREAM];
+	GPUBufferView			boundIndexBuffer;
+	EIndexFormat			boundIndexFormat{ INDEXFMT_UINT16 };
+
+	static bool IsSamePipelineState(const RenderDrawCmd& a, const RenderDrawCmd& b)
+	{
+		if (a.batchInfo.material != b.batchInfo.material || a.batchInfo.primTopology != b.batchInfo.primTopology)
+			return false;
+
+		const RenderInstanceInfo& instA = a.instanceInfo;
+		const RenderInstanceInfo& instB = b.instanceInfo;
+		if (instA.instFormat.formatId != instB.instFormat.formatId || instA.instFormat.layout.ptr() != instB.instFormat.layout.ptr())
+			return false;
+
+		if (instA.instData.instanceProvider != instB.instData.instanceProvider)
+			return false;
+
+		if (instA.uniformBuffers.numElem() != instB.uniformBuffers.numElem())
+			return false;
+
+		for (int i = 0; i < instA.uniformBuffers.numElem(); ++i)
+		{
+			const RenderBufferInfo& bufA = instA.uniformBuffers[i];
+			const RenderBufferInfo& bufB = instB.uniformBuffers[i];
+			if (bufA.signature != bufB.signature || bufA.bufferView != bufB.bufferView)
+				return false;
+		}
+		return true;
+	}
+
+	// pipeline and bind groups stay valid when nothing that affects them has changed
+	bool NeedPipelineSetup(const RenderDrawCmd& drawCmd, uint usedLayoutBits) const
+	{
+		return !pipelineCmd || pipelineLayoutBits != usedLayoutBits || !IsSamePipelineState(*pipelineCmd, drawCmd);
+	}
+
+	void ResetPipeline()
+	{
+		pipelineCmd = nullptr;
+	}
+
+	void SetPipeline(const RenderDrawCmd& drawCmd, uint usedLayoutBits, const IGPURenderPipeline* pipeline, RenderDrawStats& stats)
+	{
+		pipelineCmd = &drawCmd;
+		pipelineLayoutBits = usedLayoutBits;
+
+		if (boundPipeline != pipeline)
+		{
+			boundPipeline = pipeline;
+			++stats.numPipelinesBound;
+		}
+
+		if (boundMaterial != drawCmd.batchInfo.material)
+		{
+			boundMaterial = drawCmd.batchInfo.material;
+			++stats.numMaterialsBound;
+		}
+	}
+
+	// returns true if buffer must be set on recorder
+	bool SetVertexBuffer(int slot, const GPUBufferView& bufferView, RenderDrawStats& stats)
+	{
+		if (boundVertexBuffers[slot] == bufferView)
+			return false;
+
+		boundVertexBuffers[slot] = bufferView;
+		++stats.numVertexBuffersBound;
+		return true;
+	}
+
+	bool SetIndexBuffer(const GPUBufferView& bufferView, EIndexFormat indexFormat, RenderDrawStats& stats)
+	{
+		if (boundIndexBuffer == bufferView && boundIndexFormat == indexFormat)
+			return false;
+
+		boundIndexBuffer = bufferView;
+		boundIndexFormat = indexFormat;
+		++stats.numIndexBuffersBound;
+		return true;
+	}
+};
+
 enum EShaderBlendMode : int
 {
 	SHADER_BLEND_NONE = 0,
@@ -388,7 +498,7 @@ struct MatSysDefaultRenderPass : public RenderPassBaseData
 struct RenderPassContext
 {
 	RenderPassContext() = default;
-	RenderPassContext(IGPURenderPassRecorder* recorder, RenderPassBaseData* passData) 
+	RenderPassContext(IGPURenderCommandsRecorder* recorder, RenderPassBaseData* passData) 
 		: recorder(recorder)
 		, data(passData)
 	{}
@@ -397,6 +507,6 @@ struct RenderPassContext
 
 	BeforeMaterialSetupFunc		beforeMaterialSetup{ nullptr };
 
-	IGPURenderPassRecorderPtr	recorder;			// render pass recorder
+	IGPURenderCommandsRecorderPtr	recorder;		// render pass or render bundle recorder
 	RenderPassBaseData*			data{ nullptr };
 };
\ No newline at end of file
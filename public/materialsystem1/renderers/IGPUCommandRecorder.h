@@ -63,17 +63,6 @@ public:
 
 	virtual int						GetTargetMultiSamples() const = 0;
 
-	/* TODO: multi - threaded recorder
-		like:
-			GPUCommandBlock* block = cmdRec->BeginCommandBlock()
-				block.SetPipeline
-				block.SetBindGroup(n...)
-				block.SetVertexBuffer(...)
-				block.SetIndexBuffer(...)
-				block.Draw(...)
-			EndBlock(block)
-	*/
-
 	virtual void					DbgPopGroup() const = 0;
 	virtual void					DbgPushGroup(const char* groupLabel) const = 0;
 	virtual void					DbgAddMarker(const char* label) const = 0;
@@ -101,6 +90,8 @@ public:
 
 };
 
+using IGPURenderCommandsRecorderPtr = CRefPtr<IGPURenderCommandsRecorder>;
+
 inline void IGPURenderCommandsRecorder::SetVertexBufferView(int slot, const GPUBufferView& vertexBuffer)
 {
 	SetVertexBuffer(slot, vertexBuffer.buffer, vertexBuffer.offset, vertexBuffer.size);
@@ -113,11 +104,18 @@ inline void IGPURenderCommandsRecorder::SetIndexBufferView(const GPUBufferView&
 
 //---------------------------------
 // Render bundle recorder
+// Secondary recorder that can be filled on any thread and executed within
+// compatible render pass using IGPURenderPassRecorder::AddBundle.
+// Viewport and scissor rectangle are inherited from the render pass.
 class IGPURenderBundleRecorder : public IGPURenderCommandsRecorder
 {
 public:
-	EType							GetType() const { return PASS_RECORDER; }
+	EType							GetType() const { return BUNDLE_RECORDER; }
+
+	// completes bundle recording. After this bundle can be added to render pass
+	virtual void					Complete() = 0;
 };
+using IGPURenderBundleRecorderPtr = CRefPtr<IGPURenderBundleRecorder>;
 
 //---------------------------------
 // Render pass recorder
@@ -126,7 +124,7 @@ class IGPURenderPassRecorder : public IGPURenderCommandsRecorder
 public:
 	EType							GetType() const { return PASS_RECORDER; }
 
-	// adds render bundle
+	// executes completed render bundle
 	virtual void					AddBundle(IGPURenderBundleRecorder* bundle) = 0;
 
 	// completes pass recording. After this recorder can be disposed
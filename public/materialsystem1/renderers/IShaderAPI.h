@@ -135,6 +135,10 @@ public:
 	virtual IGPURenderPassRecorderPtr	BeginRenderPass(const RenderPassDesc& renderPassDesc, void* userData = nullptr) const = 0;
 	virtual IGPUComputePassRecorderPtr	BeginComputePass(const char* name, void* userData = nullptr) const = 0;
 
+	// creates render bundle recorder which is compatible with specified render pass.
+	// Bundles can be recorded on worker threads
+	virtual IGPURenderBundleRecorderPtr	CreateRenderBundleRecorder(const IGPURenderPassRecorder* compatiblePass, const char* name = nullptr, void* userData = nullptr) const = 0;
+
 //-------------------------------------------------------------
 // Command buffer management
 	
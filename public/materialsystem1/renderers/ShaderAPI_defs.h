@@ -262,6 +262,8 @@ enum EVertAttribFormat : int
 	ATTRIBUTEFORMAT_UINT8,
 	ATTRIBUTEFORMAT_HALF,
 	ATTRIBUTEFORMAT_FLOAT,
+	ATTRIBUTEFORMAT_UNORM8,		// read as float 0..1
+	ATTRIBUTEFORMAT_SNORM8,		// read as float -1..1
 };
 
 static int s_attributeSize[] =
@@ -269,7 +271,9 @@ static int s_attributeSize[] =
 	0,
 	sizeof(ubyte),
 	sizeof(half),
-	sizeof(float)
+	sizeof(float),
+	sizeof(ubyte),
+	sizeof(int8),
 };
 
 enum EVertexStepMode : int
@@ -478,6 +478,11 @@ bool CEGFGenerator::ParseModels(const KVSection* pSection)
 			// try apply global offset
 			m_modelOffset = KV_GetVector3D(keyBase, 0, vec3_zero);
 		}
+		else if (!keyBase->name.CompareCaseIns("hw_streams"))
+		{
+			// pre-bake hardware vertex streams
+			m_hwStreams = KV_GetValueBool(keyBase, 0, true);
+		}
 		else if (!keyBase->name.CompareCaseIns("FBXSource"))
 		{
 			LoadModelsFromFBX(keyBase);
@@ -602,6 +607,86 @@ void CEGFGenerator::ParseLods(const KVSection* pSection)
 
 		Msg("Added lod %d, distance: %2f\n", lodIdx, lodDist);
 	}
+
+	ParseAutoLods(pSection);
+}
+
+//************************************
+// Parses automatic LOD generation
+//************************************
+void CEGFGenerator::ParseAutoLods(const KVSection* pSection)
+{
+	/*
+	Example:
+
+		autolod
+		{
+			count 3;				// number of LODs generated after authored ones
+			ratio 0.5;				// triangle count ratio between each LOD
+			error 0.01 0.03 0.08;	// target error of each LOD relative to model extents
+			normal_weight 0.5;		// attribute weights for simplification
+			uv_weight 0.5;
+			pixel_error 1.0;		// LOD distances are computed from resulting error projected to screen
+		}
+	*/
+
+	const KVSection* autoLodSec = pSection->FindSection("autolod", KV_FLAG_SECTION);
+	if (!autoLodSec)
+		return;
+
+	const int numLods = KV_GetValueInt(autoLodSec->FindSection("count"), 0, 3);
+	const float ratio = KV_GetValueFloat(autoLodSec->FindSection("ratio"), 0, 0.5f);
+	const KVSection* errorSec = autoLodSec->FindSection("error");
+
+	m_simplifyNormalWeight = KV_GetValueFloat(autoLodSec->FindSection("normal_weight"), 0, 0.5f);
+	m_simplifyUvWeight = KV_GetValueFloat(autoLodSec->FindSection("uv_weight"), 0, 0.5f);
+	m_autoLodPixelError = max(0.01f, KV_GetValueFloat(autoLodSec->FindSection("pixel_error"), 0, 1.0f));
+	m_autoLodFirst = m_lodparams.numElem();
+
+	MsgWarning("\nGenerating LODs\n");
+
+	float simplifyThreshold = 1.0f;
+	float simplifyError = 0.01f;
+	for (int i = 0; i < numLods; ++i)
+	{
+		if (m_lodparams.numElem() >= MAX_MODEL_LODS)
+		{
+			MsgError("Reached max lod count (MAX_MODEL_LODS = %d)!", MAX_MODEL_LODS);
+			break;
+		}
+
+		simplifyThreshold *= ratio;
+		if (errorSec && i < errorSec->ValueCount())
+			simplifyError = KV_GetValueFloat(errorSec, i, simplifyError);
+		else if (i > 0)
+			simplifyError *= 2.0f;
+
+		const int lodIdx = m_lodparams.numElem();
+
+		// distance is computed during write from simplification error
+		studioLodParams_t& newlod = m_lodparams.append();
+		newlod.distance = 0.0f;
+		newlod.flags = 0;
+
+		for (GenLODList& lodList : m_modelLodLists)
+		{
+			if (lodList.lodmodels.numElem() != lodIdx)
+			{
+				MsgWarning("%s has manually specified LODs and is skipped for lod %d\n", lodList.name.ToCString(), lodIdx);
+				continue;
+			}
+
+			GenModel newModel = m_modelrefs[lodList.lodmodels[0]];
+			newModel.simplifyThreshold = simplifyThreshold;
+			newModel.simplifyError = simplifyError;
+			newModel.name.Append(EqString::Format("_autolod%d", lodIdx));
+
+			const int lodModel = m_modelrefs.append(newModel);
+			lodList.lodmodels.append(lodModel);
+		}
+
+		Msg("Added automatic lod %d, triangle ratio: %g, target error: %g\n", lodIdx, simplifyThreshold, simplifyError);
+	}
 }
 
 
@@ -74,6 +74,7 @@ protected:
 	bool					ParseModels(const KVSection* pSection);
 	void					ParseLodData(const KVSection* pSection, int lodIdx);
 	void					ParseLods(const KVSection* pSection);
+	void					ParseAutoLods(const KVSection* pSection);
 	bool					ParseBodyGroups(const KVSection* pSection);
 	bool					ParseMaterialGroups(const KVSection* pSection);
 	bool					ParseMaterialPaths(const KVSection* pSection);
@@ -90,7 +91,7 @@ protected:
 	int						UsedMaterialIndex(const char* pszName);
 
 	// writing to stream	
-	void					WriteGroup(studioHdr_t* header, IVirtualStream* stream, SharedModel::DSMesh* srcGroup, SharedModel::DSShapeKey* modShapeKey, float simplifyThreshold, studioMeshDesc_t* dstGroup);
+	float					WriteGroup(studioHdr_t* header, IVirtualStream* stream, SharedModel::DSMesh* srcGroup, SharedModel::DSShapeKey* modShapeKey, float simplifyThreshold, float simplifyError, studioMeshDesc_t* dstGroup);
 
 	void					WriteModels(studioHdr_t* header, IVirtualStream* stream);
 	void					WriteLods(studioHdr_t* header, IVirtualStream* stream);
@@ -101,6 +102,7 @@ protected:
 	void					WriteMaterialPaths(studioHdr_t* header, IVirtualStream* stream);
 	void					WriteMotionPackageList(studioHdr_t* header, IVirtualStream* stream);
 	void					WriteBones(studioHdr_t* header, IVirtualStream* stream);
+	void					WriteHwStreams(studioHdr_t* header, IVirtualStream* stream);
 
 	void					Validate(studioHdr_t* header, const char* stage);
 
@@ -121,10 +123,26 @@ protected:
 	Array<GenMaterialDesc*>		m_usedMaterials{ PP_SL };	// materials that used by models referenced by body groups
 	Array<GenMaterialGroup*>	m_matGroups{ PP_SL };		// material groups
 
+	// hardware vertex streams of all written meshes, mesh streams are not written with them
+	Array<studioVertexPosUv_t>	m_hwPosUvs{ PP_SL };
+	Array<studioVertexTBN_t>	m_hwTBNs{ PP_SL };
+	Array<studioBoneWeight_t>	m_hwBoneWeights{ PP_SL };
+	Array<studioVertexColor_t>	m_hwColors{ PP_SL };
+	Array<uint32>				m_hwIndices{ PP_SL };
+	int							m_hwVertexType{ 0 };
+
 	// settings
 	Vector3D					m_modelScale{ 1.0f };
 	Vector3D					m_modelOffset{ 0.0f };
 	bool						m_notextures{ false };
+	bool						m_hwStreams{ true };
+	bool						m_optimizeOverdraw{ true };
+
+	// simplification and automatic LODs
+	float						m_simplifyNormalWeight{ 0.0f };
+	float						m_simplifyUvWeight{ 0.0f };
+	float						m_autoLodPixelError{ 1.0f };
+	int							m_autoLodFirst{ -1 };		// first LOD which distance is computed from simplification error
 
 	EqString					m_refsPath;
 	EqString					m_outputFilename;
@@ -165,6 +183,11 @@ struct CEGFGenerator::GenModel
 	int			shapeIndex{ -1 };
 	int			meshGroupIdx{ -1 };				// model indices are remapped during write as not every modelref is used
 	float		simplifyThreshold{ 0.0f };
+	float		simplifyError{ 0.1f };			// target simplification error relative to model extents
+
+	// filled during write
+	float		lodError{ 0.0f };				// resulting simplification error in model units
+	int			numTriangles{ 0 };
 };
 
 struct CEGFGenerator::GenLODList
@@ -11,6 +11,7 @@
 #include "core/IFileSystem.h"
 #include "math/Utility.h"
 #include "EGFGenerator.h"
+#include "studiofile/StudioLoader.h"
 #include "utils/AdjacentTriangles.h"
 
 #include "dsm_loader.h"
@@ -27,8 +28,24 @@ using namespace SharedModel;
 #define WRITE_OFS						stream->Tell()		// write offset over header
 #define WRITE_RELATIVE_OFS(obj)			(stream->Tell() - ((ubyte*)obj - (ubyte*)header))	// write offset over object
 
+// reference view used to convert LOD simplification error into distance
+static constexpr const float s_autoLodScreenHeight = 1080.0f;
+static constexpr const float s_autoLodFovTan = 1.0f;	// tan(90 / 2)
+
 //---------------------------------------------------------------------------------------
 
+static int GetMeshTriangleCount(const studioMeshDesc_t* pMesh)
+{
+	switch (pMesh->primitiveType)
+	{
+	case STUDIO_PRIM_TRIANGLES:
+		return pMesh->numIndices / 3;
+	case STUDIO_PRIM_TRI_STRIP:
+		return pMesh->numIndices - 2;
+	}
+	return 0;
+}
+
 struct StudioVertexData
 {
 	studioVertexPosUv_t	posUvs;
@@ -132,8 +149,10 @@ int CEGFGenerator::UsedMaterialIndex(const char* pszName)
 
 
 // writes group
-void CEGFGenerator::WriteGroup(studioHdr_t* header, IVirtualStream* stream, DSMesh* srcGroup, DSShapeKey* modShapeKey, float simplifyThreshold, studioMeshDesc_t* dstGroup)
+float CEGFGenerator::WriteGroup(studioHdr_t* header, IVirtualStream* stream, DSMesh* srcGroup, DSShapeKey* modShapeKey, float simplifyThreshold, float simplifyError, studioMeshDesc_t* dstGroup)
 {
+	float lodError = 0.0f;
+
 	int vertexStreamsAvailableBits = STUDIO_VERTFLAG_POS_UV | STUDIO_VERTFLAG_TBN;
 
 	// DSM groups to be generated indices and optimized here
@@ -186,7 +205,7 @@ void CEGFGenerator::WriteGroup(studioHdr_t* header, IVirtualStream* stream, DSMe
 	if((float)indexList.numElem() / (float)3.0f != (int)indexList.numElem() / (int)3)
 	{
 		MsgError("Model group has invalid triangles!\n");
-		return;
+		return lodError;
 	}
 
 	auto usedVertList = ArrayRef<StudioVertexData>(modShapeKey ? shapeVertsList : vertexList);
@@ -234,6 +253,47 @@ void CEGFGenerator::WriteGroup(studioHdr_t* header, IVirtualStream* stream, DSMe
 	{
 		Array<int> outIndices(PP_SL);
 
+		if (simplifyThreshold > 0.0f && indexList.numElem())
+		{
+			MsgInfo("Simplifying group '%s' by %.2f threshold...\n", srcGroup->texture.ToCString(), simplifyThreshold);
+
+			// attributes are laid out sequentially after position: UV, tangent, binormal, normal
+			const float attributeWeights[] = {
+				m_simplifyUvWeight, m_simplifyUvWeight,
+				0.0f, 0.0f, 0.0f,
+				0.0f, 0.0f, 0.0f,
+				m_simplifyNormalWeight, m_simplifyNormalWeight, m_simplifyNormalWeight,
+			};
+			ASSERT(offsetOf(StudioVertexData, tbn.normal) - offsetOf(StudioVertexData, posUvs.texCoord) == sizeof(float) * (elementsOf(attributeWeights) - 3));
+
+			const int targetIndexCount = int(indexList.numElem() * simplifyThreshold);
+			outIndices.setNum(indexList.numElem());
+
+			int indexCount = 0;
+			if (m_simplifyUvWeight > 0.0f || m_simplifyNormalWeight > 0.0f)
+			{
+				indexCount = meshopt_simplifyWithAttributes(outIndices.ptr(), indexList.ptr(), indexList.numElem(),
+					usedVertList[0].posUvs.point, usedVertList.numElem(), sizeof(usedVertList[0]),
+					usedVertList[0].posUvs.texCoord, sizeof(usedVertList[0]), attributeWeights, elementsOf(attributeWeights), nullptr,
+					targetIndexCount, simplifyError, 0u, &lodError);
+			}
+			else
+			{
+				indexCount = meshopt_simplify(outIndices.ptr(), indexList.ptr(), indexList.numElem(),
+					usedVertList[0].posUvs.point, usedVertList.numElem(), sizeof(usedVertList[0]),
+					targetIndexCount, simplifyError, 0u, &lodError);
+			}
+
+			// convert relative error to model units
+			lodError *= meshopt_simplifyScale(usedVertList[0].posUvs.point, usedVertList.numElem(), sizeof(usedVertList[0]));
+
+			if(indexList.numElem() > indexCount)
+				MsgInfo("   Simplified %d >>> %d, lod error %g\n", indexList.numElem(), indexCount, lodError);
+
+			outIndices.setNum(indexCount, true);
+			indexList.swap(outIndices);
+		}
+
 		// optimize vertex cache
 		{
 			MsgInfo("Optimizing group '%s'...\n", srcGroup->texture.ToCString());
@@ -242,26 +302,27 @@ void CEGFGenerator::WriteGroup(studioHdr_t* header, IVirtualStream* stream, DSMe
 			indexList.swap(outIndices);
 		}
 
-		if (simplifyThreshold > 0.0f)
+		// reorder triangles to reduce overdraw while keeping cache efficiency
+		if (m_optimizeOverdraw && indexList.numElem())
 		{
-			MsgInfo("Simplifying group '%s' by %.2f threshold...\n", srcGroup->texture.ToCString(), simplifyThreshold);
-
-			constexpr float simplifyTargetError = 0.1f;
+			constexpr float overdrawCacheThreshold = 1.05f;
 
-			float lodError = 0.0f;
 			outIndices.setNum(indexList.numElem());
-			const int indexCount = meshopt_simplify(outIndices.ptr(), indexList.ptr(), indexList.numElem(),
-				usedVertList[0].posUvs.point, usedVertList.numElem(), sizeof(usedVertList[0]),
-				int(indexList.numElem() * simplifyThreshold), simplifyTargetError, 0u, &lodError);
+			meshopt_optimizeOverdraw(outIndices.ptr(), indexList.ptr(), indexList.numElem(),
+				usedVertList[0].posUvs.point, usedVertList.numElem(), sizeof(usedVertList[0]), overdrawCacheThreshold);
+			indexList.swap(outIndices);
+		}
 
-			if(indexList.numElem() > indexCount)
-				MsgInfo("   Simplified %d >>> %d, lod error %g\n", indexList.numElem(), indexCount, lodError);
+		// reorder vertices in the order of use, this also drops vertices unused after simplification
+		{
+			Array<StudioVertexData> fetchVertList(PP_SL);
+			fetchVertList.setNum(usedVertList.numElem());
 
-			outIndices.setNum(indexCount, true);
-			indexList.swap(outIndices);
+			const int vertexCount = meshopt_optimizeVertexFetch(fetchVertList.ptr(), indexList.ptr(), indexList.numElem(),
+				usedVertList.ptr(), usedVertList.numElem(), sizeof(StudioVertexData));
 
-			// TODO: also need to optimize vertex fetch
-			//meshopt_optimizeVertexFetch();
+			memcpy(usedVertList.ptr(), fetchVertList.ptr(), sizeof(StudioVertexData) * vertexCount);
+			usedVertList = ArrayRef<StudioVertexData>(usedVertList.ptr(), vertexCount);
 		}
 
 		// stripify group
@@ -295,6 +356,41 @@ void CEGFGenerator::WriteGroup(studioHdr_t* header, IVirtualStream* stream, DSMe
 
 	//WRT_TEXT("MODEL GROUP DATA");
 
+#if ENABLE_OLD_VERTEX_FORMAT == 0
+	if (m_hwStreams)
+	{
+		// vertices and indices are only stored in hardware vertex streams,
+		// mesh keeps it's first vertex and first index in them
+		dstGroup->vertexType = vertexStreamsAvailableBits;
+		dstGroup->vertexOffset = m_hwPosUvs.numElem();
+		dstGroup->indicesOffset = m_hwIndices.numElem();
+		m_hwVertexType |= vertexStreamsAvailableBits;
+
+		studioBoneWeight_t noBoneWeight{};
+		for (int i = 0; i < MAX_MODEL_VERTEX_WEIGHTS; i++)
+			noBoneWeight.bones[i] = -1;
+
+		for (int32 i = 0; i < dstGroup->numVertices; i++)
+		{
+			const StudioVertexData& vertData = usedVertList[i];
+
+			m_hwPosUvs.append(vertData.posUvs);
+			m_hwTBNs.append(vertData.tbn);
+			m_hwBoneWeights.append((vertexStreamsAvailableBits & STUDIO_VERTFLAG_BONEWEIGHT) ? vertData.boneWeights : noBoneWeight);
+			m_hwColors.append((vertexStreamsAvailableBits & STUDIO_VERTFLAG_COLOR) ? vertData.color : studioVertexColor_t{ color_white.pack() });
+		}
+
+		for (uint32 i = 0; i < dstGroup->numIndices; i++)
+			m_hwIndices.append(indexList[i] + dstGroup->vertexOffset);
+
+		MsgWarning("   written %d %s\n",
+			dstGroup->primitiveType == STUDIO_PRIM_TRI_STRIP ? (dstGroup->numIndices - 2) : (dstGroup->numIndices / 3),
+			dstGroup->primitiveType == STUDIO_PRIM_TRI_STRIP ? "strip primitives" : "triangles");
+
+		return lodError;
+	}
+#endif
+
 	// set write offset for vertex buffer
 	dstGroup->vertexOffset = WRITE_RELATIVE_OFS(dstGroup);
 
@@ -360,6 +456,8 @@ void CEGFGenerator::WriteGroup(studioHdr_t* header, IVirtualStream* stream, DSMe
 	MsgWarning("   written %d %s\n", 
 		dstGroup->primitiveType == STUDIO_PRIM_TRI_STRIP ? (dstGroup->numIndices - 2) : (dstGroup->numIndices / 3),
 		dstGroup->primitiveType == STUDIO_PRIM_TRI_STRIP ? "strip primitives" : "triangles");
+
+	return lodError;
 }
 
 //************************************
@@ -378,6 +476,13 @@ void CEGFGenerator::WriteModels(studioHdr_t* header, IVirtualStream* stream)
 		
 	*/
 
+	m_hwPosUvs.clear();
+	m_hwTBNs.clear();
+	m_hwBoneWeights.clear();
+	m_hwColors.clear();
+	m_hwIndices.clear();
+	m_hwVertexType = 0;
+
 	Array<GenModel*> writeModels{ PP_SL };
 	for (const GenLODList& lodList : m_modelLodLists)
 	{
@@ -421,9 +526,12 @@ void CEGFGenerator::WriteModels(studioHdr_t* header, IVirtualStream* stream)
 	// FIXME: Body groups will need a remapping once some models are unused
 	for(int i = 0; i < writeModels.numElem(); i++)
 	{
-		const GenModel& modelRef = *writeModels[i];
+		GenModel& modelRef = *writeModels[i];
 		studioMeshGroupDesc_t* pDesc = header->pMeshGroupDesc(i);
 
+		modelRef.lodError = 0.0f;
+		modelRef.numTriangles = 0;
+
 		// write groups
 		for(int j = 0; j < pDesc->numMeshes; j++)
 		{
@@ -431,7 +539,10 @@ void CEGFGenerator::WriteModels(studioHdr_t* header, IVirtualStream* stream)
 
 			// shape key modifier (if available)
 			DSShapeKey* key = (modelRef.shapeIndex != -1) ? modelRef.shapeData->shapes[modelRef.shapeIndex] : nullptr;
-			WriteGroup(header, stream, modelRef.model->meshes[j], key, modelRef.simplifyThreshold, groupDesc);
+			const float lodError = WriteGroup(header, stream, modelRef.model->meshes[j], key, modelRef.simplifyThreshold, modelRef.simplifyError, groupDesc);
+
+			modelRef.lodError = max(modelRef.lodError, lodError);
+			modelRef.numTriangles += GetMeshTriangleCount(groupDesc);
 
 			Msg("Wrote group %s:%d", modelRef.name.ToCString(), j);
 
@@ -482,6 +593,23 @@ void CEGFGenerator::WriteLods(studioHdr_t* header, IVirtualStream* stream)
 		}
 	}
 
+	// automatic LOD distances are where simplification error becomes smaller than pixel error
+	if (m_autoLodFirst > 0)
+	{
+		for (int i = m_autoLodFirst; i < m_lodparams.numElem(); i++)
+		{
+			float lodError = 0.0f;
+			for (const GenLODList* lodList : writeLodLists)
+			{
+				if (i < lodList->lodmodels.numElem())
+					lodError = max(lodError, m_modelrefs[lodList->lodmodels[i]].lodError);
+			}
+
+			const float lodDist = lodError * s_autoLodScreenHeight / (2.0f * s_autoLodFovTan * m_autoLodPixelError);
+			m_lodparams[i].distance = max(lodDist, m_lodparams[i - 1].distance);
+		}
+	}
+
 	header->lodParamsOffset = WRITE_OFS;
 	header->numLodParams = m_lodparams.numElem();
 	WRITE_RESERVE_NUM(studioLodParams_t, m_lodparams.numElem());
@@ -654,6 +782,61 @@ void CEGFGenerator::WriteBones(studioHdr_t* header, IVirtualStream* stream)
 	}
 }
 
+//************************************
+// Writes hardware vertex streams
+//************************************
+void CEGFGenerator::WriteHwStreams(studioHdr_t* header, IVirtualStream* stream)
+{
+	/*
+	Structure:
+
+		studioHwStreamsDesc_t	desc
+
+		studioHwVertexPosUv_t	posUvs[numVertices]
+		studioHwVertexTBN_t		tbns[numVertices]
+		studioHwBoneWeight_t	boneWeights[numVertices]		(optional)
+		studioVertexColor_t		colors[numVertices]				(optional)
+		uint16 or uint32		indices[numIndices]
+
+	Vertices of meshes are collected by WriteGroup, meshes only refer to them
+	*/
+
+	const int numVertices = m_hwPosUvs.numElem();
+	if (!numVertices)
+		return;
+
+	BoundingBox aabb;
+	for (const studioVertexPosUv_t& posUv : m_hwPosUvs)
+		aabb.AddVertex(posUv.point);
+
+	studioHwStreamsDesc_t desc;
+	const int size = Studio_InitHwStreams(desc, m_hwVertexType, numVertices, m_hwIndices.numElem());
+	desc.boundsMin = aabb.minPoint;
+	desc.boundsMax = aabb.maxPoint;
+
+	header->flags |= STUDIO_FLAG_HW_VERTEX_STREAMS;
+	header->hwStreamsOffset = WRITE_OFS;
+	WRITE_RESERVE_NUM(ubyte, size);
+
+	studioHwStreamsDesc_t* hwStreams = header->pHwStreams();
+	*hwStreams = desc;
+
+	for (int i = 0; i < numVertices; i++)
+		Studio_EncodeHwVertex(hwStreams, i, m_hwPosUvs[i], m_hwTBNs[i], m_hwBoneWeights[i], m_hwColors[i]);
+
+	uint16* indices16 = (uint16*)hwStreams->pIndices();
+	uint32* indices32 = (uint32*)hwStreams->pIndices();
+	for (int i = 0; i < m_hwIndices.numElem(); i++)
+	{
+		if (hwStreams->indexSize == sizeof(uint32))
+			indices32[i] = m_hwIndices[i];
+		else
+			indices16[i] = m_hwIndices[i] & 0xffff;
+	}
+
+	Msg(" hardware vertex streams: %d bytes\n", size);
+}
+
 void CEGFGenerator::Validate(studioHdr_t* header, const char* stage)
 {
 	Array<const GenModel*> writeModels{ PP_SL };
@@ -745,6 +928,13 @@ bool CEGFGenerator::GenerateEGF()
 	WriteBones(header, &egfStream);
 	Validate(header, "Write bones");
 
+	// pre-bake hardware vertex streams
+	if (m_hwStreams)
+	{
+		WriteHwStreams(header, &egfStream);
+		Validate(header, "Write hardware vertex streams");
+	}
+
 	// set the size of file (size with header), for validation purposes
 	header->length = egfStream.GetSize();
 
@@ -761,16 +951,25 @@ bool CEGFGenerator::GenerateEGF()
 		{
 			studioMeshDesc_t* pMesh = pMeshGroupDesc->pMesh(j);
 			totalVerts += pMesh->numVertices;
-			switch (pMesh->primitiveType)
-			{
-			case STUDIO_PRIM_TRIANGLES:
-				totalTris += pMesh->numIndices / 3;
-				break;
-			case STUDIO_PRIM_TRI_STRIP:
-				totalTris += pMesh->numIndices - 2;
-				break;
-			}
+			totalTris += GetMeshTriangleCount(pMesh);
+		}
+	}
+
+	for (int i = 0; i < m_lodparams.numElem(); i++)
+	{
+		int lodTris = 0;
+		float lodError = 0.0f;
+		for (const GenLODList& lodList : m_modelLodLists)
+		{
+			if (!lodList.used || i >= lodList.lodmodels.numElem())
+				continue;
+
+			const GenModel& modelRef = m_modelrefs[lodList.lodmodels[i]];
+			lodTris += modelRef.numTriangles;
+			lodError = max(lodError, modelRef.lodError);
 		}
+
+		Msg(" lod %d: distance %g, triangles: %d, error: %g\n", i, m_lodparams[i].distance, lodTris, lodError);
 	}
 
 	Msg(" total vertices: %d\n", totalVerts);
@@ -9,7 +9,7 @@
 #ifndef DATATABLES_H
 #define DATATABLES_H
 
-#include "utils/eqstring.h"
+#include "ds/eqstring.h"
 #include "math/Vector.h"
 #include "math/Matrix.h"
 
@@ -24,6 +24,8 @@ enum FieldFlag_e
 	FIELD_ARRAY			= (1 << 2),	// simple array
 	FIELD_LIST			= (1 << 3), // DkList dynamic array
 	FIELD_LINKEDLIST	= (1 << 4), // DkLinkedList by array
+
+	FIELD_NETWORKED		= (1 << 5),	// replicated by network snapshots
 };
 
 enum DataVarType_e
@@ -90,7 +92,7 @@ static int s_dataVarTypeSize[DTVAR_TYPE_COUNT] =
 	0,
 };
 
-static char* s_dataVarTypeNames[DTVAR_TYPE_COUNT] = 
+static const char* s_dataVarTypeNames[DTVAR_TYPE_COUNT] = 
 {
 	"void",
 	"float",
@@ -136,15 +138,15 @@ public:
 	inline int			GetInt() const					{ return( varType == DTVAR_TYPE_INTEGER ) ? iVal[0] : 0; }
 	inline float		GetFloat() const				{ return( varType == DTVAR_TYPE_FLOAT ) ? flVal[0] : 0; }
 
-	inline Matrix2x2	GetMatrix2x2() const			{ return( varType == DTVAR_TYPE_MATRIX2X2 ) ? Matrix2x2(	flVal[0],flVal[1],flVal[2],flVal[3]) : identity2();}
+	inline Matrix2x2	GetMatrix2x2() const			{ return( varType == DTVAR_TYPE_MATRIX2X2 ) ? Matrix2x2(	flVal[0],flVal[1],flVal[2],flVal[3]) : identity2;}
 	inline Matrix3x3	GetMatrix3x3() const			{ return( varType == DTVAR_TYPE_MATRIX3X3 ) ? Matrix3x3(	flVal[0],flVal[1],flVal[2],flVal[3],
 																													flVal[4],flVal[5],flVal[6],flVal[7],
-																													flVal[8]) : identity3();}
+																													flVal[8]) : identity3;}
 
 	inline Matrix4x4	GetMatrix4x4() const			{ return( varType == DTVAR_TYPE_MATRIX4X4 ) ? Matrix4x4(	flVal[0],flVal[1],flVal[2],flVal[3],
 																													flVal[4],flVal[5],flVal[6],flVal[7],
 																													flVal[8],flVal[9],flVal[10],flVal[11],
-																													flVal[12],flVal[13],flVal[14],flVal[15]) : identity4();}
+																													flVal[12],flVal[13],flVal[14],flVal[15]) : identity4;}
 
 	inline Vector2D		GetVector2D() const				{ return( varType == DTVAR_TYPE_VECTOR2D ) ? Vector2D(flVal[0],flVal[1]) : Vector2D(0);}
 	inline Vector3D		GetVector3D() const				{ return( varType == DTVAR_TYPE_VECTOR3D ) ? Vector3D(flVal[0],flVal[1],flVal[2]) : GetVector3DFromFixed();}
@@ -172,7 +174,7 @@ public:
 private:
 
 	inline Vector3D		GetVector3DFromFixed() const	{ return( varType == DTVAR_TYPE_FVECTOR3D ) ? Vector3D(FReal(iVal[0], 0),FReal(iVal[1], 0),FReal(iVal[2], 0)) : Vector3D(0);}
-	inline FVector3D	GetFVector3DFromFloat() const	{ return( varType == DTVAR_TYPE_VECTOR3D ) ? FVector3D(flVal[0],flVal[1],flVal[2]) : Vector3D(0);}
+	inline FVector3D	GetFVector3DFromFloat() const	{ return( varType == DTVAR_TYPE_VECTOR3D ) ? FVector3D(flVal[0],flVal[1],flVal[2]) : FVector3D(0);}
 
 	union
 	{
@@ -189,8 +191,8 @@ private:
 struct dataDescMap_t;
 
 #define MAKE_SIMPLE_CONSTRUCT_FUNC(friendlyName, dtvartype)									\
-	static dataDescField_t Field_##friendlyName##(const char* name, int offset, int flags){		\
-		return dataDescField_t { dtvartype, name, offset, flags, nullptr };						\
+	static dataDescField_t Field_##friendlyName(const char* name, int offset, int flags, float precision = 0.0f){	\
+		return dataDescField_t { dtvartype, name, offset, flags, nullptr, precision };			\
 	}
 
 // this is used by key fields and save data
@@ -229,6 +231,9 @@ struct dataDescField_t
 
 	// for embedding
 	dataDescMap_t*			dataMap;
+
+	// network quantization step (degrees for angles), zero sends full precision
+	float					precision{ 0.0f };
 };
 
 // the datamap
@@ -263,7 +268,7 @@ void DataMap_Print(dataDescMap_t* dataMap, int spaces = 0);
 	template <> dataDescMap_t* DataMapInit<className>( className * ) \
 	{ \
 		typedef className ThisClass; \
-		static mappedVar_t dataDesc[] = \
+		static dataDescField_t dataDesc[] = \
 		{ \
 			{ DTVAR_TYPE_VOID, nullptr, 0, 0, nullptr},	/* An empty element because we can't have empty array */
 
@@ -284,16 +289,21 @@ void DataMap_Print(dataDescMap_t* dataMap, int spaces = 0);
 	}
 
 #define BEGIN_DATAMAP( className ) \
-	dataDescMap_t className::m_DataMap = { #className, sizeof(ThisClass), &BaseClass::m_DataMap, 0, NULL }; \
+	dataDescMap_t className::m_DataMap = { #className, sizeof(className), &BaseClass::m_DataMap, 0, NULL }; \
 	dataDescMap_t* className::GetDataDescMap( void ) { return &m_DataMap; } \
 	BEGIN_DATAMAP_GUTS( className )
 
 //
 #define BEGIN_DATAMAP_NO_BASE( className ) \
-	dataDescMap_t className::m_DataMap = { #className, sizeof(ThisClass), NULL, 0, NULL }; \
+	dataDescMap_t className::m_DataMap = { #className, sizeof(className), NULL, 0, NULL }; \
 	dataDescMap_t* className::GetDataDescMap( void ) { return &m_DataMap; } \
 	BEGIN_DATAMAP_GUTS( className )
 
+// for structures declared with DECLARE_SIMPLE_DATAMAP
+#define BEGIN_SIMPLE_DATAMAP( className ) \
+	dataDescMap_t className::m_DataMap = { #className, sizeof(className), NULL, 0, NULL }; \
+	BEGIN_DATAMAP_GUTS( className )
+
 // creates data description map for structures
 #define DECLARE_SIMPLE_DATAMAP() \
 	static dataDescMap_t m_DataMap; \
@@ -304,14 +314,17 @@ void DataMap_Print(dataDescMap_t* dataMap, int spaces = 0);
 	DECLARE_SIMPLE_DATAMAP() \
 	virtual dataDescMap_t* GetDataDescMap( void );
 
-#define _NAMEFIELD(var, name, fieldtype, flags)			mappedVar_t::Field_##fieldtype##(name, offsetOf(ThisClass, var), flags)
-#define _FIELD(name, fieldtype, flags)					mappedVar_t::Field_##fieldtype##(#name, offsetOf(ThisClass, name), flags)
+#define _NAMEFIELD(var, name, fieldtype, flags)			dataDescField_t::Field_##fieldtype(name, offsetOf(ThisClass, var), flags)
+#define _FIELD(name, fieldtype, flags)					dataDescField_t::Field_##fieldtype(#name, offsetOf(ThisClass, name), flags)
 
 #define DEFINE_FIELD(name,fieldtype)					_FIELD(name, fieldtype, 0 )
 #define DEFINE_KEYFIELD(var,name,fieldtype)				_NAMEFIELD(var, name, fieldtype, FIELD_KEY )
 #define DEFINE_ARRAYFIELD(name,fieldtype)				_FIELD(name, fieldtype, FIELD_ARRAY )
 #define DEFINE_LISTFIELD(name,fieldtype)				_FIELD(name, fieldtype, FIELD_LIST )
 
+// replicated field, quantized with specified precision
+#define DEFINE_NETFIELD(name,fieldtype,precision)		dataDescField_t::Field_##fieldtype(#name, offsetOf(ThisClass, name), FIELD_NETWORKED, precision)
+
 // nested object
 #define DEFINE_MAPPEDOBJECT(name)						dataDescField_t { DTVAR_TYPE_NESTED, #name, offsetOf(ThisClass, name), 0, &(((ThisClass *)0)->name.m_DataMap) }
 
@@ -12,6 +12,7 @@ TODO:
 */
 
 #include "core/core_common.h"
+#include "core/ConCommand.h"
 #include "core/ConVar.h"
 #include "utils/KeyValues.h"
 #include "Font.h"
@@ -114,6 +115,7 @@ static CPlainTextLayoutBuilder s_defaultTextLayout;
 CFont::CFont()
 {
 	memset(&m_flags, 1, sizeof(m_flags));
+	memset(m_charPages, -1, sizeof(m_charPages));
 }
 
 float CFont::GetStringWidth( const char* str, const FontStyleParam& params, int charCount, int breakOnChar) const
@@ -364,18 +366,247 @@ DECLARE_CVAR(r_font_sdf_start, "0.94", nullptr, CV_CHEAT);
 DECLARE_CVAR(r_font_sdf_range, "0.06", nullptr, CV_CHEAT);
 DECLARE_CVAR(r_font_debug, "0", nullptr, CV_CHEAT);
 
-// renders text (wide char)
-void CFont::SetupRenderText(const wchar_t* pszText, const Vector2D& start, const FontStyleParam& params, IGPURenderPassRecorder* rendPassRecorder)
+DECLARE_CVAR(r_font_layoutcache, "1", "Cache glyph quads of repeatedly drawn text", 0);
+DECLARE_CVAR(r_font_layoutcache_size, "1024", "Max cached text layouts per font", 0);
+
+static struct
 {
-	int vertCount = GetTextQuadsCount(pszText, params) * 6;
-	if (vertCount == 0)
+	int64	hits{ 0 };
+	int64	misses{ 0 };
+	double	buildTime{ 0.0 };	// layout and fill on misses
+	double	fillTime{ 0.0 };	// fill from cache on hits
+} s_layoutCacheStats;
+
+DECLARE_CMD(r_font_layoutcache_stats, "Prints text layout cache hit rate and time saved since last call", 0)
+{
+	const int64 numTexts = s_layoutCacheStats.hits + s_layoutCacheStats.misses;
+	if (!numTexts)
+	{
+		Msg("No text was drawn using layout cache\n");
 		return;
+	}
+
+	const double buildTime = s_layoutCacheStats.misses ? s_layoutCacheStats.buildTime / s_layoutCacheStats.misses : 0.0;
+	const double fillTime = s_layoutCacheStats.hits ? s_layoutCacheStats.fillTime / s_layoutCacheStats.hits : 0.0;
+
+	Msg("Text layout cache: %" PRId64 " hits, %" PRId64 " misses, %.1f%% hit rate\n",
+		s_layoutCacheStats.hits, s_layoutCacheStats.misses, s_layoutCacheStats.hits * 100.0 / numTexts);
+	Msg("  text layout %.2f us, cached %.2f us, saved %.2f ms\n",
+		buildTime * 1000000.0, fillTime * 1000000.0, s_layoutCacheStats.hits * max(buildTime - fillTime, 0.0) * 1000.0);
+
+	s_layoutCacheStats = {};
+}
+
+//
+// Records mesh builder output to text layout instead of GPU buffers
+//
+class CTextLayoutCaptureMesh : public IDynamicMesh
+{
+public:
+	CTextLayoutCaptureMesh(ArrayCRef<VertexLayoutDesc> layoutDesc, Array<ubyte>& vertices, Array<uint16>& indices)
+		: m_layoutDesc(layoutDesc), m_vertices(vertices), m_indices(indices), m_vertexStride(layoutDesc[0].stride)
+	{
+	}
+
+	ArrayCRef<VertexLayoutDesc>	GetVertexLayoutDesc() const { return m_layoutDesc; }
+
+	void			SetPrimitiveType(EPrimTopology primType) { m_primType = primType; }
+	EPrimTopology	GetPrimitiveType() const { return m_primType; }
+
+	int AllocateGeom(int nVertices, int nIndices, void** verts, uint16** indices, bool addStripBreak)
+	{
+		if (nVertices == 0 && nIndices == 0)
+			return -1;
+
+		if (addStripBreak)
+			AddStripBreak();
+
+		const int startVertex = m_vertices.numElem() / m_vertexStride;
+		const int startIndex = m_indices.numElem();
+
+		m_vertices.setNum(m_vertices.numElem() + nVertices * m_vertexStride);
+		*verts = m_vertices.ptr() + startVertex * m_vertexStride;
+		memset(*verts, 0, nVertices * m_vertexStride);
+
+		if (indices && nIndices)
+		{
+			m_indices.setNum(startIndex + nIndices);
+			*indices = m_indices.ptr() + startIndex;
+			memset(*indices, 0, nIndices * sizeof(uint16));
+		}
+
+		return startVertex;
+	}
+
+	void AddStripBreak()
+	{
+		if (m_primType == PRIM_TRIANGLE_STRIP && m_indices.numElem())
+			m_indices.append(0xffff);
+	}
+
+	bool					FillDrawCmd(RenderDrawCmd& drawCmd, int firstIndex, int numIndices) { return false; }
+	IGPUCommandBufferPtr	GetSubmitBuffer() { return nullptr; }
+
+	void Reset()
+	{
+		m_vertices.clear(false);
+		m_indices.clear(false);
+	}
+
+private:
+	ArrayCRef<VertexLayoutDesc>	m_layoutDesc;
+	Array<ubyte>&				m_vertices;
+	Array<uint16>&				m_indices;
+	int							m_vertexStride;
+	EPrimTopology				m_primType{ PRIM_TRIANGLE_STRIP };
+};
+
+// text layout is moved by position, returns -1 if it can't be done in this vertex format
+static int GetTextLayoutPositionOffset(ArrayCRef<VertexLayoutDesc> layoutDesc)
+{
+	if (layoutDesc.numElem() != 1)
+		return -1;
+
+	for (const VertexLayoutDesc::AttribDesc& attrib : layoutDesc[0].attributes)
+	{
+		if (attrib.type != VERTEXATTRIB_POSITION)
+			continue;
+
+		if (attrib.format == ATTRIBUTEFORMAT_FLOAT && attrib.count >= 2)
+			return attrib.offset;
+		break;
+	}
+
+	return -1;
+}
+
+static int GetTextLength(const char* str) { return strlen(str); }
+static int GetTextLength(const wchar_t* str) { return wcslen(str); }
+
+// style parameters that affect glyph quads
+struct TextLayoutKeyParams
+{
+	float		textColor[4];
+	float		scale[2];
+	float		originX;
+	int			align;
+	int			styleFlag;
+	int			charSize;
+};
+
+template <typename CHAR_T>
+const CFont::TextLayout* CFont::GetCachedTextLayout(const CHAR_T* pszText, const FontStyleParam& params, const Vector2D& layoutOrigin, IDynamicMesh* dynMesh, bool& cacheHit)
+{
+	const int textSize = GetTextLength(pszText) * sizeof(CHAR_T);
+
+	TextLayoutKeyParams keyParams;
+	memset(&keyParams, 0, sizeof(keyParams));
+	for (int i = 0; i < 4; ++i)
+		keyParams.textColor[i] = params.textColor.v[i];
+	keyParams.scale[0] = params.scale.x;
+	keyParams.scale[1] = params.scale.y;
+	keyParams.originX = layoutOrigin.x;
+	keyParams.align = params.align;
+	keyParams.styleFlag = params.styleFlag;
+	keyParams.charSize = sizeof(CHAR_T);
+
+	const uint64 key = HashMapMix(HashMapHashBytes(pszText, textSize) * 31 + HashMapHashBytes(&keyParams, sizeof(keyParams)));
+	const int64 frameIndex = FrameAllocGetFrameIndex();
+
+	auto it = m_layoutCache.find(key);
+	if (!it.atEnd())
+	{
+		TextLayout& layout = *it;
+		if (layout.text.numElem() == textSize && !memcmp(layout.text.ptr(), pszText, textSize))
+		{
+			layout.lastUsedFrame = frameIndex;
+			cacheHit = true;
+			return &layout;
+		}
+	}
+
+	cacheHit = false;
+
+	if (GetTextQuadsCount(pszText, params) == 0)
+		return nullptr;
+
+	if (it.atEnd() && m_layoutCache.size() >= r_font_layoutcache_size.GetInt())
+		EvictTextLayouts();
+
+	// replaces layout on hash collision
+	TextLayout& layout = *m_layoutCache.insert(key);
+	layout.text.setNum(textSize, false);
+	memcpy(layout.text.ptr(), pszText, textSize);
+	layout.lastUsedFrame = frameIndex;
+
+	CTextLayoutCaptureMesh captureMesh(dynMesh->GetVertexLayoutDesc(), layout.vertices, layout.indices);
+	{
+		CMeshBuilder meshBuilder{ IDynamicMeshPtr(&captureMesh) };
+		meshBuilder.Begin(PRIM_TRIANGLE_STRIP);
+		BuildCharVertexBuffer(meshBuilder, pszText, layoutOrigin, params);
+		meshBuilder.End();
+	}
+
+	return &layout;
+}
+
+template const CFont::TextLayout* CFont::GetCachedTextLayout(const char* pszText, const FontStyleParam& params, const Vector2D& layoutOrigin, IDynamicMesh* dynMesh, bool& cacheHit);
+template const CFont::TextLayout* CFont::GetCachedTextLayout(const wchar_t* pszText, const FontStyleParam& params, const Vector2D& layoutOrigin, IDynamicMesh* dynMesh, bool& cacheHit);
+
+bool CFont::FillTextLayoutMesh(const TextLayout& layout, const Vector2D& offset, int positionOffset, IDynamicMesh* dynMesh, RenderDrawCmd& drawCmd) const
+{
+	const int vertexStride = dynMesh->GetVertexLayoutDesc()[0].stride;
+	const int numVerts = layout.vertices.numElem() / vertexStride;
+	if (!numVerts)
+		return false;
+
+	dynMesh->Reset();
+	dynMesh->SetPrimitiveType(PRIM_TRIANGLE_STRIP);
+
+	void* verts = nullptr;
+	uint16* indices = nullptr;
+	const int startVertex = dynMesh->AllocateGeom(numVerts, layout.indices.numElem(), &verts, &indices, false);
+	if (startVertex == -1)
+		return false;
+
+	ASSERT(startVertex == 0);
+
+	memcpy(verts, layout.vertices.ptr(), layout.vertices.numElem());
+	memcpy(indices, layout.indices.ptr(), layout.indices.numElem() * sizeof(uint16));
+
+	// layout was made at origin
+	ubyte* vertPos = reinterpret_cast<ubyte*>(verts) + positionOffset;
+	for (int i = 0; i < numVerts; ++i, vertPos += vertexStride)
+		*reinterpret_cast<Vector2D*>(vertPos) += offset;
+
+	return dynMesh->FillDrawCmd(drawCmd);
+}
+
+void CFont::EvictTextLayouts()
+{
+	// drop layouts that were not drawn during last frame
+	const int64 frameIndex = FrameAllocGetFrameIndex();
+	for (auto it = m_layoutCache.begin(); !it.atEnd(); )
+	{
+		if (frameIndex - it->lastUsedFrame > 1)
+			it = m_layoutCache.remove(it);
+		else
+			++it;
+	}
+
+	if (m_layoutCache.size() >= r_font_layoutcache_size.GetInt())
+		m_layoutCache.clear();
+}
 
+template <typename CHAR_T>
+void CFont::SetupRenderTextImpl(const CHAR_T* pszText, const Vector2D& start, const FontStyleParam& params, IGPURenderPassRecorder* rendPassRecorder)
+{
 	IDynamicMeshPtr dynMesh = g_matSystem->GetDynamicMesh();
-	CMeshBuilder meshBuilder(dynMesh);
 
 	if (r_font_debug.GetBool())
 	{
+		CMeshBuilder meshBuilder(dynMesh);
+
 		RenderDrawCmd drawCmd;
 		drawCmd.SetMaterial(g_matSystem->GetDefaultMaterial());
 
@@ -392,22 +623,42 @@ void CFont::SetupRenderText(const wchar_t* pszText, const Vector2D& start, const
 			g_matSystem->SetupDrawCommand(drawCmd, defaultPassContext);
 	}
 
-	RenderDrawCmd drawCmd;
+	// custom layout builders have the state that is read back after drawing
+	const int positionOffset = GetTextLayoutPositionOffset(dynMesh->GetVertexLayoutDesc());
+	if (r_font_layoutcache.GetBool() && !params.layoutBuilder && positionOffset != -1)
+	{
+		// aligned lines are snapped to whole pixels which depends on fractional part of start
+		const Vector2D layoutOrigin((params.align != TEXT_ALIGN_LEFT) ? start.x - floor(start.x) : 0.0f, 0.0f);
 
-	meshBuilder.Begin(PRIM_TRIANGLE_STRIP);
-	BuildCharVertexBuffer(meshBuilder, pszText, start, params);
-	if (meshBuilder.End(drawCmd))
-		SetupDrawTextMeshBuffer(drawCmd, params, rendPassRecorder);
-}
+		CEqTimer timer;
+		bool cacheHit = false;
+		const TextLayout* layout = GetCachedTextLayout(pszText, params, layoutOrigin, dynMesh, cacheHit);
+		if (!layout)
+			return;
 
-// renders text (ASCII)
-void CFont::SetupRenderText(const char* pszText, const Vector2D& start, const FontStyleParam& params, IGPURenderPassRecorder* rendPassRecorder)
-{
-	int vertCount = GetTextQuadsCount(pszText, params) * 6;
+		RenderDrawCmd drawCmd;
+		const bool hasGeometry = FillTextLayoutMesh(*layout, start - layoutOrigin, positionOffset, dynMesh, drawCmd);
+
+		if (cacheHit)
+		{
+			++s_layoutCacheStats.hits;
+			s_layoutCacheStats.fillTime += timer.GetTime();
+		}
+		else
+		{
+			++s_layoutCacheStats.misses;
+			s_layoutCacheStats.buildTime += timer.GetTime();
+		}
+
+		if (hasGeometry)
+			SetupDrawTextMeshBuffer(drawCmd, params, rendPassRecorder);
+		return;
+	}
+
+	const int vertCount = GetTextQuadsCount(pszText, params) * 6;
 	if (vertCount == 0)
 		return;
 
-	IDynamicMeshPtr dynMesh = g_matSystem->GetDynamicMesh();
 	CMeshBuilder meshBuilder(dynMesh);
 
 	RenderDrawCmd drawCmd;
@@ -417,6 +668,18 @@ void CFont::SetupRenderText(const char* pszText, const Vector2D& start, const Fo
 		SetupDrawTextMeshBuffer(drawCmd, params, rendPassRecorder);
 }
 
+// renders text (wide char)
+void CFont::SetupRenderText(const wchar_t* pszText, const Vector2D& start, const FontStyleParam& params, IGPURenderPassRecorder* rendPassRecorder)
+{
+	SetupRenderTextImpl(pszText, start, params, rendPassRecorder);
+}
+
+// renders text (ASCII)
+void CFont::SetupRenderText(const char* pszText, const Vector2D& start, const FontStyleParam& params, IGPURenderPassRecorder* rendPassRecorder)
+{
+	SetupRenderTextImpl(pszText, start, params, rendPassRecorder);
+}
+
 void CFont::SetupDrawTextMeshBuffer(RenderDrawCmd& drawCmd, const FontStyleParam& params, IGPURenderPassRecorder* rendPassRecorder)
 {
 	MatSysDefaultRenderPass defaultRenderPass;
@@ -476,12 +739,28 @@ const FontChar&	CFont::GetFontCharById( const int chrId ) const
 {
 	static FontChar null_default;
 
-	auto it = m_charMap.find(chrId);
+	if (chrId < 0 || chrId > 0xffff)
+		return null_default;
 
-	if(it.atEnd())
+	const int page = m_charPages[chrId >> CHAR_PAGE_BITS];
+	if (page == -1)
 		return null_default;
-	
-	return *it;
+
+	return m_charTable[page * CHAR_PAGE_SIZE + (chrId & (CHAR_PAGE_SIZE - 1))];
+}
+
+FontChar& CFont::AllocFontChar(int chrId)
+{
+	ASSERT(chrId >= 0 && chrId <= 0xffff);
+
+	int16& page = m_charPages[chrId >> CHAR_PAGE_BITS];
+	if (page == -1)
+	{
+		page = m_charTable.numElem() / CHAR_PAGE_SIZE;
+		m_charTable.setNum(m_charTable.numElem() + CHAR_PAGE_SIZE);
+	}
+
+	return m_charTable[page * CHAR_PAGE_SIZE + (chrId & (CHAR_PAGE_SIZE - 1))];
 }
 
 //
@@ -595,7 +874,7 @@ bool CFont::LoadFont( const char* filenamePrefix )
 				lChars = 0;
 			}
 
-			FontChar& chr = m_charMap[i];
+			FontChar& chr = AllocFontChar(i);
 
 			const float CurCharPos_x = lChars * charTall;
 			const float CurCharPos_y = line * charTall;
@@ -676,7 +955,10 @@ bool CFont::LoadFont( const char* filenamePrefix )
 			fontChar.advX *= m_scale.x;
 
 			const int charIdx = atoi(charSec->GetName());
-			m_charMap.insert(charIdx, fontChar);
+			if (charIdx < 0 || charIdx > 0xffff)
+				continue;
+
+			AllocFontChar(charIdx) = fontChar;
 		}
 
 		return true;
@@ -10,6 +10,7 @@
 #include "font/IFont.h"
 
 class CMeshBuilder;
+class IDynamicMesh;
 struct RenderDrawCmd;
 struct RenderPassContext;
 class ITexture;
@@ -43,10 +44,33 @@ public:
 
 protected:
 
-	using FontCharMap = Map<ushort, FontChar>;
+	static constexpr const int CHAR_PAGE_BITS = 8;
+	static constexpr const int CHAR_PAGE_SIZE = 1 << CHAR_PAGE_BITS;
+	static constexpr const int CHAR_PAGE_COUNT = 0x10000 >> CHAR_PAGE_BITS;
+
+	// positioned glyph quads of text in dynamic mesh vertex format
+	struct TextLayout
+	{
+		Array<ubyte>	text{ PP_SL };		// to resolve hash collisions
+		Array<ubyte>	vertices{ PP_SL };
+		Array<uint16>	indices{ PP_SL };	// from zero vertex, 0xffff is strip break
+		int64			lastUsedFrame{ 0 };
+	};
+	using TextLayoutCache = HashMap<uint64, TextLayout>;
+
+	template <typename CHAR_T>
+	void			SetupRenderTextImpl(const CHAR_T* pszText, const Vector2D& start, const FontStyleParam& params, IGPURenderPassRecorder* rendPassRecorder);
+
+	template <typename CHAR_T>
+	const TextLayout*	GetCachedTextLayout(const CHAR_T* pszText, const FontStyleParam& params, const Vector2D& layoutOrigin, IDynamicMesh* dynMesh, bool& cacheHit);
+
+	bool			FillTextLayoutMesh(const TextLayout& layout, const Vector2D& offset, int positionOffset, IDynamicMesh* dynMesh, RenderDrawCmd& drawCmd) const;
+	void			EvictTextLayouts();
 
 	void			SetupDrawTextMeshBuffer(RenderDrawCmd& drawCmd, const FontStyleParam& params, IGPURenderPassRecorder* rendPassRecorder);
 
+	FontChar&		AllocFontChar(int chrId);
+
 	// returns the character data
 	const FontChar&	GetFontCharById( const int chrId ) const;
 
@@ -66,8 +90,11 @@ protected:
 	template <typename CHAR_T>
 	int				GetTextQuadsCount(const CHAR_T *str, const FontStyleParam& params) const;
 
-	// map of chars
-	FontCharMap		m_charMap{ PP_SL };
+	// BMP characters by direct index, pages are allocated only for present characters
+	Array<FontChar>	m_charTable{ PP_SL };
+	int16			m_charPages[CHAR_PAGE_COUNT];
+
+	TextLayoutCache	m_layoutCache{ PP_SL };
 
 	EqString		m_name;
 
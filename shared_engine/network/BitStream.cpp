@@ -0,0 +1,550 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2024
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Bit-packed network stream
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "core/core_common.h"
+#include "BitStream.h"
+
+namespace Networking
+{
+
+static int BitsRequired(uint value)
+{
+	int numBits = 0;
+	while (value)
+	{
+		++numBits;
+		value >>= 1;
+	}
+	return numBits;
+}
+
+static constexpr const float s_quatComponentRange = 0.70710678f;	// 1 / sqrt(2), the largest component is never sent
+
+static uint QuantizeBounded(float value, float minValue, float maxValue, int numBits)
+{
+	const uint maxQuantized = uint((uint64(1) << numBits) - 1);
+	const float t = clamp((value - minValue) / (maxValue - minValue), 0.0f, 1.0f);
+	return uint(double(t) * maxQuantized + 0.5);
+}
+
+static float DequantizeBounded(uint value, float minValue, float maxValue, int numBits)
+{
+	const uint maxQuantized = uint((uint64(1) << numBits) - 1);
+	return minValue + float(double(value) / maxQuantized) * (maxValue - minValue);
+}
+
+CBitWriter::CBitWriter(ubyte* data, int sizeBytes)
+	: m_data(data), m_numBits(sizeBytes * 8)
+{
+}
+
+void CBitWriter::Reset()
+{
+	m_curBit = 0;
+	m_overflow = false;
+}
+
+void CBitWriter::SetOverflow()
+{
+	m_overflow = true;
+	m_curBit = m_numBits;
+}
+
+void CBitWriter::WriteBits(uint value, int numBits)
+{
+	ASSERT(numBits >= 0 && numBits <= 32);
+
+	if (m_curBit + numBits > m_numBits)
+	{
+		SetOverflow();
+		return;
+	}
+
+	if (numBits < 32)
+		value &= (1u << numBits) - 1;
+
+	const int byteIdx = m_curBit >> 3;
+	const int bitOfs = m_curBit & 7;
+
+	// whole 64 bit word fits - single read-modify-write, bits of next bytes are preserved by mask
+	if (byteIdx + 8 <= (m_numBits >> 3))
+	{
+		const uint64 mask = ((uint64(1) << numBits) - 1) << bitOfs;
+
+		uint64 word;
+		memcpy(&word, m_data + byteIdx, sizeof(word));
+		word = (word & ~mask) | (uint64(value) << bitOfs);
+		memcpy(m_data + byteIdx, &word, sizeof(word));
+
+		m_curBit += numBits;
+		return;
+	}
+
+	while (numBits > 0)
+	{
+		const int curByteIdx = m_curBit >> 3;
+		const int curBitOfs = m_curBit & 7;
+		const int bitsToWrite = min(8 - curBitOfs, numBits);
+
+		const uint mask = (1u << bitsToWrite) - 1;
+
+		// clear bits first as buffer is reused
+		m_data[curByteIdx] &= ~ubyte(mask << curBitOfs);
+		m_data[curByteIdx] |= ubyte((value & mask) << curBitOfs);
+
+		value >>= bitsToWrite;
+		numBits -= bitsToWrite;
+		m_curBit += bitsToWrite;
+	}
+}
+
+void CBitWriter::WriteUIntBits(uint value)
+{
+	const int numBits = BitsRequired(value);
+
+	// zero is written as 0 length
+	WriteBits(numBits ? numBits - 1 : 0, 5);
+	WriteBool(numBits > 0);
+	if (numBits > 1)
+		WriteBits(value, numBits - 1);	// top bit is always set
+}
+
+void CBitWriter::WriteIntBits(int value)
+{
+	WriteUIntBits(ZigZagEncode(value));
+}
+
+void CBitWriter::WriteVarUInt(uint value)
+{
+	while (value >= 0x80)
+	{
+		WriteBits((value & 0x7f) | 0x80, 8);
+		value >>= 7;
+	}
+	WriteBits(value, 8);
+}
+
+void CBitWriter::WriteVarInt(int value)
+{
+	WriteVarUInt(ZigZagEncode(value));
+}
+
+void CBitWriter::WriteFloat(float value)
+{
+	uint bits;
+	memcpy(&bits, &value, sizeof(bits));
+	WriteBits(bits, 32);
+}
+
+void CBitWriter::WriteBoundedFloat(float value, float minValue, float maxValue, int numBits)
+{
+	ASSERT(maxValue > minValue);
+	WriteBits(QuantizeBounded(value, minValue, maxValue, numBits), numBits);
+}
+
+void CBitWriter::WriteQuantizedFloat(float value, float precision)
+{
+	ASSERT(precision > 0.0f);
+
+	const float quantized = roundf(value / precision);
+	ASSERT_MSG(fabsf(quantized) < float(INT_MAX), "WriteQuantizedFloat - value %g out of range for precision %g", value, precision);
+
+	WriteVarInt(int(quantized));
+}
+
+void CBitWriter::WriteVector3D(const Vector3D& value, float precision)
+{
+	WriteQuantizedFloat(value.x, precision);
+	WriteQuantizedFloat(value.y, precision);
+	WriteQuantizedFloat(value.z, precision);
+}
+
+void CBitWriter::WriteNormal(const Vector3D& value, int numBits)
+{
+	// project to octahedron and unfold lower half over the diagonals
+	const float invLength = 1.0f / max(fabsf(value.x) + fabsf(value.y) + fabsf(value.z), F_EPS);
+	float u = value.x * invLength;
+	float v = value.y * invLength;
+	if (value.z < 0.0f)
+	{
+		const float unfoldU = (1.0f - fabsf(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+		const float unfoldV = (1.0f - fabsf(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+		u = unfoldU;
+		v = unfoldV;
+	}
+
+	WriteBoundedFloat(u, -1.0f, 1.0f, numBits);
+	WriteBoundedFloat(v, -1.0f, 1.0f, numBits);
+}
+
+void CBitWriter::WriteQuaternion(const Quaternion& value, int numBits)
+{
+	const float components[4] = { value.x, value.y, value.z, value.w };
+
+	int largestIdx = 0;
+	for (int i = 1; i < 4; ++i)
+	{
+		if (fabsf(components[i]) > fabsf(components[largestIdx]))
+			largestIdx = i;
+	}
+
+	// q and -q are the same rotation, make largest component positive so it can be restored from the others
+	const float sign = components[largestIdx] < 0.0f ? -1.0f : 1.0f;
+
+	WriteBits(largestIdx, 2);
+	for (int i = 0; i < 4; ++i)
+	{
+		if (i == largestIdx)
+			continue;
+		WriteBoundedFloat(components[i] * sign, -s_quatComponentRange, s_quatComponentRange, numBits);
+	}
+}
+
+void CBitWriter::WriteString(const char* str)
+{
+	const int length = strlen(str);
+	ASSERT_MSG(length <= NETSTREAM_MAX_STRING_LENGTH, "WriteString - string is too long (%d)", length);
+
+	WriteVarUInt(length);
+	WriteData(str, length);
+}
+
+void CBitWriter::WriteStringRef(CNetStringTable& table, const char* str)
+{
+	const int idx = table.Find(str);
+	WriteBool(idx != -1);
+
+	if (idx != -1)
+	{
+		WriteBits(idx, table.GetIndexBits());
+		return;
+	}
+
+	WriteString(str);
+
+	// reader won't get the string if it didn't fit, so it's sent again next time
+	if (!m_overflow)
+		table.Add(str);
+}
+
+void CBitWriter::WriteData(const void* data, int sizeBytes)
+{
+	if (m_curBit + sizeBytes * 8 > m_numBits)
+	{
+		SetOverflow();
+		return;
+	}
+
+	if ((m_curBit & 7) == 0)
+	{
+		memcpy(m_data + (m_curBit >> 3), data, sizeBytes);
+		m_curBit += sizeBytes * 8;
+		return;
+	}
+
+	const ubyte* bytes = reinterpret_cast<const ubyte*>(data);
+	for (int i = 0; i < sizeBytes; ++i)
+		WriteBits(bytes[i], 8);
+}
+
+void CBitWriter::AlignToByte()
+{
+	const int padding = (8 - (m_curBit & 7)) & 7;
+	WriteBits(0, padding);
+}
+
+//-------------------------------------------------------------
+
+CBitReader::CBitReader(const ubyte* data, int sizeBytes)
+	: m_data(data), m_numBits(sizeBytes * 8)
+{
+}
+
+void CBitReader::SetOverflow()
+{
+	m_overflow = true;
+	m_curBit = m_numBits;
+}
+
+uint CBitReader::ReadBits(int numBits)
+{
+	ASSERT(numBits >= 0 && numBits <= 32);
+
+	if (m_curBit + numBits > m_numBits)
+	{
+		SetOverflow();
+		return 0;
+	}
+
+	const int byteIdx = m_curBit >> 3;
+	const int bitOfs = m_curBit & 7;
+
+	if (byteIdx + 8 <= (m_numBits >> 3))
+	{
+		uint64 word;
+		memcpy(&word, m_data + byteIdx, sizeof(word));
+
+		m_curBit += numBits;
+		return uint((word >> bitOfs) & ((uint64(1) << numBits) - 1));
+	}
+
+	uint value = 0;
+	int valueBit = 0;
+	while (numBits > 0)
+	{
+		const int curByteIdx = m_curBit >> 3;
+		const int curBitOfs = m_curBit & 7;
+		const int bitsToRead = min(8 - curBitOfs, numBits);
+
+		const uint mask = (1u << bitsToRead) - 1;
+		value |= ((uint(m_data[curByteIdx]) >> curBitOfs) & mask) << valueBit;
+
+		valueBit += bitsToRead;
+		numBits -= bitsToRead;
+		m_curBit += bitsToRead;
+	}
+
+	return value;
+}
+
+int CBitReader::ReadInt(int numBits)
+{
+	const uint value = ReadBits(numBits);
+	if (numBits == 32 || numBits == 0)
+		return int(value);
+
+	// sign extend
+	const uint signBit = 1u << (numBits - 1);
+	return int((value ^ signBit) - signBit);
+}
+
+uint CBitReader::ReadUIntBits()
+{
+	const int numBits = ReadBits(5) + 1;
+	if (!ReadBool())
+		return 0;
+
+	if (numBits == 1)
+		return 1;
+
+	return ReadBits(numBits - 1) | (1u << (numBits - 1));
+}
+
+int CBitReader::ReadIntBits()
+{
+	return ZigZagDecode(ReadUIntBits());
+}
+
+uint CBitReader::ReadVarUInt()
+{
+	uint value = 0;
+	for (int shift = 0; shift < 35; shift += 7)
+	{
+		const uint group = ReadBits(8);
+		value |= (group & 0x7f) << shift;
+
+		if (!(group & 0x80))
+			return value;
+	}
+
+	// malformed, more than 5 groups
+	SetOverflow();
+	return 0;
+}
+
+int CBitReader::ReadVarInt()
+{
+	return ZigZagDecode(ReadVarUInt());
+}
+
+float CBitReader::ReadFloat()
+{
+	const uint bits = ReadBits(32);
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+float CBitReader::ReadBoundedFloat(float minValue, float maxValue, int numBits)
+{
+	return DequantizeBounded(ReadBits(numBits), minValue, maxValue, numBits);
+}
+
+float CBitReader::ReadQuantizedFloat(float precision)
+{
+	return ReadVarInt() * precision;
+}
+
+Vector3D CBitReader::ReadVector3D(float precision)
+{
+	Vector3D value;
+	value.x = ReadQuantizedFloat(precision);
+	value.y = ReadQuantizedFloat(precision);
+	value.z = ReadQuantizedFloat(precision);
+	return value;
+}
+
+Vector3D CBitReader::ReadNormal(int numBits)
+{
+	const float u = ReadBoundedFloat(-1.0f, 1.0f, numBits);
+	const float v = ReadBoundedFloat(-1.0f, 1.0f, numBits);
+
+	Vector3D value(u, v, 1.0f - fabsf(u) - fabsf(v));
+	if (value.z < 0.0f)
+	{
+		value.x = (1.0f - fabsf(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+		value.y = (1.0f - fabsf(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+	}
+
+	return normalize(value);
+}
+
+Quaternion CBitReader::ReadQuaternion(int numBits)
+{
+	const int largestIdx = ReadBits(2);
+
+	float components[4];
+	float sumSqr = 0.0f;
+	for (int i = 0; i < 4; ++i)
+	{
+		if (i == largestIdx)
+			continue;
+
+		components[i] = ReadBoundedFloat(-s_quatComponentRange, s_quatComponentRange, numBits);
+		sumSqr += components[i] * components[i];
+	}
+	components[largestIdx] = sqrtf(max(0.0f, 1.0f - sumSqr));
+
+	return Quaternion(components[3], components[0], components[1], components[2]);
+}
+
+int CBitReader::ReadString(char* dest, int maxLength)
+{
+	const int length = ReadVarUInt();
+	if (length >= maxLength || length > NETSTREAM_MAX_STRING_LENGTH)
+	{
+		SetOverflow();
+		if (maxLength > 0)
+			*dest = 0;
+		return -1;
+	}
+
+	ReadData(dest, length);
+	dest[length] = 0;
+
+	return m_overflow ? -1 : length;
+}
+
+EqString CBitReader::ReadString()
+{
+	char str[NETSTREAM_MAX_STRING_LENGTH + 1];
+	if (ReadString(str, sizeof(str)) < 0)
+		return EqString();
+
+	return EqString(str);
+}
+
+const char* CBitReader::ReadStringRef(CNetStringTable& table)
+{
+	if (ReadBool())
+	{
+		const int idx = ReadBits(table.GetIndexBits());
+		if (m_overflow || idx >= table.GetCount())
+		{
+			SetOverflow();
+			return nullptr;
+		}
+		return table.GetString(idx);
+	}
+
+	char str[NETSTREAM_MAX_STRING_LENGTH + 1];
+	if (ReadString(str, sizeof(str)) < 0)
+		return nullptr;
+
+	// writer adds the same string so tables stay in sync
+	const int idx = table.Add(str);
+	if (idx == -1)
+	{
+		// not stored (table is full or hash collides), writer sends it again next time
+		table.m_uncachedString = str;
+		return table.m_uncachedString;
+	}
+
+	return table.GetString(idx);
+}
+
+void CBitReader::ReadData(void* dest, int sizeBytes)
+{
+	if (m_curBit + sizeBytes * 8 > m_numBits)
+	{
+		SetOverflow();
+		memset(dest, 0, sizeBytes);
+		return;
+	}
+
+	if ((m_curBit & 7) == 0)
+	{
+		memcpy(dest, m_data + (m_curBit >> 3), sizeBytes);
+		m_curBit += sizeBytes * 8;
+		return;
+	}
+
+	ubyte* bytes = reinterpret_cast<ubyte*>(dest);
+	for (int i = 0; i < sizeBytes; ++i)
+		bytes[i] = ReadBits(8);
+}
+
+void CBitReader::AlignToByte()
+{
+	const int padding = (8 - (m_curBit & 7)) & 7;
+	ReadBits(padding);
+}
+
+//-------------------------------------------------------------
+
+CNetStringTable::CNetStringTable(int maxStrings)
+	: m_maxStrings(maxStrings)
+{
+	ASSERT(maxStrings > 1);
+	m_indexBits = BitsRequired(maxStrings - 1);
+}
+
+void CNetStringTable::Clear()
+{
+	m_strings.clear();
+	m_hashToIndex.clear();
+}
+
+int CNetStringTable::Find(const char* str) const
+{
+	auto it = m_hashToIndex.find(StringToHash(str));
+	if (it.atEnd())
+		return -1;
+
+	const int idx = *it;
+	if (m_strings[idx] != str)
+		return -1;
+
+	return idx;
+}
+
+int CNetStringTable::Add(const char* str)
+{
+	if (m_strings.numElem() >= m_maxStrings)
+		return -1;
+
+	const int hash = StringToHash(str);
+	auto it = m_hashToIndex.find(hash);
+	if (!it.atEnd())
+		return m_strings[*it] == str ? *it : -1;
+
+	const int idx = m_strings.append(str);
+	m_hashToIndex.insert(hash, idx);
+	return idx;
+}
+
+}; // namespace Networking
@@ -0,0 +1,178 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2024
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Bit-packed network stream
+//////////////////////////////////////////////////////////////////////////////////
+
+/*
+Example of use:
+
+	ubyte data[MAX_MESSAGE_LENGTH];
+	CBitWriter writer(data, sizeof(data));
+	writer.WriteVarUInt(objectId);
+	writer.WriteVector3D(position, 0.01f);		// quantized to 1 cm
+	writer.WriteNormal(normal, 10);				// octahedral, 20 bits total
+	writer.WriteBoundedFloat(impulse, 0.0f, 1000.0f, 12);
+	writer.WriteStringRef(stringTable, surfaceName);
+	send(data, writer.GetNumBytesWritten());
+
+	// reader must follow the same order and parameters
+	CBitReader reader(data, size);
+	const uint objectId = reader.ReadVarUInt();
+	...
+*/
+
+#pragma once
+
+namespace Networking
+{
+class CNetStringTable;
+
+static constexpr const int NETSTRINGTABLE_MAX_STRINGS = 1024;
+static constexpr const int NETSTREAM_MAX_STRING_LENGTH = 4096;
+
+// writes bits LSB first into fixed size buffer.
+// Overflow doesn't write out of buffer bounds and is reported by IsOverflowed
+class CBitWriter
+{
+public:
+	CBitWriter(ubyte* data, int sizeBytes);
+
+	void		Reset();
+
+	void		WriteBits(uint value, int numBits);
+	void		WriteBool(bool value)		{ WriteBits(value ? 1 : 0, 1); }
+
+	// two's complement signed value in numBits
+	void		WriteInt(int value, int numBits)	{ WriteBits(uint(value), numBits); }
+
+	// writes value with 5 bit length prefix, small values take less bits
+	void		WriteUIntBits(uint value);
+	void		WriteIntBits(int value);
+
+	// 7 bit groups with continuation bit. Signed values are zig-zag encoded
+	void		WriteVarUInt(uint value);
+	void		WriteVarInt(int value);
+
+	void		WriteFloat(float value);
+
+	// value clamped to range and stored in numBits
+	void		WriteBoundedFloat(float value, float minValue, float maxValue, int numBits);
+
+	// value / precision written as varint, unbounded
+	void		WriteQuantizedFloat(float value, float precision);
+	void		WriteVector3D(const Vector3D& value, float precision);
+
+	// unit vector in octahedral encoding, two components of numBits
+	void		WriteNormal(const Vector3D& value, int numBits);
+
+	// unit quaternion, index of largest component and other three of numBits each
+	void		WriteQuaternion(const Quaternion& value, int numBits);
+
+	// length prefixed, without null terminator
+	void		WriteString(const char* str);
+
+	// index of string if it was written before, otherwise string itself which is added to table
+	void		WriteStringRef(CNetStringTable& table, const char* str);
+
+	void		WriteData(const void* data, int sizeBytes);
+	void		AlignToByte();
+
+	int			GetNumBitsWritten() const	{ return m_curBit; }
+	int			GetNumBytesWritten() const	{ return (m_curBit + 7) >> 3; }
+	bool		IsOverflowed() const		{ return m_overflow; }
+
+	const ubyte* GetData() const			{ return m_data; }
+
+private:
+	void		SetOverflow();
+
+	ubyte*		m_data{ nullptr };
+	int			m_numBits{ 0 };
+	int			m_curBit{ 0 };
+	bool		m_overflow{ false };
+};
+
+class CBitReader
+{
+public:
+	CBitReader(const ubyte* data, int sizeBytes);
+
+	uint		ReadBits(int numBits);
+	bool		ReadBool()					{ return ReadBits(1) != 0; }
+
+	int			ReadInt(int numBits);
+
+	uint		ReadUIntBits();
+	int			ReadIntBits();
+
+	uint		ReadVarUInt();
+	int			ReadVarInt();
+
+	float		ReadFloat();
+	float		ReadBoundedFloat(float minValue, float maxValue, int numBits);
+	float		ReadQuantizedFloat(float precision);
+	Vector3D	ReadVector3D(float precision);
+	Vector3D	ReadNormal(int numBits);
+	Quaternion	ReadQuaternion(int numBits);
+
+	// returns string length or -1 if it does not fit into destination including null terminator
+	int			ReadString(char* dest, int maxLength);
+	EqString	ReadString();
+
+	// returns null on error. Pointer is valid until table is changed
+	const char*	ReadStringRef(CNetStringTable& table);
+
+	void		ReadData(void* dest, int sizeBytes);
+	void		AlignToByte();
+
+	int			GetNumBitsRead() const		{ return m_curBit; }
+	int			GetNumBitsLeft() const		{ return m_numBits - m_curBit; }
+	bool		IsOverflowed() const		{ return m_overflow; }
+
+private:
+	void		SetOverflow();
+
+	const ubyte* m_data{ nullptr };
+	int			m_numBits{ 0 };
+	int			m_curBit{ 0 };
+	bool		m_overflow{ false };
+};
+
+//-----------------------------------------------------------------------
+// strings shared by writer and reader for reference encoding.
+// Both sides must process the same stream in order (reliable channel)
+// so their tables stay identical
+class CNetStringTable
+{
+public:
+	CNetStringTable(int maxStrings = NETSTRINGTABLE_MAX_STRINGS);
+
+	void		Clear();
+
+	// returns -1 if not found
+	int			Find(const char* str) const;
+
+	// returns -1 when table is full or string hash collides with other entry
+	int			Add(const char* str);
+
+	const char*	GetString(int idx) const	{ return m_strings[idx]; }
+	int			GetCount() const			{ return m_strings.numElem(); }
+	int			GetIndexBits() const		{ return m_indexBits; }
+
+private:
+	friend class CBitReader;
+
+	Array<EqString>		m_strings{ PP_SL };
+	EqString			m_uncachedString;	// last read string that was not added
+	Map<int, int>		m_hashToIndex{ PP_SL };
+	int					m_maxStrings{ 0 };
+	int					m_indexBits{ 0 };
+};
+
+// maps signed integers to unsigned so small magnitudes stay small
+inline uint ZigZagEncode(int value)		{ return (uint(value) << 1) ^ uint(value >> 31); }
+inline int	ZigZagDecode(uint value)	{ return int(value >> 1) ^ -int(value & 1); }
+
+}; // namespace Networking
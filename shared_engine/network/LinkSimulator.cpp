@@ -0,0 +1,120 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2024
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Deterministic lossy link simulator for outgoing datagrams
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "core/core_common.h"
+#include "LinkSimulator.h"
+
+using namespace Threading;
+
+namespace Networking
+{
+
+CNetLinkSimulator::CNetLinkSimulator(const NetLinkSimParams& params)
+{
+	SetParams(params);
+}
+
+CNetLinkSimulator::~CNetLinkSimulator()
+{
+	m_delayed.clear(true);
+}
+
+void CNetLinkSimulator::SetParams(const NetLinkSimParams& params)
+{
+	CScopedMutex m(m_mutex);
+	m_params = params;
+	m_randState = params.seed ? params.seed : 1;
+}
+
+// xorshift32, own state so drop pattern does not depend on other random users
+uint CNetLinkSimulator::RandomNext()
+{
+	uint x = m_randState;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	m_randState = x;
+	return x;
+}
+
+void CNetLinkSimulator::SendTo(SOCKET sock, const void* data, int size, const sockaddr_in& to, uint32 timeMs)
+{
+	{
+		CScopedMutex m(m_mutex);
+
+		++m_stats.datagrams;
+		m_stats.bytes += size;
+
+		if (m_params.lossRate > 0.0f && (RandomNext() & 0xffffff) < uint(m_params.lossRate * float(0x1000000)))
+		{
+			++m_stats.dropped;
+			return;
+		}
+
+		const int jitter = m_params.jitterMs > 0 ? int(RandomNext() % (m_params.jitterMs + 1)) : 0;
+		const int delayMs = m_params.latencyMs + jitter;
+
+		if (delayMs > 0)
+		{
+			DelayedDatagram& delayed = m_delayed.append();
+			delayed.packet = g_packetPool.Alloc();
+			delayed.packet.Write(data, size);
+			delayed.to = to;
+			delayed.dueTime = timeMs + delayMs;
+			return;
+		}
+	}
+
+	sendto(sock, (const char*)data, size, 0, (const sockaddr*)&to, sizeof(sockaddr_in));
+}
+
+void CNetLinkSimulator::Update(SOCKET sock, uint32 timeMs)
+{
+	CScopedMutex m(m_mutex);
+
+	// keeps order of datagrams with the same due time
+	for (int i = 0; i < m_delayed.numElem(); )
+	{
+		DelayedDatagram& delayed = m_delayed[i];
+		if (int(timeMs - delayed.dueTime) < 0)
+		{
+			++i;
+			continue;
+		}
+
+		sendto(sock, (const char*)delayed.packet.GetData(), delayed.packet.GetSize(), 0, (const sockaddr*)&delayed.to, sizeof(sockaddr_in));
+		m_delayed.removeIndex(i);
+	}
+}
+
+int CNetLinkSimulator::GetNextDueMs(uint32 timeMs) const
+{
+	CScopedMutex m(m_mutex);
+
+	int nextDueMs = -1;
+	for (const DelayedDatagram& delayed : m_delayed)
+	{
+		const int dueMs = max(int(delayed.dueTime - timeMs), 0);
+		if (nextDueMs == -1 || dueMs < nextDueMs)
+			nextDueMs = dueMs;
+	}
+	return nextDueMs;
+}
+
+int CNetLinkSimulator::GetDelayedCount() const
+{
+	CScopedMutex m(m_mutex);
+	return m_delayed.numElem();
+}
+
+NetLinkSimStats CNetLinkSimulator::GetStats() const
+{
+	CScopedMutex m(m_mutex);
+	return m_stats;
+}
+
+}; // namespace Networking
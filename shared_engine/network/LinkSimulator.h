@@ -0,0 +1,68 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2024
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Deterministic lossy link simulator for outgoing datagrams
+//////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "PacketPool.h"
+
+namespace Networking
+{
+
+struct NetLinkSimParams
+{
+	float	lossRate{ 0.0f };		// 0..1 probability of datagram to be dropped
+	int		latencyMs{ 0 };			// one way delay
+	int		jitterMs{ 0 };			// random extra delay, reorders datagrams
+	uint	seed{ 1 };				// same seed gives same drop pattern
+};
+
+struct NetLinkSimStats
+{
+	int64	datagrams{ 0 };			// submitted to link
+	int64	bytes{ 0 };
+	int64	dropped{ 0 };
+};
+
+// sits between socket and sendto, drops and delays datagrams.
+// Delayed datagrams are sent by Update
+class CNetLinkSimulator
+{
+public:
+	CNetLinkSimulator(const NetLinkSimParams& params = NetLinkSimParams());
+	~CNetLinkSimulator();
+
+	void					SetParams(const NetLinkSimParams& params);
+	const NetLinkSimParams&	GetParams() const { return m_params; }
+
+	void					SendTo(SOCKET sock, const void* data, int size, const sockaddr_in& to, uint32 timeMs);
+
+	// sends datagrams which delay has expired
+	void					Update(SOCKET sock, uint32 timeMs);
+
+	// time until next delayed datagram or -1
+	int						GetNextDueMs(uint32 timeMs) const;
+	int						GetDelayedCount() const;
+
+	NetLinkSimStats			GetStats() const;
+
+private:
+	struct DelayedDatagram
+	{
+		PacketSlice		packet;
+		sockaddr_in		to;
+		uint32			dueTime;
+	};
+
+	uint					RandomNext();
+
+	mutable Threading::CEqMutex	m_mutex;
+	Array<DelayedDatagram>	m_delayed{ PP_SL };
+	NetLinkSimParams		m_params;
+	NetLinkSimStats			m_stats;
+	uint					m_randState{ 1 };
+};
+
+}; // namespace Networking
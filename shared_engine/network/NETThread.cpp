@@ -10,6 +10,9 @@
 #include "core/ConVar.h"
 #include "math/Random.h"
 
+// maximum time thread waits for network events, so cycle callbacks are still called
+#define NETTHREAD_MAX_WAIT_MS	50
+
 ConVar net_fakelatency("net_fakelatency", "0", "Simulate latency (value is in ms). Operating on recieved only\n", CV_CHEAT);
 ConVar net_fakelatency_randthresh("net_fakelatency_randthresh", "1.0f", "Fake latency randomization threshold\n", CV_CHEAT);
 
@@ -240,8 +243,14 @@ int CNetworkThread::Run()
 
 		m_prevTime = curTime;
 
-		// this system is lagging very hard if you use 1
-		Platform_Sleep( 1 );
+		// sleep until datagrams arrive, resend timer expires or new message is queued
+		int waitMs = m_stopWork ? 1 : NETTHREAD_MAX_WAIT_MS;
+
+		// lag test messages must be added in time
+		for(int i = 0; i < m_lateMessages.numElem(); i++)
+			waitMs = min(waitMs, max(0, (int)((m_lateMessages[i]->recvTime - curTime) * 1000.0)));
+
+		m_netInterface->GetSocket()->WaitForEvents( waitMs );
 	}
 
 	// reset
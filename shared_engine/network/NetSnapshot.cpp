@@ -0,0 +1,766 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2024
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Datamap driven delta snapshot replication
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "core/core_common.h"
+#include "core/ConVar.h"
+#include "core/platform/eqjobmanager.h"
+
+#include "NetSnapshot.h"
+#include "BitStream.h"
+
+using namespace Threading;
+
+DECLARE_CVAR(net_snapshotParallelMinClients, "4", "Minimal number of client snapshots built by single job", CV_ARCHIVE);
+
+namespace Networking
+{
+
+// entity operations in snapshot
+enum ENetSnapshotEntityOp : int
+{
+	NETSNAP_ENT_DELTA = 0,
+	NETSNAP_ENT_CREATE,
+	NETSNAP_ENT_REMOVE,
+
+	NETSNAP_ENT_OP_BITS = 2,
+};
+
+static int NetFieldWordCount(DataVarType_e type)
+{
+	switch (type)
+	{
+		case DTVAR_TYPE_FLOAT:
+		case DTVAR_TYPE_INTEGER:
+		case DTVAR_TYPE_BOOLEAN:
+		case DTVAR_TYPE_SHORT:
+		case DTVAR_TYPE_BYTE:
+			return 1;
+		case DTVAR_TYPE_VECTOR2D:
+			return 2;
+		case DTVAR_TYPE_VECTOR3D:
+		case DTVAR_TYPE_FVECTOR3D:
+		case DTVAR_TYPE_ANGLES:
+			return 3;
+		case DTVAR_TYPE_VECTOR4D:
+		case DTVAR_TYPE_MATRIX2X2:
+			return 4;
+		case DTVAR_TYPE_MATRIX3X3:
+			return 9;
+		case DTVAR_TYPE_MATRIX4X4:
+			return 16;
+	}
+	return 0;
+}
+
+static int QuantizeFloat(float value, float precision)
+{
+	return (int)floorf(value / precision + 0.5f);
+}
+
+static int QuantizeAngle(float angle, int numBits)
+{
+	const int steps = 1 << numBits;
+	float normAngle = fmodf(angle, 360.0f);
+	if (normAngle < 0.0f)
+		normAngle += 360.0f;
+
+	return (int)floorf(normAngle * (steps / 360.0f) + 0.5f) & (steps - 1);
+}
+
+// wrapping difference to keep delta coding valid for any values
+static int StateDelta(int value, int base)
+{
+	return int(uint(value) - uint(base));
+}
+
+//-----------------------------------------------------------------------
+
+CNetSnapshotSchema::CNetSnapshotSchema(const dataDescMap_t* dataMap)
+	: m_name(dataMap->dataClassName)
+{
+	AddFields(dataMap, 0, false);
+}
+
+void CNetSnapshotSchema::AddFields(const dataDescMap_t* dataMap, int baseOffset, bool networked)
+{
+	if (!dataMap)
+		return;
+
+	// base class fields go first
+	AddFields(dataMap->baseMap, baseOffset, networked);
+
+	for (int i = 0; i < dataMap->numFields; ++i)
+	{
+		const dataDescField_t& descField = dataMap->fields[i];
+		if (descField.type == DTVAR_TYPE_VOID)
+			continue;
+
+		// nested object is replicated entirely if it's marked as networked
+		const bool fieldNetworked = networked || (descField.nFlags & FIELD_NETWORKED);
+		if (descField.type == DTVAR_TYPE_NESTED)
+		{
+			if (descField.nFlags & (FIELD_ARRAY | FIELD_LIST))
+			{
+				if (fieldNetworked)
+					MsgWarning("CNetSnapshotSchema: %s.%s - arrays of objects are not replicated\n", dataMap->dataClassName, descField.name);
+				continue;
+			}
+
+			AddFields(descField.dataMap, baseOffset + descField.offset, fieldNetworked);
+			continue;
+		}
+
+		if (!fieldNetworked)
+			continue;
+
+		const int numWords = NetFieldWordCount(descField.type);
+		if (!numWords || (descField.nFlags & (FIELD_ARRAY | FIELD_LIST | FIELD_LINKEDLIST)))
+		{
+			MsgWarning("CNetSnapshotSchema: %s.%s - type %s can't be replicated\n", dataMap->dataClassName, descField.name, s_dataVarTypeNames[descField.type]);
+			continue;
+		}
+
+		NetSnapshotField& field = m_fields.append();
+		field.name = descField.name;
+		field.offset = baseOffset + descField.offset;
+		field.type = descField.type;
+		field.precision = descField.precision;
+		field.firstWord = m_numWords;
+		field.numWords = numWords;
+
+		switch (descField.type)
+		{
+			case DTVAR_TYPE_INTEGER:
+			case DTVAR_TYPE_SHORT:
+			case DTVAR_TYPE_BYTE:
+				field.encoding = NETFIELD_ENC_INTEGER;
+				break;
+			case DTVAR_TYPE_BOOLEAN:
+				field.encoding = NETFIELD_ENC_BOOLEAN;
+				break;
+			case DTVAR_TYPE_ANGLES:
+				if (field.precision > 0.0f)
+				{
+					field.encoding = NETFIELD_ENC_ANGLE;
+					field.angleBits = clamp((int)ceilf(log2f(360.0f / field.precision)), 1, 24);
+				}
+				else
+					field.encoding = NETFIELD_ENC_FLOAT;
+				break;
+			default:
+				field.encoding = field.precision > 0.0f ? NETFIELD_ENC_QUANTIZED : NETFIELD_ENC_FLOAT;
+		}
+
+		m_numWords += numWords;
+	}
+}
+
+void CNetSnapshotSchema::Quantize(const void* object, int* state) const
+{
+	const ubyte* objectData = (const ubyte*)object;
+
+	for (const NetSnapshotField& field : m_fields)
+	{
+		const ubyte* fieldData = objectData + field.offset;
+		int* fieldState = state + field.firstWord;
+
+		switch (field.type)
+		{
+			case DTVAR_TYPE_INTEGER:
+				fieldState[0] = *(const int*)fieldData;
+				continue;
+			case DTVAR_TYPE_SHORT:
+				fieldState[0] = *(const short*)fieldData;
+				continue;
+			case DTVAR_TYPE_BYTE:
+				fieldState[0] = *(const char*)fieldData;
+				continue;
+			case DTVAR_TYPE_BOOLEAN:
+				fieldState[0] = *(const bool*)fieldData ? 1 : 0;
+				continue;
+		}
+
+		for (int i = 0; i < field.numWords; ++i)
+		{
+			const float value = (field.type == DTVAR_TYPE_FVECTOR3D) ? (float)((const FReal*)fieldData)[i] : ((const float*)fieldData)[i];
+
+			if (field.encoding == NETFIELD_ENC_QUANTIZED)
+				fieldState[i] = QuantizeFloat(value, field.precision);
+			else if (field.encoding == NETFIELD_ENC_ANGLE)
+				fieldState[i] = QuantizeAngle(value, field.angleBits);
+			else
+				memcpy(&fieldState[i], &value, sizeof(float));
+		}
+	}
+}
+
+void CNetSnapshotSchema::Dequantize(const int* state, void* object) const
+{
+	ubyte* objectData = (ubyte*)object;
+
+	for (const NetSnapshotField& field : m_fields)
+	{
+		ubyte* fieldData = objectData + field.offset;
+		const int* fieldState = state + field.firstWord;
+
+		switch (field.type)
+		{
+			case DTVAR_TYPE_INTEGER:
+				*(int*)fieldData = fieldState[0];
+				continue;
+			case DTVAR_TYPE_SHORT:
+				*(short*)fieldData = (short)fieldState[0];
+				continue;
+			case DTVAR_TYPE_BYTE:
+				*(char*)fieldData = (char)fieldState[0];
+				continue;
+			case DTVAR_TYPE_BOOLEAN:
+				*(bool*)fieldData = fieldState[0] != 0;
+				continue;
+		}
+
+		for (int i = 0; i < field.numWords; ++i)
+		{
+			float value;
+			if (field.encoding == NETFIELD_ENC_QUANTIZED)
+				value = fieldState[i] * field.precision;
+			else if (field.encoding == NETFIELD_ENC_ANGLE)
+				value = fieldState[i] * (360.0f / (1 << field.angleBits));
+			else
+				memcpy(&value, &fieldState[i], sizeof(float));
+
+			if (field.type == DTVAR_TYPE_FVECTOR3D)
+				((FReal*)fieldData)[i] = FReal(value);
+			else
+				((float*)fieldData)[i] = value;
+		}
+	}
+}
+
+void CNetSnapshotSchema::WriteDelta(CBitWriter& writer, const int* baseline, const int* state) const
+{
+	for (const NetSnapshotField& field : m_fields)
+	{
+		const int* fieldState = state + field.firstWord;
+		const int* fieldBase = baseline ? baseline + field.firstWord : nullptr;
+
+		bool changed = false;
+		for (int i = 0; i < field.numWords && !changed; ++i)
+			changed = fieldState[i] != (fieldBase ? fieldBase[i] : 0);
+
+		writer.WriteBool(changed);
+		if (!changed)
+			continue;
+
+		for (int i = 0; i < field.numWords; ++i)
+		{
+			switch (field.encoding)
+			{
+				case NETFIELD_ENC_FLOAT:
+					writer.WriteBits(fieldState[i], 32);
+					break;
+				case NETFIELD_ENC_QUANTIZED:
+				case NETFIELD_ENC_INTEGER:
+					writer.WriteIntBits(StateDelta(fieldState[i], fieldBase ? fieldBase[i] : 0));
+					break;
+				case NETFIELD_ENC_BOOLEAN:
+					writer.WriteBool(fieldState[i] != 0);
+					break;
+				case NETFIELD_ENC_ANGLE:
+					writer.WriteBits(fieldState[i], field.angleBits);
+					break;
+			}
+		}
+	}
+}
+
+void CNetSnapshotSchema::ReadDelta(CBitReader& reader, const int* baseline, int* state) const
+{
+	for (const NetSnapshotField& field : m_fields)
+	{
+		int* fieldState = state + field.firstWord;
+		const int* fieldBase = baseline ? baseline + field.firstWord : nullptr;
+
+		if (!reader.ReadBool())
+		{
+			for (int i = 0; i < field.numWords; ++i)
+				fieldState[i] = fieldBase ? fieldBase[i] : 0;
+			continue;
+		}
+
+		for (int i = 0; i < field.numWords; ++i)
+		{
+			switch (field.encoding)
+			{
+				case NETFIELD_ENC_FLOAT:
+					fieldState[i] = (int)reader.ReadBits(32);
+					break;
+				case NETFIELD_ENC_QUANTIZED:
+				case NETFIELD_ENC_INTEGER:
+					fieldState[i] = int(uint(fieldBase ? fieldBase[i] : 0) + uint(reader.ReadIntBits()));
+					break;
+				case NETFIELD_ENC_BOOLEAN:
+					fieldState[i] = reader.ReadBool() ? 1 : 0;
+					break;
+				case NETFIELD_ENC_ANGLE:
+					fieldState[i] = (int)reader.ReadBits(field.angleBits);
+					break;
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------
+
+void NetSnapshotFrame::Clear()
+{
+	frame = -1;
+	entities.clear();
+	states.clear();
+}
+
+void NetSnapshotFrame::AddEntity(int entityId, int schemaIdx, const int* state, int numWords)
+{
+	ASSERT(entities.numElem() == 0 || entities.back().entityId < entityId);
+
+	NetSnapshotEntity& ent = entities.append();
+	ent.entityId = entityId;
+	ent.schemaIdx = schemaIdx;
+	ent.stateOfs = states.numElem();
+	states.append(state, numWords);
+}
+
+static const NetSnapshotEntity* FindSnapshotEntity(const NetSnapshotFrame& frame, int entityId)
+{
+	int first = 0;
+	int last = frame.entities.numElem() - 1;
+	while (first <= last)
+	{
+		const int mid = (first + last) >> 1;
+		const NetSnapshotEntity& ent = frame.entities[mid];
+		if (ent.entityId == entityId)
+			return &ent;
+
+		if (ent.entityId < entityId)
+			first = mid + 1;
+		else
+			last = mid - 1;
+	}
+	return nullptr;
+}
+
+//-----------------------------------------------------------------------
+
+// builds snapshots for range of clients
+class CNetSnapshotServer::CBuildSnapshotsJob : public IParallelJob
+{
+public:
+	CBuildSnapshotsJob()
+		: IParallelJob("BuildClientSnapshots")
+	{
+		InitSignal();
+	}
+
+	void Execute() override
+	{
+		for (Client* client : m_clients)
+			m_server->BuildClientSnapshot(*client);
+	}
+
+	const CNetSnapshotServer*	m_server{ nullptr };
+	ArrayCRef<Client*>			m_clients{ nullptr };
+};
+
+CNetSnapshotServer::CNetSnapshotServer()
+{
+}
+
+CNetSnapshotServer::~CNetSnapshotServer()
+{
+	for (Client* client : m_clients)
+		delete client;
+
+	for (CBuildSnapshotsJob* job : m_buildJobs)
+		delete job;
+}
+
+int CNetSnapshotServer::AddSchema(const CNetSnapshotSchema* schema)
+{
+	return m_schemas.append(schema);
+}
+
+void CNetSnapshotServer::AddEntity(int entityId, int schemaIdx, const void* object)
+{
+	ASSERT(m_schemas.inRange(schemaIdx));
+	ASSERT(entityId >= 0);
+
+	m_entities[entityId] = ServerEntity{ schemaIdx, object };
+}
+
+void CNetSnapshotServer::RemoveEntity(int entityId)
+{
+	auto it = m_entities.find(entityId);
+	if (!it.atEnd())
+		m_entities.remove(it);
+}
+
+int CNetSnapshotServer::AddClient()
+{
+	int clientIdx = -1;
+	for (int i = 0; i < m_clients.numElem(); ++i)
+	{
+		if (!m_clients[i]->active)
+		{
+			clientIdx = i;
+			break;
+		}
+	}
+
+	if (clientIdx == -1)
+	{
+		clientIdx = m_clients.append(PPNew Client());
+		m_clients[clientIdx]->buffer.setNum(NETSNAPSHOT_MAX_SIZE);
+	}
+
+	Client& client = *m_clients[clientIdx];
+	client.active = true;
+	client.ackFrame = -1;
+	client.snapshotSize = 0;
+
+	return clientIdx;
+}
+
+void CNetSnapshotServer::RemoveClient(int clientIdx)
+{
+	m_clients[clientIdx]->active = false;
+}
+
+void CNetSnapshotServer::AckSnapshot(int clientIdx, int frame)
+{
+	Client& client = *m_clients[clientIdx];
+
+	// acknowledges may come out of order
+	if (frame > client.ackFrame && frame <= m_curFrame)
+		client.ackFrame = frame;
+}
+
+int CNetSnapshotServer::TakeSnapshot()
+{
+	++m_curFrame;
+
+	NetSnapshotFrame& frame = m_frames[m_curFrame % NETSNAPSHOT_HISTORY];
+	frame.Clear();
+	frame.frame = m_curFrame;
+
+	for (auto it = m_entities.begin(); !it.atEnd(); ++it)
+	{
+		const ServerEntity& ent = *it;
+		const CNetSnapshotSchema* schema = m_schemas[ent.schemaIdx];
+		const int numWords = schema->GetStateWords();
+
+		const int stateOfs = frame.states.numElem();
+		frame.states.setNum(stateOfs + numWords);
+		schema->Quantize(ent.object, frame.states.ptr() + stateOfs);
+
+		NetSnapshotEntity& snapEnt = frame.entities.append();
+		snapEnt.entityId = it.key();
+		snapEnt.schemaIdx = ent.schemaIdx;
+		snapEnt.stateOfs = stateOfs;
+	}
+
+	return m_curFrame;
+}
+
+const NetSnapshotFrame* CNetSnapshotServer::GetFrame(int frame) const
+{
+	if (frame < 0 || frame > m_curFrame || m_curFrame - frame >= NETSNAPSHOT_HISTORY)
+		return nullptr;
+
+	const NetSnapshotFrame& snapshotFrame = m_frames[frame % NETSNAPSHOT_HISTORY];
+	return snapshotFrame.frame == frame ? &snapshotFrame : nullptr;
+}
+
+void CNetSnapshotServer::BuildClientSnapshots(CEqJobManager* jobMng)
+{
+	if (m_curFrame < 0)
+		return;
+
+	CEqTimer timer;
+
+	Array<Client*> activeClients(PP_SL);
+	for (Client* client : m_clients)
+	{
+		if (client->active)
+			activeClients.append(client);
+	}
+
+	const int numClients = activeClients.numElem();
+	const int minClientsPerJob = max(1, net_snapshotParallelMinClients.GetInt());
+
+	int numJobs = 1;
+	if (jobMng && jobMng->GetJobThreadsCount() > 0)
+		numJobs = clamp(numClients / minClientsPerJob, 1, jobMng->GetJobThreadsCount() + 1);
+
+	const int clientsPerJob = numJobs > 1 ? (numClients + numJobs - 1) / numJobs : numClients;
+
+	while (m_buildJobs.numElem() < numJobs - 1)
+		m_buildJobs.append(PPNew CBuildSnapshotsJob());
+
+	// first range is built by this thread
+	int numStartedJobs = 0;
+	for (int start = clientsPerJob; start < numClients; start += clientsPerJob)
+	{
+		CBuildSnapshotsJob* job = m_buildJobs[numStartedJobs++];
+		job->m_server = this;
+		job->m_clients = ArrayCRef<Client*>(activeClients.ptr() + start, min(clientsPerJob, numClients - start));
+		job->InitJob();
+		jobMng->StartJob(job);
+	}
+
+	for (int i = 0; i < min(clientsPerJob, numClients); ++i)
+		BuildClientSnapshot(*activeClients[i]);
+
+	for (int i = 0; i < numStartedJobs; ++i)
+		m_buildJobs[i]->GetSignal()->Wait();
+
+	for (Client* client : activeClients)
+	{
+		++m_stats.numSnapshots;
+		m_stats.numBytes += client->snapshotSize;
+		m_stats.numEntityUpdates += client->numEntityUpdates;
+		if (!GetFrame(client->ackFrame))
+			++m_stats.numFullUpdates;
+	}
+
+	m_stats.buildTimeMs = timer.GetTimeMS();
+}
+
+// snapshot layout:
+//	frame(32) | has baseline(1) [ frame - baseline frame ]
+//	{ 1 | entity id delta | op(2) [ schema ] [ fields ] } ... 0
+void CNetSnapshotServer::BuildClientSnapshot(Client& client) const
+{
+	const NetSnapshotFrame& frame = *GetFrame(m_curFrame);
+	const NetSnapshotFrame* baseline = GetFrame(client.ackFrame);
+
+	CBitWriter writer(client.buffer.ptr(), client.buffer.numElem());
+	writer.WriteBits(frame.frame, 32);
+	writer.WriteBool(baseline != nullptr);
+	if (baseline)
+		writer.WriteUIntBits(frame.frame - baseline->frame);
+
+	int numEntityUpdates = 0;
+	int prevEntityId = -1;
+	auto writeEntityOp = [&](int entityId, ENetSnapshotEntityOp op) {
+		writer.WriteBool(true);
+		writer.WriteUIntBits(entityId - prevEntityId - 1);
+		writer.WriteBits(op, NETSNAP_ENT_OP_BITS);
+		prevEntityId = entityId;
+	};
+
+	const int numBaseEntities = baseline ? baseline->entities.numElem() : 0;
+	int baseIdx = 0;
+
+	for (const NetSnapshotEntity& ent : frame.entities)
+	{
+		// entities missing in the new frame are removed
+		while (baseIdx < numBaseEntities && baseline->entities[baseIdx].entityId < ent.entityId)
+			writeEntityOp(baseline->entities[baseIdx++].entityId, NETSNAP_ENT_REMOVE);
+
+		const NetSnapshotEntity* baseEnt = nullptr;
+		if (baseIdx < numBaseEntities && baseline->entities[baseIdx].entityId == ent.entityId)
+			baseEnt = &baseline->entities[baseIdx++];
+
+		const CNetSnapshotSchema* schema = m_schemas[ent.schemaIdx];
+		const int* state = frame.states.ptr() + ent.stateOfs;
+
+		if (baseEnt && baseEnt->schemaIdx == ent.schemaIdx)
+		{
+			const int* baseState = baseline->states.ptr() + baseEnt->stateOfs;
+
+			// unchanged entities are not sent at all
+			if (!memcmp(baseState, state, schema->GetStateWords() * sizeof(int)))
+				continue;
+
+			writeEntityOp(ent.entityId, NETSNAP_ENT_DELTA);
+			schema->WriteDelta(writer, baseState, state);
+		}
+		else
+		{
+			writeEntityOp(ent.entityId, NETSNAP_ENT_CREATE);
+			writer.WriteUIntBits(ent.schemaIdx);
+			schema->WriteDelta(writer, nullptr, state);
+		}
+
+		++numEntityUpdates;
+	}
+
+	while (baseIdx < numBaseEntities)
+		writeEntityOp(baseline->entities[baseIdx++].entityId, NETSNAP_ENT_REMOVE);
+
+	writer.WriteBool(false);
+
+	if (writer.IsOverflowed())
+	{
+		MsgError("CNetSnapshotServer: snapshot of frame %d exceeds %d bytes\n", frame.frame, NETSNAPSHOT_MAX_SIZE);
+		client.snapshotSize = 0;
+		client.numEntityUpdates = 0;
+		return;
+	}
+
+	client.snapshotSize = writer.GetNumBytesWritten();
+	client.numEntityUpdates = numEntityUpdates;
+}
+
+ArrayCRef<ubyte> CNetSnapshotServer::GetClientSnapshot(int clientIdx) const
+{
+	const Client& client = *m_clients[clientIdx];
+	return ArrayCRef<ubyte>(client.buffer.ptr(), client.snapshotSize);
+}
+
+//-----------------------------------------------------------------------
+
+int CNetSnapshotClient::AddSchema(const CNetSnapshotSchema* schema)
+{
+	return m_schemas.append(schema);
+}
+
+const NetSnapshotFrame* CNetSnapshotClient::GetFrame(int frame) const
+{
+	if (frame < 0)
+		return nullptr;
+
+	const NetSnapshotFrame& snapshotFrame = m_frames[frame % NETSNAPSHOT_HISTORY];
+	return snapshotFrame.frame == frame ? &snapshotFrame : nullptr;
+}
+
+int CNetSnapshotClient::ReadSnapshot(const ubyte* data, int size)
+{
+	CBitReader reader(data, size);
+
+	const int frameNum = (int)reader.ReadBits(32);
+	const bool hasBaseline = reader.ReadBool();
+	const int baselineFrameNum = hasBaseline ? frameNum - (int)reader.ReadUIntBits() : -1;
+
+	if (frameNum < 0 || frameNum <= m_lastFrame)
+		return -1;
+
+	const NetSnapshotFrame* baseline = nullptr;
+	if (hasBaseline)
+	{
+		baseline = GetFrame(baselineFrameNum);
+		if (!baseline || frameNum - baselineFrameNum >= NETSNAPSHOT_HISTORY)
+		{
+			MsgWarning("CNetSnapshotClient: baseline frame %d of snapshot %d is not available\n", baselineFrameNum, frameNum);
+			return -1;
+		}
+	}
+
+	NetSnapshotFrame& frame = m_frames[frameNum % NETSNAPSHOT_HISTORY];
+	frame.Clear();
+
+	const int numBaseEntities = baseline ? baseline->entities.numElem() : 0;
+	int baseIdx = 0;
+
+	auto copyBaseEntity = [&](const NetSnapshotEntity& baseEnt) {
+		const int numWords = m_schemas[baseEnt.schemaIdx]->GetStateWords();
+		frame.AddEntity(baseEnt.entityId, baseEnt.schemaIdx, baseline->states.ptr() + baseEnt.stateOfs, numWords);
+	};
+
+	int prevEntityId = -1;
+	while (reader.ReadBool())
+	{
+		const int entityId = prevEntityId + 1 + (int)reader.ReadUIntBits();
+		const ENetSnapshotEntityOp op = (ENetSnapshotEntityOp)reader.ReadBits(NETSNAP_ENT_OP_BITS);
+		prevEntityId = entityId;
+
+		if (reader.IsOverflowed())
+			break;
+
+		// unchanged entities
+		while (baseIdx < numBaseEntities && baseline->entities[baseIdx].entityId < entityId)
+			copyBaseEntity(baseline->entities[baseIdx++]);
+
+		const NetSnapshotEntity* baseEnt = nullptr;
+		if (baseIdx < numBaseEntities && baseline->entities[baseIdx].entityId == entityId)
+			baseEnt = &baseline->entities[baseIdx++];
+
+		if (op == NETSNAP_ENT_REMOVE)
+			continue;
+
+		int schemaIdx;
+		const int* baseState = nullptr;
+		if (op == NETSNAP_ENT_DELTA)
+		{
+			if (!baseEnt)
+			{
+				MsgWarning("CNetSnapshotClient: snapshot %d updates unknown entity %d\n", frameNum, entityId);
+				frame.Clear();
+				return -1;
+			}
+			schemaIdx = baseEnt->schemaIdx;
+			baseState = baseline->states.ptr() + baseEnt->stateOfs;
+		}
+		else
+		{
+			schemaIdx = (int)reader.ReadUIntBits();
+			if (!m_schemas.inRange(schemaIdx))
+			{
+				MsgWarning("CNetSnapshotClient: snapshot %d has unknown schema %d\n", frameNum, schemaIdx);
+				frame.Clear();
+				return -1;
+			}
+		}
+
+		const CNetSnapshotSchema* schema = m_schemas[schemaIdx];
+
+		NetSnapshotEntity& ent = frame.entities.append();
+		ent.entityId = entityId;
+		ent.schemaIdx = schemaIdx;
+		ent.stateOfs = frame.states.numElem();
+
+		frame.states.setNum(ent.stateOfs + schema->GetStateWords());
+		schema->ReadDelta(reader, baseState, frame.states.ptr() + ent.stateOfs);
+	}
+
+	while (baseIdx < numBaseEntities)
+		copyBaseEntity(baseline->entities[baseIdx++]);
+
+	if (reader.IsOverflowed())
+	{
+		MsgWarning("CNetSnapshotClient: snapshot %d is truncated\n", frameNum);
+		frame.Clear();
+		return -1;
+	}
+
+	frame.frame = frameNum;
+	m_lastFrame = frameNum;
+
+	return frameNum;
+}
+
+int CNetSnapshotClient::GetEntityCount() const
+{
+	const NetSnapshotFrame* frame = GetFrame(m_lastFrame);
+	return frame ? frame->entities.numElem() : 0;
+}
+
+bool CNetSnapshotClient::ApplyEntityState(int entityId, void* object) const
+{
+	const NetSnapshotFrame* frame = GetFrame(m_lastFrame);
+	if (!frame)
+		return false;
+
+	const NetSnapshotEntity* ent = FindSnapshotEntity(*frame, entityId);
+	if (!ent)
+		return false;
+
+	m_schemas[ent->schemaIdx]->Dequantize(frame->states.ptr() + ent->stateOfs, object);
+	return true;
+}
+
+}; // namespace Networking
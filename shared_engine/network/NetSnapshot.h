@@ -0,0 +1,208 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2024
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Datamap driven delta snapshot replication
+//////////////////////////////////////////////////////////////////////////////////
+
+/*
+Example of use:
+
+	// networked fields are described by datamap
+	BEGIN_SIMPLE_DATAMAP(CCarState)
+		DEFINE_NETFIELD(m_position, Vector3D, 0.01f),
+		DEFINE_NETFIELD(m_angles, Angles, 0.1f),
+	END_DATAMAP()
+
+	// server
+	CNetSnapshotSchema carSchema(&CCarState::m_DataMap);
+	const int carSchemaIdx = snapshotServer.AddSchema(&carSchema);
+	snapshotServer.AddEntity(carId, carSchemaIdx, &car);
+	...
+	snapshotServer.TakeSnapshot();
+	snapshotServer.BuildClientSnapshots(jobMng);
+	send(snapshotServer.GetClientSnapshot(clientIdx));
+	...
+	snapshotServer.AckSnapshot(clientIdx, ackedFrame);
+
+	// client, schemas must be added in the same order
+	const int frame = snapshotClient.ReadSnapshot(data, size);
+	snapshotClient.ApplyEntityState(carId, &car);
+	send ack of frame
+*/
+
+#pragma once
+#include "entity/DataTable.h"
+#include "net_defs.h"
+
+class CEqJobManager;
+
+namespace Networking
+{
+class CBitWriter;
+class CBitReader;
+
+static constexpr const int NETSNAPSHOT_HISTORY = 32;					// frames kept to be used as baseline
+static constexpr const int NETSNAPSHOT_MAX_SIZE = MAX_MESSAGE_LENGTH;	// size of single client snapshot
+
+enum ENetFieldEncoding : int
+{
+	NETFIELD_ENC_FLOAT = 0,		// raw 32 bits
+	NETFIELD_ENC_QUANTIZED,		// value / precision, delta against baseline
+	NETFIELD_ENC_INTEGER,		// delta against baseline
+	NETFIELD_ENC_BOOLEAN,		// single bit
+	NETFIELD_ENC_ANGLE,			// fixed number of bits over 360 degrees
+};
+
+struct NetSnapshotField
+{
+	const char*			name{ nullptr };
+	int					offset{ 0 };
+	DataVarType_e		type{ DTVAR_TYPE_VOID };
+	ENetFieldEncoding	encoding{ NETFIELD_ENC_FLOAT };
+	float				precision{ 0.0f };
+	int					firstWord{ 0 };		// in quantized state
+	int					numWords{ 0 };
+	int					angleBits{ 0 };
+};
+
+// networked fields of datamap flattened into quantized state words
+class CNetSnapshotSchema
+{
+public:
+	CNetSnapshotSchema(const dataDescMap_t* dataMap);
+
+	const char*			GetName() const			{ return m_name; }
+	int					GetStateWords() const	{ return m_numWords; }
+	ArrayCRef<NetSnapshotField>	GetFields() const { return m_fields; }
+
+	void				Quantize(const void* object, int* state) const;
+	void				Dequantize(const int* state, void* object) const;
+
+	// writes changed field mask and values. Baseline can be null which means all zeroes
+	void				WriteDelta(CBitWriter& writer, const int* baseline, const int* state) const;
+	void				ReadDelta(CBitReader& reader, const int* baseline, int* state) const;
+
+protected:
+	void				AddFields(const dataDescMap_t* dataMap, int baseOffset, bool networked);
+
+	Array<NetSnapshotField>	m_fields{ PP_SL };
+	const char*			m_name{ nullptr };
+	int					m_numWords{ 0 };
+};
+
+struct NetSnapshotEntity
+{
+	int		entityId;
+	int		schemaIdx;
+	int		stateOfs;		// in NetSnapshotFrame::states
+};
+
+// quantized states of all entities, sorted by entity id
+struct NetSnapshotFrame
+{
+	int							frame{ -1 };
+	Array<NetSnapshotEntity>	entities{ PP_SL };
+	Array<int>					states{ PP_SL };
+
+	void						Clear();
+	void						AddEntity(int entityId, int schemaIdx, const int* state, int numWords);
+};
+
+struct NetSnapshotStats
+{
+	int64	numSnapshots{ 0 };		// client snapshots built
+	int64	numBytes{ 0 };			// total bytes of client snapshots
+	int64	numEntityUpdates{ 0 };	// entities written as delta or created
+	int64	numFullUpdates{ 0 };	// snapshots built without baseline
+	float	buildTimeMs{ 0.0f };	// last BuildClientSnapshots time
+};
+
+//-----------------------------------------------------------------------
+// collects entity states and builds delta snapshots against last acknowledged frame of each client
+class CNetSnapshotServer
+{
+public:
+	CNetSnapshotServer();
+	~CNetSnapshotServer();
+
+	int							AddSchema(const CNetSnapshotSchema* schema);
+
+	void						AddEntity(int entityId, int schemaIdx, const void* object);
+	void						RemoveEntity(int entityId);
+
+	int							AddClient();
+	void						RemoveClient(int clientIdx);
+
+	// client has received snapshot frame, it becomes the baseline
+	void						AckSnapshot(int clientIdx, int frame);
+
+	// quantizes all entities into next frame
+	int							TakeSnapshot();
+
+	// builds delta snapshot of latest frame for each client.
+	// Clients are split between job threads if job manager is specified
+	void						BuildClientSnapshots(CEqJobManager* jobMng = nullptr);
+
+	ArrayCRef<ubyte>			GetClientSnapshot(int clientIdx) const;
+
+	const NetSnapshotStats&		GetStats() const { return m_stats; }
+	void						ResetStats() { m_stats = NetSnapshotStats{}; }
+
+protected:
+	class CBuildSnapshotsJob;
+
+	struct Client
+	{
+		Array<ubyte>	buffer{ PP_SL };
+		int				snapshotSize{ 0 };
+		int				ackFrame{ -1 };
+		int				numEntityUpdates{ 0 };
+		bool			active{ false };
+	};
+
+	struct ServerEntity
+	{
+		int			schemaIdx;
+		const void*	object;
+	};
+
+	void						BuildClientSnapshot(Client& client) const;
+	const NetSnapshotFrame*		GetFrame(int frame) const;
+
+	Array<const CNetSnapshotSchema*>	m_schemas{ PP_SL };
+	Map<int, ServerEntity>		m_entities{ PP_SL };
+	Array<Client*>				m_clients{ PP_SL };
+	Array<CBuildSnapshotsJob*>	m_buildJobs{ PP_SL };
+
+	NetSnapshotFrame			m_frames[NETSNAPSHOT_HISTORY];
+	int							m_curFrame{ -1 };
+
+	NetSnapshotStats			m_stats;
+};
+
+//-----------------------------------------------------------------------
+// decodes snapshots received from CNetSnapshotServer
+class CNetSnapshotClient
+{
+public:
+	int							AddSchema(const CNetSnapshotSchema* schema);
+
+	// decodes snapshot and returns it's frame number which must be acknowledged, -1 on error
+	int							ReadSnapshot(const ubyte* data, int size);
+
+	int							GetLastFrame() const { return m_lastFrame; }
+	const NetSnapshotFrame*		GetFrame(int frame) const;
+
+	int							GetEntityCount() const;
+
+	// writes latest entity state to object, returns false if entity is not present
+	bool						ApplyEntityState(int entityId, void* object) const;
+
+protected:
+	Array<const CNetSnapshotSchema*>	m_schemas{ PP_SL };
+	NetSnapshotFrame			m_frames[NETSNAPSHOT_HISTORY];
+	int							m_lastFrame{ -1 };
+};
+
+}; // namespace Networking
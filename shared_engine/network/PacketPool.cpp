@@ -0,0 +1,204 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2024
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Fixed-size network packet buffer pool with refcounted slices
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "core/core_common.h"
+#include "PacketPool.h"
+
+using namespace Threading;
+
+namespace Networking
+{
+
+struct PacketBuffer
+{
+	union {
+		PacketBuffer*	nextFree;
+		CPacketPool*	owner;
+	};
+	int		refCount;
+	ubyte	data[PACKETPOOL_BUFFER_SIZE];
+};
+
+CPacketPool g_packetPool;
+
+//------------------------------------------------------------------------------
+
+PacketSlice::PacketSlice(const PacketSlice& other)
+	: m_buffer(other.m_buffer), m_offset(other.m_offset), m_size(other.m_size)
+{
+	if (m_buffer)
+		Atomic::Increment(m_buffer->refCount);
+}
+
+PacketSlice::PacketSlice(PacketSlice&& other) noexcept
+	: m_buffer(other.m_buffer), m_offset(other.m_offset), m_size(other.m_size)
+{
+	other.m_buffer = nullptr;
+	other.m_offset = 0;
+	other.m_size = 0;
+}
+
+PacketSlice::~PacketSlice()
+{
+	Release();
+}
+
+PacketSlice& PacketSlice::operator=(const PacketSlice& other)
+{
+	if (this == &other)
+		return *this;
+
+	if (other.m_buffer)
+		Atomic::Increment(other.m_buffer->refCount);
+
+	Release();
+	m_buffer = other.m_buffer;
+	m_offset = other.m_offset;
+	m_size = other.m_size;
+	return *this;
+}
+
+PacketSlice& PacketSlice::operator=(PacketSlice&& other) noexcept
+{
+	if (this == &other)
+		return *this;
+
+	Release();
+	m_buffer = other.m_buffer;
+	m_offset = other.m_offset;
+	m_size = other.m_size;
+
+	other.m_buffer = nullptr;
+	other.m_offset = 0;
+	other.m_size = 0;
+	return *this;
+}
+
+void PacketSlice::Release()
+{
+	if (!m_buffer)
+		return;
+
+	if (Atomic::Decrement(m_buffer->refCount) == 0)
+		m_buffer->owner->FreeBuffer(m_buffer);
+
+	m_buffer = nullptr;
+	m_offset = 0;
+	m_size = 0;
+}
+
+PacketSlice PacketSlice::Slice(int offset, int size) const
+{
+	ASSERT(m_buffer);
+	ASSERT(offset >= 0 && offset + size <= m_size);
+
+	PacketSlice slice(*this);
+	slice.m_offset = m_offset + offset;
+	slice.m_size = size;
+	return slice;
+}
+
+ubyte* PacketSlice::GetData() const
+{
+	return m_buffer ? m_buffer->data + m_offset : nullptr;
+}
+
+void PacketSlice::SetSize(int size)
+{
+	ASSERT(size >= 0 && size <= GetCapacity());
+	m_size = size;
+}
+
+bool PacketSlice::Write(const void* data, int size)
+{
+	ASSERT_MSG(m_size + size <= GetCapacity(), "PacketSlice::Write - buffer overflow (%d + %d)", m_size, size);
+	if (m_size + size > GetCapacity())
+		return false;
+
+	memcpy(GetData() + m_size, data, size);
+	m_size += size;
+	return true;
+}
+
+int PacketSlice::GetRefCount() const
+{
+	return m_buffer ? m_buffer->refCount : 0;
+}
+
+//------------------------------------------------------------------------------
+
+CPacketPool::~CPacketPool()
+{
+	Shutdown();
+}
+
+PacketSlice CPacketPool::Alloc()
+{
+	PacketBuffer* buffer = nullptr;
+	{
+		CScopedMutex m(m_mutex);
+
+		if (!m_firstFree)
+		{
+			ubyte* chunk = (ubyte*)PPAlloc(sizeof(PacketBuffer) * PACKETPOOL_CHUNK_BUFFERS);
+			m_chunks.append(chunk);
+
+			PacketBuffer* chunkBuffers = reinterpret_cast<PacketBuffer*>(chunk);
+			for (int i = PACKETPOOL_CHUNK_BUFFERS - 1; i >= 0; --i)
+			{
+				chunkBuffers[i].nextFree = m_firstFree;
+				m_firstFree = &chunkBuffers[i];
+			}
+
+			m_stats.numBuffers += PACKETPOOL_CHUNK_BUFFERS;
+			++m_stats.heapAllocs;
+		}
+
+		buffer = m_firstFree;
+		m_firstFree = buffer->nextFree;
+
+		++m_stats.poolAllocs;
+		m_stats.peakUsed = max(m_stats.peakUsed, ++m_stats.numUsed);
+	}
+
+	buffer->owner = this;
+	buffer->refCount = 1;
+
+	PacketSlice slice;
+	slice.m_buffer = buffer;
+	return slice;
+}
+
+void CPacketPool::FreeBuffer(PacketBuffer* buffer)
+{
+	CScopedMutex m(m_mutex);
+	buffer->nextFree = m_firstFree;
+	m_firstFree = buffer;
+	--m_stats.numUsed;
+}
+
+void CPacketPool::Shutdown()
+{
+	CScopedMutex m(m_mutex);
+
+	ASSERT_MSG(m_stats.numUsed == 0, "CPacketPool::Shutdown - %d packet buffers are still referenced", m_stats.numUsed);
+
+	for (ubyte* chunk : m_chunks)
+		PPFree(chunk);
+	m_chunks.clear(true);
+
+	m_firstFree = nullptr;
+	m_stats.numBuffers = 0;
+}
+
+PacketPoolStats CPacketPool::GetStats() const
+{
+	CScopedMutex m(m_mutex);
+	return m_stats;
+}
+
+}; // namespace Networking
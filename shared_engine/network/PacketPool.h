@@ -0,0 +1,90 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2024
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Fixed-size network packet buffer pool with refcounted slices
+//////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "net_defs.h"
+
+namespace Networking
+{
+
+static constexpr const int PACKETPOOL_BUFFER_SIZE = MAX_MESSAGE_LENGTH;
+static constexpr const int PACKETPOOL_CHUNK_BUFFERS = 16;
+
+struct PacketBuffer;
+
+struct PacketPoolStats
+{
+	int64	heapAllocs{ 0 };		// number of chunks allocated from heap
+	int64	poolAllocs{ 0 };		// number of buffers taken from pool
+	int		numBuffers{ 0 };		// total buffers owned by pool
+	int		numUsed{ 0 };			// buffers currently referenced
+	int		peakUsed{ 0 };
+};
+
+// refcounted view into pooled packet buffer.
+// Copies share the storage, so retransmits and fragments don't copy the data.
+class PacketSlice
+{
+public:
+	PacketSlice() = default;
+	PacketSlice(const PacketSlice& other);
+	PacketSlice(PacketSlice&& other) noexcept;
+	~PacketSlice();
+
+	PacketSlice&	operator=(const PacketSlice& other);
+	PacketSlice&	operator=(PacketSlice&& other) noexcept;
+
+	bool			IsValid() const { return m_buffer != nullptr; }
+	void			Release();
+
+	// returns sub-slice sharing the same buffer
+	PacketSlice		Slice(int offset, int size) const;
+
+	ubyte*			GetData() const;
+	int				GetSize() const { return m_size; }
+	int				GetCapacity() const { return PACKETPOOL_BUFFER_SIZE - m_offset; }
+
+	void			SetSize(int size);
+	bool			Write(const void* data, int size);
+
+	int				GetRefCount() const;
+
+private:
+	friend class CPacketPool;
+
+	PacketBuffer*	m_buffer{ nullptr };
+	int				m_offset{ 0 };
+	int				m_size{ 0 };
+};
+
+// thread-safe pool of PACKETPOOL_BUFFER_SIZE buffers.
+// Buffers are never returned to the heap until Shutdown
+class CPacketPool
+{
+public:
+	CPacketPool() = default;
+	~CPacketPool();
+
+	PacketSlice				Alloc();
+	void					Shutdown();
+
+	PacketPoolStats			GetStats() const;
+
+protected:
+	friend class PacketSlice;
+
+	void					FreeBuffer(PacketBuffer* buffer);
+
+	mutable Threading::CEqMutex	m_mutex;
+	Array<ubyte*>			m_chunks{ PP_SL };
+	PacketBuffer*			m_firstFree{ nullptr };
+	PacketPoolStats			m_stats;
+};
+
+extern CPacketPool g_packetPool;
+
+}; // namespace Networking
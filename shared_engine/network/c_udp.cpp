@@ -14,6 +14,14 @@
 #include "math/Random.h"
 
 #include "c_udp.h"
+#include "LinkSimulator.h"
+
+#if defined(PLAT_LINUX) || defined(PLAT_ANDROID)
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#define CDP_USE_EPOLL
+#endif
 
 using namespace Threading;
 
@@ -29,12 +37,16 @@ namespace Networking
 #define UDP_CDP_IDENT						MAKECHAR4('E','Q','D','P')		// signature: EqDatagramPacket
 
 #define UDP_CDP_PROTOCOL_VERSION			9			// protocol version
+#define UDP_CDP_PROTOCOL_VERSION_SACK		10			// datagrams of selective acknowledge mode, with udp_cdp_ackhdr_t
 
 #define UDP_CDP_MIN_SEND_BUFFER				2048		// minimal send buffer; tweak this if you have bandwith issues
 #define UDP_CDP_MIN_MESSAGESIZE				512
 
 #define UDP_CDP_MAX_QUEUE_BUFFERS			16			// maximum amount of queue buffers
 
+#define UDP_CDP_RECV_BATCH					16			// datagrams received with single recvmmsg
+#define UDP_CDP_SEND_BATCH					16			// datagrams sent with single sendmmsg
+
 #define UDP_CDP_FORCESEND_FILLPERCENTAGE	(0.7)
 
 #define CDP_MAX_MESSAGE_ID					32760
@@ -51,32 +63,112 @@ namespace Networking
 //ConVar net_cudp_removetime("net_cudp_removetime", "500", 1.0, 80.0, "Delay to send message buffer", CV_CHEAT);
 //ConVar net_cudp_recvtimeout("net_cudp_recvtimeout", "1500", 1.0, 80.0, "Delay to send message buffer", CV_CHEAT);
 
+#define CDP_RECV_WINDOW						4096		// received message ids kept per peer, power of two
+
+// selective acknowledge mode
+#define CDP_SACK_SEQ_WINDOW					256			// sent sequences tracked per peer, power of two
+#define CDP_SACK_ACK_BITS					64			// sequences preceding latest acknowledged one
+#define CDP_SACK_SEQ_RESET_DISTANCE			4096		// received sequence that far behind means peer has restarted
+#define CDP_SACK_ACK_DELAY_MS				5			// ack-only datagram is sent if there was nothing to piggyback on
+#define CDP_SACK_FAST_RESEND_THRESHOLD		3			// datagram is lost when this many later ones are acknowledged
+#define CDP_SACK_MIN_REORDER_MS				2			// or when later one is acknowledged and it's overdue by SRTT + reorder window
+#define CDP_SACK_INITIAL_RTO_MS				200
+#define CDP_SACK_MIN_RTO_MS					20
+#define CDP_SACK_MAX_RTO_MS					2000
+#define CDP_SACK_MAX_SENDS					16			// guaranteed datagram fails after that many sends
+#define CDP_SACK_INITIAL_CWND				8.0f		// datagrams in flight, limited by UDP_CDP_MAX_QUEUE_BUFFERS
+#define CDP_SACK_MIN_CWND					4.0f
+#define CDP_SACK_CWND_DECREASE				0.7f		// window multiplier on loss, mild as game traffic has random losses
+
 //------------------------------------------------------------------------------
 // message buffer
 //------------------------------------------------------------------------------
 struct cdp_queued_message_t
 {
-	cdp_queued_message_t()
-	{
-		bytestream = nullptr;
-		flags = 0;
-		sendTime = 0;
-	}
+	sockaddr_in				addr;				// address of sender or receiver
+	PacketSlice				packet;				// pooled datagram storage
+	cdp_peer_t*				peer{ nullptr };
+
+	cdp_queued_message_t*	peerPrev{ nullptr };	// peer queue links
+	cdp_queued_message_t*	peerNext{ nullptr };
+	cdp_queued_message_t*	nextPending{ nullptr };	// ack ring chain or free list link
 
-	sockaddr_in				addr;			// address of sender or receiver
-	CMemoryStream*			bytestream{ nullptr };
 	mutable int				sendTimes{ 0 };		// send times
 	mutable int				sentTimeout{ 0 };	// timeout to send
 	mutable int				removeTimeout{ 0 };	// timeout to remove
 
 	uint32					sendTime{ 0 };
+	int						queueIdx{ -1 };
+	short					messageId{ -1 };
 	short					flags{ 0 };
 
-	bool Write(const void* pData, int nSize );
-	void WriteReset();
-	void ReadReset();
+	ushort					sequence{ 0 };		// of last transmission, selective mode
+	bool					inFlight{ false };
+	bool					fastResend{ false };
+	bool					windowStalled{ false };	// keeps accepting messages while waiting for congestion window
+
+	bool Write(const void* pData, int nSize) { return packet.Write(pData, nSize); }
 };
 
+struct cdp_recv_msgid_t
+{
+	short			msgid{ -1 };
+	uint32			time{ 0 };
+};
+
+// remote address state
+struct cdp_peer_t
+{
+	sockaddr_in				addr;
+	cdp_queued_message_t*	firstQueued{ nullptr };
+	int						numQueued{ 0 };
+	uint32					lastActiveTime{ 0 };
+
+	cdp_recv_msgid_t		receivedIds[CDP_RECV_WINDOW];
+
+	// selective mode, sending side
+	cdp_queued_message_t*	sentSeqs[CDP_SACK_SEQ_WINDOW]{ nullptr };
+	ushort					sendSequence{ 0 };
+	ushort					highestAcked{ 0 };
+	ushort					recoverySequence{ 0 };	// losses of datagrams sent before it are the same congestion event
+	bool					hasAcked{ false };
+	bool					inRecovery{ false };
+	bool					hasRtt{ false };
+	int						srttMs{ 0 };
+	int						rttVarMs{ 0 };
+	int						rtoMs{ CDP_SACK_INITIAL_RTO_MS };
+	float					cwnd{ CDP_SACK_INITIAL_CWND };
+	float					ssthresh{ float(UDP_CDP_MAX_QUEUE_BUFFERS) };
+	int						inFlight{ 0 };
+
+	// selective mode, receiving side
+	uint64					recvAckBits{ 0 };
+	ushort					recvAck{ 0 };
+	bool					recvAckValid{ false };
+	bool					ackPending{ false };
+	bool					inAckList{ false };
+	uint32					recvAckTime{ 0 };
+	uint32					ackPendingTime{ 0 };
+
+	CDPPeerStats			stats;
+};
+
+// sequence comparison with wrap around
+static inline short CDPSeqDiff(ushort a, ushort b)
+{
+	return short(ushort(a - b));
+}
+
+static uint64 CDPPeerKey(const sockaddr_in& addr)
+{
+#ifdef _WIN32
+	const uint32 ip = addr.sin_addr.S_un.S_addr;
+#else
+	const uint32 ip = addr.sin_addr.s_addr;
+#endif
+	return (uint64(ip) << 16) | addr.sin_port;
+}
+
 // big message header
 struct udp_cdp_hdr_s
 {
@@ -108,46 +200,22 @@ struct udp_cdp_packetstate_s
 
 ALIGNED_TYPE(udp_cdp_packetstate_s,2) udp_cdp_packetstate_t;
 
-bool cdp_queued_message_t::Write(const void* pData, int nSize )
-{
-	ASSERT( bytestream->Tell() + nSize < UDP_CDP_MAX_MESSAGEPAYLOAD );
-
-	return bytestream->Write( pData, 1, nSize ) > 0;
-}
-
-void cdp_queued_message_t::WriteReset()
-{
-	delete bytestream;
-	bytestream = nullptr;
-}
-
-void cdp_queued_message_t::ReadReset()
-{
-	bytestream->Seek(0, VS_SEEK_SET);
-}
-
-void FreeMessage(cdp_queued_message_t* pMessage)
-{
-	delete pMessage->bytestream;
-	delete pMessage;
-}
-
-// allocates message
-cdp_queued_message_t* AllocMessage()
+// selective acknowledge, follows udp_cdp_hdr_t in UDP_CDP_PROTOCOL_VERSION_SACK datagrams.
+// Carried by every datagram so lost acknowledges are repaired by next ones
+struct udp_cdp_ackhdr_s
 {
-	cdp_queued_message_t* pMessage = PPNew cdp_queued_message_t;
-
-	memset(pMessage, 0, sizeof(cdp_queued_message_t));
-
-	if(!pMessage->bytestream)
-	{
-		pMessage->bytestream = PPNew CMemoryStream(nullptr, VS_OPEN_WRITE, UDP_CDP_MIN_MESSAGESIZE, PP_SL);
-	}
+	uint64			ack_bits;				// bit N is set if sequence (ack - 1 - N) was received
+	ushort			sequence;				// sequence of this datagram, guaranteed only
+	ushort			ack;					// latest received sequence
+	ushort			ack_delay;				// ms passed since ack sequence was received, excluded from RTT
+	ubyte			ack_valid;				// nothing was received yet if zero
+	ubyte			unused;					// explicit padding, always zero on the wire
+};
 
-	return pMessage;
-}
+typedef udp_cdp_ackhdr_s udp_cdp_ackhdr_t;
+static_assert(sizeof(udp_cdp_ackhdr_t) == 16, "udp_cdp_ackhdr_t must not have implicit padding");
 
-int udp_select_messages( SOCKET sock )
+int udp_select_messages( SOCKET sock, int timeoutMs = 0 )
 {
 	struct timeval stTimeOut;
 
@@ -155,14 +223,9 @@ int udp_select_messages( SOCKET sock )
 
 	FD_ZERO(&stReadFDS);
 
-    // Timeout of one second
-#ifdef _WIN32
-	stTimeOut.tv_sec = 0;
-	stTimeOut.tv_usec = 20 * 1000;
-#else
-	stTimeOut.tv_sec = 0;
-	stTimeOut.tv_usec = 0;
-#endif // _WIN32
+	stTimeOut.tv_sec = timeoutMs / 1000;
+	stTimeOut.tv_usec = (timeoutMs % 1000) * 1000;
+
 	FD_SET(sock, &stReadFDS);
 
 #ifdef _WIN32
@@ -189,6 +252,7 @@ CEqRDPSocket::CEqRDPSocket()
 	m_init = false;
 
 	m_nMessageIDInc = 0;
+	m_time = 0;
 }
 
 CEqRDPSocket::~CEqRDPSocket()
@@ -238,17 +302,14 @@ bool CEqRDPSocket::Init( int port )
 	gethostname(host_name, sizeof(host_name));
 	hostinfo = gethostbyname(host_name);
 
-	if (hostinfo == nullptr)
-	{
-		closesocket( sock );
-
-		Msg("Unable to get hostinfo!\n");
-		return false;
-	}
-
 	in_addr hostaddress;
+	memset(&hostaddress, 0, sizeof(hostaddress));
 
-	hostaddress = *((in_addr *)( hostinfo->h_addr ));
+	// only used for display
+	if (hostinfo != nullptr)
+		hostaddress = *((in_addr *)( hostinfo->h_addr ));
+	else
+		MsgWarning("Unable to get hostinfo!\n");
 
 #ifndef _WIN32
 	addr.sin_addr.s_addr = INADDR_ANY;
@@ -285,6 +346,11 @@ bool CEqRDPSocket::Init( int port )
 
 	m_init = true;
 
+	m_recvBuffer = (ubyte*)PPAlloc(UDP_CDP_RECV_BATCH * UDP_CDP_MAX_MESSAGEPAYLOAD);
+
+	if(!InitEvents())
+		MsgWarning("CEqRDPSocket: event loop is not available, using polling\n");
+
 	// setup defaults
 	m_nSendTimeout					= CDP_SEND_TIMEOUT_MS;
 	m_nUnconfirmedRemoveTimeout		= CDP_SEND_REMOVE_TIMEOUT_MS;
@@ -298,61 +364,230 @@ void CEqRDPSocket::Close()
 	if(!m_init)
 		return;
 
+	ShutdownEvents();
+
 	closesocket( m_sock );
 
 	m_sock = -1;
 	m_init = false;
 
+	PPFree(m_recvBuffer);
+	m_recvBuffer = nullptr;
+
 	memset(&m_addr, 0, sizeof(sockaddr_in));
 
 	// cleanup lists
-	for(int i = 0; i < m_pMessageQueue.numElem(); i++)
-		FreeMessage(m_pMessageQueue[i]);
+	while(m_pMessageQueue.numElem())
+		FreeMessage(m_pMessageQueue.back());
+
+	m_pMessageQueue.clear(true);
+	m_sendBatch.clear(true);
+
+	while(m_freeMessages)
+	{
+		cdp_queued_message_t* msg = m_freeMessages;
+		m_freeMessages = msg->nextPending;
+		delete msg;
+	}
+
+	m_ackPendingPeers.clear(true);
+
+	for(auto it = m_peers.begin(); !it.atEnd(); ++it)
+		delete *it;
+
+	m_peers.clear(true);
+	m_lastPeer = nullptr;
+}
+
+bool CEqRDPSocket::InitEvents()
+{
+#ifdef CDP_USE_EPOLL
+	m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+	m_timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	m_wakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	if(m_epollFd == -1 || m_timerFd == -1 || m_wakeupFd == -1)
+	{
+		ShutdownEvents();
+		return false;
+	}
+
+	const int fds[] = { m_sock, m_timerFd, m_wakeupFd };
+	for(int i = 0; i < elementsOf(fds); i++)
+	{
+		epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.fd = fds[i];
+
+		if(epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fds[i], &ev) == -1)
+		{
+			ShutdownEvents();
+			return false;
+		}
+	}
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+void CEqRDPSocket::ShutdownEvents()
+{
+#ifdef CDP_USE_EPOLL
+	if(m_epollFd != -1)
+		close(m_epollFd);
+	if(m_timerFd != -1)
+		close(m_timerFd);
+	if(m_wakeupFd != -1)
+		close(m_wakeupFd);
+#endif
+	m_epollFd = -1;
+	m_timerFd = -1;
+	m_wakeupFd = -1;
+}
+
+bool CEqRDPSocket::WaitForEvents( int maxWaitMs )
+{
+	if(!m_init)
+		return false;
+
+#ifdef CDP_USE_EPOLL
+	if(m_epollFd != -1)
+	{
+		epoll_event events[3];
+		const int count = epoll_wait(m_epollFd, events, elementsOf(events), maxWaitMs);
+
+		for(int i = 0; i < count; i++)
+		{
+			// socket is level-triggered and drained by UpdateRecieve
+			if(events[i].data.fd == m_sock)
+				continue;
+
+			uint64 value;
+			read(events[i].data.fd, &value, sizeof(value));
+		}
+
+		return count > 0;
+	}
+#endif
+
+	return udp_select_messages(m_sock, maxWaitMs) > 0;
+}
+
+void CEqRDPSocket::Wakeup()
+{
+#ifdef CDP_USE_EPOLL
+	if(m_wakeupFd != -1)
+	{
+		const uint64 value = 1;
+		write(m_wakeupFd, &value, sizeof(value));
+	}
+#endif
+}
+
+// arms resend timer to nearest send or remove timeout of the queue
+void CEqRDPSocket::ArmResendTimer()
+{
+#ifdef CDP_USE_EPOLL
+	if(m_timerFd == -1)
+		return;
+
+	int nextTimeoutMs = INT_MAX;
+	{
+		CScopedMutex m(m_Mutex);
+		for(int i = 0; i < m_pMessageQueue.numElem(); i++)
+		{
+			const cdp_queued_message_t* buffer = m_pMessageQueue[i];
+
+			if(m_ackMode == CDP_ACK_SELECTIVE)
+			{
+				// resend by RTO, first send waits for congestion window which is opened by incoming acks
+				if(buffer->sendTimes > 0)
+					nextTimeoutMs = min(nextTimeoutMs, buffer->fastResend ? 0 : GetResendTimeout(buffer) - int(m_time - buffer->sendTime));
+				else if(buffer->sentTimeout < m_nSendTimeout)
+					nextTimeoutMs = min(nextTimeoutMs, m_nSendTimeout - buffer->sentTimeout);
+				continue;
+			}
+
+			nextTimeoutMs = min(nextTimeoutMs, m_nSendTimeout - buffer->sentTimeout);
+
+			if(buffer->sendTimes >= 5)
+				nextTimeoutMs = min(nextTimeoutMs, m_nUnconfirmedRemoveTimeout - buffer->removeTimeout);
+		}
+
+		if(m_ackPendingPeers.numElem())
+			nextTimeoutMs = min(nextTimeoutMs, CDP_SACK_ACK_DELAY_MS);
+	}
+
+	if(m_linkSim)
+	{
+		const int linkDueMs = m_linkSim->GetNextDueMs(m_time);
+		if(linkDueMs >= 0)
+			nextTimeoutMs = min(nextTimeoutMs, linkDueMs);
+	}
 
-	m_pMessageQueue.clear();
-	m_receivedIds.clear();
+	// zero disarms timer
+	itimerspec timerSpec;
+	memset(&timerSpec, 0, sizeof(timerSpec));
+
+	if(nextTimeoutMs != INT_MAX)
+	{
+		nextTimeoutMs = max(nextTimeoutMs, 1);
+		timerSpec.it_value.tv_sec = nextTimeoutMs / 1000;
+		timerSpec.it_value.tv_nsec = (nextTimeoutMs % 1000) * 1000000;
+	}
+
+	timerfd_settime(m_timerFd, 0, &timerSpec, nullptr);
+#endif
 }
 
 void CEqRDPSocket::SendMessageStatus(  const sockaddr_in* to, short message_id, bool isOk  )
 {
-	// alloc new message
-	cdp_queued_message_t* buffer = AllocMessage();
-	buffer->addr = *to;
+	struct {
+		udp_cdp_hdr_t			hdr;
+		udp_cdp_submsg_t		subhdr;
+		udp_cdp_packetstate_t	statehdr;
+	} statusMsg;
 
-	udp_cdp_hdr_t hdr;
+	udp_cdp_hdr_t& hdr = statusMsg.hdr;
 	hdr.ident = UDP_CDP_IDENT;
 	hdr.protocol_version = UDP_CDP_PROTOCOL_VERSION;
 	hdr.message_id = -1;
 	hdr.flags = 0; // mark it as unguaranteed, but not necessary for sender, may be reciever
 	//hdr.crc32 = 0;
 
-	// write header before return
-	buffer->Write( &hdr, sizeof( udp_cdp_hdr_t ) );
-
 	// generate message subheader
-	udp_cdp_submsg_t subhdr;
+	udp_cdp_submsg_t& subhdr = statusMsg.subhdr;
 	subhdr.data_type = CDP_DATA_PACKETSTATE;
 	subhdr.size = sizeof( udp_cdp_packetstate_t );
 
-	// write header
-	buffer->Write( &subhdr, sizeof( udp_cdp_submsg_t ));
-
-	udp_cdp_packetstate_t statehdr;
+	udp_cdp_packetstate_t& statehdr = statusMsg.statehdr;
 	statehdr.message_id = message_id;
 	statehdr.status = isOk ? 0x1 : 0x0;
 
-	// write message size
-	buffer->Write( &statehdr, sizeof( udp_cdp_packetstate_t ) );
-
-	// status messages also with CRC
-	//udp_cdp_hdr_t* pModHDR = (udp_cdp_hdr_t*)buffer->bytestream->GetBasePointer();
-	//pModHDR->crc32 = buffer->bytestream->GetCRC32();
+	// status message is small enough to be sent from stack
+	static_assert(sizeof(statusMsg) == sizeof(udp_cdp_hdr_t) + sizeof(udp_cdp_submsg_t) + sizeof(udp_cdp_packetstate_t), "status message must be packed");
 
 	// sent packet state now
-	sendto( m_sock, (char*)buffer->bytestream->GetBasePointer(), buffer->bytestream->Tell(), 0, (sockaddr*)&buffer->addr, sizeof(sockaddr_in) );
+	SendDatagram( &statusMsg, sizeof(statusMsg), *to );
+
+	CScopedMutex m(m_Mutex);
+	cdp_peer_t* peer = GetPeer( *to, true );
+	++peer->stats.ackDatagrams;
+	++peer->stats.datagramsSent;
+	peer->stats.bytesSent += sizeof(statusMsg);
+}
+
+void CEqRDPSocket::SendDatagram( const void* data, int size, const sockaddr_in& to )
+{
+	if(m_linkSim)
+	{
+		m_linkSim->SendTo( m_sock, data, size, to, m_time );
+		return;
+	}
 
-	// free buffer since we just allocated it
-	FreeMessage( buffer );
+	sendto( m_sock, (const char*)data, size, 0, (const sockaddr*)&to, sizeof(sockaddr_in) );
 }
 
 // sends message
@@ -365,279 +600,409 @@ int CEqRDPSocket::Send( const char* data, int size, const sockaddr_in* to, short
 		return -1;
 	}
 
-	cdp_queued_message_t* buffer = nullptr;
+	// generate message subheader
+	udp_cdp_submsg_t subhdr;
+	subhdr.data_type = CDP_DATA_PACKETDATA;
+	subhdr.size = size+sizeof(udp_cdp_submsg_t);
 
 	bool continiousMessage = (flags & CDPSEND_GUARANTEED);
 
-	if(continiousMessage)
-	{
-		buffer = GetFreeBuffer( size + sizeof(udp_cdp_submsg_t) + 16, to, flags );
-	}
-	else
+	if( !continiousMessage )
 	{
-		buffer = AllocMessage();
+		// FAKE LAG
+		if(net_fakelag.GetInt() && RandomInt(0, net_fakelag.GetInt()) == 0)
+		{
+			msgId = CUDP_MESSAGE_ID_IMMEDIATE;
+			return size;
+		}
 
-		buffer->addr = *to;
+		// unguaranteed messages are sent right away from pooled buffer
+		PacketSlice packet = g_packetPool.Alloc();
 
 		udp_cdp_hdr_t hdr;
 		hdr.ident = UDP_CDP_IDENT;
-		hdr.protocol_version = UDP_CDP_PROTOCOL_VERSION;
+		hdr.protocol_version = (m_ackMode == CDP_ACK_SELECTIVE) ? UDP_CDP_PROTOCOL_VERSION_SACK : UDP_CDP_PROTOCOL_VERSION;
 		hdr.message_id = GetMessageUniqueID();
 		hdr.flags = 0; // mark it as unguaranteed, but not necessary for sender, may be reciever
 
-		// write header before return
-		buffer->Write( &hdr, sizeof( udp_cdp_hdr_t ) );
-	}
+		packet.Write( &hdr, sizeof( udp_cdp_hdr_t ) );
 
-	if(!buffer)
-	{
-		msgId = CUDP_MESSAGE_ID_ERROR;
-		return -1;
-	}
+		{
+			CScopedMutex m(m_Mutex);
+			cdp_peer_t* peer = GetPeer( *to, true );
 
-	if(continiousMessage)
-		m_Mutex.Lock();
+			// acknowledges are piggybacked on any traffic
+			if( m_ackMode == CDP_ACK_SELECTIVE )
+			{
+				udp_cdp_ackhdr_t ackhdr;
+				FillAckHeader( peer, ackhdr, 0 );
+				packet.Write( &ackhdr, sizeof(udp_cdp_ackhdr_t) );
+			}
 
-	buffer->addr = *to;
+			++peer->stats.datagramsSent;
+			peer->stats.bytesSent += packet.GetSize() + sizeof(udp_cdp_submsg_t) + size;
+		}
 
-	// generate message subheader
-	udp_cdp_submsg_t subhdr;
-	subhdr.data_type = CDP_DATA_PACKETDATA;
-	subhdr.size = size+sizeof(udp_cdp_submsg_t);
+		packet.Write( &subhdr, sizeof(udp_cdp_submsg_t) );
+		packet.Write( data, size );
+
+		// sent packet state now
+		SendDatagram( packet.GetData(), packet.GetSize(), *to );
 
-	// write subheader
-	buffer->Write( &subhdr, sizeof(udp_cdp_submsg_t));
+		msgId = CUDP_MESSAGE_ID_IMMEDIATE;
+		return size;
+	}
 
-	// write message bytes
-	buffer->Write( data, size );
+	cdp_queued_message_t* buffer = GetFreeBuffer( size + sizeof(udp_cdp_submsg_t) + 16, to, flags );
 
-	// if buffer now have filled for over 80 percent, we force to send message fast
-	if( float(buffer->bytestream->Tell()) / float(UDP_CDP_MAX_MESSAGEPAYLOAD) >= UDP_CDP_FORCESEND_FILLPERCENTAGE || (flags & CDPSEND_IMMEDIATE))
+	if(!buffer)
 	{
-		buffer->sentTimeout = m_nSendTimeout;
+		msgId = CUDP_MESSAGE_ID_ERROR;
+		return -1;
 	}
 
-	if( continiousMessage )
 	{
-		udp_cdp_hdr_t* pHdr = (udp_cdp_hdr_t*)buffer->bytestream->GetBasePointer();
+		CScopedMutex m(m_Mutex);
 
-		// set message id to return
-		msgId = pHdr->message_id;
+		// write subheader
+		buffer->Write( &subhdr, sizeof(udp_cdp_submsg_t));
 
-		m_Mutex.Unlock();
-	}
-	else
-	{
-		// FAKE LAG
-		if(net_fakelag.GetInt() && RandomInt(0, net_fakelag.GetInt()) == 0)
+		// write message bytes
+		buffer->Write( data, size );
+
+		// if buffer now have filled for over 80 percent, we force to send message fast
+		if( float(buffer->packet.GetSize()) / float(UDP_CDP_MAX_MESSAGEPAYLOAD) >= UDP_CDP_FORCESEND_FILLPERCENTAGE || (flags & CDPSEND_IMMEDIATE))
 		{
-			FreeMessage( buffer );
-			msgId = CUDP_MESSAGE_ID_IMMEDIATE;
-			return size;
+			buffer->sentTimeout = m_nSendTimeout;
 		}
 
-		// sent packet state now
-		sendto( m_sock, (char*)buffer->bytestream->GetBasePointer(), buffer->bytestream->Tell(), 0, (sockaddr*)&buffer->addr, sizeof(sockaddr_in) );
-
-		// free buffer since we just allocated it
-		FreeMessage( buffer );
-
-		msgId = CUDP_MESSAGE_ID_IMMEDIATE;
+		// set message id to return
+		msgId = buffer->messageId;
 	}
 
-	/*
-	// DEBUG
-	char filename[256];
-
-	udp_cdp_hdr_t* hdr = (udp_cdp_hdr_t*)buffer->bytestream->GetBasePointer();
-
-	strcpy( filename, varargs("msg_debug/cdpprepsendmsg_%d", hdr->message_id) );
-
-	FILE* pFile = fopen(filename, "wb");
-	if(pFile)
-	{
-		fwrite(buffer->bytestream->GetBasePointer(), buffer->bytestream->Tell(), 1, pFile);
-		fclose(pFile);
-	}
-	*/
+	// let network thread schedule the send
+	Wakeup();
 
 	return size;
 }
 
-// this really updates socket
-void CEqRDPSocket::UpdateRecieve( int dtMs, CDPRecvPipe_fn recvFunc, void* recvObj )
+void CEqRDPSocket::ProcessDatagram( ubyte* message_buffer, int r_size, const sockaddr_in& fromaddr, CDPRecvPipe_fn recvFunc, void* recvObj )
 {
-	if(!m_init)
+	// FAKE LAG - do not accept recieved message
+	if(net_fakelag.GetInt() && RandomInt(0, net_fakelag.GetInt()) == 0)
 		return;
 
-	ASSERT(recvFunc);
+	// don't receive zero packets
+	if(r_size <= 0)
+		return;
 
-	// get incomming messages from socket
-	int count = udp_select_messages( m_sock );
+	// don't receive from itself !!!
+	if( NETCompareAdr( fromaddr, m_addr ) )
+		return;
 
-	for( int i = 0; i < count; i++ )
-	{
-		sockaddr_in fromaddr;
-		socklen_t	fromlen = sizeof(sockaddr_in);
+	// get message header
+	udp_cdp_hdr_t* hdr = (udp_cdp_hdr_t*)message_buffer;
 
-		// zero it
-		static char message_buffer[UDP_CDP_MAX_MESSAGEPAYLOAD] = {0};
+	if( hdr->ident != UDP_CDP_IDENT)
+		return; // unk kind of message
 
-		// receive messages
-		int r_size = recvfrom( m_sock, message_buffer, UDP_CDP_MAX_MESSAGEPAYLOAD, 0, (sockaddr*)&fromaddr, &fromlen );
+	const bool selectiveAck = (hdr->protocol_version == UDP_CDP_PROTOCOL_VERSION_SACK);
 
-		if( r_size < 0 )
+	if( hdr->protocol_version != UDP_CDP_PROTOCOL_VERSION && !selectiveAck )
+		return; // wrong version
+
+	int message_offset = sizeof(udp_cdp_hdr_t);
+
+	short ackedIds[CDP_SACK_ACK_BITS + 1];
+	int numAcked = 0;
+	{
+		CScopedMutex m(m_Mutex);
+
+		cdp_peer_t* peer = GetPeer( fromaddr, true );
+		++peer->stats.datagramsReceived;
+		peer->stats.bytesReceived += r_size;
+
+		if( selectiveAck )
 		{
-			int nErrorMsg = sock_errno;
-#ifdef _WIN32
-			// skip WSAEWOULDBLOCK, WSAENOTCONN and WSAECONNRESET to avoid receiving ICMP error
-			if( nErrorMsg != WSAEWOULDBLOCK && nErrorMsg != WSAENOTCONN && nErrorMsg != WSAECONNRESET )
-			{
-				Msg("receive error (%s)\n", NETErrorString(nErrorMsg));
-				continue;
-			}
-#else
-			// skip WSAEWOULDBLOCK, WSAENOTCONN and WSAECONNRESET to avoid receiving ICMP error
-			if( nErrorMsg != EWOULDBLOCK && nErrorMsg != ENOTCONN && nErrorMsg != ECONNRESET && nErrorMsg != EAGAIN )
-			{
-				Msg("receive error (%s)\n", NETErrorString(nErrorMsg));
-				continue;
-			}
-#endif // _WIN32
+			if( r_size < (int)(sizeof(udp_cdp_hdr_t) + sizeof(udp_cdp_ackhdr_t)) )
+				return;
+
+			udp_cdp_ackhdr_t ackhdr;
+			memcpy( &ackhdr, message_buffer + message_offset, sizeof(udp_cdp_ackhdr_t) );
+			message_offset += sizeof(udp_cdp_ackhdr_t);
+
+			// duplicates are acknowledged as well, previous acknowledge could be lost
+			if( hdr->flags & CDPSEND_GUARANTEED )
+				RecordReceivedSequence( peer, ackhdr.sequence );
+
+			numAcked = ProcessAckHeader( peer, ackhdr, ackedIds );
 		}
+	}
 
-		// FAKE LAG - do not accept recieved message
-		if(net_fakelag.GetInt() && RandomInt(0, net_fakelag.GetInt()) == 0)
-			continue;
+	// make sender happy
+	for( int i = 0; i < numAcked; i++ )
+		(recvFunc)(recvObj, nullptr, DELIVERY_SUCCESS, fromaddr, ackedIds[i], RECV_MSG_STATUS );
 
-		// don't receive zero packets
-		if(r_size <= 0)
-			continue;
+	// skip this message if it was already received
+	if( !MarkMessageReceived( hdr->message_id, fromaddr ) )
+	{
+		// send status
+		if((hdr->flags & CDPSEND_GUARANTEED) && !selectiveAck)
+		{
+			SendMessageStatus( &fromaddr, hdr->message_id, true );
+		}
 
-		// don't receive from itself !!!
-		if( NETCompareAdr( fromaddr, m_addr ) )
-			continue;
+		return;
+	}
 
+	int msg_idx = 0;
+	bool statusSent = selectiveAck;		// selective mode acknowledges by sequence
+
+	// cyclic reading
+	while( message_offset < r_size )
+	{
 		// get message header
-		udp_cdp_hdr_t* hdr = (udp_cdp_hdr_t*)message_buffer;
+		udp_cdp_submsg_t* subhdr = (udp_cdp_submsg_t*)(message_buffer + message_offset);
 
-		if( hdr->ident != UDP_CDP_IDENT)
-			continue; // unk kind of message
+		// prevent zero messages
+		if( subhdr->size <= 0 )
+			break;
 
-		if( hdr->protocol_version != UDP_CDP_PROTOCOL_VERSION )
-			continue; // wrong version
+		message_offset += subhdr->size;
 
-		// skip this message if it was already received
-		if( HasAnyMessageWithId( hdr->message_id, fromaddr ) )
+		// then add them to received_messages buffer list
+		// or check for status message
+
+		// is a packet
+		if( subhdr->data_type == CDP_DATA_PACKETDATA )
 		{
-			// send status
-			if(hdr->flags & CDPSEND_GUARANTEED)
+			// if message was guaranteed, acknowledge whole datagram once
+			if((hdr->flags & CDPSEND_GUARANTEED) && !statusSent)
 			{
-                SendMessageStatus( &fromaddr, hdr->message_id, true );
+				SendMessageStatus( &fromaddr, hdr->message_id, true );
+				statusSent = true;
 			}
 
-			continue;
-		}
+			// get message size
+			int msg_size = subhdr->size-sizeof(udp_cdp_submsg_t);
+			ubyte* rbuf = ((ubyte*)subhdr) + sizeof(udp_cdp_submsg_t);
 
-		// add to received IDs
-		if(hdr->message_id != -1)
-		{
-			cdp_receive_msgid_t		mid;
+			ERecvMessageKind recvFlags = (hdr->flags & CDPSEND_IS_RESPONSE) ? RECV_MSG_RESPONSE_DATA : RECV_MSG_DATA;
 
-			mid.addr	= fromaddr;
-			mid.msgid	= hdr->message_id;
-			mid.timeMs	= 0;				// sometime i've forgotten to zero it.
+			// make the reciever happy
+			(recvFunc)(recvObj, rbuf, msg_size, fromaddr, hdr->message_id, recvFlags );
 
-			Threading::CScopedMutex m( m_Mutex );
+			/*
+			// DEBUG
 
-			m_receivedIds.append( mid );
-		}
+			char filename[256];
 
-		int message_offset = sizeof(udp_cdp_hdr_t);
-		int msg_idx = 0;
+			strcpy( filename, varargs("msg_debug/cdpmsg_%d_%d", hdr->message_id, msg_idx) );
 
-		// cyclic reading
-		while( message_offset < r_size )
+			FILE* pFile = fopen(filename, "wb");
+			if(pFile)
+			{
+				fwrite(rbuf, msg_size, 1, pFile);
+				fclose(pFile);
+			}
+			*/
+		}
+		else if( subhdr->data_type == CDP_DATA_PACKETSTATE )
 		{
-			// get message header
-			udp_cdp_submsg_t* subhdr = (udp_cdp_submsg_t*)(message_buffer + message_offset);
+			char* rbuf = ((char*)subhdr) + sizeof(udp_cdp_submsg_t);
 
-			// prevent zero messages
-			if( subhdr->size <= 0 )
-				break;
+			// get a state and message index, then check remove message from send list
+			udp_cdp_packetstate_t* statehdr = (udp_cdp_packetstate_t*)rbuf;
 
-			message_offset += subhdr->size;
+			// got state
+			//if( statehdr->status == 0x1 )
+			{
+				// make sender happy
+				(recvFunc)(recvObj, nullptr, DELIVERY_SUCCESS, fromaddr, statehdr->message_id, RECV_MSG_STATUS );
 
-			// then add them to received_messages buffer list
-			// or check for status message
+				m_Mutex.Lock();
+				RemoveMessageFromSendPool( statehdr->message_id );
+				m_Mutex.Unlock();
+			}
+			//else
+			//	CheckMessageForResend( statehdr->message_id );
+		}
 
-			// is a packet
-			if( subhdr->data_type == CDP_DATA_PACKETDATA )
-			{
-				// if message was guaranteed
-				if(hdr->flags & CDPSEND_GUARANTEED)
-					SendMessageStatus( &fromaddr, hdr->message_id, true );
+		msg_idx++;
+	}
+}
+
+// this really updates socket
+void CEqRDPSocket::UpdateRecieve( int dtMs, CDPRecvPipe_fn recvFunc, void* recvObj )
+{
+	if(!m_init)
+		return;
 
-				// get message size
-				int msg_size = subhdr->size-sizeof(udp_cdp_submsg_t);
-				ubyte* rbuf = ((ubyte*)subhdr) + sizeof(udp_cdp_submsg_t);
+	ASSERT(recvFunc);
 
-				ERecvMessageKind recvFlags = (hdr->flags & CDPSEND_IS_RESPONSE) ? RECV_MSG_RESPONSE_DATA : RECV_MSG_DATA;
+#ifdef CDP_USE_EPOLL
+	// drain socket by batches
+	mmsghdr msgs[UDP_CDP_RECV_BATCH];
+	iovec iovecs[UDP_CDP_RECV_BATCH];
+	sockaddr_in fromAddrs[UDP_CDP_RECV_BATCH];
 
-				// make the reciever happy
-				(recvFunc)(recvObj, rbuf, msg_size, fromaddr, hdr->message_id, recvFlags );
+	for(;;)
+	{
+		memset(msgs, 0, sizeof(msgs));
+		for(int i = 0; i < UDP_CDP_RECV_BATCH; i++)
+		{
+			iovecs[i].iov_base = m_recvBuffer + i * UDP_CDP_MAX_MESSAGEPAYLOAD;
+			iovecs[i].iov_len = UDP_CDP_MAX_MESSAGEPAYLOAD;
 
-				/*
-				// DEBUG
+			msgs[i].msg_hdr.msg_iov = &iovecs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			msgs[i].msg_hdr.msg_name = &fromAddrs[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+		}
 
-				char filename[256];
+		const int count = recvmmsg( m_sock, msgs, UDP_CDP_RECV_BATCH, MSG_DONTWAIT, nullptr );
 
-				strcpy( filename, varargs("msg_debug/cdpmsg_%d_%d", hdr->message_id, msg_idx) );
+		if( count < 0 )
+		{
+			const int nErrorMsg = sock_errno;
 
-				FILE* pFile = fopen(filename, "wb");
-				if(pFile)
-				{
-					fwrite(rbuf, msg_size, 1, pFile);
-					fclose(pFile);
-				}
-				*/
+			// skip EWOULDBLOCK, ENOTCONN and ECONNRESET to avoid receiving ICMP error
+			if( nErrorMsg != EWOULDBLOCK && nErrorMsg != ENOTCONN && nErrorMsg != ECONNRESET && nErrorMsg != EAGAIN )
+				Msg("receive error (%s)\n", NETErrorString(nErrorMsg));
+			break;
+		}
+
+		for( int i = 0; i < count; i++ )
+			ProcessDatagram( (ubyte*)iovecs[i].iov_base, msgs[i].msg_len, fromAddrs[i], recvFunc, recvObj );
+
+		if( count < UDP_CDP_RECV_BATCH )
+			break;
+	}
+#else
+	// get incomming messages from socket
+	int count = udp_select_messages( m_sock );
+
+	for( int i = 0; i < count; i++ )
+	{
+		sockaddr_in fromaddr;
+		socklen_t	fromlen = sizeof(sockaddr_in);
+
+		// receive messages
+		int r_size = recvfrom( m_sock, (char*)m_recvBuffer, UDP_CDP_MAX_MESSAGEPAYLOAD, 0, (sockaddr*)&fromaddr, &fromlen );
+
+		if( r_size < 0 )
+		{
+			int nErrorMsg = sock_errno;
+#ifdef _WIN32
+			// skip WSAEWOULDBLOCK, WSAENOTCONN and WSAECONNRESET to avoid receiving ICMP error
+			if( nErrorMsg != WSAEWOULDBLOCK && nErrorMsg != WSAENOTCONN && nErrorMsg != WSAECONNRESET )
+			{
+				Msg("receive error (%s)\n", NETErrorString(nErrorMsg));
+				continue;
 			}
-			else if( subhdr->data_type == CDP_DATA_PACKETSTATE )
+#else
+			// skip WSAEWOULDBLOCK, WSAENOTCONN and WSAECONNRESET to avoid receiving ICMP error
+			if( nErrorMsg != EWOULDBLOCK && nErrorMsg != ENOTCONN && nErrorMsg != ECONNRESET && nErrorMsg != EAGAIN )
 			{
-				char* rbuf = ((char*)subhdr) + sizeof(udp_cdp_submsg_t);
+				Msg("receive error (%s)\n", NETErrorString(nErrorMsg));
+				continue;
+			}
+#endif // _WIN32
+		}
 
-				// get a state and message index, then check remove message from send list
-				udp_cdp_packetstate_t* statehdr = (udp_cdp_packetstate_t*)rbuf;
+		ProcessDatagram( m_recvBuffer, r_size, fromaddr, recvFunc, recvObj );
+	}
+#endif // CDP_USE_EPOLL
 
-				// got state
-				//if( statehdr->status == 0x1 )
-				{
-					// make sender happy
-					(recvFunc)(recvObj, nullptr, DELIVERY_SUCCESS, fromaddr, hdr->message_id, RECV_MSG_STATUS );
+	// received ids are expired by time stamp, only idle peers are removed
+	if( m_time - m_peerCleanupTime >= (uint32)m_nRecvTimeout )
+	{
+		RemoveIdlePeers();
+		m_peerCleanupTime = m_time;
+	}
+}
 
-					m_Mutex.Lock();
-					RemoveMessageFromSendPool( statehdr->message_id );
-					m_Mutex.Unlock();
-				}
-				//else
-				//	CheckMessageForResend( statehdr->message_id );
-			}
+// sends collected batch, returns number of messages sent
+int CEqRDPSocket::FlushSendBatch()
+{
+	int numSent = 0;
 
-			msg_idx++;
+	// link simulator takes datagrams one by one
+	if( m_linkSim )
+	{
+		for( ; numSent < m_sendBatch.numElem(); ++numSent )
+		{
+			const cdp_send_item_t& item = m_sendBatch[numSent];
+			SendDatagram( item.packet.GetData(), item.packet.GetSize(), item.msg->addr );
 		}
+		return numSent;
 	}
 
-	for(int i = 0; i < m_receivedIds.numElem(); i++)
+#ifdef CDP_USE_EPOLL
+	mmsghdr msgs[UDP_CDP_SEND_BATCH];
+	iovec iovecs[UDP_CDP_SEND_BATCH];
+
+	while( numSent < m_sendBatch.numElem() )
+	{
+		const int batchSize = min(m_sendBatch.numElem() - numSent, UDP_CDP_SEND_BATCH);
+
+		memset(msgs, 0, sizeof(msgs));
+		for(int i = 0; i < batchSize; i++)
+		{
+			cdp_send_item_t& item = m_sendBatch[numSent + i];
+
+			iovecs[i].iov_base = item.packet.GetData();
+			iovecs[i].iov_len = item.packet.GetSize();
+
+			msgs[i].msg_hdr.msg_iov = &iovecs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			msgs[i].msg_hdr.msg_name = &item.msg->addr;
+			msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+		}
+
+		const int count = sendmmsg( m_sock, msgs, batchSize, 0 );
+		if( count < 0 )
+		{
+			const int nErrorMsg = sock_errno;
+
+			// message is dropped on EWOULDBLOCK and ENOTCONN to avoid freeze, it's resent if guaranteed
+			if( nErrorMsg != EWOULDBLOCK && nErrorMsg != ENOTCONN && nErrorMsg != EAGAIN )
+				break;
+
+			++numSent;
+			continue;
+		}
+
+		numSent += count;
+	}
+#else
+	for( ; numSent < m_sendBatch.numElem(); ++numSent )
 	{
-		m_receivedIds[i].timeMs += dtMs;
+		const cdp_send_item_t& item = m_sendBatch[numSent];
+		int s_size = sendto( m_sock, (char*)item.packet.GetData(), item.packet.GetSize(), 0, (sockaddr*)&item.msg->addr, sizeof(sockaddr_in) );
 
-		if( m_receivedIds[i].timeMs > m_nRecvTimeout )
+		if( s_size < 0 )
 		{
-			// remove it
-			m_receivedIds.fastRemoveIndex(i);
-			i--;
+			int nErrorMsg = sock_errno;
+
+			// skip WSAEWOULDBLOCK and WSAENOTCONN to avoid freeze
+#ifdef _WIN32
+			if( nErrorMsg != WSAEWOULDBLOCK && nErrorMsg != WSAENOTCONN )
+#else
+			if( nErrorMsg != EWOULDBLOCK && nErrorMsg != ENOTCONN )
+#endif // _WIN32
+			{
+				break;
+			}
 		}
 	}
+#endif // CDP_USE_EPOLL
+
+	// messages that failed to send are kept in queue
+	for( int i = numSent; i < m_sendBatch.numElem(); i++ )
+		m_sendBatch[i].removeAfterSend = false;
+
+	return numSent;
 }
 
 void CEqRDPSocket::UpdateSendQueue( int timeMs, CDPRecvPipe_fn recvFunc, void* recvObj )
@@ -647,6 +1012,31 @@ void CEqRDPSocket::UpdateSendQueue( int timeMs, CDPRecvPipe_fn recvFunc, void* r
 
 	ASSERT(recvFunc);
 
+	m_sendBatch.clear();
+
+	if( m_ackMode == CDP_ACK_SELECTIVE )
+		UpdateSendQueueSelective( timeMs, recvFunc, recvObj );
+	else
+		UpdateSendQueuePerMessage( timeMs, recvFunc, recvObj );
+
+	m_sendBatch.clear();
+
+	if(m_linkSim)
+		m_linkSim->Update( m_sock, m_time );
+
+	ArmResendTimer();
+
+	// that's all
+	if(m_time > UINT_MAX - timeMs)
+		m_time = 0;
+
+	// increment the time
+	m_time += timeMs;
+}
+
+// resends guaranteed datagrams by fixed timer until status message arrives
+void CEqRDPSocket::UpdateSendQueuePerMessage( int timeMs, CDPRecvPipe_fn recvFunc, void* recvObj )
+{
 	for(int i = 0; i < m_pMessageQueue.numElem(); i++)
 	{
 		cdp_queued_message_t* buffer = m_pMessageQueue[i];
@@ -655,28 +1045,22 @@ void CEqRDPSocket::UpdateSendQueue( int timeMs, CDPRecvPipe_fn recvFunc, void* r
 		// TODO: tweak
 		if( buffer->sendTimes >= 5 )
 		{
-			Atomic::Add(buffer->removeTimeout, i);
+			Atomic::Add(buffer->removeTimeout, timeMs);
 
 			// Expired message
 			if( buffer->removeTimeout >= m_nUnconfirmedRemoveTimeout )
 			{
-				// add pending message ids
-				udp_cdp_hdr_t* pMsgHdr = (udp_cdp_hdr_t*)buffer->bytestream->GetBasePointer();
-
 				// make sender happy
-				(recvFunc)(recvObj, nullptr, DELIVERY_FAILED, buffer->addr, pMsgHdr->message_id, RECV_MSG_STATUS );
+				(recvFunc)(recvObj, nullptr, DELIVERY_FAILED, buffer->addr, buffer->messageId, RECV_MSG_STATUS );
 
 				m_Mutex.Lock();
 
+				++buffer->peer->stats.failed;
+
 				// remove
 				FreeMessage( buffer );
-
-				m_pMessageQueue.fastRemoveIndex( i );
 				i--;
 
-				if(m_pMessageQueue.numElem() < UDP_CDP_MAX_QUEUE_BUFFERS)
-					m_SendSignal.Raise();
-
 				m_Mutex.Unlock();
 
 				continue;
@@ -693,91 +1077,547 @@ void CEqRDPSocket::UpdateSendQueue( int timeMs, CDPRecvPipe_fn recvFunc, void* r
 
 			// set the send time
 			buffer->sendTime = m_time;
+			buffer->sentTimeout = 0;
+
+			cdp_peer_t* peer = buffer->peer;
+			++peer->stats.datagramsSent;
+			peer->stats.bytesSent += buffer->packet.GetSize();
+			if( buffer->sendTimes > 1 )
+				++peer->stats.retransmits;
 
-			bool bSend = true;
+			// if this message is unguaranteed, remove after send
+			cdp_send_item_t& item = m_sendBatch.append();
+			item.msg = buffer;
+			item.packet = buffer->packet;
+			item.removeAfterSend = !(buffer->flags & CDPSEND_GUARANTEED);
 
 			// FAKE LAG
 			if(net_fakelag.GetInt() && RandomInt(0, net_fakelag.GetInt()) == 0)
-				bSend = false;
+			{
+				if(!item.removeAfterSend)
+				{
+					m_sendBatch.removeIndex(m_sendBatch.numElem() - 1);
+					continue;
+				}
+
+				// unguaranteed one is lost
+				CScopedMutex m( m_Mutex );
+				m_sendBatch.removeIndex(m_sendBatch.numElem() - 1);
+
+				FreeMessage( buffer );
+				i--;
+			}
+		}
+	}
+
+	FlushSendBatch();
+
+	// remove unguaranteed messages that were sent
+	{
+		CScopedMutex m( m_Mutex );
+
+		for( int i = 0; i < m_sendBatch.numElem(); i++ )
+		{
+			if( !m_sendBatch[i].removeAfterSend )
+				continue;
+
+			FreeMessage( m_sendBatch[i].msg );
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+// selective acknowledge mode
+//------------------------------------------------------------------------------
+
+// writes receive state of peer to outgoing datagram. m_Mutex must be locked
+void CEqRDPSocket::FillAckHeader( cdp_peer_t* peer, udp_cdp_ackhdr_s& ackhdr, ushort sequence )
+{
+	ackhdr.sequence = sequence;
+	ackhdr.ack = peer->recvAck;
+	ackhdr.ack_bits = peer->recvAckBits;
+	ackhdr.ack_delay = (ushort)min(m_time - peer->recvAckTime, (uint32)USHRT_MAX);
+	ackhdr.ack_valid = peer->recvAckValid ? 1 : 0;
+	ackhdr.unused = 0;
+
+	// piggybacked, peer is removed from pending list by SendPendingAcks
+	peer->ackPending = false;
+}
+
+// updates acknowledge window with received guaranteed datagram. m_Mutex must be locked
+void CEqRDPSocket::RecordReceivedSequence( cdp_peer_t* peer, ushort sequence )
+{
+	const int diff = CDPSeqDiff( sequence, peer->recvAck );
+
+	if( !peer->recvAckValid || diff < -CDP_SACK_SEQ_RESET_DISTANCE )
+	{
+		peer->recvAck = sequence;
+		peer->recvAckBits = 0;
+		peer->recvAckValid = true;
+		peer->recvAckTime = m_time;
+	}
+	else if( diff > 0 )
+	{
+		// previous latest becomes bit (diff - 1)
+		peer->recvAckBits = (diff < CDP_SACK_ACK_BITS) ? (peer->recvAckBits << diff) : 0;
+		if( diff <= CDP_SACK_ACK_BITS )
+			peer->recvAckBits |= uint64(1) << (diff - 1);
+
+		peer->recvAck = sequence;
+		peer->recvAckTime = m_time;
+	}
+	else if( diff < 0 && -diff <= CDP_SACK_ACK_BITS )
+	{
+		peer->recvAckBits |= uint64(1) << (-diff - 1);
+	}
+
+	if( !peer->ackPending )
+	{
+		peer->ackPending = true;
+		peer->ackPendingTime = m_time;
+	}
+
+	if( !peer->inAckList )
+	{
+		peer->inAckList = true;
+		m_ackPendingPeers.append( peer );
+	}
+}
+
+// frees acknowledged datagrams and marks lost ones for resend. m_Mutex must be locked
+int CEqRDPSocket::ProcessAckHeader( cdp_peer_t* peer, const udp_cdp_ackhdr_s& ackhdr, short* ackedIds )
+{
+	if( !ackhdr.ack_valid )
+		return 0;
+
+	int numAcked = 0;
+	for( int i = -1; i < CDP_SACK_ACK_BITS; i++ )
+	{
+		if( i >= 0 && !(ackhdr.ack_bits & (uint64(1) << i)) )
+			continue;
+
+		const ushort sequence = ackhdr.ack - 1 - i;
+
+		cdp_queued_message_t* msg = peer->sentSeqs[sequence & (CDP_SACK_SEQ_WINDOW-1)];
+		if( !msg || msg->sequence != sequence || msg->sendTimes == 0 )
+			continue;
 
-			
-			if(bSend)
+		// RTT is only sampled from datagrams sent once (Karn) and from latest acknowledge which has the delay
+		if( i == -1 && msg->sendTimes == 1 )
+		{
+			const int rttMs = max((int)(m_time - msg->sendTime) - (int)ackhdr.ack_delay, 0);
+			if( !peer->hasRtt )
+			{
+				peer->srttMs = rttMs;
+				peer->rttVarMs = rttMs / 2;
+				peer->hasRtt = true;
+			}
+			else
 			{
-				int s_size = sendto( m_sock, (char*)buffer->bytestream->GetBasePointer(), buffer->bytestream->Tell(), 0, (sockaddr*)&buffer->addr, sizeof(sockaddr_in) );
+				peer->rttVarMs = (peer->rttVarMs * 3 + abs(peer->srttMs - rttMs)) / 4;
+				peer->srttMs = (peer->srttMs * 7 + rttMs) / 8;
+			}
+
+			peer->rtoMs = clamp(peer->srttMs + max(peer->rttVarMs * 4, 1), CDP_SACK_MIN_RTO_MS, CDP_SACK_MAX_RTO_MS);
+		}
+
+		// slow start, then additive increase
+		if( peer->cwnd < peer->ssthresh )
+			peer->cwnd += 1.0f;
+		else
+			peer->cwnd += 1.0f / peer->cwnd;
+
+		peer->cwnd = min(peer->cwnd, float(UDP_CDP_MAX_QUEUE_BUFFERS));
+
+		if( !peer->hasAcked || CDPSeqDiff( sequence, peer->highestAcked ) > 0 )
+		{
+			peer->highestAcked = sequence;
+			peer->hasAcked = true;
+		}
+
+		if( peer->inRecovery && CDPSeqDiff( sequence, peer->recoverySequence ) >= 0 )
+			peer->inRecovery = false;
+
+		++peer->stats.delivered;
+		ackedIds[numAcked++] = msg->messageId;
+
+		FreeMessage( msg );
+	}
+
+	if( !numAcked )
+		return 0;
+
+	// datagrams which were sent before several acknowledged ones are lost
+	for( cdp_queued_message_t* msg = peer->firstQueued; msg; msg = msg->peerNext )
+	{
+		if( msg->sendTimes == 0 || msg->fastResend )
+			continue;
+
+		if( CDPSeqDiff( peer->highestAcked, msg->sequence ) < CDP_SACK_FAST_RESEND_THRESHOLD )
+			continue;
 
-                udp_cdp_hdr_t* hdr = (udp_cdp_hdr_t*)buffer->bytestream->GetBasePointer();
+		msg->fastResend = true;
+	}
+
+	return numAcked;
+}
+
+// multiplicative decrease of congestion window, once per window of datagrams. m_Mutex must be locked
+void CEqRDPSocket::OnPeerPacketLoss( cdp_peer_t* peer, ushort sequence )
+{
+	if( peer->inRecovery && CDPSeqDiff( sequence, peer->recoverySequence ) < 0 )
+		return;
+
+	peer->ssthresh = max(peer->cwnd * CDP_SACK_CWND_DECREASE, CDP_SACK_MIN_CWND);
+	peer->cwnd = peer->ssthresh;
+	peer->inRecovery = true;
+	peer->recoverySequence = peer->sendSequence;
+}
+
+// RTO of peer with exponential backoff by number of sends
+int CEqRDPSocket::GetResendTimeout( const cdp_queued_message_t* msg ) const
+{
+	const cdp_peer_t* peer = msg->peer;
+	const int backoff = min(msg->sendTimes - 1, 4);
+	int timeoutMs = min(peer->rtoMs << backoff, CDP_SACK_MAX_RTO_MS);
+
+	// datagram sent later was acknowledged, so this one is lost if it's overdue by reordering window
+	if( peer->hasRtt && CDPSeqDiff( peer->highestAcked, msg->sequence ) > 0 )
+		timeoutMs = min(timeoutMs, peer->srttMs + max(peer->srttMs / 4, CDP_SACK_MIN_REORDER_MS));
+
+	return timeoutMs;
+}
+
+// sends datagrams allowed by congestion window and resends lost ones
+void CEqRDPSocket::UpdateSendQueueSelective( int timeMs, CDPRecvPipe_fn recvFunc, void* recvObj )
+{
+	struct {
+		sockaddr_in		addr;
+		short			messageId;
+	} failed[32];
+	int numFailed = 0;
+
+	{
+		CScopedMutex m(m_Mutex);
+
+		for(int i = 0; i < m_pMessageQueue.numElem(); i++)
+		{
+			cdp_queued_message_t* buffer = m_pMessageQueue[i];
+			cdp_peer_t* peer = buffer->peer;
+
+			if( buffer->sendTimes == 0 )
+			{
+				buffer->sentTimeout += timeMs;
+				if( buffer->sentTimeout < m_nSendTimeout )
+					continue;
 
-				if( s_size < 0 )
+				if( peer->inFlight >= (int)peer->cwnd )
 				{
-					int nErrorMsg = sock_errno;
+					buffer->windowStalled = true;
+					++peer->stats.windowStalls;
+					continue;
+				}
 
-					// skip WSAEWOULDBLOCK and WSAENOTCONN to avoid freeze
-#ifdef _WIN32
-					if( nErrorMsg != WSAEWOULDBLOCK && nErrorMsg != WSAENOTCONN )
-#else
-					if( nErrorMsg != EWOULDBLOCK && nErrorMsg != ENOTCONN )
-#endif // _WIN32
-					{
+				buffer->windowStalled = false;
+				buffer->inFlight = true;
+				++peer->inFlight;
+			}
+			else
+			{
+				const bool timedOut = (int)(m_time - buffer->sendTime) >= GetResendTimeout( buffer );
+				if( !timedOut && !buffer->fastResend )
+					continue;
+
+				if( buffer->sendTimes >= CDP_SACK_MAX_SENDS )
+				{
+					// failure is reported after unlock, rest is processed next update
+					if( numFailed == elementsOf(failed) )
 						continue;
-					}
+
+					failed[numFailed].addr = buffer->addr;
+					failed[numFailed].messageId = buffer->messageId;
+					numFailed++;
+
+					++peer->stats.failed;
+					FreeMessage( buffer );
+					i--;
+					continue;
 				}
+
+				if( buffer->fastResend || CDPSeqDiff( peer->highestAcked, buffer->sequence ) > 0 )
+					++peer->stats.fastRetransmits;
+				else
+					++peer->stats.timeouts;
+
+				OnPeerPacketLoss( peer, buffer->sequence );
+				++peer->stats.retransmits;
+				buffer->fastResend = false;
 			}
 
-			// if this message is unguaranteed, remove now
-			if( !(buffer->flags & CDPSEND_GUARANTEED) )
-			{
-				Threading::CScopedMutex m( m_Mutex );
+			// each transmission gets new sequence so acknowledge tells which one has arrived
+			cdp_queued_message_t*& oldSeqSlot = peer->sentSeqs[buffer->sequence & (CDP_SACK_SEQ_WINDOW-1)];
+			if( oldSeqSlot == buffer )
+				oldSeqSlot = nullptr;
 
-				FreeMessage( buffer );
+			buffer->sequence = peer->sendSequence++;
+			peer->sentSeqs[buffer->sequence & (CDP_SACK_SEQ_WINDOW-1)] = buffer;
 
-				m_pMessageQueue.fastRemoveIndex( i );
-				i--;
+			udp_cdp_ackhdr_t ackhdr;
+			FillAckHeader( peer, ackhdr, buffer->sequence );
+			memcpy( buffer->packet.GetData() + sizeof(udp_cdp_hdr_t), &ackhdr, sizeof(udp_cdp_ackhdr_t) );
+
+			++buffer->sendTimes;
+			buffer->sendTime = m_time;
+			buffer->sentTimeout = 0;
+
+			++peer->stats.datagramsSent;
+			peer->stats.bytesSent += buffer->packet.GetSize();
+
+			cdp_send_item_t& item = m_sendBatch.append();
+			item.msg = buffer;
+			item.packet = buffer->packet;
+			item.removeAfterSend = false;
+		}
+
+		SendPendingAcks();
+	}
+
+	FlushSendBatch();
+
+	// make sender happy
+	for( int i = 0; i < numFailed; i++ )
+		(recvFunc)(recvObj, nullptr, DELIVERY_FAILED, failed[i].addr, failed[i].messageId, RECV_MSG_STATUS );
+}
 
-				if(m_pMessageQueue.numElem() < UDP_CDP_MAX_QUEUE_BUFFERS)
-					m_SendSignal.Raise();
+// sends ack-only datagrams to peers which had no outgoing traffic to piggyback on. m_Mutex must be locked
+void CEqRDPSocket::SendPendingAcks()
+{
+	for( int i = 0; i < m_ackPendingPeers.numElem(); i++ )
+	{
+		cdp_peer_t* peer = m_ackPendingPeers[i];
 
+		if( peer->ackPending )
+		{
+			if( m_time - peer->ackPendingTime < CDP_SACK_ACK_DELAY_MS )
 				continue;
-			}
 
-			buffer->sentTimeout = 0;
+			struct {
+				udp_cdp_hdr_t		hdr;
+				udp_cdp_ackhdr_t	ackhdr;
+			} ackMsg;
 
-			// DEBUG
-			/*
-			char filename[256];
+			ackMsg.hdr.ident = UDP_CDP_IDENT;
+			ackMsg.hdr.protocol_version = UDP_CDP_PROTOCOL_VERSION_SACK;
+			ackMsg.hdr.message_id = -1;
+			ackMsg.hdr.flags = 0;
 
-			udp_cdp_hdr_t* hdr = (udp_cdp_hdr_t*)buffer->data;
+			FillAckHeader( peer, ackMsg.ackhdr, 0 );
 
-			strcpy( filename, varargs("msg_debug/cdpsendmsg_%d", hdr->message_id) );
+			SendDatagram( &ackMsg, sizeof(ackMsg), peer->addr );
 
-			FILE* pFile = fopen(filename, "wb");
-			if(pFile)
-			{
-				fwrite(buffer->data, buffer->size, 1, pFile);
-				fclose(pFile);
-			}
-			*/
+			++peer->stats.ackDatagrams;
+			++peer->stats.datagramsSent;
+			peer->stats.bytesSent += sizeof(ackMsg);
 		}
+
+		peer->inAckList = false;
+		m_ackPendingPeers.fastRemoveIndex( i-- );
 	}
+}
 
-	// that's all
-	if(m_time > UINT_MAX - timeMs)
-		m_time = 0;
+bool CEqRDPSocket::GetPeerStats( const sockaddr_in& addr, CDPPeerStats& stats ) const
+{
+	CScopedMutex m(m_Mutex);
 
-	// increment the time
-	m_time += timeMs;
+	auto it = m_peers.find( CDPPeerKey( addr ) );
+	if( it.atEnd() )
+		return false;
+
+	const cdp_peer_t* peer = *it;
+	stats = peer->stats;
+	stats.srttMs = peer->srttMs;
+	stats.rttVarMs = peer->rttVarMs;
+	stats.rtoMs = peer->rtoMs;
+	stats.cwnd = peer->cwnd;
+	stats.inFlight = peer->inFlight;
+
+	return true;
 }
 
-bool CEqRDPSocket::HasAnyMessageWithId( short message_id, const sockaddr_in& addr  )
+bool CEqRDPSocket::MarkMessageReceived( short message_id, const sockaddr_in& addr )
 {
+	// status messages are not numbered
+	if( message_id < 0 )
+		return true;
+
 	CScopedMutex m(m_Mutex);
 
-	for(int i = 0; i < m_receivedIds.numElem(); i++)
+	cdp_peer_t* peer = GetPeer( addr, true );
+	peer->lastActiveTime = m_time;
+
+	++m_stats.recvIdLookups;
+	++m_stats.recvIdLookupSteps;
+
+	cdp_recv_msgid_t& recvId = peer->receivedIds[message_id & (CDP_RECV_WINDOW-1)];
+	if( recvId.msgid == message_id && m_time - recvId.time <= (uint32)m_nRecvTimeout )
+		return false;
+
+	recvId.msgid = message_id;
+	recvId.time = m_time;
+
+	return true;
+}
+
+// returns peer state of address. m_Mutex must be locked
+cdp_peer_t* CEqRDPSocket::GetPeer( const sockaddr_in& addr, bool create )
+{
+	if( m_lastPeer && NETCompareAdr(m_lastPeer->addr, addr) )
+		return m_lastPeer;
+
+	const uint64 peerKey = CDPPeerKey( addr );
+
+	auto it = m_peers.find( peerKey );
+	if( !it.atEnd() )
 	{
-		if((m_receivedIds[i].msgid == message_id) && NETCompareAdr(m_receivedIds[i].addr, addr))
-			return true;
+		m_lastPeer = *it;
+		return m_lastPeer;
 	}
 
-	return false;
+	if( !create )
+		return nullptr;
+
+	cdp_peer_t* peer = PPNew cdp_peer_t;
+	peer->addr = addr;
+	peer->lastActiveTime = m_time;
+	++m_stats.heapAllocs;
+
+	m_peers.insert( peerKey, peer );
+	m_lastPeer = peer;
+
+	return peer;
+}
+
+// removes peers which have nothing to send and no received ids to track
+void CEqRDPSocket::RemoveIdlePeers()
+{
+	CScopedMutex m(m_Mutex);
+
+	for( auto it = m_peers.begin(); !it.atEnd(); )
+	{
+		cdp_peer_t* peer = *it;
+		if( peer->numQueued > 0 || peer->inAckList || m_time - peer->lastActiveTime <= (uint32)m_nRecvTimeout )
+		{
+			++it;
+			continue;
+		}
+
+		if( m_lastPeer == peer )
+			m_lastPeer = nullptr;
+
+		delete peer;
+		it = m_peers.remove( it );
+	}
+}
+
+// allocates message from free list and puts it to the send queue. m_Mutex must be locked
+cdp_queued_message_t* CEqRDPSocket::AllocMessage( const sockaddr_in& addr, short nFlags )
+{
+	cdp_queued_message_t* msg = m_freeMessages;
+	if( msg )
+	{
+		m_freeMessages = msg->nextPending;
+		msg->nextPending = nullptr;
+	}
+	else
+	{
+		msg = PPNew cdp_queued_message_t;
+		++m_stats.heapAllocs;
+	}
+
+	msg->addr = addr;
+	msg->packet = g_packetPool.Alloc();
+	msg->flags = nFlags;
+	msg->messageId = GetMessageUniqueID();
+
+	// link to peer
+	cdp_peer_t* peer = GetPeer( addr, true );
+	msg->peer = peer;
+	msg->peerNext = peer->firstQueued;
+	if( peer->firstQueued )
+		peer->firstQueued->peerPrev = msg;
+	peer->firstQueued = msg;
+	++peer->numQueued;
+	peer->lastActiveTime = m_time;
+
+	// link to pending acks
+	cdp_queued_message_t*& ackSlot = m_pendingAcks[msg->messageId & (UDP_CDP_ACK_RING_SIZE-1)];
+	msg->nextPending = ackSlot;
+	ackSlot = msg;
+
+	msg->queueIdx = m_pMessageQueue.append( msg );
+
+	return msg;
+}
+
+// removes message from send queue and returns it to free list. m_Mutex must be locked
+void CEqRDPSocket::FreeMessage( cdp_queued_message_t* msg )
+{
+	// unlink from pending acks
+	for( cdp_queued_message_t** link = &m_pendingAcks[msg->messageId & (UDP_CDP_ACK_RING_SIZE-1)]; *link; link = &(*link)->nextPending )
+	{
+		if( *link == msg )
+		{
+			*link = msg->nextPending;
+			break;
+		}
+	}
+
+	// unlink from peer
+	cdp_peer_t* peer = msg->peer;
+	if( msg->peerPrev )
+		msg->peerPrev->peerNext = msg->peerNext;
+	else
+		peer->firstQueued = msg->peerNext;
+
+	if( msg->peerNext )
+		msg->peerNext->peerPrev = msg->peerPrev;
+
+	--peer->numQueued;
+
+	if( msg->inFlight )
+		--peer->inFlight;
+
+	cdp_queued_message_t*& seqSlot = peer->sentSeqs[msg->sequence & (CDP_SACK_SEQ_WINDOW-1)];
+	if( seqSlot == msg )
+		seqSlot = nullptr;
+
+	// remove from queue, last one takes its place
+	const int queueIdx = msg->queueIdx;
+	ASSERT( m_pMessageQueue[queueIdx] == msg );
+
+	m_pMessageQueue.fastRemoveIndex( queueIdx );
+	if( queueIdx < m_pMessageQueue.numElem() )
+		m_pMessageQueue[queueIdx]->queueIdx = queueIdx;
+
+	if( peer->numQueued < UDP_CDP_MAX_QUEUE_BUFFERS )
+		m_SendSignal.Raise();
+
+	msg->packet.Release();
+	msg->peer = nullptr;
+	msg->peerPrev = nullptr;
+	msg->peerNext = nullptr;
+	msg->sendTimes = 0;
+	msg->sentTimeout = 0;
+	msg->removeTimeout = 0;
+	msg->sendTime = 0;
+	msg->queueIdx = -1;
+	msg->sequence = 0;
+	msg->inFlight = false;
+	msg->fastResend = false;
+	msg->windowStalled = false;
+
+	msg->nextPending = m_freeMessages;
+	m_freeMessages = msg;
 }
 
 // returns a free message (it could create new buffer or return one freed)
@@ -785,124 +1625,111 @@ cdp_queued_message_t* CEqRDPSocket::GetFreeBuffer( int freeSpaceRequired, const
 {
 	ASSERT(freeSpaceRequired < UDP_CDP_MAX_MESSAGEPAYLOAD);
 
+	int numPeerQueued = 0;
 	{
 		Threading::CScopedMutex m(m_Mutex);
 
-		// find and return existing buffer
-		for( int i = 0; i < m_pMessageQueue.numElem(); i++ )
-		{
-			if(!m_pMessageQueue[i]->bytestream)
-			{
-				FreeMessage(m_pMessageQueue[i]);
-				m_pMessageQueue.fastRemoveIndex(i);
-				i--;
-				continue;
-			}
-
-			int nCurPos = m_pMessageQueue[i]->bytestream->Tell();
+		cdp_peer_t* peer = GetPeer( *to, true );
 
-			int nFreeSpace = ( UDP_CDP_MAX_MESSAGEPAYLOAD - m_pMessageQueue[i]->bytestream->Tell() );
+		// find and return existing buffer of this address
+		for( cdp_queued_message_t* msg = peer->firstQueued; msg; msg = msg->peerNext )
+		{
+			const int nCurPos = msg->packet.GetSize();
+			const int nFreeSpace = UDP_CDP_MAX_MESSAGEPAYLOAD - nCurPos;
 
-			if( nCurPos < UDP_CDP_MIN_SEND_BUFFER &&						// check for reaching minimal send size (THIS IS UGLY)
-				nFreeSpace > freeSpaceRequired &&							// check for overflow
-				(m_pMessageQueue[i]->sendTimes == 0) &&			// don't use already sent buffers
-				(m_pMessageQueue[i]->flags == nFlags) &&					// check it's usage
-				NETCompareAdr( m_pMessageQueue[i]->addr, *to ) )			// and only deliver to needed address
+			if( (nCurPos < UDP_CDP_MIN_SEND_BUFFER || msg->windowStalled) &&	// check for reaching minimal send size (THIS IS UGLY)
+				nFreeSpace > freeSpaceRequired &&				// check for overflow
+				(msg->sendTimes == 0) &&						// don't use already sent buffers
+				(msg->flags == nFlags) )						// check it's usage
 			{
-				return m_pMessageQueue[i];
+				return msg;
 			}
-
 		}
+
+		numPeerQueued = peer->numQueued;
 	}
 
 	// otherwise, allocate new
 
-	// if we ran out of buffers, force all to send immediately
+	// if we ran out of buffers for this address, force them to send immediately
 	// and wait thread
-	if( m_pMessageQueue.numElem() >= UDP_CDP_MAX_QUEUE_BUFFERS )
+	if( numPeerQueued >= UDP_CDP_MAX_QUEUE_BUFFERS )
 	{
-		Msg("GetFreeBuffer: exceeded UDP_CDP_MAX_QUEUE_BUFFERS (%d > %d)\n", m_pMessageQueue.numElem(), UDP_CDP_MAX_QUEUE_BUFFERS);
-
 		m_Mutex.Lock();
 
-		for(int i = 0; i < m_pMessageQueue.numElem(); i++)
-		{
-			m_pMessageQueue[i]->sentTimeout = m_nSendTimeout;
-		}
+		cdp_peer_t* peer = GetPeer( *to, true );
+		for( cdp_queued_message_t* msg = peer->firstQueued; msg; msg = msg->peerNext )
+			msg->sentTimeout = m_nSendTimeout;
 
 		m_Mutex.Unlock();
 
-		m_SendSignal.Wait( m_nSendTimeout*m_pMessageQueue.numElem() );
+		Wakeup();
+
+		m_SendSignal.Wait( m_nSendTimeout*numPeerQueued );
 
 		m_SendSignal.Clear();
 	}
 
-	cdp_queued_message_t* buffer = AllocMessage();
+	CScopedMutex m(m_Mutex);
 
-	buffer->flags = nFlags;
+	cdp_queued_message_t* buffer = AllocMessage( *to, nFlags );
 
 	udp_cdp_hdr_t hdr;
 	hdr.ident = UDP_CDP_IDENT;
-	hdr.protocol_version = UDP_CDP_PROTOCOL_VERSION;
-	hdr.message_id = GetMessageUniqueID();
+	hdr.protocol_version = (m_ackMode == CDP_ACK_SELECTIVE) ? UDP_CDP_PROTOCOL_VERSION_SACK : UDP_CDP_PROTOCOL_VERSION;
+	hdr.message_id = buffer->messageId;
 	hdr.flags = nFlags;
 	//hdr.crc32 = 0;
 
 	// write header before return
 	buffer->Write(&hdr, sizeof( udp_cdp_hdr_t ));
 
-	m_Mutex.Lock();
-	m_pMessageQueue.append(buffer);
-	m_Mutex.Unlock();
+	// sequence and acknowledge are filled on each send
+	if( m_ackMode == CDP_ACK_SELECTIVE )
+	{
+		udp_cdp_ackhdr_t ackhdr;
+		memset( &ackhdr, 0, sizeof(ackhdr) );
+		buffer->Write(&ackhdr, sizeof( udp_cdp_ackhdr_t ));
+	}
 
 	return buffer;
 }
 
 void CEqRDPSocket::RemoveMessageFromSendPool( short message_id )
 {
-	for( int i = 0; i < m_pMessageQueue.numElem(); i++ )
-	{
-		cdp_queued_message_t* pMsg = m_pMessageQueue[i];
+	++m_stats.ackLookups;
 
-		// this could not be happened, but i'll keep it there
-		//if( pMsg->sendTimes == 0 )
-		//	continue;
-
-		// get message header
-		udp_cdp_hdr_t* hdr = (udp_cdp_hdr_t*)m_pMessageQueue[i]->bytestream->GetBasePointer();
+	cdp_queued_message_t* msg = m_pendingAcks[message_id & (UDP_CDP_ACK_RING_SIZE-1)];
+	while( msg )
+	{
+		++m_stats.ackLookupSteps;
 
-		if( hdr->message_id == message_id )
+		cdp_queued_message_t* next = msg->nextPending;
+		if( msg->messageId == message_id )
 		{
-			FreeMessage( m_pMessageQueue[i] );
-			m_pMessageQueue.fastRemoveIndex( i );
-			i--;
+			++msg->peer->stats.delivered;
+			FreeMessage( msg );
 		}
+
+		msg = next;
 	}
 }
 
 void CEqRDPSocket::CheckMessageForResend( short message_id )
 {
-	for( int i = 0; i < m_pMessageQueue.numElem(); i++ )
-	{
-		cdp_queued_message_t* pMsg = m_pMessageQueue[i];
+	Threading::CScopedMutex m( m_Mutex );
 
+	for( cdp_queued_message_t* msg = m_pendingAcks[message_id & (UDP_CDP_ACK_RING_SIZE-1)]; msg; msg = msg->nextPending )
+	{
 		// this could not be happened, but i'll keep it there
-		if( pMsg->sendTimes == 0 )
+		if( msg->sendTimes == 0 || msg->messageId != message_id )
 			continue;
 
-		// get message header
-		udp_cdp_hdr_t* hdr = (udp_cdp_hdr_t*)m_pMessageQueue[i]->bytestream->GetBasePointer();
+		// repeat
+		msg->sendTimes = 0;
+		msg->sentTimeout = 0;
 
-		if( hdr->message_id == message_id )
-		{
-			Threading::CScopedMutex m( m_Mutex );
-
-			// repeat
-			m_pMessageQueue[i]->sendTimes = 0;
-			m_pMessageQueue[i]->sentTimeout = 0;
-
-			return;
-		}
+		return;
 	}
 }
 
@@ -922,8 +1749,14 @@ int CEqRDPSocket::GetSendPoolCount() const
 
 void CEqRDPSocket::PrintStats() const
 {
+	const PacketPoolStats poolStats = g_packetPool.GetStats();
+
 	Msg("m_pMessageQueue = %d\n", m_pMessageQueue.numElem());
-	Msg("m_receivedIds = %d\n", m_receivedIds.numElem());
+	Msg("m_peers = %d\n", m_peers.size());
+	Msg("heap allocs = %" PRId64 "\n", m_stats.heapAllocs);
+	Msg("ack lookups = %" PRId64 " (%" PRId64 " steps)\n", m_stats.ackLookups, m_stats.ackLookupSteps);
+	Msg("received id lookups = %" PRId64 " (%" PRId64 " steps)\n", m_stats.recvIdLookups, m_stats.recvIdLookupSteps);
+	Msg("packet pool: %d/%d used, %d peak, %" PRId64 " allocs, %" PRId64 " heap allocs\n", poolStats.numUsed, poolStats.numBuffers, poolStats.peakUsed, poolStats.poolAllocs, poolStats.heapAllocs);
 }
 
 }; // namespace CUDP
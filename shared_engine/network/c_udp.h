@@ -9,16 +9,58 @@
 
 #pragma once
 #include "net_defs.h"
+#include "PacketPool.h"
 
 #define CUDP_MESSAGE_ID_IMMEDIATE			(-3)
 #define CUDP_MESSAGE_ID_ERROR				(-2)
 #define UDP_CDP_MAX_MESSAGEPAYLOAD			MAX_MESSAGE_LENGTH		// maximum payload for this protocol type; Tweak this if you have issues
+#define UDP_CDP_ACK_RING_SIZE				1024					// pending acknowledge lookup by message id, power of two
 
 struct sockaddr_in;
 
 namespace Networking
 {
 struct cdp_queued_message_t;
+struct cdp_peer_t;
+struct udp_cdp_ackhdr_s;
+class CNetLinkSimulator;
+
+enum ECDPAckMode : int
+{
+	CDP_ACK_PER_MESSAGE = 0,	// status datagram for each guaranteed datagram, fixed resend timer
+	CDP_ACK_SELECTIVE,			// piggybacked sequence ack with 64 bit field, RTT based resend and congestion window
+};
+
+struct CDPSocketStats
+{
+	int64	heapAllocs{ 0 };		// message and peer allocations made from heap
+	int64	ackLookups{ 0 };		// send pool lookups by acknowledged message id
+	int64	ackLookupSteps{ 0 };	// send pool entries visited by ack lookups
+	int64	recvIdLookups{ 0 };		// duplicate message checks
+	int64	recvIdLookupSteps{ 0 };	// received ids visited by duplicate checks
+};
+
+struct CDPPeerStats
+{
+	int64	datagramsSent{ 0 };		// including retransmits and acknowledges
+	int64	datagramsReceived{ 0 };
+	int64	bytesSent{ 0 };
+	int64	bytesReceived{ 0 };
+	int64	ackDatagrams{ 0 };		// status or ack-only datagrams sent
+	int64	retransmits{ 0 };
+	int64	fastRetransmits{ 0 };	// retransmits caused by selective acks of later datagrams
+	int64	timeouts{ 0 };			// retransmits caused by RTO
+	int64	delivered{ 0 };			// guaranteed datagrams acknowledged
+	int64	failed{ 0 };			// guaranteed datagrams given up
+	int64	windowStalls{ 0 };		// sends delayed by congestion window
+
+	// selective mode only
+	int		srttMs{ 0 };
+	int		rttVarMs{ 0 };
+	int		rtoMs{ 0 };
+	float	cwnd{ 0.0f };
+	int		inFlight{ 0 };
+};
 
 class CEqRDPSocket
 {
@@ -29,6 +71,13 @@ public:
 	bool							Init(int port);
 	void							Close();
 
+	// must be the same on both sides, set before sending anything
+	void							SetAckMode( ECDPAckMode mode )	{ m_ackMode = mode; }
+	ECDPAckMode						GetAckMode() const				{ return m_ackMode; }
+
+	// outgoing datagrams are passed through link simulator, used by tests
+	void							SetLinkSimulator( CNetLinkSimulator* linkSim )	{ m_linkSim = linkSim; }
+
 	// puts message to send queue, or sends it immediately if flags used
 	int								Send(const char* data, int size, const sockaddr_in* to, short& msgId, short flags = 0 );
 
@@ -36,21 +85,57 @@ public:
 	void							UpdateRecieve( int dtMs, CDPRecvPipe_fn recvFunc, void* recvObj );
 	void							UpdateSendQueue( int dtMs, CDPRecvPipe_fn recvFunc, void* recvObj );
 
+	// blocks until datagrams arrive, resend timer expires or Wakeup is called. Returns false on timeout
+	bool							WaitForEvents( int maxWaitMs );
+
+	// interrupts WaitForEvents, called when messages are queued
+	void							Wakeup();
+
 	int								GetSendPoolCount() const;
 
 	void							PrintStats() const;
+	const CDPSocketStats&			GetStats() const { return m_stats; }
+
+	// returns false if peer is not known
+	bool							GetPeerStats( const sockaddr_in& addr, CDPPeerStats& stats ) const;
 
 	sockaddr_in						GetAddress() const { return m_addr; }
 
 protected:
 	cdp_queued_message_t*			GetFreeBuffer( int freeSpaceRequired, const sockaddr_in* to, short nFlags );
 
-	bool							HasAnyMessageWithId( short message_id, const sockaddr_in& addr );
+	// returns false if message was already received from this address
+	bool							MarkMessageReceived( short message_id, const sockaddr_in& addr );
+
+	cdp_peer_t*						GetPeer( const sockaddr_in& addr, bool create );
+	void							RemoveIdlePeers();
+
+	cdp_queued_message_t*			AllocMessage( const sockaddr_in& addr, short nFlags );
+	void							FreeMessage( cdp_queued_message_t* msg );
 
 	void							RemoveMessageFromSendPool( short message_id );
 	void							CheckMessageForResend( short message_id );
 
 	void							SendMessageStatus( const sockaddr_in* to, short message_id, bool isOk );
+	void							SendDatagram( const void* data, int size, const sockaddr_in& to );
+
+	void							UpdateSendQueuePerMessage( int timeMs, CDPRecvPipe_fn recvFunc, void* recvObj );
+
+	// selective acknowledge mode
+	void							FillAckHeader( cdp_peer_t* peer, udp_cdp_ackhdr_s& ackhdr, ushort sequence );
+	void							RecordReceivedSequence( cdp_peer_t* peer, ushort sequence );
+	int								ProcessAckHeader( cdp_peer_t* peer, const udp_cdp_ackhdr_s& ackhdr, short* ackedIds );
+	void							OnPeerPacketLoss( cdp_peer_t* peer, ushort sequence );
+	void							UpdateSendQueueSelective( int timeMs, CDPRecvPipe_fn recvFunc, void* recvObj );
+	void							SendPendingAcks();
+	int								GetResendTimeout( const cdp_queued_message_t* msg ) const;
+
+	void							ProcessDatagram( ubyte* message_buffer, int r_size, const sockaddr_in& fromaddr, CDPRecvPipe_fn recvFunc, void* recvObj );
+	int								FlushSendBatch();
+	void							ArmResendTimer();
+
+	bool							InitEvents();
+	void							ShutdownEvents();
 
 	int								GetMessageUniqueID();
 
@@ -61,16 +146,36 @@ private:
 
 	sockaddr_in						m_addr;
 
-	struct cdp_receive_msgid_t
+	struct cdp_send_item_t
 	{
-		sockaddr_in		addr;
-		short			msgid;
-		int				timeMs;
+		cdp_queued_message_t*	msg;
+		PacketSlice				packet;		// shares storage with queued message
+		bool					removeAfterSend;
 	};
 
 	// messages are not limited, but they are splitted
 	Array<cdp_queued_message_t*> 	m_pMessageQueue{ PP_SL };
-	Array<cdp_receive_msgid_t>		m_receivedIds{ PP_SL };
+	Array<cdp_send_item_t>			m_sendBatch{ PP_SL };
+
+	// guaranteed messages waiting for acknowledge, chained by message id
+	cdp_queued_message_t*			m_pendingAcks[UDP_CDP_ACK_RING_SIZE]{ nullptr };
+	cdp_queued_message_t*			m_freeMessages{ nullptr };
+
+	Map<uint64, cdp_peer_t*>		m_peers{ PP_SL };
+	Array<cdp_peer_t*>				m_ackPendingPeers{ PP_SL };
+	cdp_peer_t*						m_lastPeer{ nullptr };
+	uint32							m_peerCleanupTime{ 0 };
+
+	CDPSocketStats					m_stats;
+	ECDPAckMode						m_ackMode{ CDP_ACK_PER_MESSAGE };
+	CNetLinkSimulator*				m_linkSim{ nullptr };
+
+	ubyte*							m_recvBuffer{ nullptr };	// UDP_CDP_RECV_BATCH datagrams
+
+	// event loop handles (epoll, timerfd and eventfd on Linux)
+	int								m_epollFd{ -1 };
+	int								m_timerFd{ -1 };
+	int								m_wakeupFd{ -1 };
 
 	int								m_nMessageIDInc;
 
@@ -80,7 +185,7 @@ private:
 
 	uint32							m_time;
 
-	Threading::CEqMutex				m_Mutex;
+	mutable Threading::CEqMutex		m_Mutex;
 	Threading::CEqSignal			m_SendSignal;
 };
 
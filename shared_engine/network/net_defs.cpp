@@ -21,13 +21,7 @@ bool NETCompareAdr(const sockaddr_in& a, const sockaddr_in& b)
 		a.sin_port == b.sin_port)
 		return true;
 #else
-	uint8* ipA = (uint8*)&a.sin_addr.s_addr;
-	uint8* ipB = (uint8*)&b.sin_addr.s_addr;
-
-	if (ipA[0] == ipB[3] &&
-		ipA[1] == ipB[3] &&
-		ipA[2] == ipB[3] &&
-		ipA[3] == ipB[3] &&
+	if (a.sin_addr.s_addr == b.sin_addr.s_addr &&
 		a.sin_port == b.sin_port)
 		return true;
 #endif
@@ -70,6 +70,9 @@ static btCollisionShape* ShapeCache_GenerateBulletShape(ArrayCRef<Vector3D> vert
 			convexShape->setMargin(EQ2BULLET(0.1f * margin));
 			convexShape->recalcLocalAabb();
 
+			// faces and edges are required by native narrow phase
+			convexShape->initializePolyhedralFeatures();
+
 			return convexShape;
 		}
 	}
@@ -0,0 +1,1477 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2020
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Native narrow phase for common convex shape pairs
+//
+//				Polyhedra and triangles are tested with SAT and contacts are made
+//				by clipping incident face against reference face.
+//				Spheres and capsules are points and segments with radius, their
+//				closest points are found with GJK, and SAT is used when cores overlap.
+//
+//////////////////////////////////////////////////////////////////////////////////
+
+#include <btBulletCollisionCommon.h>
+#include <BulletCollision/CollisionShapes/btConvexPolyhedron.h>
+#include <BulletCollision/CollisionShapes/btTriangleInfoMap.h>
+
+#include "core/core_common.h"
+#include "eqCollision_NarrowPhase.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NARROWPHASE_SSE2
+#endif
+
+static constexpr const int NARROWPHASE_MAX_POLYGON_VERTS	= 64;
+static constexpr const int NARROWPHASE_GJK_MAX_ITERATIONS	= 32;
+
+static constexpr const float NARROWPHASE_GJK_TOLERANCE		= 1e-6f;	// relative progress of GJK iteration
+static constexpr const float NARROWPHASE_AXIS_EPSILON		= 1e-6f;	// squared length of degenerate SAT axis
+static constexpr const float NARROWPHASE_FACE_TOLERANCE		= 0.98f;	// cosine for capsule face contacts
+static constexpr const float NARROWPHASE_EDGE_REL_TOLERANCE	= 0.95f;	// edge axis must be noticeably better than face
+static constexpr const float NARROWPHASE_EDGE_ABS_TOLERANCE	= 0.001f;
+static constexpr const float NARROWPHASE_MESH_AABB_EXPAND	= 0.01f;
+
+using NPPolygon = FixedArray<Vector3D, NARROWPHASE_MAX_POLYGON_VERTS>;
+
+struct NPContactList
+{
+	eqNarrowPhaseContact*	contacts;
+	int						numContacts;
+	int						maxContacts;
+
+	// adds contact from the point on shape X with normal from Y to X
+	void Add(const Vector3D& pointOnX, const Vector3D& normalYX, float distance, bool xIsA)
+	{
+		if (numContacts >= maxContacts)
+			return;
+
+		eqNarrowPhaseContact& contact = contacts[numContacts++];
+		contact.distance = distance;
+		contact.partId = -1;
+		contact.triangleIndex = -1;
+
+		if (xIsA)
+		{
+			contact.position = pointOnX;
+			contact.normal = normalYX;
+		}
+		else
+		{
+			contact.position = pointOnX - normalYX * distance;
+			contact.normal = -normalYX;
+		}
+	}
+};
+
+static inline int NP_TriangleHash(int partId, int triangleIndex)
+{
+	return (partId << (31 - MAX_NUM_PARTS_IN_BITS)) | triangleIndex;
+}
+
+static inline bool NP_IsRounded(const eqNarrowPhaseShape& shape)
+{
+	return shape.type == NARROWPHASE_SHAPE_SPHERE || shape.type == NARROWPHASE_SHAPE_CAPSULE;
+}
+
+static inline Vector3D NP_ToLocal(const Matrix3x3& rotation, const Vector3D& dir)
+{
+	return rotation.rows[0] * dir.x + rotation.rows[1] * dir.y + rotation.rows[2] * dir.z;
+}
+
+static inline Vector3D NP_PolyVertex(const eqNarrowPhaseShape& shape, int index)
+{
+	const btVector3& v = shape.polyhedron->m_vertices[index];
+	return shape.rotation * Vector3D(v.m_floats[0], v.m_floats[1], v.m_floats[2]) + shape.position;
+}
+
+//----------------------------------------------------------------------------------------------
+// Polyhedron vertex projection
+// btVector3 is always four floats so four vertices are transposed into SoA registers
+
+static void NP_ProjectVertices(const btVector3* verts, int numVerts, const Vector3D& axis, float& outMin, float& outMax)
+{
+	float vmin = F_INFINITY;
+	float vmax = -F_INFINITY;
+	int i = 0;
+
+#ifdef NARROWPHASE_SSE2
+	if (numVerts >= 4)
+	{
+		const __m128 ax = _mm_set1_ps(axis.x);
+		const __m128 ay = _mm_set1_ps(axis.y);
+		const __m128 az = _mm_set1_ps(axis.z);
+
+		__m128 minV = _mm_set1_ps(F_INFINITY);
+		__m128 maxV = _mm_set1_ps(-F_INFINITY);
+
+		for (; i + 4 <= numVerts; i += 4)
+		{
+			__m128 r0 = _mm_loadu_ps(verts[i + 0].m_floats);
+			__m128 r1 = _mm_loadu_ps(verts[i + 1].m_floats);
+			__m128 r2 = _mm_loadu_ps(verts[i + 2].m_floats);
+			__m128 r3 = _mm_loadu_ps(verts[i + 3].m_floats);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+			const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r0, ax), _mm_mul_ps(r1, ay)), _mm_mul_ps(r2, az));
+			minV = _mm_min_ps(minV, d);
+			maxV = _mm_max_ps(maxV, d);
+		}
+
+		minV = _mm_min_ps(minV, _mm_shuffle_ps(minV, minV, _MM_SHUFFLE(1, 0, 3, 2)));
+		minV = _mm_min_ps(minV, _mm_shuffle_ps(minV, minV, _MM_SHUFFLE(2, 3, 0, 1)));
+		maxV = _mm_max_ps(maxV, _mm_shuffle_ps(maxV, maxV, _MM_SHUFFLE(1, 0, 3, 2)));
+		maxV = _mm_max_ps(maxV, _mm_shuffle_ps(maxV, maxV, _MM_SHUFFLE(2, 3, 0, 1)));
+
+		vmin = _mm_cvtss_f32(minV);
+		vmax = _mm_cvtss_f32(maxV);
+	}
+#endif // NARROWPHASE_SSE2
+
+	for (; i < numVerts; ++i)
+	{
+		const float* v = verts[i].m_floats;
+		const float d = v[0] * axis.x + v[1] * axis.y + v[2] * axis.z;
+		vmin = min(vmin, d);
+		vmax = max(vmax, d);
+	}
+
+	outMin = vmin;
+	outMax = vmax;
+}
+
+static int NP_SupportVertex(const btVector3* verts, int numVerts, const Vector3D& axis)
+{
+	int best = 0;
+	float bestDist = -F_INFINITY;
+	int i = 0;
+
+#ifdef NARROWPHASE_SSE2
+	if (numVerts >= 4)
+	{
+		const __m128 ax = _mm_set1_ps(axis.x);
+		const __m128 ay = _mm_set1_ps(axis.y);
+		const __m128 az = _mm_set1_ps(axis.z);
+
+		__m128 maxV = _mm_set1_ps(-F_INFINITY);
+		__m128i maxIdx = _mm_setzero_si128();
+		__m128i idx = _mm_setr_epi32(0, 1, 2, 3);
+		const __m128i four = _mm_set1_epi32(4);
+
+		for (; i + 4 <= numVerts; i += 4)
+		{
+			__m128 r0 = _mm_loadu_ps(verts[i + 0].m_floats);
+			__m128 r1 = _mm_loadu_ps(verts[i + 1].m_floats);
+			__m128 r2 = _mm_loadu_ps(verts[i + 2].m_floats);
+			__m128 r3 = _mm_loadu_ps(verts[i + 3].m_floats);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+			const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r0, ax), _mm_mul_ps(r1, ay)), _mm_mul_ps(r2, az));
+			const __m128i greater = _mm_castps_si128(_mm_cmpgt_ps(d, maxV));
+
+			maxV = _mm_max_ps(maxV, d);
+			maxIdx = _mm_or_si128(_mm_and_si128(greater, idx), _mm_andnot_si128(greater, maxIdx));
+			idx = _mm_add_epi32(idx, four);
+		}
+
+		alignas(16) float lanes[4];
+		alignas(16) int lanesIdx[4];
+		_mm_store_ps(lanes, maxV);
+		_mm_store_si128(reinterpret_cast<__m128i*>(lanesIdx), maxIdx);
+
+		for (int j = 0; j < 4; ++j)
+		{
+			if (lanes[j] > bestDist)
+			{
+				bestDist = lanes[j];
+				best = lanesIdx[j];
+			}
+		}
+	}
+#endif // NARROWPHASE_SSE2
+
+	for (; i < numVerts; ++i)
+	{
+		const float* v = verts[i].m_floats;
+		const float d = v[0] * axis.x + v[1] * axis.y + v[2] * axis.z;
+		if (d > bestDist)
+		{
+			bestDist = d;
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+//----------------------------------------------------------------------------------------------
+// Shape queries in world space
+
+// support point of shape core, radius is not included
+static Vector3D NP_Support(const eqNarrowPhaseShape& shape, const Vector3D& dir)
+{
+	switch (shape.type)
+	{
+		case NARROWPHASE_SHAPE_SPHERE:
+			return shape.points[0];
+		case NARROWPHASE_SHAPE_CAPSULE:
+			return dot(shape.points[0], dir) >= dot(shape.points[1], dir) ? shape.points[0] : shape.points[1];
+		case NARROWPHASE_SHAPE_TRIANGLE:
+		{
+			const float d0 = dot(shape.points[0], dir);
+			const float d1 = dot(shape.points[1], dir);
+			const float d2 = dot(shape.points[2], dir);
+			if (d0 >= d1 && d0 >= d2)
+				return shape.points[0];
+			return d1 >= d2 ? shape.points[1] : shape.points[2];
+		}
+		case NARROWPHASE_SHAPE_POLYHEDRON:
+		{
+			if (shape.halfExtents.x > 0.0f)
+			{
+				const Vector3D localDir = NP_ToLocal(shape.rotation, dir);
+				const Vector3D vertex(
+					localDir.x >= 0.0f ? shape.halfExtents.x : -shape.halfExtents.x,
+					localDir.y >= 0.0f ? shape.halfExtents.y : -shape.halfExtents.y,
+					localDir.z >= 0.0f ? shape.halfExtents.z : -shape.halfExtents.z);
+				return shape.rotation * vertex + shape.position;
+			}
+
+			const btConvexPolyhedron& poly = *shape.polyhedron;
+			const int index = NP_SupportVertex(&poly.m_vertices[0], poly.m_vertices.size(), NP_ToLocal(shape.rotation, dir));
+			return NP_PolyVertex(shape, index);
+		}
+	}
+	return vec3_zero;
+}
+
+// shape interval on axis including radius
+static void NP_Project(const eqNarrowPhaseShape& shape, const Vector3D& axis, float& outMin, float& outMax)
+{
+	switch (shape.type)
+	{
+		case NARROWPHASE_SHAPE_SPHERE:
+		{
+			const float d = dot(shape.points[0], axis);
+			outMin = d - shape.radius;
+			outMax = d + shape.radius;
+			break;
+		}
+		case NARROWPHASE_SHAPE_CAPSULE:
+		{
+			const float d0 = dot(shape.points[0], axis);
+			const float d1 = dot(shape.points[1], axis);
+			outMin = min(d0, d1) - shape.radius;
+			outMax = max(d0, d1) + shape.radius;
+			break;
+		}
+		case NARROWPHASE_SHAPE_TRIANGLE:
+		{
+			const float d0 = dot(shape.points[0], axis);
+			const float d1 = dot(shape.points[1], axis);
+			const float d2 = dot(shape.points[2], axis);
+			outMin = min(d0, min(d1, d2));
+			outMax = max(d0, max(d1, d2));
+			break;
+		}
+		case NARROWPHASE_SHAPE_POLYHEDRON:
+		{
+			const float offset = dot(shape.position, axis);
+			if (shape.halfExtents.x > 0.0f)
+			{
+				const Vector3D localAxis = NP_ToLocal(shape.rotation, axis);
+				const float extent = dot(shape.halfExtents, Vector3D(fabsf(localAxis.x), fabsf(localAxis.y), fabsf(localAxis.z)));
+				outMin = offset - extent;
+				outMax = offset + extent;
+				break;
+			}
+
+			const btConvexPolyhedron& poly = *shape.polyhedron;
+			NP_ProjectVertices(&poly.m_vertices[0], poly.m_vertices.size(), NP_ToLocal(shape.rotation, axis), outMin, outMax);
+
+			outMin += offset;
+			outMax += offset;
+			break;
+		}
+		default:
+			outMin = outMax = 0.0f;
+	}
+}
+
+static inline Vector3D NP_BoxAxis(const eqNarrowPhaseShape& shape, int axis)
+{
+	return Vector3D(shape.rotation.rows[0][axis], shape.rotation.rows[1][axis], shape.rotation.rows[2][axis]);
+}
+
+// opposite box faces give the same SAT axis so only three are tested
+static int NP_NumFaces(const eqNarrowPhaseShape& shape)
+{
+	if (shape.type == NARROWPHASE_SHAPE_POLYHEDRON)
+		return shape.halfExtents.x > 0.0f ? 3 : shape.polyhedron->m_faces.size();
+	return shape.type == NARROWPHASE_SHAPE_TRIANGLE ? 1 : 0;
+}
+
+static Vector3D NP_FaceNormal(const eqNarrowPhaseShape& shape, int face)
+{
+	if (shape.type == NARROWPHASE_SHAPE_TRIANGLE)
+		return normalize(cross(shape.points[1] - shape.points[0], shape.points[2] - shape.points[0]));
+
+	if (shape.halfExtents.x > 0.0f)
+		return NP_BoxAxis(shape, face);
+
+	const btScalar* plane = shape.polyhedron->m_faces[face].m_plane;
+	return shape.rotation * Vector3D(plane[0], plane[1], plane[2]);
+}
+
+static int NP_NumEdges(const eqNarrowPhaseShape& shape)
+{
+	switch (shape.type)
+	{
+		case NARROWPHASE_SHAPE_CAPSULE:
+			return 1;
+		case NARROWPHASE_SHAPE_TRIANGLE:
+			return 3;
+		case NARROWPHASE_SHAPE_POLYHEDRON:
+			return shape.halfExtents.x > 0.0f ? 3 : shape.polyhedron->m_uniqueEdges.size();
+	}
+	return 0;
+}
+
+static Vector3D NP_EdgeDir(const eqNarrowPhaseShape& shape, int edge)
+{
+	switch (shape.type)
+	{
+		case NARROWPHASE_SHAPE_CAPSULE:
+			return shape.points[1] - shape.points[0];
+		case NARROWPHASE_SHAPE_TRIANGLE:
+			return shape.points[(edge + 1) % 3] - shape.points[edge];
+	}
+
+	if (shape.halfExtents.x > 0.0f)
+		return NP_BoxAxis(shape, edge);
+
+	const btVector3& e = shape.polyhedron->m_uniqueEdges[edge];
+	return shape.rotation * Vector3D(e.m_floats[0], e.m_floats[1], e.m_floats[2]);
+}
+
+// face which normal is closest to direction
+static void NP_GetFacePolygon(const eqNarrowPhaseShape& shape, const Vector3D& dir, NPPolygon& outPolygon, Vector3D& outNormal)
+{
+	outPolygon.clear();
+
+	if (shape.type == NARROWPHASE_SHAPE_TRIANGLE)
+	{
+		outNormal = NP_FaceNormal(shape, 0);
+		if (dot(outNormal, dir) < 0.0f)
+			outNormal = -outNormal;
+
+		outPolygon.append(shape.points[0]);
+		outPolygon.append(shape.points[1]);
+		outPolygon.append(shape.points[2]);
+		return;
+	}
+
+	const Vector3D localDir = NP_ToLocal(shape.rotation, dir);
+
+	// box face is built from extents without going through polyhedron
+	if (shape.halfExtents.x > 0.0f)
+	{
+		int axis = 0;
+		for (int i = 1; i < 3; ++i)
+		{
+			if (fabsf(localDir[i]) > fabsf(localDir[axis]))
+				axis = i;
+		}
+
+		const int axisU = (axis + 1) % 3;
+		const int axisV = (axis + 2) % 3;
+		const float sign = localDir[axis] >= 0.0f ? 1.0f : -1.0f;
+
+		outNormal = NP_BoxAxis(shape, axis) * sign;
+
+		const Vector3D center = shape.position + outNormal * shape.halfExtents[axis];
+		const Vector3D u = NP_BoxAxis(shape, axisU) * shape.halfExtents[axisU];
+		const Vector3D v = NP_BoxAxis(shape, axisV) * shape.halfExtents[axisV];
+
+		outPolygon.append(center + u + v);
+		outPolygon.append(center - u + v);
+		outPolygon.append(center - u - v);
+		outPolygon.append(center + u - v);
+		return;
+	}
+
+	const btConvexPolyhedron& poly = *shape.polyhedron;
+
+	int bestFace = 0;
+	float bestDot = -F_INFINITY;
+	for (int i = 0; i < poly.m_faces.size(); ++i)
+	{
+		const btScalar* plane = poly.m_faces[i].m_plane;
+		const float d = plane[0] * localDir.x + plane[1] * localDir.y + plane[2] * localDir.z;
+		if (d > bestDot)
+		{
+			bestDot = d;
+			bestFace = i;
+		}
+	}
+
+	const btFace& face = poly.m_faces[bestFace];
+	const int numVerts = min(face.m_indices.size(), NARROWPHASE_MAX_POLYGON_VERTS);
+	for (int i = 0; i < numVerts; ++i)
+		outPolygon.append(NP_PolyVertex(shape, face.m_indices[i]));
+
+	outNormal = shape.rotation * Vector3D(face.m_plane[0], face.m_plane[1], face.m_plane[2]);
+}
+
+// Sutherland-Hodgman, keeps part where dot(planeNormal, p) <= planeDist
+static void NP_ClipPolygon(const NPPolygon& input, NPPolygon& output, const Vector3D& planeNormal, float planeDist)
+{
+	output.clear();
+	if (!input.numElem())
+		return;
+
+	Vector3D start = input.back();
+	float startDist = dot(planeNormal, start) - planeDist;
+
+	for (const Vector3D& end : input)
+	{
+		const float endDist = dot(planeNormal, end) - planeDist;
+
+		if ((startDist <= 0.0f) != (endDist <= 0.0f) && output.numElem() < output.numAllocated())
+			output.append(lerp(start, end, startDist / (startDist - endDist)));
+
+		if (endDist <= 0.0f && output.numElem() < output.numAllocated())
+			output.append(end);
+
+		start = end;
+		startDist = endDist;
+	}
+}
+
+//----------------------------------------------------------------------------------------------
+// SAT
+
+enum ENPAxisType : int
+{
+	NP_AXIS_FACE_A = 0,
+	NP_AXIS_FACE_B,
+	NP_AXIS_EDGES,
+};
+
+struct NPSatAxis
+{
+	Vector3D	normal;					// from B to A
+	float		depth{ F_INFINITY };
+	int			edgeA{ -1 };
+	int			edgeB{ -1 };
+};
+
+// false if axis separates shapes, otherwise axis gets oriented from B to A
+static bool NP_TestAxis(const eqNarrowPhaseShape& shapeA, const eqNarrowPhaseShape& shapeB, const Vector3D& axis, NPSatAxis& best)
+{
+	float minA, maxA, minB, maxB;
+	NP_Project(shapeA, axis, minA, maxA);
+	NP_Project(shapeB, axis, minB, maxB);
+
+	const float depthPositive = maxB - minA;		// A lies along the axis
+	const float depthNegative = maxA - minB;
+	if (depthPositive < 0.0f || depthNegative < 0.0f)
+		return false;
+
+	const float depth = min(depthPositive, depthNegative);
+	if (depth < best.depth)
+	{
+		best.depth = depth;
+		best.normal = depthPositive <= depthNegative ? axis : -axis;
+	}
+	return true;
+}
+
+static bool NP_SelectPenetrationAxis(const NPSatAxis& faceA, const NPSatAxis& faceB, const NPSatAxis& edges, NPSatAxis& outAxis, ENPAxisType& outType)
+{
+	// face axes are preferred as they produce stable manifolds
+	outType = NP_AXIS_FACE_A;
+	outAxis = faceA;
+	if (faceB.depth < faceA.depth * NARROWPHASE_FACE_TOLERANCE - NARROWPHASE_EDGE_ABS_TOLERANCE)
+	{
+		outType = NP_AXIS_FACE_B;
+		outAxis = faceB;
+	}
+
+	if (edges.edgeA != -1 && edges.depth < outAxis.depth * NARROWPHASE_EDGE_REL_TOLERANCE - NARROWPHASE_EDGE_ABS_TOLERANCE)
+	{
+		outType = NP_AXIS_EDGES;
+		outAxis = edges;
+	}
+
+	return outAxis.depth < F_INFINITY;
+}
+
+// finds axis of minimal penetration, false if shapes are separated
+static bool NP_FindPenetrationAxis(const eqNarrowPhaseShape& shapeA, const eqNarrowPhaseShape& shapeB, NPSatAxis& outAxis, ENPAxisType& outType)
+{
+	NPSatAxis faceA, faceB, edges;
+
+	const int numFacesA = NP_NumFaces(shapeA);
+	for (int i = 0; i < numFacesA; ++i)
+	{
+		if (!NP_TestAxis(shapeA, shapeB, NP_FaceNormal(shapeA, i), faceA))
+			return false;
+	}
+
+	const int numFacesB = NP_NumFaces(shapeB);
+	for (int i = 0; i < numFacesB; ++i)
+	{
+		if (!NP_TestAxis(shapeA, shapeB, NP_FaceNormal(shapeB, i), faceB))
+			return false;
+	}
+
+	const int numEdgesA = NP_NumEdges(shapeA);
+	const int numEdgesB = NP_NumEdges(shapeB);
+	for (int i = 0; i < numEdgesA; ++i)
+	{
+		const Vector3D edgeA = NP_EdgeDir(shapeA, i);
+		for (int j = 0; j < numEdgesB; ++j)
+		{
+			const Vector3D axis = cross(edgeA, NP_EdgeDir(shapeB, j));
+			const float axisLenSqr = lengthSqr(axis);
+			if (axisLenSqr < NARROWPHASE_AXIS_EPSILON * lengthSqr(edgeA))
+				continue;
+
+			const float prevDepth = edges.depth;
+			if (!NP_TestAxis(shapeA, shapeB, axis / sqrtf(axisLenSqr), edges))
+				return false;
+
+			if (edges.depth < prevDepth)
+			{
+				edges.edgeA = i;
+				edges.edgeB = j;
+			}
+		}
+	}
+
+	return NP_SelectPenetrationAxis(faceA, faceB, edges, outAxis, outType);
+}
+
+// OBB test done in frame of box A, all 15 axes are taken from relative rotation
+static bool NP_FindBoxPenetrationAxis(const eqNarrowPhaseShape& boxA, const eqNarrowPhaseShape& boxB, NPSatAxis& outAxis, ENPAxisType& outType)
+{
+	const float* hA = &boxA.halfExtents.x;
+	const float* hB = &boxB.halfExtents.x;
+
+	Vector3D axesA[3];
+	Vector3D axesB[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		axesA[i] = NP_BoxAxis(boxA, i);
+		axesB[i] = NP_BoxAxis(boxB, i);
+	}
+
+	float rot[3][3];
+	float absRot[3][3];
+	for (int i = 0; i < 3; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			rot[i][j] = dot(axesA[i], axesB[j]);
+			absRot[i][j] = fabsf(rot[i][j]) + NARROWPHASE_AXIS_EPSILON;
+		}
+	}
+
+	const Vector3D delta = boxA.position - boxB.position;
+	const float deltaA[3] = { dot(delta, axesA[0]), dot(delta, axesA[1]), dot(delta, axesA[2]) };
+
+	NPSatAxis faceA, faceB, edges;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		const float depth = hA[i] + hB[0] * absRot[i][0] + hB[1] * absRot[i][1] + hB[2] * absRot[i][2] - fabsf(deltaA[i]);
+		if (depth < 0.0f)
+			return false;
+
+		if (depth < faceA.depth)
+		{
+			faceA.depth = depth;
+			faceA.normal = deltaA[i] >= 0.0f ? axesA[i] : -axesA[i];
+		}
+	}
+
+	for (int j = 0; j < 3; ++j)
+	{
+		const float deltaB = dot(delta, axesB[j]);
+		const float depth = hA[0] * absRot[0][j] + hA[1] * absRot[1][j] + hA[2] * absRot[2][j] + hB[j] - fabsf(deltaB);
+		if (depth < 0.0f)
+			return false;
+
+		if (depth < faceB.depth)
+		{
+			faceB.depth = depth;
+			faceB.normal = deltaB >= 0.0f ? axesB[j] : -axesB[j];
+		}
+	}
+
+	// axis is cross(axesA[i], axesB[j]) which length is sine between them
+	for (int i = 0; i < 3; ++i)
+	{
+		const int i1 = (i + 1) % 3;
+		const int i2 = (i + 2) % 3;
+
+		for (int j = 0; j < 3; ++j)
+		{
+			const float axisLenSqr = 1.0f - rot[i][j] * rot[i][j];
+			if (axisLenSqr < NARROWPHASE_AXIS_EPSILON)
+				continue;
+
+			const int j1 = (j + 1) % 3;
+			const int j2 = (j + 2) % 3;
+
+			const float radiusA = hA[i1] * absRot[i2][j] + hA[i2] * absRot[i1][j];
+			const float radiusB = hB[j1] * absRot[i][j2] + hB[j2] * absRot[i][j1];
+			const float dist = deltaA[i2] * rot[i1][j] - deltaA[i1] * rot[i2][j];
+
+			const float axisLen = sqrtf(axisLenSqr);
+			const float depth = (radiusA + radiusB - fabsf(dist)) / axisLen;
+			if (depth < 0.0f)
+				return false;
+
+			if (depth < edges.depth)
+			{
+				const Vector3D axis = cross(axesA[i], axesB[j]) / axisLen;
+				edges.depth = depth;
+				edges.normal = dist >= 0.0f ? axis : -axis;
+				edges.edgeA = i;
+				edges.edgeB = j;
+			}
+		}
+	}
+
+	return NP_SelectPenetrationAxis(faceA, faceB, edges, outAxis, outType);
+}
+
+//----------------------------------------------------------------------------------------------
+// GJK on shape cores
+
+struct NPSimplexVertex
+{
+	Vector3D	w;		// a - b
+	Vector3D	a;
+	Vector3D	b;
+};
+
+struct NPSimplex
+{
+	NPSimplexVertex	verts[4];
+	float			weights[4];
+	int				count{ 0 };
+
+	void Keep(int i0)
+	{
+		verts[0] = verts[i0];
+		weights[0] = 1.0f;
+		count = 1;
+	}
+
+	void Keep(int i0, int i1, float w0, float w1)
+	{
+		const NPSimplexVertex v0 = verts[i0];
+		const NPSimplexVertex v1 = verts[i1];
+		verts[0] = v0;
+		verts[1] = v1;
+		weights[0] = w0;
+		weights[1] = w1;
+		count = 2;
+	}
+
+	void Keep(int i0, int i1, int i2, float w0, float w1, float w2)
+	{
+		const NPSimplexVertex v0 = verts[i0];
+		const NPSimplexVertex v1 = verts[i1];
+		const NPSimplexVertex v2 = verts[i2];
+		verts[0] = v0;
+		verts[1] = v1;
+		verts[2] = v2;
+		weights[0] = w0;
+		weights[1] = w1;
+		weights[2] = w2;
+		count = 3;
+	}
+
+	Vector3D ClosestPoint() const
+	{
+		Vector3D v = vec3_zero;
+		for (int i = 0; i < count; ++i)
+			v += verts[i].w * weights[i];
+		return v;
+	}
+};
+
+// closest point of segment i0-i1 to origin
+static void NP_SolveSegment(NPSimplex& simplex, int i0, int i1)
+{
+	const Vector3D& a = simplex.verts[i0].w;
+	const Vector3D ab = simplex.verts[i1].w - a;
+	const float abLenSqr = lengthSqr(ab);
+	const float t = abLenSqr > 0.0f ? -dot(a, ab) / abLenSqr : 0.0f;
+
+	if (t <= 0.0f)
+		simplex.Keep(i0);
+	else if (t >= 1.0f)
+		simplex.Keep(i1);
+	else
+		simplex.Keep(i0, i1, 1.0f - t, t);
+}
+
+// closest point of triangle i0-i1-i2 to origin by Voronoi regions
+static void NP_SolveTriangle(NPSimplex& simplex, int i0, int i1, int i2)
+{
+	const Vector3D& a = simplex.verts[i0].w;
+	const Vector3D& b = simplex.verts[i1].w;
+	const Vector3D& c = simplex.verts[i2].w;
+
+	const Vector3D ab = b - a;
+	const Vector3D ac = c - a;
+	const Vector3D ap = -a;
+
+	const float d1 = dot(ab, ap);
+	const float d2 = dot(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f)
+	{
+		simplex.Keep(i0);
+		return;
+	}
+
+	const Vector3D bp = -b;
+	const float d3 = dot(ab, bp);
+	const float d4 = dot(ac, bp);
+	if (d3 >= 0.0f && d4 <= d3)
+	{
+		simplex.Keep(i1);
+		return;
+	}
+
+	const float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+	{
+		const float v = d1 / (d1 - d3);
+		simplex.Keep(i0, i1, 1.0f - v, v);
+		return;
+	}
+
+	const Vector3D cp = -c;
+	const float d5 = dot(ab, cp);
+	const float d6 = dot(ac, cp);
+	if (d6 >= 0.0f && d5 <= d6)
+	{
+		simplex.Keep(i2);
+		return;
+	}
+
+	const float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+	{
+		const float w = d2 / (d2 - d6);
+		simplex.Keep(i0, i2, 1.0f - w, w);
+		return;
+	}
+
+	const float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+	{
+		const float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		simplex.Keep(i1, i2, 1.0f - w, w);
+		return;
+	}
+
+	const float denom = va + vb + vc;
+	if (denom <= 0.0f)
+	{
+		// degenerate triangle
+		NP_SolveSegment(simplex, i0, i1);
+		return;
+	}
+
+	const float v = vb / denom;
+	const float w = vc / denom;
+	simplex.Keep(i0, i1, i2, 1.0f - v - w, v, w);
+}
+
+// returns false if origin is inside tetrahedron
+static bool NP_SolveTetrahedron(NPSimplex& simplex)
+{
+	static const int faces[4][4] = {
+		{ 0, 1, 2, 3 },
+		{ 0, 2, 3, 1 },
+		{ 0, 3, 1, 2 },
+		{ 1, 3, 2, 0 },
+	};
+
+	NPSimplex best;
+	float bestDistSqr = F_INFINITY;
+	bool outside = false;
+
+	for (int i = 0; i < 4; ++i)
+	{
+		const Vector3D& a = simplex.verts[faces[i][0]].w;
+		const Vector3D& b = simplex.verts[faces[i][1]].w;
+		const Vector3D& c = simplex.verts[faces[i][2]].w;
+		const Vector3D& d = simplex.verts[faces[i][3]].w;
+
+		const Vector3D n = cross(b - a, c - a);
+		const float signOrigin = dot(-a, n);
+		const float signOpposite = dot(d - a, n);
+
+		// origin is on the same side as opposite vertex
+		if (signOrigin * signOpposite >= 0.0f)
+			continue;
+
+		outside = true;
+
+		NPSimplex faceSimplex = simplex;
+		NP_SolveTriangle(faceSimplex, faces[i][0], faces[i][1], faces[i][2]);
+
+		const float distSqr = lengthSqr(faceSimplex.ClosestPoint());
+		if (distSqr < bestDistSqr)
+		{
+			bestDistSqr = distSqr;
+			best = faceSimplex;
+		}
+	}
+
+	if (!outside)
+		return false;
+
+	simplex = best;
+	return true;
+}
+
+// closest points of shape cores, false when cores overlap
+static bool NP_GJK(const eqNarrowPhaseShape& shapeA, const eqNarrowPhaseShape& shapeB, Vector3D& outPointA, Vector3D& outPointB)
+{
+	NPSimplex simplex;
+
+	{
+		NPSimplexVertex& vert = simplex.verts[0];
+		vert.a = NP_Support(shapeA, vec3_right);
+		vert.b = NP_Support(shapeB, -vec3_right);
+		vert.w = vert.a - vert.b;
+		simplex.weights[0] = 1.0f;
+		simplex.count = 1;
+	}
+
+	Vector3D v = simplex.verts[0].w;
+
+	for (int iter = 0; iter < NARROWPHASE_GJK_MAX_ITERATIONS; ++iter)
+	{
+		const float vLenSqr = lengthSqr(v);
+		if (vLenSqr < NARROWPHASE_GJK_TOLERANCE * NARROWPHASE_GJK_TOLERANCE)
+			return false;
+
+		NPSimplexVertex vert;
+		vert.a = NP_Support(shapeA, -v);
+		vert.b = NP_Support(shapeB, v);
+		vert.w = vert.a - vert.b;
+
+		// no more progress towards origin
+		if (vLenSqr - dot(v, vert.w) <= NARROWPHASE_GJK_TOLERANCE * vLenSqr)
+			break;
+
+		bool duplicate = false;
+		for (int i = 0; i < simplex.count && !duplicate; ++i)
+			duplicate = lengthSqr(simplex.verts[i].w - vert.w) < NARROWPHASE_GJK_TOLERANCE * vLenSqr;
+
+		if (duplicate)
+			break;
+
+		simplex.verts[simplex.count++] = vert;
+
+		switch (simplex.count)
+		{
+			case 2:
+				NP_SolveSegment(simplex, 0, 1);
+				break;
+			case 3:
+				NP_SolveTriangle(simplex, 0, 1, 2);
+				break;
+			case 4:
+				if (!NP_SolveTetrahedron(simplex))
+					return false;
+				break;
+		}
+
+		const Vector3D newV = simplex.ClosestPoint();
+
+		// numerical stall
+		if (lengthSqr(newV) >= vLenSqr)
+			break;
+
+		v = newV;
+	}
+
+	outPointA = vec3_zero;
+	outPointB = vec3_zero;
+	for (int i = 0; i < simplex.count; ++i)
+	{
+		outPointA += simplex.verts[i].a * simplex.weights[i];
+		outPointB += simplex.verts[i].b * simplex.weights[i];
+	}
+
+	return lengthSqr(outPointA - outPointB) > NARROWPHASE_GJK_TOLERANCE * NARROWPHASE_GJK_TOLERANCE;
+}
+
+//----------------------------------------------------------------------------------------------
+// Contact generation
+
+// polyhedron or triangle pair
+static void NP_CollidePolytopes(const eqNarrowPhaseShape& shapeA, const eqNarrowPhaseShape& shapeB, NPContactList& out)
+{
+	NPSatAxis axis;
+	ENPAxisType axisType;
+	const bool boxes = shapeA.halfExtents.x > 0.0f && shapeB.halfExtents.x > 0.0f;
+	if (!(boxes ? NP_FindBoxPenetrationAxis(shapeA, shapeB, axis, axisType) : NP_FindPenetrationAxis(shapeA, shapeB, axis, axisType)))
+		return;
+
+	const Vector3D& normal = axis.normal;
+
+	if (axisType == NP_AXIS_EDGES)
+	{
+		// closest points of lines going through deepest vertices along the edges
+		const Vector3D edgeA = normalize(NP_EdgeDir(shapeA, axis.edgeA));
+		const Vector3D edgeB = normalize(NP_EdgeDir(shapeB, axis.edgeB));
+		const Vector3D pointA = NP_Support(shapeA, -normal);
+		const Vector3D pointB = NP_Support(shapeB, normal);
+
+		const Vector3D r = pointA - pointB;
+		const float b = dot(edgeA, edgeB);
+		const float c = dot(edgeA, r);
+		const float f = dot(edgeB, r);
+		const float denom = 1.0f - b * b;
+
+		float s = 0.0f;
+		float t = f;
+		if (denom > NARROWPHASE_AXIS_EPSILON)
+		{
+			s = (b * f - c) / denom;
+			t = (f - b * c) / denom;
+		}
+
+		const Vector3D closestA = pointA + edgeA * s;
+		const Vector3D closestB = pointB + edgeB * t;
+		out.Add(closestA, normal, dot(closestA - closestB, normal), true);
+		return;
+	}
+
+	// clip incident face against side planes of reference face
+	const bool referenceIsA = (axisType == NP_AXIS_FACE_A);
+	const eqNarrowPhaseShape& reference = referenceIsA ? shapeA : shapeB;
+	const eqNarrowPhaseShape& incident = referenceIsA ? shapeB : shapeA;
+	const Vector3D referenceDir = referenceIsA ? -normal : normal;
+
+	NPPolygon referencePoly;
+	NPPolygon clipped[2];
+	Vector3D referenceNormal;
+	Vector3D incidentNormal;
+	NP_GetFacePolygon(reference, referenceDir, referencePoly, referenceNormal);
+	NP_GetFacePolygon(incident, -referenceDir, clipped[0], incidentNormal);
+
+	Vector3D referenceCenter = vec3_zero;
+	for (const Vector3D& v : referencePoly)
+		referenceCenter += v;
+	referenceCenter /= static_cast<float>(referencePoly.numElem());
+
+	int current = 0;
+	for (int i = 0; i < referencePoly.numElem() && clipped[current].numElem(); ++i)
+	{
+		const Vector3D& p = referencePoly[i];
+		const Vector3D& q = referencePoly[(i + 1) % referencePoly.numElem()];
+
+		Vector3D sideNormal = cross(q - p, referenceNormal);
+		if (dot(sideNormal, referenceCenter - p) > 0.0f)
+			sideNormal = -sideNormal;
+
+		NP_ClipPolygon(clipped[current], clipped[1 - current], sideNormal, dot(sideNormal, p));
+		current = 1 - current;
+	}
+
+	const int firstContact = out.numContacts;
+	const float referenceDist = dot(referenceNormal, referencePoly[0]);
+	for (const Vector3D& v : clipped[current])
+	{
+		const float separation = dot(referenceNormal, v) - referenceDist;
+		if (separation > 0.0f)
+			continue;
+
+		// incident points lie on B when reference face is on A
+		out.Add(v, referenceNormal, separation, !referenceIsA);
+	}
+
+	const int numAdded = out.numContacts - firstContact;
+	if (numAdded > NARROWPHASE_MAX_FACE_CONTACTS)
+		out.numContacts = firstContact + NarrowPhase_ReduceContacts(out.contacts + firstContact, numAdded);
+}
+
+// capsule segment clipped by face of polytope which normal is nearly parallel to contact normal
+static bool NP_CapsuleFaceContacts(const eqNarrowPhaseShape& capsule, const eqNarrowPhaseShape& polytope, const Vector3D& normalPR, NPContactList& out, bool capsuleIsA)
+{
+	NPPolygon facePoly;
+	Vector3D faceNormal;
+	NP_GetFacePolygon(polytope, normalPR, facePoly, faceNormal);
+
+	if (dot(faceNormal, normalPR) < NARROWPHASE_FACE_TOLERANCE)
+		return false;
+
+	Vector3D faceCenter = vec3_zero;
+	for (const Vector3D& v : facePoly)
+		faceCenter += v;
+	faceCenter /= static_cast<float>(facePoly.numElem());
+
+	float t0 = 0.0f;
+	float t1 = 1.0f;
+	const Vector3D& segStart = capsule.points[0];
+	const Vector3D segDir = capsule.points[1] - capsule.points[0];
+
+	for (int i = 0; i < facePoly.numElem(); ++i)
+	{
+		const Vector3D& p = facePoly[i];
+		const Vector3D& q = facePoly[(i + 1) % facePoly.numElem()];
+
+		Vector3D sideNormal = cross(q - p, faceNormal);
+		if (dot(sideNormal, faceCenter - p) > 0.0f)
+			sideNormal = -sideNormal;
+
+		const float startDist = dot(sideNormal, segStart - p);
+		const float dirDist = dot(sideNormal, segDir);
+
+		if (fabs(dirDist) < F_EPS)
+		{
+			if (startDist > 0.0f)
+				return false;
+			continue;
+		}
+
+		const float t = -startDist / dirDist;
+		if (dirDist > 0.0f)
+			t1 = min(t1, t);
+		else
+			t0 = max(t0, t);
+	}
+
+	if (t0 > t1)
+		return false;
+
+	const float faceDist = dot(faceNormal, facePoly[0]);
+	const int firstContact = out.numContacts;
+	for (int i = 0; i < 2; ++i)
+	{
+		const Vector3D core = segStart + segDir * (i ? t1 : t0);
+		const Vector3D pointOnCapsule = core - faceNormal * capsule.radius;
+		const float separation = dot(faceNormal, pointOnCapsule) - faceDist;
+		if (separation > 0.0f)
+			continue;
+
+		out.Add(pointOnCapsule, faceNormal, separation, capsuleIsA);
+
+		if (t1 - t0 < F_EPS)
+			break;
+	}
+
+	return out.numContacts > firstContact;
+}
+
+// sphere or capsule against polyhedron or triangle
+static void NP_CollideRoundedPolytope(const eqNarrowPhaseShape& rounded, const eqNarrowPhaseShape& polytope, NPContactList& out, bool roundedIsA)
+{
+	Vector3D closestR, closestP;
+	if (NP_GJK(rounded, polytope, closestR, closestP))
+	{
+		const Vector3D delta = closestR - closestP;
+		const float dist = length(delta);
+		if (dist >= rounded.radius)
+			return;
+
+		const Vector3D normalPR = delta / dist;
+		if (rounded.type == NARROWPHASE_SHAPE_CAPSULE && NP_CapsuleFaceContacts(rounded, polytope, normalPR, out, roundedIsA))
+			return;
+
+		out.Add(closestR - normalPR * rounded.radius, normalPR, dist - rounded.radius, roundedIsA);
+		return;
+	}
+
+	// cores overlap, find minimal penetration by SAT
+	NPSatAxis axis;
+	ENPAxisType axisType;
+	if (!NP_FindPenetrationAxis(rounded, polytope, axis, axisType))
+		return;
+
+	// axis is oriented from polytope to rounded shape
+	const Vector3D& normalPR = axis.normal;
+	if (rounded.type == NARROWPHASE_SHAPE_CAPSULE && NP_CapsuleFaceContacts(rounded, polytope, normalPR, out, roundedIsA))
+		return;
+
+	float minP, maxP;
+	NP_Project(polytope, normalPR, minP, maxP);
+
+	const int firstContact = out.numContacts;
+	const int numCorePoints = rounded.type == NARROWPHASE_SHAPE_CAPSULE ? 2 : 1;
+	for (int i = 0; i < numCorePoints; ++i)
+	{
+		const Vector3D pointOnRounded = rounded.points[i] - normalPR * rounded.radius;
+		const float separation = dot(pointOnRounded, normalPR) - maxP;
+		if (separation <= 0.0f || (i == numCorePoints - 1 && out.numContacts == firstContact))
+			out.Add(pointOnRounded, normalPR, min(separation, 0.0f), roundedIsA);
+	}
+}
+
+// closest points of segments p1-q1 and p2-q2, segments may be degenerate
+static void NP_ClosestPointsSegments(const Vector3D& p1, const Vector3D& q1, const Vector3D& p2, const Vector3D& q2, Vector3D& outC1, Vector3D& outC2)
+{
+	const Vector3D d1 = q1 - p1;
+	const Vector3D d2 = q2 - p2;
+	const Vector3D r = p1 - p2;
+	const float a = dot(d1, d1);
+	const float e = dot(d2, d2);
+	const float f = dot(d2, r);
+
+	float s = 0.0f;
+	float t = 0.0f;
+
+	if (a <= F_EPS && e <= F_EPS)
+	{
+		outC1 = p1;
+		outC2 = p2;
+		return;
+	}
+
+	if (a <= F_EPS)
+	{
+		t = clamp(f / e, 0.0f, 1.0f);
+	}
+	else
+	{
+		const float c = dot(d1, r);
+		if (e <= F_EPS)
+		{
+			s = clamp(-c / a, 0.0f, 1.0f);
+		}
+		else
+		{
+			const float b = dot(d1, d2);
+			const float denom = a * e - b * b;
+
+			if (denom > F_EPS)
+				s = clamp((b * f - c * e) / denom, 0.0f, 1.0f);
+
+			t = (b * s + f) / e;
+			if (t < 0.0f)
+			{
+				t = 0.0f;
+				s = clamp(-c / a, 0.0f, 1.0f);
+			}
+			else if (t > 1.0f)
+			{
+				t = 1.0f;
+				s = clamp((b - c) / a, 0.0f, 1.0f);
+			}
+		}
+	}
+
+	outC1 = p1 + d1 * s;
+	outC2 = p2 + d2 * t;
+}
+
+// spheres and capsules
+static void NP_CollideRounded(const eqNarrowPhaseShape& shapeA, const eqNarrowPhaseShape& shapeB, NPContactList& out)
+{
+	const int lastA = shapeA.type == NARROWPHASE_SHAPE_CAPSULE ? 1 : 0;
+	const int lastB = shapeB.type == NARROWPHASE_SHAPE_CAPSULE ? 1 : 0;
+
+	Vector3D closestA, closestB;
+	NP_ClosestPointsSegments(shapeA.points[0], shapeA.points[lastA], shapeB.points[0], shapeB.points[lastB], closestA, closestB);
+
+	const float radius = shapeA.radius + shapeB.radius;
+	const Vector3D delta = closestA - closestB;
+	const float distSqr = lengthSqr(delta);
+	if (distSqr >= radius * radius)
+		return;
+
+	const float dist = sqrtf(distSqr);
+
+	Vector3D normal = vec3_up;
+	if (dist > F_EPS)
+	{
+		normal = delta / dist;
+	}
+	else if (lastA)
+	{
+		// any direction perpendicular to capsule
+		const Vector3D axisA = shapeA.points[1] - shapeA.points[0];
+		normal = cross(axisA, fabs(axisA.y) < fabs(axisA.x) ? vec3_up : vec3_right);
+		normal = normalize(normal);
+	}
+
+	out.Add(closestA - normal * shapeA.radius, normal, dist - radius, true);
+}
+
+//----------------------------------------------------------------------------------------------
+
+bool eqNarrowPhaseShape::Init(const btCollisionShape* shape, const Matrix3x3& shapeRotation, const Vector3D& shapePosition)
+{
+	rotation = shapeRotation;
+	position = shapePosition;
+	polyhedron = nullptr;
+	halfExtents = vec3_zero;
+	radius = 0.0f;
+	type = NARROWPHASE_SHAPE_NONE;
+
+	switch (shape->getShapeType())
+	{
+		case SPHERE_SHAPE_PROXYTYPE:
+		{
+			const btSphereShape* sphere = static_cast<const btSphereShape*>(shape);
+			type = NARROWPHASE_SHAPE_SPHERE;
+			radius = sphere->getRadius();
+			points[0] = position;
+			return true;
+		}
+		case CAPSULE_SHAPE_PROXYTYPE:
+		{
+			const btCapsuleShape* capsule = static_cast<const btCapsuleShape*>(shape);
+			const int upAxis = capsule->getUpAxis();
+			const Vector3D axis = Vector3D(rotation.rows[0][upAxis], rotation.rows[1][upAxis], rotation.rows[2][upAxis]) * capsule->getHalfHeight();
+
+			type = NARROWPHASE_SHAPE_CAPSULE;
+			radius = capsule->getRadius();
+			points[0] = position - axis;
+			points[1] = position + axis;
+			return true;
+		}
+		case BOX_SHAPE_PROXYTYPE:
+		case CONVEX_HULL_SHAPE_PROXYTYPE:
+		{
+			// margin is ignored as Bullet does in polyhedral contact clipping
+			polyhedron = static_cast<const btPolyhedralConvexShape*>(shape)->getConvexPolyhedron();
+			if (!polyhedron)
+				return false;
+
+			if (shape->getShapeType() == BOX_SHAPE_PROXYTYPE)
+			{
+				const btVector3& extents = static_cast<const btBoxShape*>(shape)->getHalfExtentsWithMargin();
+				halfExtents = Vector3D(extents.x(), extents.y(), extents.z());
+			}
+
+			type = NARROWPHASE_SHAPE_POLYHEDRON;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void eqNarrowPhaseShape::InitTriangle(const Vector3D& v0, const Vector3D& v1, const Vector3D& v2)
+{
+	type = NARROWPHASE_SHAPE_TRIANGLE;
+	polyhedron = nullptr;
+	halfExtents = vec3_zero;
+	radius = 0.0f;
+	points[0] = v0;
+	points[1] = v1;
+	points[2] = v2;
+	position = (v0 + v1 + v2) * (1.0f / 3.0f);
+}
+
+bool NarrowPhase_IsSupportedConvex(const btCollisionShape* shape)
+{
+	switch (shape->getShapeType())
+	{
+		case SPHERE_SHAPE_PROXYTYPE:
+		case CAPSULE_SHAPE_PROXYTYPE:
+			return true;
+		case BOX_SHAPE_PROXYTYPE:
+		case CONVEX_HULL_SHAPE_PROXYTYPE:
+			return static_cast<const btPolyhedralConvexShape*>(shape)->getConvexPolyhedron() != nullptr;
+	}
+	return false;
+}
+
+bool NarrowPhase_IsSupportedMesh(const btCollisionShape* shape)
+{
+	return shape->getShapeType() == TRIANGLE_MESH_SHAPE_PROXYTYPE;
+}
+
+int NarrowPhase_Collide(const eqNarrowPhaseShape& shapeA, const eqNarrowPhaseShape& shapeB, eqNarrowPhaseContact* contacts, int maxContacts)
+{
+	NPContactList out{ contacts, 0, maxContacts };
+
+	const bool roundedA = NP_IsRounded(shapeA);
+	const bool roundedB = NP_IsRounded(shapeB);
+
+	if (roundedA && roundedB)
+		NP_CollideRounded(shapeA, shapeB, out);
+	else if (roundedA)
+		NP_CollideRoundedPolytope(shapeA, shapeB, out, true);
+	else if (roundedB)
+		NP_CollideRoundedPolytope(shapeB, shapeA, out, false);
+	else
+		NP_CollidePolytopes(shapeA, shapeB, out);
+
+	return out.numContacts;
+}
+
+//----------------------------------------------------------------------------------------------
+
+// BVH of mesh gives triangles intersecting bounds of convex shape
+class CNarrowPhaseTriangleCallback : public btTriangleCallback
+{
+public:
+	CNarrowPhaseTriangleCallback(const eqNarrowPhaseShape& convex, const Matrix3x3& meshRotation, const Vector3D& meshPosition, const btTriangleInfoMap* trimap, eqNarrowPhaseContact* contacts, int maxContacts)
+		: m_convex(convex)
+		, m_meshRotation(meshRotation)
+		, m_meshPosition(meshPosition)
+		, m_trimap(trimap)
+		, m_contacts(contacts)
+		, m_maxContacts(maxContacts)
+	{
+	}
+
+	void processTriangle(btVector3* triangle, int partId, int triangleIndex) override
+	{
+		if (m_numContacts >= m_maxContacts)
+			return;
+
+		Vector3D verts[3];
+		for (int i = 0; i < 3; ++i)
+			verts[i] = m_meshRotation * Vector3D(triangle[i].m_floats[0], triangle[i].m_floats[1], triangle[i].m_floats[2]) + m_meshPosition;
+
+		const Vector3D triNormal = cross(verts[1] - verts[0], verts[2] - verts[0]);
+		const float triNormalLenSqr = lengthSqr(triNormal);
+		if (triNormalLenSqr < F_EPS * F_EPS)
+			return;
+
+		eqNarrowPhaseShape triShape;
+		triShape.InitTriangle(verts[0], verts[1], verts[2]);
+
+		eqNarrowPhaseContact* contacts = m_contacts + m_numContacts;
+		const int numContacts = NarrowPhase_Collide(m_convex, triShape, contacts, m_maxContacts - m_numContacts);
+		if (!numContacts)
+			return;
+
+		const bool singleSided = m_trimap && m_trimap->find(NP_TriangleHash(partId, triangleIndex));
+		for (int i = 0; i < numContacts; ++i)
+		{
+			contacts[i].partId = partId;
+			contacts[i].triangleIndex = triangleIndex;
+
+			if (singleSided)
+				contacts[i].normal = triNormal / sqrtf(triNormalLenSqr);
+		}
+
+		m_numContacts += numContacts;
+	}
+
+	int							m_numContacts{ 0 };
+
+protected:
+	const eqNarrowPhaseShape&	m_convex;
+	const Matrix3x3&			m_meshRotation;
+	const Vector3D&				m_meshPosition;
+	const btTriangleInfoMap*	m_trimap;
+	eqNarrowPhaseContact*		m_contacts;
+	int							m_maxContacts;
+};
+
+int NarrowPhase_CollideMesh(const eqNarrowPhaseShape& convex, const btCollisionShape* meshShape, const Matrix3x3& meshRotation, const Vector3D& meshPosition,
+							const btTriangleInfoMap* trimap, eqNarrowPhaseContact* contacts, int maxContacts)
+{
+	ASSERT(NarrowPhase_IsSupportedMesh(meshShape));
+
+	// convex bounds in mesh space
+	btVector3 aabbMin, aabbMax;
+	for (int i = 0; i < 3; ++i)
+	{
+		const Vector3D meshAxis(meshRotation.rows[0][i], meshRotation.rows[1][i], meshRotation.rows[2][i]);
+		const float offset = dot(meshPosition, meshAxis);
+
+		float axisMin, axisMax;
+		NP_Project(convex, meshAxis, axisMin, axisMax);
+		aabbMin[i] = axisMin - offset - NARROWPHASE_MESH_AABB_EXPAND;
+		aabbMax[i] = axisMax - offset + NARROWPHASE_MESH_AABB_EXPAND;
+	}
+
+	CNarrowPhaseTriangleCallback callback(convex, meshRotation, meshPosition, trimap, contacts, maxContacts);
+	static_cast<const btBvhTriangleMeshShape*>(meshShape)->processAllTriangles(&callback, aabbMin, aabbMax);
+
+	return callback.m_numContacts;
+}
+
+int NarrowPhase_ReduceContacts(eqNarrowPhaseContact* contacts, int numContacts)
+{
+	if (numContacts <= NARROWPHASE_MAX_FACE_CONTACTS)
+		return numContacts;
+
+	int selected[NARROWPHASE_MAX_FACE_CONTACTS];
+
+	// deepest
+	selected[0] = 0;
+	for (int i = 1; i < numContacts; ++i)
+	{
+		if (contacts[i].distance < contacts[selected[0]].distance)
+			selected[0] = i;
+	}
+	const Vector3D p0 = contacts[selected[0]].position;
+
+	// farthest from deepest
+	float best = -1.0f;
+	for (int i = 0; i < numContacts; ++i)
+	{
+		const float distSqr = lengthSqr(contacts[i].position - p0);
+		if (distSqr > best)
+		{
+			best = distSqr;
+			selected[1] = i;
+		}
+	}
+	const Vector3D p1 = contacts[selected[1]].position;
+
+	// largest triangle
+	best = -1.0f;
+	for (int i = 0; i < numContacts; ++i)
+	{
+		const float areaSqr = lengthSqr(cross(p1 - p0, contacts[i].position - p0));
+		if (areaSqr > best)
+		{
+			best = areaSqr;
+			selected[2] = i;
+		}
+	}
+	const Vector3D p2 = contacts[selected[2]].position;
+
+	// point adding most area outside of triangle
+	best = -1.0f;
+	for (int i = 0; i < numContacts; ++i)
+	{
+		const Vector3D& p = contacts[i].position;
+		const float area = length(cross(p0 - p, p1 - p)) + length(cross(p1 - p, p2 - p)) + length(cross(p2 - p, p0 - p));
+		if (area > best)
+		{
+			best = area;
+			selected[3] = i;
+		}
+	}
+
+	eqNarrowPhaseContact reduced[NARROWPHASE_MAX_FACE_CONTACTS];
+	int numReduced = 0;
+	for (int i = 0; i < NARROWPHASE_MAX_FACE_CONTACTS; ++i)
+	{
+		bool duplicate = false;
+		for (int j = 0; j < i && !duplicate; ++j)
+			duplicate = selected[j] == selected[i];
+
+		if (!duplicate)
+			reduced[numReduced++] = contacts[selected[i]];
+	}
+
+	for (int i = 0; i < numReduced; ++i)
+		contacts[i] = reduced[i];
+
+	return numReduced;
+}
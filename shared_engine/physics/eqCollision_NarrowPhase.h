@@ -0,0 +1,64 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2020
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Native narrow phase for common convex shape pairs
+//				Box, convex hull, sphere and capsule against each other and triangles
+//				Everything else is handled by Bullet collision algorithms
+//////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+class btCollisionShape;
+class btConvexPolyhedron;
+struct btTriangleInfoMap;
+
+static constexpr const int NARROWPHASE_MAX_FACE_CONTACTS = 4;	// contacts left after reduction
+
+enum ENarrowPhaseShapeType : int
+{
+	NARROWPHASE_SHAPE_NONE = 0,
+	NARROWPHASE_SHAPE_SPHERE,			// point with radius
+	NARROWPHASE_SHAPE_CAPSULE,			// segment with radius
+	NARROWPHASE_SHAPE_POLYHEDRON,		// box or convex hull with polyhedral features
+	NARROWPHASE_SHAPE_TRIANGLE,
+};
+
+// same layout of results as Bullet provides to btManifoldResult
+struct eqNarrowPhaseContact
+{
+	Vector3D	position;					// point on shape A
+	Vector3D	normal;						// points from shape B to shape A
+	float		distance{ 0.0f };			// negative when penetrating
+	int			partId{ -1 };				// triangle mesh subpart
+	int			triangleIndex{ -1 };
+};
+
+// convex shape placed in world space
+struct eqNarrowPhaseShape
+{
+	bool						Init(const btCollisionShape* shape, const Matrix3x3& rotation, const Vector3D& position);
+	void						InitTriangle(const Vector3D& v0, const Vector3D& v1, const Vector3D& v2);
+
+	Matrix3x3					rotation{ identity3 };
+	Vector3D					position{ vec3_zero };
+	Vector3D					points[3];						// sphere center, capsule segment or triangle vertices
+	const btConvexPolyhedron*	polyhedron{ nullptr };
+	Vector3D					halfExtents{ vec3_zero };		// box is projected without iterating polyhedron vertices
+	float						radius{ 0.0f };
+	ENarrowPhaseShapeType		type{ NARROWPHASE_SHAPE_NONE };
+};
+
+bool	NarrowPhase_IsSupportedConvex(const btCollisionShape* shape);
+bool	NarrowPhase_IsSupportedMesh(const btCollisionShape* shape);
+
+// collides two convex shapes, returns number of penetrating contacts written
+int		NarrowPhase_Collide(const eqNarrowPhaseShape& shapeA, const eqNarrowPhaseShape& shapeB, eqNarrowPhaseContact* contacts, int maxContacts);
+
+// collides convex shape (A) with static triangle mesh (B)
+// triangles found in trimap are single sided and give their normal to contacts, as AdjustSingleSidedContact does
+int		NarrowPhase_CollideMesh(const eqNarrowPhaseShape& convex, const btCollisionShape* meshShape, const Matrix3x3& meshRotation, const Vector3D& meshPosition,
+								const btTriangleInfoMap* trimap, eqNarrowPhaseContact* contacts, int maxContacts);
+
+// keeps deepest contact and ones that span the largest area
+int		NarrowPhase_ReduceContacts(eqNarrowPhaseContact* contacts, int numContacts);
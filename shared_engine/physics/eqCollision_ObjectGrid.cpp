@@ -194,11 +194,22 @@ eqPhysGridCell*	CEqCollisionBroadphaseGrid::GetAllocCellAt(int x, int y)
 	auto it = m_gridMap.find(cellIdx);
 
 	if(it.atEnd())
+	{
 		it = m_gridMap.insert(cellIdx);
+		(*it).index = cellIdx;
+	}
 
 	return &(*it);
 }
 
+eqPhysGridCell* CEqCollisionBroadphaseGrid::GetPreallocatedCellByIndex(int cellIdx)
+{
+	if (cellIdx < 0)
+		return nullptr;
+
+	return GetAllocCellAt(cellIdx % m_gridWide, cellIdx / m_gridWide);
+}
+
 void CEqCollisionBroadphaseGrid::FreeCellAt( int x, int y )
 {
 	const int gridWide = m_gridWide;
@@ -18,6 +18,7 @@ struct eqPhysGridCell
 	StaticCollObjList	gridObjects{ PP_SL };
 	DynCollObjList		dynamicObjList;
 	float				cellBoundUsed = 0.0f;	// unsigned z of usage by static objects
+	int					index = -1;				// y * gridWide + x
 };
 
 class CEqCollisionBroadphaseGrid
@@ -27,6 +28,7 @@ public:
 	~CEqCollisionBroadphaseGrid();
 
 	eqPhysGridCell*		GetPreallocatedCellAtPos(const Vector3D& origin);
+	eqPhysGridCell*		GetPreallocatedCellByIndex(int cellIdx);
 
 	eqPhysGridCell*		GetCellAtPos(const Vector3D& origin) const;
 	eqPhysGridCell*		GetCellAt(int x, int y) const;
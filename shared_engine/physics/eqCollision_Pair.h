@@ -8,6 +8,9 @@
 #pragma once
 
 class CEqCollisionObject;
+struct eqContactManifold;
+
+static constexpr const int EQPHYS_MANIFOLD_MAX_POINTS = 8;
 
 enum ECollPairFlag
 {
@@ -60,6 +63,40 @@ struct eqContactPair
 	float				depth;
 
 	int					flags;
+
+	eqContactManifold*	manifold{ nullptr };	// persistent manifold of the pair
+	int					manifoldPoint{ -1 };
+
+	float				warmImpulse{ 0.0f };	// normal impulse from previous step
+	float				accumImpulse{ 0.0f };	// normal impulse of this step, stored back to manifold
+};
+
+// contact point that persists between steps
+struct eqManifoldPoint
+{
+	Vector3D			localPosA;				// contact position in object A space
+	Vector3D			localPosB;				// contact position in object B space
+	Vector3D			localNormal;			// normal in object A space
+	float				depth;
+	float				restitutionA;			// surface parameters of static object
+	float				frictionA;
+	float				impulse;				// accumulated normal impulse
+	int					feature;				// triangle hash or -1
+};
+
+// persistent contact manifold of object pair
+struct eqContactManifold
+{
+	CEqCollisionObject*	bodyA{ nullptr };
+	CEqCollisionObject*	bodyB{ nullptr };
+
+	Vector3D			relPosition{ vec3_zero };		// B position in A space at the time of narrow phase
+	Quaternion			relOrientation{ qidentity };
+
+	FixedArray<eqManifoldPoint, EQPHYS_MANIFOLD_MAX_POINTS>	points;
+
+	int					lastStep{ 0 };
+	int					flags{ 0 };
 };
 
 struct eqCollisionPairData
@@ -28,6 +28,7 @@
 
 #include "eqPhysics.h"
 #include "eqCollision_Callback.h"
+#include "eqCollision_NarrowPhase.h"
 #include "eqCollision_ObjectGrid.h"
 #include "eqPhysics_Body.h"
 #include "eqPhysics_Contstraint.h"
@@ -50,6 +51,12 @@ DECLARE_CVAR_F(ph_margin);
 DECLARE_CVAR(ph_showcontacts, "0", nullptr, CV_CHEAT);
 DECLARE_CVAR(ph_erp, "0.15", "Collision correction", CV_CHEAT);
 DECLARE_CVAR(ph_carVsCarErp, "0.15", "Car versus car erp", CV_CHEAT);
+DECLARE_CVAR(ph_nativeNarrowPhase, "1", "Use native narrow phase for box, convex hull, sphere and capsule shapes", CV_CHEAT);
+DECLARE_CVAR(ph_contactCache, "1", "Keep contact manifolds between steps and skip narrow phase of resting pairs", CV_CHEAT);
+DECLARE_CVAR(ph_warmStarting, "1", "Factor of contact impulse from previous step applied before contact response", CV_CHEAT);
+DECLARE_CVAR(ph_islandSleeping, "1", "Freeze resting islands together and remove them from simulation", CV_CHEAT);
+DECLARE_CVAR(ph_parallelIslands, "0", "Solve islands on job threads, body callbacks must be thread safe", CV_CHEAT);
+DECLARE_CVAR(ph_parallelIslandsMinContacts, "64", "Minimal contacts solved by a single job", CV_CHEAT);
 
 CEqCollisionObject* eqContactPair::GetOppositeTo(CEqCollisionObject* obj) const
 {
@@ -117,11 +124,72 @@ static void AdjustSingleSidedContact(btManifoldPoint& cp, const btCollisionObjec
 const float CONTACT_GROUPING_POSITION_TOLERANCE		= 0.05f;		// distance
 const float CONTACT_GROUPING_NORMAL_TOLERANCE		= 0.85f;		// cosine
 
+const float CONTACT_CACHE_POSITION_TOLERANCE		= 0.005f;		// relative movement distance to run narrow phase again
+const float CONTACT_CACHE_ROTATION_TOLERANCE		= 0.00001f;		// 1 - quaternion dot
+const float CONTACT_MATCH_TOLERANCE					= 0.1f;			// distance of contact on object B to inherit the impulse
+const int	CONTACT_MANIFOLD_KEEP_STEPS				= 4;
+
+// collisions of object pair from either Bullet or native narrow phase
+struct CEqPairCollisions
+{
+	CEqPairCollisions(const Vector3D& center)
+		: m_center(center)
+	{
+	}
+
+	void Add(const Vector3D& positionOnA, const Vector3D& normal, float distance, int materialIndex, int feature)
+	{
+		// if something is a NaN we have to deny it
+		if (V3IsNaN(positionOnA) || V3IsNaN(normal))
+			return;
+
+		const Vector3D position = positionOnA - m_center;
+
+#ifdef ENABLE_CONTACT_GROUPING		
+		for(eqCollisionInfo& coll : m_collisions)
+		{
+			if(	coll.materialIndex == materialIndex &&
+				fsimilar(coll.position.x, position.x, CONTACT_GROUPING_POSITION_TOLERANCE) &&
+				fsimilar(coll.position.y, position.y, CONTACT_GROUPING_POSITION_TOLERANCE) &&
+				fsimilar(coll.position.z, position.z, CONTACT_GROUPING_POSITION_TOLERANCE))
+				//dot(coll.normal, normal) > CONTACT_GROUPING_NORMAL_TOLERANCE)
+			{
+				coll.position += position;
+				coll.normal += normal;
+				coll.fract += distance;
+				
+				coll.position *= 0.5f;
+				coll.normal *= 0.5f;
+				coll.fract *= 0.5f;
+				
+				return;
+			}
+		}
+#endif // ENABLE_CONTACT_GROUPING
+
+		if (m_collisions.numElem() >= m_collisions.numAllocated())
+			return;
+		
+		eqCollisionInfo& data = m_collisions.append();
+		data.normal = normal;
+		data.position = position;
+		data.materialIndex = materialIndex;
+		data.fract = distance;
+		data.pad = 1;
+
+		m_features.append(feature);
+	}
+
+	FixedArray<eqCollisionInfo, 64>	m_collisions;
+	FixedArray<int, 64>				m_features;		// triangle of each collision
+	Vector3D						m_center;
+};
+
 struct CEqManifoldResult : public btManifoldResult
 {
-	CEqManifoldResult(const btCollisionObjectWrapper* obj0Wrap, const btCollisionObjectWrapper* obj1Wrap, bool singleSided, const Vector3D& center)
+	CEqManifoldResult(const btCollisionObjectWrapper* obj0Wrap, const btCollisionObjectWrapper* obj1Wrap, bool singleSided, CEqPairCollisions& results)
 		: btManifoldResult(obj0Wrap, obj1Wrap)
-		, m_center(center)
+		, m_results(results)
 		, m_singleSided(singleSided)
 	{
 		m_closestPointDistanceThreshold = 0.0f;
@@ -180,14 +248,8 @@ struct CEqManifoldResult : public btManifoldResult
 		else
 			btAdjustInternalEdgeContacts(cp, colObj1Wrap, colObj0Wrap, cp.m_partId1, cp.m_index1);
 
-		// if something is a NaN we have to deny it
-		if (cp.m_positionWorldOnA != cp.m_positionWorldOnA || 
-			cp.m_normalWorldOnB != cp.m_normalWorldOnB)
-			return;
-
 		Vector3D position;
 		ConvertBulletToDKVectors(position, cp.m_positionWorldOnA);
-		position -= m_center;
 		
 		Vector3D normal;
 		ConvertBulletToDKVectors(normal, cp.m_normalWorldOnB);
@@ -205,56 +267,111 @@ struct CEqManifoldResult : public btManifoldResult
 			}
 		}
 
-		const float distance = cp.getDistance();
+		const int feature = (shape1->getShapeType() == TRIANGLE_SHAPE_PROXYTYPE) ? btInternalGetHash(cp.m_partId1, cp.m_index1) : -1;
+		m_results.Add(position, normal, cp.getDistance(), materialIndex, feature);
+	}
 
-#ifdef ENABLE_CONTACT_GROUPING		
-		for(eqCollisionInfo& coll : m_collisions)
+	CEqPairCollisions&				m_results;
+	bool							m_singleSided;
+};
+
+static bool IsNativeNarrowPhaseConvex(ArrayCRef<btCollisionShape*> shapes)
+{
+	for (const btCollisionShape* shape : shapes)
+	{
+		if (!NarrowPhase_IsSupportedConvex(shape))
+			return false;
+	}
+	return true;
+}
+
+//------------------------------------------------------------------------------------------------------------
+
+// body orientations are not kept normalized and rotateVector scales by squared length
+static Quaternion ManifoldOrientation(const CEqCollisionObject* object)
+{
+	Quaternion orient = object->GetOrientation();
+	orient.normalize();
+	return orient;
+}
+
+static void ManifoldRelativeTransform(const CEqCollisionObject* bodyA, const CEqCollisionObject* bodyB, Vector3D& relPosition, Quaternion& relOrientation)
+{
+	const Quaternion invOrientA = !ManifoldOrientation(bodyA);
+	relPosition = rotateVector(Vector3D(bodyB->GetPosition() - bodyA->GetPosition()), invOrientA);
+	relOrientation = ManifoldOrientation(bodyB) * invOrientA;
+}
+
+// adds new contact to manifold and takes impulse from matching contact of previous step
+static void AddManifoldPoint(eqContactManifold& manifold, ArrayCRef<eqManifoldPoint> prevPoints, eqContactPair& pair, int feature)
+{
+	if (manifold.points.numElem() == manifold.points.numAllocated())
+		return;
+
+	const CEqCollisionObject* bodyA = manifold.bodyA;
+	const CEqCollisionObject* bodyB = manifold.bodyB;
+
+	const Quaternion invOrientA = !ManifoldOrientation(bodyA);
+
+	eqManifoldPoint& point = manifold.points.append();
+	point.localPosA = rotateVector(Vector3D(pair.position - bodyA->GetPosition()), invOrientA);
+	point.localPosB = rotateVector(Vector3D(pair.position - bodyB->GetPosition()), !ManifoldOrientation(bodyB));
+	point.localNormal = rotateVector(pair.normal, invOrientA);
+	point.depth = pair.depth;
+	point.restitutionA = pair.restitutionA;
+	point.frictionA = pair.frictionA;
+	point.impulse = 0.0f;
+	point.feature = feature;
+
+	float closestDistSqr = CONTACT_MATCH_TOLERANCE * CONTACT_MATCH_TOLERANCE;
+	for (const eqManifoldPoint& prevPoint : prevPoints)
+	{
+		if (prevPoint.feature != feature)
+			continue;
+
+		const float distSqr = distanceSqr(prevPoint.localPosB, point.localPosB);
+		if (distSqr < closestDistSqr)
 		{
-			if(	coll.materialIndex == materialIndex &&
-				fsimilar(coll.position.x, position.x, CONTACT_GROUPING_POSITION_TOLERANCE) &&
-				fsimilar(coll.position.y, position.y, CONTACT_GROUPING_POSITION_TOLERANCE) &&
-				fsimilar(coll.position.z, position.z, CONTACT_GROUPING_POSITION_TOLERANCE))
-				//dot(coll.normal, normal) > CONTACT_GROUPING_NORMAL_TOLERANCE)
-			{
-				coll.position += position;
-				coll.normal += normal;
-				coll.fract += distance;
-				
-				coll.position *= 0.5f;
-				coll.normal *= 0.5f;
-				coll.fract *= 0.5f;
-				
-				return;
-			}
+			closestDistSqr = distSqr;
+			point.impulse = prevPoint.impulse;
 		}
-#endif // ENABLE_CONTACT_GROUPING
-
-		if (m_collisions.numElem() >= m_collisions.numAllocated())
-			return;
-		
-		eqCollisionInfo& data = m_collisions.append();
-		ConvertBulletToDKVectors(data.normal, cp.m_normalWorldOnB);
-		ConvertBulletToDKVectors(position, cp.m_positionWorldOnA);
-		data.position = position - m_center;
-		data.materialIndex = materialIndex;
-		data.fract = distance;
-		data.pad = 1;
 	}
 
-	FixedArray<eqCollisionInfo, 64>	m_collisions;
-	Vector3D						m_center;
-	bool							m_singleSided;
-};
+	pair.manifold = &manifold;
+	pair.manifoldPoint = manifold.points.numElem() - 1;
+	pair.warmImpulse = point.impulse * ph_warmStarting.GetFloat();
+}
 
 //------------------------------------------------------------------------------------------------------------
 
+// solves range of islands which are not touching objects of other islands
+class CEqPhysics::CSolveIslandsJob : public IParallelJob
+{
+public:
+	CSolveIslandsJob()
+		: IParallelJob("SolvePhysicsIslands")
+	{
+		InitSignal();
+	}
+
+	void Execute() override
+	{
+		for (int islandIdx : m_islands)
+			m_physics->SolveIsland(m_physics->m_islands[islandIdx]);
+	}
+
+	CEqPhysics*		m_physics{ nullptr };
+	ArrayCRef<int>	m_islands{ nullptr };
+};
+
 CEqPhysics::CEqPhysics()
 {
 }
 
 CEqPhysics::~CEqPhysics()
 {
-
+	for (CSolveIslandsJob* job : m_solveJobs)
+		delete job;
 }
 
 void CEqPhysics::InitWorld()
@@ -311,6 +428,17 @@ void CEqPhysics::DestroyWorld()
 
 	m_ghostObjects.clear(true);
 
+	for (eqContactManifold* manifold : m_manifolds)
+		manifold->~eqContactManifold();
+	m_manifolds.clear(true);
+	m_manifoldPool.clear();
+
+	m_islands.clear(true);
+	m_islandBodies.clear(true);
+	m_wakeIslands.clear(true);
+	m_sleepingIslandPool.clear();
+	m_numSleepingBodies = 0;
+
 	// update the controllers
 	for (int i = 0; i < m_controllers.numElem(); i++)
 		m_controllers[i]->SetEnabled(false);
@@ -412,7 +540,11 @@ void CEqPhysics::RemoveFromMoveableList(CEqRigidBody* body)
 		return;
 
 	body->m_flags &= ~BODY_MOVEABLE;
-	m_moveable.fastRemove(body);
+
+	if (body->IsSleeping())
+		RemoveFromSleepingIsland(body);
+	else
+		m_moveable.fastRemove(body);
 
 	if (body->m_callbacks)
 		body->m_callbacks->OnStopMove();
@@ -452,7 +584,10 @@ bool CEqPhysics::RemoveFromWorld( CEqRigidBody* body )
 
 	const bool result = m_dynObjects.fastRemove(body);
 	if (result)
+	{
 		RemoveFromMoveableList(body);
+		RemoveObjectManifolds(body);
+	}
 
 	return result;
 }
@@ -520,6 +655,7 @@ void CEqPhysics::DestroyGhostObject( CEqCollisionObject* object )
 	if(!m_ghostObjects.fastRemove(object))
 		return;
 
+	RemoveObjectManifolds(object);
 	delete object;
 }
 
@@ -546,6 +682,8 @@ void CEqPhysics::RemoveStaticObject( CEqCollisionObject* object )
 
 	if (m_grid)
 		m_grid->RemoveStaticObjectFromGrid(object);
+
+	RemoveObjectManifolds(object);
 }
 
 void CEqPhysics::DestroyStaticObject( CEqCollisionObject* object )
@@ -561,6 +699,7 @@ void CEqPhysics::DestroyStaticObject( CEqCollisionObject* object )
 	if (m_grid)
 		m_grid->RemoveStaticObjectFromGrid(object);
 
+	RemoveObjectManifolds(object);
 	delete object;
 }
 
@@ -637,6 +776,551 @@ void CEqPhysics::DestroyController( IEqPhysicsController* controller )
 
 //-----------------------------------------------------------------------------------------------
 
+//----------------------------------------------------------------------------------------------------
+//
+// Persistent contact manifolds
+//
+//----------------------------------------------------------------------------------------------------
+
+eqContactManifold* CEqPhysics::FindManifold(const CEqCollisionObject* bodyA, const CEqCollisionObject* bodyB) const
+{
+	auto it = m_manifolds.find(eqManifoldKey{ bodyA, bodyB });
+	if (it.atEnd())
+		return nullptr;
+
+	return *it;
+}
+
+eqContactManifold* CEqPhysics::CreateManifold(CEqCollisionObject* bodyA, CEqCollisionObject* bodyB, int flags)
+{
+	eqContactManifold* manifold = m_manifoldPool.allocate();
+	new(manifold) eqContactManifold();
+	manifold->bodyA = bodyA;
+	manifold->bodyB = bodyB;
+	manifold->flags = flags;
+
+	m_manifolds.insert(eqManifoldKey{ bodyA, bodyB }, manifold);
+	return manifold;
+}
+
+void CEqPhysics::DestroyManifold(eqContactManifold* manifold)
+{
+	m_manifolds.remove(eqManifoldKey{ manifold->bodyA, manifold->bodyB });
+
+	manifold->~eqContactManifold();
+	m_manifoldPool.deallocate(manifold);
+}
+
+void CEqPhysics::CommitManifold(eqContactManifold* manifold)
+{
+	// objects are separated
+	if (!manifold->points.numElem())
+	{
+		DestroyManifold(manifold);
+		return;
+	}
+
+	ManifoldRelativeTransform(manifold->bodyA, manifold->bodyB, manifold->relPosition, manifold->relOrientation);
+	manifold->lastStep = m_stepIndex;
+}
+
+void CEqPhysics::RemoveObjectManifolds(const CEqCollisionObject* object)
+{
+	for (auto it = m_manifolds.begin(); !it.atEnd();)
+	{
+		eqContactManifold* manifold = *it;
+		if (manifold->bodyA != object && manifold->bodyB != object)
+		{
+			++it;
+			continue;
+		}
+
+		it = m_manifolds.remove(it);
+
+		manifold->~eqContactManifold();
+		m_manifoldPool.deallocate(manifold);
+	}
+}
+
+// sleeping island keeps impulses to be warm started when woken up
+static bool IsManifoldSleeping(const eqContactManifold& manifold)
+{
+	const CEqRigidBody* bodyB = static_cast<const CEqRigidBody*>(manifold.bodyB);
+	if (!bodyB->IsSleeping())
+		return false;
+
+	return !manifold.bodyA->IsDynamic() || static_cast<const CEqRigidBody*>(manifold.bodyA)->IsSleeping();
+}
+
+void CEqPhysics::PurgeManifolds()
+{
+	for (auto it = m_manifolds.begin(); !it.atEnd();)
+	{
+		eqContactManifold* manifold = *it;
+		if (m_stepIndex - manifold->lastStep <= CONTACT_MANIFOLD_KEEP_STEPS || IsManifoldSleeping(*manifold))
+		{
+			++it;
+			continue;
+		}
+
+		it = m_manifolds.remove(it);
+
+		manifold->~eqContactManifold();
+		m_manifoldPool.deallocate(manifold);
+	}
+}
+
+bool CEqPhysics::IsManifoldUpToDate(const eqContactManifold& manifold) const
+{
+	Vector3D relPosition;
+	Quaternion relOrientation;
+	ManifoldRelativeTransform(manifold.bodyA, manifold.bodyB, relPosition, relOrientation);
+
+	if (distanceSqr(relPosition, manifold.relPosition) > CONTACT_CACHE_POSITION_TOLERANCE * CONTACT_CACHE_POSITION_TOLERANCE)
+		return false;
+
+	const Quaternion& q = manifold.relOrientation;
+	const float orientDot = relOrientation.x * q.x + relOrientation.y * q.y + relOrientation.z * q.z + relOrientation.w * q.w;
+
+	return 1.0f - fabs(orientDot) < CONTACT_CACHE_ROTATION_TOLERANCE;
+}
+
+void CEqPhysics::GenerateManifoldContacts(eqContactManifold& manifold, CEqRigidBody* pairOwner)
+{
+	const CEqCollisionObject* bodyA = manifold.bodyA;
+	CEqRigidBody* bodyB = static_cast<CEqRigidBody*>(manifold.bodyB);
+
+	const bool isStaticPair = (manifold.flags & COLLPAIRFLAG_OBJECTA_STATIC);
+	const float iterDelta = 1.0f / manifold.points.numElem();
+
+	const Quaternion orientA = ManifoldOrientation(bodyA);
+	const Quaternion orientB = ManifoldOrientation(bodyB);
+
+	manifold.lastStep = m_stepIndex;
+	++m_stepStats.cachedPairs;
+
+	for (int i = 0; i < manifold.points.numElem(); ++i)
+	{
+		if (pairOwner->m_contactPairs.numElem() == pairOwner->m_contactPairs.numAllocated())
+			break;
+
+		const eqManifoldPoint& point = manifold.points[i];
+
+		// contact point that was on object B moved relative to object A
+		const FVector3D hitPos = bodyA->GetPosition() + rotateVector(point.localPosA, orientA);
+		const FVector3D pointB = bodyB->GetPosition() + rotateVector(point.localPosB, orientB);
+		const Vector3D hitNormal = rotateVector(point.localNormal, orientA);
+
+		const float separation = dot(Vector3D(pointB - hitPos), hitNormal);
+		float hitDepth = isStaticPair ? point.depth - separation : point.depth + separation;
+
+		if (hitDepth < 0)
+			continue;
+
+		if (isStaticPair && hitDepth > 1.0f)
+			hitDepth = 1.0f;
+
+		eqContactPair& newPair = pairOwner->m_contactPairs.append();
+		newPair.normal = hitNormal;
+		newPair.flags = manifold.flags;
+		newPair.depth = hitDepth;
+		newPair.position = hitPos;
+		newPair.bodyA = manifold.bodyA;
+		newPair.bodyB = bodyB;
+		newPair.dt = iterDelta;
+
+		newPair.restitutionA = point.restitutionA;
+		newPair.frictionA = point.frictionA;
+
+		newPair.restitutionB = bodyB->GetRestitution();
+		newPair.frictionB = bodyB->GetFriction();
+
+		newPair.manifold = &manifold;
+		newPair.manifoldPoint = i;
+		newPair.warmImpulse = point.impulse * ph_warmStarting.GetFloat();
+	}
+}
+
+//----------------------------------------------------------------------------------------------------
+//
+// Simulation islands
+//
+//----------------------------------------------------------------------------------------------------
+
+static int IslandFindRoot(ArrayRef<int> parents, int idx)
+{
+	while (parents[idx] != idx)
+	{
+		parents[idx] = parents[parents[idx]];
+		idx = parents[idx];
+	}
+	return idx;
+}
+
+// lowest body index becomes the root so island order follows moveable list
+static void IslandUnite(ArrayRef<int> parents, int idxA, int idxB)
+{
+	idxA = IslandFindRoot(parents, idxA);
+	idxB = IslandFindRoot(parents, idxB);
+	if (idxA == idxB)
+		return;
+
+	if (idxA < idxB)
+		parents[idxB] = idxA;
+	else
+		parents[idxA] = idxB;
+}
+
+void CEqPhysics::BuildIslands(ArrayCRef<CEqRigidBody*> movingBodies)
+{
+	const int numBodies = movingBodies.numElem();
+
+	m_islands.clear(false);
+	m_islandBodies.clear(false);
+
+	FrameArray<int> parents{ PP_SL };
+	parents.setNum(numBodies);
+
+	for (int i = 0; i < numBodies; ++i)
+	{
+		movingBodies[i]->m_islandIndex = i;
+		parents[i] = i;
+	}
+
+	for (int i = 0; i < numBodies; ++i)
+	{
+		const CEqRigidBody* body = movingBodies[i];
+		for (const eqContactPair& pair : body->m_contactPairs)
+		{
+			if (pair.flags & COLLPAIRFLAG_OBJECTA_STATIC)
+				continue;
+
+			const CEqRigidBody* other = static_cast<const CEqRigidBody*>(pair.bodyA == body ? pair.bodyB : pair.bodyA);
+			if (other->m_islandIndex >= 0)
+				IslandUnite(parents, i, other->m_islandIndex);
+		}
+	}
+
+	for (IEqPhysicsConstraint* constr : m_constraints)
+	{
+		if (!constr->IsEnabled())
+			continue;
+
+		CEqRigidBody* bodyA = constr->GetBodyA();
+		CEqRigidBody* bodyB = constr->GetBodyB();
+		if (!bodyA || !bodyB)
+			continue;
+
+		// constraint pulls sleeping body
+		if (bodyA->m_islandIndex >= 0 && bodyB->IsSleeping())
+			bodyB->QueueIslandWake();
+		else if (bodyB->m_islandIndex >= 0 && bodyA->IsSleeping())
+			bodyA->QueueIslandWake();
+
+		if (bodyA->m_islandIndex >= 0 && bodyB->m_islandIndex >= 0)
+			IslandUnite(parents, bodyA->m_islandIndex, bodyB->m_islandIndex);
+	}
+
+	// roots are replaced by island indices
+	FrameArray<int> bodyIslands{ PP_SL };
+	bodyIslands.setNum(numBodies);
+
+	for (int i = 0; i < numBodies; ++i)
+	{
+		const int root = IslandFindRoot(parents, i);
+		if (root == i)
+		{
+			bodyIslands[i] = m_islands.numElem();
+			m_islands.append();
+		}
+		else
+			bodyIslands[i] = bodyIslands[root];
+
+		++m_islands[bodyIslands[i]].numBodies;
+	}
+
+	int firstBody = 0;
+	for (eqPhysIsland& island : m_islands)
+	{
+		island.firstBody = firstBody;
+		firstBody += island.numBodies;
+		island.numBodies = 0;
+	}
+
+	m_islandBodies.setNum(numBodies);
+	for (int i = 0; i < numBodies; ++i)
+	{
+		CEqRigidBody* body = movingBodies[i];
+		eqPhysIsland& island = m_islands[bodyIslands[i]];
+
+		m_islandBodies[island.firstBody + island.numBodies++] = body;
+		island.numContacts += body->m_contactPairs.numElem();
+
+		for (const eqContactPair& pair : body->m_contactPairs)
+		{
+			if (pair.flags & COLLPAIRFLAG_OBJECTA_STATIC)
+			{
+				const CEqCollisionObject* staticObj = pair.bodyA;
+				if (staticObj->m_callbacks || (staticObj->m_flags & COLLOBJ_COLLISIONLIST))
+					island.shared = true;
+				continue;
+			}
+
+			const CEqRigidBody* other = static_cast<const CEqRigidBody*>(pair.bodyA == body ? pair.bodyB : pair.bodyA);
+			if (other->m_islandIndex < 0)
+				island.shared = true;
+		}
+	}
+
+	m_stepStats.numIslands = m_islands.numElem();
+}
+
+void CEqPhysics::SolveIsland(const eqPhysIsland& island)
+{
+	ArrayCRef<CEqRigidBody*> bodies(m_islandBodies.ptr() + island.firstBody, island.numBodies);
+
+	// warm start contacts with impulses of previous step
+	for (CEqRigidBody* body : bodies)
+	{
+		for (const eqContactPair& pair : body->m_contactPairs)
+		{
+			if (pair.warmImpulse <= 0.0f || pair.depth <= 0.0f)
+				continue;
+
+			const Vector3D responseNormal = (pair.flags & COLLPAIRFLAG_OBJECTA_STATIC) ? -pair.normal : pair.normal;
+			CEqRigidBody::ApplyWarmImpulseTo(pair, responseNormal);
+		}
+	}
+
+	// process generated contact pairs
+	for (CEqRigidBody* body : bodies)
+	{
+		for (eqContactPair& pair : body->m_contactPairs)
+			ProcessContactPair(pair);
+
+		IEqPhysCallback* callbacks = body->m_callbacks;
+		if (callbacks) // execute post simulation callbacks
+			callbacks->PostSimulate(m_fDt);
+	}
+}
+
+void CEqPhysics::SolveIslands()
+{
+	int numJobs = 1;
+	if (ph_parallelIslands.GetBool() && m_jobMng && m_jobMng->GetJobThreadsCount() > 0)
+	{
+		int numContacts = 0;
+		for (const eqPhysIsland& island : m_islands)
+			numContacts += island.shared ? 0 : island.numContacts;
+
+		const int minContactsPerJob = max(1, ph_parallelIslandsMinContacts.GetInt());
+		numJobs = clamp(numContacts / minContactsPerJob, 1, m_jobMng->GetJobThreadsCount() + 1);
+	}
+
+	if (numJobs == 1)
+	{
+		for (const eqPhysIsland& island : m_islands)
+		{
+			m_stepStats.numSharedIslands += island.shared;
+			SolveIsland(island);
+		}
+		return;
+	}
+
+	// split islands into ranges of about the same number of contacts
+	FrameArray<int> parallelIslands{ PP_SL };
+	parallelIslands.reserve(m_islands.numElem());
+
+	int numContacts = 0;
+	for (int i = 0; i < m_islands.numElem(); ++i)
+	{
+		if (m_islands[i].shared)
+			continue;
+
+		parallelIslands.append(i);
+		numContacts += m_islands[i].numContacts;
+	}
+
+	while (m_solveJobs.numElem() < numJobs - 1)
+		m_solveJobs.append(PPNew CSolveIslandsJob());
+
+	const int contactsPerJob = (numContacts + numJobs - 1) / numJobs;
+
+	FixedArray<int, 64> rangeStarts;
+	rangeStarts.append(0);
+
+	int rangeContacts = 0;
+	for (int i = 0; i < parallelIslands.numElem(); ++i)
+	{
+		if (rangeContacts >= contactsPerJob && rangeStarts.numElem() < numJobs && rangeStarts.numElem() < rangeStarts.numAllocated())
+		{
+			rangeStarts.append(i);
+			rangeContacts = 0;
+		}
+		rangeContacts += m_islands[parallelIslands[i]].numContacts;
+	}
+	rangeStarts.append(parallelIslands.numElem());
+
+	// first range is solved by this thread
+	const int numStartedJobs = rangeStarts.numElem() - 2;
+	for (int i = 0; i < numStartedJobs; ++i)
+	{
+		CSolveIslandsJob* job = m_solveJobs[i];
+		job->m_physics = this;
+		job->m_islands = ArrayCRef<int>(parallelIslands.ptr() + rangeStarts[i + 1], rangeStarts[i + 2] - rangeStarts[i + 1]);
+		job->InitJob();
+		m_jobMng->StartJob(job);
+	}
+
+	// shared islands may wake sleeping bodies and touch static objects
+	for (const eqPhysIsland& island : m_islands)
+	{
+		if (!island.shared)
+			continue;
+
+		++m_stepStats.numSharedIslands;
+		SolveIsland(island);
+	}
+
+	for (int i = 0; i < rangeStarts[1]; ++i)
+		SolveIsland(m_islands[parallelIslands[i]]);
+
+	for (int i = 0; i < numStartedJobs; ++i)
+		m_solveJobs[i]->GetSignal()->Wait();
+}
+
+void CEqPhysics::SleepIslands()
+{
+	const bool islandSleeping = ph_islandSleeping.GetBool();
+
+	int numSlept = 0;
+	for (const eqPhysIsland& island : m_islands)
+	{
+		ArrayCRef<CEqRigidBody*> bodies(m_islandBodies.ptr() + island.firstBody, island.numBodies);
+
+		// bodies freeze on their own and still remain in moveable list
+		if (!islandSleeping)
+		{
+			for (CEqRigidBody* body : bodies)
+			{
+				if (body->IsReadyToSleep())
+					body->m_flags |= BODY_FROZEN;
+			}
+			continue;
+		}
+
+		bool readyToSleep = true;
+		for (CEqRigidBody* body : bodies)
+		{
+			if (!body->IsReadyToSleep() || body->IsFrozen())
+			{
+				readyToSleep = false;
+				break;
+			}
+		}
+
+		if (!readyToSleep)
+			continue;
+
+		eqPhysSleepingIsland* sleepingIsland = m_sleepingIslandPool.allocate();
+		new(sleepingIsland) eqPhysSleepingIsland();
+		sleepingIsland->world = this;
+
+		for (CEqRigidBody* body : bodies)
+		{
+			body->m_flags |= BODY_FROZEN;
+
+			if (!(body->m_flags & BODY_FORCE_PRESERVEFORCES))
+			{
+				body->m_totalTorque = vec3_zero;
+				body->m_totalForce = vec3_zero;
+				body->m_linearVelocity = vec3_zero;
+				body->m_angularVelocity = vec3_zero;
+			}
+
+			body->m_sleepingIsland = sleepingIsland;
+			body->m_sleepingNext = sleepingIsland->firstBody;
+			sleepingIsland->firstBody = body;
+			++sleepingIsland->numBodies;
+		}
+
+		m_numSleepingBodies += island.numBodies;
+		++numSlept;
+	}
+
+	for (CEqRigidBody* body : m_islandBodies)
+		body->m_islandIndex = -1;
+
+	m_stepStats.numSleptIslands = numSlept;
+	if (!numSlept)
+		return;
+
+	// keep order of remaining bodies
+	int numMoveable = 0;
+	for (int i = 0; i < m_moveable.numElem(); ++i)
+	{
+		if (!m_moveable[i]->IsSleeping())
+			m_moveable[numMoveable++] = m_moveable[i];
+	}
+	m_moveable.setNum(numMoveable, false);
+}
+
+void CEqPhysics::QueueIslandWake(eqPhysSleepingIsland* island)
+{
+	if (island->wakeQueued)
+		return;
+
+	island->wakeQueued = true;
+	m_wakeIslands.append(island);
+}
+
+void CEqPhysics::WakeQueuedIslands()
+{
+	for (eqPhysSleepingIsland* island : m_wakeIslands)
+	{
+		CEqRigidBody* body = island->firstBody;
+		while (body)
+		{
+			CEqRigidBody* nextBody = body->m_sleepingNext;
+
+			body->m_sleepingIsland = nullptr;
+			body->m_sleepingNext = nullptr;
+			body->TryWake(false);
+
+			m_moveable.append(body);
+			body = nextBody;
+		}
+
+		m_numSleepingBodies -= island->numBodies;
+		++m_stepStats.numWokenIslands;
+
+		island->~eqPhysSleepingIsland();
+		m_sleepingIslandPool.deallocate(island);
+	}
+	m_wakeIslands.clear(false);
+}
+
+// island loses the body and wakes up since it might be supported by it
+void CEqPhysics::RemoveFromSleepingIsland(CEqRigidBody* body)
+{
+	eqPhysSleepingIsland* island = body->m_sleepingIsland;
+
+	CEqRigidBody** link = &island->firstBody;
+	while (*link != body)
+		link = &(*link)->m_sleepingNext;
+
+	*link = body->m_sleepingNext;
+	--island->numBodies;
+	--m_numSleepingBodies;
+
+	body->m_sleepingIsland = nullptr;
+	body->m_sleepingNext = nullptr;
+
+	QueueIslandWake(island);
+}
+
+//----------------------------------------------------------------------------------------------------
+
 void CEqPhysics::DetectBodyCollisions(CEqRigidBody* bodyA, CEqRigidBody* bodyB, float fDt)
 {
 	// apply filters
@@ -673,6 +1357,17 @@ void CEqPhysics::DetectBodyCollisions(CEqRigidBody* bodyA, CEqRigidBody* bodyB,
 	if (!objA || !objB)
 		return;
 
+	// resting pairs are taking contacts from previous step
+	const bool useContactCache = ph_contactCache.GetBool() && !((bodyA->m_flags | bodyB->m_flags) & COLLOBJ_ISGHOST);
+	eqContactManifold* manifold = useContactCache ? FindManifold(bodyA, bodyB) : nullptr;
+	if (manifold && IsManifoldUpToDate(*manifold))
+	{
+		GenerateManifoldContacts(*manifold, bodyA);
+		return;
+	}
+
+	++m_stepStats.narrowPhaseTests;
+
 	// body a
 	Matrix4x4 eqTransA = Matrix4x4( bodyA->GetOrientation() );
 	eqTransA.translate(bodyA->GetShapeCenter());
@@ -685,21 +1380,52 @@ void CEqPhysics::DetectBodyCollisions(CEqRigidBody* bodyA, CEqRigidBody* bodyB,
 	eqTransB = transpose(eqTransB);
 	eqTransB.rows[3] += Vector4D(bodyB->GetPosition()+centerOffset, 1.0f);
 
-	btTransform transA;
-	btTransform transB;
+	CEqPairCollisions cbResult(centerOffset);
 
-	ConvertMatrix4ToBullet(transA, eqTransA);
-	ConvertMatrix4ToBullet(transB, eqTransB);
+	const bool nativeNarrowPhase = ph_nativeNarrowPhase.GetBool() && !((bodyA->m_flags | bodyB->m_flags) & COLLOBJ_ISGHOST) &&
+		IsNativeNarrowPhaseConvex(bodyA->GetBulletCollisionShapes()) && IsNativeNarrowPhaseConvex(bodyB->GetBulletCollisionShapes());
 
-	//objA->setWorldTransform(transA);
-	//objB->setWorldTransform(transB);
+	if (nativeNarrowPhase)
+	{
+		++m_stepStats.nativeNarrowPhaseTests;
+
+		const Matrix3x3 rotationA = eqTransA.getRotationComponentTransposed();
+		const Matrix3x3 rotationB = eqTransB.getRotationComponentTransposed();
 
-	btCollisionObjectWrapper obA(nullptr, bodyA->m_shape, objA, transA, -1, -1);
-	btCollisionObjectWrapper obB(nullptr, bodyB->m_shape, objB, transB, -1, -1);
+		eqNarrowPhaseContact contacts[NARROWPHASE_MAX_FACE_CONTACTS * 2];
 
-	CEqManifoldResult cbResult(&obA, &obB, true, centerOffset);
+		for (const btCollisionShape* shapeB : bodyB->GetBulletCollisionShapes())
+		{
+			eqNarrowPhaseShape npShapeB;
+			npShapeB.Init(shapeB, rotationB, eqTransB.getTranslationComponent());
+
+			for (const btCollisionShape* shapeA : bodyA->GetBulletCollisionShapes())
+			{
+				eqNarrowPhaseShape npShapeA;
+				npShapeA.Init(shapeA, rotationA, eqTransA.getTranslationComponent());
 
+				const int numContacts = NarrowPhase_Collide(npShapeA, npShapeB, contacts, elementsOf(contacts));
+				for (int i = 0; i < numContacts; ++i)
+					cbResult.Add(contacts[i].position, contacts[i].normal, contacts[i].distance, -1, -1);
+			}
+		}
+	}
+	else
 	{
+		btTransform transA;
+		btTransform transB;
+
+		ConvertMatrix4ToBullet(transA, eqTransA);
+		ConvertMatrix4ToBullet(transB, eqTransB);
+
+		//objA->setWorldTransform(transA);
+		//objB->setWorldTransform(transB);
+
+		btCollisionObjectWrapper obA(nullptr, bodyA->m_shape, objA, transA, -1, -1);
+		btCollisionObjectWrapper obB(nullptr, bodyB->m_shape, objB, transB, -1, -1);
+
+		CEqManifoldResult manifoldResult(&obA, &obB, true, cbResult);
+
 		btCollisionAlgorithm* algorithm = nullptr;
 
 		// FIXME:
@@ -714,7 +1440,7 @@ void CEqPhysics::DetectBodyCollisions(CEqRigidBody* bodyA, CEqRigidBody* bodyB,
 				if(!algorithm)
 					algorithm = m_collDispatcher->findAlgorithm(&obA, &obB, nullptr, BT_CONTACT_POINT_ALGORITHMS);
 
-				algorithm->processCollision(&obA, &obB, *m_dispatchInfo, &cbResult);
+				algorithm->processCollision(&obA, &obB, *m_dispatchInfo, &manifoldResult);
 			}
 		}
 
@@ -729,8 +1455,17 @@ void CEqPhysics::DetectBodyCollisions(CEqRigidBody* bodyA, CEqRigidBody* bodyB,
 	const int numCollResults = cbResult.m_collisions.numElem();
 	const float iterDelta = 1.0f / numCollResults;
 
-	for(eqCollisionInfo& coll : cbResult.m_collisions)
+	FixedArray<eqManifoldPoint, EQPHYS_MANIFOLD_MAX_POINTS> prevPoints;
+	if (manifold)
+	{
+		prevPoints.append(manifold->points);
+		manifold->points.clear();
+	}
+
+	for(int i = 0; i < numCollResults; ++i)
 	{
+		const eqCollisionInfo& coll = cbResult.m_collisions[i];
+
 		if (bodyA->m_contactPairs.numElem() == bodyA->m_contactPairs.numAllocated())
 			break;
 
@@ -756,6 +1491,13 @@ void CEqPhysics::DetectBodyCollisions(CEqRigidBody* bodyA, CEqRigidBody* bodyB,
 		newPair.restitutionB = bodyB->GetRestitution();
 		newPair.frictionB = bodyB->GetFriction();
 
+		if (useContactCache)
+		{
+			if (!manifold)
+				manifold = CreateManifold(bodyA, bodyB, 0);
+			AddManifoldPoint(*manifold, prevPoints, newPair, cbResult.m_features[i]);
+		}
+
 #ifdef ENABLE_DEBUG_DRAWING
 		if(ph_showcontacts.GetBool())
 		{
@@ -765,6 +1507,9 @@ void CEqPhysics::DetectBodyCollisions(CEqRigidBody* bodyA, CEqRigidBody* bodyB,
 		}
 #endif // ENABLE_DEBUG_DRAWING
 	}
+
+	if (manifold)
+		CommitManifold(manifold);
 }
 
 void CEqPhysics::DetectStaticVsBodyCollision(CEqCollisionObject* staticObj, CEqRigidBody* bodyB, float fDt)
@@ -786,6 +1531,17 @@ void CEqPhysics::DetectStaticVsBodyCollision(CEqCollisionObject* staticObj, CEqR
 	if (!objA || !objB)
 		return;
 
+	// resting pairs are taking contacts from previous step
+	const bool useContactCache = ph_contactCache.GetBool() && !((staticObj->m_flags | bodyB->m_flags) & COLLOBJ_ISGHOST);
+	eqContactManifold* manifold = useContactCache ? FindManifold(staticObj, bodyB) : nullptr;
+	if (manifold && IsManifoldUpToDate(*manifold))
+	{
+		GenerateManifoldContacts(*manifold, bodyB);
+		return;
+	}
+
+	++m_stepStats.narrowPhaseTests;
+
 	// body a
 	Matrix4x4 eqTransA;
 	{
@@ -816,34 +1572,94 @@ void CEqPhysics::DetectStaticVsBodyCollision(CEqCollisionObject* staticObj, CEqR
 		eqTransB_vel.rows[3] += Vector4D(bodyB->GetPosition() + center + addVelToPos, 1.0f);
 	}
 
-	btTransform transA; 
-	btTransform transB;
+	CEqPairCollisions cbResult(center);
 
-	ConvertMatrix4ToBullet(transA, eqTransA);
-	ConvertMatrix4ToBullet(transB, eqTransB_orig);
+	const int bodyContents = bodyB->GetContents();
 
-	btTransform transB_vel;
-	ConvertMatrix4ToBullet(transB_vel, eqTransB_vel);
+	const CEqBulletIndexedMesh* staticIndexedMesh = staticObj->GetMesh();
+	ArrayCRef<btCollisionShape*> staticShapes = staticObj->GetBulletCollisionShapes();
 
-	objA->setWorldTransform(transA);
-	objB->setWorldTransform(transB);
+	bool nativeNarrowPhase = ph_nativeNarrowPhase.GetBool() && !((staticObj->m_flags | bodyB->m_flags) & COLLOBJ_ISGHOST) &&
+		IsNativeNarrowPhaseConvex(bodyB->GetBulletCollisionShapes());
 
-	btVector3 velocity;
-	ConvertDKToBulletVectors(velocity, bodyB->GetLinearVelocity());
-	objB->setInterpolationWorldTransform(transB_vel);
+	for (int i = 0; i < staticShapes.numElem() && nativeNarrowPhase; ++i)
+	{
+		nativeNarrowPhase = staticIndexedMesh ? NarrowPhase_IsSupportedMesh(staticShapes[i]) : NarrowPhase_IsSupportedConvex(staticShapes[i]);
+	}
 
-	btCollisionObjectWrapper obA(nullptr, staticObj->m_shape, objA, transA, -1, -1);
-	btCollisionObjectWrapper obB(nullptr, bodyB->m_shape, objB, transB, -1, -1);
-	
-	CEqManifoldResult cbResult(&obA, &obB, /*(bodyB->m_flags & BODY_ISCAR)*/true, center);
+	if (nativeNarrowPhase)
+	{
+		++m_stepStats.nativeNarrowPhaseTests;
+
+		const Matrix3x3 rotationA = eqTransA.getRotationComponentTransposed();
+		const Matrix3x3 rotationB = eqTransB_orig.getRotationComponentTransposed();
 
+		eqNarrowPhaseContact contacts[64];
+
+		for (const btCollisionShape* shapeB : bodyB->GetBulletCollisionShapes())
+		{
+			eqNarrowPhaseShape npShapeB;
+			npShapeB.Init(shapeB, rotationB, eqTransB_orig.getTranslationComponent());
+
+			for (int i = 0; i < staticShapes.numElem(); ++i)
+			{
+				if (staticIndexedMesh)
+				{
+					const int surfMaterialIdx = staticIndexedMesh->GetSubpartMaterialIdx(i);
+					const eqPhysSurfParam* surfParam = GetSurfaceParamByID(surfMaterialIdx);
+
+					// skip the shape if collide mask not meeting expectation
+					if (surfParam && (surfParam->contentsMask & bodyContents) != bodyContents)
+						continue;
+
+					// body is shape A against triangles, same as Bullet swaps convex-concave pairs
+					const int numContacts = NarrowPhase_CollideMesh(npShapeB, staticShapes[i], rotationA, eqTransA.getTranslationComponent(),
+						staticObj->m_trimap, contacts, elementsOf(contacts));
+
+					for (int j = 0; j < numContacts; ++j)
+					{
+						const eqNarrowPhaseContact& contact = contacts[j];
+						const int materialIndex = staticIndexedMesh->GetSubpartMaterialIdx(staticShapes.numElem() > 1 ? i : contact.partId);
+
+						cbResult.Add(contact.position, contact.normal, contact.distance, materialIndex, btInternalGetHash(contact.partId, contact.triangleIndex));
+					}
+				}
+				else
+				{
+					eqNarrowPhaseShape npShapeA;
+					npShapeA.Init(staticShapes[i], rotationA, eqTransA.getTranslationComponent());
+
+					const int numContacts = NarrowPhase_Collide(npShapeA, npShapeB, contacts, elementsOf(contacts));
+					for (int j = 0; j < numContacts; ++j)
+						cbResult.Add(contacts[j].position, contacts[j].normal, contacts[j].distance, -1, -1);
+				}
+			}
+		}
+	}
+	else
 	{
-		btCollisionAlgorithm* algorithm = nullptr;
+		btTransform transA; 
+		btTransform transB;
 
-		const int bodyContents = bodyB->GetContents();
+		ConvertMatrix4ToBullet(transA, eqTransA);
+		ConvertMatrix4ToBullet(transB, eqTransB_orig);
 
-		const CEqBulletIndexedMesh* staticIndexedMesh = staticObj->GetMesh();
-		ArrayCRef<btCollisionShape*> staticShapes = staticObj->GetBulletCollisionShapes();
+		btTransform transB_vel;
+		ConvertMatrix4ToBullet(transB_vel, eqTransB_vel);
+
+		objA->setWorldTransform(transA);
+		objB->setWorldTransform(transB);
+
+		btVector3 velocity;
+		ConvertDKToBulletVectors(velocity, bodyB->GetLinearVelocity());
+		objB->setInterpolationWorldTransform(transB_vel);
+
+		btCollisionObjectWrapper obA(nullptr, staticObj->m_shape, objA, transA, -1, -1);
+		btCollisionObjectWrapper obB(nullptr, bodyB->m_shape, objB, transB, -1, -1);
+	
+		CEqManifoldResult manifoldResult(&obA, &obB, /*(bodyB->m_flags & BODY_ISCAR)*/true, cbResult);
+
+		btCollisionAlgorithm* algorithm = nullptr;
 
 		// FIXME:
 		// Due to btCompoundShape producing unreliable results, there is a really slow checks appear...
@@ -867,7 +1683,7 @@ void CEqPhysics::DetectStaticVsBodyCollision(CEqCollisionObject* staticObj, CEqR
 				if (!algorithm)
 					algorithm = m_collDispatcher->findAlgorithm(&obA, &obB, nullptr, BT_CONTACT_POINT_ALGORITHMS);
 
-				algorithm->processCollision(&obA, &obB, *m_dispatchInfo, &cbResult);
+				algorithm->processCollision(&obA, &obB, *m_dispatchInfo, &manifoldResult);
 			}
 		}
 
@@ -881,8 +1697,17 @@ void CEqPhysics::DetectStaticVsBodyCollision(CEqCollisionObject* staticObj, CEqR
 	const int numCollResults = cbResult.m_collisions.numElem();
 	const float iterDelta = 1.0f / numCollResults;
 
-	for(eqCollisionInfo& coll : cbResult.m_collisions)
+	FixedArray<eqManifoldPoint, EQPHYS_MANIFOLD_MAX_POINTS> prevPoints;
+	if (manifold)
+	{
+		prevPoints.append(manifold->points);
+		manifold->points.clear();
+	}
+
+	for(int i = 0; i < numCollResults; ++i)
 	{
+		const eqCollisionInfo& coll = cbResult.m_collisions[i];
+
 		if (bodyB->m_contactPairs.numElem() == bodyB->m_contactPairs.numAllocated())
 			break;
 
@@ -924,6 +1749,13 @@ void CEqPhysics::DetectStaticVsBodyCollision(CEqCollisionObject* staticObj, CEqR
 
 		newPair.restitutionB = bodyB->GetRestitution();
 		newPair.frictionB = bodyB->GetFriction();
+
+		if (useContactCache)
+		{
+			if (!manifold)
+				manifold = CreateManifold(staticObj, bodyB, COLLPAIRFLAG_OBJECTA_STATIC);
+			AddManifoldPoint(*manifold, prevPoints, newPair, cbResult.m_features[i]);
+		}
 #ifdef ENABLE_DEBUG_DRAWING
 		if(ph_showcontacts.GetBool())
 		{
@@ -933,6 +1765,9 @@ void CEqPhysics::DetectStaticVsBodyCollision(CEqCollisionObject* staticObj, CEqR
 		}
 #endif // ENABLE_DEBUG_DRAWING
 	}
+
+	if (manifold)
+		CommitManifold(manifold);
 }
 
 void CEqPhysics::SetupBodyOnCell( CEqCollisionObject* body )
@@ -1087,6 +1922,7 @@ void CEqPhysics::ProcessContactPair(eqContactPair& pair)
 
 			bodyB->m_position += pair.normal * positionalError * combinedErp;
 			bodyB->m_prevPosition += pair.normal * positionalError * combinedErp;
+			bodyB->m_flags |= COLLOBJ_BOUNDBOX_DIRTY;
 			
 			appliedImpulse = CEqRigidBody::ApplyImpulseResponseTo(pair, positionalError * combinedErp * 2.0f);
 			//appliedImpulse =  CEqRigidBody::ApplyImpulseResponseTo(bodyB, pair.position, pair.normal, 0.0, pair.restitutionA, pair.frictionA);
@@ -1118,6 +1954,7 @@ void CEqPhysics::ProcessContactPair(eqContactPair& pair)
 		{
 			bodyA->m_position += pair.normal * positionalError * combinedErp;
 			bodyA->m_prevPosition += pair.normal * positionalError * combinedErp;
+			bodyA->m_flags |= COLLOBJ_BOUNDBOX_DIRTY;
 		}
 
 		if (pair.depth > 0 &&
@@ -1128,6 +1965,7 @@ void CEqPhysics::ProcessContactPair(eqContactPair& pair)
 		{
 			bodyB->m_position -= pair.normal * positionalError * combinedErp;
 			bodyB->m_prevPosition -= pair.normal * positionalError * combinedErp;
+			bodyB->m_flags |= COLLOBJ_BOUNDBOX_DIRTY;
 		}
 
 		// apply response
@@ -1196,6 +2034,10 @@ void CEqPhysics::ProcessContactPair(eqContactPair& pair)
 		if((bodyBFlags & COLLOBJ_COLLISIONLIST) && pairs.numElem() < PHYSICS_COLLISION_LIST_MAX)
 			pairs.append(std::move(collData));
 	}
+
+	// keep impulse for warm starting on next step
+	if (pair.manifold)
+		pair.manifold->points[pair.manifoldPoint].impulse = pair.accumImpulse;
 }
 
 //----------------------------------------------------------------------------------------------------
@@ -1210,9 +2052,20 @@ void CEqPhysics::SimulateStep(float deltaTime, int iteration, FNSIMULATECALLBACK
 	if(!m_grid)
 		return;
 
+	// step may run several times per frame or on it's own thread
+	CFrameAllocScope frameAllocScope;
+
 	// save delta
 	m_fDt = deltaTime;
 
+	++m_stepIndex;
+	m_stepStats = eqPhysStepStats();
+
+	{
+		PROF_EVENT("Islands Wake");
+		WakeQueuedIslands();
+	}
+
 	{
 		PROF_EVENT("Constraints PreApply");
 		// prepare all the constraints
@@ -1235,7 +2088,7 @@ void CEqPhysics::SimulateStep(float deltaTime, int iteration, FNSIMULATECALLBACK
 		}
 	}
 	
-	Array<CEqRigidBody*> movingMoveables{ PP_SL };
+	FrameArray<CEqRigidBody*> movingMoveables{ PP_SL };
 	movingMoveables.resize(m_moveable.numElem());
 
 	{
@@ -1281,18 +2134,13 @@ void CEqPhysics::SimulateStep(float deltaTime, int iteration, FNSIMULATECALLBACK
 	}
 	
 	{
-		PROF_EVENT("Moving Bodies Process Contact Pairs");
-
-		// process generated contact pairs
-		for (CEqRigidBody* body : movingMoveables)
-		{
-			for (eqContactPair& pair : body->m_contactPairs)
-				ProcessContactPair(pair);
+		PROF_EVENT("Moving Bodies Build Islands");
+		BuildIslands(movingMoveables);
+	}
 
-			IEqPhysCallback* callbacks = body->m_callbacks;
-			if (callbacks) // execute post simulation callbacks
-				callbacks->PostSimulate(m_fDt);
-		}
+	{
+		PROF_EVENT("Moving Bodies Process Contact Pairs");
+		SolveIslands();
 	}
 
 	{
@@ -1307,6 +2155,24 @@ void CEqPhysics::SimulateStep(float deltaTime, int iteration, FNSIMULATECALLBACK
 		}
 	}
 
+	{
+		PROF_EVENT("Moving Bodies Bounds");
+		// bounds of bodies moved by position correction, they are derived from position in snapshots
+		for (CEqRigidBody* body : m_moveable)
+			body->UpdateBoundingBoxTransform();
+	}
+
+	{
+		PROF_EVENT("Islands Sleep");
+		SleepIslands();
+	}
+
+	// manifolds of separated or sleeping pairs are not needed anymore
+	PurgeManifolds();
+	m_stepStats.numManifolds = m_manifolds.size();
+	m_stepStats.numAwakeBodies = m_moveable.numElem();
+	m_stepStats.numSleepingBodies = m_numSleepingBodies;
+
 	m_numRayQueries = 0;
 }
 
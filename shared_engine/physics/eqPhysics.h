@@ -47,20 +47,72 @@ class btCollisionShape;
 
 struct eqCollisionInfo;
 struct eqContactPair;
+struct eqContactManifold;
+struct eqPhysSnapshot;
 struct KVSection;
 class CEqCollisionObject;
 class CEqRigidBody;
 class CEqCollisionBroadphaseGrid;
 class IEqPhysicsConstraint;
 class IEqPhysicsController;
+class CEqPhysics;
+class CEqJobManager;
 
 
 typedef void (*FNSIMULATECALLBACK)(float fDt, int iterNum);
 
+struct eqManifoldKey
+{
+	const CEqCollisionObject*	bodyA;
+	const CEqCollisionObject*	bodyB;
+
+	bool operator==(const eqManifoldKey& other) const { return bodyA == other.bodyA && bodyB == other.bodyB; }
+};
+
+template<>
+struct HashMapHasher<eqManifoldKey>
+{
+	static uint64 hash(const eqManifoldKey& key) { return HashMapMix(reinterpret_cast<uintptr_t>(key.bodyA) ^ HashMapMix(reinterpret_cast<uintptr_t>(key.bodyB))); }
+};
+
+struct eqPhysStepStats
+{
+	int		narrowPhaseTests{ 0 };		// object pairs tested by collision algorithms
+	int		nativeNarrowPhaseTests{ 0 };	// of them tested without Bullet
+	int		cachedPairs{ 0 };			// object pairs which contacts were taken from manifold
+	int		numManifolds{ 0 };
+	int		numIslands{ 0 };			// islands of moving bodies solved
+	int		numSharedIslands{ 0 };		// islands which were solved by calling thread
+	int		numWokenIslands{ 0 };
+	int		numSleptIslands{ 0 };
+	int		numAwakeBodies{ 0 };		// in moveable list after step
+	int		numSleepingBodies{ 0 };
+};
+
+// bodies connected by contacts and constraints during step
+struct eqPhysIsland
+{
+	int		firstBody{ 0 };				// in island body list
+	int		numBodies{ 0 };
+	int		numContacts{ 0 };
+	bool	shared{ false };			// touches sleeping bodies or static objects with callbacks
+};
+
+// island which fell asleep, it's bodies are removed from moveable list until island is woken up
+struct eqPhysSleepingIsland
+{
+	CEqPhysics*		world{ nullptr };
+	CEqRigidBody*	firstBody{ nullptr };	// linked by CEqRigidBody::m_sleepingNext
+	int				numBodies{ 0 };
+	bool			wakeQueued{ false };
+};
+
 //--------------------------------------------------------------------------------------------------------------
 
 class CEqPhysics
 {
+	class CSolveIslandsJob;
+
 	struct sweptTestParams_t
 	{
 		Quaternion rotation;
@@ -104,6 +156,10 @@ public:
 	void							AddConstraint( IEqPhysicsConstraint* constraint );		///< adds constraint to the world
 	void							RemoveConstraint( IEqPhysicsConstraint* constraint );	///< removes constraint from the world
 
+	void							SetJobManager(CEqJobManager* jobMng) { m_jobMng = jobMng; }	///< job manager to solve islands in parallel
+
+	void							QueueIslandWake(eqPhysSleepingIsland* island);			///< island bodies are back to moveable list on next step
+
 	void							AddController( IEqPhysicsController* controller );		///< adds controller to the world
 	void							RemoveController( IEqPhysicsController* controller );	///< removes controller from the world
 	void							DestroyController( IEqPhysicsController* controlelr );	///< destroys controller
@@ -171,6 +227,11 @@ public:
 
 	void							SetDebugRaycast(bool enable) {m_debugRaycast = enable;}
 
+	const eqPhysStepStats&			GetStepStats() const { return m_stepStats; }			///< returns statistics of last simulation step
+
+	void							SaveSnapshot(eqPhysSnapshot& snapshot);					///< stores simulation state of world
+	bool							RestoreSnapshot(const eqPhysSnapshot& snapshot);		///< rolls world back to stored state, it must contain same objects
+
 	void							DetectBodyCollisions(CEqRigidBody* bodyA, CEqRigidBody* bodyB, float fDt);
 	void							DetectStaticVsBodyCollision(CEqCollisionObject* staticObj, CEqRigidBody* bodyB, float fDt);
 
@@ -213,6 +274,32 @@ protected:
 
 	CEqCollisionBroadphaseGrid*		m_grid{ nullptr };
 
+	//------------------------------------------------------
+	// persistent contact manifolds
+
+	eqContactManifold*				FindManifold(const CEqCollisionObject* bodyA, const CEqCollisionObject* bodyB) const;
+	eqContactManifold*				CreateManifold(CEqCollisionObject* bodyA, CEqCollisionObject* bodyB, int flags);
+	void							DestroyManifold(eqContactManifold* manifold);
+	void							CommitManifold(eqContactManifold* manifold);		///< stores relative transform after narrow phase
+	void							RemoveObjectManifolds(const CEqCollisionObject* object);
+	void							PurgeManifolds();
+
+	///< checks if objects are not moved relatively since manifold was built
+	bool							IsManifoldUpToDate(const eqContactManifold& manifold) const;
+
+	///< builds contact pairs from manifold points instead of running narrow phase
+	void							GenerateManifoldContacts(eqContactManifold& manifold, CEqRigidBody* pairOwner);
+
+	//------------------------------------------------------
+	// simulation islands
+
+	void							BuildIslands(ArrayCRef<CEqRigidBody*> movingBodies);
+	void							SolveIslands();
+	void							SolveIsland(const eqPhysIsland& island);
+	void							SleepIslands();				///< freezes islands which bodies are at rest
+	void							WakeQueuedIslands();
+	void							RemoveFromSleepingIsland(CEqRigidBody* body);
+
 protected:
 
 	Array<eqPhysSurfParam*>			m_physSurfaceParams{ PP_SL };
@@ -232,6 +319,22 @@ protected:
 	btCollisionConfiguration*		m_collConfig{ nullptr };
 	btCollisionDispatcher*			m_collDispatcher{ nullptr };
 
+	HashMap<eqManifoldKey, eqContactManifold*>	m_manifolds{ PP_SL };
+	MemoryPool<eqContactManifold, 256>			m_manifoldPool{ PP_SL };
+
+	Array<eqPhysIsland>				m_islands{ PP_SL };
+	Array<CEqRigidBody*>			m_islandBodies{ PP_SL };
+	Array<eqPhysSleepingIsland*>	m_wakeIslands{ PP_SL };
+	MemoryPool<eqPhysSleepingIsland, 256>		m_sleepingIslandPool{ PP_SL };
+	int								m_numSleepingBodies{ 0 };
+
+	HashMap<const CEqCollisionObject*, int>		m_snapshotStaticIds{ PP_SL };	// static object indices for manifolds in snapshot
+
+	CEqJobManager*					m_jobMng{ nullptr };
+	Array<CSolveIslandsJob*>		m_solveJobs{ PP_SL };
+	eqPhysStepStats					m_stepStats;
+	int								m_stepIndex{ 0 };
+
 	int								m_numRayQueries{ 0 };
 	float							m_fDt{ 0.0f };
 	bool							m_debugRaycast{ false };
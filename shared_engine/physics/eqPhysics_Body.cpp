@@ -11,6 +11,7 @@
 #include "core/ConVar.h"
 #include "eqPhysics_Body.h"
 #include "eqPhysics_Contstraint.h"
+#include "eqPhysics.h"
 
 #include "render/IDebugOverlay.h"
 
@@ -125,11 +126,18 @@ bool CEqRigidBody::TryWake( bool velocityCheck )
 		lengthSqr(m_linearVelocity) < BODY_MIN_VELOCITY_WAKE &&
 		lengthSqr(m_angularVelocity) < BODY_MIN_VELOCITY_WAKE_ANG)
 	{
+		// sleeping body is not integrated and would keep small impulses
+		if (m_sleepingIsland && !(m_flags & BODY_FORCE_PRESERVEFORCES))
+		{
+			m_linearVelocity = vec3_zero;
+			m_angularVelocity = vec3_zero;
+		}
 		return false;
 	}
 
 	m_flags &= ~BODY_FROZEN;
 	m_freezeTime = BODY_FREEZE_TIME;
+	QueueIslandWake();
 	return true;
 }
 
@@ -137,6 +145,14 @@ void CEqRigidBody::Wake()
 {
 	m_flags &= ~(BODY_FROZEN | BODY_FORCE_FREEZE);
 	m_freezeTime = BODY_FREEZE_TIME;
+	QueueIslandWake();
+}
+
+// sleeping body brings whole island back to simulation on next step
+void CEqRigidBody::QueueIslandWake()
+{
+	if (m_sleepingIsland)
+		m_sleepingIsland->world->QueueIslandWake(m_sleepingIsland);
 }
 
 void CEqRigidBody::Freeze()
@@ -149,6 +165,11 @@ bool CEqRigidBody::IsFrozen() const
 	return m_flags & (BODY_FROZEN | BODY_FORCE_FREEZE);
 }
 
+bool CEqRigidBody::IsReadyToSleep() const
+{
+	return !(m_flags & BODY_NO_AUTO_FREEZE) && m_freezeTime < 0.0f;
+}
+
 bool CEqRigidBody::IsCanIntegrate(bool checkIgnore) const
 {
 	if(m_frameTimeAccumulator == 0.0f || (checkIgnore == m_minFrameTimeIgnoreMotion))
@@ -291,10 +312,8 @@ void CEqRigidBody::AccumulateForces(float time)
 		if (lengthSqr(linearVelocity) < BODY_MIN_VELOCITY &&
 			lengthSqr(angularVelocity) < BODY_MIN_VELOCITY_ANG)
 		{
+			// frozen by it's island when all bodies are ready to sleep
 			m_freezeTime -= time;
-
-			if (m_freezeTime < 0.0f)
-				m_flags |= BODY_FROZEN;
 		}
 		else
 			m_freezeTime = BODY_FREEZE_TIME;
@@ -462,6 +481,46 @@ void CEqRigidBody::SetOrientation(const Quaternion& orient)
 	UpdateBoundingBoxTransform();
 }
 
+void CEqRigidBody::GetState(eqRigidBodyState& state) const
+{
+	state.position = m_position;
+	state.prevPosition = m_prevPosition;
+	state.centerOfMassTrans = m_centerOfMassTrans;
+	state.orientation = m_orientation;
+	state.prevOrientation = m_prevOrientation;
+	state.linearVelocity = m_linearVelocity;
+	state.angularVelocity = m_angularVelocity;
+	state.totalForce = m_totalForce;
+	state.totalTorque = m_totalTorque;
+	state.invInertiaTensor = m_invInertiaTensor;
+	state.aabbTransformed = m_aabb_transformed;
+	state.freezeTime = m_freezeTime;
+	state.frameTimeAccumulator = m_frameTimeAccumulator;
+	state.lastFrameTime = m_lastFrameTime;
+	state.flags = m_flags;
+}
+
+void CEqRigidBody::SetState(const eqRigidBodyState& state)
+{
+	m_position = state.position;
+	m_prevPosition = state.prevPosition;
+	m_centerOfMassTrans = state.centerOfMassTrans;
+	m_orientation = state.orientation;
+	m_prevOrientation = state.prevOrientation;
+	m_linearVelocity = state.linearVelocity;
+	m_angularVelocity = state.angularVelocity;
+	m_totalForce = state.totalForce;
+	m_totalTorque = state.totalTorque;
+	m_invInertiaTensor = state.invInertiaTensor;
+	m_aabb_transformed = state.aabbTransformed;
+	m_freezeTime = state.freezeTime;
+	m_frameTimeAccumulator = state.frameTimeAccumulator;
+	m_lastFrameTime = state.lastFrameTime;
+
+	// render matrix is not stored
+	m_flags = state.flags | COLLOBJ_TRANSFORM_DIRTY;
+}
+
 const FVector3D& CEqRigidBody::GetPrevPosition() const
 {
 	return m_prevPosition;
@@ -615,6 +674,46 @@ void CEqRigidBody::CopyValues(CEqRigidBody* dest, const CEqRigidBody* src)
 }
 
 
+static bool CanApplyImpulseToA(const eqContactPair& pair)
+{
+	const CEqCollisionObject* bodyA = pair.bodyA;
+	const CEqCollisionObject* bodyB = pair.bodyB;
+
+	return bodyA->IsDynamic() && 
+		!(pair.flags & COLLPAIRFLAG_OBJECTA_NO_RESPONSE) && 
+		!((bodyA->m_flags & BODY_INFINITEMASS) && (bodyB->m_flags & BODY_MOVEABLE)) &&
+		!(bodyB->m_flags & COLLOBJ_DISABLE_RESPONSE) &&
+		!(bodyA->m_flags & BODY_FORCE_FREEZE);
+}
+
+static bool CanApplyImpulseToB(const eqContactPair& pair)
+{
+	const CEqCollisionObject* bodyA = pair.bodyA;
+	const CEqCollisionObject* bodyB = pair.bodyB;
+
+	return !(pair.flags & COLLPAIRFLAG_OBJECTB_NO_RESPONSE) && 
+		!((bodyB->m_flags & BODY_INFINITEMASS) && (bodyA->m_flags & BODY_MOVEABLE)) &&
+		!(bodyA->m_flags & COLLOBJ_DISABLE_RESPONSE) &&
+		!(bodyB->m_flags & BODY_FORCE_FREEZE);
+}
+
+void CEqRigidBody::ApplyWarmImpulseTo(const eqContactPair& pair, const Vector3D& contactNormal)
+{
+	const Vector3D impulseVector = contactNormal * pair.warmImpulse;
+
+	if (CanApplyImpulseToA(pair))
+	{
+		CEqRigidBody* bodyA = static_cast<CEqRigidBody*>(pair.bodyA);
+		bodyA->ApplyImpulse(bodyA->GetPosition() - pair.position, impulseVector);
+	}
+
+	if (CanApplyImpulseToB(pair))
+	{
+		CEqRigidBody* bodyB = static_cast<CEqRigidBody*>(pair.bodyB);
+		bodyB->ApplyImpulse(bodyB->GetPosition() - pair.position, -impulseVector);
+	}
+}
+
 float CEqRigidBody::ApplyImpulseResponseTo(eqContactPair& pair, float errorCorrectionFactor)
 {
 	FVector3D contactPoint = pair.position;
@@ -659,6 +758,9 @@ float CEqRigidBody::ApplyImpulseResponseTo(eqContactPair& pair, float errorCorre
 	if (denominator < 0.0000001f)
 		return 0.0f;
 
+	// warm impulse is already applied to bodies before contact pairs are processed
+	const float warmImpulse = pair.warmImpulse;
+
 	const float combinedRest = 1.0f + (pair.restitutionA + pair.restitutionB);
 	const float combinedFriction = (pair.frictionA + pair.frictionB) * 0.5f;
 
@@ -668,10 +770,13 @@ float CEqRigidBody::ApplyImpulseResponseTo(eqContactPair& pair, float errorCorre
 	const float penetrationImpulse = errorCorrectionFactor * jacDiagABInv;
 	const float velocityImpulse = impulse * jacDiagABInv;
 
-	const float velocityImpulseRest = impulse * combinedRest * jacDiagABInv;
+	// warm impulse overshoot is taken back without restitution
+	const float velocityImpulseRest = (warmImpulse > 0.0f && impulse < 0.0f) ? velocityImpulse : impulse * combinedRest * jacDiagABInv;
+
+	const float normalImpulse = max(0.0f, warmImpulse + penetrationImpulse + velocityImpulse);
+	const float normalImpulseRest = max(0.0f, warmImpulse + penetrationImpulse + velocityImpulseRest) - warmImpulse;
 
-	const float normalImpulse = max(0.0f, penetrationImpulse + velocityImpulse);
-	const float normalImpulseRest = max(0.0f, penetrationImpulse + velocityImpulseRest);
+	pair.accumImpulse = max(0.0f, warmImpulse + velocityImpulse);
 
 	// apply impact based on point velocity
 	const Vector3D impulseVector = contactNormal*normalImpulseRest;
@@ -701,23 +806,14 @@ float CEqRigidBody::ApplyImpulseResponseTo(eqContactPair& pair, float errorCorre
 	const Vector3D frictionImpulse = ComputeFrictionVelocity(contactNormal, contactVelocity, normalImpulse, 
 		denominator, combinedFriction, combinedFriction);
 
-	const int pairFlag = pair.flags;
-
 	// apply now
-	if( bodyADynamic && 
-		!(pairFlag & COLLPAIRFLAG_OBJECTA_NO_RESPONSE) && 
-		!((bodyA->m_flags & BODY_INFINITEMASS) && (bodyB->m_flags & BODY_MOVEABLE)) &&
-		!(bodyB->m_flags & COLLOBJ_DISABLE_RESPONSE) &&
-		!(bodyA->m_flags & BODY_FORCE_FREEZE))
+	if(CanApplyImpulseToA(pair))
 	{
 		static_cast<CEqRigidBody*>(bodyA)->ApplyImpulse(contactRelativePosA, impulseVector - frictionImpulse);
 		static_cast<CEqRigidBody*>(bodyA)->TryWake();
 	}
 
-	if( !(pairFlag & COLLPAIRFLAG_OBJECTB_NO_RESPONSE) && 
-		!((bodyB->m_flags & BODY_INFINITEMASS) && (bodyA->m_flags & BODY_MOVEABLE)) &&
-		!(bodyA->m_flags & COLLOBJ_DISABLE_RESPONSE) &&
-		!(bodyB->m_flags & BODY_FORCE_FREEZE))
+	if(CanApplyImpulseToB(pair))
 	{
 		bodyB->ApplyImpulse(contactRelativePosB, -impulseVector + frictionImpulse);
 		bodyB->TryWake();
@@ -9,6 +9,7 @@
 #include "eqCollision_Object.h"
 
 class IEqPhysicsConstraint;
+struct eqPhysSleepingIsland;
 
 #define BODY_DISABLE_RESPONSE	COLLOBJ_DISABLE_RESPONSE
 #define BODY_COLLISIONLIST		COLLOBJ_COLLISIONLIST
@@ -52,6 +53,29 @@ inline Quaternion AngularVelocityToSpin( const Quaternion& orientation, const Ve
     return vel * orientation;
 }
 
+///
+/// Simulated state of rigid body stored in world snapshots
+/// Positions are fixed point so restored state is bit-exact
+///
+struct eqRigidBodyState
+{
+	FVector3D			position;
+	FVector3D			prevPosition;
+	FVector3D			centerOfMassTrans;
+	Quaternion			orientation;
+	Quaternion			prevOrientation;
+	Vector3D			linearVelocity;
+	Vector3D			angularVelocity;
+	Vector3D			totalForce;
+	Vector3D			totalTorque;
+	Matrix3x3			invInertiaTensor;
+	BoundingBox			aabbTransformed;
+	float				freezeTime;
+	float				frameTimeAccumulator;
+	float				lastFrameTime;
+	int					flags;
+};
+
 //-----------------------------------------------------------------------------------------------------------------------------
 
 ///
@@ -68,6 +92,9 @@ public:
 	/// Simply applies impulse response to single body
 	static float		ApplyImpulseResponseTo(eqContactPair& pair, float error_correction_factor);
 
+	/// Applies normal impulse of previous step stored in pair, normal must be oriented as in ApplyImpulseResponseTo
+	static void			ApplyWarmImpulseTo(const eqContactPair& pair, const Vector3D& contactNormal);
+
 	static void			CopyValues(CEqRigidBody* dest, const CEqRigidBody* src);
 
 	//---------------------------------------------------------------
@@ -124,10 +151,15 @@ public:
 
 	const Matrix3x3&	GetWorldInvInertiaTensor() const;											///< returns world transformed inverse inertia tensor
 
+	void				GetState(eqRigidBodyState& state) const;									///< stores simulated state
+	void				SetState(const eqRigidBodyState& state);									///< restores simulated state, grid cell and island are set up by world
+
 	bool				TryWake( bool velocityCheck = true );										///< tries to wake the body up
 	void				Wake();																		///< unfreezes the body even if it was forced to freeze
 	void				Freeze();																	///< force freezes body and external powers will not wake it up
 	bool				IsFrozen() const;															///< indicates that body has been frozen (forced or timed out)
+	bool				IsSleeping() const { return m_sleepingIsland != nullptr; }					///< body is frozen with it's island and removed from simulation
+	bool				IsReadyToSleep() const;														///< body was slow enough for freeze time
 
 	void				SetMinFrameTime( float time, bool ignoreMotion = true );					///< sets minimal frame time for collision detections
 	float				GetMinFrametime() const;
@@ -151,6 +183,7 @@ protected:
 	void				ComputeInertia(float scale);
 	void				UpdateInertiaTensor();		///< updates inertia tensor
 	void				AccumulateForces(float time);	///< accumulates forces
+	void				QueueIslandWake();
 
 	FixedArray<eqContactPair, 32>			m_contactPairs; // contact pair list in single frame
 	FixedArray<IEqPhysicsConstraint*, 8>	m_constraints;
@@ -183,6 +216,10 @@ protected:
 
 	float				m_freezeTime{ 0.0f };
 
+	eqPhysSleepingIsland*	m_sleepingIsland{ nullptr };
+	CEqRigidBody*		m_sleepingNext{ nullptr };		// next body of sleeping island
+	int					m_islandIndex{ -1 };			// index in moving bodies during step
+
 	float				m_minFrameTime{ 0.0f };
 	float				m_frameTimeAccumulator{ 0.0f };
 	float				m_lastFrameTime{ 0.0f };
@@ -42,6 +42,10 @@ public:
     // been destroyed.
     virtual void	Destroy() = 0;
 
+    // bodies linked by constraint are put into same simulation island
+    virtual CEqRigidBody*	GetBodyA() const { return nullptr; }
+    virtual CEqRigidBody*	GetBodyB() const { return nullptr; }
+
 protected:
     bool			m_enabled{ false };
     bool			m_satisfied{ true };
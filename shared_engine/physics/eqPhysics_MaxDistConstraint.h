@@ -29,6 +29,9 @@ public:
 	bool			Apply(float dt);
 	void			Destroy();
 
+	CEqRigidBody*	GetBodyA() const { return m_body0; }
+	CEqRigidBody*	GetBodyB() const { return m_body1; }
+
 protected:
 	// configuration
 	CEqRigidBody*	m_body0;
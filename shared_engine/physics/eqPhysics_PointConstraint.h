@@ -30,6 +30,9 @@ public:
 	bool			Apply(float dt);
 	void			Destroy();
 
+	CEqRigidBody*	GetBodyA() const { return m_body0; }
+	CEqRigidBody*	GetBodyB() const { return m_body1; }
+
 protected:
 	FVector3D		m_body0Pos;
 	CEqRigidBody*	m_body0;
@@ -0,0 +1,893 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2020
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Physics world snapshots
+//
+//				Body states are copied as is, so rolling back and simulating
+//				same steps again gives bit-exact fixed point positions.
+//				Fields derived from them are recomputed on restore.
+//				Order of moveable list and grid cell lists is stored as well,
+//				since collision detection and solver depend on it.
+//
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "core/core_common.h"
+
+#include "eqPhysics.h"
+#include "eqPhysics_Snapshot.h"
+#include "eqCollision_ObjectGrid.h"
+#include "eqPhysics_Body.h"
+#include "eqPhysics_Contstraint.h"
+
+// manifold record, followed by it's points
+struct eqPhysSnapshotManifold
+{
+	int			objectA;		// body index, or -(static index + 1) when COLLPAIRFLAG_OBJECTA_STATIC
+	int			objectB;		// body index
+	Vector3D	relPosition;
+	Quaternion	relOrientation;
+	int			lastStep;
+	int			flags;
+	int			numPoints;
+};
+
+// removed manifold in delta
+struct eqPhysSnapshotManifoldKey
+{
+	int			objectA;
+	int			objectB;
+};
+
+// body state which can't be derived from other fields
+struct eqPhysSnapshotBody
+{
+	FVector3D	position;
+	FVector3D	prevPosition;
+	Quaternion	orientation;
+	Quaternion	prevOrientation;
+	Vector3D	linearVelocity;
+	Vector3D	angularVelocity;
+	float		freezeTime;
+	float		frameTimeAccumulator;
+	float		lastFrameTime;
+	int			flags;
+};
+
+// forces are usually cleared by integration, only bodies having them are stored
+struct eqPhysSnapshotForce
+{
+	int			body;
+	Vector3D	force;
+	Vector3D	torque;
+};
+
+static constexpr const int PHYSSNAPSHOT_BODY_SIZE = sizeof(eqPhysSnapshotBody);
+
+#define SNAPSHOT_READ_CHECK(expr) \
+	if (!(expr)) { ASSERT_FAIL("RestoreSnapshot - snapshot data is corrupted"); return false; } (void)0
+
+//----------------------------------------------------------------------------------------------------
+
+class CPhysSnapshotWriter
+{
+public:
+	CPhysSnapshotWriter(Array<ubyte>& data) : m_data(data)
+	{
+		m_data.clear(false);
+	}
+
+	template<typename T>
+	void Write(const T* values, int count)
+	{
+		const int size = sizeof(T) * count;
+		if (!size)
+			return;
+
+		const int offset = m_data.numElem();
+		if (offset + size > m_data.numAllocated())
+			m_data.reserve(max(offset + size, m_data.numAllocated() * 2));
+
+		m_data.setNum(offset + size, false);
+		memcpy(m_data.ptr() + offset, values, size);
+	}
+
+	template<typename T>
+	void Write(const T& value) { Write(&value, 1); }
+
+	// value can be filled later
+	template<typename T>
+	int Reserve() { const int offset = m_data.numElem(); Write(T{}); return offset; }
+
+	template<typename T>
+	void WriteAt(int offset, const T& value) { memcpy(m_data.ptr() + offset, &value, sizeof(T)); }
+
+private:
+	Array<ubyte>&	m_data;
+};
+
+class CPhysSnapshotReader
+{
+public:
+	CPhysSnapshotReader(const ubyte* data, int size) : m_cur(data), m_end(data + size) {}
+
+	template<typename T>
+	bool Read(T* values, int count)
+	{
+		const int size = sizeof(T) * count;
+		if (count < 0 || m_end - m_cur < size)
+			return false;
+
+		memcpy(values, m_cur, size);
+		m_cur += size;
+		return true;
+	}
+
+	template<typename T>
+	bool Read(T& value) { return Read(&value, 1); }
+
+	bool AtEnd() const { return m_cur == m_end; }
+
+private:
+	const ubyte*	m_cur;
+	const ubyte*	m_end;
+};
+
+//----------------------------------------------------------------------------------------------------
+
+const eqPhysSnapshotHeader* eqPhysSnapshot::GetHeader() const
+{
+	if (data.numElem() < (int)sizeof(eqPhysSnapshotHeader))
+		return nullptr;
+
+	return reinterpret_cast<const eqPhysSnapshotHeader*>(data.ptr());
+}
+
+bool eqPhysSnapshot::IsValid() const
+{
+	const eqPhysSnapshotHeader* header = GetHeader();
+	return header && header->version == PHYSICS_SNAPSHOT_VERSION;
+}
+
+bool eqPhysSnapshot::IsDelta() const
+{
+	const eqPhysSnapshotHeader* header = GetHeader();
+	return header && (header->flags & PHYSSNAPSHOT_DELTA);
+}
+
+int eqPhysSnapshot::GetStepIndex() const
+{
+	const eqPhysSnapshotHeader* header = GetHeader();
+	return header ? header->stepIndex : -1;
+}
+
+static int PhysSnapshot_MaskWords(int numBodies)
+{
+	return (numBodies + 31) / 32;
+}
+
+// manifold record with it's points in snapshot data
+struct PhysSnapshotManifoldSpan
+{
+	eqPhysSnapshotManifoldKey	key;
+	int							offset;
+	int							size;
+};
+
+// same order as manifolds are written by SaveSnapshot
+static int PhysSnapshot_CompareKeys(const eqPhysSnapshotManifoldKey& a, const eqPhysSnapshotManifoldKey& b)
+{
+	if (a.objectB != b.objectB)
+		return a.objectB < b.objectB ? -1 : 1;
+	if (a.objectA != b.objectA)
+		return a.objectA < b.objectA ? -1 : 1;
+	return 0;
+}
+
+static bool PhysSnapshot_ReadManifolds(const eqPhysSnapshot& snapshot, int offset, int count, FrameArray<PhysSnapshotManifoldSpan>& spans, int& endOffset)
+{
+	const ubyte* data = snapshot.data.ptr();
+	const int size = snapshot.data.numElem();
+
+	if (count > (size - offset) / (int)sizeof(eqPhysSnapshotManifold))
+		return false;
+
+	spans.reserve(count);
+	for (int i = 0; i < count; ++i)
+	{
+		eqPhysSnapshotManifold record;
+		if (offset + (int)sizeof(record) > size)
+			return false;
+		memcpy(&record, data + offset, sizeof(record));
+
+		const int spanSize = sizeof(record) + record.numPoints * sizeof(eqManifoldPoint);
+		if (record.numPoints < 0 || record.numPoints > EQPHYS_MANIFOLD_MAX_POINTS || offset + spanSize > size)
+			return false;
+
+		spans.append({ { record.objectA, record.objectB }, offset, spanSize });
+		offset += spanSize;
+	}
+
+	endOffset = offset;
+	return true;
+}
+
+static bool PhysSnapshot_ReadInt(const eqPhysSnapshot& snapshot, int& offset, int& value)
+{
+	if (offset + (int)sizeof(int) > snapshot.data.numElem())
+		return false;
+
+	memcpy(&value, snapshot.data.ptr() + offset, sizeof(int));
+	offset += sizeof(int);
+	return value >= 0;
+}
+
+void PhysSnapshot_MakeDelta(const eqPhysSnapshot& base, const eqPhysSnapshot& current, eqPhysSnapshot& delta)
+{
+	CFrameAllocScope frameAllocScope;
+
+	ASSERT(base.IsValid() && !base.IsDelta());
+	ASSERT(current.IsValid() && !current.IsDelta());
+
+	const eqPhysSnapshotHeader& baseHeader = *base.GetHeader();
+	const eqPhysSnapshotHeader& curHeader = *current.GetHeader();
+
+	// bodies were added or removed, nothing to refer to
+	if (baseHeader.numBodies != curHeader.numBodies)
+	{
+		delta.data.clear(false);
+		delta.data.append(current.data);
+		return;
+	}
+
+	const int numBodies = curHeader.numBodies;
+	const ubyte* baseBodies = base.data.ptr() + sizeof(eqPhysSnapshotHeader);
+	const ubyte* curBodies = current.data.ptr() + sizeof(eqPhysSnapshotHeader);
+
+	FrameArray<uint> changedMask{ PP_SL };
+	changedMask.setNum(PhysSnapshot_MaskWords(numBodies));
+	memset(changedMask.ptr(), 0, changedMask.numElem() * sizeof(uint));
+
+	int numChanged = 0;
+	for (int i = 0; i < numBodies; ++i)
+	{
+		const int offset = i * PHYSSNAPSHOT_BODY_SIZE;
+		if (!memcmp(baseBodies + offset, curBodies + offset, PHYSSNAPSHOT_BODY_SIZE))
+			continue;
+
+		changedMask[i >> 5] |= 1u << (i & 31);
+		++numChanged;
+	}
+
+	FrameArray<PhysSnapshotManifoldSpan> baseManifolds{ PP_SL };
+	FrameArray<PhysSnapshotManifoldSpan> curManifolds{ PP_SL };
+	{
+		int baseOffset = baseHeader.manifoldsOffset;
+		int curOffset = curHeader.manifoldsOffset;
+		int numBaseManifolds, numCurManifolds, endOffset;
+
+		const bool isValid = PhysSnapshot_ReadInt(base, baseOffset, numBaseManifolds)
+			&& PhysSnapshot_ReadManifolds(base, baseOffset, numBaseManifolds, baseManifolds, endOffset)
+			&& PhysSnapshot_ReadInt(current, curOffset, numCurManifolds)
+			&& PhysSnapshot_ReadManifolds(current, curOffset, numCurManifolds, curManifolds, endOffset);
+
+		if (!isValid)
+		{
+			ASSERT_FAIL("PhysSnapshot_MakeDelta - snapshot data is corrupted");
+			delta.data.clear(false);
+			delta.data.append(current.data);
+			return;
+		}
+	}
+
+	// both lists are sorted, unchanged manifolds of sleeping and resting bodies are skipped
+	FrameArray<eqPhysSnapshotManifoldKey> removedManifolds{ PP_SL };
+	FrameArray<const PhysSnapshotManifoldSpan*> storedManifolds{ PP_SL };
+	{
+		int baseIdx = 0;
+		int curIdx = 0;
+		while (baseIdx < baseManifolds.numElem() || curIdx < curManifolds.numElem())
+		{
+			const PhysSnapshotManifoldSpan* baseSpan = baseIdx < baseManifolds.numElem() ? &baseManifolds[baseIdx] : nullptr;
+			const PhysSnapshotManifoldSpan* curSpan = curIdx < curManifolds.numElem() ? &curManifolds[curIdx] : nullptr;
+			const int cmp = !baseSpan ? 1 : (!curSpan ? -1 : PhysSnapshot_CompareKeys(baseSpan->key, curSpan->key));
+
+			if (cmp < 0)
+			{
+				removedManifolds.append(baseSpan->key);
+				++baseIdx;
+				continue;
+			}
+
+			if (cmp > 0 || baseSpan->size != curSpan->size || memcmp(base.data.ptr() + baseSpan->offset, current.data.ptr() + curSpan->offset, curSpan->size))
+				storedManifolds.append(curSpan);
+
+			curIdx++;
+			if (cmp == 0)
+				++baseIdx;
+		}
+	}
+
+	eqPhysSnapshotHeader header = curHeader;
+	header.flags |= PHYSSNAPSHOT_DELTA;
+	header.baseStepIndex = baseHeader.stepIndex;
+	header.numStoredBodies = numChanged;
+
+	CPhysSnapshotWriter writer(delta.data);
+	const int headerOffset = writer.Reserve<eqPhysSnapshotHeader>();
+	writer.Write(changedMask.ptr(), changedMask.numElem());
+
+	for (int i = 0; i < numBodies; ++i)
+	{
+		if (changedMask[i >> 5] & (1u << (i & 31)))
+			writer.Write(curBodies + i * PHYSSNAPSHOT_BODY_SIZE, PHYSSNAPSHOT_BODY_SIZE);
+	}
+
+	const int worldOffset = sizeof(eqPhysSnapshotHeader) + numBodies * PHYSSNAPSHOT_BODY_SIZE;
+	writer.Write(current.data.ptr() + worldOffset, curHeader.manifoldsOffset - worldOffset);
+
+	header.manifoldsOffset = delta.data.numElem();
+	writer.Write(removedManifolds.numElem());
+	writer.Write(removedManifolds.ptr(), removedManifolds.numElem());
+
+	writer.Write(storedManifolds.numElem());
+	for (const PhysSnapshotManifoldSpan* span : storedManifolds)
+		writer.Write(current.data.ptr() + span->offset, span->size);
+
+	writer.WriteAt(headerOffset, header);
+}
+
+bool PhysSnapshot_ApplyDelta(const eqPhysSnapshot& base, const eqPhysSnapshot& delta, eqPhysSnapshot& result)
+{
+	if (!base.IsValid() || base.IsDelta() || !delta.IsValid())
+	{
+		ASSERT_FAIL("PhysSnapshot_ApplyDelta - invalid snapshots");
+		return false;
+	}
+
+	// full snapshot was stored instead
+	if (!delta.IsDelta())
+	{
+		if (&result != &delta)
+		{
+			result.data.clear(false);
+			result.data.append(delta.data);
+		}
+		return true;
+	}
+
+	const eqPhysSnapshotHeader& baseHeader = *base.GetHeader();
+	const eqPhysSnapshotHeader& deltaHeader = *delta.GetHeader();
+
+	if (baseHeader.stepIndex != deltaHeader.baseStepIndex || baseHeader.numBodies != deltaHeader.numBodies)
+	{
+		ASSERT_FAIL("PhysSnapshot_ApplyDelta - delta was made against another base snapshot");
+		return false;
+	}
+
+	ASSERT_MSG(&result != &base && &result != &delta, "PhysSnapshot_ApplyDelta - result must be a separate snapshot");
+
+	CFrameAllocScope frameAllocScope;
+
+	const int numBodies = deltaHeader.numBodies;
+	const int maskWords = PhysSnapshot_MaskWords(numBodies);
+
+	const uint* changedMask = reinterpret_cast<const uint*>(delta.data.ptr() + sizeof(eqPhysSnapshotHeader));
+	const ubyte* changedBodies = delta.data.ptr() + sizeof(eqPhysSnapshotHeader) + maskWords * sizeof(uint);
+	const ubyte* baseBodies = base.data.ptr() + sizeof(eqPhysSnapshotHeader);
+
+	const int worldOffset = sizeof(eqPhysSnapshotHeader) + maskWords * sizeof(uint) + deltaHeader.numStoredBodies * PHYSSNAPSHOT_BODY_SIZE;
+
+	FrameArray<PhysSnapshotManifoldSpan> baseManifolds{ PP_SL };
+	FrameArray<PhysSnapshotManifoldSpan> storedManifolds{ PP_SL };
+	FrameArray<eqPhysSnapshotManifoldKey> removedManifolds{ PP_SL };
+	{
+		int baseOffset = baseHeader.manifoldsOffset;
+		int deltaOffset = deltaHeader.manifoldsOffset;
+		int numBaseManifolds, numRemoved, numStored, endOffset;
+
+		bool isValid = worldOffset <= deltaOffset
+			&& PhysSnapshot_ReadInt(base, baseOffset, numBaseManifolds)
+			&& PhysSnapshot_ReadManifolds(base, baseOffset, numBaseManifolds, baseManifolds, endOffset)
+			&& PhysSnapshot_ReadInt(delta, deltaOffset, numRemoved)
+			&& deltaOffset + numRemoved * (int)sizeof(eqPhysSnapshotManifoldKey) <= delta.data.numElem();
+
+		if (isValid)
+		{
+			removedManifolds.setNum(numRemoved);
+			memcpy(removedManifolds.ptr(), delta.data.ptr() + deltaOffset, numRemoved * sizeof(eqPhysSnapshotManifoldKey));
+			deltaOffset += numRemoved * sizeof(eqPhysSnapshotManifoldKey);
+
+			isValid = PhysSnapshot_ReadInt(delta, deltaOffset, numStored)
+				&& PhysSnapshot_ReadManifolds(delta, deltaOffset, numStored, storedManifolds, endOffset)
+				&& endOffset == delta.data.numElem();
+		}
+
+		if (!isValid)
+		{
+			ASSERT_FAIL("PhysSnapshot_ApplyDelta - delta is truncated");
+			return false;
+		}
+	}
+
+	eqPhysSnapshotHeader header = deltaHeader;
+	header.flags &= ~PHYSSNAPSHOT_DELTA;
+	header.baseStepIndex = 0;
+	header.numStoredBodies = numBodies;
+
+	CPhysSnapshotWriter writer(result.data);
+	const int headerOffset = writer.Reserve<eqPhysSnapshotHeader>();
+
+	for (int i = 0; i < numBodies; ++i)
+	{
+		if (changedMask[i >> 5] & (1u << (i & 31)))
+		{
+			writer.Write(changedBodies, PHYSSNAPSHOT_BODY_SIZE);
+			changedBodies += PHYSSNAPSHOT_BODY_SIZE;
+		}
+		else
+			writer.Write(baseBodies + i * PHYSSNAPSHOT_BODY_SIZE, PHYSSNAPSHOT_BODY_SIZE);
+	}
+
+	writer.Write(delta.data.ptr() + worldOffset, deltaHeader.manifoldsOffset - worldOffset);
+	header.manifoldsOffset = result.data.numElem();
+
+	// merge base manifolds with stored ones in the same order
+	const int numManifoldsOffset = writer.Reserve<int>();
+	int numManifolds = 0;
+	int baseIdx = 0;
+	int storedIdx = 0;
+	int removedIdx = 0;
+	while (baseIdx < baseManifolds.numElem() || storedIdx < storedManifolds.numElem())
+	{
+		const PhysSnapshotManifoldSpan* baseSpan = baseIdx < baseManifolds.numElem() ? &baseManifolds[baseIdx] : nullptr;
+		const PhysSnapshotManifoldSpan* storedSpan = storedIdx < storedManifolds.numElem() ? &storedManifolds[storedIdx] : nullptr;
+		const int cmp = !baseSpan ? 1 : (!storedSpan ? -1 : PhysSnapshot_CompareKeys(baseSpan->key, storedSpan->key));
+
+		if (cmp >= 0)
+		{
+			writer.Write(delta.data.ptr() + storedSpan->offset, storedSpan->size);
+			++numManifolds;
+			++storedIdx;
+			if (cmp == 0)
+				++baseIdx;
+			continue;
+		}
+
+		while (removedIdx < removedManifolds.numElem() && PhysSnapshot_CompareKeys(removedManifolds[removedIdx], baseSpan->key) < 0)
+			++removedIdx;
+
+		const bool isRemoved = removedIdx < removedManifolds.numElem() && PhysSnapshot_CompareKeys(removedManifolds[removedIdx], baseSpan->key) == 0;
+		if (!isRemoved)
+		{
+			writer.Write(base.data.ptr() + baseSpan->offset, baseSpan->size);
+			++numManifolds;
+		}
+		++baseIdx;
+	}
+
+	writer.WriteAt(numManifoldsOffset, numManifolds);
+	writer.WriteAt(headerOffset, header);
+	return true;
+}
+
+//----------------------------------------------------------------------------------------------------
+
+// ghost objects are stored as negative indices in cell lists
+static int SnapshotGhostRef(int ghostIndex)
+{
+	return -(ghostIndex + 1);
+}
+
+void CEqPhysics::SaveSnapshot(eqPhysSnapshot& snapshot)
+{
+	CFrameAllocScope frameAllocScope;
+
+	const int numBodies = m_dynObjects.numElem();
+
+	eqPhysSnapshotHeader header;
+	header.stepIndex = m_stepIndex;
+	header.numBodies = numBodies;
+	header.numStaticObjects = m_staticObjects.numElem();
+	header.numGhostObjects = m_ghostObjects.numElem();
+	header.numConstraints = m_constraints.numElem();
+	header.numStoredBodies = numBodies;
+
+	CPhysSnapshotWriter writer(snapshot.data);
+	writer.Write(header);
+
+	// island index is only used during step, here it's an index in snapshot
+	int numForces = 0;
+	for (int i = 0; i < numBodies; ++i)
+	{
+		CEqRigidBody* body = m_dynObjects[i];
+		body->m_islandIndex = i;
+
+		eqPhysSnapshotBody record;
+		memset(&record, 0, sizeof(record));
+		record.position = body->m_position;
+		record.prevPosition = body->m_prevPosition;
+		record.orientation = body->m_orientation;
+		record.prevOrientation = body->m_prevOrientation;
+		record.linearVelocity = body->m_linearVelocity;
+		record.angularVelocity = body->m_angularVelocity;
+		record.freezeTime = body->m_freezeTime;
+		record.frameTimeAccumulator = body->m_frameTimeAccumulator;
+		record.lastFrameTime = body->m_lastFrameTime;
+		record.flags = body->m_flags;
+		writer.Write(record);
+
+		if (body->m_totalForce != vec3_zero || body->m_totalTorque != vec3_zero)
+			++numForces;
+	}
+
+	writer.Write(numForces);
+	for (int i = 0; i < numBodies && numForces; ++i)
+	{
+		const CEqRigidBody* body = m_dynObjects[i];
+		if (body->m_totalForce == vec3_zero && body->m_totalTorque == vec3_zero)
+			continue;
+
+		eqPhysSnapshotForce record;
+		record.body = i;
+		record.force = body->m_totalForce;
+		record.torque = body->m_totalTorque;
+		writer.Write(record);
+	}
+
+	// moveable list
+	writer.Write(m_moveable.numElem());
+	for (const CEqRigidBody* body : m_moveable)
+		writer.Write(body->m_islandIndex);
+
+	// sleeping islands, ones queued to wake go first as they are in m_wakeIslands
+	const int numIslandsOffset = writer.Reserve<int>();
+	writer.Write(m_wakeIslands.numElem());
+
+	int numSleepingIslands = 0;
+	auto writeIsland = [&](const eqPhysSleepingIsland* island) {
+		writer.Write(island->numBodies);
+		for (const CEqRigidBody* body = island->firstBody; body; body = body->m_sleepingNext)
+			writer.Write(body->m_islandIndex);
+		++numSleepingIslands;
+	};
+
+	for (const eqPhysSleepingIsland* island : m_wakeIslands)
+		writeIsland(island);
+
+	for (const CEqRigidBody* body : m_dynObjects)
+	{
+		const eqPhysSleepingIsland* island = body->m_sleepingIsland;
+		if (island && !island->wakeQueued && island->firstBody == body)
+			writeIsland(island);
+	}
+	writer.WriteAt(numIslandsOffset, numSleepingIslands);
+
+	// constraints
+	for (const IEqPhysicsConstraint* constraint : m_constraints)
+		writer.Write<ubyte>(constraint->IsEnabled() ? 1 : 0);
+
+	// grid cell lists, each list is written once from it's first object
+	const int numCellsOffset = writer.Reserve<int>();
+	int numCells = 0;
+	auto writeCell = [&](const CEqCollisionObject* first) {
+		const eqPhysGridCell* cell = first->GetCell();
+		writer.Write(cell->index);
+		writer.Write(cell->dynamicObjList.getCount());
+		for (const CEqCollisionObject* obj = first; obj; obj = obj->next)
+		{
+			if (obj->IsDynamic())
+				writer.Write(static_cast<const CEqRigidBody*>(obj)->m_islandIndex);
+			else
+				writer.Write(SnapshotGhostRef(arrayFindIndex(m_ghostObjects, obj)));
+		}
+		++numCells;
+	};
+
+	for (const CEqRigidBody* body : m_dynObjects)
+	{
+		if (body->GetCell() && body->GetCell()->dynamicObjList.getFirst() == body)
+			writeCell(body);
+	}
+
+	for (const CEqCollisionObject* ghost : m_ghostObjects)
+	{
+		if (ghost->GetCell() && ghost->GetCell()->dynamicObjList.getFirst() == ghost)
+			writeCell(ghost);
+	}
+	writer.WriteAt(numCellsOffset, numCells);
+
+	header.manifoldsOffset = snapshot.data.numElem();
+	writer.WriteAt(0, header);
+
+	// manifolds are sorted by objects so snapshots of same state are identical
+	FrameArray<eqPhysSnapshotManifold> manifolds{ PP_SL };
+	FrameArray<const eqContactManifold*> manifoldPtrs{ PP_SL };
+	manifolds.reserve(m_manifolds.size());
+	manifoldPtrs.reserve(m_manifolds.size());
+
+	bool staticIdsReady = false;
+	for (const eqContactManifold* manifold : m_manifolds)
+	{
+		int objectA;
+		if (manifold->flags & COLLPAIRFLAG_OBJECTA_STATIC)
+		{
+			if (!staticIdsReady)
+			{
+				m_snapshotStaticIds.clear(false);
+				for (int i = 0; i < m_staticObjects.numElem(); ++i)
+					m_snapshotStaticIds.insert(m_staticObjects[i], i);
+				staticIdsReady = true;
+			}
+
+			auto it = m_snapshotStaticIds.find(manifold->bodyA);
+			ASSERT_MSG(!it.atEnd(), "SaveSnapshot - manifold of object not in world");
+			objectA = -(*it + 1);
+		}
+		else
+			objectA = static_cast<const CEqRigidBody*>(manifold->bodyA)->m_islandIndex;
+
+		eqPhysSnapshotManifold& record = manifolds.append();
+		memset(&record, 0, sizeof(record));
+		record.objectA = objectA;
+		record.objectB = static_cast<const CEqRigidBody*>(manifold->bodyB)->m_islandIndex;
+		record.relPosition = manifold->relPosition;
+		record.relOrientation = manifold->relOrientation;
+		record.lastStep = manifold->lastStep;
+		record.flags = manifold->flags;
+		record.numPoints = manifold->points.numElem();
+		manifoldPtrs.append(manifold);
+	}
+
+	FrameArray<int> order{ PP_SL };
+	order.setNum(manifolds.numElem());
+	for (int i = 0; i < order.numElem(); ++i)
+		order[i] = i;
+
+	arraySort(order, [&](int a, int b) {
+		const eqPhysSnapshotManifold& ma = manifolds[a];
+		const eqPhysSnapshotManifold& mb = manifolds[b];
+		if (ma.objectB != mb.objectB)
+			return ma.objectB - mb.objectB;
+		return ma.objectA - mb.objectA;
+	});
+
+	writer.Write(manifolds.numElem());
+	for (int idx : order)
+	{
+		writer.Write(manifolds[idx]);
+		writer.Write(manifoldPtrs[idx]->points.ptr(), manifoldPtrs[idx]->points.numElem());
+	}
+
+	for (CEqRigidBody* body : m_dynObjects)
+		body->m_islandIndex = -1;
+}
+
+bool CEqPhysics::RestoreSnapshot(const eqPhysSnapshot& snapshot)
+{
+	if (!snapshot.IsValid() || snapshot.IsDelta())
+	{
+		ASSERT_FAIL("RestoreSnapshot - snapshot is not valid or it's a delta");
+		return false;
+	}
+
+	CFrameAllocScope frameAllocScope;
+
+	const eqPhysSnapshotHeader& header = *snapshot.GetHeader();
+	if (header.numBodies != m_dynObjects.numElem() ||
+		header.numStaticObjects != m_staticObjects.numElem() ||
+		header.numGhostObjects != m_ghostObjects.numElem() ||
+		header.numConstraints != m_constraints.numElem())
+	{
+		ASSERT_FAIL("RestoreSnapshot - world objects were changed since snapshot was made");
+		return false;
+	}
+
+	const int numBodies = m_dynObjects.numElem();
+	CPhysSnapshotReader reader(snapshot.data.ptr() + sizeof(eqPhysSnapshotHeader), snapshot.data.numElem() - sizeof(eqPhysSnapshotHeader));
+
+	auto readBody = [&](CEqRigidBody*& body) {
+		int index;
+		if (!reader.Read(index) || index < 0 || index >= numBodies)
+			return false;
+
+		body = m_dynObjects[index];
+		return true;
+	};
+
+	// drop contacts and caches of current state
+	for (eqContactManifold* manifold : m_manifolds)
+	{
+		manifold->~eqContactManifold();
+		m_manifoldPool.deallocate(manifold);
+	}
+	m_manifolds.clear(false);
+
+	{
+		FrameArray<eqPhysSleepingIsland*> islands{ PP_SL };
+		islands.append(m_wakeIslands);
+		for (const CEqRigidBody* body : m_dynObjects)
+		{
+			eqPhysSleepingIsland* island = body->m_sleepingIsland;
+			if (island && !island->wakeQueued && island->firstBody == body)
+				islands.append(island);
+		}
+
+		for (eqPhysSleepingIsland* island : islands)
+		{
+			island->~eqPhysSleepingIsland();
+			m_sleepingIslandPool.deallocate(island);
+		}
+		m_wakeIslands.clear(false);
+		m_numSleepingBodies = 0;
+	}
+
+	// bodies
+	for (CEqRigidBody* body : m_dynObjects)
+	{
+		eqPhysSnapshotBody record;
+		SNAPSHOT_READ_CHECK(reader.Read(record));
+
+		body->ClearContacts();
+		body->m_position = record.position;
+		body->m_prevPosition = record.prevPosition;
+		body->m_orientation = record.orientation;
+		body->m_prevOrientation = record.prevOrientation;
+		body->m_linearVelocity = record.linearVelocity;
+		body->m_angularVelocity = record.angularVelocity;
+		body->m_freezeTime = record.freezeTime;
+		body->m_frameTimeAccumulator = record.frameTimeAccumulator;
+		body->m_lastFrameTime = record.lastFrameTime;
+		body->m_totalForce = vec3_zero;
+		body->m_totalTorque = vec3_zero;
+		body->UpdateInertiaTensor();
+
+		// bounds are computed again only if they were up to date, render matrix is not stored
+		body->m_flags = record.flags | COLLOBJ_BOUNDBOX_DIRTY | COLLOBJ_TRANSFORM_DIRTY;
+		if (!(record.flags & COLLOBJ_BOUNDBOX_DIRTY))
+			body->UpdateBoundingBoxTransform();
+
+		body->m_sleepingIsland = nullptr;
+		body->m_sleepingNext = nullptr;
+		body->m_islandIndex = -1;
+	}
+
+	int numForces;
+	SNAPSHOT_READ_CHECK(reader.Read(numForces) && numForces >= 0 && numForces <= numBodies);
+	for (int i = 0; i < numForces; ++i)
+	{
+		eqPhysSnapshotForce record;
+		SNAPSHOT_READ_CHECK(reader.Read(record) && record.body >= 0 && record.body < numBodies);
+
+		m_dynObjects[record.body]->m_totalForce = record.force;
+		m_dynObjects[record.body]->m_totalTorque = record.torque;
+	}
+
+	int numMoveable;
+	SNAPSHOT_READ_CHECK(reader.Read(numMoveable) && numMoveable >= 0 && numMoveable <= numBodies);
+
+	m_moveable.setNum(numMoveable, false);
+	for (int i = 0; i < numMoveable; ++i)
+		SNAPSHOT_READ_CHECK(readBody(m_moveable[i]));
+
+	// sleeping islands
+	int numSleepingIslands, numWakeIslands;
+	SNAPSHOT_READ_CHECK(reader.Read(numSleepingIslands) && reader.Read(numWakeIslands));
+
+	for (int i = 0; i < numSleepingIslands; ++i)
+	{
+		eqPhysSleepingIsland* island = m_sleepingIslandPool.allocate();
+		new(island) eqPhysSleepingIsland();
+		island->world = this;
+
+		if (i < numWakeIslands)
+		{
+			island->wakeQueued = true;
+			m_wakeIslands.append(island);
+		}
+
+		SNAPSHOT_READ_CHECK(reader.Read(island->numBodies));
+
+		CEqRigidBody** link = &island->firstBody;
+		for (int j = 0; j < island->numBodies; ++j)
+		{
+			CEqRigidBody* body;
+			SNAPSHOT_READ_CHECK(readBody(body));
+
+			body->m_sleepingIsland = island;
+			*link = body;
+			link = &body->m_sleepingNext;
+		}
+		m_numSleepingBodies += island->numBodies;
+	}
+
+	// constraints
+	for (IEqPhysicsConstraint* constraint : m_constraints)
+	{
+		ubyte enabled;
+		SNAPSHOT_READ_CHECK(reader.Read(enabled));
+		constraint->SetEnabled(enabled);
+	}
+
+	// grid cells
+	int numCells;
+	SNAPSHOT_READ_CHECK(reader.Read(numCells));
+
+	auto unlinkFromCell = [](CEqCollisionObject* obj) {
+		eqPhysGridCell* cell = obj->GetCell();
+		if (!cell)
+			return;
+
+		cell->dynamicObjList.unlinkNode(obj);
+		obj->SetCell(nullptr);
+	};
+
+	if (m_grid)
+	{
+		for (CEqRigidBody* body : m_dynObjects)
+			unlinkFromCell(body);
+
+		for (CEqCollisionObject* ghost : m_ghostObjects)
+		{
+			if (!ghost->GetMesh())
+				unlinkFromCell(ghost);
+		}
+	}
+
+	for (int i = 0; i < numCells; ++i)
+	{
+		int cellIdx, numObjects;
+		SNAPSHOT_READ_CHECK(reader.Read(cellIdx) && reader.Read(numObjects));
+
+		eqPhysGridCell* cell = m_grid ? m_grid->GetPreallocatedCellByIndex(cellIdx) : nullptr;
+		for (int j = 0; j < numObjects; ++j)
+		{
+			int ref;
+			SNAPSHOT_READ_CHECK(reader.Read(ref) && ref < numBodies && -ref <= m_ghostObjects.numElem());
+
+			if (!cell)
+				continue;
+
+			CEqCollisionObject* obj = ref >= 0 ? static_cast<CEqCollisionObject*>(m_dynObjects[ref]) : m_ghostObjects[-ref - 1];
+			cell->dynamicObjList.insertNodeLast(obj);
+			obj->SetCell(cell);
+		}
+	}
+
+	// contact manifolds
+	int numManifolds;
+	SNAPSHOT_READ_CHECK(reader.Read(numManifolds));
+
+	for (int i = 0; i < numManifolds; ++i)
+	{
+		eqPhysSnapshotManifold record;
+		SNAPSHOT_READ_CHECK(reader.Read(record));
+
+		CEqCollisionObject* bodyA;
+		if (record.flags & COLLPAIRFLAG_OBJECTA_STATIC)
+		{
+			SNAPSHOT_READ_CHECK(record.objectA < 0 && -record.objectA <= m_staticObjects.numElem());
+			bodyA = m_staticObjects[-record.objectA - 1];
+		}
+		else
+		{
+			SNAPSHOT_READ_CHECK(record.objectA >= 0 && record.objectA < numBodies);
+			bodyA = m_dynObjects[record.objectA];
+		}
+
+		SNAPSHOT_READ_CHECK(record.objectB >= 0 && record.objectB < numBodies && record.numPoints >= 0 && record.numPoints <= EQPHYS_MANIFOLD_MAX_POINTS);
+
+		eqContactManifold* manifold = CreateManifold(bodyA, m_dynObjects[record.objectB], record.flags);
+		manifold->relPosition = record.relPosition;
+		manifold->relOrientation = record.relOrientation;
+		manifold->lastStep = record.lastStep;
+
+		manifold->points.setNum(record.numPoints);
+		SNAPSHOT_READ_CHECK(reader.Read(manifold->points.ptr(), record.numPoints));
+	}
+
+	m_stepIndex = header.stepIndex;
+
+	ASSERT(reader.AtEnd());
+	return true;
+}
@@ -0,0 +1,67 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2020
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Physics world snapshots
+//				Simulation state stored in a single contiguous buffer
+//				for client-side prediction and server rewind
+//////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+static constexpr const int PHYSICS_SNAPSHOT_VERSION = 2;
+
+enum EPhysSnapshotFlags
+{
+	PHYSSNAPSHOT_DELTA = (1 << 0),		// only bodies and manifolds changed since base snapshot are stored
+};
+
+//
+// Snapshot layout:
+//		eqPhysSnapshotHeader
+//		delta only: bit mask of changed bodies, uint per 32 bodies
+//		body state for each body in world order (or changed bodies in delta)
+//		world section:
+//			forces and torques of bodies which have them
+//			moveable list as body indices
+//			sleeping islands: queued to wake first, body indices in island order
+//			constraint enabled states
+//			grid cells with their dynamic object order
+//		contact manifolds with their points, sorted by body indices
+//		delta only: pairs of removed manifolds go first, stored ones are new or changed
+//
+// Objects are referenced by indices, so snapshot can only be restored
+// to the world which has the same bodies, static and ghost objects and constraints.
+// Body mass, shape, factors and controllers are not a part of snapshot.
+// Inertia tensor and bounds are computed from body orientation on restore.
+//
+struct eqPhysSnapshotHeader
+{
+	int		version{ PHYSICS_SNAPSHOT_VERSION };
+	int		flags{ 0 };
+	int		stepIndex{ 0 };
+	int		baseStepIndex{ 0 };			// step index of base snapshot if delta
+	int		numBodies{ 0 };
+	int		numStaticObjects{ 0 };
+	int		numGhostObjects{ 0 };
+	int		numConstraints{ 0 };
+	int		numStoredBodies{ 0 };		// less than numBodies in delta
+	int		manifoldsOffset{ 0 };		// of manifold section in snapshot data
+};
+
+struct eqPhysSnapshot
+{
+	Array<ubyte>	data{ PP_SL };
+
+	const eqPhysSnapshotHeader*	GetHeader() const;
+
+	bool			IsValid() const;
+	bool			IsDelta() const;
+	int				GetStepIndex() const;
+};
+
+// stores bodies of current snapshot that differ from base one
+void	PhysSnapshot_MakeDelta(const eqPhysSnapshot& base, const eqPhysSnapshot& current, eqPhysSnapshot& delta);
+
+// reconstructs full snapshot from base and delta made against it
+bool	PhysSnapshot_ApplyDelta(const eqPhysSnapshot& base, const eqPhysSnapshot& delta, eqPhysSnapshot& result);
@@ -10,7 +10,7 @@
 enum EDecalMakeFlags
 {
 	DECAL_MAKE_FLAG_TEX_NORMAL	= (1 << 0),		// texture coordinates by normal
-	DECAL_MAKE_FLAG_CLIPPING	= (1 << 1),		// not supported on EGFs
+	DECAL_MAKE_FLAG_CLIPPING	= (1 << 1),		// clip geometry by decal box
 };
 
 class IMaterial;
@@ -45,7 +45,7 @@ struct DecalData : public RefCountedObject<DecalData>
 
 	BoundingBox			bbox;
 	IMaterialPtr		material;
-	void*				verts{ nullptr };
+	void*				verts{ nullptr };	// studio decals: PositionUV, TBN and BoneWeights streams of numVerts each
 	uint16*				indices{ nullptr };
 	
 	uint16				numVerts{ 0 };
@@ -60,10 +60,10 @@ void CEffectRenderer::DrawEffects(float dt)
 
 	CScopedMutex m(s_effectRenderMutex);
 
-	// sort particles
-	arraySort(m_effectList, [](IEffect* effect0, IEffect* effect1)
+	// sort particles from furthest to closest
+	arrayRadixSort(m_effectList, m_sortTemp, [](IEffect* effect)
 	{
-		return sortCompare(effect1->GetDistanceToCamera(), effect0->GetDistanceToCamera());
+		return -effect->GetDistanceToCamera();
 	});
 
 	for(int i = 0; i < m_effectList.numElem(); i++)
@@ -61,6 +61,7 @@ protected:
 
 private:
 	FixedArray<IEffect*, MAX_VISIBLE_EFFECTS>	m_effectList;
+	FixedArray<IEffect*, MAX_VISIBLE_EFFECTS>	m_sortTemp;
 	Vector3D	m_viewPos{ vec3_zero };
 };
 
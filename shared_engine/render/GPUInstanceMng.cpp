@@ -255,11 +255,8 @@ static void instPrepareDataBuffer(IGPUCommandRecorder* cmdRecorder, ArrayCRef<in
 	const int updatedCount = elementIds.numElem();
 	const int updateBufferSize = updatedCount * elemSize;
 
-	ubyte* updateData = reinterpret_cast<ubyte*>(PPAlloc(updateBufferSize));
+	ubyte* updateData = FrameAllocStructArray(ubyte, updateBufferSize);
 	ubyte* updateDataStart = updateData;
-	defer{
-		PPFree(updateDataStart);
-	};
 
 	// as GPU does not like unaligned access, we put updated elements in separate buffer
 	for (const int elemIdx : elementIds)
@@ -274,7 +271,7 @@ static void instPrepareDataBuffer(IGPUCommandRecorder* cmdRecorder, ArrayCRef<in
 }
 
 // prepare data and indices
-static void instPrepareBuffers(IGPUCommandRecorder* cmdRecorder, const Set<int>& updated, Array<int>& elementIds, const ubyte* sourceData, int sourceStride, int elemSize, IGPUBufferPtr& destIdxsBuffer, IGPUBufferPtr& destDataBuffer)
+static void instPrepareBuffers(IGPUCommandRecorder* cmdRecorder, const Set<int>& updated, FrameArray<int>& elementIds, const ubyte* sourceData, int sourceStride, int elemSize, IGPUBufferPtr& destIdxsBuffer, IGPUBufferPtr& destDataBuffer)
 {
 	ASSERT(elemSize <= sourceStride);
 
@@ -287,11 +284,8 @@ static void instPrepareBuffers(IGPUCommandRecorder* cmdRecorder, const Set<int>&
 	// always insert count as first element (sourceCount)
 	elementIds.append(updatedCount);
 
-	ubyte* updateData = reinterpret_cast<ubyte*>(PPAlloc(updateBufferSize));
+	ubyte* updateData = FrameAllocStructArray(ubyte, updateBufferSize);
 	ubyte* updateDataStart = updateData;
-	defer{
-		PPFree(updateDataStart);
-	};
 
 	// as GPU does not like unaligned access, we put updated elements in separate buffer
 	for (auto it = updated.begin(); !it.atEnd(); ++it)
@@ -317,7 +311,9 @@ void GPUBaseInstanceManager::SyncInstances(IGPUCommandRecorder* cmdRecorder)
 
 	Threading::CScopedMutex m(m_mutex);
 
-	Array<int> elementIds(PP_SL);
+	// update data is copied by command recorder
+	CFrameAllocScope frameAllocScope;
+	FrameArray<int> elementIds(PP_SL);
 
 	{
 		const int oldBufferElems = m_rootBuffer ? m_rootBuffer->GetSize() / sizeof(InstRoot) : 0;
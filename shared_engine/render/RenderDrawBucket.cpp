@@ -0,0 +1,328 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2024
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Draw command bucket.
+//				Records draw commands with sort keys and submits them
+//				ordered to minimize pipeline, material and buffer changes
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "core/core_common.h"
+#include "core/ConVar.h"
+#include "core/IEqParallelJobs.h"
+#include "materialsystem1/IMaterialSystem.h"
+#include "render/IDebugOverlay.h"
+#include "RenderDrawBucket.h"
+
+DECLARE_CVAR(r_drawBucketStats, "0", "Show draw bucket statistics", CV_CHEAT);
+DECLARE_CVAR(r_drawBucketSort, "1", "Enable draw bucket state sorting", CV_CHEAT);
+DECLARE_CVAR(r_drawBucketParallel, "1", "Record large draw bucket passes on job threads", CV_ARCHIVE);
+DECLARE_CVAR(r_drawBucketParallelMinDraws, "256", "Minimal number of draws recorded by single job", CV_ARCHIVE);
+
+static constexpr const int DRAWBUCKET_PASS_BITS		= 4;
+static constexpr const int DRAWBUCKET_PIPELINE_BITS	= 16;
+static constexpr const int DRAWBUCKET_MATERIAL_BITS	= 16;
+static constexpr const int DRAWBUCKET_BUFFERS_BITS	= 12;
+static constexpr const int DRAWBUCKET_DEPTH_BITS	= 16;
+
+static_assert(DRAWBUCKET_PASS_BITS + DRAWBUCKET_PIPELINE_BITS + DRAWBUCKET_MATERIAL_BITS + DRAWBUCKET_BUFFERS_BITS + DRAWBUCKET_DEPTH_BITS == 64, "sort key must be 64 bits");
+static_assert(DRAWBUCKET_MAX_PASSES == (1 << DRAWBUCKET_PASS_BITS), "pass bits mismatch");
+
+static constexpr const int DRAWBUCKET_RADIX_BITS	= 8;
+static constexpr const int DRAWBUCKET_RADIX_SIZE	= 1 << DRAWBUCKET_RADIX_BITS;
+static constexpr const int DRAWBUCKET_RADIX_PASSES	= 64 / DRAWBUCKET_RADIX_BITS;
+
+// folds hash to specified bit count
+static inline uint64 DrawKeyFoldBits(uint64 value, int bits)
+{
+	return (value * 0x9E3779B97F4A7C15ULL) >> (64 - bits);
+}
+
+static inline uint64 DrawKeyHashCombine(uint64 hash, uint64 value)
+{
+	return hash ^ (value + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2));
+}
+
+// records range of sorted draw commands into render bundle
+class CRenderDrawBucket::CRecordBundleJob : public IParallelJob
+{
+public:
+	CRecordBundleJob()
+		: IParallelJob("RecordDrawBundle")
+	{
+		InitSignal();
+	}
+
+	void Execute() override
+	{
+		g_matSystem->SetupDrawCommands(m_drawCmds, m_passContext, &m_stats);
+		m_bundle->Complete();
+	}
+
+	RenderPassContext				m_passContext;
+	ArrayCRef<const RenderDrawCmd*>	m_drawCmds{ nullptr };
+	IGPURenderBundleRecorderPtr		m_bundle;
+	RenderDrawStats					m_stats;
+};
+
+CRenderDrawBucket::CRenderDrawBucket()
+{
+	for (int i = 0; i < DRAWBUCKET_MAX_PASSES; ++i)
+		m_passSortMode[i] = DRAWBUCKET_SORT_STATE;
+}
+
+CRenderDrawBucket::~CRenderDrawBucket()
+{
+	for (CRecordBundleJob* job : m_recordJobs)
+		delete job;
+}
+
+void CRenderDrawBucket::Clear()
+{
+	m_drawCmds.clear(false);
+	m_sortItems.clear(false);
+	m_submitList.clear(false);
+	m_sorted = true;
+
+	ResetStats();
+}
+
+void CRenderDrawBucket::SetPassSortMode(int pass, EDrawBucketSortMode mode)
+{
+	ASSERT(pass >= 0 && pass < DRAWBUCKET_MAX_PASSES);
+	m_passSortMode[pass] = mode;
+}
+
+void CRenderDrawBucket::SetMaxDepth(float maxDepth)
+{
+	m_maxDepth = max(maxDepth, F_EPS);
+}
+
+DrawSortKey CRenderDrawBucket::MakeSortKey(const RenderDrawCmd& drawCmd, float depth, int pass) const
+{
+	const RenderInstanceInfo& instInfo = drawCmd.instanceInfo;
+	const RenderDrawBatch& batchInfo = drawCmd.batchInfo;
+
+	// pipeline is defined by shader, vertex layout and topology.
+	// Shader name pointer is unique per shader class so there is no need to hash the string
+	uint64 pipelineHash = static_cast<uint64>(batchInfo.primTopology);
+	pipelineHash = DrawKeyHashCombine(pipelineHash, reinterpret_cast<uintptr_t>(batchInfo.material ? batchInfo.material->GetShaderName() : nullptr));
+	pipelineHash = DrawKeyHashCombine(pipelineHash, static_cast<uint>(instInfo.instFormat.formatId));
+	pipelineHash = DrawKeyHashCombine(pipelineHash, instInfo.instFormat.usedLayoutBits);
+	pipelineHash = DrawKeyHashCombine(pipelineHash, reinterpret_cast<uintptr_t>(instInfo.instData.instanceProvider));
+
+	const uint64 materialHash = reinterpret_cast<uintptr_t>(batchInfo.material);
+
+	uint64 buffersHash = reinterpret_cast<uintptr_t>(instInfo.indexBuffer.buffer.Ptr());
+	for (const GPUBufferView& vertexBuffer : instInfo.vertexBuffers)
+		buffersHash = DrawKeyHashCombine(buffersHash, reinterpret_cast<uintptr_t>(vertexBuffer.buffer.Ptr()));
+
+	const uint64 depthBits = static_cast<uint64>(clamp(depth / m_maxDepth, 0.0f, 1.0f) * float((1 << DRAWBUCKET_DEPTH_BITS) - 1));
+
+	const uint64 passKey = static_cast<uint64>(pass) << (64 - DRAWBUCKET_PASS_BITS);
+	const uint64 stateKey = (DrawKeyFoldBits(pipelineHash, DRAWBUCKET_PIPELINE_BITS) << (DRAWBUCKET_MATERIAL_BITS + DRAWBUCKET_BUFFERS_BITS))
+		| (DrawKeyFoldBits(materialHash, DRAWBUCKET_MATERIAL_BITS) << DRAWBUCKET_BUFFERS_BITS)
+		| DrawKeyFoldBits(buffersHash, DRAWBUCKET_BUFFERS_BITS);
+
+	if (m_passSortMode[pass] == DRAWBUCKET_SORT_BACK_TO_FRONT)
+	{
+		const uint64 invDepthBits = ((1 << DRAWBUCKET_DEPTH_BITS) - 1) - depthBits;
+		return passKey | (invDepthBits << (64 - DRAWBUCKET_PASS_BITS - DRAWBUCKET_DEPTH_BITS)) | stateKey;
+	}
+
+	if (!r_drawBucketSort.GetBool())
+		return passKey;
+
+	return passKey | (stateKey << DRAWBUCKET_DEPTH_BITS) | depthBits;
+}
+
+void CRenderDrawBucket::AddDrawCmd(const RenderDrawCmd& drawCmd, float depth, int pass)
+{
+	if (!drawCmd.batchInfo.material)
+		return;
+
+	ASSERT(pass >= 0 && pass < DRAWBUCKET_MAX_PASSES);
+
+	const int cmdIdx = m_drawCmds.append(drawCmd);
+	m_sortItems.append({ MakeSortKey(drawCmd, depth, pass), cmdIdx });
+	m_sorted = false;
+}
+
+// stable LSD radix sort of the 64 bit keys.
+// Digits which are equal for all items are skipped, so only varying key parts cost time
+void CRenderDrawBucket::Sort()
+{
+	if (m_sorted)
+		return;
+
+	PROF_EVENT_F();
+
+	m_sorted = true;
+
+	const int numItems = m_sortItems.numElem();
+	if (numItems <= 1)
+		return;
+
+	int histogram[DRAWBUCKET_RADIX_PASSES][DRAWBUCKET_RADIX_SIZE];
+	memset(histogram, 0, sizeof(histogram));
+
+	for (const SortItem& item : m_sortItems)
+	{
+		for (int p = 0; p < DRAWBUCKET_RADIX_PASSES; ++p)
+			++histogram[p][(item.key >> (p * DRAWBUCKET_RADIX_BITS)) & (DRAWBUCKET_RADIX_SIZE - 1)];
+	}
+
+	m_sortTemp.setNum(numItems, false);
+
+	SortItem* src = m_sortItems.ptr();
+	SortItem* dst = m_sortTemp.ptr();
+	for (int p = 0; p < DRAWBUCKET_RADIX_PASSES; ++p)
+	{
+		int* counts = histogram[p];
+
+		// all items fall into single bucket - nothing to reorder
+		const int firstDigit = (src[0].key >> (p * DRAWBUCKET_RADIX_BITS)) & (DRAWBUCKET_RADIX_SIZE - 1);
+		if (counts[firstDigit] == numItems)
+			continue;
+
+		int offset = 0;
+		for (int i = 0; i < DRAWBUCKET_RADIX_SIZE; ++i)
+		{
+			const int count = counts[i];
+			counts[i] = offset;
+			offset += count;
+		}
+
+		for (int i = 0; i < numItems; ++i)
+		{
+			const int digit = (src[i].key >> (p * DRAWBUCKET_RADIX_BITS)) & (DRAWBUCKET_RADIX_SIZE - 1);
+			dst[counts[digit]++] = src[i];
+		}
+		QuickSwap(src, dst);
+	}
+
+	if (src != m_sortItems.ptr())
+		memcpy(m_sortItems.ptr(), src, numItems * sizeof(SortItem));
+}
+
+ArrayCRef<const RenderDrawCmd*> CRenderDrawBucket::GetPassDrawCmds(int pass)
+{
+	ASSERT(pass >= 0 && pass < DRAWBUCKET_MAX_PASSES);
+	ASSERT_MSG(m_sorted, "CRenderDrawBucket::GetPassDrawCmds - Sort() must be called before");
+
+	// items of the same pass are contiguous after sorting
+	m_submitList.clear(false);
+	for (const SortItem& item : m_sortItems)
+	{
+		const int itemPass = static_cast<int>(item.key >> (64 - DRAWBUCKET_PASS_BITS));
+		if (itemPass < pass)
+			continue;
+		if (itemPass > pass)
+			break;
+		m_submitList.append(&m_drawCmds[item.cmdIdx]);
+	}
+	return m_submitList;
+}
+
+void CRenderDrawBucket::Submit(const RenderPassContext& passContext, int pass)
+{
+	PROF_EVENT_F();
+
+	GetPassDrawCmds(pass);
+
+	RenderDrawStats& passStats = m_passStats[pass];
+
+	const int numJobs = GetParallelJobCount(m_submitList.numElem());
+	if (numJobs > 1 && passContext.recorder->GetType() == IGPURenderCommandsRecorder::PASS_RECORDER)
+		SubmitParallel(passContext, numJobs, passStats);
+	else
+		g_matSystem->SetupDrawCommands(m_submitList, passContext, &passStats);
+
+	if (r_drawBucketStats.GetBool())
+	{
+		debugoverlay->Text(color_white, "draw bucket pass %d: %d draws, %d pipelines, %d materials, %d vertex buffers, %d index buffers",
+			pass, passStats.numDraws, passStats.numPipelinesBound, passStats.numMaterialsBound, passStats.numVertexBuffersBound, passStats.numIndexBuffersBound);
+	}
+}
+
+int CRenderDrawBucket::GetParallelJobCount(int numDraws) const
+{
+	if (!r_drawBucketParallel.GetBool() || !g_parallelJobs->IsInitialized())
+		return 1;
+
+	const int minDrawsPerJob = max(1, r_drawBucketParallelMinDraws.GetInt());
+
+	// calling thread records it's own range as well
+	const int maxJobs = g_parallelJobs->GetJobThreadsCount() + 1;
+	return clamp(numDraws / minDrawsPerJob, 1, maxJobs);
+}
+
+// Splits submit list into contiguous ranges.
+// First range is recorded directly into render pass by calling thread,
+// others are recorded into render bundles by job threads and added to the pass in order
+void CRenderDrawBucket::SubmitParallel(const RenderPassContext& passContext, int numJobs, RenderDrawStats& passStats)
+{
+	PROF_EVENT_F();
+
+	IGPURenderPassRecorder* rendPassRecorder = static_cast<IGPURenderPassRecorder*>(passContext.recorder.Ptr());
+	CEqJobManager* jobMng = g_parallelJobs->GetJobMng();
+	IShaderAPI* renderAPI = g_matSystem->GetShaderAPI();
+
+	while (m_recordJobs.numElem() < numJobs - 1)
+		m_recordJobs.append(PPNew CRecordBundleJob());
+
+	const int numDraws = m_submitList.numElem();
+	const int drawsPerJob = (numDraws + numJobs - 1) / numJobs;
+
+	ArrayCRef<const RenderDrawCmd*> submitList(m_submitList);
+
+	int numStartedJobs = 0;
+	for (int start = drawsPerJob; start < numDraws; start += drawsPerJob)
+	{
+		CRecordBundleJob* job = m_recordJobs[numStartedJobs];
+		job->m_bundle = renderAPI->CreateRenderBundleRecorder(rendPassRecorder, "DrawBucketBundle", rendPassRecorder->GetUserData());
+		if (!job->m_bundle)
+			break;
+
+		job->m_passContext = RenderPassContext(job->m_bundle, passContext.data);
+		job->m_passContext.beforeMaterialSetup = passContext.beforeMaterialSetup;
+		job->m_drawCmds = ArrayCRef<const RenderDrawCmd*>(submitList.ptr() + start, min(drawsPerJob, numDraws - start));
+		job->m_stats = RenderDrawStats{};
+
+		job->InitJob();
+		jobMng->StartJob(job);
+		++numStartedJobs;
+	}
+
+	// record first range while bundles are filled, and any range which didn't get a bundle
+	const int numParallelDraws = numStartedJobs * drawsPerJob;
+	g_matSystem->SetupDrawCommands(ArrayCRef<const RenderDrawCmd*>(submitList.ptr(), min(drawsPerJob, numDraws)), passContext, &passStats);
+
+	for (int i = 0; i < numStartedJobs; ++i)
+	{
+		CRecordBundleJob* job = m_recordJobs[i];
+		job->GetSignal()->Wait();
+
+		rendPassRecorder->AddBundle(job->m_bundle);
+		passStats += job->m_stats;
+
+		job->m_bundle = nullptr;
+		job->m_passContext = RenderPassContext();
+	}
+
+	const int firstRemainingDraw = drawsPerJob + numParallelDraws;
+	if (firstRemainingDraw < numDraws)
+		g_matSystem->SetupDrawCommands(ArrayCRef<const RenderDrawCmd*>(submitList.ptr() + firstRemainingDraw, numDraws - firstRemainingDraw), passContext, &passStats);
+}
+
+const RenderDrawStats& CRenderDrawBucket::GetPassStats(int pass) const
+{
+	ASSERT(pass >= 0 && pass < DRAWBUCKET_MAX_PASSES);
+	return m_passStats[pass];
+}
+
+void CRenderDrawBucket::ResetStats()
+{
+	for (int i = 0; i < DRAWBUCKET_MAX_PASSES; ++i)
+		m_passStats[i] = RenderDrawStats{};
+}
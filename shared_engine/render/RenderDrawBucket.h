@@ -0,0 +1,99 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2024
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Draw command bucket.
+//				Records draw commands with sort keys and submits them
+//				ordered to minimize pipeline, material and buffer changes
+//////////////////////////////////////////////////////////////////////////////////
+
+/*
+Example of use:
+
+	// collecting
+	s_drawBucket.Clear();
+	...
+	RenderDrawCmd drawCmd;
+	... setup draw command as usual
+	s_drawBucket.AddDrawCmd(drawCmd, distanceToCamera, DRAWPASS_OPAQUE);
+
+	// or let CEqStudioGeom::Draw fill it through DrawProps::drawBucket
+
+	// sorting and drawing
+	s_drawBucket.Sort();
+	s_drawBucket.Submit(RenderPassContext(rendPassRecorder, &scenePassData), DRAWPASS_OPAQUE);
+	s_drawBucket.Submit(RenderPassContext(rendPassRecorder, &scenePassData), DRAWPASS_TRANSLUCENT);
+
+	// large passes are split into ranges which are recorded into render bundles
+	// by job threads and then added to render pass in the sorted order.
+	// passContext.beforeMaterialSetup must be thread-safe in this case
+*/
+
+#pragma once
+#include "materialsystem1/RenderDefs.h"
+
+static constexpr const int DRAWBUCKET_MAX_PASSES = 16;
+
+enum EDrawBucketSortMode : int
+{
+	DRAWBUCKET_SORT_STATE = 0,			// sort by pipeline, material, buffers then front to back
+	DRAWBUCKET_SORT_BACK_TO_FRONT,		// sort by depth first (translucent), state changes are minimized only among equal depths
+};
+
+// 64 bit sort key layout, most significant first:
+//	pass(4) | pipeline(16) | material(16) | vertex buffers(12) | depth(16)
+// or in back to front mode:
+//	pass(4) | depth(16) | pipeline(16) | material(16) | vertex buffers(12)
+using DrawSortKey = uint64;
+
+class CRenderDrawBucket
+{
+public:
+	CRenderDrawBucket();
+	~CRenderDrawBucket();
+
+	void					Clear();
+
+	void					SetPassSortMode(int pass, EDrawBucketSortMode mode);
+	void					SetMaxDepth(float maxDepth);
+
+	void					AddDrawCmd(const RenderDrawCmd& drawCmd, float depth, int pass = 0);
+	int						GetDrawCmdCount() const { return m_drawCmds.numElem(); }
+
+	// sorts all recorded commands by key
+	void					Sort();
+
+	// draws commands of the specified pass. Sort() must be called before
+	void					Submit(const RenderPassContext& passContext, int pass = 0);
+
+	// sorted commands of the specified pass, valid until next call
+	ArrayCRef<const RenderDrawCmd*>	GetPassDrawCmds(int pass);
+
+	const RenderDrawStats&	GetPassStats(int pass) const;
+	void					ResetStats();
+
+	DrawSortKey				MakeSortKey(const RenderDrawCmd& drawCmd, float depth, int pass) const;
+
+protected:
+	class CRecordBundleJob;
+
+	struct SortItem
+	{
+		DrawSortKey		key;
+		int				cmdIdx;
+	};
+
+	int						GetParallelJobCount(int numDraws) const;
+	void					SubmitParallel(const RenderPassContext& passContext, int numJobs, RenderDrawStats& passStats);
+
+	Array<RenderDrawCmd>	m_drawCmds{ PP_SL };
+	Array<SortItem>			m_sortItems{ PP_SL };
+	Array<SortItem>			m_sortTemp{ PP_SL };
+	Array<const RenderDrawCmd*>	m_submitList{ PP_SL };
+	Array<CRecordBundleJob*>	m_recordJobs{ PP_SL };
+
+	RenderDrawStats			m_passStats[DRAWBUCKET_MAX_PASSES];
+	EDrawBucketSortMode		m_passSortMode[DRAWBUCKET_MAX_PASSES];
+	float					m_maxDepth{ 1000.0f };
+	bool					m_sorted{ true };
+};
@@ -6,10 +6,18 @@
 //////////////////////////////////////////////////////////////////////////////////
 
 #include "core/core_common.h"
+#include "core/ConVar.h"
+#include "materialsystem1/IMaterialSystem.h"
+#include "render/IDebugOverlay.h"
 #include "RenderList.h"
 #include "RenderableObject.h"
 
+DECLARE_CVAR(r_autoInstancing, "1", "Enable automatic instancing of identical renderables", CV_ARCHIVE);
+DECLARE_CVAR(r_autoInstancingStats, "0", "Show automatic instancing statistics", CV_CHEAT);
+
 static constexpr const int MIN_OBJECT_RENDERLIST_SIZE = 64;
+static constexpr const int MIN_INSTANCE_GROUP_SIZE = 2;
+static constexpr const int MAX_INSTANCE_BATCH_BYTES = 32 * 1024; // must fit transient vertex buffer
 
 CRenderList::CRenderList()
 	: m_objectList(PP_SL, MIN_OBJECT_RENDERLIST_SIZE)
@@ -29,51 +37,203 @@ void CRenderList::AddRenderable(Renderable* pObject, void* userData)
 	m_viewDistance.append({ 0.0f, idx });
 }
 
-void CRenderList::Render(int renderFlags, const RenderPassContext& passContext, void* userdata)
+void CRenderList::Render(int renderFlags, const RenderPassContext& passContext, void* userdata, CRenderDrawBucket* drawBucket)
 {
-	RenderInfo rinfo{ passContext, userdata, 0.0f, renderFlags };
-	for (const RendPair& renderable : m_viewDistance)
+	RenderInfo rinfo{ passContext, userdata, 0.0f, renderFlags, drawBucket };
+
+	m_stats = RenderListStats{};
+	m_stats.numRenderables = m_viewDistance.numElem();
+
+	const bool autoInstancing = m_autoInstancing && r_autoInstancing.GetBool();
+
+	m_instancingItems.clear(false);
+	m_instanceBatches.clear(false);
+	if (autoInstancing)
+		BuildInstanceBatches(rinfo);
+
+	for (int i = 0; i < m_viewDistance.numElem(); ++i)
 	{
+		const int batchIdx = m_instanceBatches.numElem() ? m_pairBatch[i] : -1;
+		if (batchIdx != -1)
+		{
+			// drawn by the batch at position of it's first renderable
+			const InstanceBatch& batch = m_instanceBatches[batchIdx];
+			if (batch.pairIdx == i)
+				RenderInstanceBatch(rinfo, batch);
+			continue;
+		}
+
+		const RendPair& renderable = m_viewDistance[i];
 		rinfo.distance = renderable.distance;
 		m_objectList[renderable.objIdx]->Render(rinfo);
+		++m_stats.numDraws;
+	}
+
+	if (r_autoInstancingStats.GetBool() && autoInstancing)
+	{
+		debugoverlay->Text(color_white, "render list: %d draws before instancing, %d after (%d groups, %d instanced)",
+			m_stats.numRenderables, m_stats.numDraws, m_stats.numInstanceGroups, m_stats.numInstanced);
 	}
 }
 
+// groups items with identical geometry, instance format, body groups, LOD and material group
+// into batches that are drawn at once
+void CRenderList::BuildInstanceBatches(RenderInfo& rinfo)
+{
+	PROF_EVENT_F();
+
+	for (int i = 0; i < m_viewDistance.numElem(); ++i)
+	{
+		const RendPair& renderable = m_viewDistance[i];
+		rinfo.distance = renderable.distance;
+
+		RenderInstancingDesc instDesc;
+		if (!m_objectList[renderable.objIdx]->GetInstancingDesc(rinfo, instDesc) || !instDesc.geometry)
+			continue;
+
+		m_instancingItems.append({ instDesc.geometry, instDesc.instanceFormat, instDesc.bodyGroupFlags, instDesc.lod, instDesc.materialGroup, instDesc.instanceData, instDesc.instanceDataSize, i });
+	}
+
+	if (!m_instancingItems.numElem())
+		return;
+
+	// back to front order must be kept so only neighbours are grouped,
+	// otherwise group items in draw order so the closest renderable goes first
+	if (!m_backToFront)
+	{
+		arraySort(m_instancingItems, [](const InstancingItem& a, const InstancingItem& b) {
+			if (a.geometry != b.geometry)
+				return sortCompare(reinterpret_cast<uintptr_t>(a.geometry), reinterpret_cast<uintptr_t>(b.geometry));
+			if (a.instanceFormat != b.instanceFormat)
+				return sortCompare(reinterpret_cast<uintptr_t>(a.instanceFormat), reinterpret_cast<uintptr_t>(b.instanceFormat));
+			if (a.bodyGroupFlags != b.bodyGroupFlags)
+				return sortCompare(a.bodyGroupFlags, b.bodyGroupFlags);
+			if (a.lod != b.lod)
+				return sortCompare(a.lod, b.lod);
+			if (a.materialGroup != b.materialGroup)
+				return sortCompare(a.materialGroup, b.materialGroup);
+			if (a.instanceDataSize != b.instanceDataSize)
+				return sortCompare(a.instanceDataSize, b.instanceDataSize);
+			return sortCompare(a.pairIdx, b.pairIdx);
+		});
+	}
+
+	const bool backToFront = m_backToFront;
+	auto isSameGroup = [backToFront](const InstancingItem& a, const InstancingItem& b) {
+		if (backToFront && b.pairIdx != a.pairIdx + 1)
+			return false;
+
+		return a.geometry == b.geometry
+			&& a.instanceFormat == b.instanceFormat
+			&& a.bodyGroupFlags == b.bodyGroupFlags
+			&& a.lod == b.lod
+			&& a.materialGroup == b.materialGroup
+			&& a.instanceDataSize == b.instanceDataSize;
+	};
+
+	m_pairBatch.setNum(m_viewDistance.numElem(), false);
+	for (int& batchIdx : m_pairBatch)
+		batchIdx = -1;
+
+	const int numItems = m_instancingItems.numElem();
+	int groupStart = 0;
+	while (groupStart < numItems)
+	{
+		int groupEnd = groupStart + 1;
+		while (groupEnd < numItems && isSameGroup(m_instancingItems[groupEnd - 1], m_instancingItems[groupEnd]))
+			++groupEnd;
+
+		const int instanceSize = m_instancingItems[groupStart].instanceDataSize;
+		const int groupSize = groupEnd - groupStart;
+
+		// too small groups are drawn as usual
+		if (groupSize >= MIN_INSTANCE_GROUP_SIZE && instanceSize > 0)
+		{
+			const int maxBatchInstances = max(1, MAX_INSTANCE_BATCH_BYTES / instanceSize);
+			for (int batchStart = groupStart; batchStart < groupEnd; batchStart += maxBatchInstances)
+			{
+				const int batchSize = min(maxBatchInstances, groupEnd - batchStart);
+				const int batchIdx = m_instanceBatches.append({ batchStart, batchSize, m_instancingItems[batchStart].pairIdx });
+
+				for (int i = batchStart; i < batchStart + batchSize; ++i)
+					m_pairBatch[m_instancingItems[i].pairIdx] = batchIdx;
+			}
+		}
+
+		groupStart = groupEnd;
+	}
+}
+
+// packs instance data of batch into instance buffer and draws it through the first renderable
+void CRenderList::RenderInstanceBatch(RenderInfo& rinfo, const InstanceBatch& batch)
+{
+	const int instanceSize = m_instancingItems[batch.firstItem].instanceDataSize;
+
+	m_instanceData.setNum(batch.numItems * instanceSize, false);
+	ubyte* instanceDataPtr = m_instanceData.ptr();
+	for (int i = batch.firstItem; i < batch.firstItem + batch.numItems; ++i)
+	{
+		memcpy(instanceDataPtr, m_instancingItems[i].instanceData, instanceSize);
+		instanceDataPtr += instanceSize;
+	}
+
+	MeshInstanceData instData;
+	instData.buffer = GetInstanceBuffer(m_instanceData.ptr(), m_instanceData.numElem());
+	instData.first = 0;
+	instData.count = batch.numItems;
+
+	const RendPair& leader = m_viewDistance[batch.pairIdx];
+	rinfo.distance = leader.distance;
+	m_objectList[leader.objIdx]->RenderInstanced(rinfo, instData);
+
+	++m_stats.numDraws;
+	++m_stats.numInstanceGroups;
+	m_stats.numInstanced += batch.numItems;
+}
+
+GPUBufferView CRenderList::GetInstanceBuffer(const void* data, int size)
+{
+	return g_matSystem->GetTransientVertexBuffer(data, size);
+}
+
 void CRenderList::Clear()
 {
 	m_objectList.clear(false);
 	m_viewDistance.clear(false);
+	m_instancingItems.clear(false);
+	m_instanceBatches.clear(false);
+	m_backToFront = false;
 }
 
 void CRenderList::SortByDistanceFrom(const Vector3D& origin, bool reverse)
 {
-	m_viewDistance.setNum(m_objectList.numElem(), false);
-
 	// pre-compute object distances
-	for(int i = 0; i < m_objectList.numElem(); ++i)
+	for(RendPair& pair : m_viewDistance)
 	{
-		const Renderable* renderable = m_objectList[i];
+		const Renderable* renderable = m_objectList[pair.objIdx];
 		const BoundingBox& bbox = renderable->GetBoundingBox();
 
 		// clamp point in bbox
 		if(!bbox.Contains(origin))
-			m_viewDistance[i].distance = length(origin - bbox.ClampPoint(origin));
+			pair.distance = length(origin - bbox.ClampPoint(origin));
 		else
-			m_viewDistance[i].distance = length(origin - bbox.GetCenter());
+			pair.distance = length(origin - bbox.GetCenter());
 	}
 
+	// radix sort is stable so objects at equal distance keep their order
+	m_backToFront = reverse;
 	if (reverse)
 	{
 		// furthest to closest (for transparency)
-		arraySort(m_viewDistance, [this](RendPair& a, RendPair& b) {
-			return sortCompare(b.distance, a.distance);
+		arrayRadixSort(m_viewDistance, m_sortTemp, [](const RendPair& pair) {
+			return -pair.distance;
 		});
 	}
 	else
 	{
 		// closest to furthest
-		arraySort(m_viewDistance, [this](RendPair& a, RendPair& b) {
-			return sortCompare(a.distance, b.distance);
+		arrayRadixSort(m_viewDistance, m_sortTemp, [](const RendPair& pair) {
+			return pair.distance;
 		});
 	}
 }
\ No newline at end of file
@@ -8,7 +8,18 @@
 #pragma once
 
 struct RenderPassContext;
+struct GPUBufferView;
+struct RenderInfo;
 class IRenderableObject;
+class CRenderDrawBucket;
+
+struct RenderListStats
+{
+	int		numRenderables{ 0 };	// draws without instancing
+	int		numDraws{ 0 };			// draws after instancing
+	int		numInstanceGroups{ 0 };
+	int		numInstanced{ 0 };		// renderables drawn as part of instance groups
+};
 
 class CRenderList
 {
@@ -24,7 +35,12 @@ public:
 	ArrayCRef<Renderable*>	GetRenderables() const { return m_objectList; }
 	void					SortByDistanceFrom(const Vector3D& origin, bool reverse);
 
-	void					Render(int renderFlags, const RenderPassContext& passContext, void* userdata = nullptr);// draws render list
+	void					Render(int renderFlags, const RenderPassContext& passContext, void* userdata = nullptr, CRenderDrawBucket* drawBucket = nullptr);// draws render list
+
+	// groups identical renderables into instanced draws. Each instanced draw goes at the position of
+	// it's closest renderable. After back to front sorting only neighbour renderables are grouped
+	void					SetAutoInstancing(bool enable) { m_autoInstancing = enable; }
+	const RenderListStats&	GetStats() const { return m_stats; }
 
 protected:
 	struct RendPair
@@ -32,6 +48,41 @@ protected:
 		float	distance;
 		int		objIdx;
 	};
-	Array<Renderable*>	m_objectList;
-	Array<RendPair>		m_viewDistance;
+
+	struct InstancingItem
+	{
+		const void*		geometry;
+		const void*		instanceFormat;
+		int				bodyGroupFlags;
+		int				lod;
+		int				materialGroup;
+		const void*		instanceData;
+		int				instanceDataSize;
+		int				pairIdx;
+	};
+
+	struct InstanceBatch
+	{
+		int				firstItem;
+		int				numItems;
+		int				pairIdx;		// first renderable in draw order, draws the batch
+	};
+
+	void					BuildInstanceBatches(RenderInfo& rinfo);
+	void					RenderInstanceBatch(RenderInfo& rinfo, const InstanceBatch& batch);
+
+	// instance data is uploaded to transient vertex buffer by default
+	virtual GPUBufferView	GetInstanceBuffer(const void* data, int size);
+
+	Array<Renderable*>		m_objectList;
+	Array<RendPair>			m_viewDistance;
+	Array<RendPair>			m_sortTemp{ PP_SL };
+
+	Array<InstancingItem>	m_instancingItems{ PP_SL };
+	Array<InstanceBatch>	m_instanceBatches{ PP_SL };
+	Array<int>				m_pairBatch{ PP_SL };		// batch index for each pair or -1
+	Array<ubyte>			m_instanceData{ PP_SL };
+	RenderListStats			m_stats;
+	bool					m_autoInstancing{ false };
+	bool					m_backToFront{ false };
 };
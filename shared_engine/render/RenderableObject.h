@@ -8,8 +8,10 @@
 #pragma once
 
 class CRenderList;
+class CRenderDrawBucket;
 class IGPUCommandRecorder;
 struct RenderPassContext;
+struct MeshInstanceData;
 
 struct RenderInfo
 {
@@ -17,6 +19,22 @@ struct RenderInfo
 	void*	userData{ nullptr };
 	float	distance{ 0.0f };		// dist from camera
 	int		renderFlags{ 0 };
+	CRenderDrawBucket* drawBucket{ nullptr };	// if set, renderable should record it's draw commands here
+};
+
+// Describes draw that can be merged with identical draws of other renderables.
+// Renderables with equal geometry, instance format, body groups, LOD and material group
+// are drawn once with their instance data packed into single instance buffer
+struct RenderInstancingDesc
+{
+	const void*		geometry{ nullptr };		// CEqStudioGeom or any other unique geometry pointer
+	const void*		instanceFormat{ nullptr };	// vertex format used by RenderInstanced
+	int				bodyGroupFlags{ 0 };
+	int				lod{ 0 };
+	int				materialGroup{ 0 };
+
+	const void*		instanceData{ nullptr };	// must stay valid until CRenderList::Render returns
+	int				instanceDataSize{ 0 };
 };
 
 // renderable object
@@ -29,6 +47,12 @@ public:
 	virtual void				Render(const RenderInfo& rinfo) = 0;
 	virtual const BoundingBox&	GetBoundingBox() const = 0;
 
+	// automatic instancing support.
+	// When returns true, renderable may be drawn as a part of group through RenderInstanced
+	// of the group's first renderable, which must use instData with instanced vertex format
+	virtual bool				GetInstancingDesc(const RenderInfo& rinfo, RenderInstancingDesc& desc) const { return false; }
+	virtual void				RenderInstanced(const RenderInfo& rinfo, const MeshInstanceData& instData) {}
+
 	void						SetRenderFlags(int flags);
 	int							GetRenderFlags() const;
 
@@ -14,11 +14,14 @@
 
 #include "studiofile/StudioLoader.h"
 #include "StudioGeom.h"
+#include "StudioGeomBVH.h"
+#include "StudioGeomDecal.h"
 #include "StudioCache.h"
 #include "StudioGeomInstancer.h"
 
 #include "physics/IStudioShapeCache.h"
 #include "render/Decals.h"
+#include "render/RenderDrawBucket.h"
 #include "render/StudioRenderDefs.h"
 #include "materialsystem1/IMaterialSystem.h"
 
@@ -36,34 +39,37 @@ static bool TransformEGFVertex(EGFHwVertex::PositionUV& vertPos, EGFHwVertex::TB
 {
 	bool bAffected = false;
 
+	const Vector3D vertPoint(vertPos.point.x, vertPos.point.y, vertPos.point.z);
+	const Vector3D vertNormal = Vector3D(tbn.normal[0], tbn.normal[1], tbn.normal[2]) / 127.0f;
+	const Vector3D vertTangent = Vector3D(tbn.tangent[0], tbn.tangent[1], tbn.tangent[2]) / 127.0f;
+	const Vector3D vertBinormal = Vector3D(tbn.binormal[0], tbn.binormal[1], tbn.binormal[2]) / 127.0f;
+
 	Vector3D pos = vec3_zero;
-	Vector3D normal = vec3_zero;
-	Vector3D tangent = vec3_zero;
-	Vector3D binormal = vec3_zero;
+	studioVertexTBN_t skinnedTbn;
+	skinnedTbn.normal = vec3_zero;
+	skinnedTbn.tangent = vec3_zero;
+	skinnedTbn.binormal = vec3_zero;
 
 	for (int i = 0; i < MAX_MODEL_VERTEX_WEIGHTS; ++i)
 	{
-		const int boneIdx = vertWeight.boneIndices[i];
+		const int boneIdx = vertWeight.bones[i];
 		if (boneIdx == -1)
 			continue;
 
-		const float weight = vertWeight.boneWeights[i];
-		pos += transformPoint(Vector3D(vertPos.pos.xyz()), pMatrices[boneIdx]) * weight;
+		const float weight = vertWeight.weight[i] / 255.0f;
+		pos += transformPoint(vertPoint, pMatrices[boneIdx]) * weight;
 
-		normal += rotateVector(Vector3D(tbn.normal), pMatrices[boneIdx]) * weight;
-		tangent += rotateVector(Vector3D(tbn.tangent), pMatrices[boneIdx]) * weight;
-		binormal += rotateVector(Vector3D(tbn.binormal), pMatrices[boneIdx]) * weight;
+		skinnedTbn.normal += rotateVector(vertNormal, pMatrices[boneIdx]) * weight;
+		skinnedTbn.tangent += rotateVector(vertTangent, pMatrices[boneIdx]) * weight;
+		skinnedTbn.binormal += rotateVector(vertBinormal, pMatrices[boneIdx]) * weight;
 
 		bAffected = true;
 	}
 
 	if (bAffected)
 	{
-		vertPos.pos = Vector4D(pos, 1.0f);
-
-		tbn.normal = normal;
-		tbn.tangent = tangent;
-		tbn.binormal = binormal;
+		vertPos.point = Vector4D(pos, 1.0f);
+		tbn = EGFHwVertex::TBN(skinnedTbn);
 	}
 
 	return bAffected;
@@ -206,6 +212,7 @@ void CEqStudioGeom::DestroyModel()
 	}
 
 	PPDeleteArrayRef(m_hwGeomRefs);
+	PPDeleteArrayRef(m_meshGroupBVHs);
 	SAFE_DELETE_ARRAY(m_joints);
 }
 
@@ -220,70 +227,62 @@ void CEqStudioGeom::LoadPhysicsData()
 	g_studioShapeCache->InitStudioCache(m_physModel);
 }
 
-static int CopyGroupVertexDataToHWList(EGFHwVertex::PositionUV* hwVertPosList, EGFHwVertex::TBN* hwVertTbnList, EGFHwVertex::BoneWeights* hwVertWeightList, EGFHwVertex::Color* hwVertColorList, int currentVertexCount, const studioMeshDesc_t* pMesh, BoundingBox& aabb)
+// older EGF versions only have mesh streams, hardware vertex streams are built from them
+static studioHwStreamsDesc_t* BuildHwStreamsFromMeshes(const studioHdr_t* studio, int vertexType, int numVertices, int numIndices)
 {
-	for (int32 i = 0; i < pMesh->numVertices; i++)
+	studioHwStreamsDesc_t desc;
+	const int size = Studio_InitHwStreams(desc, vertexType, numVertices, numIndices);
+
+	studioHwStreamsDesc_t* hwStreams = (studioHwStreamsDesc_t*)PPAlloc(size);
+	*hwStreams = desc;
+
+	BoundingBox aabb;
+	int vertexIdx = 0;
+	int indexIdx = 0;
+	for (int i = 0; i < studio->numMeshGroups; i++)
 	{
-		if(hwVertPosList)
+		const studioMeshGroupDesc_t* pMeshGroupDesc = studio->pMeshGroupDesc(i);
+		for (int j = 0; j < pMeshGroupDesc->numMeshes; j++)
 		{
-			if (pMesh->vertexType & STUDIO_VERTFLAG_POS_UV)
+			const studioMeshDesc_t* pMesh = pMeshGroupDesc->pMesh(j);
+			const int firstVertex = vertexIdx;
+
+			// streams missing in mesh are filled with defaults
+			studioVertexPosUv_t posUv;
+			studioVertexTBN_t tbn;
+			studioBoneWeight_t boneWeight;
+			studioVertexColor_t color;
+			memset(&posUv, 0, sizeof(posUv));
+			memset(&tbn, 0, sizeof(tbn));
+			memset(&boneWeight, 0, sizeof(boneWeight));
+			color.color = color_white.pack();
+
+			for (int k = 0; k < pMesh->numVertices; k++)
 			{
-				const studioVertexPosUv_t* vertPosUv = pMesh->pPosUvs(i);
-				hwVertPosList[currentVertexCount] = EGFHwVertex::PositionUV(*vertPosUv);
-				aabb.AddVertex(vertPosUv->point);
-			}
-		}
-		if(hwVertTbnList)
-		{
-			if (pMesh->vertexType & STUDIO_VERTFLAG_TBN)
-				hwVertTbnList[currentVertexCount] = EGFHwVertex::TBN(*pMesh->pTBNs(i));
-		}
-		if(hwVertWeightList)
-		{
-			if (pMesh->vertexType & STUDIO_VERTFLAG_BONEWEIGHT)
-				hwVertWeightList[currentVertexCount] = EGFHwVertex::BoneWeights(*pMesh->pBoneWeight(i));
-			else
-				hwVertWeightList[currentVertexCount].boneIndices[0] = -1;
-		}
-		if (hwVertColorList)
-		{
-			if (pMesh->vertexType & STUDIO_VERTFLAG_COLOR)
-				hwVertColorList[currentVertexCount] = EGFHwVertex::Color(*pMesh->pColor(i));
-			else
-				hwVertColorList[currentVertexCount].color = color_white.pack();
-		}
-		++currentVertexCount;
-	}
+				Studio_GetMeshVertex(nullptr, pMesh, k, &posUv, &tbn, &boneWeight, &color);
+				Studio_EncodeHwVertex(hwStreams, vertexIdx++, posUv, tbn, boneWeight, color);
 
-	return pMesh->numVertices;
-}
+				if (pMesh->vertexType & STUDIO_VERTFLAG_POS_UV)
+					aabb.AddVertex(posUv.point);
+			}
 
-static int CopyGroupIndexDataToHWList(void* indexData, int indexSize, int currentIndexCount, const studioMeshDesc_t* pMesh, int vertex_add_offset)
-{
-	if (indexSize == sizeof(int))
-	{
-		uint32* indices = (uint32*)indexData;
-		for (uint32 i = 0; i < pMesh->numIndices; i++)
-		{
-			const uint32 index = (*pMesh->pVertexIdx(i)) + vertex_add_offset;
-			indices[currentIndexCount++] = index;
-		}
-	}
-	else if (indexSize == sizeof(short))
-	{
-		uint16* indices = (uint16*)indexData;
-		for (uint32 i = 0; i < pMesh->numIndices; i++)
-		{
-			const uint32 index = (*pMesh->pVertexIdx(i)) + vertex_add_offset;
-			indices[currentIndexCount++] = index & 0xffff;
+			uint16* indices16 = (uint16*)hwStreams->pIndices();
+			uint32* indices32 = (uint32*)hwStreams->pIndices();
+			for (uint32 k = 0; k < pMesh->numIndices; k++)
+			{
+				const uint32 index = (*pMesh->pVertexIdx(k)) + firstVertex;
+				if (hwStreams->indexSize == sizeof(uint32))
+					indices32[indexIdx++] = index;
+				else
+					indices16[indexIdx++] = index & 0xffff;
+			}
 		}
 	}
-	else
-	{
-		ASSERT_FAIL("CopyGroupIndexDataToHWList - Bad index size");
-	}
 
-	return pMesh->numIndices;
+	hwStreams->boundsMin = aabb.minPoint;
+	hwStreams->boundsMax = aabb.maxPoint;
+
+	return hwStreams;
 }
 
 bool CEqStudioGeom::LoadModel(const char* pszPath, bool useJob)
@@ -330,6 +329,12 @@ bool CEqStudioGeom::LoadModel(const char* pszPath, bool useJob)
 		loadGeomJob->DeleteOnFinish();
 		loadGeomJob->InitJob();
 
+		FunctionJob* buildBVHJob = PPNew FunctionJob("BuildEGFBVH", [this](void*, int) {
+			LoadBuildBVH();
+		});
+		buildBVHJob->DeleteOnFinish();
+		buildBVHJob->InitJob();
+
 		FunctionJob* finishJob = PPNew FunctionJob("FinishSyncJob", [this, loadingPromise](void*, int) {
 			if (m_readyState != MODEL_LOAD_ERROR)
 				Atomic::Exchange(m_readyState, MODEL_LOAD_OK);
@@ -342,6 +347,7 @@ bool CEqStudioGeom::LoadModel(const char* pszPath, bool useJob)
 		finishJob->InitJob();
 		finishJob->AddWait(loadModelJob);
 		finishJob->AddWait(loadGeomJob);
+		finishJob->AddWait(buildBVHJob);
 
 		if (numPackages)
 		{
@@ -362,6 +368,7 @@ bool CEqStudioGeom::LoadModel(const char* pszPath, bool useJob)
 
 		jobMng->StartJob(loadModelJob);
 		jobMng->StartJob(loadGeomJob);
+		jobMng->StartJob(buildBVHJob);
 		jobMng->StartJob(finishJob);
 
 		return true;
@@ -377,6 +384,7 @@ bool CEqStudioGeom::LoadModel(const char* pszPath, bool useJob)
 	}
 
 	LoadSetupBones();
+	LoadBuildBVH();
 	LoadMotionPackages();
 	LoadPhysicsData();
 	
@@ -401,66 +409,27 @@ bool CEqStudioGeom::LoadGenerateVertexBuffer()
 {
 	const studioHdr_t* studio = m_studio;
 
-	// use index size
-	int numVertices = 0;
-	int numIndices = 0;
-
-	int allVertexFeatureFlags = 0;
-
-	// find vert and index count
-	for (int i = 0; i < studio->numMeshGroups; i++)
-	{
-		const studioMeshGroupDesc_t* pMeshGroupDesc = studio->pMeshGroupDesc(i);
-		for (int j = 0; j < pMeshGroupDesc->numMeshes; j++)
-		{
-			const studioMeshDesc_t* pMesh = pMeshGroupDesc->pMesh(j);
-			numVertices += pMesh->numVertices;
-			numIndices += pMesh->numIndices;
-
-			allVertexFeatureFlags |= pMesh->vertexType;
-		}
-	}
-
-	const int indexSize = numVertices > int(USHRT_MAX) ? sizeof(int) : sizeof(short);
-
-	// FIXME: separate per each mesh since each mesh has different features?
-	EGFHwVertex::PositionUV* allPositionUvsList = nullptr;
-	EGFHwVertex::TBN* allTbnList = nullptr;
-	EGFHwVertex::BoneWeights* allBoneWeightsList = nullptr;
-	EGFHwVertex::Color* allColorList = nullptr;
-
-	if(allVertexFeatureFlags & STUDIO_VERTFLAG_POS_UV)
-		allPositionUvsList = PPNew EGFHwVertex::PositionUV[numVertices];
-
-	if (allVertexFeatureFlags & STUDIO_VERTFLAG_TBN)
-		allTbnList = PPNew EGFHwVertex::TBN[numVertices];
-
-	if (allVertexFeatureFlags & STUDIO_VERTFLAG_BONEWEIGHT)
-		allBoneWeightsList = PPNew EGFHwVertex::BoneWeights[numVertices];
-
-	if (allVertexFeatureFlags & STUDIO_VERTFLAG_COLOR)
-		allColorList = PPNew EGFHwVertex::Color[numVertices];
-
-	ubyte* allIndices = PPNew ubyte[indexSize * numIndices];
-
-	numVertices = 0;
-	numIndices = 0;
-
 	static const EPrimTopology s_egfPrimTypeMap[] = {
 		PRIM_TRIANGLES, 
 		PRIM_TRIANGLE_STRIP, // was fan, now placeholder
 		PRIM_TRIANGLE_STRIP,
 	};
 
+	// use index size
+	int numVertices = 0;
+	int numIndices = 0;
+
+	int allVertexFeatureFlags = 0;
+
+	// setup mesh references and find vert and index count
 	m_hwGeomRefs = PPNewArrayRef(HWGeomRef, studio->numMeshGroups);
 	for (int i = 0; i < studio->numMeshGroups; i++)
 	{
 		const studioMeshGroupDesc_t* pMeshGroupDesc = studio->pMeshGroupDesc(i);
 		ArrayRef<HWGeomRef::MeshRef> meshRefs = PPNewArrayRef(HWGeomRef::MeshRef, pMeshGroupDesc->numMeshes);
-		
+
 		for (int j = 0; j < pMeshGroupDesc->numMeshes; j++)
 		{
-			// add vertices, add indices
 			const studioMeshDesc_t* pMeshDesc = pMeshGroupDesc->pMesh(j);
 			HWGeomRef::MeshRef& meshRef = meshRefs[j];
 
@@ -470,33 +439,57 @@ bool CEqStudioGeom::LoadGenerateVertexBuffer()
 			meshRef.materialIdx = pMeshDesc->materialIndex;
 			meshRef.supportsSkinning = (pMeshDesc->vertexType & STUDIO_VERTFLAG_BONEWEIGHT);
 
-			const int newOffset = numVertices;
+			numVertices += pMeshDesc->numVertices;
+			numIndices += pMeshDesc->numIndices;
 
-			numVertices += CopyGroupVertexDataToHWList(
-				allPositionUvsList,
-				allTbnList, 
-				allBoneWeightsList,
-				allColorList,
-				numVertices, 
-				pMeshDesc, m_boundingBox);
-			numIndices += CopyGroupIndexDataToHWList(allIndices, indexSize, numIndices, pMeshDesc, newOffset);
+			allVertexFeatureFlags |= pMeshDesc->vertexType;
 		}
 
 		m_hwGeomRefs[i].meshRefs = meshRefs;
 	}
 
+	// EGF 14 hardware vertex streams are uploaded as they are stored
+	const studioHwStreamsDesc_t* hwStreams = studio->pHwStreams();
+	studioHwStreamsDesc_t* builtHwStreams = nullptr;
+	if (hwStreams && (hwStreams->numVertices != numVertices || hwStreams->numIndices != numIndices))
+	{
+		MsgError("%s: hardware vertex streams mismatch mesh data\n", GetName());
+		return false;
+	}
+
+	if (!hwStreams)
+	{
+		builtHwStreams = BuildHwStreamsFromMeshes(studio, allVertexFeatureFlags, numVertices, numIndices);
+		hwStreams = builtHwStreams;
+	}
+
+	m_boundingBox = BoundingBox(hwStreams->boundsMin, hwStreams->boundsMax);
+
 	// create hardware buffers
-	if(allPositionUvsList)
-		m_vertexBuffers[EGFHwVertex::VERT_POS_UV] = g_renderAPI->CreateBuffer({ allPositionUvsList, numVertices }, BUFFERUSAGE_VERTEX, "EGFPosUVBuf");
-	if(allTbnList)
-		m_vertexBuffers[EGFHwVertex::VERT_TBN] = g_renderAPI->CreateBuffer({ allTbnList, numVertices }, BUFFERUSAGE_VERTEX, "EGFTBNBuf");
-	if(allBoneWeightsList)
-		m_vertexBuffers[EGFHwVertex::VERT_BONEWEIGHT] = g_renderAPI->CreateBuffer({ allBoneWeightsList, numVertices }, BUFFERUSAGE_VERTEX, "EGFBoneWBuf");
-	if(allColorList)
-		m_vertexBuffers[EGFHwVertex::VERT_COLOR] = g_renderAPI->CreateBuffer({ allColorList, numVertices }, BUFFERUSAGE_VERTEX, "EGFColBuf");
-
-	m_indexBuffer = g_renderAPI->CreateBuffer(BufferInfo(allIndices, indexSize, numIndices), BUFFERUSAGE_INDEX, "EGFIdxBuffer");
-	m_indexFmt = (indexSize == 2) ? INDEXFMT_UINT16 : INDEXFMT_UINT32;
+	static const int s_vertexStreamStrides[] = {
+		sizeof(EGFHwVertex::PositionUV),
+		sizeof(EGFHwVertex::TBN),
+		sizeof(EGFHwVertex::BoneWeights),
+		sizeof(EGFHwVertex::Color),
+	};
+	static const char* s_vertexStreamNames[] = {
+		"EGFPosUVBuf",
+		"EGFTBNBuf",
+		"EGFBoneWBuf",
+		"EGFColBuf",
+	};
+	static_assert(elementsOf(s_vertexStreamStrides) == EGFHwVertex::VERT_COUNT, "s_vertexStreamStrides must match EGFHwVertex::VertexStreamId");
+	static_assert(elementsOf(s_vertexStreamNames) == EGFHwVertex::VERT_COUNT, "s_vertexStreamNames must match EGFHwVertex::VertexStreamId");
+
+	for (int i = 0; i < EGFHwVertex::VERT_COUNT; i++)
+	{
+		if (!(hwStreams->vertexType & (1 << i)))
+			continue;
+		m_vertexBuffers[i] = g_renderAPI->CreateBuffer(BufferInfo(hwStreams->pStream(i), s_vertexStreamStrides[i], numVertices), BUFFERUSAGE_VERTEX, s_vertexStreamNames[i]);
+	}
+
+	m_indexBuffer = g_renderAPI->CreateBuffer(BufferInfo(hwStreams->pIndices(), hwStreams->indexSize, numIndices), BUFFERUSAGE_INDEX, "EGFIdxBuffer");
+	m_indexFmt = (hwStreams->indexSize == 2) ? INDEXFMT_UINT16 : INDEXFMT_UINT32;
 
 	// if we using software skinning, we need to create temporary vertices
 #if 0
@@ -508,12 +501,7 @@ bool CEqStudioGeom::LoadGenerateVertexBuffer()
 #endif
 
 	// done.
-	delete[] allPositionUvsList;
-	delete[] allTbnList;
-	delete[] allBoneWeightsList;
-	delete[] allColorList;
-
-	delete[] allIndices;
+	PPFree(builtHwStreams);
 
 	return true;
 }
@@ -731,6 +719,15 @@ void CEqStudioGeom::LoadSetupBones()
 	}
 }
 
+void CEqStudioGeom::LoadBuildBVH()
+{
+	const studioHdr_t* studio = m_studio;
+
+	m_meshGroupBVHs = PPNewArrayRef(CStudioMeshBVH, studio->numMeshGroups);
+	for (int i = 0; i < studio->numMeshGroups; ++i)
+		m_meshGroupBVHs[i].Build(studio->pMeshGroupDesc(i), studio->pHwStreams());
+}
+
 int CEqStudioGeom::SelectLod(float distance) const
 {
 	if (r_egf_LodTest.GetInt() != -1)
@@ -903,7 +900,10 @@ void CEqStudioGeom::Draw(const DrawProps& drawProperties, const MeshInstanceData
 			const HWGeomRef::MeshRef& meshRef = m_hwGeomRefs[modelDescId].meshRefs[j];
 			drawCmd.SetDrawIndexed(static_cast<EPrimTopology>(meshRef.primType), meshRef.indexCount, meshRef.firstIndex);
 
-			g_matSystem->SetupDrawCommand(drawCmd, passContext);
+			if (drawProperties.drawBucket)
+				drawProperties.drawBucket->AddDrawCmd(drawCmd, drawProperties.drawBucketDepth, drawProperties.drawBucketPass);
+			else
+				g_matSystem->SetupDrawCommand(drawCmd, passContext);
 		}
 	}
 }
@@ -977,288 +977,65 @@ CBaseEqGeomInstancer* CEqStudioGeom::GetInstancer() const
 	return m_instancer;
 }
 
-static void MakeDecalTexCoord(Array<EGFHwVertex>& verts, Array<int>& indices, const DecalMakeInfo& info)
+// returns mesh group of body group for the lod, falls back to lower lods if not present
+static uint8 GetBodyGroupMeshGroup(const studioHdr_t& studio, int bodyGroupIdx, int lod)
 {
-	ASSERT_FAIL("Not implemented");
-#if 0
-	const Vector3D decalSize = info.size * 2.0f;
-
-	if (info.flags & DECAL_MAKE_FLAG_TEX_NORMAL)
-	{
-		int texSizeW = 1;
-		int texSizeH = 1;
-
-		ITexturePtr pTex = info.material->GetBaseTexture();
-
-		if (pTex)
-		{
-			texSizeW = pTex->GetWidth();
-			texSizeH = pTex->GetHeight();
-		}
-
-		Vector3D uaxis;
-		Vector3D vaxis;
+	const int bodyGroupLodIndex = studio.pBodyGroups(bodyGroupIdx)->lodModelIndex;
+	const studioLodModel_t* lodModel = studio.pLodModel(bodyGroupLodIndex);
 
-		Vector3D axisAngles = VectorAngles(info.normal);
-		AngleVectors(axisAngles, nullptr, &uaxis, &vaxis);
-
-		vaxis *= -1;
-
-		//VectorVectors(m_surftex.Plane.normal, m_surftex.UAxis.normal, m_surftex.VAxis.normal);
-
-		Matrix3x3 texMatrix(uaxis, vaxis, info.normal);
-
-		const Matrix3x3 rotationMat = rotateZXY3(0.0f, 0.0f, DEG2RAD(info.texRotation));
-		texMatrix = rotationMat * texMatrix;
-
-		uaxis = texMatrix.rows[0];
-		vaxis = texMatrix.rows[1];
-
-		for (int i = 0; i < verts.numElem(); i++)
-		{
-			const float one_over_w = 1.0f / fabs(dot(decalSize, uaxis * uaxis) * info.texScale.x);
-			const float one_over_h = 1.0f / fabs(dot(decalSize, vaxis * vaxis) * info.texScale.y);
-
-			const float U = dot(uaxis, info.origin - verts[i].pos.xyz()) * one_over_w + 0.5f;
-			const float V = dot(vaxis, info.origin - verts[i].pos.xyz()) * one_over_h - 0.5f;
-
-			verts[i].texcoord.x = U;
-			verts[i].texcoord.y = -V;
-		}
-	}
-	else
+	int bodyGroupLOD = lod;
+	uint8 modelDescId = EGF_INVALID_IDX;
+	do
 	{
-		// generate new texture coordinates
-		for (int i = 0; i < verts.numElem(); i++)
-		{
-			verts[i].tangent = fastNormalize(verts[i].tangent);
-			verts[i].binormal = fastNormalize(verts[i].binormal);
-			verts[i].normal = fastNormalize(verts[i].normal);
-
-			const float one_over_w = 1.0f / fabs(dot(decalSize, Vector3D(verts[i].tangent)));
-			const float one_over_h = 1.0f / fabs(dot(decalSize, Vector3D(verts[i].binormal)));
+		modelDescId = lodModel->modelsIndexes[bodyGroupLOD];
+		bodyGroupLOD--;
+	} while (modelDescId == EGF_INVALID_IDX && bodyGroupLOD >= 0);
 
-			const Vector3D t(verts[i].tangent);
-			const Vector3D b(verts[i].binormal);
-
-			verts[i].texcoord.x = fabs(dot(info.origin - verts[i].pos.xyz(), t * sign(t)) * one_over_w + 0.5f);
-			verts[i].texcoord.y = fabs(dot(info.origin - verts[i].pos.xyz(), b * sign(b)) * one_over_h + 0.5f);
-		}
-	}
-
-	// it needs TBN refreshing
-	for (int i = 0; i < indices.numElem(); i += 3)
-	{
-		const int idxs[3] = { indices[i], indices[i + 1], indices[i + 2] };
-
-		Vector3D t, b, n;
-
-		ComputeTriangleTBN(
-			Vector3D(verts[idxs[0]].pos.xyz()),
-			Vector3D(verts[idxs[1]].pos.xyz()),
-			Vector3D(verts[idxs[2]].pos.xyz()),
-			verts[idxs[0]].texcoord,
-			verts[idxs[1]].texcoord,
-			verts[idxs[2]].texcoord,
-			n,
-			t,
-			b);
-
-		verts[idxs[0]].tangent = t;
-		verts[idxs[0]].binormal = b;
-		verts[idxs[1]].tangent = t;
-		verts[idxs[1]].binormal = b;
-		verts[idxs[2]].tangent = t;
-		verts[idxs[2]].binormal = b;
-	}
-#endif
+	return modelDescId;
 }
 
 // makes dynamic temporary decal
 CRefPtr<DecalData> CEqStudioGeom::MakeDecal(const DecalMakeInfo& info, Matrix4x4* jointMatrices, int bodyGroupFlags, int lod) const
 {
-	ASSERT_FAIL("Not implemented");
-#if 0
 	if (r_egf_NoTempDecals.GetBool())
 		return nullptr;
 
-	const studioHdr_t* studio = m_studio;
-
-	Vector3D decal_origin = info.origin;
-	Vector3D decal_normal = info.normal;
-
-	Array<EGFHwVertex> verts(PP_SL);
-	Array<int> indices(PP_SL);
+	if (!m_meshGroupBVHs.numElem())
+		return nullptr;
 
-	Matrix4x4 tempMatrixArray[128];
+	const studioHdr_t& studio = *m_studio;
 
-	if (jointMatrices)
+	FrameArray<Matrix4x4> skinMatrices(PP_SL);
+	if (jointMatrices && studio.numBones)
 	{
-		// Send all matrices as 4x3
-		for (int i = 0; i < studio->numBones; i++)
-		{
-			// FIXME: kind of slowness
-			tempMatrixArray[i] = (!m_joints[i].absTrans * jointMatrices[i]);
-		}
+		skinMatrices.setNum(studio.numBones);
+		for (int i = 0; i < studio.numBones; ++i)
+			skinMatrices[i] = m_joints[i].invAbsTrans * jointMatrices[i];
 	}
 
-	BoundingBox bbox(decal_origin - info.size, decal_origin + info.size);
-
-	// we should transform every vertex and find an intersecting ones
-	for (int i = 0; i < studio->numBodyGroups; i++)
+	FrameArray<const CStudioMeshBVH*> meshGroupBVHs(PP_SL);
+	for (int i = 0; i < studio.numBodyGroups; ++i)
 	{
 		if (!(bodyGroupFlags & (1 << i)))
 			continue;
 
-		const int bodyGroupLodIndex = studio->pBodyGroups(i)->lodModelIndex;
-		const studioLodModel_t* lodModel = studio->pLodModel(bodyGroupLodIndex);
-
-		// get the right LOD model number
-		int bodyGroupLOD = lod;
-		uint8 modelDescId = EGF_INVALID_IDX;
-		do
-		{
-			modelDescId = lodModel->modelsIndexes[bodyGroupLOD];
-			bodyGroupLOD--;
-		} while (modelDescId == EGF_INVALID_IDX && bodyGroupLOD >= 0);
-
-		if (modelDescId == EGF_INVALID_IDX)
+		const uint8 modelDescId = GetBodyGroupMeshGroup(studio, i, lod);
+		if (modelDescId == EGF_INVALID_IDX || modelDescId >= m_meshGroupBVHs.numElem())
 			continue;
 
-		const studioMeshGroupDesc_t* modDesc = studio->pMeshGroupDesc(modelDescId);
-
-		Array<EGFHwVertex> g_verts(PP_SL);
-		Array<int> g_indices(PP_SL);
-		Array<int> g_orig_indices(PP_SL);
-
-		for (int j = 0; j < modDesc->numMeshes; j++)
-		{
-			const studioMeshDesc_t* pMesh = modDesc->pMesh(j);
-
-			const uint32* pIndices = pMesh->pVertexIdx(0);
-
-			g_verts.clear();
-			g_indices.clear();
-			g_orig_indices.clear();
-
-			g_verts.reserve(pMesh->numIndices);
-			g_indices.reserve(pMesh->numIndices);
-			g_orig_indices.reserve(pMesh->numIndices);
-
-			const int numIndices = (pMesh->primitiveType == STUDIO_PRIM_TRI_STRIP) ? pMesh->numIndices - 2 : pMesh->numIndices;
-			const int indexStep = (pMesh->primitiveType == STUDIO_PRIM_TRI_STRIP) ? 1 : 3;
-
-			for (int k = 0; k < numIndices; k += indexStep)
-			{
-				// skip strip degenerates
-				if (pIndices[k] == pIndices[k + 1] || pIndices[k] == pIndices[k + 2] || pIndices[k + 1] == pIndices[k + 2])
-					continue;
-
-				const int even = k % 2;	// handle flipped triangles on STUDIO_PRIM_TRI_STRIP
-				
-				int i0, i1, i2;
-				if (even && pMesh->primitiveType == STUDIO_PRIM_TRI_STRIP)
-				{
-					i0 = pIndices[k + 2];
-					i1 = pIndices[k + 1];
-					i2 = pIndices[k];
-				}
-				else
-				{
-					i0 = pIndices[k];
-					i1 = pIndices[k + 1];
-					i2 = pIndices[k + 2];
-				}
-
-				EGFHwVertex v0(*pMesh->pVertex(i0));
-				EGFHwVertex v1(*pMesh->pVertex(i1));
-				EGFHwVertex v2(*pMesh->pVertex(i2));
-
-				// for skinning we transform vertices but we add raw verts to decal later
-				if (jointMatrices)
-				{
-					TransformEGFVertex(v0, tempMatrixArray);
-					TransformEGFVertex(v1, tempMatrixArray);
-					TransformEGFVertex(v2, tempMatrixArray);
-				}
-
-				BoundingBox vbox;
-				vbox.AddVertex(v0.pos.xyz());
-				vbox.AddVertex(v1.pos.xyz());
-				vbox.AddVertex(v2.pos.xyz());
-
-				// make and check surface normal
-				const Vector3D normal = (v0.normal + v1.normal + v2.normal) / 3.0f;
-
-				auto egf_vertex_comp = [](const EGFHwVertex& a, const EGFHwVertex& b) -> bool
-				{
-					return (a.pos == b.pos) && (a.texcoord == b.texcoord);
-				};
-
-				if (bbox.Intersects(vbox) && dot(normal, decal_normal) < 0)
-				{
-					// TODO: optimize using Map and HashVector3D
-					g_indices.append(g_verts.addUnique(v0, egf_vertex_comp));
-					g_indices.append(g_verts.addUnique(v1, egf_vertex_comp));
-					g_indices.append(g_verts.addUnique(v2, egf_vertex_comp));
-
-					g_orig_indices.append(pIndices[k]);
-					g_orig_indices.append(pIndices[k + 1]);
-					g_orig_indices.append(pIndices[k + 2]);
-				}
-			}
-
-			MakeDecalTexCoord(g_verts, g_indices, info);
-
-			const int start = verts.numElem();
-
-			verts.resize(g_indices.numElem());
-			indices.resize(g_indices.numElem());
-
-			for (int k = 0; k < g_indices.numElem(); k++)
-			{
-				indices.append(start + g_indices[k]);
-
-				// restore vertex position in case of skinning
-				g_verts[g_indices[k]].pos = Vector4D(pMesh->pVertex(g_orig_indices[k])->point, 1.0f);
-			}
-
-			verts.append(g_verts);
-		}
-	}
-
-	if (verts.numElem() && indices.numElem())
-	{
-		CRefPtr<DecalData> decal = CRefPtr_new(DecalData);
-
-		decal->material = info.material;
-		decal->flags = DECAL_FLAG_STUDIODECAL;
-		decal->numVerts = verts.numElem();
-		decal->numIndices = indices.numElem();
-		decal->verts = PPAllocStructArray(EGFHwVertex, decal->numVerts);
-		decal->indices = PPAllocStructArray(uint16, decal->numIndices);
-
-		// copy geometry
-		memcpy(decal->verts, verts.ptr(), sizeof(EGFHwVertex) * decal->numVerts);
-
-		for (int i = 0; i < decal->numIndices; i++)
-			decal->indices[i] = indices[i];
-
-		return decal;
+		meshGroupBVHs.append(&m_meshGroupBVHs[modelDescId]);
 	}
 
-#endif
-	return nullptr;
+	return Studio_MakeDecal(meshGroupBVHs, skinMatrices, info);
 }
 
-
 float CEqStudioGeom::CheckIntersectionWithRay(const Vector3D& rayStart, const Vector3D& rayDir, int bodyGroupFlags, int lod) const
 {
 	float f1, f2;
 	if(!m_boundingBox.IntersectsRay(rayStart, rayDir, f1, f2))
 		return F_INFINITY;
 
-	float best_dist = F_INFINITY;
+	float bestDist = F_INFINITY;
 
 	const studioHdr_t& studio = *m_studio;
 
@@ -1267,63 +1044,14 @@ float CEqStudioGeom::CheckIntersectionWithRay(const Vector3D& rayStart, const Ve
 		if (!(bodyGroupFlags & (1 << i)))
 			continue;
 
-		const int bodyGroupLodIndex = studio.pBodyGroups(i)->lodModelIndex;
-		const studioLodModel_t* lodModel = studio.pLodModel(bodyGroupLodIndex);
-
-		// get the right LOD model number
-		int bodyGroupLOD = lod;
-		uint8 modelDescId = EGF_INVALID_IDX;
-		do
-		{
-			modelDescId = lodModel->modelsIndexes[bodyGroupLOD];
-			bodyGroupLOD--;
-		} while (modelDescId == EGF_INVALID_IDX && bodyGroupLOD >= 0);
-
-		if (modelDescId == EGF_INVALID_IDX)
+		const uint8 modelDescId = GetBodyGroupMeshGroup(studio, i, lod);
+		if (modelDescId == EGF_INVALID_IDX || modelDescId >= m_meshGroupBVHs.numElem())
 			continue;
 
-		const studioMeshGroupDesc_t* modDesc = studio.pMeshGroupDesc(modelDescId);
-
-		for(int j = 0; j < modDesc->numMeshes; j++)
-		{
-			const studioMeshDesc_t* pMesh = modDesc->pMesh(j);
-
-			const uint32* pIndices = pMesh->pVertexIdx(0);
-
-			const int numIndices = (pMesh->primitiveType == STUDIO_PRIM_TRI_STRIP) ? pMesh->numIndices - 2 : pMesh->numIndices;
-			const int indexStep = (pMesh->primitiveType == STUDIO_PRIM_TRI_STRIP) ? 1 : 3;
-
-			for (int k = 0; k < numIndices; k += indexStep)
-			{
-				// skip strip degenerates
-				if (pIndices[k] == pIndices[k+1] || pIndices[k] == pIndices[k+2] || pIndices[k+1] == pIndices[k+2])
-					continue;
-
-				const int even = k % 2; // handle flipped triangles on STUDIO_PRIM_TRI_STRIP
-
-				Vector3D v0, v1, v2;
-				if (even && pMesh->primitiveType == STUDIO_PRIM_TRI_STRIP)
-				{
-					v0 = pMesh->pPosUvs(pIndices[k + 2])->point;
-					v1 = pMesh->pPosUvs(pIndices[k + 1])->point;
-					v2 = pMesh->pPosUvs(pIndices[k])->point;
-				}
-				else
-				{
-					v0 = pMesh->pPosUvs(pIndices[k])->point;
-					v1 = pMesh->pPosUvs(pIndices[k + 1])->point;
-					v2 = pMesh->pPosUvs(pIndices[k + 2])->point;
-				}
-
-				float dist = F_INFINITY;
-				if(IsRayIntersectsTriangle(v0,v1,v2, rayStart, rayDir, dist, true))
-				{
-					if(dist < best_dist && dist > 0)
-						best_dist = dist;
-				}
-			}
-		}
+		const float dist = m_meshGroupBVHs[modelDescId].TestRay(rayStart, rayDir, bestDist);
+		if (dist < bestDist)
+			bestDist = dist;
 	}
 
-	return best_dist;
-}
\ No newline at end of file
+	return bestDist;
+}
@@ -18,12 +18,14 @@ using IGPUBufferPtr = CRefPtr<IGPUBuffer>;
 
 class IVertexFormat;
 class CBaseEqGeomInstancer;
+class CStudioMeshBVH;
 struct MeshInstanceData;
 struct RenderDrawCmd;
 struct DecalMakeInfo;
 struct DecalData;
 struct RenderBoneTransform;
 struct RenderPassContext;
+class CRenderDrawBucket;
 
 enum EModelLoadingState
 {
@@ -96,6 +98,7 @@ private:
 	bool					LoadGenerateVertexBuffer();
 	void					LoadMotionPackages();
 	void					LoadSetupBones();
+	void					LoadBuildBVH();
 
 	//-----------------------------------------------
 
@@ -116,6 +119,7 @@ private:
 
 	StudioJoint*			m_joints{ nullptr };
 	ArrayRef<HWGeomRef>		m_hwGeomRefs{ nullptr };	// hardware representation of models (indices)
+	ArrayRef<CStudioMeshBVH>	m_meshGroupBVHs{ nullptr };	// triangle trees for ray and decal queries, for each mesh group
 
 	CBaseEqGeomInstancer*	m_instancer{ nullptr };
 	studioHdr_t*			m_studio{ nullptr };
@@ -148,6 +152,10 @@ struct CEqStudioGeom::DrawProps
 
 	SetupDrawFunc			setupDrawCmd;	// called once before entire EGF is drawn
 	BodyGroupFunc			setupBodyGroup;	// called multiple times before body group is drawn
+
+	CRenderDrawBucket*		drawBucket{ nullptr };	// when set, draw commands are recorded into bucket instead of drawing immediately
+	float					drawBucketDepth{ 0.0f };
+	int						drawBucketPass{ 0 };
 	
 	int						bodyGroupFlags{ -1 };
 	int						materialGroup{ 0 };
@@ -0,0 +1,360 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2020
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Triangle bounding volume hierarchy of EGF mesh group
+//				used for ray picking and decal projection
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "core/core_common.h"
+#include "math/Utility.h"
+#include "studiofile/StudioLoader.h"
+#include "StudioGeomBVH.h"
+
+static constexpr const int BVH_SAH_BINS = 16;
+
+struct CStudioMeshBVH::BuildTriangle
+{
+	BoundingBox		bounds;
+	Vector3D		center;
+	int				triangleIdx;
+};
+
+static float BoxHalfArea(const BoundingBox& box)
+{
+	if (box.IsEmpty())
+		return 0.0f;
+
+	const Vector3D size = box.GetSize();
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+void CStudioMeshBVH::Clear()
+{
+	m_meshGroup = nullptr;
+	m_hwStreams = nullptr;
+	m_nodes.clear(true);
+	m_triangles.clear(true);
+}
+
+const BoundingBox CStudioMeshBVH::GetBounds() const
+{
+	if (m_nodes.numElem() == 0)
+		return BoundingBox();
+
+	return BoundingBox(m_nodes[0].mins, m_nodes[0].maxs);
+}
+
+void CStudioMeshBVH::GetTriangleVerts(const Triangle& tri, Vector3D& v0, Vector3D& v1, Vector3D& v2) const
+{
+	const studioMeshDesc_t* mesh = m_meshGroup->pMesh(tri.mesh);
+	v0 = Studio_GetMeshVertexPoint(m_hwStreams, mesh, tri.indices[0]);
+	v1 = Studio_GetMeshVertexPoint(m_hwStreams, mesh, tri.indices[1]);
+	v2 = Studio_GetMeshVertexPoint(m_hwStreams, mesh, tri.indices[2]);
+}
+
+void CStudioMeshBVH::Build(const studioMeshGroupDesc_t* meshGroup, const studioHwStreamsDesc_t* hwStreams)
+{
+	Clear();
+	m_meshGroup = meshGroup;
+	m_hwStreams = hwStreams;
+
+	int maxTriangles = 0;
+	for (int i = 0; i < meshGroup->numMeshes; ++i)
+	{
+		const studioMeshDesc_t* mesh = meshGroup->pMesh(i);
+		if (!(mesh->vertexType & STUDIO_VERTFLAG_POS_UV))
+			continue;
+		maxTriangles += (mesh->primitiveType == STUDIO_PRIM_TRI_STRIP) ? max((int)mesh->numIndices - 2, 0) : mesh->numIndices / 3;
+	}
+
+	if (!maxTriangles)
+		return;
+
+	m_triangles.reserve(maxTriangles);
+
+	for (int i = 0; i < meshGroup->numMeshes; ++i)
+	{
+		const studioMeshDesc_t* mesh = meshGroup->pMesh(i);
+		if (!(mesh->vertexType & STUDIO_VERTFLAG_POS_UV))
+			continue;
+
+		const bool isStrip = (mesh->primitiveType == STUDIO_PRIM_TRI_STRIP);
+
+		const int numIndices = isStrip ? (int)mesh->numIndices - 2 : (int)mesh->numIndices;
+		const int indexStep = isStrip ? 1 : 3;
+
+		for (int k = 0; k < numIndices; k += indexStep)
+		{
+			const uint32 indices[3] = {
+				Studio_GetMeshVertexIndex(m_hwStreams, mesh, k),
+				Studio_GetMeshVertexIndex(m_hwStreams, mesh, k + 1),
+				Studio_GetMeshVertexIndex(m_hwStreams, mesh, k + 2),
+			};
+
+			// skip strip degenerates
+			if (indices[0] == indices[1] || indices[0] == indices[2] || indices[1] == indices[2])
+				continue;
+
+			Triangle& tri = m_triangles.append();
+			tri.mesh = i;
+
+			// handle flipped triangles on STUDIO_PRIM_TRI_STRIP
+			if (isStrip && (k & 1))
+			{
+				tri.indices[0] = indices[2];
+				tri.indices[1] = indices[1];
+				tri.indices[2] = indices[0];
+			}
+			else
+			{
+				tri.indices[0] = indices[0];
+				tri.indices[1] = indices[1];
+				tri.indices[2] = indices[2];
+			}
+		}
+	}
+
+	const int numTriangles = m_triangles.numElem();
+	if (!numTriangles)
+		return;
+
+	Array<BuildTriangle> buildTris(PP_SL);
+	buildTris.setNum(numTriangles);
+
+	for (int i = 0; i < numTriangles; ++i)
+	{
+		Vector3D v0, v1, v2;
+		GetTriangleVerts(m_triangles[i], v0, v1, v2);
+
+		BuildTriangle& buildTri = buildTris[i];
+		buildTri.bounds.Reset();
+		buildTri.bounds.AddVertex(v0);
+		buildTri.bounds.AddVertex(v1);
+		buildTri.bounds.AddVertex(v2);
+		buildTri.center = buildTri.bounds.GetCenter();
+		buildTri.triangleIdx = i;
+	}
+
+	m_nodes.reserve(numTriangles * 2);
+	m_nodes.append();
+	BuildNode(0, buildTris, 0, numTriangles, 0);
+
+	// put triangles in leaf order so leaves reference contiguous ranges
+	Array<Triangle> orderedTriangles(PP_SL);
+	orderedTriangles.setNum(numTriangles);
+	for (int i = 0; i < numTriangles; ++i)
+		orderedTriangles[i] = m_triangles[buildTris[i].triangleIdx];
+
+	m_triangles.swap(orderedTriangles);
+	m_nodes.resize(m_nodes.numElem());
+}
+
+// Binned surface area heuristic split
+void CStudioMeshBVH::BuildNode(int nodeIdx, ArrayRef<BuildTriangle> buildTris, int start, int end, int depth)
+{
+	BoundingBox bounds;
+	BoundingBox centerBounds;
+	for (int i = start; i < end; ++i)
+	{
+		bounds.Merge(buildTris[i].bounds);
+		centerBounds.AddVertex(buildTris[i].center);
+	}
+
+	{
+		Node& node = m_nodes[nodeIdx];
+		node.mins = bounds.minPoint;
+		node.maxs = bounds.maxPoint;
+		node.first = start;
+		node.count = end - start;
+	}
+
+	const int count = end - start;
+	if (count <= MAX_LEAF_TRIANGLES || depth >= MAX_DEPTH - 2)
+		return;
+
+	const Vector3D centerExtents = centerBounds.GetSize();
+	int axis = 0;
+	if (centerExtents.y > centerExtents[axis])
+		axis = 1;
+	if (centerExtents.z > centerExtents[axis])
+		axis = 2;
+
+	int mid = start;
+	if (centerExtents[axis] > F_EPS)
+	{
+		int binCount[BVH_SAH_BINS] = { 0 };
+		BoundingBox binBounds[BVH_SAH_BINS];
+
+		const float binScale = BVH_SAH_BINS / centerExtents[axis];
+		const float binMin = centerBounds.minPoint[axis];
+		auto binIndex = [&](const BuildTriangle& tri) {
+			return min((int)((tri.center[axis] - binMin) * binScale), BVH_SAH_BINS - 1);
+		};
+
+		for (int i = start; i < end; ++i)
+		{
+			const int bin = binIndex(buildTris[i]);
+			++binCount[bin];
+			binBounds[bin].Merge(buildTris[i].bounds);
+		}
+
+		// right side sweep, then pick the cheapest split during left side sweep
+		float rightCost[BVH_SAH_BINS];
+		{
+			BoundingBox rightBounds;
+			int rightCount = 0;
+			for (int i = BVH_SAH_BINS - 1; i > 0; --i)
+			{
+				rightBounds.Merge(binBounds[i]);
+				rightCount += binCount[i];
+				rightCost[i] = rightCount * BoxHalfArea(rightBounds);
+			}
+		}
+
+		BoundingBox leftBounds;
+		int leftCount = 0;
+		int bestSplit = -1;
+		float bestCost = F_INFINITY;
+		for (int i = 1; i < BVH_SAH_BINS; ++i)
+		{
+			leftBounds.Merge(binBounds[i - 1]);
+			leftCount += binCount[i - 1];
+			if (!leftCount || leftCount == count)
+				continue;
+
+			const float cost = leftCount * BoxHalfArea(leftBounds) + rightCost[i];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = i;
+			}
+		}
+
+		if (bestSplit != -1)
+		{
+			int right = end;
+			while (mid < right)
+			{
+				if (binIndex(buildTris[mid]) < bestSplit)
+					++mid;
+				else
+					QuickSwap(buildTris[mid], buildTris[--right]);
+			}
+		}
+	}
+
+	// all centers in one spot or in one bin
+	if (mid == start || mid == end)
+		mid = (start + end) / 2;
+
+	const int firstChild = m_nodes.numElem();
+	m_nodes.append();
+	m_nodes.append();
+
+	{
+		Node& node = m_nodes[nodeIdx];
+		node.first = firstChild;
+		node.count = 0;
+	}
+
+	BuildNode(firstChild, buildTris, start, mid, depth + 1);
+	BuildNode(firstChild + 1, buildTris, mid, end, depth + 1);
+}
+
+static bool IntersectRayNode(const CStudioMeshBVH::Node& node, const Vector3D& rayStart, const Vector3D& invDir, float maxFraction, float& fraction)
+{
+	float tmin = 0.0f;
+	float tmax = maxFraction;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		float t1 = (node.mins[i] - rayStart[i]) * invDir[i];
+		float t2 = (node.maxs[i] - rayStart[i]) * invDir[i];
+		if (t1 > t2)
+			QuickSwap(t1, t2);
+
+		tmin = max(tmin, t1);
+		tmax = min(tmax, t2);
+	}
+
+	fraction = tmin;
+	return tmin <= tmax;
+}
+
+float CStudioMeshBVH::TestRay(const Vector3D& rayStart, const Vector3D& rayDir, float maxFraction, bool twoSided) const
+{
+	if (m_nodes.numElem() == 0)
+		return F_INFINITY;
+
+	// very large value instead of division by zero keeps slabs away from NaN
+	Vector3D invDir;
+	for (int i = 0; i < 3; ++i)
+		invDir[i] = fabs(rayDir[i]) > F_EPS ? 1.0f / rayDir[i] : (rayDir[i] < 0.0f ? -1e30f : 1e30f);
+
+	float bestFraction = maxFraction;
+	bool hit = false;
+
+	float rootFraction;
+	if (!IntersectRayNode(m_nodes[0], rayStart, invDir, bestFraction, rootFraction))
+		return F_INFINITY;
+
+	int stack[MAX_DEPTH];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize)
+	{
+		const Node& node = m_nodes[stack[--stackSize]];
+
+		// node could be pushed before closer hit was found
+		float nodeFraction;
+		if (!IntersectRayNode(node, rayStart, invDir, bestFraction, nodeFraction))
+			continue;
+
+		if (node.count)
+		{
+			for (int i = 0; i < node.count; ++i)
+			{
+				Vector3D v0, v1, v2;
+				GetTriangleVerts(m_triangles[node.first + i], v0, v1, v2);
+
+				float fraction = F_INFINITY;
+				if (!IsRayIntersectsTriangle(v0, v1, v2, rayStart, rayDir, fraction, twoSided))
+					continue;
+
+				if (fraction > 0.0f && fraction < bestFraction)
+				{
+					bestFraction = fraction;
+					hit = true;
+				}
+			}
+			continue;
+		}
+
+		float leftFraction, rightFraction;
+		const bool hitLeft = IntersectRayNode(m_nodes[node.first], rayStart, invDir, bestFraction, leftFraction);
+		const bool hitRight = IntersectRayNode(m_nodes[node.first + 1], rayStart, invDir, bestFraction, rightFraction);
+
+		// closer child is popped first
+		if (hitLeft && hitRight)
+		{
+			if (leftFraction < rightFraction)
+			{
+				stack[stackSize++] = node.first + 1;
+				stack[stackSize++] = node.first;
+			}
+			else
+			{
+				stack[stackSize++] = node.first;
+				stack[stackSize++] = node.first + 1;
+			}
+		}
+		else if (hitLeft)
+			stack[stackSize++] = node.first;
+		else if (hitRight)
+			stack[stackSize++] = node.first + 1;
+	}
+
+	return hit ? bestFraction : F_INFINITY;
+}
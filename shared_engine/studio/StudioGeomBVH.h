@@ -0,0 +1,94 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2020
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Triangle bounding volume hierarchy of EGF mesh group
+//				used for ray picking and decal projection
+//////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "egf/model.h"
+
+class CStudioMeshBVH
+{
+public:
+	static constexpr const int MAX_LEAF_TRIANGLES = 4;
+	static constexpr const int MAX_DEPTH = 64;
+
+	// 32 bytes, children of inner node are always stored next to each other
+	struct Node
+	{
+		Vector3D	mins;
+		int			first{ 0 };		// first triangle if leaf, left child otherwise
+		Vector3D	maxs;
+		int			count{ 0 };		// triangle count if leaf, 0 for inner node
+	};
+
+	struct Triangle
+	{
+		int			mesh;
+		int			indices[3];		// vertex indices in mesh with strip winding resolved
+	};
+
+	// hwStreams are required for EGF 14 models which meshes refer to them
+	void					Build(const studioMeshGroupDesc_t* meshGroup, const studioHwStreamsDesc_t* hwStreams = nullptr);
+	void					Clear();
+
+	bool					IsEmpty() const { return m_nodes.numElem() == 0; }
+	const BoundingBox		GetBounds() const;
+	const studioMeshGroupDesc_t*	GetMeshGroup() const { return m_meshGroup; }
+	const studioHwStreamsDesc_t*	GetHwStreams() const { return m_hwStreams; }
+
+	ArrayCRef<Node>			GetNodes() const { return m_nodes; }
+	ArrayCRef<Triangle>		GetTriangles() const { return m_triangles; }
+
+	void					GetTriangleVerts(const Triangle& tri, Vector3D& v0, Vector3D& v1, Vector3D& v2) const;
+
+	// returns closest ray fraction (in rayDir units) or F_INFINITY
+	float					TestRay(const Vector3D& rayStart, const Vector3D& rayDir, float maxFraction = F_INFINITY, bool twoSided = true) const;
+
+	// calls func(int triangleIdx) for triangles in leaves which bounds intersect box
+	template<typename FUNC>
+	void					QueryBox(const BoundingBox& box, FUNC func) const;
+
+private:
+	struct BuildTriangle;
+
+	void					BuildNode(int nodeIdx, ArrayRef<BuildTriangle> buildTris, int start, int end, int depth);
+
+	const studioMeshGroupDesc_t*	m_meshGroup{ nullptr };
+	const studioHwStreamsDesc_t*	m_hwStreams{ nullptr };
+	Array<Node>				m_nodes{ PP_SL };
+	Array<Triangle>			m_triangles{ PP_SL };
+};
+
+template<typename FUNC>
+inline void CStudioMeshBVH::QueryBox(const BoundingBox& box, FUNC func) const
+{
+	if (m_nodes.numElem() == 0)
+		return;
+
+	int stack[MAX_DEPTH];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize)
+	{
+		const Node& node = m_nodes[stack[--stackSize]];
+
+		if (box.minPoint.x > node.maxs.x || box.maxPoint.x < node.mins.x ||
+			box.minPoint.y > node.maxs.y || box.maxPoint.y < node.mins.y ||
+			box.minPoint.z > node.maxs.z || box.maxPoint.z < node.mins.z)
+			continue;
+
+		if (node.count)
+		{
+			for (int i = 0; i < node.count; ++i)
+				func(node.first + i);
+			continue;
+		}
+
+		stack[stackSize++] = node.first + 1;
+		stack[stackSize++] = node.first;
+	}
+}
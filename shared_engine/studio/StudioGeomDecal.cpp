@@ -0,0 +1,331 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2020
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Decal geometry of EGF mesh groups
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "core/core_common.h"
+#include "math/Utility.h"
+#include "studiofile/StudioLoader.h"
+
+#include "StudioGeomDecal.h"
+#include "StudioGeomBVH.h"
+#include "StudioVertex.h"
+
+#include "render/Decals.h"
+#include "materialsystem1/IMaterial.h"
+
+struct StudioDecalVertex
+{
+	Vector3D					position;		// bind pose
+	Vector2D					texCoord;
+	Vector3D					tangent;
+	Vector3D					binormal;
+	Vector3D					normal;
+
+	// skinned by joint matrices, decal is projected in this space
+	Vector3D					projPosition;
+	Vector3D					projTangent;
+	Vector3D					projBinormal;
+	Vector3D					projNormal;
+
+	studioBoneWeight_t			boneWeight;		// numweights is 0 if vertex is not skinned
+};
+
+static void GetStudioDecalVertex(const studioHwStreamsDesc_t* hwStreams, const studioMeshDesc_t* mesh, int vertexIdx, ArrayCRef<Matrix4x4> skinMatrices, StudioDecalVertex& vert)
+{
+	studioVertexPosUv_t posUv;
+	studioVertexTBN_t tbn;
+	tbn.tangent = vec3_right;
+	tbn.binormal = vec3_forward;
+	tbn.normal = vec3_up;
+	memset(&vert.boneWeight, 0, sizeof(vert.boneWeight));
+
+	Studio_GetMeshVertex(hwStreams, mesh, vertexIdx, &posUv, &tbn, &vert.boneWeight, nullptr);
+
+	vert.position = posUv.point;
+	vert.texCoord = posUv.texCoord;
+	vert.tangent = tbn.tangent;
+	vert.binormal = tbn.binormal;
+	vert.normal = tbn.normal;
+
+	if (!vert.boneWeight.numweights || !skinMatrices.numElem())
+	{
+		vert.projPosition = vert.position;
+		vert.projTangent = vert.tangent;
+		vert.projBinormal = vert.binormal;
+		vert.projNormal = vert.normal;
+		return;
+	}
+
+	vert.projPosition = vec3_zero;
+	vert.projTangent = vec3_zero;
+	vert.projBinormal = vec3_zero;
+	vert.projNormal = vec3_zero;
+
+	for (int i = 0; i < vert.boneWeight.numweights; ++i)
+	{
+		const Matrix4x4& skinMatrix = skinMatrices[vert.boneWeight.bones[i]];
+		const float weight = vert.boneWeight.weight[i];
+
+		vert.projPosition += transformPoint(vert.position, skinMatrix) * weight;
+		vert.projTangent += rotateVector(vert.tangent, skinMatrix) * weight;
+		vert.projBinormal += rotateVector(vert.binormal, skinMatrix) * weight;
+		vert.projNormal += rotateVector(vert.normal, skinMatrix) * weight;
+	}
+}
+
+static StudioDecalVertex LerpStudioDecalVertex(const StudioDecalVertex& a, const StudioDecalVertex& b, float t)
+{
+	StudioDecalVertex vert;
+	vert.position = lerp(a.position, b.position, t);
+	vert.texCoord = lerp(a.texCoord, b.texCoord, t);
+	vert.tangent = lerp(a.tangent, b.tangent, t);
+	vert.binormal = lerp(a.binormal, b.binormal, t);
+	vert.normal = lerp(a.normal, b.normal, t);
+	vert.projPosition = lerp(a.projPosition, b.projPosition, t);
+	vert.projTangent = lerp(a.projTangent, b.projTangent, t);
+	vert.projBinormal = lerp(a.projBinormal, b.projBinormal, t);
+	vert.projNormal = lerp(a.projNormal, b.projNormal, t);
+
+	// weights can't be blended, take them from closest vertex
+	vert.boneWeight = (t < 0.5f) ? a.boneWeight : b.boneWeight;
+	return vert;
+}
+
+// Sutherland-Hodgman clipping of convex polygon by decal box planes in projection space
+static void ClipStudioDecalPolygon(FrameArray<StudioDecalVertex>& polygon, const BoundingBox& box)
+{
+	FrameArray<StudioDecalVertex> clipped(PP_SL);
+	clipped.reserve(polygon.numElem() + 6);
+
+	for (int plane = 0; plane < 6 && polygon.numElem() >= 3; ++plane)
+	{
+		const int axis = plane >> 1;
+		const bool isMax = plane & 1;
+		const float planeDist = isMax ? box.maxPoint[axis] : box.minPoint[axis];
+
+		// positive distance is inside of box
+		auto distance = [&](const StudioDecalVertex& vert) {
+			return isMax ? planeDist - vert.projPosition[axis] : vert.projPosition[axis] - planeDist;
+		};
+
+		clipped.clear(false);
+		for (int i = 0; i < polygon.numElem(); ++i)
+		{
+			const StudioDecalVertex& a = polygon[i];
+			const StudioDecalVertex& b = polygon[(i + 1) % polygon.numElem()];
+			const float distA = distance(a);
+			const float distB = distance(b);
+
+			if (distA >= 0.0f)
+				clipped.append(a);
+
+			if ((distA >= 0.0f) != (distB >= 0.0f))
+				clipped.append(LerpStudioDecalVertex(a, b, distA / (distA - distB)));
+		}
+
+		polygon.swap(clipped);
+	}
+}
+
+static void MakeDecalTexCoord(ArrayRef<StudioDecalVertex> verts, ArrayCRef<int> indices, const DecalMakeInfo& info)
+{
+	const Vector3D decalSize = info.size * 2.0f;
+
+	if (info.flags & DECAL_MAKE_FLAG_TEX_NORMAL)
+	{
+		Vector3D uaxis;
+		Vector3D vaxis;
+
+		const Vector3D axisAngles = VectorAngles(info.normal);
+		AngleVectors(axisAngles, nullptr, &uaxis, &vaxis);
+
+		vaxis *= -1;
+
+		Matrix3x3 texMatrix(uaxis, vaxis, info.normal);
+
+		const Matrix3x3 rotationMat = rotateZXY3(0.0f, 0.0f, DEG2RAD(info.texRotation));
+		texMatrix = rotationMat * texMatrix;
+
+		uaxis = texMatrix.rows[0];
+		vaxis = texMatrix.rows[1];
+
+		const float oneOverW = 1.0f / fabs(dot(decalSize, uaxis * uaxis) * info.texScale.x);
+		const float oneOverH = 1.0f / fabs(dot(decalSize, vaxis * vaxis) * info.texScale.y);
+
+		for (StudioDecalVertex& vert : verts)
+		{
+			const float U = dot(uaxis, info.origin - vert.projPosition) * oneOverW + 0.5f;
+			const float V = dot(vaxis, info.origin - vert.projPosition) * oneOverH - 0.5f;
+
+			vert.texCoord.x = U;
+			vert.texCoord.y = -V;
+		}
+	}
+	else
+	{
+		for (StudioDecalVertex& vert : verts)
+		{
+			const Vector3D t = fastNormalize(vert.projTangent);
+			const Vector3D b = fastNormalize(vert.projBinormal);
+
+			const float oneOverW = 1.0f / fabs(dot(decalSize, t));
+			const float oneOverH = 1.0f / fabs(dot(decalSize, b));
+
+			vert.texCoord.x = fabs(dot(info.origin - vert.projPosition, t * sign(t)) * oneOverW + 0.5f);
+			vert.texCoord.y = fabs(dot(info.origin - vert.projPosition, b * sign(b)) * oneOverH + 0.5f);
+		}
+	}
+
+	// it needs TBN refreshing
+	for (int i = 0; i < indices.numElem(); i += 3)
+	{
+		StudioDecalVertex& v0 = verts[indices[i]];
+		StudioDecalVertex& v1 = verts[indices[i + 1]];
+		StudioDecalVertex& v2 = verts[indices[i + 2]];
+
+		Vector3D t, b, n;
+		ComputeTriangleTBN(v0.position, v1.position, v2.position, v0.texCoord, v1.texCoord, v2.texCoord, n, t, b);
+
+		v0.tangent = t;
+		v0.binormal = b;
+		v1.tangent = t;
+		v1.binormal = b;
+		v2.tangent = t;
+		v2.binormal = b;
+	}
+}
+
+CRefPtr<DecalData> Studio_MakeDecal(ArrayCRef<const CStudioMeshBVH*> meshGroupBVHs, ArrayCRef<Matrix4x4> skinMatrices, const DecalMakeInfo& info)
+{
+	const BoundingBox decalBox(info.origin - info.size, info.origin + info.size);
+
+	// Skinned triangles are searched in bind pose with decal box moved by each bone.
+	// Vertices blended between strongly bent bones may fall out of all of them.
+	FrameArray<BoundingBox> boneDecalBoxes(PP_SL);
+	boneDecalBoxes.setNum(skinMatrices.numElem());
+	for (int i = 0; i < skinMatrices.numElem(); ++i)
+	{
+		const Matrix4x4 invSkinMatrix = !skinMatrices[i];
+		BoundingBox& boneBox = boneDecalBoxes[i];
+		boneBox.Reset();
+		for (int j = 0; j < BoundingBox::VertexCount; ++j)
+			boneBox.AddVertex(transformPoint(decalBox.GetVertex(j), invSkinMatrix));
+	}
+
+	const bool clipToBox = (info.flags & DECAL_MAKE_FLAG_CLIPPING);
+
+	FrameArray<StudioDecalVertex> verts(PP_SL);
+	FrameArray<int> indices(PP_SL);
+	FrameArray<int> candidates(PP_SL);
+	FrameArray<uint> candidateBits(PP_SL);
+	FrameArray<StudioDecalVertex> polygon(PP_SL);
+
+	for (const CStudioMeshBVH* bvh : meshGroupBVHs)
+	{
+		if (bvh->IsEmpty())
+			continue;
+
+		const studioMeshGroupDesc_t* modDesc = bvh->GetMeshGroup();
+		ArrayCRef<CStudioMeshBVH::Triangle> triangles = bvh->GetTriangles();
+
+		candidates.clear(false);
+		candidateBits.setNum((triangles.numElem() + 31) / 32, false);
+		memset(candidateBits.ptr(), 0, candidateBits.numElem() * sizeof(uint));
+
+		auto addCandidate = [&](int triIdx) {
+			uint& bits = candidateBits[triIdx >> 5];
+			const uint mask = 1u << (triIdx & 31);
+			if (bits & mask)
+				return;
+			bits |= mask;
+			candidates.append(triIdx);
+		};
+
+		bvh->QueryBox(decalBox, addCandidate);
+		for (const BoundingBox& boneBox : boneDecalBoxes)
+			bvh->QueryBox(boneBox, addCandidate);
+
+		for (const int triIdx : candidates)
+		{
+			const CStudioMeshBVH::Triangle& tri = triangles[triIdx];
+			const studioMeshDesc_t* mesh = modDesc->pMesh(tri.mesh);
+
+			StudioDecalVertex triVerts[3];
+			BoundingBox triBox;
+			for (int j = 0; j < 3; ++j)
+			{
+				GetStudioDecalVertex(bvh->GetHwStreams(), mesh, tri.indices[j], skinMatrices, triVerts[j]);
+				triBox.AddVertex(triVerts[j].projPosition);
+			}
+
+			if (!decalBox.Intersects(triBox))
+				continue;
+
+			// make and check surface normal
+			const Vector3D normal = (triVerts[0].projNormal + triVerts[1].projNormal + triVerts[2].projNormal) / 3.0f;
+			if (dot(normal, info.normal) >= 0)
+				continue;
+
+			polygon.clear(false);
+			polygon.append(triVerts, 3);
+
+			if (clipToBox)
+				ClipStudioDecalPolygon(polygon, decalBox);
+
+			if (polygon.numElem() < 3 || verts.numElem() + polygon.numElem() > USHRT_MAX)
+				continue;
+
+			// triangle fan
+			const int firstVertex = verts.numElem();
+			verts.append(polygon.ptr(), polygon.numElem());
+			for (int j = 2; j < polygon.numElem(); ++j)
+			{
+				indices.append(firstVertex);
+				indices.append(firstVertex + j - 1);
+				indices.append(firstVertex + j);
+			}
+		}
+	}
+
+	if (!verts.numElem() || !indices.numElem() || indices.numElem() > USHRT_MAX)
+		return nullptr;
+
+	MakeDecalTexCoord(verts, indices, info);
+
+	CRefPtr<DecalData> decal = CRefPtr_new(DecalData);
+
+	decal->material = info.material;
+	decal->flags = DECAL_FLAG_STUDIODECAL;
+	decal->numVerts = verts.numElem();
+	decal->numIndices = indices.numElem();
+
+	// vertex streams are stored one after another
+	const int numVerts = verts.numElem();
+	decal->verts = PPAlloc(numVerts * (sizeof(EGFHwVertex::PositionUV) + sizeof(EGFHwVertex::TBN) + sizeof(EGFHwVertex::BoneWeights)));
+	decal->indices = PPAllocStructArray(uint16, decal->numIndices);
+
+	EGFHwVertex::PositionUV* posUvs = reinterpret_cast<EGFHwVertex::PositionUV*>(decal->verts);
+	EGFHwVertex::TBN* tbns = reinterpret_cast<EGFHwVertex::TBN*>(posUvs + numVerts);
+	EGFHwVertex::BoneWeights* boneWeights = reinterpret_cast<EGFHwVertex::BoneWeights*>(tbns + numVerts);
+
+	for (int i = 0; i < numVerts; ++i)
+	{
+		const StudioDecalVertex& vert = verts[i];
+
+		posUvs[i].point = Vector4D(vert.position, 1.0f);
+		posUvs[i].texCoord = vert.texCoord;
+
+		tbns[i] = EGFHwVertex::TBN({ vert.tangent, vert.binormal, vert.normal });
+		boneWeights[i] = EGFHwVertex::BoneWeights(vert.boneWeight);
+
+		decal->bbox.AddVertex(vert.projPosition);
+	}
+
+	for (int i = 0; i < decal->numIndices; ++i)
+		decal->indices[i] = indices[i];
+
+	return decal;
+}
@@ -0,0 +1,17 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2020
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Decal geometry of EGF mesh groups
+//////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+class CStudioMeshBVH;
+struct DecalMakeInfo;
+struct DecalData;
+
+// Makes decal from mesh group triangles found by their trees.
+// With skin matrices decal is projected onto skinned geometry,
+// output vertices are kept in bind pose with their bone weights.
+CRefPtr<DecalData> Studio_MakeDecal(ArrayCRef<const CStudioMeshBVH*> meshGroupBVHs, ArrayCRef<Matrix4x4> skinMatrices, const DecalMakeInfo& info);
@@ -0,0 +1,93 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2024
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Studio model renderable for render lists
+//////////////////////////////////////////////////////////////////////////////////
+
+#include "core/core_common.h"
+#include "materialsystem1/IMaterialSystem.h"
+#include "StudioRenderable.h"
+
+CStudioRenderable::CStudioRenderable(CEqStudioGeom* model)
+{
+	SetModel(model);
+}
+
+void CStudioRenderable::SetModel(CEqStudioGeom* model)
+{
+	m_model.Assign(model);
+	m_bbox = model ? model->GetBoundingBox() : BoundingBox();
+}
+
+void CStudioRenderable::SetInstanceFormat(IVertexFormat* instFormat)
+{
+	m_instFormat = instFormat;
+}
+
+void CStudioRenderable::SetInstanceData(const void* data, int size)
+{
+	m_instanceData.setNum(size, false);
+	memcpy(m_instanceData.ptr(), data, size);
+}
+
+int CStudioRenderable::GetDrawLod(float distance) const
+{
+	return m_lod >= 0 ? m_lod : m_model->SelectLod(distance);
+}
+
+void CStudioRenderable::DrawModel(const RenderInfo& rinfo, const MeshInstanceData& instData) const
+{
+	DrawProps drawProps = m_drawProps;
+	drawProps.lod = GetDrawLod(rinfo.distance);
+	drawProps.drawBucket = rinfo.drawBucket;
+	drawProps.drawBucketDepth = rinfo.distance;
+
+	if (m_instFormat)
+		drawProps.vertexFormat = m_instFormat;
+
+	m_model->Draw(drawProps, instData, rinfo.passContext);
+}
+
+void CStudioRenderable::Render(const RenderInfo& rinfo)
+{
+	if (!m_model || m_model->GetLoadingState() != MODEL_LOAD_OK)
+		return;
+
+	MeshInstanceData instData;
+	if (m_instFormat && m_instanceData.numElem())
+	{
+		instData.buffer = g_matSystem->GetTransientVertexBuffer(m_instanceData.ptr(), m_instanceData.numElem());
+		instData.count = 1;
+	}
+
+	DrawModel(rinfo, instData);
+}
+
+bool CStudioRenderable::GetInstancingDesc(const RenderInfo& rinfo, RenderInstancingDesc& desc) const
+{
+	if (!m_model || m_model->GetLoadingState() != MODEL_LOAD_OK)
+		return false;
+
+	if (!m_instFormat || !m_instanceData.numElem())
+		return false;
+
+	// skinned models and per-object setup callbacks can't be shared
+	if (m_drawProps.boneTransforms || m_drawProps.setupDrawCmd || m_drawProps.setupBodyGroup)
+		return false;
+
+	desc.geometry = m_model;
+	desc.instanceFormat = m_instFormat;
+	desc.bodyGroupFlags = m_drawProps.bodyGroupFlags;
+	desc.lod = GetDrawLod(rinfo.distance);
+	desc.materialGroup = m_drawProps.materialGroup;
+	desc.instanceData = m_instanceData.ptr();
+	desc.instanceDataSize = m_instanceData.numElem();
+
+	return true;
+}
+
+void CStudioRenderable::RenderInstanced(const RenderInfo& rinfo, const MeshInstanceData& instData)
+{
+	DrawModel(rinfo, instData);
+}
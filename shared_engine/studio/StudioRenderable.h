@@ -0,0 +1,54 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Copyright (C) Inspiration Byte
+// 2009-2024
+//////////////////////////////////////////////////////////////////////////////////
+// Description: Studio model renderable for render lists
+//////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+#include "render/RenderableObject.h"
+#include "StudioGeom.h"
+
+// Draws studio model in CRenderList.
+// When instance format is set, the model is drawn with it's instance data and
+// identical models (same body groups, LOD and material group) are drawn instanced.
+class CStudioRenderable : public IRenderableObject
+{
+public:
+	using DrawProps = CEqStudioGeom::DrawProps;
+
+	CStudioRenderable() = default;
+	CStudioRenderable(CEqStudioGeom* model);
+
+	void						SetModel(CEqStudioGeom* model);
+	CEqStudioGeom*				GetModel() const { return m_model; }
+
+	// instance data must match instance stream of format, e.g. model transform
+	void						SetInstanceFormat(IVertexFormat* instFormat);
+	void						SetInstanceData(const void* data, int size);
+
+	// -1 selects LOD by distance
+	void						SetLod(int lod) { m_lod = lod; }
+	DrawProps&					GetDrawProps() { return m_drawProps; }
+
+	// world bounds, set to model bounds by SetModel
+	void						SetBoundingBox(const BoundingBox& bbox) { m_bbox = bbox; }
+
+	void						Render(const RenderInfo& rinfo) override;
+	const BoundingBox&			GetBoundingBox() const override { return m_bbox; }
+
+	bool						GetInstancingDesc(const RenderInfo& rinfo, RenderInstancingDesc& desc) const override;
+	void						RenderInstanced(const RenderInfo& rinfo, const MeshInstanceData& instData) override;
+
+protected:
+	int							GetDrawLod(float distance) const;
+	void						DrawModel(const RenderInfo& rinfo, const MeshInstanceData& instData) const;
+
+	CRefPtr<CEqStudioGeom>		m_model;
+	DrawProps					m_drawProps;
+	BoundingBox					m_bbox;
+
+	IVertexFormat*				m_instFormat{ nullptr };
+	Array<ubyte>				m_instanceData{ PP_SL };
+	int							m_lod{ -1 };
+};
@@ -1,4 +1,5 @@
 #include "core/core_common.h"
+#include "studiofile/StudioLoader.h"
 #include "StudioVertex.h"
 #include "materialsystem1/renderers/ShaderAPI_defs.h"
 
@@ -10,34 +11,33 @@ static EGFHwVertex::VertexStreamId s_defaultVertexStreamMappingDesc[] = {
 };
 ArrayCRef<EGFHwVertex::VertexStreamId> g_defaultVertexStreamMapping = { s_defaultVertexStreamMappingDesc ,  elementsOf(s_defaultVertexStreamMappingDesc) };
 
+static_assert((int)EGFHwVertex::VERT_COUNT == (int)STUDIO_VERTSTREAM_COUNT, "EGFHwVertex streams and EStudioVertexStreamType mismatch");
+
+static_assert(sizeof(EGFHwVertex::PositionUV) == sizeof(studioHwVertexPosUv_t), "EGFHwVertex::PositionUV must match hardware vertex stream");
+static_assert(sizeof(EGFHwVertex::TBN) == sizeof(studioHwVertexTBN_t), "EGFHwVertex::TBN must match hardware vertex stream");
+static_assert(sizeof(EGFHwVertex::BoneWeights) == sizeof(studioHwBoneWeight_t), "EGFHwVertex::BoneWeights must match hardware vertex stream");
+static_assert(sizeof(EGFHwVertex::Color) == sizeof(studioVertexColor_t), "EGFHwVertex::Color must match hardware vertex stream");
+
 EGFHwVertex::PositionUV::PositionUV(const studioVertexPosUv_t& initFrom)
 {
-	pos = Vector4D(initFrom.point, 1.0f);
-	texcoord = initFrom.texCoord;
+	Studio_EncodeHwPosUv(*this, initFrom);
 }
 
 EGFHwVertex::TBN::TBN(const studioVertexTBN_t& initFrom)
 {
-	tangent = initFrom.tangent;
-	binormal = initFrom.binormal;
-	normal = initFrom.normal;
+	Studio_EncodeHwTBN(*this, initFrom);
 }
 
 EGFHwVertex::BoneWeights::BoneWeights()
 {
-	memset(boneWeights, 0, sizeof(boneWeights));
+	memset(weight, 0, sizeof(weight));
 	for (int i = 0; i < MAX_MODEL_VERTEX_WEIGHTS; i++)
-		boneIndices[i] = -1;
+		bones[i] = -1;
 }
 
-EGFHwVertex::BoneWeights::BoneWeights(const studioBoneWeight_t& initFrom) : BoneWeights()
+EGFHwVertex::BoneWeights::BoneWeights(const studioBoneWeight_t& initFrom)
 {
-	ASSERT(initFrom.numweights <= MAX_MODEL_VERTEX_WEIGHTS);
-	for (int i = 0; i < min(initFrom.numweights, MAX_MODEL_VERTEX_WEIGHTS); i++)
-	{
-		boneIndices[i] = initFrom.bones[i];
-		boneWeights[i] = initFrom.weight[i];
-	}
+	Studio_EncodeHwBoneWeight(*this, initFrom);
 }
 
 EGFHwVertex::Color::Color(const studioVertexColor_t& initFrom)
@@ -50,8 +50,8 @@ const VertexLayoutDesc& EGFHwVertex::PositionUV::GetVertexLayoutDesc()
 	static const VertexLayoutDesc g_EGFVertexUvFormat = Builder<VertexLayoutDesc>()
 		.UserId(EGFHwVertex::VERT_POS_UV)
 		.Stride(sizeof(EGFHwVertex::PositionUV))
-		.Attribute(VERTEXATTRIB_POSITION, "position", 0, offsetOf(EGFHwVertex::PositionUV, pos), ATTRIBUTEFORMAT_HALF, 4)
-		.Attribute(VERTEXATTRIB_TEXCOORD, "texCoord", 1, offsetOf(EGFHwVertex::PositionUV, texcoord), ATTRIBUTEFORMAT_HALF, 2)
+		.Attribute(VERTEXATTRIB_POSITION, "position", 0, offsetOf(EGFHwVertex::PositionUV, point), ATTRIBUTEFORMAT_HALF, 4)
+		.Attribute(VERTEXATTRIB_TEXCOORD, "texCoord", 1, offsetOf(EGFHwVertex::PositionUV, texCoord), ATTRIBUTEFORMAT_HALF, 2)
 		.End();
 	return g_EGFVertexUvFormat;
 }
@@ -61,9 +61,9 @@ const VertexLayoutDesc& EGFHwVertex::TBN::GetVertexLayoutDesc()
 	static const VertexLayoutDesc g_EGFTBNFormat = Builder<VertexLayoutDesc>()
 		.UserId(EGFHwVertex::VERT_TBN)
 		.Stride(sizeof(EGFHwVertex::TBN))
-		.Attribute(VERTEXATTRIB_TEXCOORD, "tangent", 2, offsetOf(EGFHwVertex::TBN, tangent), ATTRIBUTEFORMAT_HALF, 4)
-		.Attribute(VERTEXATTRIB_TEXCOORD, "binormal", 3, offsetOf(EGFHwVertex::TBN, binormal), ATTRIBUTEFORMAT_HALF, 4)
-		.Attribute(VERTEXATTRIB_TEXCOORD, "normal", 4, offsetOf(EGFHwVertex::TBN, normal), ATTRIBUTEFORMAT_HALF, 4)
+		.Attribute(VERTEXATTRIB_TEXCOORD, "tangent", 2, offsetOf(EGFHwVertex::TBN, tangent), ATTRIBUTEFORMAT_SNORM8, 4)
+		.Attribute(VERTEXATTRIB_TEXCOORD, "binormal", 3, offsetOf(EGFHwVertex::TBN, binormal), ATTRIBUTEFORMAT_SNORM8, 4)
+		.Attribute(VERTEXATTRIB_TEXCOORD, "normal", 4, offsetOf(EGFHwVertex::TBN, normal), ATTRIBUTEFORMAT_SNORM8, 4)
 		.End();
 	return g_EGFTBNFormat;
 }
@@ -73,8 +73,8 @@ const VertexLayoutDesc& EGFHwVertex::BoneWeights::GetVertexLayoutDesc()
 	static const VertexLayoutDesc g_EGFBoneWeightsFormat = Builder<VertexLayoutDesc>()
 		.UserId(EGFHwVertex::VERT_BONEWEIGHT)
 		.Stride(sizeof(EGFHwVertex::BoneWeights))
-		.Attribute(VERTEXATTRIB_TEXCOORD, "boneId", 5, offsetOf(EGFHwVertex::BoneWeights, boneIndices), ATTRIBUTEFORMAT_UINT8, 4)
-		.Attribute(VERTEXATTRIB_TEXCOORD, "boneWt", 6, offsetOf(EGFHwVertex::BoneWeights, boneWeights), ATTRIBUTEFORMAT_HALF, 4)
+		.Attribute(VERTEXATTRIB_TEXCOORD, "boneId", 5, offsetOf(EGFHwVertex::BoneWeights, bones), ATTRIBUTEFORMAT_UINT8, 4)
+		.Attribute(VERTEXATTRIB_TEXCOORD, "boneWt", 6, offsetOf(EGFHwVertex::BoneWeights, weight), ATTRIBUTEFORMAT_UNORM8, 4)
 		.End();
 	return g_EGFBoneWeightsFormat;
 }
@@ -18,41 +18,30 @@ struct EGFHwVertex
 		VERT_COUNT,
 	};
 
-	struct PositionUV
+	// layouts are same as in EGF 14 hardware vertex streams
+
+	struct PositionUV : public studioHwVertexPosUv_t
 	{
 		static const VertexLayoutDesc& GetVertexLayoutDesc();
 
 		PositionUV() = default;
 		PositionUV(const studioVertexPosUv_t& initFrom);
-
-		TVec4D<half>	pos;
-		TVec2D<half>	texcoord;
 	};
 
-	struct TBN
+	struct TBN : public studioHwVertexTBN_t
 	{
 		static const VertexLayoutDesc& GetVertexLayoutDesc();
 
 		TBN() = default;
 		TBN(const studioVertexTBN_t& initFrom);
-
-		TVec3D<half>	tangent;
-		half			unused1;	// half float types are unsupported with v3d, turn them into v4d
-		TVec3D<half>	binormal;
-		half			unused2;
-		TVec3D<half>	normal;
-		half			unused3;
 	};
 
-	struct BoneWeights
+	struct BoneWeights : public studioHwBoneWeight_t
 	{
 		static const VertexLayoutDesc& GetVertexLayoutDesc();
 
 		BoneWeights();
 		BoneWeights(const studioBoneWeight_t& initFrom);
-
-		uint8			boneIndices[MAX_MODEL_VERTEX_WEIGHTS];
-		half			boneWeights[MAX_MODEL_VERTEX_WEIGHTS];
 	};
 
 	struct Color
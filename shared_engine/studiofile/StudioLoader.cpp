@@ -36,6 +36,41 @@ static void ConvertHeaderToLatestVersion(basemodelheader_t* pBaseHdr)
 	}
 }
 
+// checks hardware vertex streams that meshes are referring to
+static bool ValidateHwStreams(studioHdr_t* pHdr, const char* pszPath)
+{
+	const studioHwStreamsDesc_t* hwStreams = pHdr->pHwStreams();
+	if (hwStreams->format == STUDIO_HWSTREAM_FMT_HALF)
+	{
+		// mesh streams were stored along with obsolete hardware vertex streams
+		pHdr->flags &= ~STUDIO_FLAG_HW_VERTEX_STREAMS;
+		return true;
+	}
+
+	if (hwStreams->format != STUDIO_HWSTREAM_FMT_QUANTIZED)
+	{
+		MsgError("Model '%s' has unsupported hardware vertex streams format %d\n", pszPath, hwStreams->format);
+		return false;
+	}
+
+	for (int i = 0; i < pHdr->numMeshGroups; ++i)
+	{
+		const studioMeshGroupDesc_t* meshGroupDesc = pHdr->pMeshGroupDesc(i);
+		for (int j = 0; j < meshGroupDesc->numMeshes; ++j)
+		{
+			const studioMeshDesc_t* mesh = meshGroupDesc->pMesh(j);
+			if (mesh->vertexOffset < 0 || mesh->vertexOffset + mesh->numVertices > hwStreams->numVertices
+				|| mesh->indicesOffset < 0 || mesh->indicesOffset + (int)mesh->numIndices > hwStreams->numIndices)
+			{
+				MsgError("Model '%s' mesh is out of hardware vertex streams range\n", pszPath);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
 // loads all supported EGF model formats
 studioHdr_t* Studio_LoadModel(const char* pszPath)
 {
@@ -53,11 +88,16 @@ studioHdr_t* Studio_LoadModel(const char* pszPath)
 	file->Read(_buffer, 1, len);
 	file = nullptr;
 
-	basemodelheader_t* pBaseHdr = (basemodelheader_t*)_buffer;
+	return Studio_LoadModelFromBuffer(_buffer, len, pszPath);
+}
+
+studioHdr_t* Studio_LoadModelFromBuffer(void* buffer, int len, const char* pszPath)
+{
+	basemodelheader_t* pBaseHdr = (basemodelheader_t*)buffer;
 
 	if(!IsValidModelIdentifier( pBaseHdr->ident ))
 	{
-		PPFree(_buffer);
+		PPFree(buffer);
 		MsgError("Invalid model file '%s'\n",pszPath);
 		return nullptr;
 	}
@@ -68,23 +108,206 @@ studioHdr_t* Studio_LoadModel(const char* pszPath)
 
 	studioHdr_t* pHdr = (studioHdr_t*)pBaseHdr;
 
-	if(pHdr->version != EQUILIBRIUM_MODEL_VERSION)
+	// version 13 is same except it doesn't have hardware vertex streams
+	if(pHdr->version == EQUILIBRIUM_MODEL_VERSION_13)
+		pHdr->flags &= ~STUDIO_FLAG_HW_VERTEX_STREAMS;
+
+	if(pHdr->version != EQUILIBRIUM_MODEL_VERSION && pHdr->version != EQUILIBRIUM_MODEL_VERSION_13)
 	{
 		MsgError("Wrong model '%s' version, excepted %i, but model version is %i\n",pszPath, EQUILIBRIUM_MODEL_VERSION,pBaseHdr->version);
-		PPFree(_buffer);
+		PPFree(buffer);
 		return nullptr;
 	}
 
 	if(len != pHdr->length)
 	{
 		MsgError("Model is not valid (read %d vs size %d in header)!\n",len, pBaseHdr->size);
-		PPFree(_buffer);
+		PPFree(buffer);
+		return nullptr;
+	}
+
+	if ((pHdr->flags & STUDIO_FLAG_HW_VERTEX_STREAMS) && !ValidateHwStreams(pHdr, pszPath))
+	{
+		PPFree(pHdr);
 		return nullptr;
 	}
 
 	return pHdr;
 }
 
+//-------------------------------------------
+// EGF 14 hardware vertex streams
+
+static int8 EncodeSnorm8(float value)
+{
+	return (int8)roundf(clamp(value, -1.0f, 1.0f) * 127.0f);
+}
+
+static void EncodeSnorm8(const Vector3D& value, int8 out[4])
+{
+	for (int i = 0; i < 3; ++i)
+		out[i] = EncodeSnorm8(value[i]);
+	out[3] = 0;
+}
+
+static Vector3D DecodeSnorm8(const int8 in[4])
+{
+	return Vector3D(max(in[0] / 127.0f, -1.0f), max(in[1] / 127.0f, -1.0f), max(in[2] / 127.0f, -1.0f));
+}
+
+int Studio_InitHwStreams(studioHwStreamsDesc_t& hwStreams, int vertexType, int numVertices, int numIndices)
+{
+	static constexpr const int s_streamSizes[] = {
+		sizeof(studioHwVertexPosUv_t),
+		sizeof(studioHwVertexTBN_t),
+		sizeof(studioHwBoneWeight_t),
+		sizeof(studioVertexColor_t),
+	};
+	static_assert(elementsOf(s_streamSizes) == STUDIO_VERTSTREAM_COUNT, "s_streamSizes must match EStudioVertexStreamType");
+
+	memset(&hwStreams, 0, sizeof(hwStreams));
+	hwStreams.format = STUDIO_HWSTREAM_FMT_QUANTIZED;
+	hwStreams.indexSize = numVertices > int(USHRT_MAX) ? sizeof(uint32) : sizeof(uint16);
+	hwStreams.vertexType = vertexType;
+	hwStreams.numVertices = numVertices;
+	hwStreams.numIndices = numIndices;
+
+	int offset = sizeof(studioHwStreamsDesc_t);
+	for (int i = 0; i < STUDIO_VERTSTREAM_COUNT; i++)
+	{
+		if (!(vertexType & (1 << i)))
+			continue;
+
+		hwStreams.streamOffsets[i] = offset;
+		offset += s_streamSizes[i] * numVertices;
+	}
+
+	hwStreams.indicesOffset = offset;
+	offset += hwStreams.indexSize * numIndices;
+
+	// keep following data aligned
+	return (offset + 3) & ~3;
+}
+
+void Studio_EncodeHwPosUv(studioHwVertexPosUv_t& dst, const studioVertexPosUv_t& posUv)
+{
+	dst.point = Vector4D(posUv.point, 1.0f);
+	dst.texCoord = posUv.texCoord;
+}
+
+void Studio_EncodeHwTBN(studioHwVertexTBN_t& dst, const studioVertexTBN_t& tbn)
+{
+	EncodeSnorm8(tbn.tangent, dst.tangent);
+	EncodeSnorm8(tbn.binormal, dst.binormal);
+	EncodeSnorm8(tbn.normal, dst.normal);
+}
+
+void Studio_EncodeHwBoneWeight(studioHwBoneWeight_t& dst, const studioBoneWeight_t& boneWeight)
+{
+	ASSERT(boneWeight.numweights <= MAX_MODEL_VERTEX_WEIGHTS);
+	for (int i = 0; i < MAX_MODEL_VERTEX_WEIGHTS; ++i)
+	{
+		const bool used = i < boneWeight.numweights;
+		dst.bones[i] = used ? boneWeight.bones[i] : -1;
+		dst.weight[i] = used ? (uint8)roundf(clamp(boneWeight.weight[i], 0.0f, 1.0f) * 255.0f) : 0;
+	}
+}
+
+void Studio_EncodeHwVertex(studioHwStreamsDesc_t* hwStreams, int vertexIdx, const studioVertexPosUv_t& posUv, const studioVertexTBN_t& tbn, const studioBoneWeight_t& boneWeight, const studioVertexColor_t& color)
+{
+	const int vertexType = hwStreams->vertexType;
+	if (vertexType & STUDIO_VERTFLAG_POS_UV)
+		Studio_EncodeHwPosUv(((studioHwVertexPosUv_t*)hwStreams->pStream(STUDIO_VERTSTREAM_POS_UV))[vertexIdx], posUv);
+
+	if (vertexType & STUDIO_VERTFLAG_TBN)
+		Studio_EncodeHwTBN(((studioHwVertexTBN_t*)hwStreams->pStream(STUDIO_VERTSTREAM_TBN))[vertexIdx], tbn);
+
+	if (vertexType & STUDIO_VERTFLAG_BONEWEIGHT)
+		Studio_EncodeHwBoneWeight(((studioHwBoneWeight_t*)hwStreams->pStream(STUDIO_VERTSTREAM_BONEWEIGHT))[vertexIdx], boneWeight);
+
+	if (vertexType & STUDIO_VERTFLAG_COLOR)
+		((studioVertexColor_t*)hwStreams->pStream(STUDIO_VERTSTREAM_COLOR))[vertexIdx] = color;
+}
+
+void Studio_DecodeHwVertex(const studioHwStreamsDesc_t* hwStreams, int vertexIdx, studioVertexPosUv_t* posUv, studioVertexTBN_t* tbn, studioBoneWeight_t* boneWeight, studioVertexColor_t* color)
+{
+	const int vertexType = hwStreams->vertexType;
+	if (posUv && (vertexType & STUDIO_VERTFLAG_POS_UV))
+	{
+		const studioHwVertexPosUv_t& src = ((const studioHwVertexPosUv_t*)hwStreams->pStream(STUDIO_VERTSTREAM_POS_UV))[vertexIdx];
+		posUv->point = Vector3D(src.point.x, src.point.y, src.point.z);
+		posUv->texCoord = Vector2D(src.texCoord.x, src.texCoord.y);
+	}
+
+	if (tbn && (vertexType & STUDIO_VERTFLAG_TBN))
+	{
+		const studioHwVertexTBN_t& src = ((const studioHwVertexTBN_t*)hwStreams->pStream(STUDIO_VERTSTREAM_TBN))[vertexIdx];
+		tbn->tangent = DecodeSnorm8(src.tangent);
+		tbn->binormal = DecodeSnorm8(src.binormal);
+		tbn->normal = DecodeSnorm8(src.normal);
+	}
+
+	if (boneWeight && (vertexType & STUDIO_VERTFLAG_BONEWEIGHT))
+	{
+		const studioHwBoneWeight_t& src = ((const studioHwBoneWeight_t*)hwStreams->pStream(STUDIO_VERTSTREAM_BONEWEIGHT))[vertexIdx];
+		memset(boneWeight, 0, sizeof(*boneWeight));
+		for (int i = 0; i < MAX_MODEL_VERTEX_WEIGHTS; ++i)
+		{
+			boneWeight->bones[i] = src.bones[i];
+			if (src.bones[i] == -1)
+				continue;
+
+			boneWeight->weight[i] = src.weight[i] / 255.0f;
+			boneWeight->numweights = i + 1;
+		}
+	}
+
+	if (color && (vertexType & STUDIO_VERTFLAG_COLOR))
+		*color = ((const studioVertexColor_t*)hwStreams->pStream(STUDIO_VERTSTREAM_COLOR))[vertexIdx];
+}
+
+void Studio_GetMeshVertex(const studioHwStreamsDesc_t* hwStreams, const studioMeshDesc_t* mesh, int vertexIdx, studioVertexPosUv_t* posUv, studioVertexTBN_t* tbn, studioBoneWeight_t* boneWeight, studioVertexColor_t* color)
+{
+	const int vertexType = mesh->vertexType;
+	if (hwStreams)
+	{
+		Studio_DecodeHwVertex(hwStreams, mesh->vertexOffset + vertexIdx,
+			(vertexType & STUDIO_VERTFLAG_POS_UV) ? posUv : nullptr,
+			(vertexType & STUDIO_VERTFLAG_TBN) ? tbn : nullptr,
+			(vertexType & STUDIO_VERTFLAG_BONEWEIGHT) ? boneWeight : nullptr,
+			(vertexType & STUDIO_VERTFLAG_COLOR) ? color : nullptr);
+		return;
+	}
+
+	if (posUv && (vertexType & STUDIO_VERTFLAG_POS_UV))
+		*posUv = *mesh->pPosUvs(vertexIdx);
+	if (tbn && (vertexType & STUDIO_VERTFLAG_TBN))
+		*tbn = *mesh->pTBNs(vertexIdx);
+	if (boneWeight && (vertexType & STUDIO_VERTFLAG_BONEWEIGHT))
+		*boneWeight = *mesh->pBoneWeight(vertexIdx);
+	if (color && (vertexType & STUDIO_VERTFLAG_COLOR))
+		*color = *mesh->pColor(vertexIdx);
+}
+
+Vector3D Studio_GetMeshVertexPoint(const studioHwStreamsDesc_t* hwStreams, const studioMeshDesc_t* mesh, int vertexIdx)
+{
+	if (!hwStreams)
+		return mesh->pPosUvs(vertexIdx)->point;
+
+	const TVec4D<half>& point = ((const studioHwVertexPosUv_t*)hwStreams->pStream(STUDIO_VERTSTREAM_POS_UV))[mesh->vertexOffset + vertexIdx].point;
+	return Vector3D(point.x, point.y, point.z);
+}
+
+uint32 Studio_GetMeshVertexIndex(const studioHwStreamsDesc_t* hwStreams, const studioMeshDesc_t* mesh, int idx)
+{
+	if (!hwStreams)
+		return *mesh->pVertexIdx(idx);
+
+	const int hwIdx = mesh->indicesOffset + idx;
+	const uint32 index = (hwStreams->indexSize == sizeof(uint32)) ? ((const uint32*)hwStreams->pIndices())[hwIdx] : ((const uint16*)hwStreams->pIndices())[hwIdx];
+	return index - mesh->vertexOffset;
+}
+
 bool Studio_LoadMotionData(const char* pszPath, StudioMotionData& motionData)
 {
 	ubyte* pData = g_fileSystem->GetFileBuffer(pszPath);
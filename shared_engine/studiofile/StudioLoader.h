@@ -9,9 +9,24 @@
 #include "egf/model.h"
 
 studioHdr_t*	Studio_LoadModel(const char* pszPath);
+studioHdr_t*	Studio_LoadModelFromBuffer(void* buffer, int len, const char* pszPath);	// takes ownership of PPAlloc'd buffer
 bool			Studio_LoadMotionData(const char* pszPath, StudioMotionData& motionData);
 bool			Studio_LoadPhysModel(const char* pszPath, StudioPhysData& pModel);
 
 void			Studio_FreeModel(studioHdr_t* pModel);
 void			Studio_FreeMotionData(StudioMotionData& pData);
 void			Studio_FreePhysModel(StudioPhysData& pModel);
+
+// EGF 14 hardware vertex streams
+int				Studio_InitHwStreams(studioHwStreamsDesc_t& hwStreams, int vertexType, int numVertices, int numIndices); // returns size of streams with desc
+void			Studio_EncodeHwPosUv(studioHwVertexPosUv_t& dst, const studioVertexPosUv_t& posUv);
+void			Studio_EncodeHwTBN(studioHwVertexTBN_t& dst, const studioVertexTBN_t& tbn);
+void			Studio_EncodeHwBoneWeight(studioHwBoneWeight_t& dst, const studioBoneWeight_t& boneWeight);
+void			Studio_EncodeHwVertex(studioHwStreamsDesc_t* hwStreams, int vertexIdx, const studioVertexPosUv_t& posUv, const studioVertexTBN_t& tbn, const studioBoneWeight_t& boneWeight, const studioVertexColor_t& color);
+void			Studio_DecodeHwVertex(const studioHwStreamsDesc_t* hwStreams, int vertexIdx, studioVertexPosUv_t* posUv, studioVertexTBN_t* tbn, studioBoneWeight_t* boneWeight, studioVertexColor_t* color);
+
+// Mesh vertex access, hwStreams is studioHdr_t::pHwStreams() - reads EGF 14 hardware vertex streams
+// or mesh streams of older models if null. Vertex indices are local to mesh
+void			Studio_GetMeshVertex(const studioHwStreamsDesc_t* hwStreams, const studioMeshDesc_t* mesh, int vertexIdx, studioVertexPosUv_t* posUv, studioVertexTBN_t* tbn, studioBoneWeight_t* boneWeight, studioVertexColor_t* color);
+Vector3D		Studio_GetMeshVertexPoint(const studioHwStreamsDesc_t* hwStreams, const studioMeshDesc_t* mesh, int vertexIdx);
+uint32			Studio_GetMeshVertexIndex(const studioHwStreamsDesc_t* hwStreams, const studioMeshDesc_t* mesh, int idx);
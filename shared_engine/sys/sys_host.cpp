@@ -737,6 +737,10 @@ bool CGameHost::Frame()
 	if (!FilterTime(elapsedTime))
 		return false;
 
+	PROF_END_FRAME();
+	PPMemEndFrame();
+	FrameAllocEndFrame();
+
 	PROF_EVENT("Host Frame");
 
 	double gameFrameTime = m_accumTime;
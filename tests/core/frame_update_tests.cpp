@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+
+#include "core/core_common.h"
+
+using namespace Threading;
+
+static constexpr const int s_frameUpdateThreads = 4;
+static constexpr const int s_frameUpdateFrames = 100;
+
+// works like material proxies: state is updated once per frame by any thread that binds it
+struct FrameUpdateTestState
+{
+	CEqFrameUpdateGuard		guard;
+	volatile int			frame{ 0 };
+	volatile int			numBound{ 0 };
+	volatile int			numUpdates{ 0 };
+	volatile int			numBadBinds{ 0 };
+
+	volatile int			proxyValueA{ 0 };
+	volatile int			proxyValueB{ 0 };
+};
+
+class CFrameBindThread : public CEqThread
+{
+public:
+	CFrameBindThread(FrameUpdateTestState& state)
+		: m_state(state)
+	{
+	}
+
+	int Run() override
+	{
+		for (int frame = 1; frame <= s_frameUpdateFrames; ++frame)
+		{
+			while (Atomic::Load(m_state.frame) < frame)
+				Platform_Sleep(0);
+
+			m_state.guard.Update(frame, [&]() {
+				Atomic::Increment(m_state.numUpdates);
+				m_state.proxyValueA = frame;
+
+				// give other threads a chance to bind the half-updated state
+				Platform_Sleep(1);
+				m_state.proxyValueB = frame;
+			});
+
+			if (m_state.proxyValueA != frame || m_state.proxyValueB != frame)
+				Atomic::Increment(m_state.numBadBinds);
+
+			Atomic::Increment(m_state.numBound);
+		}
+		return 0;
+	}
+
+private:
+	FrameUpdateTestState& m_state;
+};
+
+TEST(FRAME_UPDATE_TESTS, BindFromSeveralThreads)
+{
+	FrameUpdateTestState state;
+
+	FixedArray<CFrameBindThread*, s_frameUpdateThreads> threads;
+	for (int i = 0; i < s_frameUpdateThreads; ++i)
+	{
+		threads.append(PPNew CFrameBindThread(state));
+		threads[i]->StartThread(EqString::Format("FrameBind%d", i));
+	}
+
+	for (int frame = 1; frame <= s_frameUpdateFrames; ++frame)
+	{
+		Atomic::Store(state.frame, frame);
+		while (Atomic::Load(state.numBound) < frame * s_frameUpdateThreads)
+			Platform_Sleep(0);
+
+		EXPECT_EQ(state.guard.GetFrame(), (uint)frame);
+	}
+
+	for (CFrameBindThread* thread : threads)
+	{
+		thread->WaitForThread();
+		delete thread;
+	}
+
+	EXPECT_EQ(state.numUpdates, s_frameUpdateFrames);
+	EXPECT_EQ(state.numBadBinds, 0);
+}
+
+TEST(FRAME_UPDATE_TESTS, ForcedUpdate)
+{
+	CEqFrameUpdateGuard guard;
+	int numUpdates = 0;
+
+	EXPECT_TRUE(guard.Update(1, [&]() { ++numUpdates; }));
+	EXPECT_FALSE(guard.Update(1, [&]() { ++numUpdates; }));
+	EXPECT_TRUE(guard.Update(1, [&]() { ++numUpdates; }, true));
+	EXPECT_TRUE(guard.Update(2, [&]() { ++numUpdates; }));
+
+	EXPECT_EQ(numUpdates, 3);
+	EXPECT_EQ(guard.GetFrame(), 2u);
+}
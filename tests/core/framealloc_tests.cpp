@@ -0,0 +1,229 @@
+#include <gtest/gtest.h>
+
+#include "core/core_common.h"
+
+using namespace Threading;
+
+static constexpr const int s_frameBenchFrames = 200;
+static constexpr const int s_frameBenchArrays = 32;
+static constexpr const int s_frameBenchElems = 100;
+
+class CFrameAllocThread : public CEqThread
+{
+public:
+	void*	ptrs[2]{ nullptr };
+
+	int Run() override
+	{
+		ptrs[0] = FrameAlloc(64);
+		ptrs[1] = FrameAlloc(64);
+		return 0;
+	}
+};
+
+template<typename ARRAY_TYPE>
+static int FrameBenchFillArrays()
+{
+	int sum = 0;
+	for (int i = 0; i < s_frameBenchArrays; ++i)
+	{
+		ARRAY_TYPE values(PP_SL);
+		for (int j = 0; j < s_frameBenchElems; ++j)
+			values.append(i + j);
+		sum += values[i % s_frameBenchElems];
+	}
+	return sum;
+}
+
+TEST(FRAMEALLOC_TESTS, LifetimeAcrossFrames)
+{
+	FrameAllocEndFrame();
+
+	int* data = FrameAllocStructArray(int, 256);
+	for (int i = 0; i < 256; ++i)
+		data[i] = i;
+
+	const int64 allocFrame = FrameAllocGetFrameIndex();
+	EXPECT_EQ(reinterpret_cast<uintptr_t>(data) % alignof(int), 0);
+
+	// still valid during next frame while other buffer is used
+	FrameAllocEndFrame();
+	EXPECT_TRUE(FrameAllocIsAlive(allocFrame));
+
+	int* nextData = FrameAllocStructArray(int, 256);
+	EXPECT_NE(nextData, data);
+	for (int i = 0; i < 256; ++i)
+		EXPECT_EQ(data[i], i);
+
+	// buffer is rewound and reused
+	FrameAllocEndFrame();
+	EXPECT_FALSE(FrameAllocIsAlive(allocFrame));
+	EXPECT_EQ(FrameAllocStructArray(int, 256), data);
+}
+
+TEST(FRAMEALLOC_TESTS, GrowInPlace)
+{
+	FrameAllocEndFrame();
+
+	FrameArray<int> values(PP_SL);
+	values.append(0);
+	const int* firstPtr = values.ptr();
+
+	for (int i = 1; i < 4000; ++i)
+		values.append(i);
+
+	// last allocation grows without copying
+	EXPECT_EQ(values.ptr(), firstPtr);
+	for (int i = 0; i < values.numElem(); ++i)
+		EXPECT_EQ(values[i], i);
+
+	// other allocation in between forces copy
+	void* other = FrameAlloc(16);
+	EXPECT_NE(other, nullptr);
+	values.resize(values.numElem() + 1000);
+	EXPECT_NE(values.ptr(), firstPtr);
+	EXPECT_EQ(values[3999], 3999);
+
+	FrameAllocStats stats;
+	FrameAllocEndFrame();
+	FrameAllocGetStats(stats);
+	EXPECT_GE(stats.lastFrameBytes, (4000 + 1000) * sizeof(int));
+	EXPECT_GE(stats.reservedBytes, stats.lastFrameBytes);
+}
+
+TEST(FRAMEALLOC_TESTS, ScopeRewind)
+{
+	FrameAllocEndFrame();
+
+	FrameArray<int> outer(PP_SL);
+	outer.append(1);
+
+	// steps without frames don't grow the arena
+	void* firstStepPtr = nullptr;
+	for (int step = 0; step < 100; ++step)
+	{
+		CFrameAllocScope scope;
+		FrameArray<int> values(PP_SL);
+		for (int i = 0; i < 10000; ++i)
+			values.append(i);
+
+		if (!firstStepPtr)
+			firstStepPtr = values.ptr();
+		EXPECT_EQ(values.ptr(), firstStepPtr);
+	}
+
+	// memory before the mark is not reused, it's last allocation grows by copy
+	EXPECT_EQ(outer[0], 1);
+	outer.append(2);
+	EXPECT_EQ(outer[0], 1);
+	EXPECT_EQ(outer[1], 2);
+
+	FrameAllocStats stats;
+	FrameAllocEndFrame();
+	FrameAllocGetStats(stats);
+	EXPECT_LT(stats.lastFrameBytes, 10000 * sizeof(int));
+
+	// frame ended inside the scope, next frame memory is kept
+	int* kept = nullptr;
+	{
+		CFrameAllocScope scope;
+		FrameAlloc(64);
+		FrameAllocEndFrame();
+		kept = FrameAllocStructArray(int, 16);
+	}
+	EXPECT_NE(FrameAllocStructArray(int, 16), kept);
+}
+
+TEST(FRAMEALLOC_TESTS, ThreadArenas)
+{
+	FrameAllocEndFrame();
+	void* mainPtr = FrameAlloc(64);
+
+	CFrameAllocThread thread;
+	thread.StartThread("FrameAllocTest");
+	thread.WaitForThread();
+
+	// each thread bumps own arena
+	EXPECT_NE(thread.ptrs[0], nullptr);
+	EXPECT_EQ(static_cast<ubyte*>(thread.ptrs[1]) - static_cast<ubyte*>(thread.ptrs[0]), static_cast<ubyte*>(FrameAlloc(64)) - static_cast<ubyte*>(mainPtr));
+	EXPECT_NE(thread.ptrs[0], mainPtr);
+
+	// arena of exited thread is reused by the next one
+	FrameAllocStats stats;
+	FrameAllocGetStats(stats);
+	const int numArenas = stats.numArenas;
+
+	CFrameAllocThread nextThread;
+	nextThread.StartThread("FrameAllocTest2");
+	nextThread.WaitForThread();
+
+	FrameAllocGetStats(stats);
+	EXPECT_EQ(stats.numArenas, numArenas);
+}
+
+TEST(FRAMEALLOC_TESTS, FrameString)
+{
+	FrameAllocEndFrame();
+
+	FrameString str;
+	EXPECT_EQ(str.Length(), 0);
+	EXPECT_STREQ(str.ToCString(), "");
+
+	str.Append("models/");
+	str.Append('x');
+	str.AppendFormat("_%d.egf", 15);
+	EXPECT_STREQ(str.ToCString(), "models/x_15.egf");
+	EXPECT_EQ(str.Length(), 15);
+
+	FrameString formatted = FrameString::Format("%s:%d", "frame", 42);
+	EXPECT_STREQ(formatted, "frame:42");
+	EXPECT_EQ(formatted.Ref().Length(), 8);
+}
+
+TEST(FRAMEALLOC_TESTS, HeapAllocationsPerFrame)
+{
+	PPMemEndFrame();
+
+	void* ptrs[10];
+	for (int i = 0; i < 10; ++i)
+		ptrs[i] = PPAlloc(32);
+	for (int i = 0; i < 10; ++i)
+		PPFree(ptrs[i]);
+
+	PPMemEndFrame();
+#ifdef PPMEM_DISABLED
+	EXPECT_EQ(PPMemGetFrameAllocCount(), 0);
+#else
+	EXPECT_EQ(PPMemGetFrameAllocCount(), 10);
+#endif
+
+	// frame arrays do not hit the heap once arena is warm
+	FrameBenchFillArrays<FrameArray<int>>();
+	FrameAllocEndFrame();
+	PPMemEndFrame();
+
+	FrameBenchFillArrays<FrameArray<int>>();
+	PPMemEndFrame();
+	EXPECT_EQ(PPMemGetFrameAllocCount(), 0);
+}
+
+TEST(FRAMEALLOC_TESTS, TemporaryArraysBenchmark)
+{
+	int sum = 0;
+
+	CEqTimer timer;
+	for (int i = 0; i < s_frameBenchFrames; ++i)
+		sum += FrameBenchFillArrays<Array<int>>();
+	const double heapMs = timer.GetTime() * 1000.0;
+
+	timer.GetTime(true);
+	for (int i = 0; i < s_frameBenchFrames; ++i)
+	{
+		sum -= FrameBenchFillArrays<FrameArray<int>>();
+		FrameAllocEndFrame();
+	}
+	const double frameMs = timer.GetTime() * 1000.0;
+
+	EXPECT_EQ(sum, 0);
+	Msg("%d temporary arrays: Array %.2f ms, FrameArray %.2f ms\n", s_frameBenchFrames * s_frameBenchArrays, heapMs, frameMs);
+}
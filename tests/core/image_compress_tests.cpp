@@ -0,0 +1,382 @@
+#include <gtest/gtest.h>
+
+#include "core/core_common.h"
+#include "core/platform/eqjobmanager.h"
+#include "ds/MemoryStream.h"
+#include "math/Vector.h"
+#include "imaging/ImageLoader.h"
+#include "imaging/BlockCompression.h"
+
+static constexpr const int s_bcTestSize = 256;
+
+// reference decoders for checking encoder output
+static void TestDecodeColorBlock(const ubyte* block, ubyte* rgba)
+{
+	const uint16 color0 = block[0] | (block[1] << 8);
+	const uint16 color1 = block[2] | (block[3] << 8);
+	const uint32 indices = block[4] | (block[5] << 8) | (block[6] << 16) | (block[7] << 24);
+
+	int palette[4][4];
+	for (int i = 0; i < 2; ++i)
+	{
+		const uint16 color = i ? color1 : color0;
+		const int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+		palette[i][0] = (r << 3) | (r >> 2);
+		palette[i][1] = (g << 2) | (g >> 4);
+		palette[i][2] = (b << 3) | (b >> 2);
+		palette[i][3] = 255;
+	}
+
+	for (int c = 0; c < 4; ++c)
+	{
+		if (color0 > color1)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+
+	for (int i = 0; i < BC_BLOCK_PIXELS; ++i)
+	{
+		for (int c = 0; c < 3; ++c)
+			rgba[i * 4 + c] = palette[(indices >> (i * 2)) & 3][c];
+	}
+}
+
+static void TestDecodeAlphaBlock(const ubyte* block, ubyte* rgba, int channel)
+{
+	const int alpha0 = block[0];
+	const int alpha1 = block[1];
+
+	int palette[8] = { alpha0, alpha1 };
+	if (alpha0 > alpha1)
+	{
+		for (int i = 1; i < 7; ++i)
+			palette[i + 1] = ((7 - i) * alpha0 + i * alpha1 + 3) / 7;
+	}
+	else
+	{
+		for (int i = 1; i < 5; ++i)
+			palette[i + 1] = ((5 - i) * alpha0 + i * alpha1 + 2) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+
+	uint64 bits = 0;
+	for (int i = 0; i < 6; ++i)
+		bits |= uint64(block[2 + i]) << (i * 8);
+
+	for (int i = 0; i < BC_BLOCK_PIXELS; ++i)
+		rgba[i * 4 + channel] = palette[(bits >> (i * 3)) & 7];
+}
+
+static uint TestReadBits(const ubyte* block, int& bitPos, int numBits)
+{
+	uint value = 0;
+	for (int i = 0; i < numBits; ++i, ++bitPos)
+		value |= ((block[bitPos >> 3] >> (bitPos & 7)) & 1) << i;
+	return value;
+}
+
+static bool TestDecodeBC7Mode6(const ubyte* block, ubyte* rgba)
+{
+	static const int s_weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	int bitPos = 0;
+	if (TestReadBits(block, bitPos, 7) != (1 << 6))
+		return false;
+
+	int endpoints[2][4];
+	for (int c = 0; c < 4; ++c)
+	{
+		endpoints[0][c] = TestReadBits(block, bitPos, 7);
+		endpoints[1][c] = TestReadBits(block, bitPos, 7);
+	}
+
+	const int pbit0 = TestReadBits(block, bitPos, 1);
+	const int pbit1 = TestReadBits(block, bitPos, 1);
+	for (int c = 0; c < 4; ++c)
+	{
+		endpoints[0][c] = (endpoints[0][c] << 1) | pbit0;
+		endpoints[1][c] = (endpoints[1][c] << 1) | pbit1;
+	}
+
+	for (int i = 0; i < BC_BLOCK_PIXELS; ++i)
+	{
+		const int index = TestReadBits(block, bitPos, i == 0 ? 3 : 4);
+		for (int c = 0; c < 4; ++c)
+			rgba[i * 4 + c] = ((64 - s_weights[index]) * endpoints[0][c] + s_weights[index] * endpoints[1][c] + 32) >> 6;
+	}
+	return true;
+}
+
+static void TestDecodeImage(ETextureFormat format, const ubyte* blocks, int width, int height, ubyte* rgba)
+{
+	const int blocksX = width / BC_BLOCK_SIZE;
+	const int blockBytes = GetBytesPerBlock(format);
+
+	for (int by = 0; by < height / BC_BLOCK_SIZE; ++by)
+	{
+		for (int bx = 0; bx < blocksX; ++bx)
+		{
+			const ubyte* block = blocks + (by * blocksX + bx) * blockBytes;
+
+			ubyte pixels[BC_BLOCK_PIXELS * 4];
+			memset(pixels, 0, sizeof(pixels));
+			for (int i = 0; i < BC_BLOCK_PIXELS; ++i)
+				pixels[i * 4 + 3] = 255;
+
+			switch (format)
+			{
+			case FORMAT_DXT1:
+				TestDecodeColorBlock(block, pixels);
+				break;
+			case FORMAT_DXT5:
+				TestDecodeAlphaBlock(block, pixels, 3);
+				TestDecodeColorBlock(block + 8, pixels);
+				break;
+			case FORMAT_ATI1N:
+				TestDecodeAlphaBlock(block, pixels, 0);
+				break;
+			case FORMAT_ATI2N:
+				TestDecodeAlphaBlock(block, pixels, 0);
+				TestDecodeAlphaBlock(block + 8, pixels, 1);
+				break;
+			case FORMAT_BC7:
+				EXPECT_TRUE(TestDecodeBC7Mode6(block, pixels));
+				break;
+			default:
+				break;
+			}
+
+			for (int y = 0; y < BC_BLOCK_SIZE; ++y)
+				memcpy(&rgba[((by * BC_BLOCK_SIZE + y) * width + bx * BC_BLOCK_SIZE) * 4], &pixels[y * BC_BLOCK_SIZE * 4], BC_BLOCK_SIZE * 4);
+		}
+	}
+}
+
+// smooth color gradients with some noise and alpha ramp
+static void TestMakeImage(Array<ubyte>& rgba, int width, int height)
+{
+	rgba.setNum(width * height * 4);
+
+	uint seed = 1234;
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			const int noise = (seed >> 24) & 7;
+
+			ubyte* pixel = &rgba[(y * width + x) * 4];
+			pixel[0] = (x * 255 / width + noise) & 255;
+			pixel[1] = (y * 255 / height) & 255;
+			pixel[2] = ((x + y) * 127 / width) & 255;
+			pixel[3] = (x ^ y) & 255;
+		}
+	}
+}
+
+static float TestChannelRMSE(const Array<ubyte>& a, const Array<ubyte>& b, int firstChannel, int numChannels)
+{
+	double sum = 0.0;
+	const int numPixels = a.numElem() / 4;
+	for (int i = 0; i < numPixels; ++i)
+	{
+		for (int c = firstChannel; c < firstChannel + numChannels; ++c)
+		{
+			const int d = a[i * 4 + c] - b[i * 4 + c];
+			sum += d * d;
+		}
+	}
+	return sqrt(sum / (numPixels * numChannels));
+}
+
+static float TestCompressRMSE(ETextureFormat format, const Array<ubyte>& source, int firstChannel, int numChannels)
+{
+	Array<ubyte> blocks(PP_SL);
+	blocks.setNum((s_bcTestSize / BC_BLOCK_SIZE) * (s_bcTestSize / BC_BLOCK_SIZE) * GetBytesPerBlock(format));
+	EXPECT_TRUE(BlockCompress(format, source.ptr(), s_bcTestSize, s_bcTestSize, blocks.ptr()));
+
+	Array<ubyte> decoded(PP_SL);
+	decoded.setNum(source.numElem());
+	TestDecodeImage(format, blocks.ptr(), s_bcTestSize, s_bcTestSize, decoded.ptr());
+
+	return TestChannelRMSE(source, decoded, firstChannel, numChannels);
+}
+
+TEST(IMAGE_COMPRESS_TESTS, BlockFormatsQuality)
+{
+	Array<ubyte> source(PP_SL);
+	TestMakeImage(source, s_bcTestSize, s_bcTestSize);
+
+	const float rmseBC1 = TestCompressRMSE(FORMAT_DXT1, source, 0, 3);
+	const float rmseBC3 = TestCompressRMSE(FORMAT_DXT5, source, 3, 1);
+	const float rmseBC4 = TestCompressRMSE(FORMAT_ATI1N, source, 0, 1);
+	const float rmseBC5 = TestCompressRMSE(FORMAT_ATI2N, source, 0, 2);
+	const float rmseBC7 = TestCompressRMSE(FORMAT_BC7, source, 0, 3);
+
+	Msg("RMSE: BC1 %.2f, BC3 alpha %.2f, BC4 %.2f, BC5 %.2f, BC7 %.2f\n", rmseBC1, rmseBC3, rmseBC4, rmseBC5, rmseBC7);
+
+	EXPECT_LT(rmseBC1, 6.0f);
+	EXPECT_LT(rmseBC3, 6.0f);
+	EXPECT_LT(rmseBC4, 3.0f);
+	EXPECT_LT(rmseBC5, 3.0f);
+	EXPECT_LT(rmseBC7, rmseBC1);
+}
+
+TEST(IMAGE_COMPRESS_TESTS, SingleColorBlocks)
+{
+	ubyte pixels[BC_BLOCK_PIXELS * 4];
+	ubyte decoded[BC_BLOCK_PIXELS * 4];
+
+	for (int value = 0; value < 256; value += 5)
+	{
+		for (int i = 0; i < BC_BLOCK_PIXELS; ++i)
+		{
+			pixels[i * 4 + 0] = value;
+			pixels[i * 4 + 1] = 255 - value;
+			pixels[i * 4 + 2] = value / 2;
+			pixels[i * 4 + 3] = value;
+		}
+
+		ubyte block[16];
+		BlockCompressSingle(FORMAT_DXT1, pixels, block);
+		TestDecodeColorBlock(block, decoded);
+		for (int c = 0; c < 3; ++c)
+			EXPECT_LE(abs(decoded[c] - pixels[c]), 2) << "value " << value;
+
+		BlockCompressSingle(FORMAT_ATI1N, pixels, block);
+		TestDecodeAlphaBlock(block, decoded, 0);
+		EXPECT_EQ(decoded[0], pixels[0]);
+
+		BlockCompressSingle(FORMAT_BC7, pixels, block);
+		ASSERT_TRUE(TestDecodeBC7Mode6(block, decoded));
+		for (int c = 0; c < 4; ++c)
+			EXPECT_LE(abs(decoded[c] - pixels[c]), 1) << "value " << value;
+	}
+}
+
+TEST(IMAGE_COMPRESS_TESTS, ParallelOutputMatchesSerial)
+{
+	Array<ubyte> source(PP_SL);
+	TestMakeImage(source, s_bcTestSize, s_bcTestSize);
+
+	CEqJobManager jobMng("bcTestJobs", 4, 256);
+
+	const ETextureFormat formats[] = { FORMAT_DXT1, FORMAT_DXT3, FORMAT_DXT5, FORMAT_ATI1N, FORMAT_ATI2N, FORMAT_BC7 };
+	for (ETextureFormat format : formats)
+	{
+		const int size = (s_bcTestSize / BC_BLOCK_SIZE) * (s_bcTestSize / BC_BLOCK_SIZE) * GetBytesPerBlock(format);
+
+		Array<ubyte> serial(PP_SL);
+		Array<ubyte> parallel(PP_SL);
+		serial.setNum(size);
+		parallel.setNum(size);
+
+		CEqTimer timer;
+		EXPECT_TRUE(BlockCompress(format, source.ptr(), s_bcTestSize, s_bcTestSize, serial.ptr()));
+		const double serialTime = timer.GetTime(true);
+
+		EXPECT_TRUE(BlockCompress(format, source.ptr(), s_bcTestSize, s_bcTestSize, parallel.ptr(), &jobMng));
+		const double parallelTime = timer.GetTime(true);
+
+		Msg("%s: serial %.2f ms, 4 threads %.2f ms\n", GetFormatString(format), serialTime * 1000.0, parallelTime * 1000.0);
+		EXPECT_EQ(memcmp(serial.ptr(), parallel.ptr(), size), 0) << GetFormatString(format);
+	}
+}
+
+TEST(IMAGE_COMPRESS_TESTS, ConvertMipMappedImage)
+{
+	CImage image;
+	ubyte* pixels = image.Create(FORMAT_RGB8, 64, 32, 1, 1);
+	for (int i = 0; i < 64 * 32 * 3; ++i)
+		pixels[i] = i & 255;
+
+	ASSERT_TRUE(image.CreateMipMaps(ALL_MIPMAPS, MIPMAP_FILTER_KAISER, true));
+	EXPECT_EQ(image.GetMipMapCount(), 7);
+
+	ASSERT_TRUE(image.Convert(FORMAT_BC7));
+	EXPECT_EQ(image.GetFormat(), FORMAT_BC7);
+	EXPECT_EQ(image.GetMipMappedSize(0, 1), 16 * 8 * 16);
+
+	// mips below block size are stored as one block
+	EXPECT_EQ(image.GetMipMappedSize(0, ALL_MIPMAPS), (16 * 8 + 8 * 4 + 4 * 2 + 2 + 1 + 1 + 1) * 16);
+
+	// no decoding of compressed images
+	EXPECT_FALSE(image.Convert(FORMAT_DXT1));
+}
+
+TEST(IMAGE_COMPRESS_TESTS, SRGBFormatsInDDS)
+{
+	const ETextureFormat formats[] = {
+		FORMAT_BC7,
+		MakeTexFormat(FORMAT_BC7, TEXFORMAT_FLAG_SRGB),
+		MakeTexFormat(FORMAT_DXT1, TEXFORMAT_FLAG_SRGB),
+		MakeTexFormat(FORMAT_DXT5, TEXFORMAT_FLAG_SRGB),
+	};
+
+	for (ETextureFormat format : formats)
+	{
+		CImage image;
+		ubyte* pixels = image.Create(FORMAT_RGBA8, 16, 16, 1, 1);
+		for (int i = 0; i < 16 * 16 * 4; ++i)
+			pixels[i] = i & 255;
+
+		ASSERT_TRUE(image.Convert(GetTexFormat(format)));
+		image.GetFormat(format);
+
+		CRefPtr<CMemoryStream> stream = CRefPtr_new(CMemoryStream, nullptr, VS_OPEN_WRITE | VS_OPEN_READ, 4096, PP_SL);
+		ASSERT_TRUE(image.SaveDDS(IVirtualStreamPtr(stream)));
+
+		stream->Seek(0, VS_SEEK_SET);
+		CImage loaded;
+		ASSERT_TRUE(loaded.LoadDDS(IVirtualStreamPtr(stream)));
+		EXPECT_EQ(loaded.GetFormat(), format);
+		EXPECT_EQ(memcmp(loaded.GetPixels(), image.GetPixels(), image.GetMipMappedSize(0, 1)), 0);
+	}
+}
+
+TEST(IMAGE_COMPRESS_TESTS, GammaCorrectMipMaps)
+{
+	// black and white checker averages to half of linear intensity
+	for (int filter = MIPMAP_FILTER_BOX; filter <= MIPMAP_FILTER_KAISER; ++filter)
+	{
+		CImage linearImage;
+		CImage srgbImage;
+		ubyte* linearPixels = linearImage.Create(FORMAT_RGBA8, 16, 16, 1, 1);
+		ubyte* srgbPixels = srgbImage.Create(FORMAT_RGBA8, 16, 16, 1, 1);
+		for (int i = 0; i < 16 * 16; ++i)
+		{
+			const ubyte value = (((i & 15) ^ (i >> 4)) & 1) ? 255 : 0;
+			for (int c = 0; c < 4; ++c)
+				linearPixels[i * 4 + c] = srgbPixels[i * 4 + c] = value;
+		}
+
+		ASSERT_TRUE(linearImage.CreateMipMaps(ALL_MIPMAPS, (EMipMapFilter)filter, false));
+		ASSERT_TRUE(srgbImage.CreateMipMaps(ALL_MIPMAPS, (EMipMapFilter)filter, true));
+
+		// Kaiser taps are clamped on image edges
+		const int border = (filter == MIPMAP_FILTER_KAISER) ? 2 : 0;
+
+		const ubyte* linearMip = linearImage.GetPixels(1);
+		const ubyte* srgbMip = srgbImage.GetPixels(1);
+		for (int y = border; y < 8 - border; ++y)
+		{
+			for (int x = border; x < 8 - border; ++x)
+			{
+				const int i = y * 8 + x;
+				EXPECT_NEAR(linearMip[i * 4], 128, 1);
+				EXPECT_NEAR(srgbMip[i * 4], 188, 1);
+
+				// alpha is not gamma corrected
+				EXPECT_NEAR(srgbMip[i * 4 + 3], 128, 1);
+			}
+		}
+	}
+}
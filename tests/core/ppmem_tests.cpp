@@ -0,0 +1,199 @@
+#include <gtest/gtest.h>
+
+#include "core/core_common.h"
+
+using namespace Threading;
+
+static constexpr const int s_ppmemBenchIterations = 2000;
+static constexpr const int s_ppmemBenchBatch = 64;
+static constexpr const int s_ppmemBenchMaxThreads = 8;
+static constexpr const int s_ppmemCrossThreadAllocs = 10000;
+
+static int PPMemTestRandomSize(uint& seed)
+{
+	// mostly small like Array, EqString and Map nodes
+	seed = seed * 1664525u + 1013904223u;
+	const int size = 8 + (seed >> 16) % 248;
+	return (seed & 15) == 0 ? size * 16 : size;
+}
+
+class CPPMemBenchThread : public CEqThread
+{
+public:
+	bool	useMalloc{ false };
+	uint	seed{ 0 };
+
+	int Run() override
+	{
+		void* ptrs[s_ppmemBenchBatch];
+		for (int i = 0; i < s_ppmemBenchIterations; ++i)
+		{
+			for (int j = 0; j < s_ppmemBenchBatch; ++j)
+			{
+				const int size = PPMemTestRandomSize(seed);
+				ptrs[j] = useMalloc ? malloc(size) : PPAlloc(size);
+				*static_cast<ubyte*>(ptrs[j]) = j;
+			}
+
+			// free in different order
+			for (int j = 0; j < s_ppmemBenchBatch; ++j)
+			{
+				void* ptr = ptrs[(j * 7) % s_ppmemBenchBatch];
+				if (useMalloc)
+					free(ptr);
+				else
+					PPFree(ptr);
+			}
+		}
+		return 0;
+	}
+};
+
+class CPPMemAllocThread : public CEqThread
+{
+public:
+	Array<void*>	ptrs{ PP_SL };
+
+	int Run() override
+	{
+		uint seed = 1;
+		for (int i = 0; i < s_ppmemCrossThreadAllocs; ++i)
+		{
+			const int size = PPMemTestRandomSize(seed);
+			void* ptr = PPAlloc(size);
+			memset(ptr, i & 255, size);
+			ptrs.append(ptr);
+		}
+		return 0;
+	}
+};
+
+class CPPMemFreeThread : public CEqThread
+{
+public:
+	Array<void*>*	ptrs{ nullptr };
+
+	int Run() override
+	{
+		for (void* ptr : *ptrs)
+			PPFree(ptr);
+		return 0;
+	}
+};
+
+// returns nanoseconds per alloc+free pair, wall time over all threads
+static double PPMemBenchmark(int numThreads, bool useMalloc)
+{
+	CPPMemBenchThread threads[s_ppmemBenchMaxThreads];
+
+	CEqTimer timer;
+	for (int i = 0; i < numThreads; ++i)
+	{
+		threads[i].useMalloc = useMalloc;
+		threads[i].seed = i + 1;
+		threads[i].StartThread(EqString::Format("PPMemBench%d", i));
+	}
+
+	for (int i = 0; i < numThreads; ++i)
+		threads[i].WaitForThread();
+
+	return timer.GetTime() * 1e9 / (s_ppmemBenchIterations * s_ppmemBenchBatch * numThreads);
+}
+
+TEST(PPMEM_TESTS, CrossThreadFree)
+{
+	const size_t usageBefore = PPMemGetUsage();
+
+	CPPMemAllocThread allocThread;
+	allocThread.StartThread("PPMemAlloc");
+	allocThread.WaitForThread();
+
+	EXPECT_GT(PPMemGetUsage(), usageBefore);
+
+	// freed by another thread than allocating one, including exited
+	CPPMemFreeThread freeThread;
+	freeThread.ptrs = &allocThread.ptrs;
+	freeThread.StartThread("PPMemFree");
+	freeThread.WaitForThread();
+
+	allocThread.ptrs.clear(true);
+	EXPECT_EQ(PPMemGetUsage(), usageBefore);
+}
+
+TEST(PPMEM_TESTS, ReAlloc)
+{
+	const size_t usageBefore = PPMemGetUsage();
+
+	ubyte* ptr = static_cast<ubyte*>(PPAlloc(24));
+	for (int i = 0; i < 24; ++i)
+		ptr[i] = i;
+
+	// grows within size class and beyond
+	for (int size = 25; size < 128 * 1024; size = size * 3 / 2)
+	{
+		ptr = static_cast<ubyte*>(PPReAlloc(ptr, size));
+		EXPECT_EQ(PPMemGetUsage(), usageBefore + size);
+		ptr[size - 1] = 0xFF;
+	}
+
+	for (int i = 0; i < 24; ++i)
+		EXPECT_EQ(ptr[i], i);
+
+	PPDCheck(ptr);
+	PPFree(ptr);
+	EXPECT_EQ(PPMemGetUsage(), usageBefore);
+}
+
+TEST(PPMEM_TESTS, ReAllocTrackedWithEmptySourceLine)
+{
+	const size_t usageBefore = PPMemGetUsage();
+
+	ubyte* ptr = static_cast<ubyte*>(PPAlloc(24));
+	for (int i = 0; i < 24; ++i)
+		ptr[i] = i;
+
+	// block must stay tracked, not be passed to realloc
+	ptr = static_cast<ubyte*>(PPDReAlloc(ptr, 4096, PPSourceLine::Empty()));
+	EXPECT_EQ(PPMemGetUsage(), usageBefore + 4096);
+
+	for (int i = 0; i < 24; ++i)
+		EXPECT_EQ(ptr[i], i);
+
+	PPDCheck(ptr);
+	PPFree(ptr);
+	EXPECT_EQ(PPMemGetUsage(), usageBefore);
+}
+
+TEST(PPMEM_TESTS, ReAllocUntracked)
+{
+	const size_t usageBefore = PPMemGetUsage();
+
+	ubyte* ptr = static_cast<ubyte*>(PPDAlloc(24, PPSourceLine::Empty()));
+	for (int i = 0; i < 24; ++i)
+		ptr[i] = i;
+
+	// untracked block stays untracked even if source line is given
+	ptr = static_cast<ubyte*>(PPReAlloc(ptr, 4096));
+	EXPECT_EQ(PPMemGetUsage(), usageBefore);
+
+	for (int i = 0; i < 24; ++i)
+		EXPECT_EQ(ptr[i], i);
+
+	PPFree(ptr);
+	EXPECT_EQ(PPMemGetUsage(), usageBefore);
+}
+
+TEST(PPMEM_TESTS, AllocFreeBenchmark)
+{
+	const int threadCounts[] = { 1, 2, 4, 8 };
+	for (const int numThreads : threadCounts)
+	{
+		const double mallocNs = PPMemBenchmark(numThreads, true);
+		const double ppmemNs = PPMemBenchmark(numThreads, false);
+
+		Msg("%d threads: PPAlloc+PPFree %.1f ns, malloc+free %.1f ns\n", numThreads, ppmemNs, mallocNs);
+	}
+
+	// states of exited benchmark threads are reused
+	PPMemInfo(false);
+}
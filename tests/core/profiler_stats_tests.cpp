@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+
+#include "core/core_common.h"
+
+static constexpr const int s_statsFrames = 20;
+static constexpr const int s_statsInnerPerFrame = 5;
+
+static const ProfScopeStats* FindScopeStats(const ProfScopeStats* stats, int numStats, const char* name)
+{
+	for (int i = 0; i < numStats; ++i)
+	{
+		if (!strcmp(stats[i].name, name))
+			return &stats[i];
+	}
+	return nullptr;
+}
+
+static void RunStatsFrame(int sleepMs)
+{
+	{
+		PROF_EVENT("StatsTest Frame");
+		for (int i = 0; i < s_statsInnerPerFrame; ++i)
+		{
+			PROF_EVENT("StatsTest Inner");
+		}
+
+		if (sleepMs)
+			Platform_Sleep(sleepMs);
+	}
+	ProfEndFrame();
+}
+
+TEST(PROFILER_TESTS, StatsAggregation)
+{
+	ProfSetStatsEnabled(true);
+	ProfResetStats();
+
+	// opens first frame
+	ProfEndFrame();
+
+	CEqTimer timer;
+	for (int i = 0; i < s_statsFrames; ++i)
+		RunStatsFrame(1);
+	const double wallMs = timer.GetTime() * 1000.0;
+
+	ProfFrameStats frameStats;
+	ProfGetFrameStats(frameStats);
+
+	EXPECT_EQ(frameStats.frameIndex, s_statsFrames);
+	EXPECT_EQ(frameStats.numFrames, s_statsFrames);
+	EXPECT_GE(frameStats.minFrameMs, 1.0f);
+	EXPECT_LE(frameStats.minFrameMs, frameStats.avgFrameMs);
+	EXPECT_LE(frameStats.avgFrameMs, frameStats.maxFrameMs);
+	EXPECT_NEAR(frameStats.avgFrameMs * s_statsFrames, wallMs, wallMs * 0.1);
+
+	int histogramTotal = 0;
+	for (int i = 0; i < PROF_STATS_HISTOGRAM_BUCKETS; ++i)
+		histogramTotal += frameStats.histogram[i];
+	EXPECT_EQ(histogramTotal, s_statsFrames);
+	EXPECT_EQ(frameStats.histogram[0], 0);
+
+	ProfScopeStats scopeStats[64];
+	const int numScopes = ProfGetScopeStats(scopeStats, elementsOf(scopeStats));
+
+	const ProfScopeStats* frameScope = FindScopeStats(scopeStats, numScopes, "StatsTest Frame");
+	const ProfScopeStats* innerScope = FindScopeStats(scopeStats, numScopes, "StatsTest Inner");
+	ASSERT_NE(frameScope, nullptr);
+	ASSERT_NE(innerScope, nullptr);
+
+	EXPECT_EQ(frameScope->count, s_statsFrames);
+	EXPECT_EQ(frameScope->depth, 0);
+	EXPECT_EQ(frameScope->lastFrameCount, 1);
+	EXPECT_GE(frameScope->minMs, 1.0f);
+	EXPECT_LE(frameScope->minMs, frameScope->avgMs);
+	EXPECT_LE(frameScope->avgMs, frameScope->maxMs);
+
+	EXPECT_EQ(innerScope->count, s_statsFrames * s_statsInnerPerFrame);
+	EXPECT_EQ(innerScope->depth, 1);
+	EXPECT_EQ(innerScope->lastFrameCount, s_statsInnerPerFrame);
+	EXPECT_LT(innerScope->totalMs, frameScope->totalMs);
+
+	// sorted by total time
+	for (int i = 1; i < numScopes; ++i)
+		EXPECT_GE(scopeStats[i - 1].totalMs, scopeStats[i].totalMs);
+
+	ProfThreadStats threadStats[16];
+	const int numThreads = ProfGetThreadStats(threadStats, elementsOf(threadStats));
+	ASSERT_GE(numThreads, 1);
+	EXPECT_GE(threadStats[0].avgBusyMs, 1.0f);
+	EXPECT_LE(threadStats[0].avgBusyMs, frameStats.avgFrameMs);
+
+	ProfResetStats();
+	ProfGetFrameStats(frameStats);
+	EXPECT_EQ(frameStats.numFrames, 0);
+	EXPECT_EQ(ProfGetScopeStats(scopeStats, elementsOf(scopeStats)), 0);
+
+	ProfSetStatsEnabled(false);
+}
+
+TEST(PROFILER_TESTS, StatsSpikeCapture)
+{
+	ProfSetStatsEnabled(true);
+	ProfResetStats();
+	ProfSetSpikeCapture(20.0f, 4);
+
+	CRefPtr<CMemoryStream> traceStream = CRefPtr_new(CMemoryStream, nullptr, VS_OPEN_WRITE | VS_OPEN_READ, 64 * 1024, PP_SL);
+	EXPECT_FALSE(ProfWriteSpikeTrace(traceStream));
+
+	ProfEndFrame();
+	for (int i = 0; i < 10; ++i)
+		RunStatsFrame(0);
+
+	ProfFrameStats frameStats;
+	ProfGetFrameStats(frameStats);
+	EXPECT_EQ(frameStats.numSpikes, 0);
+
+	RunStatsFrame(30);
+
+	ProfGetFrameStats(frameStats);
+	EXPECT_EQ(frameStats.numSpikes, 1);
+	EXPECT_GE(frameStats.lastSpikeMs, 20.0f);
+	EXPECT_GE(frameStats.maxFrameMs, 20.0f);
+
+	// later frames must not alter the capture
+	RunStatsFrame(0);
+
+	ASSERT_TRUE(ProfWriteSpikeTrace(traceStream));
+	ProfSetSpikeCapture(0.0f, 0);
+
+	traceStream->Seek(0, VS_SEEK_SET);
+	CRefPtr<CMemoryStream> jsonStream = CRefPtr_new(CMemoryStream, nullptr, VS_OPEN_WRITE | VS_OPEN_READ, 64 * 1024, PP_SL);
+	ASSERT_TRUE(ProfConvertTraceToJSON(traceStream, jsonStream));
+
+	const char nullTerm = 0;
+	jsonStream->Write(&nullTerm, 1, 1);
+
+	// spike frame and three before it
+	int numFrameEvents = 0;
+	const char* json = (const char*)jsonStream->GetBasePointer();
+	for (const char* found = strstr(json, "\"name\":\"StatsTest Frame\""); found; found = strstr(found + 1, "\"name\":\"StatsTest Frame\""))
+		++numFrameEvents;
+	EXPECT_EQ(numFrameEvents, 4);
+
+	ProfSetStatsEnabled(false);
+}
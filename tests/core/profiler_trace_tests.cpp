@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+
+#include "core/core_common.h"
+
+using namespace Threading;
+
+static constexpr const int s_traceScopesPerThread = 2000;
+static constexpr const int s_traceBenchScopes = 200000;
+static constexpr const int s_traceBenchThreads = 4;
+
+static int CountSubstrings(const char* str, const char* substr)
+{
+	int count = 0;
+	const int substrLength = strlen(substr);
+	for (const char* found = strstr(str, substr); found; found = strstr(found + substrLength, substr))
+		++count;
+	return count;
+}
+
+// produces nested scopes, pauses so writer keeps up
+class CTraceScopesThread : public CEqThread
+{
+public:
+	int Run() override
+	{
+		for (int i = 0; i < s_traceScopesPerThread; ++i)
+		{
+			PROF_EVENT("TraceTest Outer");
+			{
+				PROF_EVENT("TraceTest Inner");
+			}
+
+			if ((i % 100) == 99)
+				Platform_Sleep(1);
+		}
+		return 0;
+	}
+};
+
+class CTraceBenchThread : public CEqThread
+{
+public:
+	int Run() override
+	{
+		for (int i = 0; i < s_traceBenchScopes; ++i)
+		{
+			PROF_EVENT("TraceBench Scope");
+		}
+		return 0;
+	}
+};
+
+static CRefPtr<CMemoryStream> ConvertTrace(CMemoryStream* traceStream)
+{
+	traceStream->Seek(0, VS_SEEK_SET);
+
+	CRefPtr<CMemoryStream> jsonStream = CRefPtr_new(CMemoryStream, nullptr, VS_OPEN_WRITE | VS_OPEN_READ, 64 * 1024, PP_SL);
+	EXPECT_TRUE(ProfConvertTraceToJSON(traceStream, jsonStream));
+
+	const char nullTerm = 0;
+	jsonStream->Write(&nullTerm, 1, 1);
+	return jsonStream;
+}
+
+static double MeasureSingleThreadScope()
+{
+	CEqTimer timer;
+	for (int i = 0; i < s_traceBenchScopes; ++i)
+	{
+		PROF_EVENT("TraceBench Scope");
+	}
+	return timer.GetTime() * 1e9 / s_traceBenchScopes;
+}
+
+TEST(PROFILER_TESTS, TraceRoundTrip)
+{
+	CRefPtr<CMemoryStream> traceStream = CRefPtr_new(CMemoryStream, nullptr, VS_OPEN_WRITE | VS_OPEN_READ, 64 * 1024, PP_SL);
+	ASSERT_TRUE(ProfStartTrace(traceStream));
+	EXPECT_TRUE(ProfIsTracing());
+
+	// not possible to start twice
+	EXPECT_FALSE(ProfStartTrace(traceStream));
+
+	CTraceScopesThread threadA;
+	CTraceScopesThread threadB;
+	threadA.StartThread("TraceTestA");
+	threadB.StartThread("TraceTestB");
+
+	// same label pointer with different contents
+	for (int i = 0; i < 10; ++i)
+	{
+		EqString dynamicName = EqString::Format("TraceTest Dynamic %d", i);
+		PROF_EVENT(dynamicName);
+	}
+
+	threadA.WaitForThread();
+	threadB.WaitForThread();
+
+	ProfStopTrace();
+	EXPECT_FALSE(ProfIsTracing());
+
+	// not recorded
+	{
+		PROF_EVENT("TraceTest After Stop");
+	}
+
+	CRefPtr<CMemoryStream> jsonStream = ConvertTrace(traceStream);
+	const char* json = (const char*)jsonStream->GetBasePointer();
+
+	EXPECT_EQ(strncmp(json, "{\"traceEvents\":[", 16), 0);
+	EXPECT_EQ(CountSubstrings(json, "\"name\":\"TraceTest Outer\""), s_traceScopesPerThread * 2);
+	EXPECT_EQ(CountSubstrings(json, "\"name\":\"TraceTest Inner\""), s_traceScopesPerThread * 2);
+	EXPECT_EQ(CountSubstrings(json, "\"name\":\"TraceTest After Stop\""), 0);
+	EXPECT_EQ(CountSubstrings(json, "\"args\":{\"name\":\"TraceTestA\"}"), 1);
+	EXPECT_EQ(CountSubstrings(json, "\"args\":{\"name\":\"TraceTestB\"}"), 1);
+
+	for (int i = 0; i < 10; ++i)
+		EXPECT_EQ(CountSubstrings(json, EqString::Format("\"name\":\"TraceTest Dynamic %d\"", i)), 1);
+
+	// corrupted trace is rejected
+	CRefPtr<CMemoryStream> badStream = CRefPtr_new(CMemoryStream, nullptr, VS_OPEN_WRITE | VS_OPEN_READ, 64, PP_SL);
+	badStream->Print("{\"traceEvents\":[]}");
+	badStream->Seek(0, VS_SEEK_SET);
+
+	CRefPtr<CMemoryStream> badJson = CRefPtr_new(CMemoryStream, nullptr, VS_OPEN_WRITE | VS_OPEN_READ, 64, PP_SL);
+	EXPECT_FALSE(ProfConvertTraceToJSON(badStream, badJson));
+}
+
+TEST(PROFILER_TESTS, TraceScopeOverhead)
+{
+	ProfSetStatsEnabled(false);
+	const double disabledNs = MeasureSingleThreadScope();
+
+	CRefPtr<CMemoryStream> traceStream = CRefPtr_new(CMemoryStream, nullptr, VS_OPEN_WRITE | VS_OPEN_READ, 1024 * 1024, PP_SL);
+	ASSERT_TRUE(ProfStartTrace(traceStream));
+
+	const double enabledNs = MeasureSingleThreadScope();
+
+	// wall time over all scopes, threads don't share anything but the writer
+	CEqTimer threadsTimer;
+	CTraceBenchThread threads[s_traceBenchThreads];
+	for (int i = 0; i < s_traceBenchThreads; ++i)
+		threads[i].StartThread(EqString::Format("TraceBench%d", i));
+
+	for (int i = 0; i < s_traceBenchThreads; ++i)
+		threads[i].WaitForThread();
+
+	const double threadedNs = threadsTimer.GetTime() * 1e9 / (s_traceBenchScopes * s_traceBenchThreads);
+
+	ProfStopTrace();
+
+	CRefPtr<CMemoryStream> jsonStream = ConvertTrace(traceStream);
+	const int numRecorded = CountSubstrings((const char*)jsonStream->GetBasePointer(), "\"name\":\"TraceBench Scope\"");
+	const int numScopes = s_traceBenchScopes * (s_traceBenchThreads + 1);
+
+	Msg("PROF_EVENT scope cost: %.1f ns not tracing, %.1f ns tracing, %.1f ns per scope tracing on %d threads\n",
+		disabledNs, enabledNs, threadedNs, s_traceBenchThreads);
+	Msg("  %d of %d scopes recorded (rest dropped when writer falls behind), trace %d KB, %.1f bytes per scope\n",
+		numRecorded, numScopes, (int)(traceStream->GetSize() / 1024), (double)traceStream->GetSize() / max(numRecorded, 1));
+
+	EXPECT_GT(numRecorded, 0);
+	EXPECT_LE(numRecorded, numScopes);
+}
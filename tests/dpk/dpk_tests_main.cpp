@@ -0,0 +1,19 @@
+#include <gtest/gtest.h>
+
+#include "core/core_common.h"
+#include "core/IFileSystem.h"
+#include "tests_common.h"
+
+int main(int argc, char** argv)
+{
+	// packages are written to the file system
+	TestAppWrapper test(true, "dpk_tests", argc, argv);
+	g_fileSystem->Init(false);
+
+	testing::InitGoogleTest(&argc, argv);
+
+	// you can specify flags before running
+	//::testing::FLAGS_gtest_filter = "DPK_WRITER_TESTS.*";
+
+	return RUN_ALL_TESTS();
+}
@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+
+#include "core/core_common.h"
+#include "core/IFileSystem.h"
+#include "core/IEqCPUServices.h"
+#include "core/platform/eqjobmanager.h"
+#include "dpk/DPKFileWriter.h"
+#include "dpk/DPKFileReader.h"
+
+static constexpr const int s_dpkTestFiles = 40;
+static constexpr const int s_dpkTestCompression = 9;
+static constexpr const int s_dpkBenchFiles = 200;
+static constexpr const int s_dpkBenchRuns = 3;
+
+static constexpr const char* s_dpkTestPackage = "dpk_tests_package.epk";
+static constexpr const char* s_dpkTestPrevPackage = "dpk_tests_package.epk.prev";
+static constexpr const char* s_dpkTestFullPackage = "dpk_tests_full.epk";
+
+// partially compressible data, size is not multiple of block size
+static void MakeFileData(int seed, Array<ubyte>& data)
+{
+	data.setNum(1000 + (seed % 97) * 5711);
+
+	uint32 random = seed * 2654435761u + 1;
+	for (int i = 0; i < data.numElem(); ++i)
+	{
+		random = random * 1103515245 + 12345;
+		data[i] = (i % 7 == 0) ? (ubyte)(random >> 16) : (ubyte)(i / 64 + seed);
+	}
+}
+
+struct DPKTestFiles
+{
+	Array<Array<ubyte>>	data{ PP_SL };
+	int64				totalSize{ 0 };
+
+	DPKTestFiles(int numFiles)
+	{
+		for (int i = 0; i < numFiles; ++i)
+		{
+			Array<ubyte>& fileData = data[data.append(Array<ubyte>(PP_SL))];
+			MakeFileData(i, fileData);
+			totalSize += fileData.numElem();
+		}
+	}
+
+	void Change(int fileIdx, int seed)
+	{
+		totalSize -= data[fileIdx].numElem();
+		MakeFileData(seed, data[fileIdx]);
+		totalSize += data[fileIdx].numElem();
+	}
+};
+
+// returns number of files copied from previous package
+static int WriteTestPackage(const char* fileName, const DPKTestFiles& files, CEqJobManager* jobMng, const char* prevFileName = nullptr)
+{
+	CDPKFileWriter writer("dpktest", s_dpkTestCompression);
+	writer.SetJobManager(jobMng);
+	if (prevFileName)
+		EXPECT_TRUE(writer.SetPreviousPackage(prevFileName));
+
+	EXPECT_TRUE(writer.Begin(fileName));
+	for (int i = 0; i < files.data.numElem(); ++i)
+	{
+		CMemoryStream stream(const_cast<ubyte*>(files.data[i].ptr()), VS_OPEN_READ, files.data[i].numElem(), PP_SL);
+		writer.Add(&stream, EqString::Format("file%d.bin", i), DPKFILE_FLAG_COMPRESSED);
+	}
+	writer.End();
+
+	return writer.GetReusedFileCount();
+}
+
+static void ReadTestPackage(const char* fileName, Array<ubyte>& data)
+{
+	IFilePtr file = g_fileSystem->Open(fileName, "rb", SP_ROOT);
+	ASSERT_TRUE(file);
+
+	data.setNum(file->GetSize());
+	file->Read(data.ptr(), 1, data.numElem());
+}
+
+static void CheckPackageFiles(const char* fileName, const DPKTestFiles& files)
+{
+	CDPKFileReader reader;
+	ASSERT_TRUE(reader.InitPackage(g_fileSystem->GetAbsolutePath(SP_ROOT, fileName), nullptr));
+
+	Array<ubyte> readData(PP_SL);
+	for (int i = 0; i < files.data.numElem(); ++i)
+	{
+		IFilePtr file = reader.Open(EqString::Format("file%d.bin", i), COSFile::READ);
+		ASSERT_TRUE(file) << "file " << i;
+		ASSERT_EQ(file->GetSize(), files.data[i].numElem()) << "file " << i;
+
+		readData.setNum(file->GetSize());
+		file->Read(readData.ptr(), 1, readData.numElem());
+		EXPECT_EQ(memcmp(readData.ptr(), files.data[i].ptr(), readData.numElem()), 0) << "file " << i;
+	}
+}
+
+class DPK_WRITER_TESTS : public testing::Test
+{
+protected:
+	void TearDown() override
+	{
+		g_fileSystem->FileRemove(s_dpkTestPackage, SP_ROOT);
+		g_fileSystem->FileRemove(s_dpkTestPrevPackage, SP_ROOT);
+		g_fileSystem->FileRemove(s_dpkTestFullPackage, SP_ROOT);
+	}
+};
+
+TEST_F(DPK_WRITER_TESTS, ParallelMatchesSerial)
+{
+	DPKTestFiles files(s_dpkTestFiles);
+	CEqJobManager jobMng("dpkTestJobs", 4, 1024);
+
+	WriteTestPackage(s_dpkTestFullPackage, files, nullptr);
+	WriteTestPackage(s_dpkTestPackage, files, &jobMng);
+
+	Array<ubyte> serialData(PP_SL);
+	Array<ubyte> parallelData(PP_SL);
+	ReadTestPackage(s_dpkTestFullPackage, serialData);
+	ReadTestPackage(s_dpkTestPackage, parallelData);
+
+	ASSERT_EQ(serialData.numElem(), parallelData.numElem());
+	EXPECT_EQ(memcmp(serialData.ptr(), parallelData.ptr(), serialData.numElem()), 0);
+
+	CheckPackageFiles(s_dpkTestPackage, files);
+}
+
+TEST_F(DPK_WRITER_TESTS, IncrementalRebuild)
+{
+	DPKTestFiles files(s_dpkTestFiles);
+	CEqJobManager jobMng("dpkTestJobs", 4, 1024);
+
+	EXPECT_EQ(WriteTestPackage(s_dpkTestPackage, files, &jobMng), 0);
+	g_fileSystem->Rename(s_dpkTestPackage, s_dpkTestPrevPackage, SP_ROOT);
+
+	// same size but different content, different size, last file
+	const int changedFiles[] = { 3, 17, s_dpkTestFiles - 1 };
+	files.Change(changedFiles[0], changedFiles[0] + 97);
+	files.Change(changedFiles[1], 1000);
+	files.Change(changedFiles[2], 2000);
+
+	EXPECT_EQ(WriteTestPackage(s_dpkTestPackage, files, &jobMng, s_dpkTestPrevPackage), s_dpkTestFiles - (int)elementsOf(changedFiles));
+	CheckPackageFiles(s_dpkTestPackage, files);
+
+	// reused blocks are same as newly compressed
+	WriteTestPackage(s_dpkTestFullPackage, files, &jobMng);
+
+	Array<ubyte> incrementalData(PP_SL);
+	Array<ubyte> fullData(PP_SL);
+	ReadTestPackage(s_dpkTestPackage, incrementalData);
+	ReadTestPackage(s_dpkTestFullPackage, fullData);
+
+	ASSERT_EQ(incrementalData.numElem(), fullData.numElem());
+	EXPECT_EQ(memcmp(incrementalData.ptr(), fullData.ptr(), fullData.numElem()), 0);
+}
+
+// benchmarks are run with --gtest_also_run_disabled_tests
+TEST_F(DPK_WRITER_TESTS, DISABLED_ThreadsBenchmark)
+{
+	DPKTestFiles files(s_dpkBenchFiles);
+	const double totalSizeMB = files.totalSize / (1024.0 * 1024.0);
+
+	// thread count includes the calling thread
+	const int threadCounts[] = { 1, 2, 4, max(1, g_cpuCaps->GetCPUCount()) };
+	for (const int numThreads : threadCounts)
+	{
+		CEqJobManager jobMng("dpkBenchJobs", max(1, numThreads - 1), 1024);
+		CEqJobManager* writerJobMng = (numThreads > 1) ? &jobMng : nullptr;
+
+		double bestTime = DBL_MAX;
+		for (int run = 0; run < s_dpkBenchRuns; ++run)
+		{
+			CEqTimer timer;
+			WriteTestPackage(s_dpkTestPackage, files, writerJobMng);
+			bestTime = min(bestTime, timer.GetTime());
+		}
+
+		Msg("%.2f MB in %d files, %d threads: %.2f ms, %.2f MB/s\n", totalSizeMB, s_dpkBenchFiles, numThreads, bestTime * 1000.0, totalSizeMB / bestTime);
+	}
+
+	// incremental rebuild with one changed file
+	WriteTestPackage(s_dpkTestFullPackage, files, nullptr);
+	files.Change(0, 1000);
+
+	CEqTimer timer;
+	const int reusedFiles = WriteTestPackage(s_dpkTestPackage, files, nullptr, s_dpkTestFullPackage);
+	const double incrementalTime = timer.GetTime();
+
+	EXPECT_EQ(reusedFiles, s_dpkBenchFiles - 1);
+	Msg("incremental rebuild, %d reused files: %.2f ms, %.2f MB/s\n", reusedFiles, incrementalTime * 1000.0, totalSizeMB / incrementalTime);
+}
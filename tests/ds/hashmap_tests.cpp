@@ -0,0 +1,218 @@
+#include <gtest/gtest.h>
+
+#include "core/core_common.h"
+
+static constexpr const int s_hashBenchCount = 50000;
+static constexpr const int s_hashBenchLookups = 4;
+
+static uint HashBenchRandom(uint& seed)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return seed >> 8;
+}
+
+TEST(HASHMAP_TESTS, InsertFindRemove)
+{
+	HashMap<int, int> map(PP_SL);
+	EXPECT_TRUE(map.isEmpty());
+	EXPECT_TRUE(map.find(5).atEnd());
+
+	for (int i = 0; i < 1000; ++i)
+		map.insert(i * 7, i);
+
+	EXPECT_EQ(map.size(), 1000);
+	for (int i = 0; i < 1000; ++i)
+	{
+		auto it = map.find(i * 7);
+		ASSERT_FALSE(it.atEnd());
+		EXPECT_EQ(it.key(), i * 7);
+		EXPECT_EQ(*it, i);
+	}
+	EXPECT_FALSE(map.contains(1));
+
+	// existing key is updated
+	map.insert(7, 100);
+	EXPECT_EQ(map.size(), 1000);
+	EXPECT_EQ(map[7], 100);
+
+	for (int i = 0; i < 1000; i += 2)
+		map.remove(i * 7);
+
+	EXPECT_EQ(map.size(), 500);
+	for (int i = 0; i < 1000; ++i)
+		EXPECT_EQ(map.contains(i * 7), (i & 1) != 0);
+
+	// removed slots are reused
+	const int capacity = map.capacity();
+	for (int round = 0; round < 20; ++round)
+	{
+		for (int i = 0; i < 500; ++i)
+			map.insert(-1 - i, i);
+		for (int i = 0; i < 500; ++i)
+			map.remove(-1 - i);
+	}
+	EXPECT_EQ(map.size(), 500);
+	EXPECT_EQ(map.capacity(), capacity);
+}
+
+TEST(HASHMAP_TESTS, Iteration)
+{
+	HashMap<int, int> map(PP_SL);
+	for (int i = 0; i < 100; ++i)
+		map[i] = i * 2;
+
+	int count = 0;
+	int keySum = 0;
+	for (auto it = map.begin(); !it.atEnd(); ++it)
+	{
+		EXPECT_EQ(*it, it.key() * 2);
+		keySum += it.key();
+		++count;
+	}
+	EXPECT_EQ(count, 100);
+	EXPECT_EQ(keySum, 99 * 100 / 2);
+
+	// remove while iterating
+	for (auto it = map.begin(); !it.atEnd();)
+	{
+		if (it.key() % 3 == 0)
+			it = map.remove(it);
+		else
+			++it;
+	}
+	EXPECT_EQ(map.size(), 66);
+
+	for (int value : map)
+		EXPECT_NE(value % 3, 0);
+}
+
+TEST(HASHMAP_TESTS, StringKeysAndValues)
+{
+	HashMap<EqString, EqString> map(PP_SL);
+	for (int i = 0; i < 200; ++i)
+		map.insert(EqString::Format("materials/texture_%d", i), EqString::Format("value %d", i));
+
+	EXPECT_EQ(map.size(), 200);
+	EXPECT_EQ(*map.find("materials/texture_150"), "value 150");
+	EXPECT_TRUE(map.find("materials/texture_200").atEnd());
+
+	// copies keep values, moved from is empty
+	HashMap<EqString, EqString> copy(map);
+	HashMap<EqString, EqString> moved(std::move(map));
+	EXPECT_EQ(map.size(), 0);
+	EXPECT_EQ(copy.size(), 200);
+	EXPECT_EQ(*moved.find("materials/texture_10"), "value 10");
+
+	copy.clear();
+	EXPECT_TRUE(copy.isEmpty());
+	EXPECT_TRUE(copy.find("materials/texture_10").atEnd());
+
+	HashSet<EqString> set(PP_SL);
+	set.insert("a");
+	set.insert("b");
+	set.insert("a");
+	EXPECT_EQ(set.size(), 2);
+	EXPECT_TRUE(set.contains("b"));
+
+	HashMap<int, Array<int>> nested(PP_SL);
+	nested[5].append(1);
+	nested[5].append(2);
+	EXPECT_EQ(nested[5].numElem(), 2);
+}
+
+template<typename MAP_TYPE>
+static void HashBenchInt(const char* name, ArrayCRef<int> keys)
+{
+	MAP_TYPE map(PP_SL);
+
+	CEqTimer timer;
+	for (int i = 0; i < keys.numElem(); ++i)
+		map.insert(keys[i], i);
+	const double insertMs = timer.GetTime(true) * 1000.0;
+
+	int found = 0;
+	for (int j = 0; j < s_hashBenchLookups; ++j)
+	{
+		for (int i = 0; i < keys.numElem(); ++i)
+			found += !map.find(keys[i] + (j & 1)).atEnd();
+	}
+	const double lookupMs = timer.GetTime(true) * 1000.0;
+
+	int64 sum = 0;
+	for (auto it = map.begin(); !it.atEnd(); ++it)
+		sum += *it;
+	const double iterateMs = timer.GetTime(true) * 1000.0;
+
+	EXPECT_EQ(sum, static_cast<int64>(keys.numElem() - 1) * keys.numElem() / 2);
+	EXPECT_GE(found, keys.numElem() * s_hashBenchLookups / 2);
+	Msg("%s int keys: insert %.2f ms, lookup %.2f ms, iterate %.2f ms\n", name, insertMs, lookupMs, iterateMs);
+}
+
+// benchmarks are run with --gtest_also_run_disabled_tests
+TEST(HASHMAP_TESTS, DISABLED_IntKeysBenchmark)
+{
+	Array<int> keys(PP_SL);
+	uint seed = 1;
+	HashSet<int> unique(PP_SL);
+	while (keys.numElem() < s_hashBenchCount)
+	{
+		const int key = HashBenchRandom(seed) & ~1;
+		if (unique.contains(key))
+			continue;
+		unique.insert(key);
+		keys.append(key);
+	}
+
+	HashBenchInt<Map<int, int>>("Map", keys);
+	HashBenchInt<HashMap<int, int>>("HashMap", keys);
+}
+
+TEST(HASHMAP_TESTS, DISABLED_StringKeysBenchmark)
+{
+	Array<EqString> keys(PP_SL);
+	for (int i = 0; i < s_hashBenchCount; ++i)
+		keys.append(EqString::Format("models/props/object_%d.egf", i));
+
+	// engine keys Map by string hash and compares names on hit
+	{
+		Map<int, int> map(PP_SL);
+
+		CEqTimer timer;
+		for (int i = 0; i < keys.numElem(); ++i)
+			map.insert(StringToHash(keys[i]), i);
+		const double insertMs = timer.GetTime(true) * 1000.0;
+
+		int found = 0;
+		for (int j = 0; j < s_hashBenchLookups; ++j)
+		{
+			for (int i = 0; i < keys.numElem(); ++i)
+			{
+				auto it = map.find(StringToHash(keys[i]));
+				found += !it.atEnd() && keys[*it] == keys[i];
+			}
+		}
+		const double lookupMs = timer.GetTime(true) * 1000.0;
+
+		Msg("Map string hash keys: insert %.2f ms, lookup %.2f ms (%d found)\n", insertMs, lookupMs, found);
+	}
+
+	{
+		HashMap<EqString, int> map(PP_SL);
+
+		CEqTimer timer;
+		for (int i = 0; i < keys.numElem(); ++i)
+			map.insert(keys[i], i);
+		const double insertMs = timer.GetTime(true) * 1000.0;
+
+		int found = 0;
+		for (int j = 0; j < s_hashBenchLookups; ++j)
+		{
+			for (int i = 0; i < keys.numElem(); ++i)
+				found += !map.find(keys[i]).atEnd();
+		}
+		const double lookupMs = timer.GetTime(true) * 1000.0;
+
+		EXPECT_EQ(found, keys.numElem() * s_hashBenchLookups);
+		Msg("HashMap string keys: insert %.2f ms, lookup %.2f ms\n", insertMs, lookupMs);
+	}
+}
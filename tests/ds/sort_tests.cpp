@@ -0,0 +1,212 @@
+#include <gtest/gtest.h>
+
+#include "core/core_common.h"
+#include "ds/sort_parallel.h"
+
+struct SortTestItem
+{
+	float	distance;
+	int		index;
+};
+
+static uint SortTestRandom(uint& seed)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return seed >> 8;
+}
+
+static void SortTestFill(Array<SortTestItem>& items, int count, int distinctKeys, uint seed)
+{
+	items.setNum(count);
+	for (int i = 0; i < count; ++i)
+	{
+		const int key = int(SortTestRandom(seed) % distinctKeys) - distinctKeys / 2;
+		items[i] = { key * 0.25f, i };
+	}
+}
+
+static int SortTestCompare(const SortTestItem& a, const SortTestItem& b)
+{
+	return sortCompare(a.distance, b.distance);
+}
+
+static int SortTestCompareStable(const SortTestItem& a, const SortTestItem& b)
+{
+	const int res = sortCompare(a.distance, b.distance);
+	return res ? res : sortCompare(a.index, b.index);
+}
+
+TEST(SORT_TESTS, RadixSortIntKeys)
+{
+	Array<int> values(PP_SL);
+	Array<int> temp(PP_SL);
+	uint seed = 12345;
+	for (int i = 0; i < 10000; ++i)
+		values.append(int(SortTestRandom(seed)) - 0x400000);
+	values.append(INT_MIN);
+	values.append(INT_MAX);
+	values.append(0);
+	values.append(-1);
+
+	Array<int> expected(PP_SL);
+	expected.append(values);
+	arraySort(expected, sortCompare<int>);
+
+	arrayRadixSort(values, temp, [](int value) { return value; });
+	ASSERT_EQ(values.numElem(), expected.numElem());
+	for (int i = 0; i < values.numElem(); ++i)
+		EXPECT_EQ(values[i], expected[i]);
+
+	// 64 bit keys with only high bits different
+	Array<int64> values64(PP_SL);
+	Array<int64> temp64(PP_SL);
+	for (int i = 0; i < 1000; ++i)
+		values64.append((int64(SortTestRandom(seed) % 64) - 32) << 40);
+
+	arrayRadixSort(values64, temp64, [](int64 value) { return value; });
+	EXPECT_TRUE(arrayIsSorted(values64.ptr(), values64.ptr() + values64.numElem(), sortCompare<int64>));
+}
+
+TEST(SORT_TESTS, RadixSortFloatKeysStable)
+{
+	Array<SortTestItem> items(PP_SL);
+	Array<SortTestItem> temp(PP_SL);
+	SortTestFill(items, 20000, 100, 777);
+	items.append({ 0.0f, items.numElem() });
+	items.append({ -0.0f, -1 }); // -0.0 goes before all 0.0
+	items.append({ -1e30f, items.numElem() });
+	items.append({ 1e30f, items.numElem() });
+
+	arrayRadixSort(items, temp, [](const SortTestItem& item) { return item.distance; });
+	EXPECT_TRUE(arrayIsSorted(items.ptr(), items.ptr() + items.numElem(), SortTestCompareStable));
+
+	// reversed keys keep original order for equal keys
+	SortTestFill(items, 20000, 100, 778);
+	arrayRadixSort(items, temp, [](const SortTestItem& item) { return -item.distance; });
+	for (int i = 1; i < items.numElem(); ++i)
+	{
+		ASSERT_GE(items[i - 1].distance, items[i].distance);
+		if (items[i - 1].distance == items[i].distance)
+			ASSERT_LT(items[i - 1].index, items[i].index);
+	}
+}
+
+TEST(SORT_TESTS, RadixSortIndices)
+{
+	// SoA keys are not moved
+	Array<float> keys(PP_SL);
+	uint seed = 99;
+	for (int i = 0; i < 5000; ++i)
+		keys.append(float(SortTestRandom(seed) % 1000) * 0.5f - 250.0f);
+
+	Array<int> indices(PP_SL);
+	Array<int> temp(PP_SL);
+	indices.setNum(keys.numElem());
+	temp.setNum(keys.numElem());
+	radixSortIndices(indices.ptr(), temp.ptr(), keys.numElem(), [&](int idx) { return keys[idx]; });
+
+	for (int i = 1; i < indices.numElem(); ++i)
+	{
+		ASSERT_LE(keys[indices[i - 1]], keys[indices[i]]);
+		if (keys[indices[i - 1]] == keys[indices[i]])
+			ASSERT_LT(indices[i - 1], indices[i]);
+	}
+}
+
+TEST(SORT_TESTS, MergeSortStable)
+{
+	Array<SortTestItem> items(PP_SL);
+	Array<SortTestItem> temp(PP_SL);
+	for (int count : { 0, 1, 2, 15, 16, 17, 1000, 33333 })
+	{
+		SortTestFill(items, count, 50, count);
+		arrayStableSort(items, temp, SortTestCompare);
+		EXPECT_TRUE(arrayIsSorted(items.ptr(), items.ptr() + items.numElem(), SortTestCompareStable));
+	}
+}
+
+TEST(SORT_TESTS, NthElementAndPartialSort)
+{
+	Array<SortTestItem> items(PP_SL);
+	Array<SortTestItem> sorted(PP_SL);
+	for (int count : { 1, 5, 11, 100, 10000 })
+	{
+		SortTestFill(sorted, count, count / 2 + 1, 31 + count);
+		arraySort(sorted, SortTestCompare);
+
+		for (int nth : { 0, count / 3, count / 2, count - 1 })
+		{
+			SortTestFill(items, count, count / 2 + 1, 31 + count);
+			arrayNthElement(items, nth, SortTestCompare);
+
+			ASSERT_EQ(items[nth].distance, sorted[nth].distance);
+			for (int i = 0; i < nth; ++i)
+				ASSERT_LE(items[i].distance, items[nth].distance);
+			for (int i = nth + 1; i < count; ++i)
+				ASSERT_GE(items[i].distance, items[nth].distance);
+
+			SortTestFill(items, count, count / 2 + 1, 31 + count);
+			arrayPartialSort(items, nth + 1, SortTestCompare);
+			for (int i = 0; i <= nth; ++i)
+				ASSERT_EQ(items[i].distance, sorted[i].distance);
+		}
+	}
+}
+
+TEST(SORT_TESTS, ParallelSort)
+{
+	CEqJobManager jobMng("sortTestJobs", 4, 64);
+
+	Array<SortTestItem> items(PP_SL);
+	Array<SortTestItem> temp(PP_SL);
+	Array<SortTestItem> expected(PP_SL);
+	for (int count : { 0, 10, 8192, 50000, 300001 })
+	{
+		SortTestFill(items, count, 1000, count + 5);
+		SortTestFill(expected, count, 1000, count + 5);
+
+		arrayParallelSort(items, temp, SortTestCompareStable, jobMng);
+		arraySort(expected, SortTestCompareStable);
+
+		ASSERT_EQ(items.numElem(), expected.numElem());
+		for (int i = 0; i < count; ++i)
+			ASSERT_EQ(items[i].index, expected[i].index);
+	}
+}
+
+// benchmarks are run with --gtest_also_run_disabled_tests
+TEST(SORT_TESTS, DISABLED_Benchmark)
+{
+	CEqJobManager jobMng("sortBenchJobs", 4, 256);
+
+	Array<SortTestItem> source(PP_SL);
+	Array<SortTestItem> items(PP_SL);
+	Array<SortTestItem> temp(PP_SL);
+
+	const auto radixKey = [](const SortTestItem& item) { return item.distance; };
+
+	for (int count = 1000; count <= 10000000; count *= 10)
+	{
+		SortTestFill(source, count, count, count);
+
+		CEqTimer timer;
+		const auto runBench = [&](auto sortFunc) {
+			items.setNum(0, false);
+			items.append(source);
+			timer.GetTime(true);
+			sortFunc();
+			const float ms = timer.GetTime() * 1000.0f;
+			EXPECT_EQ(items.numElem(), count);
+			return ms;
+		};
+
+		const float arraySortMs = runBench([&]() { arraySort(items, SortTestCompare); });
+		const float radixMs = runBench([&]() { arrayRadixSort(items, temp, radixKey); });
+		const float stableMs = runBench([&]() { arrayStableSort(items, temp, SortTestCompare); });
+		const float parallelMs = runBench([&]() { arrayParallelSort(items, temp, SortTestCompare, jobMng); });
+		const float partialMs = runBench([&]() { arrayPartialSort(items, min(count, 100), SortTestCompare); });
+
+		Msg("Sort %d items: arraySort %.2f ms, radix %.2f ms, stable %.2f ms, parallel %.2f ms, partial(100) %.2f ms\n",
+			count, arraySortMs, radixMs, stableMs, parallelMs, partialMs);
+	}
+}
@@ -0,0 +1,523 @@
+#include <gtest/gtest.h>
+
+#include "core/core_common.h"
+#include "math/Random.h"
+#include "network/Buffer.h"
+#include "network/BitStream.h"
+
+using namespace Networking;
+
+static constexpr const int s_benchEventCount = 10000;
+static constexpr const int s_benchRepeats = 20;
+
+static const char* s_surfaceNames[] = {
+	"asphalt", "asphalt_wet", "concrete", "grass", "dirt", "gravel", "metal", "wood", "glass", "rubber", "water", "sand"
+};
+
+static const char* s_carNames[] = {
+	"mustang", "rollo", "taxi_cab", "police_default", "van_delivery", "bus_city", "pickup_truck"
+};
+
+//-------------------------------------------------------------
+// typical game event payloads
+
+struct TestCollisionEvent
+{
+	int			objectId;
+	Vector3D	position;
+	Vector3D	normal;
+	float		impulse;
+	const char*	surfaceName;
+};
+
+struct TestSpawnEvent
+{
+	int			playerId;
+	EqString	playerName;
+	const char*	carName;
+	Vector3D	position;
+	Quaternion	rotation;
+	int			colorIdx;
+};
+
+struct TestInputEvent
+{
+	int			tick;
+	float		steering;
+	float		accel;
+	float		brake;
+	bool		handbrake;
+	int			buttons;
+};
+
+struct TestEvents
+{
+	Array<TestCollisionEvent>	collisions{ PP_SL };
+	Array<TestSpawnEvent>		spawns{ PP_SL };
+	Array<TestInputEvent>		inputs{ PP_SL };
+};
+
+static Vector3D RandomUnitVector()
+{
+	return normalize(Vector3D(RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f)) + Vector3D(0.0f, 0.01f, 0.0f));
+}
+
+static Quaternion RandomRotation()
+{
+	Quaternion q(RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f));
+	q.normalize();
+	return q;
+}
+
+static void GenerateEvents(TestEvents& events, int count)
+{
+	RandomSeed(1234);
+	for (int i = 0; i < count; ++i)
+	{
+		const int kind = i % 10;
+		if (kind < 6)
+		{
+			TestInputEvent& ev = events.inputs.append();
+			ev.tick = 1000 + i;
+			ev.steering = RandomFloat(-1.0f, 1.0f);
+			ev.accel = RandomFloat(0.0f, 1.0f);
+			ev.brake = RandomFloat(0.0f, 1.0f);
+			ev.handbrake = RandomInt(0, 4) == 0;
+			ev.buttons = RandomInt(0, 255);
+		}
+		else if (kind < 9)
+		{
+			TestCollisionEvent& ev = events.collisions.append();
+			ev.objectId = RandomInt(0, 2000);
+			ev.position = Vector3D(RandomFloat(-2000.0f, 2000.0f), RandomFloat(0.0f, 50.0f), RandomFloat(-2000.0f, 2000.0f));
+			ev.normal = RandomUnitVector();
+			ev.impulse = RandomFloat(0.0f, 1000.0f);
+			ev.surfaceName = s_surfaceNames[RandomInt(0, elementsOf(s_surfaceNames) - 1)];
+		}
+		else
+		{
+			TestSpawnEvent& ev = events.spawns.append();
+			ev.playerId = RandomInt(0, 31);
+			ev.playerName = EqString::Format("Player_%d", ev.playerId);
+			ev.carName = s_carNames[RandomInt(0, elementsOf(s_carNames) - 1)];
+			ev.position = Vector3D(RandomFloat(-2000.0f, 2000.0f), RandomFloat(0.0f, 50.0f), RandomFloat(-2000.0f, 2000.0f));
+			ev.rotation = RandomRotation();
+			ev.colorIdx = RandomInt(0, 15);
+		}
+	}
+}
+
+//-------------------------------------------------------------
+// byte aligned Buffer encoding, as game code does it now
+
+static void WriteEventsBuffer(Buffer& buffer, const TestEvents& events)
+{
+	for (const TestInputEvent& ev : events.inputs)
+	{
+		buffer.WriteInt(ev.tick);
+		buffer.WriteFloat(ev.steering);
+		buffer.WriteFloat(ev.accel);
+		buffer.WriteFloat(ev.brake);
+		buffer.WriteBool(ev.handbrake);
+		buffer.WriteInt(ev.buttons);
+	}
+
+	for (const TestCollisionEvent& ev : events.collisions)
+	{
+		buffer.WriteInt(ev.objectId);
+		buffer.WriteVector3D(ev.position);
+		buffer.WriteVector3D(ev.normal);
+		buffer.WriteFloat(ev.impulse);
+		buffer.WriteString(ev.surfaceName);
+	}
+
+	for (const TestSpawnEvent& ev : events.spawns)
+	{
+		buffer.WriteInt(ev.playerId);
+		buffer.WriteString(ev.playerName);
+		buffer.WriteString(ev.carName);
+		buffer.WriteVector3D(ev.position);
+		buffer.WriteVector4D(Vector4D(ev.rotation.x, ev.rotation.y, ev.rotation.z, ev.rotation.w));
+		buffer.WriteInt(ev.colorIdx);
+	}
+}
+
+static int ReadEventsBuffer(Buffer& buffer, const TestEvents& events)
+{
+	int checksum = 0;
+	char str[256];
+	for (int i = 0; i < events.inputs.numElem(); ++i)
+	{
+		checksum += buffer.ReadInt();
+		buffer.ReadFloat();
+		buffer.ReadFloat();
+		buffer.ReadFloat();
+		checksum += buffer.ReadBool();
+		checksum += buffer.ReadInt();
+	}
+
+	for (int i = 0; i < events.collisions.numElem(); ++i)
+	{
+		checksum += buffer.ReadInt();
+		buffer.ReadVector3D();
+		buffer.ReadVector3D();
+		buffer.ReadFloat();
+		buffer.ReadString(str);
+		checksum += str[0];
+	}
+
+	for (int i = 0; i < events.spawns.numElem(); ++i)
+	{
+		checksum += buffer.ReadInt();
+		buffer.ReadString(str);
+		checksum += str[0];
+		buffer.ReadString(str);
+		checksum += str[0];
+		buffer.ReadVector3D();
+		buffer.ReadVector4D();
+		checksum += buffer.ReadInt();
+	}
+	return checksum;
+}
+
+//-------------------------------------------------------------
+// bit packed encoding
+
+static void WriteEventsBits(CBitWriter& writer, CNetStringTable& strings, const TestEvents& events)
+{
+	int lastTick = 0;
+	for (const TestInputEvent& ev : events.inputs)
+	{
+		writer.WriteVarInt(ev.tick - lastTick);
+		writer.WriteBoundedFloat(ev.steering, -1.0f, 1.0f, 8);
+		writer.WriteBoundedFloat(ev.accel, 0.0f, 1.0f, 6);
+		writer.WriteBoundedFloat(ev.brake, 0.0f, 1.0f, 6);
+		writer.WriteBool(ev.handbrake);
+		writer.WriteBits(ev.buttons, 8);
+		lastTick = ev.tick;
+	}
+
+	for (const TestCollisionEvent& ev : events.collisions)
+	{
+		writer.WriteVarUInt(ev.objectId);
+		writer.WriteVector3D(ev.position, 0.01f);
+		writer.WriteNormal(ev.normal, 10);
+		writer.WriteBoundedFloat(ev.impulse, 0.0f, 1000.0f, 12);
+		writer.WriteStringRef(strings, ev.surfaceName);
+	}
+
+	for (const TestSpawnEvent& ev : events.spawns)
+	{
+		writer.WriteBits(ev.playerId, 5);
+		writer.WriteStringRef(strings, ev.playerName);
+		writer.WriteStringRef(strings, ev.carName);
+		writer.WriteVector3D(ev.position, 0.01f);
+		writer.WriteQuaternion(ev.rotation, 12);
+		writer.WriteBits(ev.colorIdx, 4);
+	}
+}
+
+static int ReadEventsBits(CBitReader& reader, CNetStringTable& strings, const TestEvents& events)
+{
+	int checksum = 0;
+	int tick = 0;
+	for (int i = 0; i < events.inputs.numElem(); ++i)
+	{
+		tick += reader.ReadVarInt();
+		checksum += tick;
+		reader.ReadBoundedFloat(-1.0f, 1.0f, 8);
+		reader.ReadBoundedFloat(0.0f, 1.0f, 6);
+		reader.ReadBoundedFloat(0.0f, 1.0f, 6);
+		checksum += reader.ReadBool();
+		checksum += reader.ReadBits(8);
+	}
+
+	for (int i = 0; i < events.collisions.numElem(); ++i)
+	{
+		checksum += reader.ReadVarUInt();
+		reader.ReadVector3D(0.01f);
+		reader.ReadNormal(10);
+		reader.ReadBoundedFloat(0.0f, 1000.0f, 12);
+		checksum += reader.ReadStringRef(strings)[0];
+	}
+
+	for (int i = 0; i < events.spawns.numElem(); ++i)
+	{
+		checksum += reader.ReadBits(5);
+		checksum += reader.ReadStringRef(strings)[0];
+		checksum += reader.ReadStringRef(strings)[0];
+		reader.ReadVector3D(0.01f);
+		reader.ReadQuaternion(12);
+		checksum += reader.ReadBits(4);
+	}
+	return checksum;
+}
+
+//-------------------------------------------------------------
+
+TEST(BITSTREAM_TESTS, BitsRoundTrip)
+{
+	ubyte data[128];
+	CBitWriter writer(data, sizeof(data));
+
+	// writes end up crossing the buffer end so both word and byte paths are used
+	RandomSeed(42);
+	uint values[128];
+	int numBits[128];
+	int numValues = 0;
+	while (numValues < elementsOf(values))
+	{
+		numBits[numValues] = RandomInt(1, 32);
+		values[numValues] = uint(RandomInt(0, INT_MAX)) * 2654435761u;
+		if (writer.GetNumBitsWritten() + numBits[numValues] > int(sizeof(data)) * 8)
+			break;
+		writer.WriteBits(values[numValues], numBits[numValues]);
+		++numValues;
+	}
+	EXPECT_FALSE(writer.IsOverflowed());
+
+	CBitReader reader(data, sizeof(data));
+	for (int i = 0; i < numValues; ++i)
+	{
+		const uint mask = numBits[i] == 32 ? ~0u : (1u << numBits[i]) - 1;
+		ASSERT_EQ(reader.ReadBits(numBits[i]), values[i] & mask);
+	}
+	EXPECT_FALSE(reader.IsOverflowed());
+
+	// overflow is reported and does not write past the buffer
+	writer.WriteBits(0xffffffff, 32);
+	writer.WriteBits(0xffffffff, 32);
+	EXPECT_TRUE(writer.IsOverflowed());
+
+	const int signedValues[] = { 0, 1, -1, 63, -64, 1000000, -1000000, INT_MAX, INT_MIN };
+	const uint unsignedValues[] = { 0, 1, 127, 128, 16383, 16384, 0xffffffffu };
+
+	ubyte varData[512];
+	CBitWriter varWriter(varData, sizeof(varData));
+	for (int value : signedValues)
+	{
+		varWriter.WriteVarInt(value);
+		varWriter.WriteIntBits(value);
+		varWriter.WriteInt(value >> 20, 12);
+	}
+	for (uint value : unsignedValues)
+	{
+		varWriter.WriteVarUInt(value);
+		varWriter.WriteUIntBits(value);
+	}
+	EXPECT_FALSE(varWriter.IsOverflowed());
+
+	CBitReader varReader(varData, varWriter.GetNumBytesWritten());
+	for (int value : signedValues)
+	{
+		EXPECT_EQ(varReader.ReadVarInt(), value);
+		EXPECT_EQ(varReader.ReadIntBits(), value);
+		EXPECT_EQ(varReader.ReadInt(12), value >> 20);
+	}
+	for (uint value : unsignedValues)
+	{
+		EXPECT_EQ(varReader.ReadVarUInt(), value);
+		EXPECT_EQ(varReader.ReadUIntBits(), value);
+	}
+	EXPECT_FALSE(varReader.IsOverflowed());
+
+	// small varints take a single byte
+	varWriter.Reset();
+	varWriter.WriteVarInt(-64);
+	EXPECT_EQ(varWriter.GetNumBitsWritten(), 8);
+
+	// reading past the end
+	varReader.ReadBits(32);
+	EXPECT_TRUE(varReader.IsOverflowed());
+}
+
+TEST(BITSTREAM_TESTS, FloatsRoundTrip)
+{
+	ubyte data[4096];
+	CBitWriter writer(data, sizeof(data));
+
+	RandomSeed(7);
+	Vector3D positions[32];
+	Vector3D normals[32];
+	Quaternion rotations[32];
+	float bounded[32];
+	for (int i = 0; i < 32; ++i)
+	{
+		positions[i] = Vector3D(RandomFloat(-5000.0f, 5000.0f), RandomFloat(-5000.0f, 5000.0f), RandomFloat(-5000.0f, 5000.0f));
+		normals[i] = RandomUnitVector();
+		rotations[i] = RandomRotation();
+		bounded[i] = RandomFloat(-20.0f, 20.0f);
+
+		writer.WriteFloat(positions[i].x);
+		writer.WriteVector3D(positions[i], 0.01f);
+		writer.WriteNormal(normals[i], 12);
+		writer.WriteQuaternion(rotations[i], 12);
+		writer.WriteBoundedFloat(bounded[i], -10.0f, 10.0f, 10);
+	}
+
+	// axis aligned normals are the edge cases of octahedral encoding
+	const Vector3D axes[] = { vec3_right, -vec3_right, vec3_up, -vec3_up, vec3_forward, -vec3_forward };
+	for (const Vector3D& axis : axes)
+		writer.WriteNormal(axis, 12);
+
+	EXPECT_FALSE(writer.IsOverflowed());
+
+	CBitReader reader(data, writer.GetNumBytesWritten());
+	for (int i = 0; i < 32; ++i)
+	{
+		EXPECT_EQ(reader.ReadFloat(), positions[i].x);
+
+		const Vector3D position = reader.ReadVector3D(0.01f);
+		for (int j = 0; j < 3; ++j)
+			EXPECT_NEAR(position[j], positions[i][j], 0.005f + 1e-3f);
+
+		// 12 bits per component gives well under half a degree
+		const Vector3D normal = reader.ReadNormal(12);
+		EXPECT_NEAR(length(normal), 1.0f, 1e-4f);
+		EXPECT_GT(dot(normal, normals[i]), cosf(DEG2RAD(0.25f)));
+
+		// q and -q are the same rotation
+		const Quaternion rotation = reader.ReadQuaternion(12);
+		const float qdot = rotation.x * rotations[i].x + rotation.y * rotations[i].y + rotation.z * rotations[i].z + rotation.w * rotations[i].w;
+		EXPECT_GT(fabsf(qdot), 0.9999f);
+
+		EXPECT_NEAR(reader.ReadBoundedFloat(-10.0f, 10.0f, 10), clamp(bounded[i], -10.0f, 10.0f), 20.0f / 1023.0f);
+	}
+
+	for (const Vector3D& axis : axes)
+		EXPECT_GT(dot(reader.ReadNormal(12), axis), 0.99999f);
+
+	EXPECT_FALSE(reader.IsOverflowed());
+}
+
+TEST(BITSTREAM_TESTS, StringTable)
+{
+	ubyte data[1024];
+	CBitWriter writer(data, sizeof(data));
+
+	CNetStringTable writerStrings(4);
+	CNetStringTable readerStrings(4);
+
+	const char* names[] = { "asphalt", "grass", "asphalt", "asphalt", "dirt", "grass", "metal", "wood", "wood", "asphalt" };
+	for (const char* name : names)
+		writer.WriteStringRef(writerStrings, name);
+
+	writer.WriteString("not referenced");
+	EXPECT_FALSE(writer.IsOverflowed());
+
+	// table was filled by first four names, "wood" is sent as literal each time
+	EXPECT_EQ(writerStrings.GetCount(), 4);
+	EXPECT_EQ(writerStrings.Find("wood"), -1);
+
+	CBitReader reader(data, writer.GetNumBytesWritten());
+	for (const char* name : names)
+	{
+		const char* str = reader.ReadStringRef(readerStrings);
+		ASSERT_NE(str, nullptr);
+		EXPECT_STREQ(str, name);
+	}
+	EXPECT_STREQ(reader.ReadString(), "not referenced");
+	EXPECT_FALSE(reader.IsOverflowed());
+
+	for (int i = 0; i < writerStrings.GetCount(); ++i)
+		EXPECT_STREQ(writerStrings.GetString(i), readerStrings.GetString(i));
+
+	// references of a single table entry take 1 + 2 bits
+	writer.Reset();
+	writer.WriteStringRef(writerStrings, "asphalt");
+	EXPECT_EQ(writer.GetNumBitsWritten(), 3);
+
+	// out of table reference
+	CNetStringTable emptyStrings(4);
+	CBitReader badReader(data, writer.GetNumBytesWritten());
+	EXPECT_EQ(badReader.ReadStringRef(emptyStrings), nullptr);
+	EXPECT_TRUE(badReader.IsOverflowed());
+}
+
+TEST(BITSTREAM_TESTS, StringTableOverflow)
+{
+	ubyte data[16];
+	CBitWriter writer(data, sizeof(data));
+
+	CNetStringTable writerStrings(4);
+	CNetStringTable readerStrings(4);
+
+	// string that doesn't fit is not added, otherwise next message would reference it
+	writer.WriteStringRef(writerStrings, "a string longer than message");
+	EXPECT_TRUE(writer.IsOverflowed());
+	EXPECT_EQ(writerStrings.GetCount(), 0);
+
+	writer.Reset();
+	writer.WriteStringRef(writerStrings, "asphalt");
+	EXPECT_FALSE(writer.IsOverflowed());
+	EXPECT_EQ(writerStrings.GetCount(), 1);
+
+	CBitReader reader(data, writer.GetNumBytesWritten());
+	EXPECT_STREQ(reader.ReadStringRef(readerStrings), "asphalt");
+	EXPECT_EQ(readerStrings.GetCount(), 1);
+}
+
+TEST(BITSTREAM_TESTS, EventsSizeAndThroughputVsBuffer)
+{
+	TestEvents events;
+	GenerateEvents(events, s_benchEventCount);
+
+	// byte aligned Buffer
+	Buffer buffer;
+	WriteEventsBuffer(buffer, events);
+	const int bufferSize = buffer.GetMessageLength();
+
+	CEqTimer timer;
+	timer.GetTime(true);
+	int bufferChecksum = 0;
+	for (int i = 0; i < s_benchRepeats; ++i)
+	{
+		buffer.ResetPos();
+		WriteEventsBuffer(buffer, events);
+	}
+	const double bufferWriteTime = timer.GetTime(true);
+
+	for (int i = 0; i < s_benchRepeats; ++i)
+	{
+		buffer.ResetPos();
+		bufferChecksum = ReadEventsBuffer(buffer, events);
+	}
+	const double bufferReadTime = timer.GetTime(true);
+
+	// bit packed
+	Array<ubyte> bitData(PP_SL);
+	bitData.setNum(bufferSize);
+
+	CBitWriter writer(bitData.ptr(), bitData.numElem());
+	int bitsChecksum = 0;
+	for (int i = 0; i < s_benchRepeats; ++i)
+	{
+		CNetStringTable strings;
+		writer.Reset();
+		WriteEventsBits(writer, strings, events);
+	}
+	const double bitsWriteTime = timer.GetTime(true);
+	ASSERT_FALSE(writer.IsOverflowed());
+
+	const int bitsSize = writer.GetNumBytesWritten();
+	for (int i = 0; i < s_benchRepeats; ++i)
+	{
+		CNetStringTable strings;
+		CBitReader reader(bitData.ptr(), bitsSize);
+		bitsChecksum = ReadEventsBits(reader, strings, events);
+		ASSERT_FALSE(reader.IsOverflowed());
+	}
+	const double bitsReadTime = timer.GetTime(true);
+
+	EXPECT_EQ(bitsChecksum, bufferChecksum);
+	EXPECT_LT(bitsSize, bufferSize / 2);
+
+	const int numEvents = events.inputs.numElem() + events.collisions.numElem() + events.spawns.numElem();
+	const double eventsTotal = double(numEvents) * s_benchRepeats;
+
+	Msg("%d events (%d input, %d collision, %d spawn):\n", numEvents, events.inputs.numElem(), events.collisions.numElem(), events.spawns.numElem());
+	Msg("  Buffer:    %d bytes (%.1f per event), write %.1f Mevents/s, read %.1f Mevents/s\n",
+		bufferSize, bufferSize / double(numEvents), eventsTotal / bufferWriteTime / 1e6, eventsTotal / bufferReadTime / 1e6);
+	Msg("  BitStream: %d bytes (%.1f per event), write %.1f Mevents/s, read %.1f Mevents/s\n",
+		bitsSize, bitsSize / double(numEvents), eventsTotal / bitsWriteTime / 1e6, eventsTotal / bitsReadTime / 1e6);
+}
@@ -0,0 +1,234 @@
+#include <gtest/gtest.h>
+
+#include "core/core_common.h"
+#include "core/platform/eqjobmanager.h"
+#include "math/Random.h"
+#include "network/NetSnapshot.h"
+
+using namespace Networking;
+
+static constexpr const int s_benchCarCount = 200;
+static constexpr const int s_benchClientCount = 32;
+static constexpr const int s_benchTicks = 300;
+static constexpr const int s_benchTickRate = 30;
+static constexpr const int s_benchAckLatencyTicks = 3;
+
+struct NetTestCar
+{
+	DECLARE_SIMPLE_DATAMAP();
+
+	Vector3D	position{ 0.0f };
+	Vector3D	velocity{ 0.0f };
+	Vector3D	angles{ 0.0f };
+	float		steering{ 0.0f };
+	int			gear{ 0 };
+	bool		headlights{ false };
+	int			localCounter{ 0 };		// not networked
+};
+
+BEGIN_SIMPLE_DATAMAP(NetTestCar)
+	DEFINE_NETFIELD(position, Vector3D, 0.01f),
+	DEFINE_NETFIELD(velocity, Vector3D, 0.05f),
+	DEFINE_NETFIELD(angles, Angles, 0.1f),
+	DEFINE_NETFIELD(steering, Float, 0.0f),
+	DEFINE_NETFIELD(gear, Int, 0.0f),
+	DEFINE_NETFIELD(headlights, Boolean, 0.0f),
+	DEFINE_FIELD(localCounter, Int),
+END_DATAMAP()
+
+// full precision size when written by hand with Buffer::WriteInt/WriteVector3D etc
+static constexpr const int s_netTestCarFullSize = sizeof(int) + sizeof(Vector3D) * 3 + sizeof(float) + sizeof(int) + sizeof(bool);
+
+static void NetTestCarMove(NetTestCar& car, int carIdx, int tick)
+{
+	const float t = tick / float(s_benchTickRate);
+	const float radius = 20.0f + carIdx * 0.5f;
+	const float speed = 0.2f + (carIdx % 7) * 0.05f;
+
+	car.position = Vector3D(sinf(t * speed) * radius, 0.5f, cosf(t * speed) * radius) + Vector3D(carIdx * 3.0f, 0.0f, 0.0f);
+	car.velocity = Vector3D(cosf(t * speed), 0.0f, -sinf(t * speed)) * radius * speed;
+	car.angles = Vector3D(0.0f, t * speed * 57.2957795f + 90.0f, 0.0f);
+	car.steering = sinf(t + carIdx) * 0.3f;
+	car.gear = 1 + (tick / 60 + carIdx) % 5;
+	car.headlights = (carIdx & 1);
+}
+
+static void ExpectCarsEqual(const NetTestCar& received, const NetTestCar& sent)
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		EXPECT_NEAR(received.position[i], sent.position[i], 0.005f + 1e-4f);
+		EXPECT_NEAR(received.velocity[i], sent.velocity[i], 0.025f + 1e-4f);
+	}
+
+	// compare angles by direction to not care about wrapping
+	EXPECT_NEAR(cosf(DEG2RAD(received.angles.y)), cosf(DEG2RAD(sent.angles.y)), 0.002f);
+	EXPECT_NEAR(sinf(DEG2RAD(received.angles.y)), sinf(DEG2RAD(sent.angles.y)), 0.002f);
+
+	EXPECT_EQ(received.steering, sent.steering);
+	EXPECT_EQ(received.gear, sent.gear);
+	EXPECT_EQ(received.headlights, sent.headlights);
+	EXPECT_EQ(received.localCounter, 0);
+}
+
+TEST(NET_SNAPSHOT_TESTS, SchemaFromDataMap)
+{
+	CNetSnapshotSchema schema(&NetTestCar::m_DataMap);
+
+	EXPECT_EQ(schema.GetFields().numElem(), 6);
+	EXPECT_EQ(schema.GetStateWords(), 3 + 3 + 3 + 1 + 1 + 1);
+	EXPECT_EQ(schema.GetFields()[2].encoding, NETFIELD_ENC_ANGLE);
+	EXPECT_EQ(schema.GetFields()[2].angleBits, 12);
+	EXPECT_EQ(schema.GetFields()[3].encoding, NETFIELD_ENC_FLOAT);
+}
+
+TEST(NET_SNAPSHOT_TESTS, DeltaRoundTrip)
+{
+	CNetSnapshotSchema schema(&NetTestCar::m_DataMap);
+
+	CNetSnapshotServer server;
+	CNetSnapshotClient client;
+	const int schemaIdx = server.AddSchema(&schema);
+	client.AddSchema(&schema);
+
+	NetTestCar cars[16];
+	for (int i = 0; i < elementsOf(cars); ++i)
+	{
+		cars[i].localCounter = i + 1;
+		server.AddEntity(i * 3, schemaIdx, &cars[i]);
+	}
+
+	const int clientIdx = server.AddClient();
+
+	for (int tick = 0; tick < 40; ++tick)
+	{
+		// half of cars are parked
+		for (int i = 0; i < elementsOf(cars); i += 2)
+			NetTestCarMove(cars[i], i, tick);
+
+		if (tick == 20)
+			server.RemoveEntity(3);
+		if (tick == 30)
+			server.AddEntity(3, schemaIdx, &cars[1]);
+
+		const int frame = server.TakeSnapshot();
+		server.BuildClientSnapshots();
+
+		ArrayCRef<ubyte> snapshot = server.GetClientSnapshot(clientIdx);
+		ASSERT_GT(snapshot.numElem(), 0);
+		ASSERT_EQ(client.ReadSnapshot(snapshot.ptr(), snapshot.numElem()), frame);
+
+		// acknowledges of every second snapshot are lost
+		if (tick & 1)
+			server.AckSnapshot(clientIdx, frame);
+
+		const bool removed = tick >= 20 && tick < 30;
+		EXPECT_EQ(client.GetEntityCount(), removed ? elementsOf(cars) - 1 : elementsOf(cars));
+
+		for (int i = 0; i < elementsOf(cars); ++i)
+		{
+			NetTestCar received;
+			const bool present = client.ApplyEntityState(i * 3, &received);
+			if (i == 1 && removed)
+			{
+				EXPECT_FALSE(present);
+				continue;
+			}
+
+			ASSERT_TRUE(present);
+			ExpectCarsEqual(received, cars[i]);
+		}
+	}
+
+	// parked cars are not sent
+	NetTestCarMove(cars[0], 0, 100);
+	const int frame = server.TakeSnapshot();
+	server.BuildClientSnapshots();
+
+	ArrayCRef<ubyte> snapshot = server.GetClientSnapshot(clientIdx);
+	EXPECT_EQ(client.ReadSnapshot(snapshot.ptr(), snapshot.numElem()), frame);
+	EXPECT_LT(snapshot.numElem(), 32);
+}
+
+TEST(NET_SNAPSHOT_TESTS, Bandwidth200Cars32Clients)
+{
+	CNetSnapshotSchema schema(&NetTestCar::m_DataMap);
+
+	CNetSnapshotServer server;
+	const int schemaIdx = server.AddSchema(&schema);
+
+	Array<NetTestCar> cars(PP_SL);
+	cars.setNum(s_benchCarCount);
+	for (int i = 0; i < s_benchCarCount; ++i)
+	{
+		NetTestCarMove(cars[i], i, 0);
+		server.AddEntity(i, schemaIdx, &cars[i]);
+	}
+
+	CNetSnapshotClient clients[s_benchClientCount];
+	int clientIds[s_benchClientCount];
+	for (int i = 0; i < s_benchClientCount; ++i)
+	{
+		clients[i].AddSchema(&schema);
+		clientIds[i] = server.AddClient();
+	}
+
+	CEqJobManager jobMng("snapshotTestJobs", 4, 256);
+
+	// in-memory transport with constant latency of acknowledges
+	int pendingAcks[s_benchAckLatencyTicks][s_benchClientCount];
+	memset(pendingAcks, -1, sizeof(pendingAcks));
+
+	float serialBuildMs = 0.0f;
+	float parallelBuildMs = 0.0f;
+
+	for (int tick = 1; tick <= s_benchTicks; ++tick)
+	{
+		for (int i = 0; i < s_benchCarCount; ++i)
+			NetTestCarMove(cars[i], i, tick);
+
+		int* tickAcks = pendingAcks[tick % s_benchAckLatencyTicks];
+		for (int i = 0; i < s_benchClientCount; ++i)
+		{
+			if (tickAcks[i] != -1)
+				server.AckSnapshot(clientIds[i], tickAcks[i]);
+		}
+
+		const int frame = server.TakeSnapshot();
+
+		// alternate serial and parallel builds to compare
+		const bool parallel = (tick & 1);
+		server.BuildClientSnapshots(parallel ? &jobMng : nullptr);
+		(parallel ? parallelBuildMs : serialBuildMs) += server.GetStats().buildTimeMs;
+
+		for (int i = 0; i < s_benchClientCount; ++i)
+		{
+			ArrayCRef<ubyte> snapshot = server.GetClientSnapshot(clientIds[i]);
+			tickAcks[i] = clients[i].ReadSnapshot(snapshot.ptr(), snapshot.numElem());
+			ASSERT_EQ(tickAcks[i], frame);
+		}
+	}
+
+	for (int i = 0; i < s_benchCarCount; ++i)
+	{
+		NetTestCar received;
+		ASSERT_TRUE(clients[s_benchClientCount - 1].ApplyEntityState(i, &received));
+		ExpectCarsEqual(received, cars[i]);
+	}
+
+	const NetSnapshotStats& stats = server.GetStats();
+	const double bytesPerSnapshot = double(stats.numBytes) / stats.numSnapshots;
+	const double fullBytesPerSnapshot = s_benchCarCount * s_netTestCarFullSize;
+
+	EXPECT_LT(bytesPerSnapshot, fullBytesPerSnapshot * 0.5);
+
+	Msg("Snapshots of %d cars to %d clients at %d Hz, %d ticks:\n", s_benchCarCount, s_benchClientCount, s_benchTickRate, s_benchTicks);
+	Msg("  delta: %.0f bytes/snapshot, %.1f kbit/s per client, %.1f Mbit/s total (%d full snapshots)\n",
+		bytesPerSnapshot, bytesPerSnapshot * 8.0 * s_benchTickRate / 1000.0,
+		bytesPerSnapshot * 8.0 * s_benchTickRate * s_benchClientCount / 1000000.0, (int)stats.numFullUpdates);
+	Msg("  full precision: %.0f bytes/snapshot, %.1f kbit/s per client, %.1f Mbit/s total\n",
+		fullBytesPerSnapshot, fullBytesPerSnapshot * 8.0 * s_benchTickRate / 1000.0,
+		fullBytesPerSnapshot * 8.0 * s_benchTickRate * s_benchClientCount / 1000000.0);
+	Msg("  build time: serial %.3f ms, parallel (%d threads) %.3f ms per tick\n",
+		serialBuildMs / (s_benchTicks / 2), jobMng.GetJobThreadsCount(), parallelBuildMs / (s_benchTicks / 2));
+}
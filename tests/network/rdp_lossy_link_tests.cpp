@@ -0,0 +1,285 @@
+#include <gtest/gtest.h>
+
+#include "core/core_common.h"
+#include "ds/sort.h"
+#include "network/c_udp.h"
+#include "network/LinkSimulator.h"
+
+using namespace Networking;
+using namespace Threading;
+
+static constexpr const int s_lossyLinkPortStart = 29700;
+static constexpr const int s_lossyLinkMessageCount = 400;
+static constexpr const int s_lossyLinkLatencyMs = 20;		// one way
+static constexpr const int s_lossyLinkJitterMs = 4;
+static constexpr const int s_lossyLinkMessagesPerMs = 4;
+static constexpr const float s_lossyLinkTimeout = 20.0f;
+
+struct LossyLinkPacket
+{
+	int		index;
+	double	sendTime;
+	ubyte	payload[180];
+};
+
+// pumps single socket and records arrivals of test packets
+class CLossyLinkPumpThread : public CEqThread
+{
+public:
+	CEqRDPSocket		m_socket;
+	CNetLinkSimulator	m_linkSim;
+	CEqTimer*			m_clock{ nullptr };
+
+	double				m_arrivalTime[s_lossyLinkMessageCount];
+	double				m_latency[s_lossyLinkMessageCount];
+	int					m_numUnique{ 0 };
+	int					m_numDelivered{ 0 };
+	int					m_numFailed{ 0 };
+
+	CLossyLinkPumpThread()
+	{
+		for (int i = 0; i < s_lossyLinkMessageCount; ++i)
+			m_arrivalTime[i] = -1.0;
+	}
+
+	int Run() override
+	{
+		CEqTimer timer;
+		while (!IsTerminating())
+		{
+			m_socket.WaitForEvents(1);
+
+			const int dtMs = timer.GetTimeMS(true);
+			m_socket.UpdateSendQueue(dtMs, OnReceived, this);
+			m_socket.UpdateRecieve(dtMs, OnReceived, this);
+		}
+		return 0;
+	}
+
+	static void OnReceived(void* thisptr, ubyte* data, int size, const sockaddr_in& from, short msgId, ERecvMessageKind type)
+	{
+		CLossyLinkPumpThread* thisThread = (CLossyLinkPumpThread*)thisptr;
+		if (type == RECV_MSG_STATUS)
+		{
+			if (size == DELIVERY_SUCCESS)
+				Atomic::Increment(thisThread->m_numDelivered);
+			else
+				Atomic::Increment(thisThread->m_numFailed);
+			return;
+		}
+
+		if (size != sizeof(LossyLinkPacket))
+			return;
+
+		LossyLinkPacket packet;
+		memcpy(&packet, data, sizeof(packet));
+		if (packet.index < 0 || packet.index >= s_lossyLinkMessageCount || thisThread->m_arrivalTime[packet.index] >= 0.0)
+			return;
+
+		const double arrivalTime = thisThread->m_clock->GetTime();
+		thisThread->m_arrivalTime[packet.index] = arrivalTime;
+		thisThread->m_latency[packet.index] = arrivalTime - packet.sendTime;
+		Atomic::Increment(thisThread->m_numUnique);
+	}
+};
+
+struct LossyLinkResult
+{
+	int				numUnique{ 0 };
+	int				numFailed{ 0 };
+	double			goodputKBs{ 0.0 };
+	double			avgLatencyMs{ 0.0 };
+	double			p95LatencyMs{ 0.0 };
+	NetLinkSimStats	link;		// both directions
+	CDPPeerStats	sender;
+	CDPPeerStats	receiver;
+};
+
+static sockaddr_in LossyLinkLoopbackAddr(int port)
+{
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	return addr;
+}
+
+static LossyLinkResult RunLossyLink(ECDPAckMode ackMode, float lossRate, int runIdx)
+{
+	LossyLinkResult result;
+
+	// each run has own ports so delayed datagrams of previous one don't interfere
+	const int serverPort = s_lossyLinkPortStart + runIdx * 2;
+	const int clientPort = serverPort + 1;
+
+	CEqTimer clock;
+
+	CLossyLinkPumpThread server;
+	CLossyLinkPumpThread client;
+	server.m_clock = &clock;
+	client.m_clock = &clock;
+
+	NetLinkSimParams linkParams;
+	linkParams.lossRate = lossRate;
+	linkParams.latencyMs = s_lossyLinkLatencyMs;
+	linkParams.jitterMs = s_lossyLinkJitterMs;
+	linkParams.seed = 1000 + runIdx * 2;
+	server.m_linkSim.SetParams(linkParams);
+
+	linkParams.seed += 1;
+	client.m_linkSim.SetParams(linkParams);
+
+	for (CLossyLinkPumpThread* pump : { &server, &client })
+	{
+		pump->m_socket.SetAckMode(ackMode);
+		pump->m_socket.SetLinkSimulator(&pump->m_linkSim);
+	}
+
+	if (!server.m_socket.Init(serverPort) || !client.m_socket.Init(clientPort))
+	{
+		ADD_FAILURE() << "failed to init sockets";
+		return result;
+	}
+
+	server.StartThread("LossyLinkServer");
+	client.StartThread("LossyLinkClient");
+
+	const sockaddr_in serverAddr = LossyLinkLoopbackAddr(serverPort);
+	const sockaddr_in clientAddr = LossyLinkLoopbackAddr(clientPort);
+
+	LossyLinkPacket packet;
+	memset(&packet, 0x5a, sizeof(packet));
+
+	clock.GetTime(true);
+	for (int i = 0; i < s_lossyLinkMessageCount; ++i)
+	{
+		packet.index = i;
+		packet.sendTime = clock.GetTime();
+
+		short msgId;
+		client.m_socket.Send((const char*)&packet, sizeof(packet), &serverAddr, msgId, CDPSEND_GUARANTEED | CDPSEND_IMMEDIATE);
+
+		if ((i % s_lossyLinkMessagesPerMs) == s_lossyLinkMessagesPerMs - 1)
+			Platform_Sleep(1);
+	}
+
+	// until every guaranteed datagram is acknowledged or failed
+	while (clock.GetTime() < s_lossyLinkTimeout)
+	{
+		if (client.m_socket.GetSendPoolCount() == 0 && client.m_linkSim.GetDelayedCount() == 0 && server.m_linkSim.GetDelayedCount() == 0)
+			break;
+		Platform_Sleep(1);
+	}
+
+	server.StopThread(false);
+	client.StopThread(false);
+	server.m_socket.Wakeup();
+	client.m_socket.Wakeup();
+	server.WaitForThread();
+	client.WaitForThread();
+
+	// goodput is measured till last unique arrival
+	Array<double> latencies(PP_SL);
+	double lastArrival = 0.0;
+	for (int i = 0; i < s_lossyLinkMessageCount; ++i)
+	{
+		if (server.m_arrivalTime[i] < 0.0)
+			continue;
+
+		lastArrival = max(lastArrival, server.m_arrivalTime[i]);
+		latencies.append(server.m_latency[i] * 1000.0);
+		result.avgLatencyMs += server.m_latency[i] * 1000.0;
+	}
+
+	result.numUnique = server.m_numUnique;
+	result.numFailed = client.m_numFailed;
+
+	if (latencies.numElem())
+	{
+		arraySort(latencies, [](const double a, const double b) { return sortCompare(a, b); });
+		result.avgLatencyMs /= latencies.numElem();
+		result.p95LatencyMs = latencies[latencies.numElem() * 95 / 100];
+		result.goodputKBs = result.numUnique * sizeof(LossyLinkPacket) / 1024.0 / max(lastArrival, 0.001);
+	}
+
+	const NetLinkSimStats serverLink = server.m_linkSim.GetStats();
+	const NetLinkSimStats clientLink = client.m_linkSim.GetStats();
+	result.link.datagrams = serverLink.datagrams + clientLink.datagrams;
+	result.link.bytes = serverLink.bytes + clientLink.bytes;
+	result.link.dropped = serverLink.dropped + clientLink.dropped;
+
+	client.m_socket.GetPeerStats(serverAddr, result.sender);
+	server.m_socket.GetPeerStats(clientAddr, result.receiver);
+
+	client.m_socket.Close();
+	server.m_socket.Close();
+
+	return result;
+}
+
+static void PrintLossyLinkResult(const char* modeName, float lossRate, const LossyLinkResult& result)
+{
+	Msg("  %-11s %2.0f%% loss: %3d/%d delivered, %d failed, goodput %6.1f KB/s, latency avg %5.1f ms p95 %5.1f ms, "
+		"link %5" PRId64 " datagrams %4" PRId64 " KB, %" PRId64 " retransmits, %" PRId64 " acks\n",
+		modeName, lossRate * 100.0f, result.numUnique, s_lossyLinkMessageCount, result.numFailed,
+		result.goodputKBs, result.avgLatencyMs, result.p95LatencyMs,
+		result.link.datagrams, result.link.bytes / 1024, result.sender.retransmits, result.receiver.ackDatagrams);
+}
+
+TEST(RDP_LOSSY_LINK_TESTS, LinkSimulatorIsDeterministic)
+{
+	NetLinkSimParams params;
+	params.lossRate = 0.2f;
+	params.seed = 77;
+
+	CNetLinkSimulator linkA(params);
+	CNetLinkSimulator linkB(params);
+
+	// datagrams to discard port of loopback, only drop pattern matters
+	const sockaddr_in addr = LossyLinkLoopbackAddr(9);
+	const SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+	const ubyte data[16] = { 0 };
+	for (int i = 0; i < 10000; ++i)
+	{
+		linkA.SendTo(sock, data, sizeof(data), addr, 0);
+		linkB.SendTo(sock, data, sizeof(data), addr, 0);
+	}
+	closesocket(sock);
+
+	EXPECT_EQ(linkA.GetStats().dropped, linkB.GetStats().dropped);
+	EXPECT_NEAR(linkA.GetStats().dropped / 10000.0, 0.2, 0.02);
+}
+
+TEST(RDP_LOSSY_LINK_TESTS, SelectiveAcksUnderLoss)
+{
+	ASSERT_TRUE(InitNetworking());
+
+	const float lossRates[] = { 0.01f, 0.05f, 0.20f };
+
+	Msg("%d guaranteed messages of %d bytes, %d ms one way latency, %d ms jitter:\n",
+		s_lossyLinkMessageCount, (int)sizeof(LossyLinkPacket), s_lossyLinkLatencyMs, s_lossyLinkJitterMs);
+
+	int runIdx = 0;
+	for (const float lossRate : lossRates)
+	{
+		const LossyLinkResult perMessage = RunLossyLink(CDP_ACK_PER_MESSAGE, lossRate, runIdx++);
+		const LossyLinkResult selective = RunLossyLink(CDP_ACK_SELECTIVE, lossRate, runIdx++);
+
+		PrintLossyLinkResult("per-message", lossRate, perMessage);
+		PrintLossyLinkResult("selective", lossRate, selective);
+		Msg("  selective: srtt %d ms, rto %d ms, cwnd %.1f, %" PRId64 " fast retransmits, %" PRId64 " timeouts, %" PRId64 " window stalls\n",
+			selective.sender.srttMs, selective.sender.rtoMs, selective.sender.cwnd,
+			selective.sender.fastRetransmits, selective.sender.timeouts, selective.sender.windowStalls);
+
+		// everything arrives and nothing is given up
+		EXPECT_EQ(selective.numUnique, s_lossyLinkMessageCount);
+		EXPECT_EQ(selective.numFailed, 0);
+
+		// no timer driven floods of resends and status datagrams
+		EXPECT_LT(selective.link.datagrams, perMessage.link.datagrams);
+	}
+
+	ShutdownNetworking();
+}
@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+
+#include "core/core_common.h"
+#include "network/c_udp.h"
+#include "network/PacketPool.h"
+
+using namespace Networking;
+using namespace Threading;
+
+static constexpr const int s_sendPoolServerPort = 29620;
+static constexpr const int s_sendPoolClientPortStart = 29630;
+static constexpr const int s_sendPoolClientCount = 64;
+static constexpr const int s_sendPoolRounds = 200;
+
+TEST(PACKET_POOL_TESTS, SliceRefCount)
+{
+	const PacketPoolStats startStats = g_packetPool.GetStats();
+	{
+		PacketSlice packet = g_packetPool.Alloc();
+		ASSERT_TRUE(packet.IsValid());
+		EXPECT_EQ(packet.GetRefCount(), 1);
+		EXPECT_EQ(packet.GetSize(), 0);
+
+		const char data[] = "header_payload";
+		EXPECT_TRUE(packet.Write(data, sizeof(data)));
+		EXPECT_EQ(packet.GetSize(), (int)sizeof(data));
+
+		// fragments share storage with the packet
+		PacketSlice payload = packet.Slice(7, sizeof(data) - 7);
+		EXPECT_EQ(packet.GetRefCount(), 2);
+		EXPECT_EQ(payload.GetData(), packet.GetData() + 7);
+		EXPECT_STREQ((const char*)payload.GetData(), "payload");
+
+		// retransmit copy keeps buffer alive
+		PacketSlice resend = packet;
+		EXPECT_EQ(packet.GetRefCount(), 3);
+
+		packet.Release();
+		EXPECT_FALSE(packet.IsValid());
+		EXPECT_EQ(resend.GetRefCount(), 2);
+		EXPECT_EQ(g_packetPool.GetStats().numUsed, startStats.numUsed + 1);
+
+		PacketSlice moved = std::move(resend);
+		EXPECT_FALSE(resend.IsValid());
+		EXPECT_EQ(moved.GetRefCount(), 2);
+	}
+	EXPECT_EQ(g_packetPool.GetStats().numUsed, startStats.numUsed);
+}
+
+TEST(PACKET_POOL_TESTS, BuffersAreReused)
+{
+	{
+		PacketSlice warmup = g_packetPool.Alloc();
+	}
+	const PacketPoolStats startStats = g_packetPool.GetStats();
+
+	for (int i = 0; i < 10000; ++i)
+	{
+		PacketSlice packet = g_packetPool.Alloc();
+		packet.Write(&i, sizeof(i));
+	}
+
+	const PacketPoolStats stats = g_packetPool.GetStats();
+	EXPECT_EQ(stats.heapAllocs, startStats.heapAllocs);
+	EXPECT_EQ(stats.poolAllocs - startStats.poolAllocs, 10000);
+}
+
+//-----------------------------------------------------------------
+
+// pumps socket in own thread
+class CRDPPumpThread : public CEqThread
+{
+public:
+	Array<CEqRDPSocket*>	m_sockets{ PP_SL };
+	int						m_numReceived{ 0 };
+	int						m_numDelivered{ 0 };
+
+	int Run() override
+	{
+		CEqTimer timer;
+		while (!IsTerminating())
+		{
+			m_sockets[0]->WaitForEvents(1);
+
+			const int dtMs = timer.GetTimeMS(true);
+			for (CEqRDPSocket* socket : m_sockets)
+			{
+				socket->UpdateSendQueue(dtMs, OnReceived, this);
+				socket->UpdateRecieve(dtMs, OnReceived, this);
+			}
+		}
+		return 0;
+	}
+
+	static void OnReceived(void* thisptr, ubyte* data, int size, const sockaddr_in& from, short msgId, ERecvMessageKind type)
+	{
+		CRDPPumpThread* thisThread = (CRDPPumpThread*)thisptr;
+		if (type == RECV_MSG_STATUS)
+		{
+			if (size == DELIVERY_SUCCESS)
+				Atomic::Increment(thisThread->m_numDelivered);
+			return;
+		}
+		Atomic::Increment(thisThread->m_numReceived);
+	}
+};
+
+TEST(PACKET_POOL_TESTS, SendPool64Clients)
+{
+	ASSERT_TRUE(InitNetworking());
+
+	CEqRDPSocket server;
+	ASSERT_TRUE(server.Init(s_sendPoolServerPort));
+
+	CEqRDPSocket clients[s_sendPoolClientCount];
+	sockaddr_in clientAddrs[s_sendPoolClientCount];
+
+	CRDPPumpThread serverThread;
+	CRDPPumpThread clientThread;
+	serverThread.m_sockets.append(&server);
+
+	for (int i = 0; i < s_sendPoolClientCount; ++i)
+	{
+		ASSERT_TRUE(clients[i].Init(s_sendPoolClientPortStart + i));
+		clientThread.m_sockets.append(&clients[i]);
+
+		memset(&clientAddrs[i], 0, sizeof(sockaddr_in));
+		clientAddrs[i].sin_family = AF_INET;
+		clientAddrs[i].sin_port = htons(s_sendPoolClientPortStart + i);
+		clientAddrs[i].sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	}
+
+	serverThread.StartThread("RDPServerPump");
+	clientThread.StartThread("RDPClientPump");
+
+	ubyte payload[96];
+	memset(payload, 0x5a, sizeof(payload));
+
+	CEqTimer timer;
+	for (int round = 0; round < s_sendPoolRounds; ++round)
+	{
+		for (int i = 0; i < s_sendPoolClientCount; ++i)
+		{
+			short msgId;
+			server.Send((const char*)payload, sizeof(payload), &clientAddrs[i], msgId, CDPSEND_GUARANTEED);
+		}
+		Platform_Sleep(1);
+	}
+
+	const int numMessages = s_sendPoolRounds * s_sendPoolClientCount;
+	while ((clientThread.m_numReceived < numMessages || server.GetSendPoolCount() > 0) && timer.GetTime() < 30.0)
+		Platform_Sleep(1);
+
+	const double totalTime = timer.GetTime();
+
+	serverThread.StopThread(false);
+	clientThread.StopThread(false);
+	server.Wakeup();
+	clients[0].Wakeup();
+	serverThread.WaitForThread();
+	clientThread.WaitForThread();
+
+	EXPECT_EQ(clientThread.m_numReceived, numMessages);
+	EXPECT_EQ(server.GetSendPoolCount(), 0);
+
+	CDPSocketStats clientStats;
+	for (int i = 0; i < s_sendPoolClientCount; ++i)
+	{
+		const CDPSocketStats& stats = clients[i].GetStats();
+		clientStats.heapAllocs += stats.heapAllocs;
+		clientStats.recvIdLookups += stats.recvIdLookups;
+		clientStats.recvIdLookupSteps += stats.recvIdLookupSteps;
+	}
+	const CDPSocketStats& serverStats = server.GetStats();
+	const PacketPoolStats poolStats = g_packetPool.GetStats();
+
+	Msg("Send pool at %d clients: %d messages delivered in %.3f s (%.0f msg/sec)\n",
+		s_sendPoolClientCount, clientThread.m_numReceived, totalTime, clientThread.m_numReceived / totalTime);
+	Msg("  heap allocations: server %" PRId64 " (%.0f/sec), clients %" PRId64 " (%.0f/sec)\n",
+		serverStats.heapAllocs, serverStats.heapAllocs / totalTime,
+		clientStats.heapAllocs, clientStats.heapAllocs / totalTime);
+	Msg("  send pool: %" PRId64 " ack lookups, %.2f entries visited per lookup\n",
+		serverStats.ackLookups, serverStats.ackLookups ? double(serverStats.ackLookupSteps) / serverStats.ackLookups : 0.0);
+	Msg("  received ids: %" PRId64 " lookups, %.2f entries visited per lookup\n",
+		clientStats.recvIdLookups, clientStats.recvIdLookups ? double(clientStats.recvIdLookupSteps) / clientStats.recvIdLookups : 0.0);
+	Msg("  packet pool: %" PRId64 " buffers taken, %d peak used, %" PRId64 " heap chunks\n",
+		poolStats.poolAllocs, poolStats.peakUsed, poolStats.heapAllocs);
+
+	for (int i = 0; i < s_sendPoolClientCount; ++i)
+		clients[i].Close();
+	server.Close();
+
+	ShutdownNetworking();
+}
@@ -0,0 +1,289 @@
+#include <gtest/gtest.h>
+
+#include "core/core_common.h"
+#include "network/c_udp.h"
+
+using namespace Networking;
+using namespace Threading;
+
+static constexpr const int s_rdpTestServerPort = 29610;
+static constexpr const int s_rdpTestClientPort = 29611;
+
+static constexpr const int s_roundTripCount = 2000;
+static constexpr const int s_throughputPacketCount = 50000;
+static constexpr const int s_guaranteedMsgCount = 64;
+
+enum ERDPTestPacket : int
+{
+	RDPTEST_PING = 0,
+	RDPTEST_PING_QUEUED,		// echoed through send queue
+	RDPTEST_FLOOD,
+};
+
+struct RDPTestPacket
+{
+	int		type;
+	int		index;
+	ubyte	payload[56];
+};
+
+static sockaddr_in RDPTestLoopbackAddr(int port)
+{
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	return addr;
+}
+
+// echoes ping packets back and counts flood packets
+class CRDPEchoThread : public CEqThread
+{
+public:
+	CEqRDPSocket	m_socket;
+	int				m_floodCount{ 0 };
+
+	int Run() override
+	{
+		CEqTimer timer;
+		while (!IsTerminating())
+		{
+			m_socket.WaitForEvents(10);
+
+			const int dtMs = timer.GetTimeMS(true);
+			m_socket.UpdateSendQueue(dtMs, OnReceived, this);
+			m_socket.UpdateRecieve(dtMs, OnReceived, this);
+		}
+		return 0;
+	}
+
+	static void OnReceived(void* thisptr, ubyte* data, int size, const sockaddr_in& from, short msgId, ERecvMessageKind type)
+	{
+		CRDPEchoThread* thisThread = (CRDPEchoThread*)thisptr;
+		if (type == RECV_MSG_STATUS || size < (int)sizeof(int))
+			return;
+
+		const RDPTestPacket* packet = (const RDPTestPacket*)data;
+		if (packet->type == RDPTEST_FLOOD)
+		{
+			Atomic::Increment(thisThread->m_floodCount);
+			return;
+		}
+
+		const short echoFlags = (packet->type == RDPTEST_PING_QUEUED) ? (CDPSEND_GUARANTEED | CDPSEND_IMMEDIATE) : CDPSEND_IMMEDIATE;
+
+		short echoMsgId;
+		thisThread->m_socket.Send((const char*)data, size, &from, echoMsgId, echoFlags);
+	}
+};
+
+struct RDPTestClient
+{
+	CEqRDPSocket	socket;
+	int				lastEchoIndex{ -1 };
+	Array<short>	deliveredIds{ PP_SL };
+
+	static void OnReceived(void* thisptr, ubyte* data, int size, const sockaddr_in& from, short msgId, ERecvMessageKind type)
+	{
+		RDPTestClient* client = (RDPTestClient*)thisptr;
+		if (type == RECV_MSG_STATUS)
+		{
+			if (size == DELIVERY_SUCCESS)
+				client->deliveredIds.addUnique(msgId);
+			return;
+		}
+
+		const RDPTestPacket* packet = (const RDPTestPacket*)data;
+		client->lastEchoIndex = packet->index;
+	}
+
+	void Update(CEqTimer& timer, int maxWaitMs)
+	{
+		socket.WaitForEvents(maxWaitMs);
+
+		const int dtMs = timer.GetTimeMS(true);
+		socket.UpdateSendQueue(dtMs, OnReceived, this);
+		socket.UpdateRecieve(dtMs, OnReceived, this);
+	}
+};
+
+class RDP_SOCKET_TESTS : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		ASSERT_TRUE(InitNetworking());
+		ASSERT_TRUE(m_server.m_socket.Init(s_rdpTestServerPort));
+		ASSERT_TRUE(m_client.socket.Init(s_rdpTestClientPort));
+
+		m_server.StartThread("RDPEchoServer");
+	}
+
+	void TearDown() override
+	{
+		m_server.StopThread(false);
+		m_server.m_socket.Wakeup();
+		m_server.WaitForThread();
+
+		m_server.m_socket.Close();
+		m_client.socket.Close();
+		ShutdownNetworking();
+	}
+
+	CRDPEchoThread	m_server;
+	RDPTestClient	m_client;
+};
+
+struct RDPTestRoundTrips
+{
+	double	minRtt{ DBL_MAX };
+	double	maxRtt{ 0.0 };
+	double	sumRtt{ 0.0 };
+	double	totalTime{ 0.0 };
+	int		numReceived{ 0 };
+};
+
+// queued packets are sent by UpdateSendQueue in batches (sendmmsg on Linux),
+// immediate unguaranteed ones are sent right away by Send
+static RDPTestRoundTrips RDPTestRunRoundTrips(RDPTestClient& client, ERDPTestPacket type)
+{
+	const sockaddr_in serverAddr = RDPTestLoopbackAddr(s_rdpTestServerPort);
+	const short sendFlags = (type == RDPTEST_PING_QUEUED) ? (CDPSEND_GUARANTEED | CDPSEND_IMMEDIATE) : CDPSEND_IMMEDIATE;
+
+	CEqTimer updateTimer;
+	CEqTimer rttTimer;
+	CEqTimer totalTimer;
+
+	RDPTestRoundTrips result;
+
+	RDPTestPacket packet;
+	memset(&packet, 0, sizeof(packet));
+	packet.type = type;
+
+	client.lastEchoIndex = -1;
+	for (int i = 0; i < s_roundTripCount; ++i)
+	{
+		packet.index = i;
+
+		short msgId;
+		rttTimer.GetTime(true);
+		client.socket.Send((const char*)&packet, sizeof(packet), &serverAddr, msgId, sendFlags);
+
+		while (client.lastEchoIndex != i && rttTimer.GetTime() < 1.0)
+			client.Update(updateTimer, 100);
+
+		if (client.lastEchoIndex != i)
+			continue;
+
+		const double rtt = rttTimer.GetTime();
+		result.minRtt = min(result.minRtt, rtt);
+		result.maxRtt = max(result.maxRtt, rtt);
+		result.sumRtt += rtt;
+		++result.numReceived;
+	}
+
+	result.totalTime = totalTimer.GetTime();
+	return result;
+}
+
+static void RDPTestPrintRoundTrips(const char* name, const RDPTestRoundTrips& result)
+{
+	if (!result.numReceived)
+		return;
+
+	Msg("Round trip (%s): %d packets in %.3f s, avg %.1f us, min %.1f us, max %.1f us, %.0f round trips/sec\n",
+		name, result.numReceived, result.totalTime,
+		result.sumRtt / result.numReceived * 1000000.0, result.minRtt * 1000000.0, result.maxRtt * 1000000.0,
+		result.numReceived / result.totalTime);
+}
+
+TEST_F(RDP_SOCKET_TESTS, LoopbackRoundTrip)
+{
+	const RDPTestRoundTrips queued = RDPTestRunRoundTrips(m_client, RDPTEST_PING_QUEUED);
+	EXPECT_EQ(queued.numReceived, s_roundTripCount);
+
+	// echoes are guaranteed and must be acknowledged too
+	CEqTimer updateTimer;
+	CEqTimer timer;
+	while (m_client.socket.GetSendPoolCount() > 0 && timer.GetTime() < 5.0)
+		m_client.Update(updateTimer, 100);
+	EXPECT_EQ(m_client.socket.GetSendPoolCount(), 0);
+
+	const RDPTestRoundTrips immediate = RDPTestRunRoundTrips(m_client, RDPTEST_PING);
+	EXPECT_EQ(immediate.numReceived, s_roundTripCount);
+
+	RDPTestPrintRoundTrips("send queue", queued);
+	RDPTestPrintRoundTrips("immediate", immediate);
+}
+
+TEST_F(RDP_SOCKET_TESTS, LoopbackThroughput)
+{
+	const sockaddr_in serverAddr = RDPTestLoopbackAddr(s_rdpTestServerPort);
+
+	RDPTestPacket packet;
+	memset(&packet, 0, sizeof(packet));
+	packet.type = RDPTEST_FLOOD;
+
+	CEqTimer timer;
+	for (int i = 0; i < s_throughputPacketCount; ++i)
+	{
+		packet.index = i;
+
+		short msgId;
+		m_client.socket.Send((const char*)&packet, sizeof(packet), &serverAddr, msgId, CDPSEND_IMMEDIATE);
+	}
+	const double sendTime = timer.GetTime();
+
+	// wait until server stops receiving
+	int lastCount = -1;
+	while (lastCount != m_server.m_floodCount)
+	{
+		lastCount = m_server.m_floodCount;
+		Platform_Sleep(50);
+	}
+	const double recvTime = timer.GetTime() - 0.05;
+
+	EXPECT_GT(m_server.m_floodCount, 0);
+
+	Msg("Throughput: sent %d packets at %.0f packets/sec, received %d (%.1f%%) at %.0f packets/sec\n",
+		s_throughputPacketCount, s_throughputPacketCount / sendTime,
+		m_server.m_floodCount, m_server.m_floodCount * 100.0 / s_throughputPacketCount,
+		m_server.m_floodCount / recvTime);
+}
+
+TEST_F(RDP_SOCKET_TESTS, GuaranteedDelivery)
+{
+	const sockaddr_in serverAddr = RDPTestLoopbackAddr(s_rdpTestServerPort);
+
+	RDPTestPacket packet;
+	memset(&packet, 0, sizeof(packet));
+	packet.type = RDPTEST_FLOOD;
+
+	Array<short> sentIds(PP_SL);
+	for (int i = 0; i < s_guaranteedMsgCount; ++i)
+	{
+		packet.index = i;
+
+		short msgId;
+		m_client.socket.Send((const char*)&packet, sizeof(packet), &serverAddr, msgId, CDPSEND_GUARANTEED);
+		sentIds.addUnique(msgId);
+	}
+
+	// resend timer must wake us up, otherwise this takes seconds
+	CEqTimer updateTimer;
+	CEqTimer timer;
+	while (m_client.socket.GetSendPoolCount() > 0 && timer.GetTime() < 5.0)
+		m_client.Update(updateTimer, 1000);
+
+	// status is sent before message is passed to server callback
+	while (Atomic::Load(m_server.m_floodCount) < s_guaranteedMsgCount && timer.GetTime() < 5.0)
+		Platform_Sleep(1);
+
+	EXPECT_EQ(m_client.socket.GetSendPoolCount(), 0);
+	EXPECT_EQ(m_server.m_floodCount, s_guaranteedMsgCount);
+	for (short msgId : sentIds)
+		EXPECT_NE(arrayFindIndex(m_client.deliveredIds, msgId), -1);
+
+	Msg("Guaranteed: %d messages in %d datagrams acknowledged in %.2f ms\n", s_guaranteedMsgCount, sentIds.numElem(), timer.GetTime() * 1000.0);
+}
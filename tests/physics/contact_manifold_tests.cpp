@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+
+#include "core/core_common.h"
+#include "physics_test_utils.h"
+
+static constexpr const float s_manifoldTestDt = 1.0f / 60.0f;
+static constexpr const int s_manifoldSettleSteps = 120;
+static constexpr const int s_manifoldMeasureSteps = 240;
+static constexpr const int s_groundQuads = 4;
+static constexpr const float s_groundQuadSize = 4.0f;
+
+struct ManifoldTestResult
+{
+	int		narrowPhaseTests{ 0 };
+	int		cachedPairs{ 0 };
+	float	maxHeightDeviation{ 0.0f };
+	float	maxSpeed{ 0.0f };
+	float	topHeight{ 0.0f };
+};
+
+// stack of boxes on static triangle mesh ground, each 60 Hz step is split into substeps
+static ManifoldTestResult SimulateBoxStack(int numBoxes, bool contactCache, int substeps = 1)
+{
+	SetPhysicsCVar("ph_contactCache", contactCache ? "1" : "0");
+	SetPhysicsCVar("ph_warmStarting", contactCache ? "1" : "0");
+
+	CEqPhysics physics;
+	physics.InitWorld();
+
+	PhysTestGround ground;
+	ground.Create(physics, s_groundQuads, s_groundQuadSize);
+
+	Array<CEqRigidBody*> boxes(PP_SL);
+	for (int i = 0; i < numBoxes; ++i)
+		boxes.append(PhysTestCreateBox(physics, FVector3D(7.0f, 0.5f + i * 1.0f, 7.0f), FVector3D(0.5f), 100.0f, BODY_NO_AUTO_FREEZE));
+
+	physics.InitGrid();
+
+	ManifoldTestResult result;
+	Array<float> restHeights(PP_SL);
+
+	for (int step = 0; step < s_manifoldSettleSteps + s_manifoldMeasureSteps; ++step)
+	{
+		for (int i = 0; i < substeps; ++i)
+		{
+			physics.SimulateStep(s_manifoldTestDt / substeps, i, nullptr);
+			if (step <= s_manifoldSettleSteps)
+				continue;
+
+			const eqPhysStepStats& stats = physics.GetStepStats();
+			result.narrowPhaseTests += stats.narrowPhaseTests;
+			result.cachedPairs += stats.cachedPairs;
+		}
+
+		if (step == s_manifoldSettleSteps)
+		{
+			for (CEqRigidBody* box : boxes)
+				restHeights.append(box->GetPosition().y);
+		}
+
+		if (step <= s_manifoldSettleSteps)
+			continue;
+
+		for (int i = 0; i < boxes.numElem(); ++i)
+		{
+			result.maxHeightDeviation = max(result.maxHeightDeviation, fabs(static_cast<float>(boxes[i]->GetPosition().y) - restHeights[i]));
+			result.maxSpeed = max(result.maxSpeed, length(boxes[i]->GetLinearVelocity()));
+		}
+	}
+	result.topHeight = boxes.back()->GetPosition().y;
+
+	physics.DestroyGrid();
+	physics.DestroyWorld();
+
+	SetPhysicsCVar("ph_contactCache", "1");
+	SetPhysicsCVar("ph_warmStarting", "1");
+
+	return result;
+}
+
+TEST(CONTACT_MANIFOLD_TESTS, RestingBoxSkipsNarrowPhase)
+{
+	const ManifoldTestResult noCache = SimulateBoxStack(1, false);
+	const ManifoldTestResult cache = SimulateBoxStack(1, true);
+
+	EXPECT_EQ(noCache.cachedPairs, 0);
+	EXPECT_GT(cache.cachedPairs, 0);
+	EXPECT_LT(cache.narrowPhaseTests * 4, noCache.narrowPhaseTests);
+
+	// box still rests on the ground
+	EXPECT_NEAR(cache.topHeight, 0.5f, 0.05f);
+	EXPECT_LT(cache.maxSpeed, 0.5f);
+
+	Msg("resting box: %d narrow phase tests without cache, %d with cache (%d cached)\n", noCache.narrowPhaseTests, cache.narrowPhaseTests, cache.cachedPairs);
+}
+
+TEST(CONTACT_MANIFOLD_TESTS, BoxStackStability)
+{
+	const ManifoldTestResult noCache = SimulateBoxStack(3, false);
+	const ManifoldTestResult cache = SimulateBoxStack(3, true);
+
+	// stack is not collapsed, each contact keeps some penetration under weight
+	EXPECT_NEAR(cache.topHeight, 2.5f, 0.15f);
+	EXPECT_LT(cache.maxHeightDeviation, 0.05f);
+	EXPECT_LE(cache.narrowPhaseTests, noCache.narrowPhaseTests);
+
+	// without warm-starting the same stack jitters or falls apart
+	EXPECT_LT(cache.maxHeightDeviation * 10.0f, noCache.maxHeightDeviation);
+	EXPECT_LT(cache.maxSpeed, noCache.maxSpeed);
+
+	Msg("box stack: height deviation %.4f (no cache %.4f), max speed %.3f (no cache %.3f), narrow phase tests %d (no cache %d)\n",
+		cache.maxHeightDeviation, noCache.maxHeightDeviation, cache.maxSpeed, noCache.maxSpeed, cache.narrowPhaseTests, noCache.narrowPhaseTests);
+}
+
+TEST(CONTACT_MANIFOLD_TESTS, FewerSubstepsForSameStability)
+{
+	const ManifoldTestResult cache = SimulateBoxStack(3, true, 1);
+	const ManifoldTestResult noCache2 = SimulateBoxStack(3, false, 2);
+	const ManifoldTestResult noCache4 = SimulateBoxStack(3, false, 4);
+
+	// stack needs four substeps to stand without warm-starting
+	EXPECT_NEAR(noCache4.topHeight, 2.5f, 0.15f);
+	EXPECT_LT(cache.maxHeightDeviation, noCache2.maxHeightDeviation);
+	EXPECT_LE(cache.maxHeightDeviation, noCache4.maxHeightDeviation);
+	EXPECT_LT(cache.narrowPhaseTests * 4, noCache4.narrowPhaseTests);
+
+	Msg("box stack: height deviation %.4f with cache at 1 substep, no cache %.4f at 2 substeps, %.4f at 4 substeps\n",
+		cache.maxHeightDeviation, noCache2.maxHeightDeviation, noCache4.maxHeightDeviation);
+}
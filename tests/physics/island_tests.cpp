@@ -0,0 +1,235 @@
+#include <gtest/gtest.h>
+
+#include "core/core_common.h"
+#include "core/platform/eqjobmanager.h"
+#include "physics_test_utils.h"
+
+static constexpr const float s_islandTestDt = 1.0f / 60.0f;
+static constexpr const int s_islandSleepSteps = 180;
+
+static constexpr const int s_parkedCarsRows = 40;
+static constexpr const int s_parkedCarsColumns = 50;
+static constexpr const int s_movingCars = 5;
+static constexpr const int s_parkedCarsSettleSteps = 300;
+static constexpr const int s_parkedCarsMeasureSteps = 120;
+static constexpr const float s_parkedCarsSpacing = 6.0f;
+
+static void SimulateSteps(CEqPhysics& physics, int numSteps)
+{
+	for (int i = 0; i < numSteps; ++i)
+		physics.SimulateStep(s_islandTestDt, 0, nullptr);
+}
+
+TEST(ISLAND_TESTS, StackSleepsAndWakesTogether)
+{
+	SetPhysicsCVar("ph_islandSleeping", "1");
+
+	CEqPhysics physics;
+	physics.InitWorld();
+
+	PhysTestGround ground;
+	ground.Create(physics, 4, 4.0f);
+
+	Array<CEqRigidBody*> boxes(PP_SL);
+	for (int i = 0; i < 3; ++i)
+		boxes.append(PhysTestCreateBox(physics, FVector3D(7.0f, 0.5f + i * 1.0f, 7.0f), FVector3D(0.5f), 100.0f));
+
+	physics.InitGrid();
+	SimulateSteps(physics, s_islandSleepSteps);
+
+	EXPECT_EQ(physics.GetStepStats().numAwakeBodies, 0);
+	EXPECT_EQ(physics.GetStepStats().numSleepingBodies, 3);
+	for (CEqRigidBody* box : boxes)
+	{
+		EXPECT_TRUE(box->IsSleeping());
+		EXPECT_TRUE(box->IsFrozen());
+	}
+
+	const float topHeight = boxes.back()->GetPosition().y;
+
+	// sleeping stack is not simulated at all
+	SimulateSteps(physics, 10);
+	EXPECT_EQ(physics.GetStepStats().numIslands, 0);
+	EXPECT_EQ(static_cast<float>(boxes.back()->GetPosition().y), topHeight);
+
+	// waking single body brings whole island back
+	boxes.back()->Wake();
+	EXPECT_EQ(physics.GetStepStats().numSleepingBodies, 3);
+
+	SimulateSteps(physics, 1);
+	EXPECT_EQ(physics.GetStepStats().numWokenIslands, 1);
+	EXPECT_EQ(physics.GetStepStats().numAwakeBodies, 3);
+	EXPECT_EQ(physics.GetStepStats().numIslands, 1);
+	for (CEqRigidBody* box : boxes)
+		EXPECT_FALSE(box->IsSleeping());
+
+	// and it falls asleep again
+	SimulateSteps(physics, s_islandSleepSteps);
+	EXPECT_EQ(physics.GetStepStats().numSleepingBodies, 3);
+
+	// removed body wakes the rest
+	physics.DestroyBody(boxes[0]);
+	SimulateSteps(physics, 1);
+	EXPECT_EQ(physics.GetStepStats().numAwakeBodies, 2);
+	EXPECT_EQ(physics.GetStepStats().numSleepingBodies, 0);
+
+	physics.DestroyWorld();
+}
+
+TEST(ISLAND_TESTS, ImpactWakesSleepingIsland)
+{
+	SetPhysicsCVar("ph_islandSleeping", "1");
+
+	CEqPhysics physics;
+	physics.InitWorld();
+
+	PhysTestGround ground;
+	ground.Create(physics, 4, 4.0f);
+
+	CEqRigidBody* bottom = PhysTestCreateBox(physics, FVector3D(7.0f, 0.5f, 7.0f), FVector3D(0.5f), 100.0f);
+	CEqRigidBody* top = PhysTestCreateBox(physics, FVector3D(7.0f, 1.5f, 7.0f), FVector3D(0.5f), 100.0f);
+
+	physics.InitGrid();
+	SimulateSteps(physics, s_islandSleepSteps);
+	ASSERT_TRUE(bottom->IsSleeping());
+	ASSERT_TRUE(top->IsSleeping());
+
+	// box hits bottom one, top box is woken with it
+	CEqRigidBody* bullet = PhysTestCreateBox(physics, FVector3D(4.0f, 0.5f, 7.0f), FVector3D(0.5f), 100.0f);
+	bullet->SetLinearVelocity(Vector3D(20.0f, 0.0f, 0.0f));
+
+	bool topWoken = false;
+	for (int i = 0; i < 30 && !topWoken; ++i)
+	{
+		SimulateSteps(physics, 1);
+		topWoken = !top->IsSleeping();
+	}
+
+	EXPECT_TRUE(topWoken);
+	EXPECT_FALSE(bottom->IsSleeping());
+	EXPECT_GT(static_cast<float>(bottom->GetPosition().x), 7.0f);
+
+	physics.DestroyWorld();
+}
+
+// separate stacks are independent islands and give same result on job threads
+TEST(ISLAND_TESTS, ParallelIslandsMatchSerial)
+{
+	SetPhysicsCVar("ph_islandSleeping", "1");
+
+	CEqJobManager jobMng("physicsTestJobs", 4, 256);
+
+	Array<FVector3D> results[2]{ PP_SL, PP_SL };
+	for (int parallel = 0; parallel < 2; ++parallel)
+	{
+		SetPhysicsCVar("ph_parallelIslands", parallel ? "1" : "0");
+		SetPhysicsCVar("ph_parallelIslandsMinContacts", "1");
+
+		CEqPhysics physics;
+		physics.InitWorld();
+		physics.SetJobManager(&jobMng);
+
+		PhysTestGround ground;
+		ground.Create(physics, 4, 8.0f);
+
+		Array<CEqRigidBody*> boxes(PP_SL);
+		for (int i = 0; i < 16; ++i)
+		{
+			const FVector3D stackPos(2.0f + (i % 4) * 8.0f, 0.5f, 2.0f + (i / 4) * 8.0f);
+			for (int j = 0; j < 2; ++j)
+				boxes.append(PhysTestCreateBox(physics, stackPos + FVector3D(0.1f * j, 1.1f * j, 0.0f), FVector3D(0.5f), 100.0f, BODY_NO_AUTO_FREEZE));
+		}
+
+		physics.InitGrid();
+		SimulateSteps(physics, 60);
+
+		EXPECT_EQ(physics.GetStepStats().numIslands, 16);
+		EXPECT_EQ(physics.GetStepStats().numSharedIslands, 0);
+
+		for (CEqRigidBody* box : boxes)
+			results[parallel].append(box->GetPosition());
+
+		physics.DestroyWorld();
+	}
+
+	SetPhysicsCVar("ph_parallelIslands", "0");
+	SetPhysicsCVar("ph_parallelIslandsMinContacts", "64");
+
+	ASSERT_EQ(results[0].numElem(), results[1].numElem());
+	for (int i = 0; i < results[0].numElem(); ++i)
+	{
+		EXPECT_EQ(static_cast<float>(results[0][i].x), static_cast<float>(results[1][i].x));
+		EXPECT_EQ(static_cast<float>(results[0][i].y), static_cast<float>(results[1][i].y));
+		EXPECT_EQ(static_cast<float>(results[0][i].z), static_cast<float>(results[1][i].z));
+	}
+}
+
+// parking lot where few cars are driving through
+static double SimulateParkedCars(bool islandSleeping, int& awakeBodies)
+{
+	SetPhysicsCVar("ph_islandSleeping", islandSleeping ? "1" : "0");
+
+	CEqPhysics physics;
+	physics.InitWorld();
+
+	const float lotSize = s_parkedCarsColumns * s_parkedCarsSpacing;
+
+	PhysTestGround ground;
+	ground.Create(physics, 10, lotSize / 10.0f + 2.0f);
+
+	const FVector3D carHalfSize(1.0f, 0.75f, 2.25f);
+	for (int row = 0; row < s_parkedCarsRows; ++row)
+	{
+		for (int col = 0; col < s_parkedCarsColumns; ++col)
+			PhysTestCreateBox(physics, FVector3D(3.0f + col * s_parkedCarsSpacing, 0.75f, 3.0f + row * s_parkedCarsSpacing), carHalfSize, 1500.0f, BODY_ISCAR);
+	}
+
+	// driving along the lot edge
+	Array<CEqRigidBody*> movingCars(PP_SL);
+	for (int i = 0; i < s_movingCars; ++i)
+	{
+		const FVector3D carPos(3.0f + i * 12.0f, 0.75f, lotSize + 3.0f);
+		movingCars.append(PhysTestCreateBox(physics, carPos, carHalfSize, 1500.0f, BODY_ISCAR | BODY_NO_AUTO_FREEZE));
+	}
+
+	physics.InitGrid();
+	SimulateSteps(physics, s_parkedCarsSettleSteps);
+
+	CEqTimer timer;
+	for (int i = 0; i < s_parkedCarsMeasureSteps; ++i)
+	{
+		for (CEqRigidBody* car : movingCars)
+			car->SetLinearVelocity(Vector3D(5.0f, car->GetLinearVelocity().y, 0.0f));
+
+		physics.SimulateStep(s_islandTestDt, 0, nullptr);
+	}
+	const double stepMs = timer.GetTime() * 1000.0 / s_parkedCarsMeasureSteps;
+
+	awakeBodies = physics.GetStepStats().numAwakeBodies;
+	physics.DestroyWorld();
+
+	return stepMs;
+}
+
+// benchmarks are run with --gtest_also_run_disabled_tests
+TEST(ISLAND_TESTS, DISABLED_ParkedCarsBenchmark)
+{
+	int legacyAwake = 0;
+	int islandAwake = 0;
+	const double legacyMs = SimulateParkedCars(false, legacyAwake);
+	const double islandMs = SimulateParkedCars(true, islandAwake);
+
+	SetPhysicsCVar("ph_islandSleeping", "1");
+
+	const int numParked = s_parkedCarsRows * s_parkedCarsColumns;
+
+	// frozen bodies are still visited each step without island sleeping
+	EXPECT_EQ(legacyAwake, numParked + s_movingCars);
+
+	// few cars across ground triangle edges may take longer to settle
+	EXPECT_GE(islandAwake, s_movingCars);
+	EXPECT_LT(islandAwake - s_movingCars, numParked / 100);
+
+	Msg("%d parked cars, %d moving: per body freezing %.3f ms/step, island sleeping %.3f ms/step (%d awake)\n",
+		numParked, s_movingCars, legacyMs, islandMs, islandAwake);
+}
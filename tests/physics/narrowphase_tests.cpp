@@ -0,0 +1,394 @@
+#include <gtest/gtest.h>
+#include <btBulletCollisionCommon.h>
+
+#include "core/core_common.h"
+#include "math/Random.h"
+#include "physics/eqCollision_NarrowPhase.h"
+#include "physics_test_utils.h"
+
+static constexpr const int s_narrowPhaseTestPairs = 2000;
+static constexpr const int s_narrowPhaseBenchmarkRepeats = 20;
+static constexpr const int s_narrowPhaseMeshBenchmarkRepeats = 2;
+static constexpr const float s_narrowPhaseTestMargin = 0.0001f;
+static constexpr const float s_narrowPhaseMarginalDepth = 0.005f;	// contacts this shallow may be reported by either side
+static constexpr const float s_narrowPhaseShallowDepth = 0.1f;		// resting contacts, deeper ones may be resolved along different axis
+
+// records raw contacts the same way as engine manifold result does
+struct NarrowPhaseReferenceResult : public btManifoldResult
+{
+	NarrowPhaseReferenceResult(const btCollisionObjectWrapper* obj0Wrap, const btCollisionObjectWrapper* obj1Wrap)
+		: btManifoldResult(obj0Wrap, obj1Wrap)
+	{
+		m_closestPointDistanceThreshold = 0.0f;
+	}
+
+	void addContactPoint(const btVector3& normalOnBInWorld, const btVector3& pointInWorld, btScalar depth) override
+	{
+		if (depth >= 0.0f || numContacts >= elementsOf(contacts))
+			return;
+
+		const btVector3 pointA = pointInWorld + normalOnBInWorld * depth;
+
+		eqNarrowPhaseContact& contact = contacts[numContacts++];
+		contact.position = Vector3D(pointA.x(), pointA.y(), pointA.z());
+		contact.normal = Vector3D(normalOnBInWorld.x(), normalOnBInWorld.y(), normalOnBInWorld.z());
+		contact.distance = depth;
+	}
+
+	eqNarrowPhaseContact	contacts[64];
+	int						numContacts{ 0 };
+};
+
+struct NarrowPhaseTestPose
+{
+	Matrix3x3	rotation{ identity3 };
+	Vector3D	position{ vec3_zero };
+
+	btTransform ToBullet() const
+	{
+		const btMatrix3x3 basis(
+			rotation.rows[0].x, rotation.rows[0].y, rotation.rows[0].z,
+			rotation.rows[1].x, rotation.rows[1].y, rotation.rows[1].z,
+			rotation.rows[2].x, rotation.rows[2].y, rotation.rows[2].z);
+		return btTransform(basis, btVector3(position.x, position.y, position.z));
+	}
+};
+
+struct NarrowPhaseCompareStats
+{
+	int		numPairs{ 0 };
+	int		numPenetrating{ 0 };		// both report penetration
+	int		numMismatched{ 0 };			// only one reports penetration deeper than marginal
+	int		numNormalsAgree{ 0 };
+	int		numShallow{ 0 };
+	int		numShallowDepthsAgree{ 0 };
+	int		numShallowNormalsAgree{ 0 };
+	float	maxExcessDepth{ 0.0f };			// how much native contact can be deeper than Bullet one
+	double	nativePairsPerSec{ 0.0 };
+	double	bulletPairsPerSec{ 0.0 };
+};
+
+class CNarrowPhaseTester
+{
+public:
+	CNarrowPhaseTester()
+		: m_dispatcher(&m_collConfig)
+	{
+		m_dispatchInfo.m_enableSatConvex = true;
+		m_dispatchInfo.m_stepCount = 1;
+	}
+
+	// runs native and Bullet narrow phase on same poses
+	int Collide(const btCollisionShape* shapeA, const NarrowPhaseTestPose& poseA, const btCollisionShape* shapeB, const NarrowPhaseTestPose& poseB,
+				bool bulletReference, eqNarrowPhaseContact* contacts)
+	{
+		if (bulletReference)
+		{
+			btCollisionObject objA;
+			btCollisionObject objB;
+			objA.setCollisionShape(const_cast<btCollisionShape*>(shapeA));
+			objB.setCollisionShape(const_cast<btCollisionShape*>(shapeB));
+			objA.setWorldTransform(poseA.ToBullet());
+			objB.setWorldTransform(poseB.ToBullet());
+
+			btCollisionObjectWrapper obA(nullptr, shapeA, &objA, objA.getWorldTransform(), -1, -1);
+			btCollisionObjectWrapper obB(nullptr, shapeB, &objB, objB.getWorldTransform(), -1, -1);
+
+			NarrowPhaseReferenceResult result(&obA, &obB);
+
+			btCollisionAlgorithm* algorithm = m_dispatcher.findAlgorithm(&obA, &obB, nullptr, BT_CONTACT_POINT_ALGORITHMS);
+			algorithm->processCollision(&obA, &obB, m_dispatchInfo, &result);
+			algorithm->~btCollisionAlgorithm();
+			m_dispatcher.freeCollisionAlgorithm(algorithm);
+
+			for (int i = 0; i < result.numContacts; ++i)
+				contacts[i] = result.contacts[i];
+			return result.numContacts;
+		}
+
+		// static mesh is always B in native narrow phase
+		if (NarrowPhase_IsSupportedMesh(shapeA))
+		{
+			eqNarrowPhaseShape npShapeB;
+			npShapeB.Init(shapeB, poseB.rotation, poseB.position);
+			return NarrowPhase_CollideMesh(npShapeB, shapeA, poseA.rotation, poseA.position, nullptr, contacts, 64);
+		}
+
+		eqNarrowPhaseShape npShapeA;
+		eqNarrowPhaseShape npShapeB;
+		npShapeA.Init(shapeA, poseA.rotation, poseA.position);
+		npShapeB.Init(shapeB, poseB.rotation, poseB.position);
+		return NarrowPhase_Collide(npShapeA, npShapeB, contacts, 64);
+	}
+
+	NarrowPhaseCompareStats Compare(const btCollisionShape* shapeA, const btCollisionShape* shapeB, const Vector3D& spread, int seed)
+	{
+		CUniformRandomStream random;
+		random.SetSeed(seed);
+
+		Array<NarrowPhaseTestPose> poses(PP_SL);
+		poses.reserve(s_narrowPhaseTestPairs * 2);
+
+		const bool meshA = NarrowPhase_IsSupportedMesh(shapeA);
+		for (int i = 0; i < s_narrowPhaseTestPairs; ++i)
+		{
+			NarrowPhaseTestPose& poseA = poses.append();
+			NarrowPhaseTestPose& poseB = poses.append();
+
+			if (!meshA)
+				poseA.rotation = rotateXYZ3(random.RandomFloat(-M_PI_F, M_PI_F), random.RandomFloat(-M_PI_F, M_PI_F), random.RandomFloat(-M_PI_F, M_PI_F));
+
+			poseB.rotation = rotateXYZ3(random.RandomFloat(-M_PI_F, M_PI_F), random.RandomFloat(-M_PI_F, M_PI_F), random.RandomFloat(-M_PI_F, M_PI_F));
+			poseB.position = Vector3D(random.RandomFloat(-spread.x, spread.x), random.RandomFloat(-spread.y, spread.y), random.RandomFloat(-spread.z, spread.z));
+		}
+
+		NarrowPhaseCompareStats stats;
+		stats.numPairs = s_narrowPhaseTestPairs;
+
+		eqNarrowPhaseContact nativeContacts[64];
+		eqNarrowPhaseContact bulletContacts[64];
+
+		for (int i = 0; i < s_narrowPhaseTestPairs; ++i)
+		{
+			const NarrowPhaseTestPose& poseA = poses[i * 2];
+			const NarrowPhaseTestPose& poseB = poses[i * 2 + 1];
+
+			const int numNative = Collide(shapeA, poseA, shapeB, poseB, false, nativeContacts);
+			const int numBullet = Collide(shapeA, poseA, shapeB, poseB, true, bulletContacts);
+
+			const eqNarrowPhaseContact* deepestNative = GetDeepest(nativeContacts, numNative);
+			const eqNarrowPhaseContact* deepestBullet = GetDeepest(bulletContacts, numBullet);
+
+			if (!deepestNative || !deepestBullet)
+			{
+				const eqNarrowPhaseContact* single = deepestNative ? deepestNative : deepestBullet;
+				if (single && single->distance < -s_narrowPhaseMarginalDepth)
+					++stats.numMismatched;
+				continue;
+			}
+
+			++stats.numPenetrating;
+			if (deepestBullet->distance > -s_narrowPhaseShallowDepth)
+			{
+				// Bullet clips faces also for edge axes and may report deeper point than penetration along the normal
+				++stats.numShallow;
+				if (fabsf(deepestNative->distance - deepestBullet->distance) < s_narrowPhaseMarginalDepth)
+					++stats.numShallowDepthsAgree;
+				stats.maxExcessDepth = max(stats.maxExcessDepth, deepestBullet->distance - deepestNative->distance);
+			}
+
+			// deepest mesh contacts may come from different triangles, any native one can match
+			const int numCompared = meshA ? numNative : 1;
+			for (int j = 0; j < numCompared; ++j)
+			{
+				const eqNarrowPhaseContact& nativeContact = meshA ? nativeContacts[j] : *deepestNative;
+				if (dot(nativeContact.normal, deepestBullet->normal) > 0.9f)
+				{
+					++stats.numNormalsAgree;
+					if (deepestBullet->distance > -s_narrowPhaseShallowDepth)
+						++stats.numShallowNormalsAgree;
+					break;
+				}
+			}
+		}
+
+		// timings are only comparable when physics and Bullet are built with the same configuration,
+		// Bullet box-box detector is on par with native one
+		const int numRepeats = meshA ? s_narrowPhaseMeshBenchmarkRepeats : s_narrowPhaseBenchmarkRepeats;
+		for (int bullet = 0; bullet < 2; ++bullet)
+		{
+			CEqTimer timer;
+			for (int repeat = 0; repeat < numRepeats; ++repeat)
+			{
+				for (int i = 0; i < s_narrowPhaseTestPairs; ++i)
+					Collide(shapeA, poses[i * 2], shapeB, poses[i * 2 + 1], bullet, nativeContacts);
+			}
+
+			const double pairsPerSec = s_narrowPhaseTestPairs * numRepeats / max(timer.GetTime(), 0.000001);
+			(bullet ? stats.bulletPairsPerSec : stats.nativePairsPerSec) = pairsPerSec;
+		}
+
+		return stats;
+	}
+
+private:
+	static const eqNarrowPhaseContact* GetDeepest(const eqNarrowPhaseContact* contacts, int numContacts)
+	{
+		const eqNarrowPhaseContact* deepest = nullptr;
+		for (int i = 0; i < numContacts; ++i)
+		{
+			if (!deepest || contacts[i].distance < deepest->distance)
+				deepest = &contacts[i];
+		}
+		return deepest;
+	}
+
+	btDefaultCollisionConfiguration	m_collConfig;
+	btCollisionDispatcher			m_dispatcher;
+	btDispatcherInfo				m_dispatchInfo;
+};
+
+struct NarrowPhaseTestShapes
+{
+	NarrowPhaseTestShapes()
+		: box(btVector3(0.5f, 0.3f, 0.8f))
+		, sphere(0.4f)
+		, capsule(0.3f, 0.8f)
+	{
+		box.setMargin(s_narrowPhaseTestMargin);
+		box.initializePolyhedralFeatures();
+
+		// truncated pyramid
+		const float hullPoints[][3] = {
+			{-0.6f, -0.4f, -0.6f}, {0.6f, -0.4f, -0.6f}, {0.6f, -0.4f, 0.6f}, {-0.6f, -0.4f, 0.6f},
+			{-0.3f, 0.5f, -0.2f}, {0.3f, 0.5f, -0.2f}, {0.2f, 0.5f, 0.3f}, {-0.2f, 0.5f, 0.3f},
+		};
+		for (const float* point : hullPoints)
+			hull.addPoint(btVector3(point[0], point[1], point[2]), false);
+		hull.recalcLocalAabb();
+		hull.setMargin(s_narrowPhaseTestMargin);
+		hull.initializePolyhedralFeatures();
+
+		// bumpy ground
+		const int gridSize = 4;
+		btVector3 gridVerts[gridSize + 1][gridSize + 1];
+		for (int z = 0; z <= gridSize; ++z)
+		{
+			for (int x = 0; x <= gridSize; ++x)
+				gridVerts[z][x] = btVector3(x - gridSize * 0.5f, ((x + z) & 1) * 0.25f, z - gridSize * 0.5f);
+		}
+
+		for (int z = 0; z < gridSize; ++z)
+		{
+			for (int x = 0; x < gridSize; ++x)
+			{
+				triangles.addTriangle(gridVerts[z][x], gridVerts[z + 1][x], gridVerts[z][x + 1]);
+				triangles.addTriangle(gridVerts[z][x + 1], gridVerts[z + 1][x], gridVerts[z + 1][x + 1]);
+			}
+		}
+		mesh = new btBvhTriangleMeshShape(&triangles, true);
+		mesh->setMargin(s_narrowPhaseTestMargin);
+	}
+
+	~NarrowPhaseTestShapes()
+	{
+		delete mesh;
+	}
+
+	btBoxShape				box;
+	btConvexHullShape		hull;
+	btSphereShape			sphere;
+	btCapsuleShape			capsule;
+	btTriangleMesh			triangles;
+	btBvhTriangleMeshShape*	mesh{ nullptr };
+};
+
+static void CheckAgainstBullet(const char* pairName, const btCollisionShape* shapeA, const btCollisionShape* shapeB, const Vector3D& spread, float depthTolerance, int normalsAgreePercent = 95)
+{
+	CNarrowPhaseTester tester;
+	const NarrowPhaseCompareStats stats = tester.Compare(shapeA, shapeB, spread, 1337);
+
+	// enough of configurations must actually intersect
+	EXPECT_GT(stats.numPenetrating, stats.numPairs / 10) << pairName;
+	EXPECT_LT(stats.numMismatched, stats.numPairs / 100) << pairName;
+	EXPECT_GT(stats.numShallow, 0) << pairName;
+	// rest are edge contacts of hulls where Bullet reports deeper clipped points
+	EXPECT_GE(stats.numShallowDepthsAgree, stats.numShallow * 60 / 100) << pairName;
+	EXPECT_LT(stats.maxExcessDepth, depthTolerance) << pairName;
+	EXPECT_GE(stats.numNormalsAgree, stats.numPenetrating * normalsAgreePercent / 100) << pairName;
+	EXPECT_GE(stats.numShallowNormalsAgree, stats.numShallow * 95 / 100) << pairName;
+
+	Msg("%s: %d penetrating, %d mismatched, normals agree %d (%d shallow), depths agree %d of %d shallow (max excess %.4f); native %.0f pairs/sec, Bullet %.0f pairs/sec\n",
+		pairName, stats.numPenetrating, stats.numMismatched, stats.numNormalsAgree, stats.numShallowNormalsAgree, stats.numShallowDepthsAgree, stats.numShallow, stats.maxExcessDepth,
+		stats.nativePairsPerSec, stats.bulletPairsPerSec);
+}
+
+TEST(NARROWPHASE_TESTS, ConvexPairsMatchBullet)
+{
+	NarrowPhaseTestShapes shapes;
+	const Vector3D spread(1.2f);
+
+	CheckAgainstBullet("box-box", &shapes.box, &shapes.box, spread, 0.02f);
+	CheckAgainstBullet("hull-box", &shapes.hull, &shapes.box, spread, 0.02f);
+	CheckAgainstBullet("hull-hull", &shapes.hull, &shapes.hull, spread, 0.02f);
+	CheckAgainstBullet("sphere-box", &shapes.sphere, &shapes.box, spread, 0.02f);
+	CheckAgainstBullet("sphere-hull", &shapes.sphere, &shapes.hull, spread, 0.02f);
+	CheckAgainstBullet("capsule-box", &shapes.capsule, &shapes.box, spread, 0.02f);
+	CheckAgainstBullet("sphere-capsule", &shapes.sphere, &shapes.capsule, spread, 0.02f);
+}
+
+TEST(NARROWPHASE_TESTS, MeshPairsMatchBullet)
+{
+	NarrowPhaseTestShapes shapes;
+	const Vector3D spread(1.5f, 0.6f, 1.5f);
+
+	// Bullet resolves deep hull penetrations of single triangles along arbitrary axes
+	CheckAgainstBullet("mesh-box", shapes.mesh, &shapes.box, spread, 0.02f);
+	CheckAgainstBullet("mesh-hull", shapes.mesh, &shapes.hull, spread, 0.02f, 90);
+	CheckAgainstBullet("mesh-sphere", shapes.mesh, &shapes.sphere, spread, 0.02f);
+	CheckAgainstBullet("mesh-capsule", shapes.mesh, &shapes.capsule, spread, 0.02f);
+}
+
+TEST(NARROWPHASE_TESTS, ContactReductionKeepsDeepest)
+{
+	eqNarrowPhaseContact contacts[8];
+	for (int i = 0; i < elementsOf(contacts); ++i)
+	{
+		const float angle = i * (M_PI_F * 2.0f / elementsOf(contacts));
+		contacts[i].position = Vector3D(cosf(angle), 0.0f, sinf(angle));
+		contacts[i].normal = vec3_up;
+		contacts[i].distance = -0.01f;
+	}
+	contacts[5].distance = -0.1f;
+
+	const int numContacts = NarrowPhase_ReduceContacts(contacts, elementsOf(contacts));
+	ASSERT_EQ(numContacts, NARROWPHASE_MAX_FACE_CONTACTS);
+
+	float deepest = 0.0f;
+	for (int i = 0; i < numContacts; ++i)
+		deepest = min(deepest, contacts[i].distance);
+	EXPECT_EQ(deepest, -0.1f);
+}
+
+static float SimulateRestingBox(bool nativeNarrowPhase, int& nativeTests)
+{
+	SetPhysicsCVar("ph_nativeNarrowPhase", nativeNarrowPhase ? "1" : "0");
+
+	CEqPhysics physics;
+	physics.InitWorld();
+
+	PhysTestGround ground;
+	ground.Create(physics, 4, 4.0f);
+
+	CEqRigidBody* box = PhysTestCreateBox(physics, FVector3D(7.0f, 0.6f, 7.0f), FVector3D(0.5f), 100.0f, BODY_NO_AUTO_FREEZE);
+	CEqRigidBody* topBox = PhysTestCreateBox(physics, FVector3D(7.2f, 1.7f, 7.0f), FVector3D(0.5f), 100.0f, BODY_NO_AUTO_FREEZE);
+
+	physics.InitGrid();
+
+	nativeTests = 0;
+	for (int i = 0; i < 120; ++i)
+	{
+		physics.SimulateStep(1.0f / 60.0f, 0, nullptr);
+		nativeTests += physics.GetStepStats().nativeNarrowPhaseTests;
+	}
+
+	const float height = box->GetPosition().y + topBox->GetPosition().y;
+	physics.DestroyWorld();
+
+	SetPhysicsCVar("ph_nativeNarrowPhase", "1");
+
+	return height;
+}
+
+TEST(NARROWPHASE_TESTS, BoxStackMatchesBullet)
+{
+	int nativeTests = 0;
+	int bulletNativeTests = 0;
+	const float nativeHeight = SimulateRestingBox(true, nativeTests);
+	const float bulletHeight = SimulateRestingBox(false, bulletNativeTests);
+
+	EXPECT_GT(nativeTests, 0);
+	EXPECT_EQ(bulletNativeTests, 0);
+	EXPECT_NEAR(nativeHeight, 2.0f, 0.1f);
+	EXPECT_NEAR(nativeHeight, bulletHeight, 0.05f);
+}
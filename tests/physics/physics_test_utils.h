@@ -0,0 +1,70 @@
+#pragma once
+
+#include "core/IConsoleCommands.h"
+#include "core/ConVar.h"
+#include "physics/eqPhysics.h"
+#include "physics/eqPhysics_Body.h"
+#include "physics/eqBulletIndexedMesh.h"
+
+inline void SetPhysicsCVar(const char* name, const char* value)
+{
+	ConVar* cvar = (ConVar*)g_consoleCommands->FindCvar(name);
+	ASSERT(cvar);
+	cvar->SetValue(value);
+}
+
+// flat static triangle mesh ground at Y = 0 starting from origin
+struct PhysTestGround
+{
+	Array<Vector3D>			verts{ PP_SL };
+	Array<int>				indices{ PP_SL };
+	CEqBulletIndexedMesh*	mesh{ nullptr };
+
+	~PhysTestGround()
+	{
+		delete mesh;
+	}
+
+	void Create(CEqPhysics& physics, int numQuads, float quadSize)
+	{
+		for (int z = 0; z <= numQuads; ++z)
+		{
+			for (int x = 0; x <= numQuads; ++x)
+				verts.append(Vector3D(x * quadSize, 0.0f, z * quadSize));
+		}
+
+		for (int z = 0; z < numQuads; ++z)
+		{
+			for (int x = 0; x < numQuads; ++x)
+			{
+				const int v0 = z * (numQuads + 1) + x;
+				const int v1 = v0 + 1;
+				const int v2 = v0 + numQuads + 1;
+				const int v3 = v2 + 1;
+
+				indices.append(v0); indices.append(v2); indices.append(v1);
+				indices.append(v1); indices.append(v2); indices.append(v3);
+			}
+		}
+
+		mesh = new CEqBulletIndexedMesh(reinterpret_cast<ubyte*>(verts.ptr()), sizeof(Vector3D),
+			reinterpret_cast<ubyte*>(indices.ptr()), sizeof(int), verts.numElem(), indices.numElem());
+		mesh->AddSubpart(0, indices.numElem(), 0, verts.numElem(), -1);
+
+		CEqCollisionObject* ground = PPNew CEqCollisionObject();
+		ground->Initialize(mesh, false);
+		physics.AddStaticObject(ground);
+	}
+};
+
+inline CEqRigidBody* PhysTestCreateBox(CEqPhysics& physics, const FVector3D& position, const FVector3D& halfSize, float mass, int flags = 0)
+{
+	CEqRigidBody* box = PPNew CEqRigidBody();
+	box->Initialize(-halfSize, halfSize);
+	box->SetMass(mass);
+	box->SetPosition(position);
+	box->m_flags |= flags;
+
+	physics.AddToWorld(box);
+	return box;
+}
@@ -0,0 +1,18 @@
+#include <gtest/gtest.h>
+
+#include "core/core_common.h"
+#include "tests_common.h"
+
+class IDebugOverlay;
+IDebugOverlay* debugoverlay = nullptr;
+
+int main(int argc, char** argv)
+{
+	TestAppWrapper test(false, "physics_tests", argc, argv);
+	testing::InitGoogleTest(&argc, argv);
+
+	// you can specify flags before running
+	//::testing::FLAGS_gtest_filter = "CONTACT_MANIFOLD_TESTS.*";
+
+	return RUN_ALL_TESTS();
+}
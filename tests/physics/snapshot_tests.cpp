@@ -0,0 +1,168 @@
+#include <gtest/gtest.h>
+
+#include "core/core_common.h"
+#include "physics_test_utils.h"
+#include "physics/eqPhysics_Snapshot.h"
+
+static constexpr const float s_snapshotTestDt = 1.0f / 60.0f;
+static constexpr const int s_snapshotTotalSteps = 300;
+static constexpr const int s_snapshotRollbackSteps = 30;
+static constexpr const int s_snapshotSettleSteps = 720;
+
+// stacks, falling and spinning boxes, and one box pushed by input
+struct SnapshotTestWorld
+{
+	CEqPhysics				physics;
+	PhysTestGround			ground;
+	Array<CEqRigidBody*>	boxes{ PP_SL };
+	CEqRigidBody*			player{ nullptr };
+
+	void Create()
+	{
+		physics.InitWorld();
+		ground.Create(physics, 4, 8.0f);
+
+		for (int i = 0; i < 4; ++i)
+		{
+			for (int j = 0; j < 3; ++j)
+				boxes.append(PhysTestCreateBox(physics, FVector3D(6.0f + i * 6.0f, 0.5f + j * 1.05f, 10.0f), FVector3D(0.5f), 100.0f));
+		}
+
+		// resting stack which never sleeps uses cached contacts
+		for (int j = 0; j < 3; ++j)
+			boxes.append(PhysTestCreateBox(physics, FVector3D(16.0f, 0.5f + j * 1.05f, 26.0f), FVector3D(0.5f), 100.0f, BODY_NO_AUTO_FREEZE));
+
+		for (int i = 0; i < 6; ++i)
+		{
+			CEqRigidBody* box = PhysTestCreateBox(physics, FVector3D(4.0f + i * 4.0f, 3.0f + i * 0.5f, 20.0f), FVector3D(0.4f, 0.3f, 0.6f), 50.0f);
+			box->SetOrientation(Quaternion(rotateXYZ3(0.3f * i, 0.2f, 0.1f * i)));
+			box->SetAngularVelocity(Vector3D(1.0f, 2.0f * i, 0.5f));
+			boxes.append(box);
+		}
+
+		player = PhysTestCreateBox(physics, FVector3D(2.0f, 0.5f, 10.0f), FVector3D(0.5f), 200.0f, BODY_NO_AUTO_FREEZE);
+		boxes.append(player);
+
+		physics.InitGrid();
+	}
+
+	void Step(int stepIndex)
+	{
+		// runs into stacks at the end, some of them are asleep by then
+		const float speed = stepIndex > 200 ? 12.0f : 0.0f;
+		player->SetLinearVelocity(Vector3D(speed, player->GetLinearVelocity().y, 0.0f));
+
+		physics.SimulateStep(s_snapshotTestDt, 0, nullptr);
+	}
+
+	void GetStates(Array<eqRigidBodyState>& states) const
+	{
+		states.clear(false);
+		for (const CEqRigidBody* box : boxes)
+		{
+			eqRigidBodyState& state = states.append();
+			memset(&state, 0, sizeof(state));
+			box->GetState(state);
+		}
+	}
+};
+
+TEST(SNAPSHOT_TESTS, RollbackResimulateIsBitExact)
+{
+	SetPhysicsCVar("ph_islandSleeping", "1");
+
+	SnapshotTestWorld world;
+	world.Create();
+
+	eqPhysSnapshot rollbackSnapshot;
+	for (int i = 0; i < s_snapshotTotalSteps; ++i)
+	{
+		if (i == s_snapshotTotalSteps - s_snapshotRollbackSteps)
+			world.physics.SaveSnapshot(rollbackSnapshot);
+		world.Step(i);
+	}
+
+	EXPECT_GT(world.physics.GetStepStats().numSleepingBodies, 0);
+	EXPECT_GT(world.physics.GetStepStats().numManifolds, 0);
+
+	Array<eqRigidBodyState> expected(PP_SL);
+	world.GetStates(expected);
+
+	eqPhysSnapshot expectedSnapshot;
+	world.physics.SaveSnapshot(expectedSnapshot);
+
+	// rollback and resimulate
+	ASSERT_TRUE(world.physics.RestoreSnapshot(rollbackSnapshot));
+	for (int i = s_snapshotTotalSteps - s_snapshotRollbackSteps; i < s_snapshotTotalSteps; ++i)
+		world.Step(i);
+
+	Array<eqRigidBodyState> resimulated(PP_SL);
+	world.GetStates(resimulated);
+
+	ASSERT_EQ(expected.numElem(), resimulated.numElem());
+	for (int i = 0; i < expected.numElem(); ++i)
+	{
+		EXPECT_EQ(expected[i].position.x.raw, resimulated[i].position.x.raw);
+		EXPECT_EQ(expected[i].position.y.raw, resimulated[i].position.y.raw);
+		EXPECT_EQ(expected[i].position.z.raw, resimulated[i].position.z.raw);
+		EXPECT_EQ(memcmp(&expected[i], &resimulated[i], sizeof(eqRigidBodyState)), 0) << "body " << i;
+	}
+
+	// including contact manifolds and islands
+	eqPhysSnapshot resimulatedSnapshot;
+	world.physics.SaveSnapshot(resimulatedSnapshot);
+
+	ASSERT_EQ(expectedSnapshot.data.numElem(), resimulatedSnapshot.data.numElem());
+	EXPECT_EQ(memcmp(expectedSnapshot.data.ptr(), resimulatedSnapshot.data.ptr(), expectedSnapshot.data.numElem()), 0);
+
+	world.physics.DestroyWorld();
+}
+
+TEST(SNAPSHOT_TESTS, DeltaSnapshotRoundTrip)
+{
+	SetPhysicsCVar("ph_islandSleeping", "1");
+
+	SnapshotTestWorld world;
+	world.Create();
+
+	// player stays until most of the bodies fall asleep
+	for (int i = 0; i < s_snapshotSettleSteps; ++i)
+		world.Step(0);
+
+	eqPhysSnapshot base;
+	world.physics.SaveSnapshot(base);
+
+	world.Step(s_snapshotTotalSteps);
+
+	eqPhysSnapshot current;
+	world.physics.SaveSnapshot(current);
+
+	eqPhysSnapshot delta;
+	PhysSnapshot_MakeDelta(base, current, delta);
+	EXPECT_TRUE(delta.IsDelta());
+	EXPECT_EQ(delta.GetStepIndex(), current.GetStepIndex());
+
+	// sleeping bodies and their manifolds are not stored
+	EXPECT_GT(world.physics.GetStepStats().numSleepingBodies, world.boxes.numElem() / 2);
+	EXPECT_LT(delta.GetHeader()->numStoredBodies, world.boxes.numElem() / 2);
+	EXPECT_LT(delta.data.numElem() * 3, current.data.numElem());
+
+	eqPhysSnapshot restored;
+	ASSERT_TRUE(PhysSnapshot_ApplyDelta(base, delta, restored));
+	ASSERT_EQ(restored.data.numElem(), current.data.numElem());
+	EXPECT_EQ(memcmp(restored.data.ptr(), current.data.ptr(), current.data.numElem()), 0);
+
+	// snapshot from delta is restored as full one
+	world.Step(s_snapshotTotalSteps + 1);
+	ASSERT_TRUE(world.physics.RestoreSnapshot(restored));
+
+	eqPhysSnapshot again;
+	world.physics.SaveSnapshot(again);
+	ASSERT_EQ(again.data.numElem(), current.data.numElem());
+	EXPECT_EQ(memcmp(again.data.ptr(), current.data.ptr(), current.data.numElem()), 0);
+
+	Msg("snapshot of %d bodies is %d bytes, delta is %d bytes (%d bodies)\n",
+		world.boxes.numElem(), current.data.numElem(), delta.data.numElem(), delta.GetHeader()->numStoredBodies);
+
+	world.physics.DestroyWorld();
+}
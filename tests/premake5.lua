@@ -32,6 +32,19 @@ project "ds_tests"
 		"ds/*.h"
 	}
 
+project "core_tests"
+    kind "ConsoleApp"
+	unitybuild "on"
+    uses {
+		"corelib", "frameworkLib", 
+		"e2Core", 
+		"testsCommonLib",
+	}
+    files {
+		"core/*.cpp",
+		"core/*.h"
+	}
+
 project "scripting_tests"
     kind "ConsoleApp"
 	unitybuild "on"
@@ -46,3 +59,84 @@ project "scripting_tests"
 		"scripting/*.cpp",
 		"scripting/*.h"
 	}
+
+project "network_tests"
+    kind "ConsoleApp"
+	unitybuild "on"
+    uses {
+		"corelib", "frameworkLib", 
+		"e2Core", 
+		"testsCommonLib",
+		"networkLib",
+		"shared_engine"
+	}
+    files {
+		"network/*.cpp",
+		"network/*.h"
+	}
+
+project "physics_tests"
+    kind "ConsoleApp"
+	unitybuild "on"
+    uses {
+		"corelib", "frameworkLib", 
+		"e2Core", 
+		"testsCommonLib",
+		"physicsLib",
+		"bullet2",
+		"shared_engine"
+	}
+    files {
+		"physics/*.cpp",
+		"physics/*.h"
+	}
+
+project "render_tests"
+    kind "ConsoleApp"
+	unitybuild "on"
+    uses {
+		"corelib", "frameworkLib", 
+		"e2Core", 
+		"testsCommonLib",
+		"renderUtilLib",
+		"fontLib",
+		"shared_engine"
+	}
+    files {
+		"render/*.cpp",
+		"render/*.h"
+	}
+
+project "dpk_tests"
+    kind "ConsoleApp"
+	unitybuild "on"
+    uses {
+		"corelib", "frameworkLib", 
+		"e2Core", 
+		"testsCommonLib",
+		"dpkLib",
+	}
+    files {
+		"dpk/*.cpp",
+		"dpk/*.h"
+	}
+
+project "studio_tests"
+    kind "ConsoleApp"
+	unitybuild "on"
+    uses {
+		"corelib", "frameworkLib", 
+		"e2Core", 
+		"testsCommonLib",
+		"studioFileLib",
+		"shared_engine"
+	}
+    files {
+		"studio/*.cpp",
+		"studio/*.h",
+
+		-- tested without material system
+		"../shared_engine/studio/StudioGeomBVH.cpp",
+		"../shared_engine/studio/StudioGeomDecal.cpp",
+		"../shared_engine/studio/StudioVertex.cpp",
+	}
@@ -0,0 +1,225 @@
+#include <gtest/gtest.h>
+
+#include "core/core_common.h"
+#include "render/RenderDrawBucket.h"
+#include "render_test_utils.h"
+
+static const VertexLayoutDesc s_testVertexLayout[] = {
+	Builder<VertexLayoutDesc>()
+		.Stride(16)
+		.Attribute(VERTEXATTRIB_POSITION, "position", 0, 0, ATTRIBUTEFORMAT_FLOAT, 4)
+		.End()
+};
+
+// shader names are compared by pointer
+static const char* s_testShader1 = "shader1";
+static const char* s_testShader2 = "shader2";
+
+struct DrawBucketTestScene
+{
+	RenderTestMaterial	materials[4]{
+		{ "matA", s_testShader1 },
+		{ "matB", s_testShader1 },
+		{ "matC", s_testShader2 },
+		{ "matD", s_testShader2 },
+	};
+	IGPUBufferPtr		vertexBuffers[2];
+	IGPUBufferPtr		indexBuffer;
+
+	DrawBucketTestScene()
+	{
+		for (IGPUBufferPtr& buffer : vertexBuffers)
+			buffer = IGPUBufferPtr(PPNew RenderTestBuffer(1024));
+		indexBuffer = IGPUBufferPtr(PPNew RenderTestBuffer(512));
+	}
+
+	RenderDrawCmd MakeDrawCmd(int materialIdx, int bufferIdx, int firstIndex) const
+	{
+		RenderDrawCmd drawCmd;
+		drawCmd.instanceInfo.instFormat.formatId = 1;
+		drawCmd.instanceInfo.instFormat.layout = ArrayCRef<VertexLayoutDesc>(s_testVertexLayout, elementsOf(s_testVertexLayout));
+		drawCmd.SetMaterial(const_cast<RenderTestMaterial*>(&materials[materialIdx]));
+		drawCmd.SetVertexBuffer(0, vertexBuffers[bufferIdx]);
+		drawCmd.SetIndexBuffer(indexBuffer, INDEXFMT_UINT16);
+		drawCmd.SetDrawIndexed(PRIM_TRIANGLES, 3, firstIndex);
+		return drawCmd;
+	}
+};
+
+// replays state tracking the way IMaterialSystem::SetupDrawCommands does
+static RenderDrawStats DrawBucketReplayStates(ArrayCRef<const RenderDrawCmd*> drawCmds)
+{
+	RenderDrawStats stats;
+	RenderDrawStateCache stateCache;
+	for (const RenderDrawCmd* drawCmd : drawCmds)
+	{
+		const uint layoutBits = drawCmd->instanceInfo.instFormat.usedLayoutBits;
+		if (stateCache.NeedPipelineSetup(*drawCmd, layoutBits))
+		{
+			// pipeline objects are unique per shader in this test
+			const IGPURenderPipeline* pipeline = reinterpret_cast<const IGPURenderPipeline*>(drawCmd->batchInfo.material->GetShaderName());
+			stateCache.SetPipeline(*drawCmd, layoutBits, pipeline, stats);
+		}
+
+		stateCache.SetVertexBuffer(0, drawCmd->instanceInfo.vertexBuffers[0], stats);
+		stateCache.SetIndexBuffer(drawCmd->instanceInfo.indexBuffer, drawCmd->instanceInfo.indexFormat, stats);
+		++stats.numDraws;
+	}
+	return stats;
+}
+
+TEST(DRAW_BUCKET_TESTS, SortKeyOrdering)
+{
+	DrawBucketTestScene scene;
+	CRenderDrawBucket bucket;
+	bucket.SetMaxDepth(100.0f);
+
+	// interleaved materials, buffers and depths
+	for (int i = 0; i < 64; ++i)
+	{
+		const float depth = float((i * 37) % 64);
+		bucket.AddDrawCmd(scene.MakeDrawCmd(i % 4, (i / 4) % 2, i * 3), depth, 0);
+	}
+	bucket.AddDrawCmd(scene.MakeDrawCmd(0, 0, 1000), 1.0f, 1);
+	bucket.Sort();
+
+	ArrayCRef<const RenderDrawCmd*> drawCmds = bucket.GetPassDrawCmds(0);
+	ASSERT_EQ(drawCmds.numElem(), 64);
+
+	// each shader, material and buffer combination is contiguous
+	int numShaderChanges = 0;
+	int numMaterialChanges = 0;
+	int numStateChanges = 0;
+	for (int i = 1; i < drawCmds.numElem(); ++i)
+	{
+		const RenderDrawCmd& prev = *drawCmds[i - 1];
+		const RenderDrawCmd& cur = *drawCmds[i];
+
+		if (prev.batchInfo.material->GetShaderName() != cur.batchInfo.material->GetShaderName())
+			++numShaderChanges;
+		if (prev.batchInfo.material != cur.batchInfo.material)
+			++numMaterialChanges;
+		if (prev.batchInfo.material != cur.batchInfo.material || prev.instanceInfo.vertexBuffers[0] != cur.instanceInfo.vertexBuffers[0])
+			++numStateChanges;
+	}
+	EXPECT_EQ(numShaderChanges, 1);
+	EXPECT_EQ(numMaterialChanges, 3);
+	EXPECT_EQ(numStateChanges, 7);
+
+	// front to back among equal state
+	for (int i = 1; i < drawCmds.numElem(); ++i)
+	{
+		const RenderDrawCmd& prev = *drawCmds[i - 1];
+		const RenderDrawCmd& cur = *drawCmds[i];
+		if (prev.batchInfo.material != cur.batchInfo.material || prev.instanceInfo.vertexBuffers[0] != cur.instanceInfo.vertexBuffers[0])
+			continue;
+
+		const float prevDepth = float(((prev.batchInfo.firstIndex / 3) * 37) % 64);
+		const float curDepth = float(((cur.batchInfo.firstIndex / 3) * 37) % 64);
+		EXPECT_LE(prevDepth, curDepth);
+	}
+
+	// other passes are separate
+	ArrayCRef<const RenderDrawCmd*> pass1Cmds = bucket.GetPassDrawCmds(1);
+	ASSERT_EQ(pass1Cmds.numElem(), 1);
+	EXPECT_EQ(pass1Cmds[0]->batchInfo.firstIndex, 1000);
+	EXPECT_EQ(bucket.GetPassDrawCmds(2).numElem(), 0);
+}
+
+TEST(DRAW_BUCKET_TESTS, BackToFrontPass)
+{
+	DrawBucketTestScene scene;
+	CRenderDrawBucket bucket;
+	bucket.SetMaxDepth(100.0f);
+	bucket.SetPassSortMode(1, DRAWBUCKET_SORT_BACK_TO_FRONT);
+
+	for (int i = 0; i < 32; ++i)
+		bucket.AddDrawCmd(scene.MakeDrawCmd(i % 4, i % 2, i), float((i * 7) % 32), 1);
+
+	// equal keys keep their order
+	bucket.AddDrawCmd(scene.MakeDrawCmd(0, 0, 100), 50.0f, 1);
+	bucket.AddDrawCmd(scene.MakeDrawCmd(0, 0, 101), 50.0f, 1);
+	bucket.Sort();
+
+	ArrayCRef<const RenderDrawCmd*> drawCmds = bucket.GetPassDrawCmds(1);
+	ASSERT_EQ(drawCmds.numElem(), 34);
+	EXPECT_EQ(drawCmds[0]->batchInfo.firstIndex, 100);
+	EXPECT_EQ(drawCmds[1]->batchInfo.firstIndex, 101);
+
+	float prevDepth = 50.0f;
+	for (int i = 2; i < drawCmds.numElem(); ++i)
+	{
+		const float depth = float((drawCmds[i]->batchInfo.firstIndex * 7) % 32);
+		EXPECT_LE(depth, prevDepth);
+		prevDepth = depth;
+	}
+}
+
+TEST(DRAW_BUCKET_TESTS, RedundantStateElimination)
+{
+	DrawBucketTestScene scene;
+
+	// identical commands only set state once
+	{
+		Array<RenderDrawCmd> drawCmds(PP_SL);
+		for (int i = 0; i < 10; ++i)
+			drawCmds.append(scene.MakeDrawCmd(0, 0, i * 3));
+
+		Array<const RenderDrawCmd*> drawList(PP_SL);
+		for (const RenderDrawCmd& drawCmd : drawCmds)
+			drawList.append(&drawCmd);
+
+		const RenderDrawStats stats = DrawBucketReplayStates(drawList);
+		EXPECT_EQ(stats.numDraws, 10);
+		EXPECT_EQ(stats.numPipelinesBound, 1);
+		EXPECT_EQ(stats.numMaterialsBound, 1);
+		EXPECT_EQ(stats.numVertexBuffersBound, 1);
+		EXPECT_EQ(stats.numIndexBuffersBound, 1);
+	}
+
+	// uniform buffer change requires material setup, but pipeline stays the same
+	{
+		IGPUBufferPtr uniformBuffer(PPNew RenderTestBuffer(256));
+		RenderDrawCmd drawCmdA = scene.MakeDrawCmd(0, 0, 0);
+		RenderDrawCmd drawCmdB = scene.MakeDrawCmd(0, 0, 3);
+		drawCmdA.AddUniformBuffer(MAKECHAR4('B', 'O', 'N', 'E'), uniformBuffer, 0, 128);
+		drawCmdB.AddUniformBuffer(MAKECHAR4('B', 'O', 'N', 'E'), uniformBuffer, 128, 128);
+
+		RenderDrawStateCache stateCache;
+		EXPECT_TRUE(stateCache.NeedPipelineSetup(drawCmdA, 0xff));
+
+		RenderDrawStats stats;
+		stateCache.SetPipeline(drawCmdA, 0xff, nullptr, stats);
+		EXPECT_FALSE(stateCache.NeedPipelineSetup(drawCmdA, 0xff));
+		EXPECT_TRUE(stateCache.NeedPipelineSetup(drawCmdA, 0x1));
+		EXPECT_TRUE(stateCache.NeedPipelineSetup(drawCmdB, 0xff));
+	}
+
+	// sorted bucket binds much less state than submission order
+	{
+		CRenderDrawBucket bucket;
+		Array<RenderDrawCmd> drawCmds(PP_SL);
+		for (int i = 0; i < 64; ++i)
+		{
+			drawCmds.append(scene.MakeDrawCmd(i % 4, (i / 4) % 2, i * 3));
+			bucket.AddDrawCmd(drawCmds.back(), float(i), 0);
+		}
+		bucket.Sort();
+
+		Array<const RenderDrawCmd*> unsortedList(PP_SL);
+		for (const RenderDrawCmd& drawCmd : drawCmds)
+			unsortedList.append(&drawCmd);
+
+		const RenderDrawStats unsortedStats = DrawBucketReplayStates(unsortedList);
+		const RenderDrawStats sortedStats = DrawBucketReplayStates(bucket.GetPassDrawCmds(0));
+
+		EXPECT_EQ(unsortedStats.numDraws, sortedStats.numDraws);
+		EXPECT_EQ(sortedStats.numPipelinesBound, 2);
+		EXPECT_EQ(sortedStats.numMaterialsBound, 4);
+		EXPECT_LE(sortedStats.numVertexBuffersBound, 8);
+		EXPECT_EQ(sortedStats.numIndexBuffersBound, 1);
+
+		EXPECT_EQ(unsortedStats.numMaterialsBound, 64);
+		EXPECT_GT(unsortedStats.numVertexBuffersBound, sortedStats.numVertexBuffersBound);
+	}
+}
@@ -0,0 +1,299 @@
+#include <gtest/gtest.h>
+
+#include "core/core_common.h"
+#include "core/IConsoleCommands.h"
+#include "core/ConVar.h"
+#include "materialsystem1/IDynamicMesh.h"
+#include "materialsystem1/renderers/ShaderAPI_defs.h"
+#include "materialsystem1/RenderDefs.h"
+#include "font/Font.h"
+
+static constexpr const int s_fontTestCacheSize = 8;
+static constexpr const int s_fontBenchLabels = 500;
+static constexpr const int s_fontBenchFrames = 100;
+static constexpr const int s_fontBenchChangingLabels = 50;	// counters that change every frame
+
+static void SetFontCVar(const char* name, const char* value)
+{
+	ConVar* cvar = (ConVar*)g_consoleCommands->FindCvar(name);
+	ASSERT(cvar);
+	cvar->SetValue(value);
+}
+
+// same vertex format as material system dynamic mesh
+static const VertexLayoutDesc& GetFontTestVertexLayout()
+{
+	const int stride = sizeof(Vector4D) + sizeof(TVec4D<half>) * 2 + sizeof(uint);
+	static VertexLayoutDesc s_fontTestVertexLayout = Builder<VertexLayoutDesc>()
+		.Stride(stride)
+		.Attribute(VERTEXATTRIB_POSITION, "position", 0, 0, ATTRIBUTEFORMAT_FLOAT, 4)
+		.Attribute(VERTEXATTRIB_TEXCOORD, "texCoord", 1, sizeof(Vector4D), ATTRIBUTEFORMAT_HALF, 4)
+		.Attribute(VERTEXATTRIB_NORMAL, "normal", 2, sizeof(Vector4D) + sizeof(TVec4D<half>), ATTRIBUTEFORMAT_HALF, 4)
+		.Attribute(VERTEXATTRIB_COLOR, "color", 3, sizeof(Vector4D) + sizeof(TVec4D<half>) * 2, ATTRIBUTEFORMAT_UINT8, 4)
+		.End();
+	return s_fontTestVertexLayout;
+}
+
+// keeps geometry in memory instead of GPU buffers
+class FontTestDynamicMesh : public IDynamicMesh
+{
+public:
+	ArrayCRef<VertexLayoutDesc>	GetVertexLayoutDesc() const override { return ArrayCRef(&GetFontTestVertexLayout(), 1); }
+
+	void			SetPrimitiveType(EPrimTopology primType) override { m_primType = primType; }
+	EPrimTopology	GetPrimitiveType() const override { return m_primType; }
+
+	int AllocateGeom(int nVertices, int nIndices, void** verts, uint16** indices, bool addStripBreak) override
+	{
+		const int stride = GetFontTestVertexLayout().stride;
+		const int startVertex = vertices.numElem() / stride;
+
+		vertices.setNum(vertices.numElem() + nVertices * stride);
+		*verts = vertices.ptr() + startVertex * stride;
+
+		if (indices && nIndices)
+		{
+			this->indices.setNum(this->indices.numElem() + nIndices);
+			*indices = this->indices.ptr() + this->indices.numElem() - nIndices;
+		}
+		return startVertex;
+	}
+
+	void			AddStripBreak() override { indices.append(0xffff); }
+	bool			FillDrawCmd(RenderDrawCmd& drawCmd, int firstIndex, int numIndices) override { return vertices.numElem() > 0; }
+	IGPUCommandBufferPtr	GetSubmitBuffer() override { return nullptr; }
+
+	void Reset() override
+	{
+		vertices.clear(false);
+		indices.clear(false);
+	}
+
+	Array<ubyte>	vertices{ PP_SL };
+	Array<uint16>	indices{ PP_SL };
+
+private:
+	EPrimTopology	m_primType{ PRIM_TRIANGLE_STRIP };
+};
+
+// monospaced printable ASCII glyphs in 16x16 grid of texture
+class FontTestFont : public CFont
+{
+public:
+	using CFont::TextLayout;
+
+	FontTestFont()
+	{
+		m_flags.sdf = false;
+		m_flags.bold = false;
+		m_lineHeight = 16.0f;
+		m_baseline = 12.0f;
+		m_invTexSize = Vector2D(1.0f / 256.0f);
+
+		for (int ch = ' '; ch < 127; ++ch)
+		{
+			FontChar& chr = AllocFontChar(ch);
+			chr.x0 = (ch % 16) * 16.0f;
+			chr.y0 = (ch / 16) * 16.0f;
+			chr.x1 = chr.x0 + 10.0f;
+			chr.y1 = chr.y0 + 16.0f;
+			chr.advX = 11.0f;
+		}
+	}
+
+	template <typename CHAR_T>
+	bool DrawCached(const CHAR_T* text, const FontStyleParam& params, const Vector2D& layoutOrigin = vec2_zero)
+	{
+		bool cacheHit = false;
+		const TextLayout* layout = GetCachedTextLayout(text, params, layoutOrigin, &dynMesh, cacheHit);
+		if (layout)
+		{
+			RenderDrawCmd drawCmd;
+			FillTextLayoutMesh(*layout, vec2_zero, 0, &dynMesh, drawCmd);
+		}
+		return cacheHit;
+	}
+
+	int		GetNumCachedLayouts() const { return m_layoutCache.size(); }
+	void	ClearCachedLayouts() { m_layoutCache.clear(); }
+
+	FontTestDynamicMesh		dynMesh;
+};
+
+class FONT_LAYOUT_CACHE_TESTS : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		SetFontCVar("r_font_layoutcache_size", EqString::Format("%d", s_fontTestCacheSize));
+		FrameAllocEndFrame();
+	}
+
+	void TearDown() override
+	{
+		SetFontCVar("r_font_layoutcache_size", "1024");
+	}
+};
+
+TEST_F(FONT_LAYOUT_CACHE_TESTS, LayoutKeys)
+{
+	FontTestFont font;
+	FontStyleParam params;
+
+	EXPECT_FALSE(font.DrawCached("label", params));
+	EXPECT_TRUE(font.DrawCached("label", params));
+	EXPECT_FALSE(font.DrawCached("label2", params));
+
+	// text type is a part of the key
+	EXPECT_FALSE(font.DrawCached(L"label", params));
+	EXPECT_TRUE(font.DrawCached(L"label", params));
+
+	// parameters that change glyph quads
+	FontStyleParam colorParams;
+	colorParams.textColor = MColor(1.0f, 0.0f, 0.0f, 1.0f);
+	EXPECT_FALSE(font.DrawCached("label", colorParams));
+
+	FontStyleParam scaleParams;
+	scaleParams.scale = Vector2D(2.0f);
+	EXPECT_FALSE(font.DrawCached("label", scaleParams));
+
+	FontStyleParam alignParams;
+	alignParams.align = TEXT_ALIGN_HCENTER;
+	EXPECT_FALSE(font.DrawCached("label", alignParams));
+	EXPECT_FALSE(font.DrawCached("label", alignParams, Vector2D(0.5f, 0.0f)));
+	EXPECT_TRUE(font.DrawCached("label", alignParams, Vector2D(0.5f, 0.0f)));
+
+	FontStyleParam styleParams;
+	styleParams.styleFlag = TEXT_STYLE_MONOSPACE;
+	EXPECT_FALSE(font.DrawCached("label", styleParams));
+
+	// shadow is set up for draw command and doesn't need another layout
+	FontStyleParam shadowParams;
+	shadowParams.styleFlag = TEXT_STYLE_MONOSPACE;
+	shadowParams.shadowColor = MColor(0.0f, 0.0f, 1.0f, 1.0f);
+	shadowParams.shadowOffset = Vector2D(3.0f);
+	EXPECT_TRUE(font.DrawCached("label", shadowParams));
+
+	EXPECT_EQ(font.GetNumCachedLayouts(), 8);
+
+	// nothing to draw is not cached
+	EXPECT_FALSE(font.DrawCached("\n", params));
+	EXPECT_EQ(font.GetNumCachedLayouts(), 8);
+}
+
+TEST_F(FONT_LAYOUT_CACHE_TESTS, CachedLayoutMatchesBuilt)
+{
+	FontTestFont font;
+	FontStyleParam params;
+
+	font.DrawCached("cached text\nsecond line", params);
+	Array<ubyte> builtVertices(PP_SL);
+	builtVertices.append(font.dynMesh.vertices);
+
+	// rebuilt layout gives the same geometry
+	ASSERT_TRUE(font.DrawCached("cached text\nsecond line", params));
+	ASSERT_EQ(font.dynMesh.vertices.numElem(), builtVertices.numElem());
+	EXPECT_EQ(memcmp(font.dynMesh.vertices.ptr(), builtVertices.ptr(), builtVertices.numElem()), 0);
+
+	font.ClearCachedLayouts();
+	ASSERT_FALSE(font.DrawCached("cached text\nsecond line", params));
+	ASSERT_EQ(font.dynMesh.vertices.numElem(), builtVertices.numElem());
+	EXPECT_EQ(memcmp(font.dynMesh.vertices.ptr(), builtVertices.ptr(), builtVertices.numElem()), 0);
+}
+
+TEST_F(FONT_LAYOUT_CACHE_TESTS, EvictsLayoutsNotDrawnLastFrame)
+{
+	FontTestFont font;
+	FontStyleParam params;
+
+	for (int i = 0; i < s_fontTestCacheSize; ++i)
+		EXPECT_FALSE(font.DrawCached(EqString::Format("label %d", i).ToCString(), params));
+	EXPECT_EQ(font.GetNumCachedLayouts(), s_fontTestCacheSize);
+
+	// only first two labels are drawn in next frame
+	FrameAllocEndFrame();
+	EXPECT_TRUE(font.DrawCached("label 0", params));
+	EXPECT_TRUE(font.DrawCached("label 1", params));
+
+	// full cache drops the layouts not drawn during last frame
+	FrameAllocEndFrame();
+	EXPECT_FALSE(font.DrawCached("new label", params));
+	EXPECT_EQ(font.GetNumCachedLayouts(), 3);
+
+	EXPECT_TRUE(font.DrawCached("label 0", params));
+	EXPECT_TRUE(font.DrawCached("label 1", params));
+	EXPECT_FALSE(font.DrawCached("label 2", params));
+}
+
+TEST_F(FONT_LAYOUT_CACHE_TESTS, ClearedWhenAllLayoutsAreInUse)
+{
+	FontTestFont font;
+	FontStyleParam params;
+
+	for (int i = 0; i < s_fontTestCacheSize; ++i)
+		font.DrawCached(EqString::Format("label %d", i).ToCString(), params);
+
+	// more texts are drawn each frame than cache can hold
+	EXPECT_FALSE(font.DrawCached("new label", params));
+	EXPECT_EQ(font.GetNumCachedLayouts(), 1);
+	EXPECT_TRUE(font.DrawCached("new label", params));
+}
+
+// benchmarks are run with --gtest_also_run_disabled_tests
+TEST_F(FONT_LAYOUT_CACHE_TESTS, DISABLED_ManyLabelsBenchmark)
+{
+	// measured with default cache size
+	SetFontCVar("r_font_layoutcache_size", "1024");
+
+	FontTestFont font;
+	FontStyleParam params;
+
+	EqString labels[s_fontBenchLabels];
+	auto makeLabels = [&](int frame) {
+		for (int i = 0; i < s_fontBenchLabels; ++i)
+		{
+			if (i < s_fontBenchChangingLabels)
+				labels[i] = EqString::Format("Counter %d: %d", i, frame * 7 + i);
+			else
+				labels[i] = EqString::Format("Object label number %d", i);
+		}
+	};
+
+	// each text is laid out again every frame
+	CEqTimer timer;
+	for (int frame = 0; frame < s_fontBenchFrames; ++frame)
+	{
+		makeLabels(frame);
+		for (const EqString& label : labels)
+		{
+			font.ClearCachedLayouts();
+			font.DrawCached(label.ToCString(), params);
+		}
+		FrameAllocEndFrame();
+	}
+	const double noCacheMs = timer.GetTime(true) * 1000.0;
+
+	int64 hits = 0;
+	int64 misses = 0;
+	font.ClearCachedLayouts();
+	for (int frame = 0; frame < s_fontBenchFrames; ++frame)
+	{
+		makeLabels(frame);
+		for (const EqString& label : labels)
+		{
+			if (font.DrawCached(label.ToCString(), params))
+				++hits;
+			else
+				++misses;
+		}
+		FrameAllocEndFrame();
+	}
+	const double cacheMs = timer.GetTime() * 1000.0;
+
+	const double hitRate = hits * 100.0 / (hits + misses);
+	Msg("%d labels for %d frames: layout every frame %.2f ms, layout cache %.2f ms (%.1f%% hit rate, saved %.2f ms)\n",
+		s_fontBenchLabels, s_fontBenchFrames, noCacheMs, cacheMs, hitRate, noCacheMs - cacheMs);
+
+	EXPECT_GT(hitRate, 80.0);
+	EXPECT_LT(cacheMs, noCacheMs);
+}
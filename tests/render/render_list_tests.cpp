@@ -0,0 +1,202 @@
+#include <gtest/gtest.h>
+
+#include "core/core_common.h"
+#include "materialsystem1/RenderDefs.h"
+#include "render/RenderList.h"
+#include "render/RenderableObject.h"
+
+// geometry and instance formats are compared by pointer
+static const int s_testGeomA = 0;
+static const int s_testGeomB = 0;
+static const int s_testInstFormat = 0;
+
+struct RenderListTestDraw
+{
+	int		id;
+	int		numInstances;		// 0 when drawn without instancing
+	int		firstUploaded;		// index of first instance in uploaded ids
+};
+
+// keeps uploaded instance data instead of using transient buffers of material system
+class RenderListTestList : public CRenderList
+{
+public:
+	Array<RenderListTestDraw>	draws{ PP_SL };
+	Array<int>					uploadedIds{ PP_SL };
+
+protected:
+	GPUBufferView GetInstanceBuffer(const void* data, int size) override
+	{
+		const int* ids = reinterpret_cast<const int*>(data);
+		for (int i = 0; i < size / (int)sizeof(int); ++i)
+			uploadedIds.append(ids[i]);
+		return GPUBufferView();
+	}
+};
+
+class RenderListTestRenderable : public IRenderableObject
+{
+public:
+	RenderListTestRenderable(RenderListTestList& list, int id, float distance, const void* geometry, int lod = 0)
+		: m_list(list), m_geometry(geometry), m_lod(lod), m_id(id)
+	{
+		m_bbox = BoundingBox(distance, 0.0f, 0.0f, distance + 1.0f, 1.0f, 1.0f);
+	}
+
+	void Render(const RenderInfo& rinfo) override
+	{
+		m_list.draws.append({ m_id, 0, -1 });
+	}
+
+	const BoundingBox& GetBoundingBox() const override { return m_bbox; }
+
+	bool GetInstancingDesc(const RenderInfo& rinfo, RenderInstancingDesc& desc) const override
+	{
+		if (!m_geometry)
+			return false;
+
+		desc.geometry = m_geometry;
+		desc.instanceFormat = &s_testInstFormat;
+		desc.lod = m_lod;
+		desc.instanceData = &m_id;
+		desc.instanceDataSize = sizeof(m_id);
+		return true;
+	}
+
+	void RenderInstanced(const RenderInfo& rinfo, const MeshInstanceData& instData) override
+	{
+		m_list.draws.append({ m_id, instData.count, m_list.uploadedIds.numElem() - instData.count });
+	}
+
+private:
+	RenderListTestList&	m_list;
+	BoundingBox			m_bbox;
+	const void*			m_geometry;
+	int					m_lod;
+	int					m_id;
+};
+
+struct RenderListTestObject
+{
+	int			id;
+	float		distance;
+	const void*	geometry;
+	int			lod;
+};
+
+class RenderListTestScene
+{
+public:
+	RenderListTestScene(std::initializer_list<RenderListTestObject> objects)
+	{
+		list.SetAutoInstancing(true);
+		for (const RenderListTestObject& obj : objects)
+			renderables.append(PPNew RenderListTestRenderable(list, obj.id, obj.distance, obj.geometry, obj.lod));
+	}
+
+	~RenderListTestScene()
+	{
+		for (RenderListTestRenderable* renderable : renderables)
+			delete renderable;
+	}
+
+	void Render(bool backToFront)
+	{
+		list.Clear();
+		list.draws.clear();
+		list.uploadedIds.clear();
+
+		for (RenderListTestRenderable* renderable : renderables)
+			list.AddRenderable(renderable);
+
+		list.SortByDistanceFrom(vec3_zero, backToFront);
+		list.Render(0, RenderPassContext());
+	}
+
+	// checks draw ids and instance ids of each draw
+	void ExpectDraws(std::initializer_list<std::initializer_list<int>> expected) const
+	{
+		ASSERT_EQ(list.draws.numElem(), (int)expected.size());
+
+		int drawIdx = 0;
+		for (const std::initializer_list<int>& drawIds : expected)
+		{
+			const RenderListTestDraw& draw = list.draws[drawIdx++];
+			EXPECT_EQ(draw.id, *drawIds.begin());
+
+			if (drawIds.size() == 1)
+			{
+				EXPECT_EQ(draw.numInstances, 0);
+				continue;
+			}
+
+			ASSERT_EQ(draw.numInstances, (int)drawIds.size());
+			int instIdx = draw.firstUploaded;
+			for (int id : drawIds)
+				EXPECT_EQ(list.uploadedIds[instIdx++], id);
+		}
+	}
+
+	RenderListTestList					list;
+	Array<RenderListTestRenderable*>	renderables{ PP_SL };
+};
+
+TEST(RENDER_LIST_TESTS, InstanceGroupsAtSortedPosition)
+{
+	// id 3 is not instanceable
+	RenderListTestScene scene({
+		{ 5, 50.0f, &s_testGeomA, 0 },
+		{ 2, 20.0f, &s_testGeomB, 0 },
+		{ 1, 10.0f, &s_testGeomA, 0 },
+		{ 4, 40.0f, &s_testGeomB, 0 },
+		{ 3, 30.0f, nullptr, 0 },
+		{ 6, 60.0f, &s_testGeomA, 0 },
+	});
+
+	scene.Render(false);
+
+	// each group is drawn at position of it's closest renderable
+	scene.ExpectDraws({ { 1, 5, 6 }, { 2, 4 }, { 3 } });
+
+	const RenderListStats& stats = scene.list.GetStats();
+	EXPECT_EQ(stats.numRenderables, 6);
+	EXPECT_EQ(stats.numDraws, 3);
+	EXPECT_EQ(stats.numInstanceGroups, 2);
+	EXPECT_EQ(stats.numInstanced, 5);
+}
+
+TEST(RENDER_LIST_TESTS, GroupKeys)
+{
+	// different LODs are not grouped, single renderables are drawn as usual
+	RenderListTestScene scene({
+		{ 1, 10.0f, &s_testGeomA, 0 },
+		{ 2, 20.0f, &s_testGeomA, 1 },
+		{ 3, 30.0f, &s_testGeomA, 0 },
+		{ 4, 40.0f, &s_testGeomB, 1 },
+		{ 5, 50.0f, &s_testGeomA, 1 },
+	});
+
+	scene.Render(false);
+	scene.ExpectDraws({ { 1, 3 }, { 2, 5 }, { 4 } });
+}
+
+TEST(RENDER_LIST_TESTS, BackToFrontKeepsOrder)
+{
+	RenderListTestScene scene({
+		{ 1, 10.0f, &s_testGeomA, 0 },
+		{ 2, 20.0f, &s_testGeomB, 0 },
+		{ 3, 30.0f, &s_testGeomA, 0 },
+		{ 4, 40.0f, &s_testGeomA, 0 },
+		{ 5, 50.0f, &s_testGeomA, 0 },
+		{ 6, 60.0f, nullptr, 0 },
+		{ 7, 70.0f, &s_testGeomB, 0 },
+	});
+
+	// only neighbours are grouped so nothing is drawn out of order
+	scene.Render(true);
+	scene.ExpectDraws({ { 7 }, { 6 }, { 5, 4, 3 }, { 2 }, { 1 } });
+
+	// same list sorted front to back groups all of them
+	scene.Render(false);
+	scene.ExpectDraws({ { 1, 3, 4, 5 }, { 2, 7 }, { 6 } });
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "materialsystem1/IMaterial.h"
+#include "materialsystem1/RenderDefs.h"
+
+// material which only has a name and shader name, enough for sorting and state tracking
+class RenderTestMaterial : public IMaterial
+{
+public:
+	RenderTestMaterial(const char* name, const char* shaderName, int flags = 0)
+		: m_name(name), m_shaderName(shaderName), m_flags(flags)
+	{
+	}
+
+	const char*				GetName() const override { return m_name; }
+	const char*				GetShaderName() const override { return m_shaderName; }
+
+	CTextureAtlas*			GetAtlas() const override { return nullptr; }
+	int						GetFlags() const override { return m_flags; }
+
+	int						GetState() const override { return MATERIAL_LOAD_OK; }
+	bool					IsError() const override { return false; }
+
+	MatVarProxyUnk			FindMaterialVar(const char* pszVarName) const override { return MatVarProxyUnk(); }
+	MatVarProxyUnk			GetMaterialVar(const char* pszVarName, const char* defaultValue = nullptr) override { return MatVarProxyUnk(); }
+	const MaterialVarBlock& GetMaterialVars() const override { return m_vars; }
+
+	bool					LoadShaderAndTextures() override { return true; }
+	void					WaitForLoading() const override {}
+
+	const ITexturePtr&		GetBaseTexture(int stage = 0) override { return m_texture; }
+
+	const MatStoragePtr&	GetStorage(int id) const override { return m_storage; }
+	void					SetStorage(int id, const MatStoragePtr& ptr) override {}
+
+private:
+	MatVarData&				VarAt(int idx) const override { return m_vars.variables[idx]; }
+
+	const char*				m_name;
+	const char*				m_shaderName;
+	int						m_flags;
+	mutable MaterialVarBlock m_vars;
+	ITexturePtr				m_texture;
+	MatStoragePtr			m_storage;
+};
+
+// buffer without storage, only used as a binding identity
+class RenderTestBuffer : public IGPUBuffer
+{
+public:
+	RenderTestBuffer(int size) : m_size(size) {}
+
+	void		Update(const void* data, int64 size, int64 offset) override {}
+	MapFuture	Lock(int lockOfs, int sizeToLock, int flags) override { return MapFuture::Failure(-1, "not supported"); }
+	void		Unlock() override {}
+
+	int			GetSize() const override { return m_size; }
+	int			GetUsageFlags() const override { return 0; }
+
+private:
+	int			m_size;
+};
@@ -0,0 +1,20 @@
+#include <gtest/gtest.h>
+
+#include "core/core_common.h"
+#include "tests_common.h"
+
+class IMaterialSystem* g_matSystem = nullptr;
+
+class IDebugOverlay;
+IDebugOverlay* debugoverlay = nullptr;
+
+int main(int argc, char** argv)
+{
+	TestAppWrapper test(false, "render_tests", argc, argv);
+	testing::InitGoogleTest(&argc, argv);
+
+	// you can specify flags before running
+	//::testing::FLAGS_gtest_filter = "DRAW_BUCKET_TESTS.*";
+
+	return RUN_ALL_TESTS();
+}
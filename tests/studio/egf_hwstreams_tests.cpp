@@ -0,0 +1,375 @@
+#include <gtest/gtest.h>
+
+#include "core/core_common.h"
+#include "math/Random.h"
+#include "egf/model.h"
+#include "studiofile/StudioLoader.h"
+#include "studio/StudioVertex.h"
+#include "materialsystem1/renderers/ShaderAPI_defs.h"
+
+static constexpr const int s_testMeshVertices = 300;
+static constexpr const int s_testMeshTriangles = 500;
+
+struct EGFTestMesh
+{
+	int							vertexType{ 0 };
+	int							primitiveType{ STUDIO_PRIM_TRIANGLES };
+
+	Array<studioVertexPosUv_t>	posUvs{ PP_SL };
+	Array<studioVertexTBN_t>	tbns{ PP_SL };
+	Array<studioBoneWeight_t>	boneWeights{ PP_SL };
+	Array<studioVertexColor_t>	colors{ PP_SL };
+	Array<uint32>				indices{ PP_SL };
+};
+
+static Vector3D RandomUnitVector(CUniformRandomStream& random)
+{
+	Vector3D value;
+	do {
+		value = Vector3D(random.RandomFloat(-1.0f, 1.0f), random.RandomFloat(-1.0f, 1.0f), random.RandomFloat(-1.0f, 1.0f));
+	} while (lengthSqr(value) < 0.01f);
+	return normalize(value);
+}
+
+static void GenerateTestMesh(CUniformRandomStream& random, EGFTestMesh& mesh, int vertexType, int primitiveType)
+{
+	mesh.vertexType = vertexType;
+	mesh.primitiveType = primitiveType;
+
+	for (int i = 0; i < s_testMeshVertices; ++i)
+	{
+		studioVertexPosUv_t& posUv = mesh.posUvs.append();
+		posUv.point = Vector3D(random.RandomFloat(-10.0f, 10.0f), random.RandomFloat(-10.0f, 10.0f), random.RandomFloat(-10.0f, 10.0f));
+		posUv.texCoord = Vector2D(random.RandomFloat(-2.0f, 3.0f), random.RandomFloat(0.0f, 1.0f));
+
+		studioVertexTBN_t& tbn = mesh.tbns.append();
+		tbn.tangent = RandomUnitVector(random);
+		tbn.binormal = RandomUnitVector(random);
+		tbn.normal = RandomUnitVector(random);
+
+		if (vertexType & STUDIO_VERTFLAG_BONEWEIGHT)
+		{
+			studioBoneWeight_t& boneWeight = mesh.boneWeights.append();
+			memset(&boneWeight, 0, sizeof(boneWeight));
+			boneWeight.numweights = random.RandomInt(1, MAX_MODEL_VERTEX_WEIGHTS);
+
+			float weightSum = 0.0f;
+			for (int w = 0; w < boneWeight.numweights; ++w)
+			{
+				boneWeight.bones[w] = random.RandomInt(0, 100);
+				boneWeight.weight[w] = random.RandomFloat(0.05f, 1.0f);
+				weightSum += boneWeight.weight[w];
+			}
+
+			for (int w = 0; w < boneWeight.numweights; ++w)
+				boneWeight.weight[w] /= weightSum;
+		}
+
+		if (vertexType & STUDIO_VERTFLAG_COLOR)
+			mesh.colors.append({ (uint)random.RandomInt(0, INT_MAX) });
+	}
+
+	// strips are only different by index interpretation
+	const int numIndices = primitiveType == STUDIO_PRIM_TRI_STRIP ? s_testMeshTriangles + 2 : s_testMeshTriangles * 3;
+	for (int i = 0; i < numIndices; ++i)
+		mesh.indices.append(random.RandomInt(0, s_testMeshVertices - 1));
+}
+
+static int GetTestVertexStride(int vertexType)
+{
+	return ((vertexType & STUDIO_VERTFLAG_POS_UV) ? sizeof(studioVertexPosUv_t) : 0)
+		+ ((vertexType & STUDIO_VERTFLAG_TBN) ? sizeof(studioVertexTBN_t) : 0)
+		+ ((vertexType & STUDIO_VERTFLAG_BONEWEIGHT) ? sizeof(studioBoneWeight_t) : 0)
+		+ ((vertexType & STUDIO_VERTFLAG_COLOR) ? sizeof(studioVertexColor_t) : 0);
+}
+
+// builds EGF with single mesh group the same way as EGF generator does,
+// either with mesh streams (version 13) or with hardware vertex streams only
+static ubyte* BuildTestModel(ArrayCRef<EGFTestMesh> meshes, bool hwStreams, int& size)
+{
+	int numVertices = 0;
+	int numIndices = 0;
+	int vertexType = 0;
+	int meshStreamsSize = 0;
+	for (const EGFTestMesh& mesh : meshes)
+	{
+		numVertices += mesh.posUvs.numElem();
+		numIndices += mesh.indices.numElem();
+		vertexType |= mesh.vertexType;
+		meshStreamsSize += GetTestVertexStride(mesh.vertexType) * mesh.posUvs.numElem() + sizeof(uint32) * mesh.indices.numElem();
+	}
+
+	studioHwStreamsDesc_t hwDesc;
+	const int hwStreamsSize = Studio_InitHwStreams(hwDesc, vertexType, numVertices, numIndices);
+
+	const int meshGroupsOffset = sizeof(studioHdr_t);
+	const int meshesOffset = meshGroupsOffset + sizeof(studioMeshGroupDesc_t);
+	const int dataOffset = meshesOffset + sizeof(studioMeshDesc_t) * meshes.numElem();
+	size = dataOffset + (hwStreams ? hwStreamsSize : meshStreamsSize);
+
+	ubyte* buffer = (ubyte*)PPAlloc(size);
+	memset(buffer, 0, size);
+
+	studioHdr_t* header = (studioHdr_t*)buffer;
+	header->ident = EQUILIBRIUM_MODEL_SIGNATURE;
+	header->version = hwStreams ? EQUILIBRIUM_MODEL_VERSION : EQUILIBRIUM_MODEL_VERSION_13;
+	header->flags = STUDIO_FLAG_NEW_VERTEX_FMT;
+	header->length = size;
+	header->numMeshGroups = 1;
+	header->meshGroupsOffset = meshGroupsOffset;
+
+	studioMeshGroupDesc_t* meshGroupDesc = header->pMeshGroupDesc(0);
+	meshGroupDesc->numMeshes = meshes.numElem();
+	meshGroupDesc->meshesOffset = meshesOffset - meshGroupsOffset;
+	meshGroupDesc->transformIdx = EGF_INVALID_IDX;
+
+	studioHwStreamsDesc_t* hwStreamsDesc = nullptr;
+	if (hwStreams)
+	{
+		header->flags |= STUDIO_FLAG_HW_VERTEX_STREAMS;
+		header->hwStreamsOffset = dataOffset;
+
+		hwStreamsDesc = header->pHwStreams();
+		*hwStreamsDesc = hwDesc;
+	}
+
+	int writeOffset = dataOffset;
+	int firstVertex = 0;
+	int firstIndex = 0;
+	for (int i = 0; i < meshes.numElem(); ++i)
+	{
+		const EGFTestMesh& srcMesh = meshes[i];
+		studioMeshDesc_t* mesh = meshGroupDesc->pMesh(i);
+		const int meshOffset = (ubyte*)mesh - buffer;
+
+		mesh->materialIndex = -1;
+		mesh->primitiveType = srcMesh.primitiveType;
+		mesh->vertexType = srcMesh.vertexType;
+		mesh->numVertices = srcMesh.posUvs.numElem();
+		mesh->numIndices = srcMesh.indices.numElem();
+
+		studioBoneWeight_t noBoneWeight{};
+		for (int w = 0; w < MAX_MODEL_VERTEX_WEIGHTS; ++w)
+			noBoneWeight.bones[w] = -1;
+
+		if (hwStreamsDesc)
+		{
+			mesh->vertexOffset = firstVertex;
+			mesh->indicesOffset = firstIndex;
+
+			for (int k = 0; k < mesh->numVertices; ++k)
+			{
+				Studio_EncodeHwVertex(hwStreamsDesc, firstVertex + k, srcMesh.posUvs[k], srcMesh.tbns[k],
+					(srcMesh.vertexType & STUDIO_VERTFLAG_BONEWEIGHT) ? srcMesh.boneWeights[k] : noBoneWeight,
+					(srcMesh.vertexType & STUDIO_VERTFLAG_COLOR) ? srcMesh.colors[k] : studioVertexColor_t{ color_white.pack() });
+			}
+
+			for (uint32 k = 0; k < mesh->numIndices; ++k)
+			{
+				const uint32 index = srcMesh.indices[k] + firstVertex;
+				if (hwStreamsDesc->indexSize == sizeof(uint32))
+					((uint32*)hwStreamsDesc->pIndices())[firstIndex + k] = index;
+				else
+					((uint16*)hwStreamsDesc->pIndices())[firstIndex + k] = index & 0xffff;
+			}
+		}
+		else
+		{
+			mesh->vertexOffset = writeOffset - meshOffset;
+			writeOffset += GetTestVertexStride(mesh->vertexType) * mesh->numVertices;
+
+			for (int k = 0; k < mesh->numVertices; ++k)
+			{
+				*mesh->pPosUvs(k) = srcMesh.posUvs[k];
+				*mesh->pTBNs(k) = srcMesh.tbns[k];
+				if (mesh->vertexType & STUDIO_VERTFLAG_BONEWEIGHT)
+					*mesh->pBoneWeight(k) = srcMesh.boneWeights[k];
+				if (mesh->vertexType & STUDIO_VERTFLAG_COLOR)
+					*mesh->pColor(k) = srcMesh.colors[k];
+			}
+
+			mesh->indicesOffset = writeOffset - meshOffset;
+			writeOffset += sizeof(uint32) * mesh->numIndices;
+
+			for (uint32 k = 0; k < mesh->numIndices; ++k)
+				*mesh->pVertexIdx(k) = srcMesh.indices[k];
+		}
+
+		firstVertex += mesh->numVertices;
+		firstIndex += mesh->numIndices;
+	}
+
+	return buffer;
+}
+
+static void CompareLoadedModel(const studioHdr_t* studio, ArrayCRef<EGFTestMesh> meshes, bool exact)
+{
+	ASSERT_EQ(studio->numMeshGroups, 1);
+
+	const studioMeshGroupDesc_t* meshGroupDesc = studio->pMeshGroupDesc(0);
+	ASSERT_EQ(meshGroupDesc->numMeshes, meshes.numElem());
+
+	// positions and UVs are half floats, TBN and weights are 8 bit normalized
+	const float pointTolerance = exact ? 0.0f : 10.0f / 1024.0f;
+	const float texCoordTolerance = exact ? 0.0f : 3.0f / 1024.0f;
+	const float minDot = exact ? 1.0f - F_EPS : 0.99f;
+
+	const studioHwStreamsDesc_t* hwStreams = studio->pHwStreams();
+	for (int i = 0; i < meshes.numElem(); ++i)
+	{
+		const EGFTestMesh& srcMesh = meshes[i];
+		const studioMeshDesc_t* mesh = meshGroupDesc->pMesh(i);
+
+		ASSERT_EQ(mesh->vertexType, srcMesh.vertexType);
+		ASSERT_EQ(mesh->primitiveType, srcMesh.primitiveType);
+		ASSERT_EQ(mesh->numVertices, srcMesh.posUvs.numElem());
+		ASSERT_EQ(mesh->numIndices, (uint32)srcMesh.indices.numElem());
+
+		for (int k = 0; k < mesh->numVertices; ++k)
+		{
+			studioVertexPosUv_t posUv;
+			studioVertexTBN_t tbn;
+			studioBoneWeight_t boneWeight;
+			studioVertexColor_t color;
+			Studio_GetMeshVertex(hwStreams, mesh, k, &posUv, &tbn, &boneWeight, &color);
+
+			const Vector3D point = Studio_GetMeshVertexPoint(hwStreams, mesh, k);
+			EXPECT_EQ(point, posUv.point);
+
+			for (int c = 0; c < 3; ++c)
+				EXPECT_NEAR(posUv.point[c], srcMesh.posUvs[k].point[c], pointTolerance);
+			EXPECT_NEAR(posUv.texCoord.x, srcMesh.posUvs[k].texCoord.x, texCoordTolerance);
+			EXPECT_NEAR(posUv.texCoord.y, srcMesh.posUvs[k].texCoord.y, texCoordTolerance);
+
+			EXPECT_GT(dot(tbn.tangent, srcMesh.tbns[k].tangent), minDot);
+			EXPECT_GT(dot(tbn.binormal, srcMesh.tbns[k].binormal), minDot);
+			EXPECT_GT(dot(tbn.normal, srcMesh.tbns[k].normal), minDot);
+
+			if (mesh->vertexType & STUDIO_VERTFLAG_BONEWEIGHT)
+			{
+				const studioBoneWeight_t& srcBoneWeight = srcMesh.boneWeights[k];
+				ASSERT_EQ(boneWeight.numweights, srcBoneWeight.numweights);
+				for (int w = 0; w < srcBoneWeight.numweights; ++w)
+				{
+					EXPECT_EQ(boneWeight.bones[w], srcBoneWeight.bones[w]);
+					EXPECT_NEAR(boneWeight.weight[w], srcBoneWeight.weight[w], exact ? 0.0f : 1.0f / 255.0f);
+				}
+			}
+
+			if (mesh->vertexType & STUDIO_VERTFLAG_COLOR)
+				EXPECT_EQ(color.color, srcMesh.colors[k].color);
+		}
+
+		for (uint32 k = 0; k < mesh->numIndices; ++k)
+			ASSERT_EQ(Studio_GetMeshVertexIndex(hwStreams, mesh, k), srcMesh.indices[k]);
+	}
+}
+
+class EGF_HWSTREAMS_TESTS : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		CUniformRandomStream random;
+		random.SetSeed(1414);
+
+		GenerateTestMesh(random, meshes.append(), STUDIO_VERTFLAG_POS_UV | STUDIO_VERTFLAG_TBN | STUDIO_VERTFLAG_BONEWEIGHT, STUDIO_PRIM_TRIANGLES);
+		GenerateTestMesh(random, meshes.append(), STUDIO_VERTFLAG_POS_UV | STUDIO_VERTFLAG_TBN | STUDIO_VERTFLAG_COLOR, STUDIO_PRIM_TRI_STRIP);
+		GenerateTestMesh(random, meshes.append(), STUDIO_VERTFLAG_POS_UV | STUDIO_VERTFLAG_TBN, STUDIO_PRIM_TRI_STRIP);
+	}
+
+	Array<EGFTestMesh> meshes{ PP_SL };
+};
+
+TEST_F(EGF_HWSTREAMS_TESTS, LoadQuantized)
+{
+	int size = 0;
+	ubyte* buffer = BuildTestModel(meshes, true, size);
+
+	studioHdr_t* studio = Studio_LoadModelFromBuffer(buffer, size, "hwstreams_test.egf");
+	ASSERT_NE(studio, nullptr);
+
+	// meshes are read from streams in place
+	EXPECT_EQ((ubyte*)studio, buffer);
+
+	const studioHwStreamsDesc_t* hwStreams = studio->pHwStreams();
+	ASSERT_NE(hwStreams, nullptr);
+	EXPECT_EQ(hwStreams->format, STUDIO_HWSTREAM_FMT_QUANTIZED);
+	EXPECT_EQ(hwStreams->indexSize, (int)sizeof(uint16));
+	EXPECT_EQ(hwStreams->numVertices, s_testMeshVertices * meshes.numElem());
+
+	CompareLoadedModel(studio, meshes, false);
+	Studio_FreeModel(studio);
+}
+
+TEST_F(EGF_HWSTREAMS_TESTS, LoadWithoutHwStreams)
+{
+	int size = 0;
+	ubyte* buffer = BuildTestModel(meshes, false, size);
+
+	studioHdr_t* studio = Studio_LoadModelFromBuffer(buffer, size, "hwstreams_test.egf");
+	ASSERT_NE(studio, nullptr);
+	EXPECT_EQ(studio->pHwStreams(), nullptr);
+
+	CompareLoadedModel(studio, meshes, true);
+	Studio_FreeModel(studio);
+}
+
+TEST_F(EGF_HWSTREAMS_TESTS, StreamsHaveHwVertexLayout)
+{
+	int size = 0;
+	ubyte* buffer = BuildTestModel(meshes, true, size);
+
+	studioHdr_t* studio = Studio_LoadModelFromBuffer(buffer, size, "hwstreams_test.egf");
+	ASSERT_NE(studio, nullptr);
+
+	const studioHwStreamsDesc_t* hwStreams = studio->pHwStreams();
+	ASSERT_NE(hwStreams, nullptr);
+
+	EXPECT_EQ(EGFHwVertex::PositionUV::GetVertexLayoutDesc().stride, (int)sizeof(studioHwVertexPosUv_t));
+	EXPECT_EQ(EGFHwVertex::TBN::GetVertexLayoutDesc().stride, (int)sizeof(studioHwVertexTBN_t));
+	EXPECT_EQ(EGFHwVertex::BoneWeights::GetVertexLayoutDesc().stride, (int)sizeof(studioHwBoneWeight_t));
+	EXPECT_EQ(EGFHwVertex::Color::GetVertexLayoutDesc().stride, (int)sizeof(studioVertexColor_t));
+
+	// streams are uploaded as they are, so they must be same as vertices made at runtime
+	const EGFHwVertex::PositionUV* posUvs = (const EGFHwVertex::PositionUV*)hwStreams->pStream(STUDIO_VERTSTREAM_POS_UV);
+	const EGFHwVertex::TBN* tbns = (const EGFHwVertex::TBN*)hwStreams->pStream(STUDIO_VERTSTREAM_TBN);
+	const EGFHwVertex::BoneWeights* boneWeights = (const EGFHwVertex::BoneWeights*)hwStreams->pStream(STUDIO_VERTSTREAM_BONEWEIGHT);
+
+	const EGFTestMesh& srcMesh = meshes[0];
+	for (int k = 0; k < srcMesh.posUvs.numElem(); ++k)
+	{
+		const EGFHwVertex::PositionUV posUv(srcMesh.posUvs[k]);
+		const EGFHwVertex::TBN tbn(srcMesh.tbns[k]);
+		const EGFHwVertex::BoneWeights boneWeight(srcMesh.boneWeights[k]);
+		EXPECT_EQ(memcmp(&posUvs[k], &posUv, sizeof(posUv)), 0);
+		EXPECT_EQ(memcmp(&tbns[k], &tbn, sizeof(tbn)), 0);
+		EXPECT_EQ(memcmp(&boneWeights[k], &boneWeight, sizeof(boneWeight)), 0);
+	}
+
+	Studio_FreeModel(studio);
+}
+
+TEST_F(EGF_HWSTREAMS_TESTS, SizeReduction)
+{
+	int hwSize = 0;
+	int meshStreamsSize = 0;
+	PPFree(BuildTestModel(meshes, true, hwSize));
+	PPFree(BuildTestModel(meshes, false, meshStreamsSize));
+
+	const float sizeRatio = (float)hwSize / (float)meshStreamsSize;
+	Msg("EGF with mesh streams %d bytes, with hardware streams %d bytes (%.2f)\n", meshStreamsSize, hwSize, sizeRatio);
+
+	EXPECT_LT(sizeRatio, 0.65f);
+}
+
+TEST_F(EGF_HWSTREAMS_TESTS, OutOfRangeMesh)
+{
+	int size = 0;
+	ubyte* buffer = BuildTestModel(meshes, true, size);
+
+	studioHdr_t* header = (studioHdr_t*)buffer;
+	header->pMeshGroupDesc(0)->pMesh(2)->vertexOffset = s_testMeshVertices * meshes.numElem() - 1;
+
+	EXPECT_EQ(Studio_LoadModelFromBuffer(buffer, size, "hwstreams_test.egf"), nullptr);
+}
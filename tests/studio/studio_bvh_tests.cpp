@@ -0,0 +1,385 @@
+#include <gtest/gtest.h>
+
+#include "core/core_common.h"
+#include "math/Random.h"
+#include "math/Utility.h"
+#include "egf/model.h"
+#include "materialsystem1/IMaterial.h"
+#include "render/Decals.h"
+#include "studio/StudioVertex.h"
+#include "studio/StudioGeomBVH.h"
+#include "studio/StudioGeomDecal.h"
+
+static constexpr const int s_bvhTestGridSize = 40;
+static constexpr const float s_bvhTestCellSize = 0.25f;
+static constexpr const int s_bvhTestRays = 2000;
+static constexpr const int s_bvhTestBoxes = 300;
+
+struct BVHTestMesh
+{
+	int							vertexType{ STUDIO_VERTFLAG_POS_UV | STUDIO_VERTFLAG_TBN };
+	int							primitiveType{ STUDIO_PRIM_TRIANGLES };
+
+	Array<studioVertexPosUv_t>	posUvs{ PP_SL };
+	Array<studioVertexTBN_t>	tbns{ PP_SL };
+	Array<studioBoneWeight_t>	boneWeights{ PP_SL };
+	Array<uint32>				indices{ PP_SL };
+};
+
+// bumpy grid surface facing up, strips have a row each joined by degenerate triangles
+static void GenerateBVHTestGrid(BVHTestMesh& mesh, const Vector3D& origin, float bumpHeight, int primitiveType, bool skinned)
+{
+	mesh.primitiveType = primitiveType;
+	if (skinned)
+		mesh.vertexType |= STUDIO_VERTFLAG_BONEWEIGHT;
+
+	const int rowVerts = s_bvhTestGridSize + 1;
+	for (int y = 0; y < rowVerts; ++y)
+	{
+		for (int x = 0; x < rowVerts; ++x)
+		{
+			studioVertexPosUv_t& posUv = mesh.posUvs.append();
+			posUv.point = origin + Vector3D(x * s_bvhTestCellSize, sinf(x * 0.3f) * cosf(y * 0.2f) * bumpHeight, y * s_bvhTestCellSize);
+			posUv.texCoord = Vector2D((float)x, (float)y) / (float)s_bvhTestGridSize;
+
+			studioVertexTBN_t& tbn = mesh.tbns.append();
+			tbn.tangent = vec3_right;
+			tbn.binormal = vec3_forward;
+			tbn.normal = vec3_up;
+
+			if (!skinned)
+				continue;
+
+			// left half follows first bone and right half follows second one
+			studioBoneWeight_t& boneWeight = mesh.boneWeights.append();
+			memset(&boneWeight, 0, sizeof(boneWeight));
+			boneWeight.numweights = 1;
+			boneWeight.bones[0] = x < rowVerts / 2 ? 0 : 1;
+			boneWeight.weight[0] = 1.0f;
+		}
+	}
+
+	for (int y = 0; y < s_bvhTestGridSize; ++y)
+	{
+		if (primitiveType == STUDIO_PRIM_TRI_STRIP)
+		{
+			if (y > 0)
+			{
+				mesh.indices.append(mesh.indices.back());
+				mesh.indices.append(y * rowVerts);
+			}
+
+			for (int x = 0; x < rowVerts; ++x)
+			{
+				mesh.indices.append(y * rowVerts + x);
+				mesh.indices.append((y + 1) * rowVerts + x);
+			}
+			continue;
+		}
+
+		for (int x = 0; x < s_bvhTestGridSize; ++x)
+		{
+			const int first = y * rowVerts + x;
+			mesh.indices.append(first);
+			mesh.indices.append(first + rowVerts);
+			mesh.indices.append(first + 1);
+			mesh.indices.append(first + 1);
+			mesh.indices.append(first + rowVerts);
+			mesh.indices.append(first + rowVerts + 1);
+		}
+	}
+}
+
+// mesh group with streams of each mesh placed after all mesh descs
+static const studioMeshGroupDesc_t* BuildBVHTestMeshGroup(ArrayCRef<BVHTestMesh> meshes, Array<ubyte>& buffer)
+{
+	const int meshesOffset = sizeof(studioMeshGroupDesc_t);
+	int size = meshesOffset + sizeof(studioMeshDesc_t) * meshes.numElem();
+	for (const BVHTestMesh& mesh : meshes)
+	{
+		const int stride = sizeof(studioVertexPosUv_t) + sizeof(studioVertexTBN_t) + ((mesh.vertexType & STUDIO_VERTFLAG_BONEWEIGHT) ? sizeof(studioBoneWeight_t) : 0);
+		size += stride * mesh.posUvs.numElem() + sizeof(uint32) * mesh.indices.numElem();
+	}
+
+	buffer.setNum(size, false);
+	memset(buffer.ptr(), 0, size);
+
+	studioMeshGroupDesc_t* meshGroupDesc = reinterpret_cast<studioMeshGroupDesc_t*>(buffer.ptr());
+	meshGroupDesc->numMeshes = meshes.numElem();
+	meshGroupDesc->meshesOffset = meshesOffset;
+	meshGroupDesc->transformIdx = EGF_INVALID_IDX;
+
+	int writeOffset = meshesOffset + sizeof(studioMeshDesc_t) * meshes.numElem();
+	for (int i = 0; i < meshes.numElem(); ++i)
+	{
+		const BVHTestMesh& srcMesh = meshes[i];
+		studioMeshDesc_t* mesh = meshGroupDesc->pMesh(i);
+		const int meshOffset = reinterpret_cast<ubyte*>(mesh) - buffer.ptr();
+
+		mesh->materialIndex = -1;
+		mesh->primitiveType = srcMesh.primitiveType;
+		mesh->vertexType = srcMesh.vertexType;
+		mesh->numVertices = srcMesh.posUvs.numElem();
+		mesh->numIndices = srcMesh.indices.numElem();
+
+		mesh->vertexOffset = writeOffset - meshOffset;
+		for (int k = 0; k < mesh->numVertices; ++k)
+		{
+			*mesh->pPosUvs(k) = srcMesh.posUvs[k];
+			*mesh->pTBNs(k) = srcMesh.tbns[k];
+			if (mesh->vertexType & STUDIO_VERTFLAG_BONEWEIGHT)
+				*mesh->pBoneWeight(k) = srcMesh.boneWeights[k];
+		}
+		writeOffset = reinterpret_cast<ubyte*>(mesh->pPosUvs(mesh->numVertices)) - buffer.ptr();
+
+		mesh->indicesOffset = writeOffset - meshOffset;
+		for (uint32 k = 0; k < mesh->numIndices; ++k)
+			*mesh->pVertexIdx(k) = srcMesh.indices[k];
+		writeOffset += sizeof(uint32) * mesh->numIndices;
+	}
+
+	return meshGroupDesc;
+}
+
+// all non-degenerate triangles of mesh group with strip winding resolved
+static void GetBVHTestTriangles(const studioMeshGroupDesc_t* meshGroupDesc, Array<CStudioMeshBVH::Triangle>& triangles)
+{
+	for (int i = 0; i < meshGroupDesc->numMeshes; ++i)
+	{
+		const studioMeshDesc_t* mesh = meshGroupDesc->pMesh(i);
+		const bool isStrip = mesh->primitiveType == STUDIO_PRIM_TRI_STRIP;
+		const int numTriangles = isStrip ? mesh->numIndices - 2 : mesh->numIndices / 3;
+
+		for (int k = 0; k < numTriangles; ++k)
+		{
+			const int first = isStrip ? k : k * 3;
+			const uint32* indices = mesh->pVertexIdx(first);
+			if (indices[0] == indices[1] || indices[0] == indices[2] || indices[1] == indices[2])
+				continue;
+
+			const bool flip = isStrip && (k & 1);
+			triangles.append({ i, { (int)indices[flip ? 2 : 0], (int)indices[1], (int)indices[flip ? 0 : 2] } });
+		}
+	}
+}
+
+static float BVHTestBruteForceRay(const studioMeshGroupDesc_t* meshGroupDesc, ArrayCRef<CStudioMeshBVH::Triangle> triangles, const Vector3D& rayStart, const Vector3D& rayDir)
+{
+	float bestFraction = F_INFINITY;
+	for (const CStudioMeshBVH::Triangle& tri : triangles)
+	{
+		const studioMeshDesc_t* mesh = meshGroupDesc->pMesh(tri.mesh);
+
+		float fraction = F_INFINITY;
+		if (!IsRayIntersectsTriangle(mesh->pPosUvs(tri.indices[0])->point, mesh->pPosUvs(tri.indices[1])->point, mesh->pPosUvs(tri.indices[2])->point, rayStart, rayDir, fraction, true))
+			continue;
+
+		if (fraction > 0.0f && fraction < bestFraction)
+			bestFraction = fraction;
+	}
+	return bestFraction;
+}
+
+static int CompareBVHTestTriangles(const CStudioMeshBVH::Triangle& a, const CStudioMeshBVH::Triangle& b)
+{
+	if (a.mesh != b.mesh)
+		return a.mesh - b.mesh;
+	return memcmp(a.indices, b.indices, sizeof(a.indices));
+}
+
+class STUDIO_BVH_TESTS : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		GenerateBVHTestGrid(meshes.append(), Vector3D(0.0f, 0.0f, 0.0f), 1.0f, STUDIO_PRIM_TRIANGLES, false);
+		GenerateBVHTestGrid(meshes.append(), Vector3D(5.0f, 0.5f, 5.0f), 1.5f, STUDIO_PRIM_TRI_STRIP, false);
+		GenerateBVHTestGrid(meshes.append(), Vector3D(-5.0f, 1.0f, 2.0f), 0.5f, STUDIO_PRIM_TRI_STRIP, false);
+
+		meshGroupDesc = BuildBVHTestMeshGroup(meshes, buffer);
+		GetBVHTestTriangles(meshGroupDesc, triangles);
+		bvh.Build(meshGroupDesc);
+	}
+
+	Array<BVHTestMesh>					meshes{ PP_SL };
+	Array<ubyte>						buffer{ PP_SL };
+	const studioMeshGroupDesc_t*		meshGroupDesc{ nullptr };
+	Array<CStudioMeshBVH::Triangle>		triangles{ PP_SL };
+	CStudioMeshBVH						bvh;
+};
+
+TEST_F(STUDIO_BVH_TESTS, TrianglesMatchMeshes)
+{
+	Array<CStudioMeshBVH::Triangle> bvhTriangles(PP_SL);
+	bvhTriangles.append(bvh.GetTriangles().ptr(), bvh.GetTriangles().numElem());
+	ASSERT_EQ(bvhTriangles.numElem(), triangles.numElem());
+
+	// tree reorders triangles, strip degenerates are dropped
+	arraySort(bvhTriangles, CompareBVHTestTriangles);
+	arraySort(triangles, CompareBVHTestTriangles);
+	for (int i = 0; i < triangles.numElem(); ++i)
+		EXPECT_EQ(CompareBVHTestTriangles(bvhTriangles[i], triangles[i]), 0) << "triangle " << i;
+
+	const BoundingBox bounds = bvh.GetBounds();
+	for (const BVHTestMesh& mesh : meshes)
+	{
+		for (const studioVertexPosUv_t& posUv : mesh.posUvs)
+			EXPECT_TRUE(bounds.Contains(posUv.point));
+	}
+}
+
+TEST_F(STUDIO_BVH_TESTS, RaysMatchBruteForce)
+{
+	CUniformRandomStream random;
+	random.SetSeed(1415);
+
+	const BoundingBox bounds = bvh.GetBounds();
+
+	int numHits = 0;
+	for (int i = 0; i < s_bvhTestRays; ++i)
+	{
+		const Vector3D rayStart(random.RandomFloat(bounds.minPoint.x - 2.0f, bounds.maxPoint.x + 2.0f), random.RandomFloat(-3.0f, 5.0f), random.RandomFloat(bounds.minPoint.z - 2.0f, bounds.maxPoint.z + 2.0f));
+		const Vector3D rayTarget(random.RandomFloat(bounds.minPoint.x, bounds.maxPoint.x), random.RandomFloat(-1.0f, 2.0f), random.RandomFloat(bounds.minPoint.z, bounds.maxPoint.z));
+
+		// straight down rays hit grids most of the time
+		const Vector3D rayDir = (i % 4) ? rayTarget - rayStart : -vec3_up * 10.0f;
+
+		const float bruteFraction = BVHTestBruteForceRay(meshGroupDesc, triangles, rayStart, rayDir);
+		EXPECT_FLOAT_EQ(bvh.TestRay(rayStart, rayDir), bruteFraction) << "ray " << i;
+
+		// limited ray stops before the hit
+		if (bruteFraction < F_INFINITY)
+		{
+			EXPECT_EQ(bvh.TestRay(rayStart, rayDir, bruteFraction * 0.5f), F_INFINITY) << "ray " << i;
+			++numHits;
+		}
+	}
+
+	EXPECT_GT(numHits, s_bvhTestRays / 4);
+}
+
+TEST_F(STUDIO_BVH_TESTS, BoxesMatchBruteForce)
+{
+	CUniformRandomStream random;
+	random.SetSeed(1416);
+
+	const BoundingBox bounds = bvh.GetBounds();
+	ArrayCRef<CStudioMeshBVH::Triangle> bvhTriangles = bvh.GetTriangles();
+
+	Array<int> reportCount(PP_SL);
+	for (int i = 0; i < s_bvhTestBoxes; ++i)
+	{
+		const Vector3D center(random.RandomFloat(bounds.minPoint.x, bounds.maxPoint.x), random.RandomFloat(-1.0f, 2.0f), random.RandomFloat(bounds.minPoint.z, bounds.maxPoint.z));
+		const Vector3D extents(random.RandomFloat(0.05f, 1.5f), random.RandomFloat(0.05f, 1.0f), random.RandomFloat(0.05f, 1.5f));
+		const BoundingBox box(center - extents, center + extents);
+
+		reportCount.setNum(bvhTriangles.numElem(), false);
+		memset(reportCount.ptr(), 0, reportCount.numElem() * sizeof(int));
+		bvh.QueryBox(box, [&](int triIdx) { ++reportCount[triIdx]; });
+
+		// leaves are tested by their bounds so only intersecting triangles must be there
+		for (int j = 0; j < bvhTriangles.numElem(); ++j)
+		{
+			EXPECT_LE(reportCount[j], 1) << "box " << i << " triangle " << j;
+
+			Vector3D v0, v1, v2;
+			bvh.GetTriangleVerts(bvhTriangles[j], v0, v1, v2);
+
+			BoundingBox triBox;
+			triBox.AddVertex(v0);
+			triBox.AddVertex(v1);
+			triBox.AddVertex(v2);
+
+			if (triBox.Intersects(box))
+				EXPECT_EQ(reportCount[j], 1) << "box " << i << " triangle " << j;
+		}
+	}
+}
+
+// second half of grid is lifted by it's bone
+class STUDIO_DECAL_TESTS : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		GenerateBVHTestGrid(meshes.append(), vec3_zero, 0.0f, STUDIO_PRIM_TRI_STRIP, true);
+
+		bvh.Build(BuildBVHTestMeshGroup(meshes, buffer));
+		meshGroupBVHs.append(&bvh);
+
+		Matrix4x4 liftMatrix = identity4;
+		liftMatrix.setTranslation(Vector3D(0.0f, s_liftHeight, 0.0f));
+
+		skinMatrices.append(identity4);
+		skinMatrices.append(liftMatrix);
+	}
+
+	DecalMakeInfo MakeInfo(const Vector3D& origin) const
+	{
+		DecalMakeInfo info;
+		info.origin = origin;
+		info.size = Vector3D(1.0f);
+		info.normal = -vec3_up;
+		info.flags = DECAL_MAKE_FLAG_CLIPPING;
+		return info;
+	}
+
+	static constexpr const float s_liftHeight = 5.0f;
+
+	Array<BVHTestMesh>				meshes{ PP_SL };
+	Array<ubyte>					buffer{ PP_SL };
+	CStudioMeshBVH					bvh;
+	Array<const CStudioMeshBVH*>	meshGroupBVHs{ PP_SL };
+	Array<Matrix4x4>				skinMatrices{ PP_SL };
+};
+
+TEST_F(STUDIO_DECAL_TESTS, ProjectedOnSkinnedPose)
+{
+	const float gridSize = s_bvhTestGridSize * s_bvhTestCellSize;
+	const Vector3D liftedOrigin(gridSize * 0.75f, s_liftHeight, gridSize * 0.5f);
+	const DecalMakeInfo info = MakeInfo(liftedOrigin);
+
+	CRefPtr<DecalData> decal = Studio_MakeDecal(meshGroupBVHs, skinMatrices, info);
+	ASSERT_NE(decal.Ptr(), nullptr);
+	EXPECT_EQ(decal->flags, DECAL_FLAG_STUDIODECAL);
+	EXPECT_GT(decal->numIndices, 0);
+	EXPECT_EQ(decal->numIndices % 3, 0);
+
+	// bounds are in skinned pose and clipped by decal box
+	const BoundingBox decalBox(info.origin - info.size, info.origin + info.size);
+	EXPECT_TRUE(decalBox.Contains(decal->bbox.minPoint, F_EPS));
+	EXPECT_TRUE(decalBox.Contains(decal->bbox.maxPoint, F_EPS));
+	EXPECT_NEAR(decal->bbox.GetCenter().x, liftedOrigin.x, 0.01f);
+	EXPECT_NEAR(decal->bbox.GetCenter().y, liftedOrigin.y, 0.01f);
+
+	// vertices stay in bind pose with weights of the bone, so decal follows the model
+	const EGFHwVertex::PositionUV* posUvs = reinterpret_cast<const EGFHwVertex::PositionUV*>(decal->verts);
+	const EGFHwVertex::TBN* tbns = reinterpret_cast<const EGFHwVertex::TBN*>(posUvs + decal->numVerts);
+	const EGFHwVertex::BoneWeights* boneWeights = reinterpret_cast<const EGFHwVertex::BoneWeights*>(tbns + decal->numVerts);
+	for (int i = 0; i < decal->numVerts; ++i)
+	{
+		const Vector3D position(posUvs[i].point.x, posUvs[i].point.y, posUvs[i].point.z);
+		EXPECT_NEAR(position.y, 0.0f, F_EPS);
+		EXPECT_TRUE(decalBox.Contains(transformPoint(position, skinMatrices[1]), 0.01f));
+		EXPECT_EQ(boneWeights[i].bones[0], 1);
+		EXPECT_EQ(boneWeights[i].weight[0], 255);
+	}
+
+	for (int i = 0; i < decal->numIndices; ++i)
+		EXPECT_LT(decal->indices[i], decal->numVerts);
+}
+
+TEST_F(STUDIO_DECAL_TESTS, BindPoseIsNotHit)
+{
+	const float gridSize = s_bvhTestGridSize * s_bvhTestCellSize;
+
+	// lifted half is not at it's bind pose location anymore
+	EXPECT_EQ(Studio_MakeDecal(meshGroupBVHs, skinMatrices, MakeInfo(Vector3D(gridSize * 0.75f, 0.0f, gridSize * 0.5f))).Ptr(), nullptr);
+
+	// and without skinning there is nothing where it was lifted to
+	EXPECT_EQ(Studio_MakeDecal(meshGroupBVHs, nullptr, MakeInfo(Vector3D(gridSize * 0.75f, s_liftHeight, gridSize * 0.5f))).Ptr(), nullptr);
+	EXPECT_NE(Studio_MakeDecal(meshGroupBVHs, nullptr, MakeInfo(Vector3D(gridSize * 0.75f, 0.0f, gridSize * 0.5f))).Ptr(), nullptr);
+
+	// unmoved half is hit at the same place in both poses
+	EXPECT_NE(Studio_MakeDecal(meshGroupBVHs, skinMatrices, MakeInfo(Vector3D(gridSize * 0.25f, 0.0f, gridSize * 0.5f))).Ptr(), nullptr);
+}
@@ -20,9 +20,13 @@
 
 #include "render/IDebugOverlay.h"
 #include "render/StudioRenderDefs.h"
+#include "render/RenderDrawBucket.h"
 
 #define INITIAL_TIME 0.0f
 
+// model meshes are recorded and drawn sorted by material and buffers
+static CRenderDrawBucket s_modelDrawBucket;
+
 CAnimatedModel::CAnimatedModel()
 {
 	m_pModel = nullptr;
@@ -393,7 +397,14 @@ void CAnimatedModel::Render(int nViewRenderFlags, float fDist, int startLod, boo
 	drawProperties.boneTransforms = g_matSystem->GetTransientUniformBuffer(boneTransforms, numBones * sizeof(RenderBoneTransform));
 	drawProperties.lod = startLOD;
 	drawProperties.bodyGroupFlags = m_bodyGroupFlags;
-	m_pModel->Draw(drawProperties, instData, RenderPassContext(rendPassRecorder, nullptr));
+	drawProperties.drawBucket = &s_modelDrawBucket;
+
+	const RenderPassContext passContext(rendPassRecorder, nullptr);
+
+	s_modelDrawBucket.Clear();
+	m_pModel->Draw(drawProperties, instData, passContext);
+	s_modelDrawBucket.Sort();
+	s_modelDrawBucket.Submit(passContext);
 
 	if(nViewRenderFlags & RFLAG_PHYSICS)
 		RenderPhysModel(rendPassRecorder);
@@ -11,6 +11,8 @@
 #include "core/IDkCore.h"
 #include "core/IFileSystem.h"
 #include "core/ICommandLine.h"
+#include "core/IEqCPUServices.h"
+#include "core/platform/eqjobmanager.h"
 #include "utils/KeyValues.h"
 
 #include "dpk/DPKFileWriter.h"
@@ -31,6 +33,8 @@
 static void Usage()
 {
 	MsgWarning("USAGE:\n	fcompress -target <target name> -set <key> <value>\n");
+	MsgWarning("			-incremental		- reuse compressed files from existing package\n");
+	MsgWarning("			-threads <count>	- number of compression threads\n");
 #if REPACK_SUPPORT
 	MsgWarning("			fcompress -repack <EPK v6 filename>\n");
 #endif
@@ -382,7 +386,7 @@ static bool CheckExtensionList(Array<EqString>& extList, const char* ext)
 }
 
 
-static void CookPackageTarget(const char* targetName)
+static void CookPackageTarget(const char* targetName, CEqJobManager* jobMng, bool incremental)
 {
 	// load all properties
 	KeyValues kvs;
@@ -440,6 +444,8 @@ static void CookPackageTarget(const char* targetName)
 	keyValueFileExt.append("txt");
 
 	CDPKFileWriter dpkWriter(mountPath, targetCompression, encryption);
+	dpkWriter.SetJobManager(jobMng);
+
 	CFileListBuilder fileListBuilder;
 
 	for (int i = 0; i < currentTarget->KeyCount(); ++i)
@@ -488,9 +494,26 @@ static void CookPackageTarget(const char* targetName)
 		return;
 	}
 
+	// previous package is moved away and its blocks are copied for unchanged files
+	const EqString prevPackageFileName = outputFileName + ".prev";
+	bool movedPrevPackage = false;
+	if (incremental && g_fileSystem->FileExist(outputFileName, SP_ROOT))
+	{
+		if (g_fileSystem->FileExist(prevPackageFileName, SP_ROOT))
+			g_fileSystem->FileRemove(prevPackageFileName, SP_ROOT);
+
+		g_fileSystem->Rename(outputFileName, prevPackageFileName, SP_ROOT);
+		movedPrevPackage = g_fileSystem->FileExist(prevPackageFileName, SP_ROOT);
+	}
+
+	CEqTimer timer;
+
+	bool packageBuilt = false;
 	if (dpkWriter.Begin(outputFileName.ToCString()))
 	{
-		uint64 packedSizeTotal = 0;
+		if (movedPrevPackage && dpkWriter.SetPreviousPackage(prevPackageFileName))
+			MsgInfo("Incremental build, reusing files from previous package\n");
+
 		uint64 originalSizeTotal = 0;
 
 		StartPacifier("Adding files, this may take a while: ");
@@ -526,6 +549,12 @@ static void CookPackageTarget(const char* targetName)
 			if (loadRawFile)
 			{
 				stream = g_fileSystem->Open(fileInfo.fileName, "rb", SP_ROOT);
+				if (!stream)
+				{
+					MsgError("Cannot open file '%s'\n", fileInfo.fileName.ToCString());
+					break;
+				}
+
 				if (fnmPathExtractExt(fileInfo.fileName) == s_dpkPackageDefaultExt)
 				{
 					// validate EPK file
@@ -543,10 +572,8 @@ static void CookPackageTarget(const char* targetName)
 				}
 			}
 
-			const uint packedSize = dpkWriter.Add(stream, fileInfo.aliasName, targetFileFlags);
-
+			dpkWriter.Add(stream, fileInfo.aliasName, targetFileFlags);
 			originalSizeTotal += stream->GetSize();
-			packedSizeTotal += packedSize;
 
 			if ((dpkWriter.GetFileCount() % 500) == 0)
 				dpkWriter.Flush();
@@ -557,13 +584,40 @@ static void CookPackageTarget(const char* targetName)
 
 		EndPacifier();
 
-		const float compressionRatio = 1.0f - (float)packedSizeTotal / (float)originalSizeTotal;
-		Msg("Compression is %.2f %%\n", compressionRatio * 100.0f);
-
+		// pending files are written here
 		dpkWriter.End();
+
+		packageBuilt = (numFilesProcessed == maxFiles);
+		if (packageBuilt)
+		{
+			const int reusedFiles = dpkWriter.GetReusedFileCount();
+			const uint64 packedSizeTotal = dpkWriter.GetPackedSize();
+
+			const double packTime = timer.GetTime();
+			const double originalSizeMB = originalSizeTotal / (1024.0 * 1024.0);
+
+			const float compressionRatio = 1.0f - (float)packedSizeTotal / (float)originalSizeTotal;
+			Msg("Compression is %.2f %%\n", compressionRatio * 100.0f);
+			Msg("Packed %d files (%.2f MB, %d reused) in %.2f seconds, %.2f MB/s with %d threads\n", 
+				numFilesProcessed, originalSizeMB, reusedFiles, packTime, packTime > 0.0 ? originalSizeMB / packTime : 0.0, jobMng ? jobMng->GetJobThreadsCount() + 1 : 1);
+		}
+		else
+		{
+			MsgError("Package '%s' is incomplete and was removed\n", outputFileName.ToCString());
+			g_fileSystem->FileRemove(outputFileName, SP_ROOT);
+		}
 	}
 	else
 		MsgError("Cannot create package file '%s'!\n", outputFileName.ToCString());
+
+	if (!movedPrevPackage)
+		return;
+
+	// previous package is kept when the new one wasn't built
+	if (packageBuilt)
+		g_fileSystem->FileRemove(prevPackageFileName, SP_ROOT);
+	else
+		g_fileSystem->Rename(prevPackageFileName, outputFileName, SP_ROOT);
 }
 
 int main(int argc, char **argv)
@@ -600,13 +654,24 @@ int main(int argc, char **argv)
 
 	EqString outFileName = "";
 
+	const bool incremental = g_cmdLine->FindArgument("-incremental") != -1;
+
+	// calling thread also compresses blocks
+	int numThreads = g_cpuCaps->GetCPUCount() - 1;
+	const int threadsArgIdx = g_cmdLine->FindArgument("-threads");
+	if (threadsArgIdx != -1)
+		numThreads = atoi(g_cmdLine->GetArgumentsOf(threadsArgIdx)) - 1;
+
+	CEqJobManager jobMng("fcompressJobs", max(1, numThreads), 1024);
+	CEqJobManager* compressJobMng = numThreads > 0 ? &jobMng : nullptr;
+
 	for (int i = 0; i < g_cmdLine->GetArgumentCount(); i++)
 	{
 		EqString argStr = g_cmdLine->GetArgumentString(i);
 
 		if (!argStr.CompareCaseIns("-target"))
 		{
-			CookPackageTarget(g_cmdLine->GetArgumentsOf(i));
+			CookPackageTarget(g_cmdLine->GetArgumentsOf(i), compressJobMng, incremental);
 		}
 		else if (!argStr.CompareCaseIns("-set") && g_cmdLine->GetArgumentCount())
 		{
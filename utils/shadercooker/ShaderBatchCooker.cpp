@@ -27,6 +27,7 @@ Targets
 		sourcepath 		"EqBase/shadersSRC/";
 		output			"EqBase/shaders";
 		sourceext		".def";
+		cachepath		"EqBase/shaders_cache";	// compiled object cache, default is output folder + "_cache"
 	}
 }
 */
@@ -34,6 +35,10 @@ Targets
 static constexpr EqStringRef s_engineDirTag("%ENGINE_DIR%");
 static constexpr EqStringRef s_gameDirTag("%GAME_DIR%");
 
+// identifies compiler settings in object hash, see SetupCompileOptions
+static constexpr EqStringRef s_compileOptionsId("shaderc 450 webgpu performance v1");
+static constexpr const uint32 s_spirvMagic = 0x07230203;
+
 
 //-------------------------------------
 
@@ -49,18 +54,33 @@ public:
 	void				Execute();
 
 private:
+	struct VariantTask
+	{
+		int		shaderIdx;
+		int		vertLayoutIdx;
+		int		nSwitch;
+	};
+
 	void				SearchFolderForShaders(const char* wildcard);
-	bool				HasMatchingCRC(uint32 crc);
+	bool				HasMatchingHash(uint64 hash);
 
 	bool				ParseShaderInfo(const char* shaderDefFileName, const KVSection* shaderSection, bool isExt = false);
 	bool				ParseShaderExtensionInfo(const char* shaderDefFileName, const KVSection* shaderSection);
 	void				InitShaderVariants(ShaderInfo& shaderInfo, int baseVariant, const KVSection* section);
-	void				ProcessShader(ShaderInfo& shaderInfo);
+
+	bool				PrepareShader(int shaderIdx);
+	void				CompileVariant(const VariantTask& task);
+	void				WriteShaderPackage(ShaderInfo& shaderInfo);
+
+	void				SetupCompileOptions(shaderc::CompileOptions& options, const ShaderInfo& shaderInfo, const ShaderInfo::VertLayout& vertexLayout, int kind, int nSwitch) const;
+	EqString			GetCacheFileName(uint64 hash) const;
+	bool				LoadCachedObject(uint64 hash, Array<uint32>& spirv) const;
+	void				StoreCachedObject(uint64 hash, ArrayCRef<uint32> spirv) const;
 
 	struct BatchConfig
 	{
-		KVSection	crcSec;			// crc list loaded from disk
-		KVSection	newCRCSec;		// crc list that will be saved
+		KVSection	crcSec;			// package hash list loaded from disk
+		KVSection	newCRCSec;		// package hash list that will be saved
 	};
 
 	struct TargetProperties
@@ -69,6 +89,7 @@ private:
 		EqString		sourceShaderPath;
 		EqString		sourceShaderDescExt;
 		EqString		targetFolder;
+		EqString		cacheFolder;
 	};
 
 	CEqJobManager&		m_jobMng;
@@ -76,6 +97,14 @@ private:
 	TargetProperties	m_targetProps;
 
 	Array<ShaderInfo>	m_shaderList{ PP_SL };
+	Array<VariantTask>	m_variantTasks{ PP_SL };
+
+	uint64				m_compilerHash{ 0 };	// compiler version, all object hashes start with it
+
+	volatile int		m_nextTask{ 0 };
+	volatile int		m_numCompiled{ 0 };
+	volatile int		m_numCacheHits{ 0 };
+	volatile int		m_numFailed{ 0 };
 };
 
 //-----------------------------------------------------------------------
@@ -306,12 +335,12 @@ void CShaderCooker::SearchFolderForShaders(const char* wildcard)
 	}
 }
 
-bool CShaderCooker::HasMatchingCRC(uint32 crc)
+bool CShaderCooker::HasMatchingHash(uint64 hash)
 {
 	for (KVSection* crcEntry : m_batchConfig.crcSec.Keys())
 	{
-		uint32 checkCRC = strtoul(crcEntry->GetName(), nullptr, 10);
-		if (checkCRC == crc)
+		const uint64 checkHash = strtoull(crcEntry->GetName(), nullptr, 10);
+		if (checkHash == hash)
 			return true;
 	}
 
@@ -401,76 +430,179 @@ void CShaderCooker::InitShaderVariants(ShaderInfo& shaderInfo, int baseVariantId
 	}
 }
 
-void CShaderCooker::ProcessShader(ShaderInfo& shaderInfo)
+static uint64 ShaderHashAppend(uint64 hash, const void* data, int size)
+{
+	return HashMapMix(hash ^ HashMapHashBytes(data, size));
+}
+
+static uint64 ShaderHashAppend(uint64 hash, EqStringRef str)
+{
+	return ShaderHashAppend(hash, str.ToCString(), str.Length());
+}
+
+// shaderc has no version query, so SPIR-V version it targets and generator word
+// (tool id and glslang version) of trivial shader are identifying the compiler
+static uint64 GetCompilerVersionHash()
+{
+	uint spirvVersion = 0;
+	uint spirvRevision = 0;
+	shaderc_get_spv_version(&spirvVersion, &spirvRevision);
+
+	uint64 hash = ShaderHashAppend(0, &spirvVersion, sizeof(spirvVersion));
+	hash = ShaderHashAppend(hash, &spirvRevision, sizeof(spirvRevision));
+
+	static constexpr EqStringRef probeSource("#version 450\nvoid main() { gl_Position = vec4(0.0); }\n");
+
+	shaderc::Compiler compiler;
+	shaderc::CompileOptions options;
+	options.SetTargetEnvironment(shaderc_target_env_webgpu, 0);
+
+	shaderc::SpvCompilationResult probeResult = compiler.CompileGlslToSpv(probeSource.ToCString(), probeSource.Length(), shaderc_vertex_shader, "compiler_version", options);
+	if (probeResult.GetCompilationStatus() != shaderc_compilation_status_success || probeResult.end() - probeResult.begin() < 3)
+	{
+		MsgWarning("Unable to get shader compiler version\n");
+		return hash;
+	}
+
+	const uint32 generator = probeResult.begin()[2];
+	hash = ShaderHashAppend(hash, &generator, sizeof(generator));
+
+	MsgInfo("Shader compiler: SPIR-V %u.%u revision %u, generator %u version %u\n", (spirvVersion >> 16) & 0xff, (spirvVersion >> 8) & 0xff, spirvRevision, generator >> 16, generator & 0xffff);
+	return hash;
+}
+
+static EqStringRef ShaderKindMacro(int kind)
+{
+	if (kind == SHADERKIND_VERTEX)
+		return "VERTEX";
+	else if (kind == SHADERKIND_FRAGMENT)
+		return "FRAGMENT";
+	return "COMPUTE";
+}
+
+static shaderc_shader_kind ShaderKindToShaderC(int kind)
+{
+	if (kind == SHADERKIND_VERTEX)
+		return shaderc_vertex_shader;
+	else if (kind == SHADERKIND_FRAGMENT)
+		return shaderc_fragment_shader;
+	return shaderc_compute_shader;
+}
+
+// Same options are used for preprocessing and compilation.
+// Change s_compileOptionsId when changing this function so object cache gets invalidated
+void CShaderCooker::SetupCompileOptions(shaderc::CompileOptions& options, const ShaderInfo& shaderInfo, const ShaderInfo::VertLayout& vertexLayout, int kind, int nSwitch) const
+{
+	std::unique_ptr<EqShaderIncluder> includer = std::make_unique<EqShaderIncluder>(shaderInfo, m_targetProps.includePaths);
+	includer->SetVertexLayout(vertexLayout.name);
+
+	options.SetSourceLanguage(s_sourceLanguage[shaderInfo.sourceType]);
+	options.SetOptimizationLevel(shaderc_optimization_level_performance);
+	options.SetIncluder(std::move(includer));
+	options.AddMacroDefinition(ShaderKindMacro(kind).ToCString());
+	options.SetForcedVersionProfile(450, shaderc_profile_none);
+	options.SetTargetEnvironment(shaderc_target_env_webgpu, 0);
+
+	for (int j = 0; j < shaderInfo.switchDefines.numElem(); ++j)
+	{
+		if (nSwitch & (1 << j))
+			options.AddMacroDefinition(shaderInfo.switchDefines[j], shaderInfo.switchDefines[j].Length(), nullptr, 0u);
+	}
+}
+
+EqString CShaderCooker::GetCacheFileName(uint64 hash) const
+{
+	EqString fileName;
+	fnmPathCombine(fileName, m_targetProps.cacheFolder, EqString::Format("%016llx.spv", (unsigned long long)hash));
+	return fileName;
+}
+
+bool CShaderCooker::LoadCachedObject(uint64 hash, Array<uint32>& spirv) const
+{
+	IFilePtr file = g_fileSystem->Open(GetCacheFileName(hash), "rb", SP_ROOT);
+	if (!file)
+		return false;
+
+	const int numWords = file->GetSize() / sizeof(uint32);
+	if (numWords == 0 || file->GetSize() % sizeof(uint32))
+		return false;
+
+	spirv.setNum(numWords);
+	if (file->Read(spirv.ptr(), numWords, sizeof(uint32)) != numWords || spirv[0] != s_spirvMagic)
+	{
+		spirv.clear();
+		return false;
+	}
+
+	return true;
+}
+
+void CShaderCooker::StoreCachedObject(uint64 hash, ArrayCRef<uint32> spirv) const
+{
+	const EqString cacheFileName = GetCacheFileName(hash);
+	if (g_fileSystem->FileExist(cacheFileName, SP_ROOT))
+		return;
+
+	// other thread might be reading same object, write it under temporary name first
+	const EqString tempFileName = EqString::Format("%s.%llu", cacheFileName.ToCString(), (unsigned long long)Threading::GetCurrentThreadID());
+	{
+		IFilePtr file = g_fileSystem->Open(tempFileName, "wb", SP_ROOT);
+		if (!file)
+			return;
+		file->Write(spirv.ptr(), spirv.numElem(), sizeof(uint32));
+	}
+
+	if (g_fileSystem->FileExist(cacheFileName, SP_ROOT))
+		g_fileSystem->FileRemove(tempFileName, SP_ROOT);
+	else
+		g_fileSystem->Rename(tempFileName, cacheFileName, SP_ROOT);
+}
+
+bool CShaderCooker::PrepareShader(int shaderIdx)
 {
-	EqString shaderSourceName;
+	ShaderInfo& shaderInfo = m_shaderList[shaderIdx];
+
 	if (shaderInfo.isExt)
 	{
 		for (const EqString& path : m_targetProps.includePaths)
 		{
-			fnmPathCombine(shaderSourceName, path, shaderInfo.sourceFilename);
-			if (g_fileSystem->FileExist(shaderSourceName, SP_ROOT))
+			fnmPathCombine(shaderInfo.sourcePath, path, shaderInfo.sourceFilename);
+			if (g_fileSystem->FileExist(shaderInfo.sourcePath, SP_ROOT))
 				break;
 		}
 	}
 	else
-		fnmPathCombine(shaderSourceName, m_targetProps.sourceShaderPath, shaderInfo.sourceFilename);
+		fnmPathCombine(shaderInfo.sourcePath, m_targetProps.sourceShaderPath, shaderInfo.sourceFilename);
 
-	CMemoryStream shaderSourceString(PP_SL);
 	{
-		IFilePtr file = g_fileSystem->Open(shaderSourceName, "r", SP_ROOT);
+		IFilePtr file = g_fileSystem->Open(shaderInfo.sourcePath, "r", SP_ROOT);
 		if (!file)
 		{
 			MsgError("Unable to open source file for %s\n", shaderInfo.name.ToCString());
-			return;
+			shaderInfo.status = SHADERCONV_FAILED;
+			return false;
 		}
-		shaderSourceString.Open(nullptr, VS_OPEN_READ | VS_OPEN_WRITE, file->GetSize());
-		shaderSourceString.AppendStream(file);
-	}
-
-	// generate CRC from shader source file and append to the shader desc CRC
-	uint32 srcCRC = shaderInfo.crc32;
-	CRC32_UpdateChecksum(srcCRC, shaderSourceString.GetBasePointer(), shaderSourceString.GetSize());
-
-	EqString targetFileName;
-	fnmPathCombine(targetFileName, m_targetProps.targetFolder, EqString::Format("%s.shd", shaderInfo.name.ToCString()));
 
-	// now check CRC from loaded file
-	if (HasMatchingCRC(srcCRC))
-	{
-		// check if  output exists
-		if (g_fileSystem->FileExist(targetFileName, SP_ROOT))
-		{
-			// store new CRC
-			m_batchConfig.newCRCSec.SetKey(EqString::Format("%u", srcCRC), shaderInfo.sourceFilename);
-
-			MsgInfo("Skipping shader '%s' (no changes made)\n", shaderInfo.name.ToCString());
-			return;
-		}
+		CMemoryStream sourceStream(nullptr, VS_OPEN_READ | VS_OPEN_WRITE, file->GetSize(), PP_SL);
+		sourceStream.AppendStream(file);
+		shaderInfo.sourceText = EqString((const char*)sourceStream.GetBasePointer(), sourceStream.GetSize());
 	}
 
 	// collect all defines into flat list
-	int numDefines = 0;
-	Array<EqString> switchDefines(PP_SL);
-
+	shaderInfo.switchDefines.clear();
 	for (const ShaderInfo::Variant& variant : shaderInfo.variants)
 	{
 		if(variant.baseVariant != -1)
-			switchDefines.append(variant.defines);
+			shaderInfo.switchDefines.append(variant.defines);
 	}
 
-	MsgWarning("Processing shader %s (%d vertex layouts %d defines)\n", shaderInfo.name.ToCString(), shaderInfo.vertexLayouts.numElem(), switchDefines.numElem());
+	shaderInfo.variantCount = 1 << shaderInfo.switchDefines.numElem();
 
-	const int totalVariantCount = 1 << switchDefines.numElem();
+	// results are stored by slots so package contents do not depend on job order
+	shaderInfo.results.setNum(shaderInfo.vertexLayouts.numElem() * shaderInfo.variantCount * shaderInfo.entryPoints.numElem());
 
-	// reserve variant count * (vertex + fragment)
-	shaderInfo.results.reserve(shaderInfo.vertexLayouts.numElem() * totalVariantCount * 2);
+	MsgWarning("Processing shader %s (%d vertex layouts %d defines)\n", shaderInfo.name.ToCString(), shaderInfo.vertexLayouts.numElem(), shaderInfo.switchDefines.numElem());
 
-	ArrayCRef<EqString> includePaths(m_targetProps.includePaths);
-
-	bool compileErrors = false;
-
-	CEqMutex resultsMutex;
 	for (int vertLayoutIdx = 0; vertLayoutIdx < shaderInfo.vertexLayouts.numElem(); ++vertLayoutIdx)
 	{
 		const ShaderInfo::VertLayout& vertexLayout = shaderInfo.vertexLayouts[vertLayoutIdx];
@@ -481,303 +613,347 @@ void CShaderCooker::ProcessShader(ShaderInfo& shaderInfo)
 			continue;
 		}
 
-		MsgWarning("   Compiling for vertex %s\n", vertexLayout.name.ToCString());
-		for (int i = 0; i < totalVariantCount; ++i)
-		{
-			FunctionJob* funcJob = PPNew FunctionJob(vertexLayout.name, 
-				[includePaths, &resultsMutex, &shaderSourceString, &shaderSourceName, &compileErrors, &shaderInfo, vertexLayout, &switchDefines, nSwitch = i, vertLayoutIdx](void*, int) {
-				EqString queryStr;
-				for (int j = 0; j < switchDefines.numElem(); ++j)
-				{
-					if (nSwitch & (1 << j))
-					{
-						if (arrayFindIndex(vertexLayout.excludeDefines, switchDefines[j]) != -1)
-						{
-							MsgWarning("Skipping %s %s\n", vertexLayout.name.ToCString(), switchDefines[j].ToCString());
-							return;
-						}
-
-						if (queryStr.Length())
-							queryStr.Append("|");
-						queryStr.Append(switchDefines[j]);
-					}
-				}
-
-				auto foundDefineLen = [](const char* str)
-					{
-						const char* p = str;
-						while (!(*p == 0 || *p == '|'))
-							++p;
-						return p - str;
-					};
-
-				for (const ShaderInfo::SkipCombo& skip : shaderInfo.skipCombos)
-				{
-					if (skip.defines.numElem() == 0)
-						continue;
-
-					int foundCount = 0;
-					for (const EqString& define : skip.defines)
-					{
-						const int foundIdx = queryStr.Find(define, true);
-						if (foundIdx != -1 && foundDefineLen(queryStr.ToCString() + foundIdx) == define.Length())
-						{
-							++foundCount;
-						}
-					}
-					if (foundCount == skip.defines.numElem())
-						return;
-				}
+		for (int i = 0; i < shaderInfo.variantCount; ++i)
+			m_variantTasks.append(VariantTask{ shaderIdx, vertLayoutIdx, i });
+	}
 
-				shaderc::Compiler compiler;
-				auto fillMacros = [vertexLayout, &queryStr, &switchDefines, nSwitch](shaderc::CompileOptions& options) {
-					for (int j = 0; j < switchDefines.numElem(); ++j)
-					{
-						if (nSwitch & (1 << j))
-							options.AddMacroDefinition(switchDefines[j], switchDefines[j].Length(), nullptr, 0u);
-					}
-				};
+	return true;
+}
 
-				auto compileShaderKind = [&](int entryPointId, const ShaderInfo::EntryPoint& entryPoint)
-				{
-					EqStringRef kindMacroStr;
-					shaderc_shader_kind shaderCKind;
-
-					if (entryPoint.kind == SHADERKIND_VERTEX)
-					{
-						kindMacroStr = "VERTEX";
-						shaderCKind = shaderc_vertex_shader;
-					}
-					else if (entryPoint.kind == SHADERKIND_FRAGMENT)
-					{
-						kindMacroStr = "FRAGMENT";
-						shaderCKind = shaderc_fragment_shader;
-					}
-					else if (entryPoint.kind == SHADERKIND_COMPUTE)
-					{
-						kindMacroStr = "COMPUTE";
-						shaderCKind = shaderc_compute_shader;
-					}
-
-					std::unique_ptr<EqShaderIncluder> includer = std::make_unique<EqShaderIncluder>(shaderInfo, includePaths);
-					includer->SetVertexLayout(vertexLayout.name);
-
-					shaderc::CompileOptions options;
-					options.SetSourceLanguage(s_sourceLanguage[shaderInfo.sourceType]);
-					options.SetOptimizationLevel(shaderc_optimization_level_performance);
-					options.SetIncluder(std::move(includer));
-					options.AddMacroDefinition(kindMacroStr.ToCString());
-					options.SetForcedVersionProfile(450, shaderc_profile_none);
-					options.SetTargetEnvironment(shaderc_target_env_webgpu, 0);
-
-					fillMacros(options);
-
-					shaderc::SpvCompilationResult compilationResult = compiler.CompileGlslToSpv(
-						(const char*)shaderSourceString.GetBasePointer(),
-						shaderSourceString.GetSize(),
-						shaderCKind,
-						shaderSourceName,
-						entryPoint.name,
-						options
-					);
-					const shaderc_compilation_status compileStatus = compilationResult.GetCompilationStatus();
-
-					if (compileStatus == shaderc_compilation_status_success)
-					{
-						uint32 resultCRC = 0;
-						CRC32_InitChecksum(resultCRC);
-						CRC32_UpdateChecksum(resultCRC, compilationResult.begin(), (compilationResult.end() - compilationResult.begin()) * sizeof(compilationResult.begin()[0]));
-
-						CScopedMutex m(resultsMutex);
-
-						// Reference shaders if they have same output
-						// TODO: make it so defines are detected for Vertex or Fragment.
-						const int refIdx = arrayFindIndexF(shaderInfo.results, [resultCRC](const ShaderInfo::Result& result) {
-							return resultCRC == result.crc32;
-						});
-
-						// store result
-						ShaderInfo::Result& result = shaderInfo.results.append();
-						if (refIdx == -1)
-						{
-							result.data = std::move(compilationResult);
-						}
-						else
-						{
-							ASSERT_MSG(entryPoint.kind == shaderInfo.results[refIdx].kindFlag, "Referenced shader kind is invalid (checksum collision?)");
-							result.refResult = refIdx;
-						}
-
-						result.queryStr = queryStr;
-						result.vertLayoutIdx = vertLayoutIdx;
-						result.entryPointId = entryPointId;
-						result.kindFlag = entryPoint.kind;
-						result.crc32 = resultCRC;
-					}
-					else
-					{
-						MsgError("Failed compiling %s %s\n%s\n", vertexLayout.name.ToCString(), queryStr.ToCString(), compilationResult.GetErrorMessage().c_str());
-						if (compileStatus == shaderc_compilation_status_compilation_error)
-							compileErrors = true;
-					}
-				};
-
-				int entryPointIdx = 0;
-				for (const ShaderInfo::EntryPoint& entryPoint : shaderInfo.entryPoints)
-				{
-					if (compileErrors)
-						break;
-					compileShaderKind(entryPointIdx, entryPoint);
-					++entryPointIdx;
-				}
+void CShaderCooker::CompileVariant(const VariantTask& task)
+{
+	ShaderInfo& shaderInfo = m_shaderList[task.shaderIdx];
+	if (shaderInfo.compileErrors)
+		return;
 
-				//if(!stopCompilation)
-				//	Msg("   - compiled variant '%s' (%d)\n", queryStr.ToCString(), nSwitch);
-			});
+	const ShaderInfo::VertLayout& vertexLayout = shaderInfo.vertexLayouts[task.vertLayoutIdx];
+	const ArrayCRef<EqString> switchDefines(shaderInfo.switchDefines);
+	const int nSwitch = task.nSwitch;
 
-			funcJob->DeleteOnFinish();
-			m_jobMng.InitStartJob(funcJob);
+	EqString queryStr;
+	for (int j = 0; j < switchDefines.numElem(); ++j)
+	{
+		if (nSwitch & (1 << j))
+		{
+			if (arrayFindIndex(vertexLayout.excludeDefines, switchDefines[j]) != -1)
+			{
+				MsgWarning("Skipping %s %s\n", vertexLayout.name.ToCString(), switchDefines[j].ToCString());
+				return;
+			}
 
-			if (compileErrors)
-				break;
+			if (queryStr.Length())
+				queryStr.Append("|");
+			queryStr.Append(switchDefines[j]);
 		}
 	}
-	m_jobMng.Wait();
 
-	// Store files
-	if (!compileErrors && shaderInfo.results.numElem())
-	{
-		CDPKFileWriter shaderPackFile("shaders", 4);
-		if (!shaderPackFile.Begin(targetFileName))
+	auto foundDefineLen = [](const char* str)
 		{
-			MsgError("Unable to create pack file %s\n", targetFileName.ToCString());
-			return;
-		}
+			const char* p = str;
+			while (!(*p == 0 || *p == '|'))
+				++p;
+			return p - str;
+		};
 
-		// store new CRC
-		m_batchConfig.newCRCSec.SetKey(EqString::Format("%u", srcCRC), shaderInfo.sourceFilename);
+	for (const ShaderInfo::SkipCombo& skip : shaderInfo.skipCombos)
+	{
+		if (skip.defines.numElem() == 0)
+			continue;
 
-		// Store shader info
-		KVSection shaderInfoKvs;
-		shaderInfoKvs.SetName(shaderInfo.name);
+		int foundCount = 0;
+		for (const EqString& define : skip.defines)
 		{
-			KVSection* definesSec = shaderInfoKvs.CreateSection("Defines");
-			for (EqString& defineStr : switchDefines)
-				definesSec->AddValue(defineStr);
+			const int foundIdx = queryStr.Find(define, true);
+			if (foundIdx != -1 && foundDefineLen(queryStr.ToCString() + foundIdx) == define.Length())
+			{
+				++foundCount;
+			}
 		}
+		if (foundCount == skip.defines.numElem())
+			return;
+	}
+
+	shaderc::Compiler compiler;
 
-		// store shader entry points
+	for (int entryPointIdx = 0; entryPointIdx < shaderInfo.entryPoints.numElem(); ++entryPointIdx)
+	{
+		if (shaderInfo.compileErrors)
+			break;
+
+		const ShaderInfo::EntryPoint& entryPoint = shaderInfo.entryPoints[entryPointIdx];
+		const shaderc_shader_kind shaderCKind = ShaderKindToShaderC(entryPoint.kind);
+
+		// includes are resolved by preprocessor so they are part of the hash
+		uint64 hash = m_compilerHash;
 		{
-			KVSection* entryPointsSec = shaderInfoKvs.CreateSection("EntryPoints");
-			for (const ShaderInfo::EntryPoint& entryPoint : shaderInfo.entryPoints)
+			shaderc::CompileOptions options;
+			SetupCompileOptions(options, shaderInfo, vertexLayout, entryPoint.kind, nSwitch);
+
+			shaderc::PreprocessedSourceCompilationResult preprocessResult = compiler.PreprocessGlsl(
+				shaderInfo.sourceText.ToCString(),
+				shaderInfo.sourceText.Length(),
+				shaderCKind,
+				shaderInfo.sourcePath,
+				options
+			);
+
+			if (preprocessResult.GetCompilationStatus() != shaderc_compilation_status_success)
 			{
-				EqStringRef kindNameStr;
-				if (entryPoint.kind == SHADERKIND_VERTEX)
-					kindNameStr = "Vertex";
-				else if (entryPoint.kind == SHADERKIND_FRAGMENT)
-					kindNameStr = "Fragment";
-				else if (entryPoint.kind == SHADERKIND_COMPUTE)
-					kindNameStr = "Compute";
-
-				entryPointsSec->AddKey(kindNameStr, entryPoint.name);
+				MsgError("Failed preprocessing %s %s\n%s\n", vertexLayout.name.ToCString(), queryStr.ToCString(), preprocessResult.GetErrorMessage().c_str());
+				Atomic::Exchange(shaderInfo.compileErrors, 1);
+				Atomic::Increment(m_numFailed);
+				break;
 			}
+
+			hash = ShaderHashAppend(hash, s_compileOptionsId);
+			hash = ShaderHashAppend(hash, preprocessResult.begin(), preprocessResult.end() - preprocessResult.begin());
+			hash = ShaderHashAppend(hash, queryStr);
+			hash = ShaderHashAppend(hash, vertexLayout.name);
+			hash = ShaderHashAppend(hash, entryPoint.name);
+			hash = ShaderHashAppend(hash, ShaderKindMacro(entryPoint.kind));
+			hash = ShaderHashAppend(hash, &shaderInfo.sourceType, sizeof(shaderInfo.sourceType));
 		}
 
-		// store vertex layout info
+		const int slot = (task.vertLayoutIdx * shaderInfo.variantCount + nSwitch) * shaderInfo.entryPoints.numElem() + entryPointIdx;
+		ShaderInfo::Result& result = shaderInfo.results[slot];
+
+		result.cached = LoadCachedObject(hash, result.spirv);
+		if (result.cached)
+		{
+			Atomic::Increment(m_numCacheHits);
+		}
+		else
 		{
-			KVSection* vertexLayoutsSec = shaderInfoKvs.CreateSection("VertexLayouts");
-			for (ShaderInfo::VertLayout& vertLayout : shaderInfo.vertexLayouts)
+			shaderc::CompileOptions options;
+			SetupCompileOptions(options, shaderInfo, vertexLayout, entryPoint.kind, nSwitch);
+
+			shaderc::SpvCompilationResult compilationResult = compiler.CompileGlslToSpv(
+				shaderInfo.sourceText.ToCString(),
+				shaderInfo.sourceText.Length(),
+				shaderCKind,
+				shaderInfo.sourcePath,
+				entryPoint.name,
+				options
+			);
+			const shaderc_compilation_status compileStatus = compilationResult.GetCompilationStatus();
+
+			if (compileStatus != shaderc_compilation_status_success)
 			{
-				KVSection* layoutSec = vertexLayoutsSec->CreateSection(vertLayout.name);
-				if (vertLayout.aliasOf != -1)
-				{
-					layoutSec->AddValue("aliasOf");
-					layoutSec->AddValue(shaderInfo.vertexLayouts[vertLayout.aliasOf].name);
-				}
+				MsgError("Failed compiling %s %s\n%s\n", vertexLayout.name.ToCString(), queryStr.ToCString(), compilationResult.GetErrorMessage().c_str());
+				if (compileStatus == shaderc_compilation_status_compilation_error)
+					Atomic::Exchange(shaderInfo.compileErrors, 1);
+				Atomic::Increment(m_numFailed);
+				continue;
 			}
+
+			const int numWords = compilationResult.end() - compilationResult.begin();
+			result.spirv.setNum(numWords);
+			memcpy(result.spirv.ptr(), compilationResult.begin(), numWords * sizeof(uint32));
+
+			StoreCachedObject(hash, result.spirv);
+			Atomic::Increment(m_numCompiled);
 		}
 
-		KVSection* shadersListSec = shaderInfoKvs.CreateSection("FileList");
+		uint32 resultCRC = 0;
+		CRC32_InitChecksum(resultCRC);
+		CRC32_UpdateChecksum(resultCRC, result.spirv.ptr(), result.spirv.numElem() * sizeof(uint32));
+
+		result.queryStr = queryStr;
+		result.vertLayoutIdx = task.vertLayoutIdx;
+		result.entryPointId = entryPointIdx;
+		result.kindFlag = entryPoint.kind;
+		result.crc32 = resultCRC;
+		result.hash = hash;
+	}
+}
+
+void CShaderCooker::WriteShaderPackage(ShaderInfo& shaderInfo)
+{
+	if (shaderInfo.compileErrors)
+	{
+		shaderInfo.status = SHADERCONV_FAILED;
+		return;
+	}
+
+	// package hash is made of shader desc and all variant hashes
+	uint64 packageHash = ShaderHashAppend(0, &shaderInfo.crc32, sizeof(shaderInfo.crc32));
+	int numResults = 0;
+	for (const ShaderInfo::Result& result : shaderInfo.results)
+	{
+		packageHash = ShaderHashAppend(packageHash, &result.hash, sizeof(result.hash));
+		if (result.kindFlag != -1)
+			++numResults;
+	}
+
+	if (!numResults)
+	{
+		shaderInfo.status = SHADERCONV_FAILED;
+		return;
+	}
+
+	EqString targetFileName;
+	fnmPathCombine(targetFileName, m_targetProps.targetFolder, EqString::Format("%s.shd", shaderInfo.name.ToCString()));
 
-		int shaderFileCount = 0;
-		Array<int> referenceRemap(PP_SL);
-		referenceRemap.setNum(shaderInfo.results.numElem());
+	const EqString packageHashStr = EqString::Format("%llu", (unsigned long long)packageHash);
+	if (HasMatchingHash(packageHash) && g_fileSystem->FileExist(targetFileName, SP_ROOT))
+	{
+		// store new hash
+		m_batchConfig.newCRCSec.SetKey(packageHashStr, shaderInfo.sourceFilename);
 
-		// Store shader SPIR-V output in separate files
+		MsgInfo("Skipping shader '%s' (no changes made)\n", shaderInfo.name.ToCString());
+		shaderInfo.status = SHADERCONV_SKIPPED;
+		return;
+	}
+
+	// Reference shaders if they have same output
+	// TODO: make it so defines are detected for Vertex or Fragment.
+	{
+		HashMap<uint32, int> resultByCRC{ PP_SL };
 		for (int i = 0; i < shaderInfo.results.numElem(); ++i)
 		{
-			const ShaderInfo::Result& result = shaderInfo.results[i];
-			const ShaderInfo::VertLayout& layout = shaderInfo.vertexLayouts[result.vertLayoutIdx];
-
-			if (result.refResult != -1)
+			ShaderInfo::Result& result = shaderInfo.results[i];
+			if (result.kindFlag == -1)
 				continue;
 
-			EqString shaderFileName = EqString::Format("%s-%s", layout.name.ToCString(), result.queryStr.ToCString());
-			KVSection* spvSec = shadersListSec->CreateSection("spv");
-			spvSec->AddValue(result.vertLayoutIdx);
-			
-			if (result.kindFlag == SHADERKIND_VERTEX)
+			auto it = resultByCRC.find(result.crc32);
+			if (it.atEnd())
 			{
-				spvSec->AddValue("Vertex");
-				shaderFileName.Append(".vert");
-			}
-			else if (result.kindFlag == SHADERKIND_FRAGMENT)
-			{
-				spvSec->AddValue("Fragment");
-				shaderFileName.Append(".frag");
-			}
-			else if (result.kindFlag == SHADERKIND_COMPUTE)
-			{
-				spvSec->AddValue("Compute");
-				shaderFileName.Append(".comp");
+				resultByCRC.insert(result.crc32, i);
+				continue;
 			}
 
-			spvSec->AddValue(shaderInfo.entryPoints[result.entryPointId].name);
-			spvSec->AddValue(result.queryStr);
+			ASSERT_MSG(result.kindFlag == shaderInfo.results[*it].kindFlag, "Referenced shader kind is invalid (checksum collision?)");
+			result.refResult = *it;
+		}
+	}
+
+	CDPKFileWriter shaderPackFile("shaders", 4);
+	if (!shaderPackFile.Begin(targetFileName))
+	{
+		MsgError("Unable to create pack file %s\n", targetFileName.ToCString());
+		shaderInfo.status = SHADERCONV_FAILED;
+		return;
+	}
 
-			// Write shader bytecode file
-			const uint32* shaderData = result.data.begin();
-			const uint32 size = result.data.end() - shaderData;
+	shaderInfo.status = SHADERCONV_COMPILED;
 
-			CMemoryStream readOnlyStream((ubyte*)shaderData, VS_OPEN_READ, size * sizeof(uint32), PP_SL);
-			shaderPackFile.Add(&readOnlyStream, shaderFileName);
+	// store new hash
+	m_batchConfig.newCRCSec.SetKey(packageHashStr, shaderInfo.sourceFilename);
 
-			referenceRemap[i] = shaderFileCount++;
+	// Store shader info
+	KVSection shaderInfoKvs;
+	shaderInfoKvs.SetName(shaderInfo.name);
+	{
+		KVSection* definesSec = shaderInfoKvs.CreateSection("Defines");
+		for (EqString& defineStr : shaderInfo.switchDefines)
+			definesSec->AddValue(defineStr);
+	}
+
+	// store shader entry points
+	{
+		KVSection* entryPointsSec = shaderInfoKvs.CreateSection("EntryPoints");
+		for (const ShaderInfo::EntryPoint& entryPoint : shaderInfo.entryPoints)
+		{
+			EqStringRef kindNameStr;
+			if (entryPoint.kind == SHADERKIND_VERTEX)
+				kindNameStr = "Vertex";
+			else if (entryPoint.kind == SHADERKIND_FRAGMENT)
+				kindNameStr = "Fragment";
+			else if (entryPoint.kind == SHADERKIND_COMPUTE)
+				kindNameStr = "Compute";
+
+			entryPointsSec->AddKey(kindNameStr, entryPoint.name);
 		}
+	}
 
-		for (int i = 0; i < shaderInfo.results.numElem(); ++i)
+	// store vertex layout info
+	{
+		KVSection* vertexLayoutsSec = shaderInfoKvs.CreateSection("VertexLayouts");
+		for (ShaderInfo::VertLayout& vertLayout : shaderInfo.vertexLayouts)
 		{
-			const ShaderInfo::Result& result = shaderInfo.results[i];
-			const ShaderInfo::VertLayout& layout = shaderInfo.vertexLayouts[result.vertLayoutIdx];
+			KVSection* layoutSec = vertexLayoutsSec->CreateSection(vertLayout.name);
+			if (vertLayout.aliasOf != -1)
+			{
+				layoutSec->AddValue("aliasOf");
+				layoutSec->AddValue(shaderInfo.vertexLayouts[vertLayout.aliasOf].name);
+			}
+		}
+	}
 
-			if (result.refResult == -1)
-				continue;
+	KVSection* shadersListSec = shaderInfoKvs.CreateSection("FileList");
 
-			ASSERT_MSG(result.refResult != -1, "Something went wrong, got empty shader and no reference id");
-			ASSERT(shaderInfo.results[result.refResult].kindFlag == result.kindFlag);
+	int shaderFileCount = 0;
+	Array<int> referenceRemap(PP_SL);
+	referenceRemap.setNum(shaderInfo.results.numElem());
 
-			// Reference shader bytecode file
-			KVSection* refSec = shadersListSec->CreateSection("ref");
-			refSec->AddValue(result.vertLayoutIdx);
+	// Store shader SPIR-V output in separate files
+	for (int i = 0; i < shaderInfo.results.numElem(); ++i)
+	{
+		const ShaderInfo::Result& result = shaderInfo.results[i];
+		if (result.kindFlag == -1 || result.refResult != -1)
+			continue;
 
-			if (result.kindFlag == SHADERKIND_VERTEX)
-				refSec->AddValue("Vertex");
-			else if (result.kindFlag == SHADERKIND_FRAGMENT)
-				refSec->AddValue("Fragment");
-			else if (result.kindFlag == SHADERKIND_COMPUTE)
-				refSec->AddValue("Compute");
+		const ShaderInfo::VertLayout& layout = shaderInfo.vertexLayouts[result.vertLayoutIdx];
 
-			refSec->AddValue(shaderInfo.entryPoints[result.entryPointId].name);
-			refSec->AddValue(result.queryStr);
-			refSec->AddValue(referenceRemap[result.refResult]);
+		EqString shaderFileName = EqString::Format("%s-%s", layout.name.ToCString(), result.queryStr.ToCString());
+		KVSection* spvSec = shadersListSec->CreateSection("spv");
+		spvSec->AddValue(result.vertLayoutIdx);
+
+		if (result.kindFlag == SHADERKIND_VERTEX)
+		{
+			spvSec->AddValue("Vertex");
+			shaderFileName.Append(".vert");
+		}
+		else if (result.kindFlag == SHADERKIND_FRAGMENT)
+		{
+			spvSec->AddValue("Fragment");
+			shaderFileName.Append(".frag");
+		}
+		else if (result.kindFlag == SHADERKIND_COMPUTE)
+		{
+			spvSec->AddValue("Compute");
+			shaderFileName.Append(".comp");
 		}
 
-		CMemoryStream shaderInfoData(nullptr, VS_OPEN_WRITE, 8192, PP_SL);
-		KV_WriteToStreamBinary(&shaderInfoData, &shaderInfoKvs);
-		shaderPackFile.Add(&shaderInfoData, "ShaderInfo");
+		spvSec->AddValue(shaderInfo.entryPoints[result.entryPointId].name);
+		spvSec->AddValue(result.queryStr);
 
-		shaderPackFile.End();
+		// Write shader bytecode file
+		CMemoryStream readOnlyStream((ubyte*)result.spirv.ptr(), VS_OPEN_READ, result.spirv.numElem() * sizeof(uint32), PP_SL);
+		shaderPackFile.Add(&readOnlyStream, shaderFileName);
+
+		referenceRemap[i] = shaderFileCount++;
 	}
+
+	for (int i = 0; i < shaderInfo.results.numElem(); ++i)
+	{
+		const ShaderInfo::Result& result = shaderInfo.results[i];
+		if (result.kindFlag == -1 || result.refResult == -1)
+			continue;
+
+		ASSERT(shaderInfo.results[result.refResult].kindFlag == result.kindFlag);
+
+		// Reference shader bytecode file
+		KVSection* refSec = shadersListSec->CreateSection("ref");
+		refSec->AddValue(result.vertLayoutIdx);
+
+		if (result.kindFlag == SHADERKIND_VERTEX)
+			refSec->AddValue("Vertex");
+		else if (result.kindFlag == SHADERKIND_FRAGMENT)
+			refSec->AddValue("Fragment");
+		else if (result.kindFlag == SHADERKIND_COMPUTE)
+			refSec->AddValue("Compute");
+
+		refSec->AddValue(shaderInfo.entryPoints[result.entryPointId].name);
+		refSec->AddValue(result.queryStr);
+		refSec->AddValue(referenceRemap[result.refResult]);
+	}
+
+	CMemoryStream shaderInfoData(nullptr, VS_OPEN_WRITE, 8192, PP_SL);
+	KV_WriteToStreamBinary(&shaderInfoData, &shaderInfoKvs);
+	shaderPackFile.Add(&shaderInfoData, "ShaderInfo");
+
+	shaderPackFile.End();
 }
 
 bool CShaderCooker::Init(const char* confFileName, const char* targetName)
@@ -856,6 +1032,14 @@ bool CShaderCooker::Init(const char* confFileName, const char* targetName)
 			m_targetProps.targetFolder.ReplaceSubstr(s_gameDirTag, g_fileSystem->GetCurrentGameDirectory());
 
 			g_fileSystem->MakeDir(m_targetProps.targetFolder, SP_ROOT);
+
+			const char* cacheFolder = KV_GetValueString(currentTarget->FindSection("CachePath"), 0, nullptr);
+			m_targetProps.cacheFolder = cacheFolder ? EqString(cacheFolder) : (m_targetProps.targetFolder.TrimChar(CORRECT_PATH_SEPARATOR).TrimChar(INCORRECT_PATH_SEPARATOR) + "_cache");
+
+			m_targetProps.cacheFolder.ReplaceSubstr(s_engineDirTag, g_fileSystem->GetCurrentDataDirectory());
+			m_targetProps.cacheFolder.ReplaceSubstr(s_gameDirTag, g_fileSystem->GetCurrentGameDirectory());
+
+			g_fileSystem->MakeDir(m_targetProps.cacheFolder, SP_ROOT);
 		}
 	}
 
@@ -884,13 +1068,50 @@ void CShaderCooker::Execute()
 	// load CRC list, check for existing shader files, and skip if necessary
 	KV_LoadFromFile(crcFileName, SP_ROOT, &m_batchConfig.crcSec);
 
-	// process shader files
-	
+	CEqTimer timer;
+
+	// compiler update invalidates object cache
+	m_compilerHash = GetCompilerVersionHash();
+
+	// load shader sources and collect variants of all shaders
+	for (int i = 0; i < m_shaderList.numElem(); ++i)
+		PrepareShader(i);
+
+	MsgInfo("Compiling %d variants...\n", m_variantTasks.numElem());
+
+	// compile variants of all shaders together, workers are taking tasks until none left
+	const int numJobs = max(1, m_jobMng.GetJobThreadsCount());
+	for (int i = 0; i < numJobs; ++i)
+	{
+		FunctionJob* funcJob = PPNew FunctionJob("CompileShaderVariants", [this](void*, int) {
+			int taskIdx;
+			while ((taskIdx = Atomic::Increment(m_nextTask) - 1) < m_variantTasks.numElem())
+				CompileVariant(m_variantTasks[taskIdx]);
+		});
+		funcJob->DeleteOnFinish();
+		m_jobMng.InitStartJob(funcJob);
+	}
+	m_jobMng.Wait();
+
+	int numWritten = 0;
+	int numSkipped = 0;
+	int numFailedShaders = 0;
 	for (ShaderInfo& shaderInfo : m_shaderList)
-	{	
-		ProcessShader(shaderInfo);
+	{
+		if (shaderInfo.status == SHADERCONV_INIT)
+			WriteShaderPackage(shaderInfo);
+
+		if (shaderInfo.status == SHADERCONV_COMPILED)
+			++numWritten;
+		else if (shaderInfo.status == SHADERCONV_SKIPPED)
+			++numSkipped;
+		else
+			++numFailedShaders;
 	}
 
+	MsgInfo("Target done in %.2f seconds: %d shaders written, %d unchanged, %d failed\n", timer.GetTime(), numWritten, numSkipped, numFailedShaders);
+	MsgInfo("   %d objects compiled, %d cache hits, %d failed\n", m_numCompiled, m_numCacheHits, m_numFailed);
+
 	// save CRC list file
 	IFilePtr pStream = g_fileSystem->Open(crcFileName, "wt", SP_ROOT);
 	if (pStream)
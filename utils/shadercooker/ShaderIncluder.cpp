@@ -6,7 +6,7 @@
 #include "ShaderIncluder.h"
 #include "GLSLBoilerplate.h"
 
-EqShaderIncluder::EqShaderIncluder(ShaderInfo& shaderInfo, ArrayCRef<EqString> includePaths)
+EqShaderIncluder::EqShaderIncluder(const ShaderInfo& shaderInfo, ArrayCRef<EqString> includePaths)
 	: m_shaderInfo(shaderInfo), m_includePaths(includePaths)
 {
 }
@@ -5,7 +5,7 @@
 class EqShaderIncluder: public shaderc::CompileOptions::IncluderInterface
 {
 public:
-	EqShaderIncluder(ShaderInfo& shaderInfo, ArrayCRef<EqString> includePaths);
+	EqShaderIncluder(const ShaderInfo& shaderInfo, ArrayCRef<EqString> includePaths);
 
 	shaderc_include_result* GetInclude(const char* requested_source, shaderc_include_type type, const char* requesting_source, size_t include_depth);
 	void ReleaseInclude(shaderc_include_result* data);
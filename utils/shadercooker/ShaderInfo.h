@@ -45,13 +45,15 @@ struct ShaderInfo
 	};
 	struct Result
 	{
-		shaderc::SpvCompilationResult data;
+		Array<uint32>	spirv{ PP_SL };
 		EqString		queryStr;
 		int				entryPointId{ -1 };
-		int				kindFlag{ -1 };
+		int				kindFlag{ -1 };		// -1 if variant was skipped or failed
 		int				refResult{ -1 };
 		int				vertLayoutIdx{ -1 };
-		uint32			crc32{ 0 };
+		uint32			crc32{ 0 };			// SPIR-V checksum
+		uint64			hash{ 0 };			// preprocessed source and compile settings hash
+		bool			cached{ false };
 	};
 	struct SkipCombo
 	{
@@ -62,7 +64,8 @@ struct ShaderInfo
 		EqString		name;
 		int				kind{ 0 };
 	};
-	Array<Result>		results{ PP_SL };
+	Array<Result>		results{ PP_SL };	// slot per vertex layout, variant and entry point
+	Array<EqString>		switchDefines{ PP_SL };
 	Array<EntryPoint>	entryPoints{ PP_SL };
 	Array<VertLayout>	vertexLayouts{ PP_SL };
 	Array<Variant>		variants{ PP_SL };
@@ -70,12 +73,17 @@ struct ShaderInfo
 
 	EqString			name;
 	EqString			sourceFilename;
+	EqString			sourcePath;			// resolved source file path
+	EqString			sourceText;
 
 	EShaderConvStatus	status{ SHADERCONV_INIT };
 	EShaderSourceType	sourceType{ SHADERSOURCE_UNDEFINED };
 
 	uint32				crc32{ 0 };
 	int					totalVariationCount{ 0 };
+	int					variantCount{ 0 };	// define combinations
+
+	volatile int		compileErrors{ 0 };
 
 	bool				isExt{ false };
 };
\ No newline at end of file
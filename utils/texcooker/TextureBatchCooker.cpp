@@ -7,7 +7,9 @@
 
 #include "core/core_common.h"
 #include "core/IFileSystem.h"
+#include "core/platform/eqjobmanager.h"
 #include "imaging/ImageLoader.h"
+#include "imaging/BlockCompression.h"
 #include "imaging/PixWriter.h"
 #include "utils/KeyValues.h"
 #include "texcooker_defs.h"
@@ -32,6 +34,12 @@ BatchConfig
 		application "otherConverter.exe";
 		arguments "-etcpack %INPUT_FILENAME% %OUTPUT_FILEPATH%";
 
+		// built-in compressor is used instead of application if format is set
+		// DXT1, DXT3, DXT5, ATI1N, ATI2N, BC7 or uncompressed formats
+		format		"BC7";
+		mipfilter	"kaiser";	// box or kaiser
+		srgb		1;			// gamma-correct mipmaps, color formats are saved as sRGB
+
 		usage default
 		{
 			sourcepath 	"./0_materials_src/";	// soruce folder
@@ -44,6 +52,9 @@ BatchConfig
 			sourcepath 	"./0_materials_src/";	// soruce folder
 			sourceext	"tga";
 			arguments "-etc1";
+
+			format		"ATI2N";	// overrides compression settings, "none" to use application
+			srgb		0;
 		}
 	}
 }
@@ -77,6 +88,11 @@ struct UsageProperties
 
 	EqString applicationName;
 	EqString applicationArguments;
+
+	// built-in compressor settings
+	ETextureFormat	format{ FORMAT_NONE };
+	EMipMapFilter	mipFilter{ MIPMAP_FILTER_BOX };
+	bool			srgb{ false };
 };
 
 struct BatchConfig
@@ -85,6 +101,7 @@ struct BatchConfig
 	EqString		applicationArgumentsTemplate;
 
 	EqString		compressionApplicationArguments;
+	UsageProperties	compressionUsage;	// built-in compressor settings of compression preset
 
 	UsageProperties defaultUsage{ "default" };
 	Array<UsageProperties> usageList{ PP_SL };
@@ -113,6 +130,11 @@ struct TexInfo
 class CTextureCooker
 {
 public:
+	CTextureCooker(CEqJobManager& jobMng)
+		: m_jobMng(jobMng)
+	{
+	}
+
 	bool				Init(const char* confFileName, const char* targetName);
 	void				Execute();
 
@@ -127,8 +149,10 @@ private:
 	bool				HasMatchingCRC(uint32 crc);
 	void				ProcessMaterial(const EqString& materialFileName);
 	void				ProcessTexture(TexInfo& textureInfo);
+	bool				CompressTexture(const TexInfo& textureInfo, const char* sourceFilename, const char* targetFilename);
 	UsageProperties*	FindUsage(const char* usageName);
 
+	CEqJobManager&		m_jobMng;
 	BatchConfig			m_batchConfig;
 	TargetProperties	m_targetProps;
 
@@ -150,6 +174,23 @@ UsageProperties* CTextureCooker::FindUsage(const char* usageName)
 	return &m_batchConfig.defaultUsage;
 }
 
+static void LoadBuiltinCompressorSettings(const KVSection* sec, UsageProperties& usage)
+{
+	const char* formatName = KV_GetValueString(sec->FindSection("format"), 0, nullptr);
+	if (formatName)
+	{
+		usage.format = GetFormatFromString(formatName);
+		if (usage.format == FORMAT_NONE && CString::CompareCaseIns(formatName, "none"))
+			MsgWarning("Unknown image format '%s'\n", formatName);
+	}
+
+	const char* mipFilterName = KV_GetValueString(sec->FindSection("mipfilter"), 0, nullptr);
+	if (mipFilterName)
+		usage.mipFilter = !CString::CompareCaseIns(mipFilterName, "kaiser") ? MIPMAP_FILTER_KAISER : MIPMAP_FILTER_BOX;
+
+	usage.srgb = KV_GetValueBool(sec->FindSection("srgb"), 0, usage.srgb);
+}
+
 
 void CTextureCooker::LoadBatchConfig(const KVSection* batchSec)
 {
@@ -180,6 +221,12 @@ void CTextureCooker::LoadBatchConfig(const KVSection* batchSec)
 
 	m_batchConfig.applicationName = KV_GetValueString(compressionSec->FindSection("application"), 0, m_batchConfig.applicationName);
 	m_batchConfig.compressionApplicationArguments = KV_GetValueString(compressionSec->FindSection("arguments"), 0, "");
+	LoadBuiltinCompressorSettings(compressionSec, m_batchConfig.compressionUsage);
+	m_batchConfig.compressionUsage.applicationName = m_batchConfig.applicationName;
+
+	// used when there is no 'usage default' section
+	m_batchConfig.defaultUsage = m_batchConfig.compressionUsage;
+	m_batchConfig.defaultUsage.usageName = "default";
 
 	// load usages
 	for (const KVSection* usageKey : compressionSec->Keys("usage"))
@@ -191,10 +238,11 @@ void CTextureCooker::LoadBatchConfig(const KVSection* batchSec)
 			continue;
 		}
 
-		UsageProperties usage;
+		UsageProperties usage = m_batchConfig.compressionUsage;
 		usage.usageName = usageName;
 		usage.applicationName = KV_GetValueString(usageKey->FindSection("application"), 0, m_batchConfig.applicationName);
 		usage.applicationArguments = KV_GetValueString(usageKey->FindSection("arguments"), 0, "");
+		LoadBuiltinCompressorSettings(usageKey, usage);
 
 		if (!usageName.CompareCaseIns("default"))
 			m_batchConfig.defaultUsage = usage;
@@ -431,10 +479,22 @@ void CTextureCooker::ProcessTexture(TexInfo& textureInfo)
 	// make image folder
 	g_fileSystem->MakeDir(targetFilePath, SP_ROOT);
 
-	EqString arguments(m_batchConfig.applicationArgumentsTemplate);
-	arguments.ReplaceSubstr(s_argumentsTag, (m_batchConfig.compressionApplicationArguments + " " + textureInfo.usage->applicationArguments));
-	arguments.ReplaceSubstr(s_inputFileNameTag, sourceFilename);
-	arguments.ReplaceSubstr(s_outputFilePathTag, targetFilePath);
+	const UsageProperties& usage = *textureInfo.usage;
+	const bool builtinCompressor = usage.format != FORMAT_NONE;
+
+	// built-in compressor settings are hashed same way as application arguments
+	EqString arguments;
+	if (builtinCompressor)
+	{
+		arguments = EqString::Format("builtin%d %s mipfilter=%d srgb=%d", BLOCK_COMPRESS_VERSION, GetFormatString(usage.format), usage.mipFilter, usage.srgb);
+	}
+	else
+	{
+		arguments = m_batchConfig.applicationArgumentsTemplate;
+		arguments.ReplaceSubstr(s_argumentsTag, (m_batchConfig.compressionApplicationArguments + " " + usage.applicationArguments));
+		arguments.ReplaceSubstr(s_inputFileNameTag, sourceFilename);
+		arguments.ReplaceSubstr(s_outputFilePathTag, targetFilePath);
+	}
 
 	// generate CRC from image file content and arguments it's going to be built
 	uint32 srcCRC = g_fileSystem->GetFileCRC32(sourceFilename, SP_ROOT);
@@ -462,9 +522,20 @@ void CTextureCooker::ProcessTexture(TexInfo& textureInfo)
 
 	textureInfo.status = CONVERTED;
 
-	
+	if (builtinCompressor)
+	{
+		if (!CompressTexture(textureInfo, sourceFilename, targetFilename))
+			MsgError("Error compressing texture\n");
+		return;
+	}
 
-	EqString cmdLine(EqString::Format("%s %s", m_batchConfig.applicationName.ToCString(), arguments.ToCString()));
+	if (!usage.applicationName.Length())
+	{
+		MsgError("No application or format specified for usage '%s'\n", usage.usageName.ToCString());
+		return;
+	}
+
+	EqString cmdLine(EqString::Format("%s %s", usage.applicationName.ToCString(), arguments.ToCString()));
 	fnmPathFixSeparators(cmdLine);
 
 	DevMsg(DEVMSG_CORE, "*RUN '%s'\n", cmdLine.GetData());
@@ -475,6 +546,39 @@ void CTextureCooker::ProcessTexture(TexInfo& textureInfo)
 	}
 }
 
+bool CTextureCooker::CompressTexture(const TexInfo& textureInfo, const char* sourceFilename, const char* targetFilename)
+{
+	const UsageProperties& usage = *textureInfo.usage;
+
+	CImage image;
+	if (!image.Load(sourceFilename, 0, SP_ROOT))
+	{
+		MsgError("Cannot load image '%s'\n", sourceFilename);
+		return false;
+	}
+
+	if (IsCompressedFormat(image.GetFormat()))
+	{
+		MsgError("'%s' is already compressed\n", sourceFilename);
+		return false;
+	}
+
+	if (!image.CreateMipMaps(ALL_MIPMAPS, usage.mipFilter, usage.srgb))
+		return false;
+
+	if (!image.Convert(usage.format, &m_jobMng))
+	{
+		MsgError("Cannot convert '%s' to %s\n", sourceFilename, GetFormatString(usage.format));
+		return false;
+	}
+
+	// color formats are tagged as sRGB so they are sampled with gamma correction
+	if (usage.srgb && IsCompressedFormat(usage.format) && GetChannelCount(usage.format) >= 3)
+		image.GetFormat(MakeTexFormat(image.GetFormat(), TEXFORMAT_FLAG_SRGB));
+
+	return image.SaveImage(targetFilename, SP_ROOT);
+}
+
 bool CTextureCooker::Init(const char* confFileName, const char* targetName)
 {
 	// load all properties
@@ -564,9 +668,9 @@ bool CTextureCooker::Init(const char* confFileName, const char* targetName)
 
 		LoadBatchConfig(batchConfig);
 
-		if (!m_batchConfig.applicationName.Length())
+		if (!m_batchConfig.applicationName.Length() && m_batchConfig.compressionUsage.format == FORMAT_NONE)
 		{
-			MsgError("No application specified in either batch config or compression setting!\n");
+			MsgError("No application or format specified in either batch config or compression setting!\n");
 			return false;
 		}
 	}
@@ -618,9 +722,9 @@ void CTextureCooker::Execute()
 	}
 }
 
-void CookTarget(const char* pszTargetName)
+void CookTarget(const char* pszTargetName, CEqJobManager& jobMng)
 {
-	CTextureCooker cooker;
+	CTextureCooker cooker(jobMng);
 	if (!cooker.Init("TextureCooker.CONFIG", pszTargetName))
 		return;
 	cooker.Execute();
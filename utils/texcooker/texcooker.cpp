@@ -9,6 +9,8 @@
 #include "core/IDkCore.h"
 #include "core/ICommandLine.h"
 #include "core/IFileSystem.h"
+#include "core/IEqCPUServices.h"
+#include "core/platform/eqjobmanager.h"
 #include "texcooker_defs.h"
 
 void Usage()
@@ -32,13 +34,16 @@ int main(int argc, char* argv[])
 		Usage();
 	}
 
-	for (int i = 0; i < g_cmdLine->GetArgumentCount(); i++)
 	{
-		EqString argStr = g_cmdLine->GetArgumentString(i);
-
-		if (!argStr.CompareCaseIns("-target"))
+		CEqJobManager jobMng("texcookerJobs", max(4, g_cpuCaps->GetCPUCount()), 1024);
+		for (int i = 0; i < g_cmdLine->GetArgumentCount(); i++)
 		{
-			CookTarget(g_cmdLine->GetArgumentsOf(i));
+			EqString argStr = g_cmdLine->GetArgumentString(i);
+
+			if (!argStr.CompareCaseIns("-target"))
+			{
+				CookTarget(g_cmdLine->GetArgumentsOf(i), jobMng);
+			}
 		}
 	}
 
@@ -13,5 +13,7 @@ static constexpr EqStringRef s_materialAtlasFileExt = "atlas";
 static constexpr EqStringRef s_materialFileExt = "mat";
 static constexpr EqStringRef s_atlasFileExt = "atl";
 
+class CEqJobManager;
+
 void ProcessAtlasFile(const char* atlasSrcFileName, const char* materialsPath);
-void CookTarget(const char* pszTargetName);;
\ No newline at end of file
+void CookTarget(const char* pszTargetName, CEqJobManager& jobMng);;
\ No newline at end of file